@@ -0,0 +1,12 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepassfragmentshader.glsl
+// ============
+// fragment shader of the depth pre-pass - writes no color, only the
+// fixed-function depth
+///////////////////////////////////////////////////////////////////////////////
+
+#version 460 core
+
+void main()
+{
+}
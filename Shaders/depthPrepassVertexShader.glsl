@@ -0,0 +1,48 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepassvertexshader.glsl
+// ============
+// vertex shader of the depth pre-pass - transforms the position-only
+// stream exactly like indirectVertexShader.glsl, so the shading pass
+// can test against the depth with GL_EQUAL
+///////////////////////////////////////////////////////////////////////////////
+
+#version 460 core
+
+layout (location = 0) in vec3 inVertexPosition;
+
+// matches GPU_DRAW_DATA in IndirectRenderer.h
+struct DrawData
+{
+	mat4 model;
+	vec2 uvScale;
+	int textureSlot;
+	int materialIndex;
+	int lightmapChart;
+	int lightmapLayer;
+	int padding[2];
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer
+{
+	DrawData drawData[];
+};
+
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+};
+
+// the same expression as in the shading pass, computed the
+// same way, so the depths match bit for bit
+invariant gl_Position;
+
+void main()
+{
+	int objectIndex = gl_BaseInstance + gl_InstanceID;
+	mat4 model = drawData[objectIndex].model;
+
+	vec4 worldPosition = model * vec4(inVertexPosition, 1.0);
+	gl_Position = projection * view * worldPosition;
+}
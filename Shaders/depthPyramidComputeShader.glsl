@@ -0,0 +1,44 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthpyramidcomputeshader.glsl
+// ============
+// compute shader of the GPU culling's depth pyramid; writes one texel of
+// a level as the farthest depth of the texels it covers in the copied
+// depth or the level below
+///////////////////////////////////////////////////////////////////////////////
+
+#version 450 core
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// the depth copy, or the pyramid itself for all but the
+// finest level
+layout (binding = 23) uniform sampler2D sourceDepth;
+uniform int sourceLevel;
+// texels of the source in use; the depth copy may be larger
+// than the viewport it holds
+uniform ivec2 sourceSize;
+
+layout (r32f, binding = 0) uniform writeonly image2D targetLevel;
+
+void main()
+{
+	ivec2 target = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 targetSize = imageSize(targetLevel);
+	if (any(greaterThanEqual(target, targetSize)))
+		return;
+
+	// the source texels the target texel overlaps, rounded
+	// outwards, so no depth is left out
+	ivec2 first = (target * sourceSize) / targetSize;
+	ivec2 last = min(((target + 1) * sourceSize + targetSize - 1) / targetSize, sourceSize) - 1;
+
+	float farthest = 0.0;
+	for (int y = first.y; y <= last.y; y++)
+	{
+		for (int x = first.x; x <= last.x; x++)
+		{
+			farthest = max(farthest, texelFetch(sourceDepth, ivec2(x, y), sourceLevel).r);
+		}
+	}
+	imageStore(targetLevel, target, vec4(farthest));
+}
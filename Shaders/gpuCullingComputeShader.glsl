@@ -0,0 +1,183 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpucullingcomputeshader.glsl
+// ============
+// compute shader of the GPU culling; tests the bounding sphere of one
+// object against the view frustum, its impostor's fade and the previous
+// frame's depth pyramid, and writes the object's indirect command with
+// one instance or none
+///////////////////////////////////////////////////////////////////////////////
+
+#version 450 core
+
+layout (local_size_x = 64) in;
+
+// matches GPU_DRAW_DATA in IndirectRenderer.h
+struct DrawData
+{
+	mat4 model;
+	vec2 uvScale;
+	int textureSlot;
+	int materialIndex;
+	int lightmapChart;
+	int lightmapLayer;
+	int padding[2];
+};
+
+// matches GPU_CULL_OBJECT in GPUCulling.cpp
+struct CullObject
+{
+	uint mesh;
+	uint flags;
+	int impostor;
+	int batch;
+	uint slot;
+	uint padding[3];
+};
+
+// matches GPU_CULL_MESH in GPUCulling.cpp
+struct CullMesh
+{
+	vec4 sphere;
+	uint indexCount;
+	uint firstIndex;
+	int baseVertex;
+	uint padding;
+};
+
+// the layout glMultiDrawElementsIndirect() reads
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer
+{
+	DrawData drawData[];
+};
+
+layout (std430, binding = 5) readonly buffer CullObjectBuffer
+{
+	CullObject objects[];
+};
+
+layout (std430, binding = 6) readonly buffer CullMeshBuffer
+{
+	CullMesh meshes[];
+};
+
+layout (std430, binding = 7) readonly buffer ImpostorFadeBuffer
+{
+	float fades[];
+};
+
+layout (std430, binding = 8) writeonly buffer CommandBuffer
+{
+	DrawCommand commands[];
+};
+
+// farthest depth per texel of the previous frame
+layout (binding = 23) uniform sampler2D depthPyramid;
+
+// normalized planes of the view frustum; inside is positive
+uniform vec4 frustumPlanes[6];
+// object flags that keep an object out of this view
+uniform uint hiddenFlags;
+// first command of each batch's culled objects
+uniform uint batchOffsets[32];
+uniform uint objectCount;
+uniform uint impostorCount;
+// test against the pyramid, drawn with pyramidViewProjection
+uniform bool bOcclusion;
+uniform mat4 pyramidViewProjection;
+uniform vec2 pyramidSize;
+uniform int pyramidLevels;
+
+/***********************************************************
+ *  IsOccluded()
+ *
+ *  True if the box around a sphere lies behind the depth of
+ *  the previous frame everywhere it covers.  The box is
+ *  projected with the previous frame's camera; the level of
+ *  the pyramid whose texels are at least as large as the
+ *  box on screen holds it within four texels.
+ ***********************************************************/
+bool IsOccluded(vec3 center, float radius)
+{
+	vec2 boxMin = vec2(1.0);
+	vec2 boxMax = vec2(-1.0);
+	float boxNear = 1.0;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		vec3 offset = vec3(((corner & 1) != 0) ? radius : -radius,
+			((corner & 2) != 0) ? radius : -radius,
+			((corner & 4) != 0) ? radius : -radius);
+		vec4 clip = pyramidViewProjection * vec4(center + offset, 1.0);
+		// a corner behind the camera - the box reaches past the
+		// view
+		if (clip.w <= 0.0)
+			return false;
+		vec3 ndc = clip.xyz / clip.w;
+		boxMin = min(boxMin, ndc.xy);
+		boxMax = max(boxMax, ndc.xy);
+		boxNear = min(boxNear, ndc.z);
+	}
+
+	// the pyramid knows nothing past the edges of its view
+	if (any(lessThan(boxMin, vec2(-1.0))) || any(greaterThan(boxMax, vec2(1.0))))
+		return false;
+
+	vec2 uvMin = boxMin * 0.5 + 0.5;
+	vec2 uvMax = boxMax * 0.5 + 0.5;
+	vec2 extent = (uvMax - uvMin) * pyramidSize;
+	float level = min(ceil(log2(max(max(extent.x, extent.y), 1.0))), float(pyramidLevels - 1));
+
+	float farthest = max(
+		max(textureLod(depthPyramid, uvMin, level).r, textureLod(depthPyramid, vec2(uvMax.x, uvMin.y), level).r),
+		max(textureLod(depthPyramid, vec2(uvMin.x, uvMax.y), level).r, textureLod(depthPyramid, uvMax, level).r));
+	return (boxNear * 0.5 + 0.5) > farthest;
+}
+
+void main()
+{
+	uint objectIndex = gl_GlobalInvocationID.x;
+	if (objectIndex >= objectCount)
+		return;
+	CullObject object = objects[objectIndex];
+	if (object.batch < 0)
+		return;
+	CullMesh mesh = meshes[object.mesh];
+
+	// the bounding sphere of the mesh moved into the world and
+	// grown by the largest scale, as the scene does for the
+	// CPU culling
+	mat4 model = drawData[objectIndex].model;
+	vec3 center = (model * vec4(mesh.sphere.xyz, 1.0)).xyz;
+	float maxScale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+	float radius = mesh.sphere.w * maxScale;
+
+	bool bVisible = (object.flags & hiddenFlags) == 0u;
+	for (int p = 0; p < 6; p++)
+	{
+		bVisible = bVisible && (dot(frustumPlanes[p].xyz, center) + frustumPlanes[p].w >= -radius);
+	}
+	// past its fade only the impostor is drawn
+	if (bVisible && (object.impostor >= 0) && (uint(object.impostor) < impostorCount))
+	{
+		bVisible = fades[object.impostor] < 1.0;
+	}
+	if (bVisible && bOcclusion)
+	{
+		bVisible = !IsOccluded(center, radius);
+	}
+
+	uint command = batchOffsets[object.batch] + object.slot;
+	commands[command].count = mesh.indexCount;
+	commands[command].instanceCount = bVisible ? 1u : 0u;
+	commands[command].firstIndex = mesh.firstIndex;
+	commands[command].baseVertex = mesh.baseVertex;
+	commands[command].baseInstance = objectIndex;
+}
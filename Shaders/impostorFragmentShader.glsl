@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////////
+// impostorfragmentshader.glsl
+// ============
+// fragment shader of the impostors - the baked color and normal of the
+// atlas view, lit like the indirect path, dithered in by the fade.
+// ShaderVariantCache inserts the TEXTURED / VIRTUAL_TEXTURED / LIT /
+// LIGHT_COUNT defines
+///////////////////////////////////////////////////////////////////////////////
+
+#version 460 core
+
+#ifndef LIT
+#define LIT 1
+#endif
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 4
+#endif
+
+// size of the light buffer, SHADER_MAX_LIGHTS in ShaderVariantCache.h
+#define MAX_LIGHTS 4
+
+// matches GPU_DRAW_DATA in IndirectRenderer.h
+struct DrawData
+{
+	mat4 model;
+	vec2 uvScale;
+	int textureSlot;
+	int materialIndex;
+	int lightmapChart;
+	int lightmapLayer;
+	int padding[2];
+};
+
+// matches GPU_MATERIAL in IndirectRenderer.h
+struct Material
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+};
+
+// matches GPU_LIGHT in IndirectRenderer.h
+struct Light
+{
+	vec4 position;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+};
+
+// matches GPU_IMPOSTOR_INSTANCE in ImpostorRenderer.h
+struct ImpostorInstance
+{
+	mat4 model;
+	vec4 sphere;
+	float fade;
+	int layer;
+	int objectIndex;
+	int padding;
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer
+{
+	DrawData drawData[];
+};
+
+layout (std430, binding = 1) readonly buffer MaterialBuffer
+{
+	Material materials[];
+};
+
+layout (std430, binding = 3) readonly buffer ImpostorInstanceBuffer
+{
+	ImpostorInstance instances[];
+};
+
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+};
+
+layout (std140, binding = 1) uniform LightBlock
+{
+	Light lights[MAX_LIGHTS];
+};
+
+// rgb = color, a = coverage / rgb = normal in the archetype's space
+layout (binding = 19) uniform sampler2DArray impostorColors;
+layout (binding = 20) uniform sampler2DArray impostorNormals;
+
+in vec3 fragmentPosition;
+in vec3 fragmentAtlasCoordinate;
+flat in int fragmentInstance;
+
+out vec4 outFragmentColor;
+
+#if LIT
+vec3 CalcLight(Light light, Material material, vec3 normal, vec3 viewDirection)
+{
+	vec3 lightDirection;
+	if (light.position.w > 0.5)
+		lightDirection = normalize(-light.position.xyz);
+	else
+		lightDirection = normalize(light.position.xyz - fragmentPosition);
+
+	vec3 ambient = light.ambient.rgb * material.ambient.rgb * material.ambient.a;
+
+	float diffuseImpact = max(dot(normal, lightDirection), 0.0);
+	vec3 diffuse = diffuseImpact * light.diffuse.rgb * material.diffuse.rgb;
+
+	// light.ambient.a = focal strength, light.diffuse.a = specular intensity
+	vec3 reflectDirection = reflect(-lightDirection, normal);
+	float specularComponent = pow(max(dot(viewDirection, reflectDirection), 0.0), max(light.ambient.a, material.specular.a));
+	vec3 specular = light.diffuse.a * specularComponent * light.specular.rgb * material.specular.rgb;
+
+	return(ambient + diffuse + specular);
+}
+#endif
+
+void main()
+{
+	ImpostorInstance instance = instances[fragmentInstance];
+
+	vec4 baseColor = texture(impostorColors, fragmentAtlasCoordinate);
+	if (baseColor.a < 0.5)
+		discard;
+
+	// 4 x 4 ordered dither: a fade of f keeps that part of the
+	// pixels, the same ones every frame
+	const float thresholds[16] = float[16](
+		0.0, 8.0, 2.0, 10.0,
+		12.0, 4.0, 14.0, 6.0,
+		3.0, 11.0, 1.0, 9.0,
+		15.0, 7.0, 13.0, 5.0);
+	ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+	if ((thresholds[pixel.y * 4 + pixel.x] + 0.5) / 16.0 >= instance.fade)
+		discard;
+
+#if LIT
+	Material material = materials[drawData[instance.objectIndex].materialIndex];
+	vec3 bakedNormal = texture(impostorNormals, fragmentAtlasCoordinate).xyz * 2.0 - 1.0;
+	vec3 normal = normalize(mat3(instance.model) * bakedNormal);
+	vec3 viewDirection = normalize(viewPosition.xyz - fragmentPosition);
+
+	vec3 lighting = vec3(0.0);
+	for (int i = 0; i < LIGHT_COUNT; i++)
+	{
+		lighting += CalcLight(lights[i], material, normal, viewDirection);
+	}
+	outFragmentColor = vec4(lighting * baseColor.rgb, 1.0);
+#else
+	outFragmentColor = vec4(baseColor.rgb, 1.0);
+#endif
+}
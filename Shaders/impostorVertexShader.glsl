@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+// impostorvertexshader.glsl
+// ============
+// vertex shader of the impostors; builds a camera-facing quad per
+// instance from gl_VertexID and picks the atlas view nearest to the
+// direction the camera sees the object from
+///////////////////////////////////////////////////////////////////////////////
+
+#version 460 core
+
+// matches GPU_IMPOSTOR_INSTANCE in ImpostorRenderer.h
+struct ImpostorInstance
+{
+	mat4 model;
+	vec4 sphere;
+	float fade;
+	int layer;
+	int objectIndex;
+	int padding;
+};
+
+layout (std430, binding = 3) readonly buffer ImpostorInstanceBuffer
+{
+	ImpostorInstance instances[];
+};
+
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+};
+
+// views along a side of the atlas
+uniform int framesPerSide;
+
+out vec3 fragmentPosition;
+out vec3 fragmentAtlasCoordinate;
+flat out int fragmentInstance;
+
+// right and up axes of the view of a direction, with world up
+// kept up; matches FrameBasis() in ImpostorBaker.cpp
+void FrameBasis(vec3 direction, out vec3 right, out vec3 up)
+{
+	vec3 forward = -direction;
+	right = cross(forward, vec3(0.0, 1.0, 0.0));
+	if (dot(right, right) < 1e-8)
+		right = vec3(1.0, 0.0, 0.0);
+	right = normalize(right);
+	up = cross(right, forward);
+}
+
+// atlas view of a direction in the upper hemisphere; the inverse
+// of ImpostorBaker::FrameDirection()
+vec2 FrameOfDirection(vec3 direction)
+{
+	direction.y = max(direction.y, 0.0);
+	direction /= abs(direction.x) + abs(direction.y) + abs(direction.z);
+	vec2 t = vec2(direction.x + direction.z, direction.x - direction.z);
+	return(round((t * 0.5 + 0.5) * float(framesPerSide - 1)));
+}
+
+void main()
+{
+	const vec2 corners[6] = vec2[6](
+		vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+		vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+	vec2 corner = corners[gl_VertexID];
+	ImpostorInstance instance = instances[gl_InstanceID];
+
+	// archetypes are placed with rotation and uniform scale
+	mat3 rotation = mat3(instance.model);
+	vec3 center = (instance.model * vec4(instance.sphere.xyz, 1.0)).xyz;
+	float radius = instance.sphere.w * length(rotation[0]);
+	vec3 toCamera = viewPosition.xyz - center;
+	float distanceToCamera = max(length(toCamera), radius * 2.0);
+	vec3 localDirection = normalize(transpose(rotation) * toCamera);
+
+	vec3 right;
+	vec3 up;
+	FrameBasis(localDirection, right, up);
+	right = normalize(rotation * right);
+	up = normalize(rotation * up);
+
+	// the quad sits in front of the object, so the dither pattern
+	// covers the mesh, and shrinks to keep its size on screen
+	float quadRadius = radius * (distanceToCamera - radius) / distanceToCamera;
+	vec3 position = center + toCamera / distanceToCamera * radius + (right * corner.x + up * corner.y) * quadRadius;
+
+	vec2 frame = FrameOfDirection(localDirection);
+	fragmentAtlasCoordinate = vec3((frame + corner * 0.5 + 0.5) / float(framesPerSide), float(instance.layer));
+	fragmentPosition = position;
+	fragmentInstance = gl_InstanceID;
+
+	gl_Position = projection * view * vec4(position, 1.0);
+}
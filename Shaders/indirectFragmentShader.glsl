@@ -0,0 +1,235 @@
+///////////////////////////////////////////////////////////////////////////////
+// indirectfragmentshader.glsl
+// ============
+// fragment shader of the multi-draw indirect path - Phong lighting with
+// the scene's light sources, per-object texture and material.
+// ShaderVariantCache inserts the TEXTURED / VIRTUAL_TEXTURED / LIT /
+// LIGHT_COUNT / LIGHTMAPPED / ALPHA_TESTED defines
+///////////////////////////////////////////////////////////////////////////////
+
+#version 460 core
+
+#ifndef TEXTURED
+#define TEXTURED 1
+#endif
+#ifndef VIRTUAL_TEXTURED
+#define VIRTUAL_TEXTURED 0
+#endif
+#ifndef LIT
+#define LIT 1
+#endif
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 4
+#endif
+#ifndef LIGHTMAPPED
+#define LIGHTMAPPED 0
+#endif
+#ifndef ALPHA_TESTED
+#define ALPHA_TESTED 0
+#endif
+
+// size of the light buffer, SHADER_MAX_LIGHTS in ShaderVariantCache.h
+#define MAX_LIGHTS 4
+
+// matches GPU_DRAW_DATA in IndirectRenderer.h
+struct DrawData
+{
+	mat4 model;
+	vec2 uvScale;
+	int textureSlot;
+	int materialIndex;
+	int lightmapChart;
+	int lightmapLayer;
+	int padding[2];
+};
+
+// matches GPU_MATERIAL in IndirectRenderer.h
+struct Material
+{
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+};
+
+// matches GPU_LIGHT in IndirectRenderer.h
+struct Light
+{
+	vec4 position;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer
+{
+	DrawData drawData[];
+};
+
+layout (std430, binding = 1) readonly buffer MaterialBuffer
+{
+	Material materials[];
+};
+
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+};
+
+layout (std140, binding = 1) uniform LightBlock
+{
+	Light lights[MAX_LIGHTS];
+};
+
+// the scene textures are bound to units 0 - 15
+layout (binding = 0) uniform sampler2D objectTextures[16];
+
+#if VIRTUAL_TEXTURED
+// matches GPU_VIRTUAL_TEXTURE in VirtualTexture.h
+layout (std140, binding = 2) uniform VirtualTextureBlock
+{
+	vec4 vtLayout;
+	vec4 vtPage;
+	vec4 vtPhysical;
+};
+
+// one texel per page and level: rg = slot, b = level in the slot
+layout (binding = 16) uniform usampler2D vtIndirection;
+layout (binding = 17) uniform sampler2D vtPhysicalPages;
+#endif
+
+#if LIGHTMAPPED
+// see indirectVertexShader.glsl
+layout (std430, binding = 4) readonly buffer LightmapChartBuffer
+{
+	vec4 lightmapInfo;
+	vec4 lightmapCharts[];
+};
+
+// the baked pages: RGBM irradiance and ambient occlusion
+layout (binding = 21) uniform sampler2DArray lightmapIrradiance;
+layout (binding = 22) uniform sampler2DArray lightmapOcclusion;
+#endif
+
+in vec3 fragmentPosition;
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+flat in int fragmentObjectIndex;
+#if LIGHTMAPPED
+in vec3 fragmentLightmapCoordinate;
+#endif
+
+out vec4 outFragmentColor;
+
+#if LIT
+// occlusion dims the ambient light; the lightmapped variants
+// leave the diffuse light to the lightmap
+vec3 CalcLight(Light light, Material material, vec3 normal, vec3 viewDirection, float occlusion)
+{
+	vec3 lightDirection;
+	if (light.position.w > 0.5)
+		lightDirection = normalize(-light.position.xyz);
+	else
+		lightDirection = normalize(light.position.xyz - fragmentPosition);
+
+	vec3 ambient = light.ambient.rgb * material.ambient.rgb * material.ambient.a * occlusion;
+
+#if LIGHTMAPPED
+	vec3 diffuse = vec3(0.0);
+#else
+	float diffuseImpact = max(dot(normal, lightDirection), 0.0);
+	vec3 diffuse = diffuseImpact * light.diffuse.rgb * material.diffuse.rgb;
+#endif
+
+	// light.ambient.a = focal strength, light.diffuse.a = specular intensity
+	vec3 reflectDirection = reflect(-lightDirection, normal);
+	float specularComponent = pow(max(dot(viewDirection, reflectDirection), 0.0), max(light.ambient.a, material.specular.a));
+	vec3 specular = light.diffuse.a * specularComponent * light.specular.rgb * material.specular.rgb;
+
+	return(ambient + diffuse + specular);
+}
+#endif
+
+#if VIRTUAL_TEXTURED
+vec4 SampleVirtualTexture(vec2 uv)
+{
+	// the level the feedback pass asks for - see
+	// virtualTextureFeedbackFragmentShader.glsl
+	vec2 texel = uv * vtLayout.xy * vtPage.x;
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float level = floor(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)));
+	int mip = int(clamp(level, 0.0, vtLayout.z - 1.0));
+
+	uv = clamp(uv, vec2(0.0), vec2(0.99999));
+	ivec2 levelPages = ivec2(vtLayout.xy) >> mip;
+	uvec4 entry = texelFetch(vtIndirection, ivec2(uv * vec2(levelPages)), mip);
+
+	// the entry may be a coarser page standing in for this one
+	vec2 residentPages = vec2(ivec2(vtLayout.xy) >> int(entry.b));
+	vec2 inPage = fract(uv * residentPages);
+	vec2 physical = vec2(entry.rg) * vtPage.z + vtPage.y + inPage * vtPage.x;
+	return(textureLod(vtPhysicalPages, physical * vtPhysical.xy, 0.0));
+}
+#endif
+
+void main()
+{
+	DrawData data = drawData[fragmentObjectIndex];
+
+#if VIRTUAL_TEXTURED
+	vec4 baseColor = SampleVirtualTexture(fragmentTextureCoordinate);
+#elif TEXTURED
+	// sampler arrays may only be indexed with dynamically
+	// uniform values, and the slot can change between the
+	// instances of one command - so loop over the slots with
+	// the loop counter as the index instead
+	vec4 baseColor = vec4(1.0);
+	for (int i = 0; i < 16; i++)
+	{
+		if (i == data.textureSlot)
+			baseColor = texture(objectTextures[i], fragmentTextureCoordinate);
+	}
+#else
+	// the lighting applies the material colors on its own
+	vec4 baseColor = vec4(1.0);
+#endif
+
+#if LIT
+	Material material = materials[data.materialIndex];
+#if ALPHA_TESTED
+	// diffuse.a is the cutoff of alpha tested materials; the
+	// fragments left are opaque
+	if (baseColor.a < material.diffuse.a)
+		discard;
+	baseColor.a = 1.0;
+#else
+	// and the opacity of the others
+	baseColor.a *= material.diffuse.a;
+#endif
+	vec3 normal = normalize(fragmentVertexNormal);
+	vec3 viewDirection = normalize(viewPosition.xyz - fragmentPosition);
+
+#if LIGHTMAPPED
+	// the baked diffuse light, direct and bounced, with the
+	// shadows of the static garden
+	vec4 irradiance = texture(lightmapIrradiance, fragmentLightmapCoordinate);
+	float occlusion = texture(lightmapOcclusion, fragmentLightmapCoordinate).r;
+	vec3 lighting = irradiance.rgb * irradiance.a * lightmapInfo.x * material.diffuse.rgb;
+#else
+	float occlusion = 1.0;
+	vec3 lighting = vec3(0.0);
+#endif
+
+	// LIGHT_COUNT is a constant, so the loop is unrolled and
+	// no unused light slot is evaluated
+	for (int i = 0; i < LIGHT_COUNT; i++)
+	{
+		lighting += CalcLight(lights[i], material, normal, viewDirection, occlusion);
+	}
+	outFragmentColor = vec4(lighting * baseColor.rgb, baseColor.a);
+#else
+	outFragmentColor = baseColor;
+#endif
+}
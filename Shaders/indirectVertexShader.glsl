@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// indirectvertexshader.glsl
+// ============
+// vertex shader of the multi-draw indirect path; the object data is
+// fetched from a storage buffer through the base instance of the draw.
+// ShaderVariantCache inserts the TEXTURED / VIRTUAL_TEXTURED / LIT /
+// LIGHT_COUNT / LIGHTMAPPED / ALPHA_TESTED defines
+///////////////////////////////////////////////////////////////////////////////
+
+#version 460 core
+
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+#if LIGHTMAPPED
+// chart coordinate and chart index within the object, from
+// LightmapCharts
+layout (location = 3) in vec3 inLightmapCoordinate;
+#endif
+
+// matches GPU_DRAW_DATA in IndirectRenderer.h
+struct DrawData
+{
+	mat4 model;
+	vec2 uvScale;
+	int textureSlot;
+	int materialIndex;
+	int lightmapChart;
+	int lightmapLayer;
+	int padding[2];
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer
+{
+	DrawData drawData[];
+};
+
+#if LIGHTMAPPED
+// matches the chart buffer of Lightmap.cpp: x of the first
+// vec4 is the irradiance range, then the page rectangle of
+// every chart (xy = offset, zw = scale)
+layout (std430, binding = 4) readonly buffer LightmapChartBuffer
+{
+	vec4 lightmapInfo;
+	vec4 lightmapCharts[];
+};
+#endif
+
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+};
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out int fragmentObjectIndex;
+#if LIGHTMAPPED
+// page coordinate and page of the lightmap
+out vec3 fragmentLightmapCoordinate;
+#endif
+
+// must match the depth pre-pass bit for bit, which tests the
+// shading pass against it with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{
+	// the base instance of each command is its first object;
+	// instanced commands cover the objects that follow it
+	int objectIndex = gl_BaseInstance + gl_InstanceID;
+	mat4 model = drawData[objectIndex].model;
+
+	vec4 worldPosition = model * vec4(inVertexPosition, 1.0);
+	fragmentPosition = worldPosition.xyz;
+	fragmentVertexNormal = mat3(transpose(inverse(model))) * inVertexNormal;
+#if VIRTUAL_TEXTURED
+	// the virtual texture covers the object once
+	fragmentTextureCoordinate = inTextureCoordinate;
+#else
+	fragmentTextureCoordinate = inTextureCoordinate * drawData[objectIndex].uvScale;
+#endif
+	fragmentObjectIndex = objectIndex;
+#if LIGHTMAPPED
+	vec4 chart = lightmapCharts[drawData[objectIndex].lightmapChart + int(inLightmapCoordinate.z + 0.5)];
+	fragmentLightmapCoordinate = vec3(chart.xy + inLightmapCoordinate.xy * chart.zw,
+		float(drawData[objectIndex].lightmapLayer));
+#endif
+
+	gl_Position = projection * view * worldPosition;
+}
@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////
+// terrainvertexshader.glsl
+// ============
+// vertex shader of the terrain; places a node's grid vertex in the
+// world, morphs it towards the next coarser level with distance and
+// takes its height and normal from the node's height tile.
+// ShaderVariantCache inserts the TEXTURED / VIRTUAL_TEXTURED / LIT /
+// LIGHT_COUNT / LIGHTMAPPED defines
+///////////////////////////////////////////////////////////////////////////////
+
+#version 460 core
+
+// matches TERRAIN_MAX_LEVELS in Terrain.h
+#define MAX_TERRAIN_LEVELS 12
+
+// grid coordinates of the vertex within the drawn part of a node
+layout (location = 0) in vec2 inGridPosition;
+
+// matches GPU_DRAW_DATA in IndirectRenderer.h
+struct DrawData
+{
+	mat4 model;
+	vec2 uvScale;
+	int textureSlot;
+	int materialIndex;
+	int lightmapChart;
+	int lightmapLayer;
+	int padding[2];
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer
+{
+	DrawData drawData[];
+};
+
+#if LIGHTMAPPED
+// matches the chart buffer of Lightmap.cpp: x of the first
+// vec4 is the irradiance range, then the page rectangle of
+// every chart (xy = offset, zw = scale)
+layout (std430, binding = 4) readonly buffer LightmapChartBuffer
+{
+	vec4 lightmapInfo;
+	vec4 lightmapCharts[];
+};
+#endif
+
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+};
+
+// matches GPU_TERRAIN_INSTANCE in Terrain.h
+struct TerrainInstance
+{
+	vec4 node;
+	vec4 tile;
+};
+
+layout (std430, binding = 2) readonly buffer TerrainInstanceBuffer
+{
+	TerrainInstance instances[];
+};
+
+// matches GPU_TERRAIN in Terrain.h
+layout (std140, binding = 3) uniform TerrainBlock
+{
+	vec4 morph[MAX_TERRAIN_LEVELS];
+	vec4 bounds;
+	vec4 textureMapping;
+	vec4 tileParameters;
+};
+
+layout (binding = 18) uniform sampler2DArray heightTiles;
+
+// the indirect renderer object the terrain is drawn as
+uniform int objectIndex;
+
+out vec3 fragmentPosition;
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+flat out int fragmentObjectIndex;
+#if LIGHTMAPPED
+out vec3 fragmentLightmapCoordinate;
+#endif
+
+// height at grid coordinates of the node; the tile has a one
+// sample border, so grid point 0 is texel 1
+float SampleHeight(vec2 grid, float layer)
+{
+	return texture(heightTiles, vec3((grid + 1.5) * tileParameters.x, layer)).r;
+}
+
+void main()
+{
+	TerrainInstance instance = instances[gl_BaseInstance + gl_InstanceID];
+	vec2 corner = instance.node.xy;
+	float spacing = instance.node.z;
+	int level = int(instance.node.w);
+	float layer = instance.tile.x;
+
+	// morph odd vertices onto the coarser grid as the distance
+	// nears the end of the level's range
+	vec2 grid = instance.tile.yz + inGridPosition;
+	vec2 position = corner + grid * spacing;
+	float height = SampleHeight(grid, layer);
+	float distanceToCamera = length(viewPosition.xyz - vec3(position.x, height, position.y));
+	float morphAmount = clamp((distanceToCamera - morph[level].x) * morph[level].y, 0.0, 1.0);
+	grid -= fract(grid * 0.5) * 2.0 * morphAmount;
+
+	// nodes on the edge can reach past the grounds
+	position = clamp(corner + grid * spacing, bounds.xy, bounds.zw);
+	grid = (position - corner) / spacing;
+	height = SampleHeight(grid, layer);
+
+	float heightLeft = SampleHeight(grid - vec2(1.0, 0.0), layer);
+	float heightRight = SampleHeight(grid + vec2(1.0, 0.0), layer);
+	float heightDown = SampleHeight(grid - vec2(0.0, 1.0), layer);
+	float heightUp = SampleHeight(grid + vec2(0.0, 1.0), layer);
+
+	vec4 worldPosition = vec4(position.x, height, position.y, 1.0);
+	fragmentPosition = worldPosition.xyz;
+	fragmentVertexNormal = normalize(vec3(heightLeft - heightRight, 2.0 * spacing, heightDown - heightUp));
+	// the same mapping as the flat ground plane had
+	vec2 textureCoordinate = vec2(position.x - textureMapping.x, textureMapping.y - position.y) * textureMapping.zw;
+#if VIRTUAL_TEXTURED
+	// the virtual texture covers the grounds once
+	fragmentTextureCoordinate = textureCoordinate;
+#else
+	fragmentTextureCoordinate = textureCoordinate * drawData[objectIndex].uvScale;
+#endif
+	fragmentObjectIndex = objectIndex;
+#if LIGHTMAPPED
+	// the terrain is one chart over the grounds, laid out like
+	// the texture coordinates
+	vec4 chart = lightmapCharts[drawData[objectIndex].lightmapChart];
+	fragmentLightmapCoordinate = vec3(chart.xy + clamp(textureCoordinate, 0.0, 1.0) * chart.zw,
+		float(drawData[objectIndex].lightmapLayer));
+#endif
+
+	gl_Position = projection * view * worldPosition;
+}
@@ -0,0 +1,41 @@
+///////////////////////////////////////////////////////////////////////////////
+// virtualtexturefeedbackfragmentshader.glsl
+// ============
+// fragment shader of the virtual texture feedback pass - writes the page
+// and level each pixel samples, for VirtualTexture to read back
+///////////////////////////////////////////////////////////////////////////////
+
+#version 460 core
+
+// matches GPU_VIRTUAL_TEXTURE in VirtualTexture.h
+layout (std140, binding = 2) uniform VirtualTextureBlock
+{
+	vec4 vtLayout;
+	vec4 vtPage;
+	vec4 vtPhysical;
+};
+
+// log2 of the feedback target's size relative to the scene's,
+// so the levels match what the scene samples
+uniform float feedbackBias;
+
+in vec2 fragmentTextureCoordinate;
+
+out vec4 outFeedback;
+
+void main()
+{
+	// same level selection as SampleVirtualTexture() in
+	// indirectFragmentShader.glsl, corrected for the target size
+	vec2 texel = fragmentTextureCoordinate * vtLayout.xy * vtPage.x;
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float level = floor(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + feedbackBias);
+	int mip = int(clamp(level, 0.0, vtLayout.z - 1.0));
+
+	vec2 uv = clamp(fragmentTextureCoordinate, vec2(0.0), vec2(0.99999));
+	ivec2 page = ivec2(uv * vec2(ivec2(vtLayout.xy) >> mip));
+
+	// r, g = page, b = level, a = 255 marks a written pixel
+	outFeedback = vec4(vec2(page), float(mip), 255.0) / 255.0;
+}
@@ -0,0 +1,45 @@
+///////////////////////////////////////////////////////////////////////////////
+// virtualtexturefeedbackvertexshader.glsl
+// ============
+// vertex shader of the virtual texture feedback pass; draws one object
+// of the indirect renderer's object data at a time
+///////////////////////////////////////////////////////////////////////////////
+
+#version 460 core
+
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 2) in vec2 inTextureCoordinate;
+
+// matches GPU_DRAW_DATA in IndirectRenderer.h
+struct DrawData
+{
+	mat4 model;
+	vec2 uvScale;
+	int textureSlot;
+	int materialIndex;
+	int lightmapChart;
+	int lightmapLayer;
+	int padding[2];
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer
+{
+	DrawData drawData[];
+};
+
+layout (std140, binding = 0) uniform CameraBlock
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPosition;
+};
+
+uniform int objectIndex;
+
+out vec2 fragmentTextureCoordinate;
+
+void main()
+{
+	fragmentTextureCoordinate = inTextureCoordinate;
+	gl_Position = projection * view * drawData[objectIndex].model * vec4(inVertexPosition, 1.0);
+}
@@ -0,0 +1,97 @@
+///////////////////////////////////////////////////////////////////////////////
+// allocationcounter.cpp
+// ============
+// count the heap allocations made by each thread
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AllocationCounter.h"
+
+#include <new>
+#include <cstdlib>
+
+// declaration of global variables
+namespace
+{
+	// operator new calls of the current thread
+	thread_local unsigned long long g_ThreadAllocations = 0;
+
+	/***********************************************************
+	 *  CountedAllocate()
+	 *
+	 *  Counts the allocation and takes the memory from
+	 *  malloc().  Returns NULL if there is none left.
+	 ***********************************************************/
+	void* CountedAllocate(size_t size)
+	{
+		g_ThreadAllocations++;
+		return(malloc((size > 0) ? size : 1));
+	}
+}
+
+/***********************************************************
+ *  GetThreadCount()
+ *
+ *  This method returns the number of operator new calls the
+ *  calling thread has made.
+ ***********************************************************/
+unsigned long long AllocationCounter::GetThreadCount()
+{
+	return(g_ThreadAllocations);
+}
+
+// replacements of the global allocation functions - every form
+// of new counts, every form of delete hands the memory back
+void* operator new(size_t size)
+{
+	void* pMemory = CountedAllocate(size);
+	if (NULL == pMemory)
+	{
+		throw std::bad_alloc();
+	}
+	return(pMemory);
+}
+
+void* operator new[](size_t size)
+{
+	return(operator new(size));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return(CountedAllocate(size));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return(CountedAllocate(size));
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory, const std::nothrow_t&) noexcept
+{
+	free(pMemory);
+}
+
+void operator delete[](void* pMemory, const std::nothrow_t&) noexcept
+{
+	free(pMemory);
+}
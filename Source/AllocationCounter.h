@@ -0,0 +1,29 @@
+///////////////////////////////////////////////////////////////////////////////
+// allocationcounter.h
+// ============
+// count the heap allocations made by each thread
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+/***********************************************************
+ *  AllocationCounter
+ *
+ *  The program's global operator new is replaced by one
+ *  that counts its calls per thread before going to
+ *  malloc(), so a thread can check that a piece of code -
+ *  such as drawing a frame - made no heap allocations:
+ *
+ *    unsigned long long before = AllocationCounter::GetThreadCount();
+ *    ...
+ *    bool bAllocationFree = (AllocationCounter::GetThreadCount() == before);
+ *
+ *  Only C++ allocations are seen; memory the driver or C
+ *  libraries take with malloc() directly is not.
+ ***********************************************************/
+class AllocationCounter
+{
+public:
+	// operator new calls made by the calling thread so far
+	static unsigned long long GetThreadCount();
+};
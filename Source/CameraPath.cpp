@@ -0,0 +1,389 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.cpp
+// ============
+// record the camera to a compact binary path file and play it back
+// with spline interpolation for reproducible benchmark runs
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraPath.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+// declaration of global variables
+namespace
+{
+	const char g_PathMagic[4] = { 'T', 'G', 'C', 'P' };
+	const uint32_t g_PathVersion = 1;
+	// bits of the keyframe flags byte
+	const uint8_t g_FlagOrthographic = 0x01;
+	// bytes of the header and of one keyframe in the file
+	const size_t g_HeaderSize = sizeof(g_PathMagic) + 2 * sizeof(uint32_t);
+	const size_t g_KeyframeSize = 8 * sizeof(float) + sizeof(uint8_t);
+
+	/***********************************************************
+	 *  Tangent()
+	 *
+	 *  Catmull-Rom tangent at keyframe i for unevenly spaced
+	 *  keyframes: the slope between its two neighbours, or a
+	 *  one-sided slope at either end of the path.
+	 ***********************************************************/
+	glm::vec4 Tangent(const glm::vec4* values, const float* times, size_t count, size_t i)
+	{
+		size_t previous = (i > 0) ? i - 1 : i;
+		size_t next = (i + 1 < count) ? i + 1 : i;
+		float span = times[next] - times[previous];
+
+		if (span <= 0.0f)
+		{
+			return(glm::vec4(0.0f));
+		}
+		return((values[next] - values[previous]) * (1.0f / span));
+	}
+
+	/***********************************************************
+	 *  Percentile()
+	 *
+	 *  Value below which the given fraction of the sorted
+	 *  samples fall.
+	 ***********************************************************/
+	double Percentile(const std::vector<double>& sorted, double fraction)
+	{
+		if (sorted.empty())
+			return(0.0);
+		size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+		return(sorted[std::min(index, sorted.size() - 1)]);
+	}
+}
+
+/***********************************************************
+ *  CameraPath()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraPath::CameraPath()
+{
+}
+
+/***********************************************************
+ *  AddKeyframe()
+ *
+ *  This method appends a keyframe to the end of the path.
+ ***********************************************************/
+void CameraPath::AddKeyframe(const CAMERA_KEYFRAME& keyframe)
+{
+	// keep the path ordered - a keyframe from the past is dropped
+	if ((m_keyframes.empty() == false) && (keyframe.time < m_keyframes.back().time))
+	{
+		return;
+	}
+	m_keyframes.push_back(keyframe);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method removes all keyframes.
+ ***********************************************************/
+void CameraPath::Clear()
+{
+	m_keyframes.clear();
+}
+
+/***********************************************************
+ *  Save()
+ *
+ *  This method writes the path to a binary file.  Fields are
+ *  written one at a time so no struct padding ends up in it.
+ ***********************************************************/
+bool CameraPath::Save(const char* filename) const
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Could not create camera path file:" << filename << std::endl;
+		return(false);
+	}
+
+	uint32_t count = (uint32_t)m_keyframes.size();
+	file.write(g_PathMagic, sizeof(g_PathMagic));
+	file.write((const char*)&g_PathVersion, sizeof(g_PathVersion));
+	file.write((const char*)&count, sizeof(count));
+
+	for (size_t i = 0; i < m_keyframes.size(); i++)
+	{
+		const CAMERA_KEYFRAME& keyframe = m_keyframes[i];
+		uint8_t flags = keyframe.bOrthographic ? g_FlagOrthographic : 0;
+
+		file.write((const char*)&keyframe.time, sizeof(float));
+		file.write((const char*)&keyframe.position.x, 3 * sizeof(float));
+		file.write((const char*)&keyframe.front.x, 3 * sizeof(float));
+		file.write((const char*)&keyframe.zoom, sizeof(float));
+		file.write((const char*)&flags, sizeof(flags));
+	}
+
+	return(file.good());
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method reads a path written by Save().
+ ***********************************************************/
+bool CameraPath::Load(const char* filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Could not open camera path file:" << filename << std::endl;
+		return(false);
+	}
+
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	char magic[4];
+	uint32_t version = 0;
+	uint32_t count = 0;
+	file.read(magic, sizeof(magic));
+	file.read((char*)&version, sizeof(version));
+	file.read((char*)&count, sizeof(count));
+
+	if (!file || (memcmp(magic, g_PathMagic, sizeof(magic)) != 0) || (version != g_PathVersion))
+	{
+		std::cout << "Not a camera path file (or wrong version):" << filename << std::endl;
+		return(false);
+	}
+
+	// the count is checked against the file before anything is
+	// reserved for it
+	if ((fileSize < (std::streamoff)g_HeaderSize) ||
+		((uint64_t)count > (uint64_t)(fileSize - g_HeaderSize) / g_KeyframeSize))
+	{
+		std::cout << "Camera path file is truncated:" << filename << std::endl;
+		return(false);
+	}
+
+	m_keyframes.clear();
+	m_keyframes.reserve(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		CAMERA_KEYFRAME keyframe;
+		uint8_t flags = 0;
+
+		file.read((char*)&keyframe.time, sizeof(float));
+		file.read((char*)&keyframe.position.x, 3 * sizeof(float));
+		file.read((char*)&keyframe.front.x, 3 * sizeof(float));
+		file.read((char*)&keyframe.zoom, sizeof(float));
+		file.read((char*)&flags, sizeof(flags));
+		if (!file)
+		{
+			std::cout << "Camera path file is truncated:" << filename << std::endl;
+			return(false);
+		}
+
+		keyframe.bOrthographic = (flags & g_FlagOrthographic) != 0;
+		AddKeyframe(keyframe);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Sample()
+ *
+ *  This method returns the camera at the given time.  The
+ *  position, front vector and zoom are interpolated with a
+ *  cubic Hermite spline using Catmull-Rom tangents; the
+ *  projection mode switches at the keyframe that changes it.
+ *  It runs every frame during playback, so it allocates
+ *  nothing.
+ ***********************************************************/
+bool CameraPath::Sample(float time, CAMERA_KEYFRAME& keyframe) const
+{
+	if (m_keyframes.empty())
+	{
+		return(false);
+	}
+
+	time = std::max(m_keyframes.front().time, time);
+	if (time >= m_keyframes.back().time)
+	{
+		keyframe = m_keyframes.back();
+		return(true);
+	}
+
+	// find the segment [i, i+1] that contains the time
+	size_t i = 0;
+	while ((i + 2 < m_keyframes.size()) && (m_keyframes[i + 1].time <= time))
+	{
+		i++;
+	}
+	keyframe = m_keyframes[i];
+	keyframe.time = time;
+
+	if ((i + 1 >= m_keyframes.size()) || (m_keyframes[i + 1].time <= m_keyframes[i].time))
+	{
+		return(true);
+	}
+
+	// the (up to) four keyframes around the segment, packed as
+	// position + zoom and front, in time order
+	size_t first = (i > 0) ? i - 1 : i;
+	size_t last = std::min(i + 2, m_keyframes.size() - 1);
+	glm::vec4 positions[4];
+	glm::vec4 fronts[4];
+	float times[4];
+	size_t count = 0;
+	for (size_t k = first; k <= last; k++)
+	{
+		positions[count] = glm::vec4(m_keyframes[k].position, m_keyframes[k].zoom);
+		fronts[count] = glm::vec4(m_keyframes[k].front, 0.0f);
+		times[count] = m_keyframes[k].time;
+		count++;
+	}
+	size_t a = i - first;
+	size_t b = a + 1;
+
+	float span = times[b] - times[a];
+	float s = (time - times[a]) / span;
+	float s2 = s * s;
+	float s3 = s2 * s;
+	float h00 = 2.0f * s3 - 3.0f * s2 + 1.0f;
+	float h10 = s3 - 2.0f * s2 + s;
+	float h01 = -2.0f * s3 + 3.0f * s2;
+	float h11 = s3 - s2;
+
+	glm::vec4 position =
+		positions[a] * h00 + Tangent(positions, times, count, a) * (h10 * span) +
+		positions[b] * h01 + Tangent(positions, times, count, b) * (h11 * span);
+	glm::vec4 front =
+		fronts[a] * h00 + Tangent(fronts, times, count, a) * (h10 * span) +
+		fronts[b] * h01 + Tangent(fronts, times, count, b) * (h11 * span);
+
+	keyframe.position = glm::vec3(position.x, position.y, position.z);
+	keyframe.zoom = position.w;
+	glm::vec3 direction = glm::vec3(front.x, front.y, front.z);
+	if (glm::length(direction) > 0.0001f)
+	{
+		keyframe.front = glm::normalize(direction);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetDuration()
+ *
+ *  This method returns the time of the last keyframe.
+ ***********************************************************/
+float CameraPath::GetDuration() const
+{
+	if (m_keyframes.empty())
+	{
+		return(0.0f);
+	}
+	return(m_keyframes.back().time);
+}
+
+/***********************************************************
+ *  FrameStatistics()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameStatistics::FrameStatistics()
+{
+}
+
+/***********************************************************
+ *  AddFrame()
+ *
+ *  This method records the timings of one rendered frame.
+ *  A GPU time of zero means it was not measured.
+ ***********************************************************/
+void FrameStatistics::AddFrame(unsigned long long frameIndex, double cpuTime, double gpuTime)
+{
+	FRAME_TIMING timing;
+	timing.frameIndex = frameIndex;
+	timing.cpuTime = cpuTime;
+	timing.gpuTime = gpuTime;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_frames.push_back(timing);
+}
+
+/***********************************************************
+ *  PrintReport()
+ *
+ *  This method prints a summary of the recorded frame times.
+ ***********************************************************/
+void FrameStatistics::PrintReport(const char* title) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_frames.empty())
+	{
+		std::cout << title << ": no frames recorded" << std::endl;
+		return;
+	}
+
+	std::vector<double> cpuTimes;
+	std::vector<double> gpuTimes;
+	double totalTime = 0.0;
+	for (size_t i = 0; i < m_frames.size(); i++)
+	{
+		cpuTimes.push_back(m_frames[i].cpuTime);
+		totalTime += m_frames[i].cpuTime;
+		if (m_frames[i].gpuTime > 0.0)
+			gpuTimes.push_back(m_frames[i].gpuTime);
+	}
+	std::sort(cpuTimes.begin(), cpuTimes.end());
+	std::sort(gpuTimes.begin(), gpuTimes.end());
+
+	std::cout << "\n" << title << "\n";
+	std::cout << "  frames:       " << m_frames.size() << "\n";
+	std::cout << "  average fps:  " << (1000.0 * m_frames.size() / totalTime) << "\n";
+	std::cout << "  frame ms:     min " << cpuTimes.front()
+		<< "  avg " << (totalTime / m_frames.size())
+		<< "  p50 " << Percentile(cpuTimes, 0.50)
+		<< "  p95 " << Percentile(cpuTimes, 0.95)
+		<< "  p99 " << Percentile(cpuTimes, 0.99)
+		<< "  max " << cpuTimes.back() << "\n";
+	if (gpuTimes.empty() == false)
+	{
+		std::cout << "  GPU ms:       p50 " << Percentile(gpuTimes, 0.50)
+			<< "  p95 " << Percentile(gpuTimes, 0.95)
+			<< "  max " << gpuTimes.back() << "\n";
+	}
+	std::cout << std::endl;
+}
+
+/***********************************************************
+ *  WriteCSV()
+ *
+ *  This method writes every frame timing to a CSV file for
+ *  comparing runs of different builds.
+ ***********************************************************/
+bool FrameStatistics::WriteCSV(const char* filename) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::ofstream file(filename);
+	if (!file)
+	{
+		std::cout << "Could not create statistics file:" << filename << std::endl;
+		return(false);
+	}
+
+	file << "frame,cpu_ms,gpu_ms\n";
+	for (size_t i = 0; i < m_frames.size(); i++)
+	{
+		file << m_frames[i].frameIndex << "," << m_frames[i].cpuTime << "," << m_frames[i].gpuTime << "\n";
+	}
+
+	return(file.good());
+}
@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.h
+// ============
+// record the camera to a compact binary path file and play it back
+// with spline interpolation for reproducible benchmark runs
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  CAMERA_KEYFRAME
+ *
+ *  The camera state that determines a rendered frame.
+ ***********************************************************/
+struct CAMERA_KEYFRAME
+{
+	// seconds since the start of the recording
+	float time;
+	glm::vec3 position;
+	glm::vec3 front;
+	// vertical field of view in degrees
+	float zoom;
+	// true = orthographic, false = perspective
+	bool bOrthographic;
+};
+
+/***********************************************************
+ *  CameraPath
+ *
+ *  A time-ordered list of camera keyframes.  Sample() returns
+ *  the camera at any time, interpolating position, direction
+ *  and zoom with a Catmull-Rom spline that accounts for the
+ *  uneven spacing of recorded keyframes.
+ *
+ *  File layout (little endian):
+ *    char[4]  "TGCP"
+ *    uint32   version
+ *    uint32   keyframe count
+ *    per keyframe: float time, float[3] position,
+ *                  float[3] front, float zoom, uint8 flags
+ ***********************************************************/
+class CameraPath
+{
+public:
+	// constructor
+	CameraPath();
+
+	// append a keyframe; times must not decrease
+	void AddKeyframe(const CAMERA_KEYFRAME& keyframe);
+	// remove all keyframes
+	void Clear();
+
+	// write the path to a binary file
+	bool Save(const char* filename) const;
+	// read the path from a binary file
+	bool Load(const char* filename);
+
+	// interpolated camera at the given time (clamped to the path)
+	bool Sample(float time, CAMERA_KEYFRAME& keyframe) const;
+
+	// time of the last keyframe
+	float GetDuration() const;
+	// number of keyframes
+	size_t GetKeyframeCount() const { return m_keyframes.size(); }
+
+private:
+	std::vector<CAMERA_KEYFRAME> m_keyframes;
+};
+
+/***********************************************************
+ *  FrameStatistics
+ *
+ *  Per-frame timings collected by the render thread during
+ *  playback, summarised at the end of the run.  Recording is
+ *  guarded by a mutex since it happens on another thread.
+ ***********************************************************/
+class FrameStatistics
+{
+public:
+	// constructor
+	FrameStatistics();
+
+	// render thread: add the times (in milliseconds) of one frame;
+	// the GPU time is the smoothed timer query value, 0 if unknown
+	void AddFrame(unsigned long long frameIndex, double cpuTime, double gpuTime);
+
+	// print min / average / percentiles / max to the console
+	void PrintReport(const char* title) const;
+	// write one line per frame to a CSV file
+	bool WriteCSV(const char* filename) const;
+
+private:
+	struct FRAME_TIMING
+	{
+		unsigned long long frameIndex;
+		double cpuTime;
+		double gpuTime;
+	};
+
+	mutable std::mutex m_mutex;
+	std::vector<FRAME_TIMING> m_frames;
+};
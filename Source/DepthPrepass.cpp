@@ -0,0 +1,533 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepass.cpp
+// ============
+// lay down the depth of the opaque objects with a position-only pass, so
+// the shading pass runs the lighting once per pixel, and decide from GPU
+// timings whether that pays for itself
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DepthPrepass.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// weight of a new frame time in the smoothed time of the
+	// mode in use
+	const double g_TimeSmoothing = 0.1;
+
+	/***********************************************************
+	 *  DepthOnlyVariant()
+	 *
+	 *  The depth-only shaders have no permutations; this is
+	 *  the one variant they are built as.
+	 ***********************************************************/
+	SHADER_VARIANT DepthOnlyVariant()
+	{
+		SHADER_VARIANT variant;
+		variant.bTextured = false;
+		variant.bVirtualTextured = false;
+		variant.bLit = false;
+		variant.bLightmapped = false;
+		variant.bAlphaTested = false;
+		variant.lightCount = 0;
+		return(variant);
+	}
+}
+
+/***********************************************************
+ *  DepthPrepass()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DepthPrepass::DepthPrepass(const DEPTH_PREPASS_SETTINGS& settings)
+{
+	m_settings = settings;
+	m_settings.probeFrames = std::max(m_settings.probeFrames, 1);
+	// a trial has to be read back before the next one starts
+	m_settings.probeInterval = std::max(m_settings.probeInterval, m_settings.probeFrames + 2 * QUERY_FRAMES);
+	m_pShaders = NULL;
+	m_program = 0;
+	m_pNewShaders = NULL;
+	m_newProgram = 0;
+	for (int i = 0; i < QUERY_FRAMES; i++)
+	{
+		m_queries[i].start = 0;
+		m_queries[i].end = 0;
+		m_queries[i].depthSamples = 0;
+		m_queries[i].shadedSamples = 0;
+		m_queries[i].bPrepass = false;
+		m_queries[i].bProbe = false;
+		m_queries[i].bPending = false;
+	}
+	m_queryIndex = 0;
+	m_bMeasuring = false;
+	m_bFramePrepass = false;
+
+	// start without the pre-pass and try it once the single
+	// pass has a few measured frames
+	m_bPrepassChosen = false;
+	for (int i = 0; i < 2; i++)
+	{
+		m_averageTime[i] = 0.0;
+		m_bTimeKnown[i] = false;
+		m_frames[i] = 0;
+		m_measuredFrames[i] = 0;
+		m_totalTime[i] = 0.0;
+	}
+	m_framesSinceProbe = m_settings.probeInterval - 2 * QUERY_FRAMES;
+	m_probeFramesLeft = 0;
+	m_probeIssued = 0;
+	m_probeTime = 0.0;
+	m_probeSamples = 0;
+	m_timeAfterProbe = 0.0;
+	m_switches = 0;
+	m_depthFragments = 0;
+	m_shadedFragments = 0;
+	m_singlePassFragments = 0;
+}
+
+/***********************************************************
+ *  ~DepthPrepass()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DepthPrepass::~DepthPrepass()
+{
+	PrintReport();
+	Destroy();
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings used unless the command
+ *  line changes them.
+ ***********************************************************/
+DEPTH_PREPASS_SETTINGS DepthPrepass::DefaultSettings()
+{
+	DEPTH_PREPASS_SETTINGS settings;
+	settings.mode = DEPTH_PREPASS_OFF;
+	settings.probeInterval = 120;
+	settings.probeFrames = 4;
+	settings.switchMargin = 0.05f;
+	settings.retestChange = 0.25f;
+	return(settings);
+}
+
+/***********************************************************
+ *  ModeName()
+ *
+ *  This method returns the command line name of a mode.
+ ***********************************************************/
+const char* DepthPrepass::ModeName(DEPTH_PREPASS_MODE mode)
+{
+	switch (mode)
+	{
+	case DEPTH_PREPASS_ON:
+		return("on");
+	case DEPTH_PREPASS_AUTO:
+		return("auto");
+	default:
+		return("off");
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method builds the depth-only program and creates
+ *  the queries.
+ ***********************************************************/
+bool DepthPrepass::Initialize(const char* vertexShaderFile, const char* fragmentShaderFile, const char* shaderCacheDirectory)
+{
+	Destroy();
+
+	m_vertexShaderFile = vertexShaderFile;
+	m_fragmentShaderFile = fragmentShaderFile;
+	m_shaderCacheDirectory = shaderCacheDirectory;
+	m_pShaders = new ShaderVariantCache(shaderCacheDirectory);
+	if (m_pShaders->LoadSources(vertexShaderFile, fragmentShaderFile))
+	{
+		m_program = m_pShaders->GetProgram(DepthOnlyVariant());
+	}
+	if (m_program == 0)
+	{
+		Destroy();
+		return(false);
+	}
+
+	for (int i = 0; i < QUERY_FRAMES; i++)
+	{
+		FRAME_QUERIES& queries = m_queries[i];
+		glGenQueries(1, &queries.start);
+		glGenQueries(1, &queries.end);
+		glGenQueries(1, &queries.depthSamples);
+		glGenQueries(1, &queries.shadedSamples);
+		queries.bPending = false;
+	}
+	m_queryIndex = 0;
+	return(true);
+}
+
+/***********************************************************
+ *  BuildShaders()
+ *
+ *  This method builds the program from the shader files
+ *  into a new cache, leaving the current one in use.
+ ***********************************************************/
+bool DepthPrepass::BuildShaders()
+{
+	DiscardShaders();
+	m_pNewShaders = new ShaderVariantCache(m_shaderCacheDirectory.c_str());
+	if (m_pNewShaders->LoadSources(m_vertexShaderFile.c_str(), m_fragmentShaderFile.c_str()))
+	{
+		m_newProgram = m_pNewShaders->GetProgram(DepthOnlyVariant());
+	}
+	if (m_newProgram == 0)
+	{
+		DiscardShaders();
+		std::cout << "Depth pre-pass shader reload failed - keeping the previous shaders" << std::endl;
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  ApplyShaders()
+ *
+ *  This method switches to the program of the last
+ *  BuildShaders(), if it built.
+ ***********************************************************/
+void DepthPrepass::ApplyShaders()
+{
+	if (m_newProgram == 0)
+	{
+		return;
+	}
+	delete m_pShaders;
+	m_pShaders = m_pNewShaders;
+	m_program = m_newProgram;
+	m_pNewShaders = NULL;
+	m_newProgram = 0;
+}
+
+/***********************************************************
+ *  DiscardShaders()
+ *
+ *  This method drops the program of the last BuildShaders()
+ *  and keeps the current one.
+ ***********************************************************/
+void DepthPrepass::DiscardShaders()
+{
+	delete m_pNewShaders;
+	m_pNewShaders = NULL;
+	m_newProgram = 0;
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method frees the program and the queries.
+ ***********************************************************/
+void DepthPrepass::Destroy()
+{
+	for (int i = 0; i < QUERY_FRAMES; i++)
+	{
+		FRAME_QUERIES& queries = m_queries[i];
+		if (queries.start != 0)
+		{
+			glDeleteQueries(1, &queries.start);
+			glDeleteQueries(1, &queries.end);
+			glDeleteQueries(1, &queries.depthSamples);
+			glDeleteQueries(1, &queries.shadedSamples);
+		}
+		queries.start = 0;
+		queries.end = 0;
+		queries.depthSamples = 0;
+		queries.shadedSamples = 0;
+		queries.bPending = false;
+	}
+	m_bMeasuring = false;
+
+	DiscardShaders();
+	delete m_pShaders;
+	m_pShaders = NULL;
+	m_program = 0;
+}
+
+/***********************************************************
+ *  BeginOpaque()
+ *
+ *  This method collects the finished frames, picks the mode
+ *  of this frame - starting a trial of the other mode in the
+ *  auto mode when one is due - and starts timing it unless
+ *  the queries of the slot are still in flight.
+ ***********************************************************/
+bool DepthPrepass::BeginOpaque()
+{
+	if (m_program == 0)
+	{
+		return(false);
+	}
+	ReadQueries();
+
+	bool bProbe = false;
+	bool bPrepass = (m_settings.mode == DEPTH_PREPASS_ON);
+	if (m_settings.mode == DEPTH_PREPASS_AUTO)
+	{
+		if (m_probeFramesLeft == 0)
+		{
+			m_framesSinceProbe++;
+			int chosen = m_bPrepassChosen ? 1 : 0;
+			bool bViewChanged = (m_timeAfterProbe > 0.0) && m_bTimeKnown[chosen] &&
+				(std::fabs(m_averageTime[chosen] - m_timeAfterProbe) > m_settings.retestChange * m_timeAfterProbe);
+			if ((m_framesSinceProbe >= m_settings.probeInterval) || bViewChanged)
+			{
+				m_probeFramesLeft = m_settings.probeFrames;
+				m_probeIssued = 0;
+				m_probeTime = 0.0;
+				m_probeSamples = 0;
+				m_framesSinceProbe = 0;
+				// no retest until this trial is read back
+				m_timeAfterProbe = 0.0;
+			}
+		}
+		bProbe = (m_probeFramesLeft > 0);
+		if (bProbe)
+		{
+			m_probeFramesLeft--;
+		}
+		bPrepass = bProbe ? !m_bPrepassChosen : m_bPrepassChosen;
+	}
+	m_bFramePrepass = bPrepass;
+	m_frames[bPrepass ? 1 : 0]++;
+
+	FRAME_QUERIES& queries = m_queries[m_queryIndex];
+	m_bMeasuring = !queries.bPending;
+	if (m_bMeasuring)
+	{
+		queries.bPrepass = bPrepass;
+		queries.bProbe = bProbe;
+		if (bProbe)
+		{
+			m_probeIssued++;
+		}
+		glQueryCounter(queries.start, GL_TIMESTAMP);
+	}
+	return(bPrepass);
+}
+
+/***********************************************************
+ *  DrawDepth()
+ *
+ *  This method draws the commands with the depth-only
+ *  program and color writes off.  The depth test is the
+ *  usual GL_LESS, so the fragments passing it are the ones a
+ *  single pass would have shaded.
+ ***********************************************************/
+void DepthPrepass::DrawDepth(GLuint positionVertexArray, GLenum indexType, GLsizei commandCount)
+{
+	FRAME_QUERIES& queries = m_queries[m_queryIndex];
+	if (m_bMeasuring)
+	{
+		glBeginQuery(GL_SAMPLES_PASSED, queries.depthSamples);
+	}
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glUseProgram(m_program);
+	glBindVertexArray(positionVertexArray);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)0, commandCount, 0);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	if (m_bMeasuring)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+}
+
+/***********************************************************
+ *  BeginShading()
+ *
+ *  This method sets up the depth test of the shading pass:
+ *  after the pre-pass only the surface that wrote the depth
+ *  passes, and the depth is already final.
+ ***********************************************************/
+void DepthPrepass::BeginShading()
+{
+	if (m_bFramePrepass)
+	{
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+	if (m_bMeasuring)
+	{
+		glBeginQuery(GL_SAMPLES_PASSED, m_queries[m_queryIndex].shadedSamples);
+	}
+}
+
+/***********************************************************
+ *  EndOpaque()
+ *
+ *  This method stops the queries of the frame and restores
+ *  the depth test for what is drawn next.
+ ***********************************************************/
+void DepthPrepass::EndOpaque()
+{
+	if (m_bMeasuring)
+	{
+		FRAME_QUERIES& queries = m_queries[m_queryIndex];
+		glEndQuery(GL_SAMPLES_PASSED);
+		glQueryCounter(queries.end, GL_TIMESTAMP);
+		queries.bPending = true;
+		m_queryIndex = (m_queryIndex + 1) % QUERY_FRAMES;
+		m_bMeasuring = false;
+	}
+
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+}
+
+/***********************************************************
+ *  ReadQueries()
+ *
+ *  This method collects every frame whose queries have all
+ *  finished, oldest first, into the report and the times of
+ *  the modes.
+ ***********************************************************/
+void DepthPrepass::ReadQueries()
+{
+	for (int i = 0; i < QUERY_FRAMES; i++)
+	{
+		int index = (m_queryIndex + i) % QUERY_FRAMES;
+		FRAME_QUERIES& queries = m_queries[index];
+		if (queries.bPending == false)
+			continue;
+
+		// the end timestamp is the last query of the frame
+		GLint available = 0;
+		glGetQueryObjectiv(queries.end, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0)
+			break;
+
+		GLuint64 start = 0;
+		GLuint64 end = 0;
+		GLuint64 shaded = 0;
+		glGetQueryObjectui64v(queries.start, GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(queries.end, GL_QUERY_RESULT, &end);
+		glGetQueryObjectui64v(queries.shadedSamples, GL_QUERY_RESULT, &shaded);
+		queries.bPending = false;
+
+		int mode = queries.bPrepass ? 1 : 0;
+		double time = (end > start) ? (end - start) / 1000000.0 : 0.0;
+		m_measuredFrames[mode]++;
+		m_totalTime[mode] += time;
+		if (queries.bPrepass)
+		{
+			GLuint64 depth = 0;
+			glGetQueryObjectui64v(queries.depthSamples, GL_QUERY_RESULT, &depth);
+			m_depthFragments += depth;
+			m_shadedFragments += shaded;
+		}
+		else
+		{
+			m_singlePassFragments += shaded;
+		}
+
+		AddSample(queries.bPrepass, queries.bProbe, time);
+	}
+}
+
+/***********************************************************
+ *  AddSample()
+ *
+ *  This method adds a frame time to the smoothed time of
+ *  its mode.  The frames of a trial are averaged on their
+ *  own; when the last one is in, the faster mode is chosen,
+ *  unless it is faster by less than the margin.
+ ***********************************************************/
+void DepthPrepass::AddSample(bool bPrepass, bool bProbe, double time)
+{
+	int mode = bPrepass ? 1 : 0;
+	if (!bProbe)
+	{
+		m_averageTime[mode] = m_bTimeKnown[mode] ?
+			m_averageTime[mode] + (time - m_averageTime[mode]) * g_TimeSmoothing : time;
+		m_bTimeKnown[mode] = true;
+		return;
+	}
+
+	m_probeTime += time;
+	m_probeSamples++;
+	if ((m_probeFramesLeft > 0) || (m_probeSamples < m_probeIssued))
+	{
+		return;
+	}
+
+	// the trial is complete
+	m_averageTime[mode] = m_probeTime / m_probeSamples;
+	m_bTimeKnown[mode] = true;
+	int chosen = m_bPrepassChosen ? 1 : 0;
+	if (m_bTimeKnown[chosen] &&
+		(m_averageTime[mode] < m_averageTime[chosen] * (1.0 - m_settings.switchMargin)))
+	{
+		m_bPrepassChosen = !m_bPrepassChosen;
+		m_switches++;
+		chosen = mode;
+	}
+	m_timeAfterProbe = m_bTimeKnown[chosen] ? m_averageTime[chosen] : 0.0;
+}
+
+/***********************************************************
+ *  PrintReport()
+ *
+ *  This method prints how often the pre-pass ran, the GPU
+ *  time of the opaque objects with and without it, and how
+ *  many fewer fragments were shaded with it.
+ ***********************************************************/
+void DepthPrepass::PrintReport() const
+{
+	unsigned long long frames = m_frames[0] + m_frames[1];
+	if (frames == 0)
+	{
+		return;
+	}
+
+	std::cout << "Depth pre-pass (" << ModeName(m_settings.mode) << "): used in " << m_frames[1]
+		<< " of " << frames << " frames";
+	if (m_settings.mode == DEPTH_PREPASS_AUTO)
+	{
+		std::cout << ", " << m_switches << " switches";
+	}
+	std::cout << std::endl;
+
+	if ((m_measuredFrames[0] + m_measuredFrames[1]) > 0)
+	{
+		std::cout << "Depth pre-pass: opaque objects took";
+		if (m_measuredFrames[1] > 0)
+		{
+			std::cout << " " << m_totalTime[1] / m_measuredFrames[1] << " ms with it";
+		}
+		if (m_measuredFrames[0] > 0)
+		{
+			std::cout << ((m_measuredFrames[1] > 0) ? "," : "") << " " << m_totalTime[0] / m_measuredFrames[0] << " ms without it";
+		}
+		std::cout << " per measured frame" << std::endl;
+	}
+
+	if ((m_measuredFrames[1] > 0) && (m_depthFragments > 0))
+	{
+		double single = (double)m_depthFragments / m_measuredFrames[1];
+		double shaded = (double)m_shadedFragments / m_measuredFrames[1];
+		std::cout << "Depth pre-pass: " << shaded << " instead of " << single
+			<< " fragments shaded per frame, " << 100.0 * (1.0 - shaded / single) << "% fewer" << std::endl;
+	}
+	if (m_measuredFrames[0] > 0)
+	{
+		std::cout << "Depth pre-pass: " << (double)m_singlePassFragments / m_measuredFrames[0]
+			<< " fragments shaded per frame without it" << std::endl;
+	}
+}
@@ -0,0 +1,188 @@
+///////////////////////////////////////////////////////////////////////////////
+// depthprepass.h
+// ============
+// lay down the depth of the opaque objects with a position-only pass, so
+// the shading pass runs the lighting once per pixel, and decide from GPU
+// timings whether that pays for itself
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderVariantCache.h"
+
+#include <string>
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  DEPTH_PREPASS_MODE
+ *
+ *  When the opaque objects get a depth pre-pass.
+ ***********************************************************/
+enum DEPTH_PREPASS_MODE
+{
+	// never - the opaque objects are shaded in one pass
+	DEPTH_PREPASS_OFF,
+	// every frame
+	DEPTH_PREPASS_ON,
+	// in the frames it is measured to make faster
+	DEPTH_PREPASS_AUTO
+};
+
+/***********************************************************
+ *  DEPTH_PREPASS_SETTINGS
+ *
+ *  Configuration of the pre-pass, filled from the command
+ *  line in main().
+ ***********************************************************/
+struct DEPTH_PREPASS_SETTINGS
+{
+	DEPTH_PREPASS_MODE mode;
+	// frames between trials of the mode not in use (auto)
+	int probeInterval;
+	// frames each trial runs
+	int probeFrames;
+	// fraction by which the other mode has to be faster before
+	// the choice changes, so measurement noise does not flip it
+	float switchMargin;
+	// change of the current mode's time, as a fraction, that
+	// starts a trial early - the view has changed
+	float retestChange;
+};
+
+/***********************************************************
+ *  DepthPrepass
+ *
+ *  Draws the opaque indirect commands with a position-only
+ *  vertex stream and a shader that writes depth alone, with
+ *  color writes off.  The shading pass after it tests with
+ *  GL_EQUAL and writes no depth, so every covered pixel runs
+ *  the multi-light fragment shader exactly once instead of
+ *  once per overlapping surface - which is where the hedges
+ *  and bushes seen at eye level spend their time.  The price
+ *  is transforming the opaque geometry twice.
+ *
+ *  Both passes are bracketed with GL_TIMESTAMP queries, and
+ *  each counts its fragments with a GL_SAMPLES_PASSED query:
+ *  the pre-pass, tested with GL_LESS in the same draw order,
+ *  passes exactly the fragments a single pass would shade,
+ *  and the equal-tested shading pass the ones it does shade,
+ *  so every pre-pass frame measures the reduction.  Results
+ *  are read a few frames late so the CPU never waits.
+ *
+ *  In the auto mode the pass times of both modes are kept:
+ *  the current mode is measured every frame, and every
+ *  probeInterval frames - or as soon as its time changes by
+ *  retestChange, which means the view has - the other mode
+ *  runs for probeFrames frames.  The faster one is then used
+ *  until the next trial, so a view into the hedges gets the
+ *  pre-pass and an open view does not.
+ *
+ *  All methods must be called on the thread that owns the GL
+ *  context (the render thread).
+ ***********************************************************/
+class DepthPrepass
+{
+public:
+	// constructor
+	DepthPrepass(const DEPTH_PREPASS_SETTINGS& settings);
+	// destructor - prints the report
+	~DepthPrepass();
+
+	// default settings: off; trials of 4 frames every 120, a 5%
+	// margin and a 25% change to retest
+	static DEPTH_PREPASS_SETTINGS DefaultSettings();
+	// name of a mode, for messages
+	static const char* ModeName(DEPTH_PREPASS_MODE mode);
+
+	// build the depth-only program and the queries
+	bool Initialize(const char* vertexShaderFile, const char* fragmentShaderFile, const char* shaderCacheDirectory);
+	// build the program from the shader files beside the
+	// current one; ApplyShaders() switches to it and
+	// DiscardShaders() drops it, so a reload can wait until
+	// every other program has built too
+	bool BuildShaders();
+	void ApplyShaders();
+	void DiscardShaders();
+	// free the GL objects
+	void Destroy();
+
+	// collect finished queries and decide whether this frame
+	// gets the pre-pass; call once per frame before the opaque
+	// objects are drawn
+	bool BeginOpaque();
+	// draw the depth of the first commandCount commands of the
+	// bound indirect buffer with the position-only stream
+	void DrawDepth(GLuint positionVertexArray, GLenum indexType, GLsizei commandCount);
+	// set the depth test of the shading pass and start counting
+	// its fragments
+	void BeginShading();
+	// stop counting and restore the depth test
+	void EndOpaque();
+
+private:
+	// the queries of one frame
+	struct FRAME_QUERIES
+	{
+		// GL_TIMESTAMP before the pre-pass and after the shading
+		GLuint start;
+		GLuint end;
+		// GL_SAMPLES_PASSED of the pre-pass and of the shading
+		GLuint depthSamples;
+		GLuint shadedSamples;
+		bool bPrepass;
+		bool bProbe;
+		bool bPending;
+	};
+
+	// number of frames of queries in flight
+	static const int QUERY_FRAMES = 4;
+
+	// collect the finished frames without stalling
+	void ReadQueries();
+	// add a frame's time to its mode, and end a trial
+	void AddSample(bool bPrepass, bool bProbe, double time);
+	void PrintReport() const;
+
+	DEPTH_PREPASS_SETTINGS m_settings;
+	ShaderVariantCache* m_pShaders;
+	GLuint m_program;
+	// built by BuildShaders() and not applied yet
+	ShaderVariantCache* m_pNewShaders;
+	GLuint m_newProgram;
+	std::string m_vertexShaderFile;
+	std::string m_fragmentShaderFile;
+	std::string m_shaderCacheDirectory;
+
+	FRAME_QUERIES m_queries[QUERY_FRAMES];
+	int m_queryIndex;
+	// true while the queries of the current frame are running
+	bool m_bMeasuring;
+	bool m_bFramePrepass;
+
+	// auto mode: the mode in use, the smoothed time of each
+	// (index 1 = with the pre-pass), the running trial and the
+	// time of the mode in use when the last trial ended
+	bool m_bPrepassChosen;
+	double m_averageTime[2];
+	bool m_bTimeKnown[2];
+	int m_framesSinceProbe;
+	int m_probeFramesLeft;
+	// trial frames whose queries were issued, and read back
+	int m_probeIssued;
+	double m_probeTime;
+	int m_probeSamples;
+	double m_timeAfterProbe;
+
+	// report
+	unsigned long long m_frames[2];
+	unsigned long long m_measuredFrames[2];
+	double m_totalTime[2];
+	unsigned long long m_switches;
+	// fragments of the measured pre-pass frames: what one pass
+	// would have shaded and what was shaded
+	unsigned long long m_depthFragments;
+	unsigned long long m_shadedFragments;
+	// fragments shaded in the measured frames without it
+	unsigned long long m_singlePassFragments;
+};
@@ -0,0 +1,290 @@
+///////////////////////////////////////////////////////////////////////////////
+// dynamicresolution.cpp
+// ============
+// render the scene into a scaled offscreen target whose size follows
+// the measured GPU frame time, then upscale it to the window
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DynamicResolution.h"
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// weight of the newest GPU time sample in the filtered time
+	const double g_FilterWeight = 0.2;
+	// no change is made while the GPU time is within this
+	// fraction of the target, which stops the scale hunting
+	const double g_DeadBand = 0.05;
+	// fraction of the estimated correction applied per update
+	const double g_Damping = 0.25;
+	// render sizes are rounded to multiples of this many pixels
+	const int g_SizeGranularity = 8;
+}
+
+/***********************************************************
+ *  DynamicResolution()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DynamicResolution::DynamicResolution(const DYNAMIC_RESOLUTION_SETTINGS& settings)
+{
+	m_settings = settings;
+	m_settings.minScale = std::max(0.1f, std::min(m_settings.minScale, 1.0f));
+	m_settings.maxScale = std::max(m_settings.minScale, std::min(m_settings.maxScale, 1.0f));
+
+	m_outputWidth = 0;
+	m_outputHeight = 0;
+	m_renderWidth = 0;
+	m_renderHeight = 0;
+	m_storageWidth = 0;
+	m_storageHeight = 0;
+	m_framebuffer = 0;
+	m_colorBuffer = 0;
+	m_depthBuffer = 0;
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		m_timerQueries[i] = 0;
+		m_bQueryPending[i] = false;
+	}
+	m_queryIndex = 0;
+
+	m_scale = m_settings.maxScale;
+	m_filteredGPUTime = m_settings.targetFrameTime;
+}
+
+/***********************************************************
+ *  ~DynamicResolution()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DynamicResolution::~DynamicResolution()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings used when nothing else
+ *  is given on the command line.
+ ***********************************************************/
+DYNAMIC_RESOLUTION_SETTINGS DynamicResolution::DefaultSettings()
+{
+	DYNAMIC_RESOLUTION_SETTINGS settings;
+	settings.bEnabled = false;
+	settings.targetFrameTime = 16.6f;
+	settings.minScale = 0.5f;
+	settings.maxScale = 1.0f;
+	return(settings);
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method creates the offscreen framebuffer at the
+ *  largest allowed scale and the ring of timer queries.
+ ***********************************************************/
+bool DynamicResolution::Initialize(int outputWidth, int outputHeight)
+{
+	Destroy();
+
+	m_outputWidth = outputWidth;
+	m_outputHeight = outputHeight;
+
+	m_storageWidth = (int)std::ceil(outputWidth * m_settings.maxScale);
+	m_storageHeight = (int)std::ceil(outputHeight * m_settings.maxScale);
+
+	glGenRenderbuffers(1, &m_colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_storageWidth, m_storageHeight);
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_storageWidth, m_storageHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Dynamic resolution framebuffer is incomplete: 0x" << std::hex << status << std::dec << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	glGenQueries(QUERY_COUNT, m_timerQueries);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Resize()
+ *
+ *  This method follows a resized window.  A smaller window
+ *  is drawn into the corner of the existing target; only a
+ *  larger one needs a new target.
+ ***********************************************************/
+bool DynamicResolution::Resize(int outputWidth, int outputHeight)
+{
+	if (((int)std::ceil(outputWidth * m_settings.maxScale) <= m_storageWidth) &&
+		((int)std::ceil(outputHeight * m_settings.maxScale) <= m_storageHeight))
+	{
+		m_outputWidth = outputWidth;
+		m_outputHeight = outputHeight;
+		return(true);
+	}
+	return(Initialize(outputWidth, outputHeight));
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method frees the framebuffer and the queries.
+ ***********************************************************/
+void DynamicResolution::Destroy()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (m_colorBuffer != 0)
+	{
+		glDeleteRenderbuffers(1, &m_colorBuffer);
+		m_colorBuffer = 0;
+	}
+	if (m_depthBuffer != 0)
+	{
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		m_depthBuffer = 0;
+	}
+	m_storageWidth = 0;
+	m_storageHeight = 0;
+	if (m_timerQueries[0] != 0)
+	{
+		glDeleteQueries(QUERY_COUNT, m_timerQueries);
+		for (int i = 0; i < QUERY_COUNT; i++)
+		{
+			m_timerQueries[i] = 0;
+			m_bQueryPending[i] = false;
+		}
+	}
+}
+
+/***********************************************************
+ *  BeginScene()
+ *
+ *  This method binds the offscreen target with a viewport at
+ *  the current scale, clears it and starts the timer query.
+ ***********************************************************/
+void DynamicResolution::BeginScene()
+{
+	ReadTimerQueries();
+
+	// round to a pixel granularity so tiny scale changes do
+	// not show up as a constantly shimmering image
+	m_renderWidth = (int)(m_outputWidth * m_scale) / g_SizeGranularity * g_SizeGranularity;
+	m_renderHeight = (int)(m_outputHeight * m_scale) / g_SizeGranularity * g_SizeGranularity;
+	m_renderWidth = std::max(m_renderWidth, g_SizeGranularity);
+	m_renderHeight = std::max(m_renderHeight, g_SizeGranularity);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_renderWidth, m_renderHeight);
+
+	// start timing unless the query in this slot is still in flight
+	if (m_bQueryPending[m_queryIndex] == false)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, m_timerQueries[m_queryIndex]);
+	}
+}
+
+/***********************************************************
+ *  EndScene()
+ *
+ *  This method stops the timer query and upscales the scene
+ *  region of the offscreen target to the whole window with a
+ *  bilinear-filtered blit.
+ ***********************************************************/
+void DynamicResolution::EndScene()
+{
+	if (m_bQueryPending[m_queryIndex] == false)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		m_bQueryPending[m_queryIndex] = true;
+		m_queryIndex = (m_queryIndex + 1) % QUERY_COUNT;
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(
+		0, 0, m_renderWidth, m_renderHeight,
+		0, 0, m_outputWidth, m_outputHeight,
+		GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_outputWidth, m_outputHeight);
+}
+
+/***********************************************************
+ *  ReadTimerQueries()
+ *
+ *  This method collects every timer query whose result is
+ *  already available and feeds it to the controller.
+ ***********************************************************/
+void DynamicResolution::ReadTimerQueries()
+{
+	for (int i = 0; i < QUERY_COUNT; i++)
+	{
+		// oldest first, so samples arrive in submission order
+		int index = (m_queryIndex + i) % QUERY_COUNT;
+		if (m_bQueryPending[index] == false)
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(m_timerQueries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0)
+			break;
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(m_timerQueries[index], GL_QUERY_RESULT, &elapsed);
+		m_bQueryPending[index] = false;
+
+		UpdateScale(elapsed / 1000000.0);
+	}
+}
+
+/***********************************************************
+ *  UpdateScale()
+ *
+ *  This method adjusts the resolution scale from a GPU time
+ *  sample.  The shading cost grows with the pixel count,
+ *  which is the square of the per-axis scale, so the scale
+ *  that would hit the target is scale * sqrt(target / time).
+ *  Only part of that correction is applied each time.
+ ***********************************************************/
+void DynamicResolution::UpdateScale(double gpuTime)
+{
+	m_filteredGPUTime += (gpuTime - m_filteredGPUTime) * g_FilterWeight;
+
+	double target = m_settings.targetFrameTime;
+	double error = (m_filteredGPUTime - target) / target;
+	if (std::fabs(error) < g_DeadBand)
+	{
+		return;
+	}
+
+	double idealScale = m_scale * std::sqrt(target / std::max(m_filteredGPUTime, 0.01));
+	double newScale = m_scale + (idealScale - m_scale) * g_Damping;
+
+	m_scale = (float)std::max((double)m_settings.minScale,
+		std::min(newScale, (double)m_settings.maxScale));
+}
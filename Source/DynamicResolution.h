@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// dynamicresolution.h
+// ============
+// render the scene into a scaled offscreen target whose size follows
+// the measured GPU frame time, then upscale it to the window
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  DYNAMIC_RESOLUTION_SETTINGS
+ *
+ *  Configuration of the resolution controller, filled from
+ *  the command line in main().
+ ***********************************************************/
+struct DYNAMIC_RESOLUTION_SETTINGS
+{
+	// false = draw straight into the window at full size
+	bool bEnabled;
+	// GPU time (in milliseconds) the scene should take per frame
+	float targetFrameTime;
+	// bounds of the per-axis resolution scale
+	float minScale;
+	float maxScale;
+};
+
+/***********************************************************
+ *  DynamicResolution
+ *
+ *  This class owns an offscreen framebuffer sized for the
+ *  largest allowed scale.  Each frame the scene is drawn into
+ *  the bottom-left corner of it at the current scale, timed
+ *  with a GL_TIME_ELAPSED query, and blitted with linear
+ *  filtering to the default framebuffer.  Query results are
+ *  read a few frames late so the CPU never waits on the GPU.
+ *
+ *  All methods must be called on the thread that owns the GL
+ *  context (the render thread).
+ ***********************************************************/
+class DynamicResolution
+{
+public:
+	// constructor
+	DynamicResolution(const DYNAMIC_RESOLUTION_SETTINGS& settings);
+	// destructor
+	~DynamicResolution();
+
+	// default settings: disabled, 16.6 ms target, 50%-100% scale
+	static DYNAMIC_RESOLUTION_SETTINGS DefaultSettings();
+
+	// create the offscreen target for a window of the given size
+	bool Initialize(int outputWidth, int outputHeight);
+	// follow a resized window; the target is only created again
+	// when the new size does not fit in it
+	bool Resize(int outputWidth, int outputHeight);
+	// free the GL objects
+	void Destroy();
+
+	// bind the offscreen target at the current scale and start timing
+	void BeginScene();
+	// stop timing, update the scale and upscale to the window
+	void EndScene();
+
+	// current per-axis resolution scale
+	float GetScale() const { return m_scale; }
+	// smoothed GPU time of the scene in milliseconds
+	double GetGPUFrameTime() const { return m_filteredGPUTime; }
+	// size the scene is currently rendered at
+	int GetRenderWidth() const { return m_renderWidth; }
+	int GetRenderHeight() const { return m_renderHeight; }
+	// size of the window the scene is upscaled to
+	int GetOutputWidth() const { return m_outputWidth; }
+	int GetOutputHeight() const { return m_outputHeight; }
+
+private:
+	// number of timer queries in flight
+	static const int QUERY_COUNT = 4;
+
+	// collect any finished timer queries without stalling
+	void ReadTimerQueries();
+	// move the scale towards the target GPU time
+	void UpdateScale(double gpuTime);
+
+	DYNAMIC_RESOLUTION_SETTINGS m_settings;
+
+	// size of the window the scene is upscaled to
+	int m_outputWidth;
+	int m_outputHeight;
+	// size the scene is rendered at this frame
+	int m_renderWidth;
+	int m_renderHeight;
+	// size of the offscreen target's storage
+	int m_storageWidth;
+	int m_storageHeight;
+
+	// offscreen framebuffer and its attachments
+	GLuint m_framebuffer;
+	GLuint m_colorBuffer;
+	GLuint m_depthBuffer;
+
+	// ring of GL_TIME_ELAPSED queries
+	GLuint m_timerQueries[QUERY_COUNT];
+	bool m_bQueryPending[QUERY_COUNT];
+	int m_queryIndex;
+
+	// current scale and smoothed GPU time
+	float m_scale;
+	double m_filteredGPUTime;
+};
@@ -0,0 +1,226 @@
+///////////////////////////////////////////////////////////////////////////////
+// entitybenchmark.cpp
+// ============
+// compare the entity store against an array of structs baseline
+///////////////////////////////////////////////////////////////////////////////
+
+#include "EntityBenchmark.h"
+#include "EntityStore.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include <glm/gtx/transform.hpp>
+
+// declaration of global variables
+namespace
+{
+	// timed runs of each system, after one warm-up run
+	const int g_BenchmarkRuns = 25;
+	// side length of the square the entities are scattered over
+	const float g_FieldSize = 1000.0f;
+	// frame arena of the SoA runs - a visible list and culling
+	// results for every entity fit
+	const size_t g_BenchmarkArenaSize = 8 * 1024 * 1024;
+
+	// baseline: one struct per object, as the scene objects were
+	// stored before the entity store
+	struct AOS_RENDERABLE
+	{
+		std::string name;
+		SCENE_MESH mesh;
+		glm::mat4 model;
+		std::string textureTag;
+		std::string materialTag;
+		glm::vec2 uvScale;
+		bool bPerspectiveOnly;
+		glm::vec3 boundsCenter;
+		float boundsRadius;
+		int32_t materialIndex;
+		int32_t textureSlot;
+		uint32_t drawIndex;
+	};
+
+	/***********************************************************
+	 *  SphereInFrustum()
+	 *
+	 *  True if a sphere is at least partly inside the frustum.
+	 ***********************************************************/
+	bool SphereInFrustum(const glm::vec4 planes[6], const glm::vec3& center, float radius)
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+
+	/***********************************************************
+	 *  TimeRuns()
+	 *
+	 *  Runs a system once to warm up, then g_BenchmarkRuns
+	 *  times, and returns the fastest run in milliseconds.
+	 ***********************************************************/
+	template <typename SYSTEM>
+	double TimeRuns(SYSTEM system)
+	{
+		system();
+		double best = 1.0e30;
+		for (int run = 0; run < g_BenchmarkRuns; run++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			system();
+			double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = std::min(best, elapsed);
+		}
+		return(best);
+	}
+
+	/***********************************************************
+	 *  PrintResult()
+	 *
+	 *  Prints the timings of one system for both layouts.
+	 ***********************************************************/
+	void PrintResult(const char* system, double aosTime, double soaTime, size_t entityCount)
+	{
+		std::cout << "  " << system << ": AoS " << aosTime << " ms ("
+			<< (aosTime * 1.0e6 / entityCount) << " ns/entity), SoA " << soaTime << " ms ("
+			<< (soaTime * 1.0e6 / entityCount) << " ns/entity), "
+			<< (aosTime / std::max(soaTime, 1.0e-9)) << "x" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method fills both layouts with the same random
+ *  entities - boxes, spheres and bushes scattered over a
+ *  large field in front of the camera - and times the
+ *  systems on each.  The visible counts of both layouts are
+ *  compared to make sure they did the same work.
+ ***********************************************************/
+bool EntityBenchmark::Run(size_t entityCount)
+{
+	std::cout << "Entity benchmark: " << entityCount << " entities, best of " << g_BenchmarkRuns << " runs" << std::endl;
+
+	std::mt19937 random(12345);
+	std::uniform_real_distribution<float> position(-0.5f * g_FieldSize, 0.5f * g_FieldSize);
+	std::uniform_real_distribution<float> size(0.5f, 4.0f);
+
+	EntityStore store;
+	std::vector<AOS_RENDERABLE> objects(entityCount);
+	for (size_t i = 0; i < entityCount; i++)
+	{
+		glm::vec3 center(position(random), 0.0f, position(random));
+		float radius = size(random);
+		SCENE_MESH mesh = (SCENE_MESH)(i % MESH_COUNT);
+		glm::mat4 model = glm::translate(center) * glm::scale(glm::vec3(radius));
+
+		AOS_RENDERABLE& object = objects[i];
+		object.name = "Entity " + std::to_string(i);
+		object.mesh = mesh;
+		object.model = model;
+		object.textureTag = "Leaves2";
+		object.materialTag = "TrimmedFoliage";
+		object.uvScale = glm::vec2(1.0f);
+		object.bPerspectiveOnly = (mesh == MESH_PLANE);
+		object.boundsCenter = center;
+		object.boundsRadius = radius;
+		object.materialIndex = 2;
+		object.textureSlot = 1;
+		object.drawIndex = (uint32_t)i;
+
+		ENTITY entity = store.Create();
+		store.SetTransform(entity, model);
+		store.SetBounds(entity, center, radius);
+		store.SetMesh(entity, mesh);
+		store.SetMaterial(entity, 2, 1);
+		store.SetVisibility(entity, object.bPerspectiveOnly ? ENTITY_PERSPECTIVE_ONLY : 0);
+		store.SetDrawIndex(entity, (uint32_t)i);
+	}
+
+	// a camera at the edge of the field looking across it, in the
+	// orthographic mode so the perspective-only flag is tested too
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 0.5f * g_FieldSize), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, g_FieldSize);
+	glm::vec4 planes[6];
+	EntityStore::ExtractFrustumPlanes(projection * view, planes);
+	const uint8_t hiddenFlags = ENTITY_PERSPECTIVE_ONLY;
+
+	// the AoS runs keep their lists in vectors, as the scene did;
+	// the SoA runs take them from a frame arena
+	std::vector<uint32_t> aosVisible;
+	std::vector<uint32_t> aosDraws;
+	aosVisible.reserve(entityCount);
+	aosDraws.reserve(entityCount);
+	FrameArena cullArena(g_BenchmarkArenaSize);
+	FrameArena buildArena(g_BenchmarkArenaSize);
+	const uint32_t* soaVisible = NULL;
+	size_t soaVisibleCount = 0;
+	uint32_t* soaDraws = NULL;
+
+	// culling system
+	double aosCull = TimeRuns([&]()
+	{
+		aosVisible.clear();
+		for (size_t i = 0; i < objects.size(); i++)
+		{
+			const AOS_RENDERABLE& object = objects[i];
+			if (object.bPerspectiveOnly)
+				continue;
+			if (SphereInFrustum(planes, object.boundsCenter, object.boundsRadius))
+				aosVisible.push_back((uint32_t)i);
+		}
+	});
+	double soaCull = TimeRuns([&]()
+	{
+		cullArena.Reset();
+		soaVisible = store.CollectVisible(planes, hiddenFlags, cullArena, soaVisibleCount);
+	});
+
+	// draw building system - a sort key of mesh and object per
+	// visible entity, as the indirect renderer batches them
+	double aosBuild = TimeRuns([&]()
+	{
+		aosDraws.clear();
+		for (size_t i = 0; i < aosVisible.size(); i++)
+		{
+			const AOS_RENDERABLE& object = objects[aosVisible[i]];
+			aosDraws.push_back(((uint32_t)object.mesh << 24) | object.drawIndex);
+		}
+	});
+	double soaBuild = TimeRuns([&]()
+	{
+		const uint8_t* meshes = store.GetMeshes();
+		const uint32_t* drawIndices = store.GetDrawIndices();
+		buildArena.Reset();
+		soaDraws = buildArena.AllocateArray<uint32_t>(soaVisibleCount);
+		for (size_t i = 0; i < soaVisibleCount; i++)
+		{
+			uint32_t entity = soaVisible[i];
+			soaDraws[i] = ((uint32_t)meshes[entity] << 24) | drawIndices[entity];
+		}
+	});
+
+	PrintResult("culling", aosCull, soaCull, entityCount);
+	PrintResult("draw building", aosBuild, soaBuild, entityCount);
+	PrintResult("frame total", aosCull + aosBuild, soaCull + soaBuild, entityCount);
+	std::cout << "  visible: " << soaVisibleCount << " of " << entityCount
+		<< ", AoS struct " << sizeof(AOS_RENDERABLE) << " bytes, culling reads "
+		<< (4 * sizeof(float) + sizeof(uint8_t)) << " bytes per entity from the store" << std::endl;
+
+	if ((aosVisible != std::vector<uint32_t>(soaVisible, soaVisible + soaVisibleCount)) ||
+		(aosDraws != std::vector<uint32_t>(soaDraws, soaDraws + soaVisibleCount)))
+	{
+		std::cout << "Entity benchmark: the layouts disagree on the visible entities" << std::endl;
+		return(false);
+	}
+	return(true);
+}
@@ -0,0 +1,26 @@
+///////////////////////////////////////////////////////////////////////////////
+// entitybenchmark.h
+// ============
+// compare the entity store against an array of structs baseline
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+
+/***********************************************************
+ *  EntityBenchmark
+ *
+ *  Runs the per-frame systems - frustum culling and draw
+ *  building - over a large synthetic scene, once on the
+ *  structure-of-arrays EntityStore and once on an array of
+ *  scene-object structs laid out the way the scene objects
+ *  used to be, and prints the timings of both.  Needs no
+ *  window or GL context.
+ ***********************************************************/
+class EntityBenchmark
+{
+public:
+	// run the benchmark with this many entities
+	static bool Run(size_t entityCount);
+};
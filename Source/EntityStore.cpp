@@ -0,0 +1,265 @@
+///////////////////////////////////////////////////////////////////////////////
+// entitystore.cpp
+// ============
+// structure-of-arrays storage of the renderable entities of the scene
+///////////////////////////////////////////////////////////////////////////////
+
+#include "EntityStore.h"
+
+/***********************************************************
+ *  EntityStore()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+EntityStore::EntityStore()
+{
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method appends an entity to every column and hands
+ *  out a handle, reusing the slot of a destroyed entity
+ *  with the next generation if there is one.
+ ***********************************************************/
+ENTITY EntityStore::Create()
+{
+	uint32_t slot = 0;
+	if (!m_freeSlots.empty())
+	{
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else
+	{
+		slot = (uint32_t)m_slotDense.size();
+		m_slotDense.push_back(0);
+		m_slotGenerations.push_back(0);
+	}
+
+	ENTITY entity = slot | ((uint32_t)m_slotGenerations[slot] << SLOT_BITS);
+	m_slotDense[slot] = (uint32_t)m_entities.size();
+
+	m_transforms.push_back(glm::mat4(1.0f));
+	m_boundsX.push_back(0.0f);
+	m_boundsY.push_back(0.0f);
+	m_boundsZ.push_back(0.0f);
+	m_boundsRadius.push_back(0.0f);
+	m_meshes.push_back((uint8_t)MESH_BOX);
+	m_materialIndices.push_back(-1);
+	m_textureSlots.push_back(-1);
+	m_visibility.push_back(0);
+	m_drawIndices.push_back(0);
+	m_entities.push_back(entity);
+
+	return(entity);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method moves the last entity into the place of the
+ *  destroyed one and retires the handle.
+ ***********************************************************/
+void EntityStore::Destroy(ENTITY entity)
+{
+	if (!IsAlive(entity))
+	{
+		return;
+	}
+
+	uint32_t slot = entity & SLOT_MASK;
+	size_t dense = m_slotDense[slot];
+	size_t last = m_entities.size() - 1;
+
+	if (dense != last)
+	{
+		m_transforms[dense] = m_transforms[last];
+		m_boundsX[dense] = m_boundsX[last];
+		m_boundsY[dense] = m_boundsY[last];
+		m_boundsZ[dense] = m_boundsZ[last];
+		m_boundsRadius[dense] = m_boundsRadius[last];
+		m_meshes[dense] = m_meshes[last];
+		m_materialIndices[dense] = m_materialIndices[last];
+		m_textureSlots[dense] = m_textureSlots[last];
+		m_visibility[dense] = m_visibility[last];
+		m_drawIndices[dense] = m_drawIndices[last];
+		m_entities[dense] = m_entities[last];
+		m_slotDense[m_entities[dense] & SLOT_MASK] = (uint32_t)dense;
+	}
+
+	m_transforms.pop_back();
+	m_boundsX.pop_back();
+	m_boundsY.pop_back();
+	m_boundsZ.pop_back();
+	m_boundsRadius.pop_back();
+	m_meshes.pop_back();
+	m_materialIndices.pop_back();
+	m_textureSlots.pop_back();
+	m_visibility.pop_back();
+	m_drawIndices.pop_back();
+	m_entities.pop_back();
+
+	m_slotGenerations[slot]++;
+	m_freeSlots.push_back(slot);
+}
+
+/***********************************************************
+ *  IsAlive()
+ *
+ *  This method checks that a handle refers to a live
+ *  entity and not to a destroyed one whose slot was reused.
+ ***********************************************************/
+bool EntityStore::IsAlive(ENTITY entity) const
+{
+	uint32_t slot = entity & SLOT_MASK;
+	return((entity != INVALID_ENTITY) && (slot < m_slotDense.size()) &&
+		(m_slotGenerations[slot] == (uint8_t)(entity >> SLOT_BITS)) &&
+		(m_slotDense[slot] < m_entities.size()) && (m_entities[m_slotDense[slot]] == entity));
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method destroys all entities.  All handles handed
+ *  out so far become invalid.
+ ***********************************************************/
+void EntityStore::Clear()
+{
+	for (size_t i = 0; i < m_entities.size(); i++)
+	{
+		uint32_t slot = m_entities[i] & SLOT_MASK;
+		m_slotGenerations[slot]++;
+		m_freeSlots.push_back(slot);
+	}
+
+	m_transforms.clear();
+	m_boundsX.clear();
+	m_boundsY.clear();
+	m_boundsZ.clear();
+	m_boundsRadius.clear();
+	m_meshes.clear();
+	m_materialIndices.clear();
+	m_textureSlots.clear();
+	m_visibility.clear();
+	m_drawIndices.clear();
+	m_entities.clear();
+}
+
+/***********************************************************
+ *  Component setters
+ ***********************************************************/
+void EntityStore::SetTransform(ENTITY entity, const glm::mat4& model)
+{
+	m_transforms[GetDenseIndex(entity)] = model;
+}
+
+void EntityStore::SetBounds(ENTITY entity, const glm::vec3& center, float radius)
+{
+	size_t dense = GetDenseIndex(entity);
+	m_boundsX[dense] = center.x;
+	m_boundsY[dense] = center.y;
+	m_boundsZ[dense] = center.z;
+	m_boundsRadius[dense] = radius;
+}
+
+void EntityStore::SetMesh(ENTITY entity, SCENE_MESH mesh)
+{
+	m_meshes[GetDenseIndex(entity)] = (uint8_t)mesh;
+}
+
+void EntityStore::SetMaterial(ENTITY entity, int32_t materialIndex, int32_t textureSlot)
+{
+	size_t dense = GetDenseIndex(entity);
+	m_materialIndices[dense] = materialIndex;
+	m_textureSlots[dense] = textureSlot;
+}
+
+void EntityStore::SetVisibility(ENTITY entity, uint8_t flags)
+{
+	m_visibility[GetDenseIndex(entity)] = flags;
+}
+
+void EntityStore::SetDrawIndex(ENTITY entity, uint32_t drawIndex)
+{
+	m_drawIndices[GetDenseIndex(entity)] = drawIndex;
+}
+
+/***********************************************************
+ *  CollectVisible()
+ *
+ *  This method is the culling system.  The first pass tests
+ *  every bounding sphere against the six planes without a
+ *  branch, reading only the bounds and visibility columns,
+ *  so the compiler can vectorize it; the second pass
+ *  gathers the indices that passed.  Both the results and
+ *  the indices live in the frame arena.
+ ***********************************************************/
+const uint32_t* EntityStore::CollectVisible(const glm::vec4 planes[6], uint8_t hiddenFlags, FrameArena& arena, size_t& visibleCount) const
+{
+	size_t count = m_entities.size();
+	uint8_t* results = arena.AllocateArray<uint8_t>(count);
+	uint32_t* visible = arena.AllocateArray<uint32_t>(count);
+
+	float planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = planes[p].x;
+		planeY[p] = planes[p].y;
+		planeZ[p] = planes[p].z;
+		planeW[p] = planes[p].w;
+	}
+
+	const float* boundsX = m_boundsX.data();
+	const float* boundsY = m_boundsY.data();
+	const float* boundsZ = m_boundsZ.data();
+	const float* boundsRadius = m_boundsRadius.data();
+	const uint8_t* visibility = m_visibility.data();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		int inside = ((visibility[i] & hiddenFlags) == 0) ? 1 : 0;
+		for (int p = 0; p < 6; p++)
+		{
+			float distance = planeX[p] * boundsX[i] + planeY[p] * boundsY[i] + planeZ[p] * boundsZ[i] + planeW[p];
+			inside &= (distance >= -boundsRadius[i]) ? 1 : 0;
+		}
+		results[i] = (uint8_t)inside;
+	}
+
+	// every index is written and the end only moves past the
+	// ones that passed, so there is no branch to mispredict
+	visibleCount = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		visible[visibleCount] = (uint32_t)i;
+		visibleCount += results[i];
+	}
+	return(visible);
+}
+
+/***********************************************************
+ *  ExtractFrustumPlanes()
+ *
+ *  Planes of the view frustum from the combined projection
+ *  and view matrix (Gribb / Hartmann), normalized so the
+ *  distances can be compared to a radius.
+ ***********************************************************/
+void EntityStore::ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+	glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	planes[0] = row3 + row0;
+	planes[1] = row3 - row0;
+	planes[2] = row3 + row1;
+	planes[3] = row3 - row1;
+	planes[4] = row3 + row2;
+	planes[5] = row3 - row2;
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////////
+// entitystore.h
+// ============
+// structure-of-arrays storage of the renderable entities of the scene
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshGenerator.h"
+#include "FrameArena.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  AlignedAllocator
+ *
+ *  Allocator for std::vector that starts every array on a
+ *  64 byte (cache line) boundary, so a system streaming
+ *  through a column never splits its first line and SIMD
+ *  loads of the float columns are aligned.
+ ***********************************************************/
+template <typename T>
+class AlignedAllocator
+{
+public:
+	typedef T value_type;
+	enum { ALIGNMENT = 64 };
+
+	AlignedAllocator() {}
+	template <typename U> AlignedAllocator(const AlignedAllocator<U>&) {}
+
+	T* allocate(size_t count)
+	{
+		// room for the alignment and the pointer to free
+		char* block = (char*)::operator new(count * sizeof(T) + ALIGNMENT + sizeof(void*));
+		uintptr_t aligned = ((uintptr_t)(block + sizeof(void*)) + ALIGNMENT - 1) & ~(uintptr_t)(ALIGNMENT - 1);
+		((void**)aligned)[-1] = block;
+		return((T*)aligned);
+	}
+
+	void deallocate(T* pointer, size_t)
+	{
+		::operator delete(((void**)pointer)[-1]);
+	}
+
+	template <typename U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+	template <typename U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+// stable handle of an entity: slot index in the low 24 bits and
+// the generation of the slot in the high 8 bits
+typedef uint32_t ENTITY;
+const ENTITY INVALID_ENTITY = 0xFFFFFFFFu;
+
+// visibility flags of an entity
+enum ENTITY_VISIBILITY
+{
+	// only drawn in the perspective view
+	ENTITY_PERSPECTIVE_ONLY = 1,
+	// never drawn
+	ENTITY_HIDDEN = 2,
+	// culled and drawn on the GPU, so the CPU culling skips it
+	ENTITY_GPU_CULLED = 4
+};
+
+/***********************************************************
+ *  EntityStore
+ *
+ *  Renderable entities with their components - transform,
+ *  bounding sphere, mesh, material and visibility - each in
+ *  its own dense array, so a system reads exactly the
+ *  columns it needs: culling streams through the four bounds
+ *  floats and the visibility bytes and never touches a
+ *  matrix.  Dense index i of every column belongs to the
+ *  same entity.
+ *
+ *  Handles stay valid while other entities come and go; a
+ *  destroyed entity's place is filled by the last one, which
+ *  keeps the columns dense.  The draw index of an entity is
+ *  the index of its per-object data on the GPU.
+ ***********************************************************/
+class EntityStore
+{
+public:
+	template <typename T>
+	struct COLUMN
+	{
+		typedef std::vector<T, AlignedAllocator<T> > type;
+	};
+
+	// constructor
+	EntityStore();
+
+	// create an entity with default components
+	ENTITY Create();
+	// destroy an entity; its handle becomes invalid
+	void Destroy(ENTITY entity);
+	bool IsAlive(ENTITY entity) const;
+	// destroy all entities
+	void Clear();
+	size_t GetCount() const { return m_entities.size(); }
+	// dense index of a live entity in the columns
+	size_t GetDenseIndex(ENTITY entity) const { return m_slotDense[entity & SLOT_MASK]; }
+
+	// component setters
+	void SetTransform(ENTITY entity, const glm::mat4& model);
+	void SetBounds(ENTITY entity, const glm::vec3& center, float radius);
+	void SetMesh(ENTITY entity, SCENE_MESH mesh);
+	void SetMaterial(ENTITY entity, int32_t materialIndex, int32_t textureSlot);
+	void SetVisibility(ENTITY entity, uint8_t flags);
+	void SetDrawIndex(ENTITY entity, uint32_t drawIndex);
+
+	// columns, by dense index
+	const glm::mat4* GetTransforms() const { return m_transforms.data(); }
+	const float* GetBoundsX() const { return m_boundsX.data(); }
+	const float* GetBoundsY() const { return m_boundsY.data(); }
+	const float* GetBoundsZ() const { return m_boundsZ.data(); }
+	const float* GetBoundsRadius() const { return m_boundsRadius.data(); }
+	const uint8_t* GetMeshes() const { return m_meshes.data(); }
+	const int32_t* GetMaterialIndices() const { return m_materialIndices.data(); }
+	const int32_t* GetTextureSlots() const { return m_textureSlots.data(); }
+	const uint8_t* GetVisibility() const { return m_visibility.data(); }
+	const uint32_t* GetDrawIndices() const { return m_drawIndices.data(); }
+
+	// culling system: dense indices of the entities whose bounds
+	// touch the frustum and that have none of the hiddenFlags, in
+	// an array from the frame arena
+	const uint32_t* CollectVisible(const glm::vec4 planes[6], uint8_t hiddenFlags, FrameArena& arena, size_t& visibleCount) const;
+
+	// planes of the view frustum from the combined projection
+	// and view matrix; inside points have a positive distance
+	static void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+private:
+	enum
+	{
+		SLOT_BITS = 24,
+		SLOT_MASK = (1 << SLOT_BITS) - 1
+	};
+
+	// components, by dense index
+	COLUMN<glm::mat4>::type m_transforms;
+	COLUMN<float>::type m_boundsX;
+	COLUMN<float>::type m_boundsY;
+	COLUMN<float>::type m_boundsZ;
+	COLUMN<float>::type m_boundsRadius;
+	COLUMN<uint8_t>::type m_meshes;
+	COLUMN<int32_t>::type m_materialIndices;
+	COLUMN<int32_t>::type m_textureSlots;
+	COLUMN<uint8_t>::type m_visibility;
+	COLUMN<uint32_t>::type m_drawIndices;
+	// handle of the entity at each dense index
+	std::vector<ENTITY> m_entities;
+
+	// per handle slot: dense index and current generation
+	std::vector<uint32_t> m_slotDense;
+	std::vector<uint8_t> m_slotGenerations;
+	// slots of destroyed entities, for reuse
+	std::vector<uint32_t> m_freeSlots;
+};
@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+// fileutility.cpp
+// ============
+// helpers shared by the on-disk caches: FNV-1a hashes for their keys and
+// checksums, and creating their directories
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FileUtility.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+/***********************************************************
+ *  Checksum()
+ *
+ *  32-bit FNV-1a hash of a block of bytes, continuing from
+ *  a previous hash value.
+ ***********************************************************/
+uint32_t Checksum(uint32_t hash, const void* bytes, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)bytes;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= p[i];
+		hash *= 16777619u;
+	}
+	return(hash);
+}
+
+/***********************************************************
+ *  HashBytes()
+ *
+ *  64-bit FNV-1a hash of a block of bytes, continuing from
+ *  a previous hash value.
+ ***********************************************************/
+uint64_t HashBytes(uint64_t hash, const void* bytes, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)bytes;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= p[i];
+		hash *= 1099511628211ull;
+	}
+	return(hash);
+}
+
+/***********************************************************
+ *  HashString()
+ *
+ *  64-bit FNV-1a hash of a string, continuing from a
+ *  previous hash value.
+ ***********************************************************/
+uint64_t HashString(uint64_t hash, const std::string& text)
+{
+	return(HashBytes(hash, text.data(), text.size()));
+}
+
+/***********************************************************
+ *  MakeDirectory()
+ *
+ *  Creates a directory.  Failure is not reported: the
+ *  directory usually exists already, and the caller finds
+ *  out anyway when it cannot create its file.
+ ***********************************************************/
+void MakeDirectory(const std::string& directory)
+{
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+}
@@ -0,0 +1,29 @@
+///////////////////////////////////////////////////////////////////////////////
+// fileutility.h
+// ============
+// helpers shared by the on-disk caches: FNV-1a hashes for their keys and
+// checksums, and creating their directories
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// starting values of the 32-bit checksum and the 64-bit hash
+const uint32_t CHECKSUM_SEED = 2166136261u;
+const uint64_t HASH_SEED = 14695981039346656037ull;
+
+// 32-bit FNV-1a hash of a block of bytes, continuing from a
+// previous value (CHECKSUM_SEED to start)
+uint32_t Checksum(uint32_t hash, const void* bytes, size_t size);
+// 64-bit FNV-1a hash of a block of bytes, continuing from a
+// previous value (HASH_SEED to start)
+uint64_t HashBytes(uint64_t hash, const void* bytes, size_t size);
+// 64-bit FNV-1a hash of the characters of a string
+uint64_t HashString(uint64_t hash, const std::string& text);
+
+// create a directory; one that already exists is left alone,
+// and missing parents are not created
+void MakeDirectory(const std::string& directory);
@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.cpp
+// ============
+// report when watched files are written, for hot reloading
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FileWatcher.h"
+
+#include <iostream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+/***********************************************************
+ *  FileWatcher()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FileWatcher::FileWatcher()
+{
+	m_inotify = -1;
+#ifdef __linux__
+	m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotify < 0)
+	{
+		std::cout << "inotify unavailable - polling watched files instead" << std::endl;
+	}
+#endif
+}
+
+/***********************************************************
+ *  ~FileWatcher()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (m_inotify >= 0)
+	{
+		close(m_inotify);
+	}
+#endif
+	m_inotify = -1;
+}
+
+/***********************************************************
+ *  AddFile()
+ *
+ *  This method starts watching a file.  With inotify its
+ *  directory is watched, since saving may replace the file
+ *  itself.
+ ***********************************************************/
+bool FileWatcher::AddFile(const std::string& filename)
+{
+	WATCHED_FILE file;
+	file.filename = filename;
+	size_t slash = filename.find_last_of("/\\");
+	file.directory = (slash == std::string::npos) ? "." : filename.substr(0, slash);
+	file.name = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+	file.watch = -1;
+	file.modifiedTime = GetModifiedTime(filename);
+
+#ifdef __linux__
+	if (m_inotify >= 0)
+	{
+		// adding the same directory again returns the same watch
+		file.watch = inotify_add_watch(m_inotify, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (file.watch < 0)
+		{
+			std::cout << "Could not watch directory:" << file.directory << std::endl;
+			return(false);
+		}
+	}
+#endif
+
+	m_files.push_back(file);
+	return(true);
+}
+
+/***********************************************************
+ *  Poll()
+ *
+ *  This method collects the watched files written since the
+ *  last poll, each at most once.  Returns true if any were.
+ ***********************************************************/
+bool FileWatcher::Poll(std::vector<std::string>& changedFiles)
+{
+	changedFiles.clear();
+	std::vector<bool> bChanged(m_files.size(), false);
+
+#ifdef __linux__
+	if (m_inotify >= 0)
+	{
+		char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+		for (;;)
+		{
+			ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+			if (length <= 0)
+			{
+				// EAGAIN - no more events
+				break;
+			}
+
+			for (char* p = buffer; p < buffer + length; )
+			{
+				const struct inotify_event* event = (const struct inotify_event*)p;
+				if (event->len > 0)
+				{
+					for (size_t i = 0; i < m_files.size(); i++)
+					{
+						if ((m_files[i].watch == event->wd) && (m_files[i].name == event->name))
+							bChanged[i] = true;
+					}
+				}
+				p += sizeof(struct inotify_event) + event->len;
+			}
+		}
+	}
+	else
+#endif
+	{
+		for (size_t i = 0; i < m_files.size(); i++)
+		{
+			long long modifiedTime = GetModifiedTime(m_files[i].filename);
+			if (modifiedTime != m_files[i].modifiedTime)
+			{
+				m_files[i].modifiedTime = modifiedTime;
+				bChanged[i] = true;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < m_files.size(); i++)
+	{
+		if (bChanged[i])
+			changedFiles.push_back(m_files[i].filename);
+	}
+
+	return(!changedFiles.empty());
+}
+
+/***********************************************************
+ *  GetModifiedTime()
+ *
+ *  This method returns the modification time of a file in
+ *  the finest unit the platform reports.
+ ***********************************************************/
+long long FileWatcher::GetModifiedTime(const std::string& filename)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(filename.c_str(), &info) != 0)
+		return(0);
+	return((long long)info.st_mtime);
+#elif defined(__linux__)
+	struct stat info;
+	if (stat(filename.c_str(), &info) != 0)
+		return(0);
+	return((long long)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec);
+#else
+	struct stat info;
+	if (stat(filename.c_str(), &info) != 0)
+		return(0);
+	return((long long)info.st_mtime);
+#endif
+}
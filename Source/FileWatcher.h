@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.h
+// ============
+// report when watched files are written, for hot reloading
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  FileWatcher
+ *
+ *  Poll() returns the watched files written since the last
+ *  call without ever blocking.  On Linux the directories of
+ *  the files are watched with inotify, so a poll is a single
+ *  non-blocking read; elsewhere the modification times of
+ *  the files are compared on each poll.
+ *
+ *  Editors that save by writing a new file and renaming it
+ *  over the old one are covered in both cases.
+ ***********************************************************/
+class FileWatcher
+{
+public:
+	// constructor
+	FileWatcher();
+	// destructor
+	~FileWatcher();
+
+	// start watching a file; it does not have to exist yet
+	bool AddFile(const std::string& filename);
+	// get the watched files written since the last poll
+	bool Poll(std::vector<std::string>& changedFiles);
+
+private:
+	struct WATCHED_FILE
+	{
+		std::string filename;
+		// directory and name within it, as inotify reports them
+		std::string directory;
+		std::string name;
+		// inotify watch of the directory (-1 = none)
+		int watch;
+		// last modification time seen by the polling fallback
+		long long modifiedTime;
+	};
+
+	// modification time of a file, 0 if it does not exist
+	static long long GetModifiedTime(const std::string& filename);
+
+	std::vector<WATCHED_FILE> m_files;
+	// inotify instance (-1 = polling fallback)
+	int m_inotify;
+};
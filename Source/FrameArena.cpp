@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.cpp
+// ============
+// linear allocator for the transient data of one frame
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameArena.h"
+
+#include <cstdint>
+
+// declaration of global variables
+namespace
+{
+	// overflow blocks a frame can take before the list itself grows
+	const size_t g_ReservedOverflowBlocks = 16;
+}
+
+/***********************************************************
+ *  FrameArena()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameArena::FrameArena(size_t capacity)
+{
+	m_capacity = capacity;
+	m_pBlock = new char[m_capacity];
+	m_offset = 0;
+	m_overflowBytes = 0;
+	m_overflowBlocks.reserve(g_ReservedOverflowBlocks);
+}
+
+/***********************************************************
+ *  ~FrameArena()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameArena::~FrameArena()
+{
+	Reset();
+	delete[] m_pBlock;
+	m_pBlock = NULL;
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method bumps the offset past the aligned request.
+ *  When the block is full the request gets a heap block of
+ *  its own, which is counted so the next Reset() can grow
+ *  the block by as much.
+ ***********************************************************/
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+	uintptr_t base = (uintptr_t)m_pBlock;
+	uintptr_t aligned = (base + m_offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	size_t end = (size_t)(aligned - base) + bytes;
+	if (end <= m_capacity)
+	{
+		m_offset = end;
+		return((void*)aligned);
+	}
+
+	char* pOverflow = new char[bytes + alignment];
+	m_overflowBlocks.push_back(pOverflow);
+	m_overflowBytes += bytes + alignment;
+	aligned = ((uintptr_t)pOverflow + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	return((void*)aligned);
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method releases the frame's allocations.  Normally
+ *  that is just the offset going back to zero; after a
+ *  frame that overflowed, the overflow blocks are freed and
+ *  the block is replaced by one with room for that frame.
+ ***********************************************************/
+void FrameArena::Reset()
+{
+	if (!m_overflowBlocks.empty())
+	{
+		size_t needed = m_offset + m_overflowBytes;
+		for (size_t i = 0; i < m_overflowBlocks.size(); i++)
+		{
+			delete[] m_overflowBlocks[i];
+		}
+		m_overflowBlocks.clear();
+
+		// leave headroom so a slowly growing scene does not
+		// overflow again on the next frame
+		delete[] m_pBlock;
+		m_capacity = needed + needed / 2;
+		m_pBlock = new char[m_capacity];
+	}
+
+	m_offset = 0;
+	m_overflowBytes = 0;
+}
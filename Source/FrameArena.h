@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.h
+// ============
+// linear allocator for the transient data of one frame
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+/***********************************************************
+ *  FrameArena
+ *
+ *  Hands out memory by bumping an offset into one block and
+ *  takes it all back at once with Reset(), which only sets
+ *  the offset to zero.  It holds the data that lives for a
+ *  single frame - visible lists, culling results, draw
+ *  commands - so drawing a frame never goes to the heap.
+ *
+ *  A frame that needs more than the block still succeeds
+ *  from extra heap blocks; the next Reset() frees them and
+ *  grows the block to fit, so only the first frames after
+ *  the scene grows allocate.  Nothing is constructed or
+ *  destroyed; the arena is for plain data only, and it is
+ *  not thread safe.
+ ***********************************************************/
+class FrameArena
+{
+public:
+	// alignment of AllocateArray() - one cache line
+	static const size_t ARRAY_ALIGNMENT = 64;
+
+	// constructor
+	FrameArena(size_t capacity);
+	// destructor
+	~FrameArena();
+
+	// uninitialized memory, valid until the next Reset()
+	void* Allocate(size_t bytes, size_t alignment);
+	// uninitialized array of count plain data elements
+	template <typename T>
+	T* AllocateArray(size_t count) { return (T*)Allocate(count * sizeof(T), ARRAY_ALIGNMENT); }
+
+	// release everything allocated since the last reset
+	void Reset();
+
+	size_t GetCapacity() const { return m_capacity; }
+	// bytes used by the current frame, including alignment
+	size_t GetUsed() const { return m_offset + m_overflowBytes; }
+
+private:
+	char* m_pBlock;
+	size_t m_capacity;
+	size_t m_offset;
+	// heap blocks of a frame that outgrew the block
+	std::vector<char*> m_overflowBlocks;
+	size_t m_overflowBytes;
+};
@@ -0,0 +1,618 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.cpp
+// ============
+// read rendered frames back through a ring of pixel buffers without
+// stalling, and write them as PNG images or a Y4M video on a thread
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameCapture.h"
+#include "FileUtility.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+
+// declaration of global variables
+namespace
+{
+	// longest wait for a pixel buffer fence, in nanoseconds
+	const GLuint64 g_FenceTimeout = 1000000000ull;
+	// largest stored deflate block
+	const size_t g_StoredBlockSize = 65535;
+
+	uint32_t g_CRCTable[256];
+	bool g_bCRCTableReady = false;
+
+	/***********************************************************
+	 *  CRC32()
+	 *
+	 *  The PNG chunk checksum of a block of bytes, continuing
+	 *  from a previous value.
+	 ***********************************************************/
+	uint32_t CRC32(uint32_t crc, const unsigned char* bytes, size_t size)
+	{
+		if (!g_bCRCTableReady)
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t value = i;
+				for (int bit = 0; bit < 8; bit++)
+				{
+					value = (value & 1) ? (0xedb88320u ^ (value >> 1)) : (value >> 1);
+				}
+				g_CRCTable[i] = value;
+			}
+			g_bCRCTableReady = true;
+		}
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = g_CRCTable[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+		}
+		return(~crc);
+	}
+
+	void AppendBigEndian(std::vector<unsigned char>& data, uint32_t value)
+	{
+		data.push_back((unsigned char)(value >> 24));
+		data.push_back((unsigned char)(value >> 16));
+		data.push_back((unsigned char)(value >> 8));
+		data.push_back((unsigned char)value);
+	}
+
+	/***********************************************************
+	 *  AppendChunk()
+	 *
+	 *  Adds a PNG chunk: its length, type, data and checksum.
+	 ***********************************************************/
+	void AppendChunk(std::vector<unsigned char>& png, const char* type, const std::vector<unsigned char>& data)
+	{
+		AppendBigEndian(png, (uint32_t)data.size());
+		size_t start = png.size();
+		png.insert(png.end(), type, type + 4);
+		png.insert(png.end(), data.begin(), data.end());
+		AppendBigEndian(png, CRC32(0, &png[start], png.size() - start));
+	}
+
+	/***********************************************************
+	 *  WritePNG()
+	 *
+	 *  Writes RGBA rows, bottom row first, as an RGB PNG.  The
+	 *  image data is stored in uncompressed deflate blocks:
+	 *  the files are larger, but writing one costs little more
+	 *  than the disk, which keeps the encoder ahead of the
+	 *  frame rate.
+	 ***********************************************************/
+	bool WritePNG(const std::string& filename, int width, int height, const std::vector<unsigned char>& pixels,
+		std::vector<unsigned char>& buffer)
+	{
+		// scanlines top row first, each with filter type 0
+		size_t rowSize = (size_t)width * 3 + 1;
+		std::vector<unsigned char> rows(rowSize * height);
+		uint32_t adlerA = 1;
+		uint32_t adlerB = 0;
+		for (int y = 0; y < height; y++)
+		{
+			unsigned char* row = &rows[rowSize * y];
+			const unsigned char* source = &pixels[(size_t)(height - 1 - y) * width * 4];
+			row[0] = 0;
+			for (int x = 0; x < width; x++)
+			{
+				row[1 + x * 3] = source[x * 4];
+				row[2 + x * 3] = source[x * 4 + 1];
+				row[3 + x * 3] = source[x * 4 + 2];
+			}
+			for (size_t i = 0; i < rowSize; i++)
+			{
+				adlerA = (adlerA + row[i]) % 65521;
+				adlerB = (adlerB + adlerA) % 65521;
+			}
+		}
+
+		// zlib stream of stored blocks
+		std::vector<unsigned char> zlib;
+		zlib.reserve(rows.size() + rows.size() / g_StoredBlockSize * 5 + 16);
+		zlib.push_back(0x78);
+		zlib.push_back(0x01);
+		for (size_t offset = 0; offset < rows.size(); offset += g_StoredBlockSize)
+		{
+			size_t size = std::min(g_StoredBlockSize, rows.size() - offset);
+			zlib.push_back((offset + size == rows.size()) ? 1 : 0);
+			zlib.push_back((unsigned char)(size & 0xff));
+			zlib.push_back((unsigned char)(size >> 8));
+			zlib.push_back((unsigned char)(~size & 0xff));
+			zlib.push_back((unsigned char)((~size >> 8) & 0xff));
+			zlib.insert(zlib.end(), rows.begin() + offset, rows.begin() + offset + size);
+		}
+		AppendBigEndian(zlib, (adlerB << 16) | adlerA);
+
+		std::vector<unsigned char> header;
+		AppendBigEndian(header, (uint32_t)width);
+		AppendBigEndian(header, (uint32_t)height);
+		// 8 bits per channel, RGB, deflate, no interlacing
+		const unsigned char format[5] = { 8, 2, 0, 0, 0 };
+		header.insert(header.end(), format, format + 5);
+
+		const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		buffer.assign(signature, signature + 8);
+		AppendChunk(buffer, "IHDR", header);
+		AppendChunk(buffer, "IDAT", zlib);
+		AppendChunk(buffer, "IEND", std::vector<unsigned char>());
+
+		std::ofstream file(filename.c_str(), std::ios::binary);
+		if (!file)
+		{
+			std::cout << "Could not write image:" << filename << std::endl;
+			return(false);
+		}
+		file.write((const char*)buffer.data(), buffer.size());
+		return(file.good());
+	}
+}
+
+/***********************************************************
+ *  FrameCapture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameCapture::FrameCapture(const FRAME_CAPTURE_SETTINGS& settings)
+{
+	m_settings = settings;
+	m_settings.ringSize = std::max(m_settings.ringSize, 2);
+	m_settings.queuedFrames = std::max(m_settings.queuedFrames, 1);
+	m_settings.frameRate = std::max(m_settings.frameRate, 1);
+	m_width = 0;
+	m_height = 0;
+	m_bInitialized = false;
+	m_oldestSlot = 0;
+	m_nextSlot = 0;
+	m_queueHead = 0;
+	m_queueCount = 0;
+	m_bStopping = false;
+	m_videoFrames = 0;
+	m_screenshots = 0;
+	m_capturedFrames = 0;
+	m_skippedFrames = 0;
+	m_bSizeChanged = false;
+	m_gpuWaits = 0;
+	m_encoderWaits = 0;
+	m_captureTime = 0.0;
+}
+
+/***********************************************************
+ *  ~FrameCapture()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameCapture::~FrameCapture()
+{
+	Destroy();
+	PrintReport();
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings for screenshots only.
+ ***********************************************************/
+FRAME_CAPTURE_SETTINGS FrameCapture::DefaultSettings()
+{
+	FRAME_CAPTURE_SETTINGS settings;
+	settings.bRecording = false;
+	settings.format = VIDEO_PNG_SEQUENCE;
+	settings.videoOutput = "Video";
+	settings.frameRate = 60;
+	settings.screenshotDirectory = "Screenshots";
+	settings.ringSize = 3;
+	settings.queuedFrames = 8;
+	return(settings);
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method creates the pixel buffers and the frame
+ *  copies for a window of the given size, opens the video
+ *  output and starts the encoder thread.
+ ***********************************************************/
+bool FrameCapture::Initialize(int width, int height)
+{
+	Destroy();
+	if ((width <= 0) || (height <= 0))
+	{
+		return(false);
+	}
+	m_width = width;
+	m_height = height;
+	size_t frameSize = (size_t)width * height * 4;
+
+	if (m_settings.bRecording)
+	{
+		if (m_settings.format == VIDEO_Y4M)
+		{
+			m_video.open(m_settings.videoOutput.c_str(), std::ios::binary | std::ios::trunc);
+			if (!m_video)
+			{
+				std::cout << "Could not create video file:" << m_settings.videoOutput << std::endl;
+				return(false);
+			}
+			// 4:2:0 with the chroma centered between the pixels,
+			// as the 2 x 2 averages are
+			m_video << "YUV4MPEG2 W" << width << " H" << height << " F" << m_settings.frameRate
+				<< ":1 Ip A1:1 C420jpeg\n";
+		}
+		else
+		{
+			MakeDirectory(m_settings.videoOutput);
+		}
+	}
+
+	m_slots.resize(m_settings.ringSize);
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		CAPTURE_SLOT& slot = m_slots[i];
+		glGenBuffers(1, &slot.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, NULL, GL_STREAM_READ);
+		slot.fence = 0;
+		slot.bPending = false;
+		slot.bVideo = false;
+		slot.bScreenshot = false;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_oldestSlot = 0;
+	m_nextSlot = 0;
+
+	// every frame copy is made up front, so capturing makes no
+	// heap allocations on the render thread
+	m_frames.resize(m_settings.queuedFrames);
+	m_freeFrames.clear();
+	for (int i = 0; i < m_settings.queuedFrames; i++)
+	{
+		m_frames[i].pixels.resize(frameSize);
+		m_freeFrames.push_back(i);
+	}
+	m_encodeQueue.assign(m_settings.queuedFrames, 0);
+	m_queueHead = 0;
+	m_queueCount = 0;
+	m_bStopping = false;
+	m_encoder = std::thread(&FrameCapture::Encode, this);
+
+	m_bInitialized = true;
+	if (m_settings.bRecording)
+	{
+		std::cout << "Recording " << width << " x " << height << " frames to " << m_settings.videoOutput << std::endl;
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method waits for the frames still on the GPU, lets
+ *  the encoder write everything queued and frees the pixel
+ *  buffers.
+ ***********************************************************/
+void FrameCapture::Destroy()
+{
+	if (!m_bInitialized)
+	{
+		return;
+	}
+
+	while (m_slots[m_oldestSlot].bPending)
+	{
+		CollectSlot(m_oldestSlot, true);
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_frameQueued.notify_all();
+	m_encoder.join();
+
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		glDeleteBuffers(1, &m_slots[i].buffer);
+	}
+	m_slots.clear();
+	m_frames.clear();
+	if (m_video.is_open())
+	{
+		m_video.close();
+	}
+
+	m_bInitialized = false;
+}
+
+/***********************************************************
+ *  CaptureFrame()
+ *
+ *  This method first hands the buffers the GPU has finished
+ *  to the encoder, oldest first, and then queues the read of
+ *  this frame into the next buffer.  Only if that buffer is
+ *  still in flight - the GPU is a whole ring behind - does
+ *  it wait.  A screenshot on its own is collected at once,
+ *  as an idle view may not draw another frame for a while.
+ *
+ *  Screenshots follow the window: at another size the
+ *  buffers are made again.  A recording keeps its size and
+ *  leaves the other frames out, saying so once each time the
+ *  size changes.
+ ***********************************************************/
+void FrameCapture::CaptureFrame(int width, int height, bool bScreenshot)
+{
+	bool bResized = (width != m_width) || (height != m_height);
+	if (!m_settings.bRecording && bResized && (width > 0) && (height > 0))
+	{
+		Initialize(width, height);
+		bResized = false;
+	}
+	if (!m_bInitialized)
+	{
+		return;
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	while (m_slots[m_oldestSlot].bPending && CollectSlot(m_oldestSlot, false))
+	{
+	}
+
+	if (m_settings.bRecording || bScreenshot)
+	{
+		if (bResized)
+		{
+			if (!m_bSizeChanged)
+			{
+				std::cout << "Frame capture: the window is " << width << " x " << height << ", frames are left out of the "
+					<< m_width << " x " << m_height << " recording until it is back at that size" << std::endl;
+				m_bSizeChanged = true;
+			}
+			if (bScreenshot)
+			{
+				std::cout << "Screenshot not taken: the window is not at the size of the recording" << std::endl;
+			}
+			m_skippedFrames++;
+		}
+		else
+		{
+			m_bSizeChanged = false;
+			if (m_slots[m_nextSlot].bPending)
+			{
+				m_gpuWaits++;
+				CollectSlot(m_nextSlot, true);
+			}
+
+			CAPTURE_SLOT& slot = m_slots[m_nextSlot];
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+			glReadBuffer(GL_BACK);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			slot.bPending = true;
+			slot.bVideo = m_settings.bRecording;
+			slot.bScreenshot = bScreenshot;
+			m_nextSlot = (m_nextSlot + 1) % (int)m_slots.size();
+			m_capturedFrames++;
+
+			if (bScreenshot && !m_settings.bRecording)
+			{
+				while (m_slots[m_oldestSlot].bPending)
+				{
+					CollectSlot(m_oldestSlot, true);
+				}
+			}
+		}
+	}
+
+	m_captureTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/***********************************************************
+ *  CollectSlot()
+ *
+ *  This method copies a pixel buffer whose read has finished
+ *  into a free frame and queues the frame for the encoder.
+ *  With no free frame the encoder is behind, and the render
+ *  thread waits for it rather than drop a frame of the video.
+ ***********************************************************/
+bool FrameCapture::CollectSlot(int index, bool bWait)
+{
+	CAPTURE_SLOT& slot = m_slots[index];
+	GLenum status = glClientWaitSync(slot.fence, bWait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, bWait ? g_FenceTimeout : 0);
+	if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED) && !bWait)
+	{
+		return(false);
+	}
+	glDeleteSync(slot.fence);
+	slot.fence = 0;
+	slot.bPending = false;
+	m_oldestSlot = (index + 1) % (int)m_slots.size();
+
+	int frameIndex = 0;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_freeFrames.empty())
+		{
+			m_encoderWaits++;
+			m_frameFreed.wait(lock, [this] { return(!m_freeFrames.empty()); });
+		}
+		frameIndex = m_freeFrames.back();
+		m_freeFrames.pop_back();
+	}
+
+	CAPTURED_FRAME& frame = m_frames[frameIndex];
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame.pixels.size(),
+		GL_MAP_READ_BIT);
+	if (NULL != pixels)
+	{
+		std::copy(pixels, pixels + frame.pixels.size(), frame.pixels.begin());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	frame.bVideo = slot.bVideo;
+	frame.bScreenshot = slot.bScreenshot;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (NULL == pixels)
+		{
+			m_freeFrames.push_back(frameIndex);
+			return(true);
+		}
+		m_encodeQueue[(m_queueHead + m_queueCount) % m_encodeQueue.size()] = frameIndex;
+		m_queueCount++;
+	}
+	m_frameQueued.notify_one();
+	return(true);
+}
+
+/***********************************************************
+ *  Encode()
+ *
+ *  This method is the body of the encoder thread: it writes
+ *  the queued frames in order and frees them again, until
+ *  the capture is destroyed and the queue is empty.
+ ***********************************************************/
+void FrameCapture::Encode()
+{
+	while (true)
+	{
+		int frameIndex = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_frameQueued.wait(lock, [this] { return(m_bStopping || (m_queueCount > 0)); });
+			if (m_queueCount == 0)
+			{
+				return;
+			}
+			frameIndex = m_encodeQueue[m_queueHead];
+		}
+
+		const CAPTURED_FRAME& frame = m_frames[frameIndex];
+		if (frame.bVideo)
+		{
+			if (m_settings.format == VIDEO_Y4M)
+			{
+				WriteY4MFrame(frame);
+			}
+			else
+			{
+				std::ostringstream name;
+				name << m_settings.videoOutput << "/frame_" << std::setw(6) << std::setfill('0') << m_videoFrames << ".png";
+				WritePNG(name.str(), m_width, m_height, frame.pixels, m_encodeBuffer);
+			}
+			m_videoFrames++;
+		}
+		if (frame.bScreenshot)
+		{
+			MakeDirectory(m_settings.screenshotDirectory);
+			std::ostringstream name;
+			name << m_settings.screenshotDirectory << "/screenshot_" << (long long)std::time(NULL) << "_" << m_screenshots
+				<< ".png";
+			if (WritePNG(name.str(), m_width, m_height, frame.pixels, m_encodeBuffer))
+			{
+				std::cout << "Saved " << name.str() << std::endl;
+			}
+			m_screenshots++;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queueHead = (m_queueHead + 1) % (int)m_encodeQueue.size();
+			m_queueCount--;
+			m_freeFrames.push_back(frameIndex);
+		}
+		m_frameFreed.notify_one();
+	}
+}
+
+/***********************************************************
+ *  WriteY4MFrame()
+ *
+ *  This method converts a frame to BT.601 YUV 4:2:0 (video
+ *  range, the default of encoders reading Y4M) and appends
+ *  it to the stream.  Chroma is the average of 2 x 2 pixels.
+ ***********************************************************/
+void FrameCapture::WriteY4MFrame(const CAPTURED_FRAME& frame)
+{
+	int chromaWidth = (m_width + 1) / 2;
+	int chromaHeight = (m_height + 1) / 2;
+	size_t lumaSize = (size_t)m_width * m_height;
+	size_t chromaSize = (size_t)chromaWidth * chromaHeight;
+	m_encodeBuffer.resize(lumaSize + chromaSize * 2);
+	unsigned char* planeY = &m_encodeBuffer[0];
+	unsigned char* planeU = planeY + lumaSize;
+	unsigned char* planeV = planeU + chromaSize;
+
+	// Y4M rows go top to bottom
+	for (int y = 0; y < m_height; y++)
+	{
+		const unsigned char* source = &frame.pixels[(size_t)(m_height - 1 - y) * m_width * 4];
+		unsigned char* row = planeY + (size_t)y * m_width;
+		for (int x = 0; x < m_width; x++)
+		{
+			int r = source[x * 4];
+			int g = source[x * 4 + 1];
+			int b = source[x * 4 + 2];
+			row[x] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		}
+	}
+	for (int y = 0; y < chromaHeight; y++)
+	{
+		int top = m_height - 1 - y * 2;
+		int bottom = std::max(top - 1, 0);
+		const unsigned char* rows[2] = { &frame.pixels[(size_t)top * m_width * 4], &frame.pixels[(size_t)bottom * m_width * 4] };
+		for (int x = 0; x < chromaWidth; x++)
+		{
+			int left = x * 2;
+			int right = std::min(left + 1, m_width - 1);
+			int r = 0;
+			int g = 0;
+			int b = 0;
+			for (int i = 0; i < 2; i++)
+			{
+				r += rows[i][left * 4] + rows[i][right * 4];
+				g += rows[i][left * 4 + 1] + rows[i][right * 4 + 1];
+				b += rows[i][left * 4 + 2] + rows[i][right * 4 + 2];
+			}
+			r = (r + 2) / 4;
+			g = (g + 2) / 4;
+			b = (b + 2) / 4;
+			planeU[(size_t)y * chromaWidth + x] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			planeV[(size_t)y * chromaWidth + x] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+
+	m_video << "FRAME\n";
+	m_video.write((const char*)m_encodeBuffer.data(), m_encodeBuffer.size());
+}
+
+/***********************************************************
+ *  PrintReport()
+ *
+ *  This method prints what capturing cost the render thread.
+ ***********************************************************/
+void FrameCapture::PrintReport() const
+{
+	if (m_capturedFrames == 0)
+	{
+		return;
+	}
+	std::cout << "Frame capture: " << m_capturedFrames << " frames read back, "
+		<< m_captureTime / m_capturedFrames << " ms per frame on the render thread, "
+		<< m_gpuWaits << " waits for the GPU, " << m_encoderWaits << " waits for the encoder";
+	if (m_skippedFrames > 0)
+	{
+		std::cout << ", " << m_skippedFrames << " frames at another size left out";
+	}
+	std::cout << std::endl;
+}
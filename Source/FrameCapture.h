@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.h
+// ============
+// read rendered frames back through a ring of pixel buffers without
+// stalling, and write them as PNG images or a Y4M video on a thread
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  VIDEO_FORMAT
+ *
+ *  How recorded frames are written.
+ ***********************************************************/
+enum VIDEO_FORMAT
+{
+	// one PNG image per frame in a directory
+	VIDEO_PNG_SEQUENCE,
+	// one uncompressed YUV 4:2:0 stream, for video encoders
+	VIDEO_Y4M
+};
+
+/***********************************************************
+ *  FRAME_CAPTURE_SETTINGS
+ *
+ *  Configuration of the capture, filled from the command
+ *  line in main().
+ ***********************************************************/
+struct FRAME_CAPTURE_SETTINGS
+{
+	// true = record every drawn frame
+	bool bRecording;
+	VIDEO_FORMAT format;
+	// directory of the PNG sequence or the Y4M file
+	std::string videoOutput;
+	// frames per second written to the Y4M header
+	int frameRate;
+	// directory screenshots are written to
+	std::string screenshotDirectory;
+	// pixel buffers the frames are read into; a frame is
+	// collected this many frames after it was drawn
+	int ringSize;
+	// frames read back but not yet written
+	int queuedFrames;
+};
+
+/***********************************************************
+ *  FrameCapture
+ *
+ *  This class reads the back buffer into a ring of pixel
+ *  pack buffers.  glReadPixels() into a buffer object only
+ *  queues the copy, and a fence after it tells when the copy
+ *  is done; each frame the finished buffers are mapped and
+ *  copied out, so the render thread waits on the GPU only if
+ *  it gets a whole ring ahead.  The copies go to an encoder
+ *  thread that writes the PNG images or the Y4M stream, so
+ *  the render thread never waits on the disk either - only
+ *  when the encoder falls more than queuedFrames behind.
+ *
+ *  Frames are recorded at the window size at Initialize();
+ *  frames drawn at another size (a resized window) are left
+ *  out, as a video cannot change size, and a message says so
+ *  when it happens.  Without a recording the buffers are
+ *  made again for the new size, so screenshots follow the
+ *  window.
+ *
+ *  All methods but the constructor must be called on the
+ *  thread that owns the GL context (the render thread).
+ ***********************************************************/
+class FrameCapture
+{
+public:
+	// constructor
+	FrameCapture(const FRAME_CAPTURE_SETTINGS& settings);
+	// destructor
+	~FrameCapture();
+
+	// default settings: not recording, PNG sequence, 60 fps,
+	// a ring of 3 buffers and 8 queued frames
+	static FRAME_CAPTURE_SETTINGS DefaultSettings();
+
+	// create the pixel buffers and start the encoder thread
+	bool Initialize(int width, int height);
+	// finish the frames in flight, stop the encoder and free the
+	// GL objects
+	void Destroy();
+	// size the frames are read at
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+
+	// read the finished back buffer of the given size (after the
+	// scene, before the swap) if recording or if a screenshot is
+	// wanted, and hand the frames the GPU has finished to the
+	// encoder
+	void CaptureFrame(int width, int height, bool bScreenshot);
+
+private:
+	// a pixel buffer of the ring
+	struct CAPTURE_SLOT
+	{
+		GLuint buffer;
+		GLsync fence;
+		bool bPending;
+		bool bVideo;
+		bool bScreenshot;
+	};
+
+	// a frame copied out of a pixel buffer, RGBA rows bottom
+	// row first
+	struct CAPTURED_FRAME
+	{
+		std::vector<unsigned char> pixels;
+		bool bVideo;
+		bool bScreenshot;
+	};
+
+	// copy a finished buffer out; false if it is not finished
+	// and bWait is false
+	bool CollectSlot(int slot, bool bWait);
+	// body of the encoder thread
+	void Encode();
+	void WriteY4MFrame(const CAPTURED_FRAME& frame);
+	void PrintReport() const;
+
+	FRAME_CAPTURE_SETTINGS m_settings;
+	int m_width;
+	int m_height;
+	bool m_bInitialized;
+
+	// ring of pixel buffers; the pending ones follow the oldest
+	std::vector<CAPTURE_SLOT> m_slots;
+	int m_oldestSlot;
+	int m_nextSlot;
+
+	// captured frames: all of them, the free ones and those
+	// waiting for the encoder, in order
+	std::vector<CAPTURED_FRAME> m_frames;
+	std::vector<int> m_freeFrames;
+	std::vector<int> m_encodeQueue;
+	int m_queueHead;
+	int m_queueCount;
+	std::mutex m_mutex;
+	std::condition_variable m_frameQueued;
+	std::condition_variable m_frameFreed;
+	bool m_bStopping;
+	std::thread m_encoder;
+
+	// encoder thread state
+	std::ofstream m_video;
+	std::vector<unsigned char> m_encodeBuffer;
+	unsigned long long m_videoFrames;
+	unsigned long long m_screenshots;
+
+	// render thread cost
+	unsigned long long m_capturedFrames;
+	unsigned long long m_skippedFrames;
+	// the frames drawn lately were at another size than the
+	// recording
+	bool m_bSizeChanged;
+	unsigned long long m_gpuWaits;
+	unsigned long long m_encoderWaits;
+	double m_captureTime;
+};
@@ -0,0 +1,265 @@
+///////////////////////////////////////////////////////////////////////////////
+// framescheduler.cpp
+// ============
+// pace the render loop to a target frame rate and skip redrawing
+// frames when nothing in the view has changed
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameScheduler.h"
+
+#include <iostream>
+#include <thread>
+#include <algorithm>
+
+// GLFW library
+#include "GLFW/glfw3.h"
+
+// declaration of global variables
+namespace
+{
+	// weight of the newest sample in the frame time average
+	const double g_AverageWeight = 0.1;
+	// the rate is halved when frames take longer than this
+	// fraction of the paced interval, and restored below it
+	const double g_SlowFrameRatio = 0.95;
+	const double g_FastFrameRatio = 0.60;
+	// lowest rate the pacing will drop to, as a divisor of the target
+	const int g_MaxRateDivisor = 4;
+
+	/***********************************************************
+	 *  MatricesEqual()
+	 *
+	 *  Exact comparison - any change at all must be redrawn.
+	 ***********************************************************/
+	bool MatricesEqual(const glm::mat4& a, const glm::mat4& b)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				if (a[column][row] != b[column][row])
+					return(false);
+			}
+		}
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  FrameScheduler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameScheduler::FrameScheduler(const FRAME_SCHEDULER_SETTINGS& settings)
+{
+	m_settings = settings;
+
+	m_frameStart = Clock::now();
+	m_workEnd = m_frameStart;
+	m_bWorkEnded = false;
+	m_nextDeadline = m_frameStart;
+	m_averageFrameTime = 0.0;
+	m_sleepOvershoot = 0.001;
+	m_pacedInterval = 0.0;
+	if (m_settings.targetFrameRate > 0.0f)
+	{
+		m_pacedInterval = 1.0 / m_settings.targetFrameRate;
+	}
+
+	m_bHasPublished = false;
+	m_bIdle = false;
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings used when nothing else
+ *  is given on the command line.
+ ***********************************************************/
+FRAME_SCHEDULER_SETTINGS FrameScheduler::DefaultSettings()
+{
+	FRAME_SCHEDULER_SETTINGS settings;
+	settings.targetFrameRate = 0.0f;
+	settings.syncMode = SYNC_VSYNC;
+	settings.bIdleEnabled = true;
+	settings.idleWaitTimeout = 0.5;
+	return(settings);
+}
+
+/***********************************************************
+ *  ApplySwapInterval()
+ *
+ *  This method sets the swap interval of the GL context that
+ *  is current on the calling (render) thread.  Adaptive sync
+ *  uses a negative interval, which is only allowed when the
+ *  swap_control_tear extension is present.
+ ***********************************************************/
+void FrameScheduler::ApplySwapInterval()
+{
+	int interval = 1;
+
+	switch (m_settings.syncMode)
+	{
+	case SYNC_OFF:
+		interval = 0;
+		break;
+	case SYNC_VSYNC:
+		interval = 1;
+		break;
+	case SYNC_ADAPTIVE:
+		if (glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+			glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+		{
+			interval = -1;
+		}
+		else
+		{
+			std::cout << "Adaptive sync is not supported, using vsync" << std::endl;
+			interval = 1;
+		}
+		break;
+	}
+
+	glfwSwapInterval(interval);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method marks the start of the frame's work.
+ ***********************************************************/
+void FrameScheduler::BeginFrame()
+{
+	m_frameStart = Clock::now();
+	m_bWorkEnded = false;
+}
+
+/***********************************************************
+ *  EndWork()
+ *
+ *  This method marks the end of the frame's work.  It is
+ *  called just before glfwSwapBuffers(), which may block
+ *  until the vertical blank.
+ ***********************************************************/
+void FrameScheduler::EndWork()
+{
+	m_workEnd = Clock::now();
+	m_bWorkEnded = true;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is called after the buffers were swapped.  It
+ *  folds the time of the frame's work into the running
+ *  average and, when a target rate is set, waits for the
+ *  next frame deadline.  The swap is left out of the average:
+ *  with vsync on it waits for the vertical blank, and counting
+ *  that wait would pace a 60 Hz target down to 30 and back up
+ *  again every few frames.
+ *
+ *  If the average frame takes longer than the interval, the
+ *  pacing drops to the next whole fraction of the target rate
+ *  (60, 30, 20, 15...) so frames stay evenly spaced instead of
+ *  alternating between early and late.
+ ***********************************************************/
+void FrameScheduler::EndFrame()
+{
+	Clock::time_point frameEnd = Clock::now();
+	Clock::time_point workEnd = m_bWorkEnded ? m_workEnd : frameEnd;
+	double frameTime = std::chrono::duration<double>(workEnd - m_frameStart).count();
+	m_averageFrameTime += (frameTime - m_averageFrameTime) * g_AverageWeight;
+
+	if (m_settings.targetFrameRate <= 0.0f)
+	{
+		return;
+	}
+
+	// pick the paced interval from the measured frame times
+	double targetInterval = 1.0 / m_settings.targetFrameRate;
+	int divisor = (int)(m_pacedInterval / targetInterval + 0.5);
+	if ((m_averageFrameTime > m_pacedInterval * g_SlowFrameRatio) && (divisor < g_MaxRateDivisor))
+	{
+		divisor++;
+	}
+	else if ((divisor > 1) && (m_averageFrameTime < targetInterval * (divisor - 1) * g_FastFrameRatio))
+	{
+		divisor--;
+	}
+	m_pacedInterval = targetInterval * divisor;
+
+	// advance the deadline; if we are more than a whole frame
+	// late, restart from now rather than rushing to catch up
+	m_nextDeadline += std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(m_pacedInterval));
+	if (m_nextDeadline < frameEnd)
+	{
+		m_nextDeadline = frameEnd;
+		return;
+	}
+
+	WaitUntil(m_nextDeadline);
+}
+
+/***********************************************************
+ *  WaitUntil()
+ *
+ *  This method sleeps for most of the remaining time and
+ *  spins for the rest.  The spin margin follows the measured
+ *  oversleep of the OS timer, which is coarse on some systems.
+ ***********************************************************/
+void FrameScheduler::WaitUntil(Clock::time_point deadline)
+{
+	double remaining = std::chrono::duration<double>(deadline - Clock::now()).count();
+	double sleepTime = remaining - m_sleepOvershoot;
+
+	if (sleepTime > 0.0)
+	{
+		Clock::time_point sleepStart = Clock::now();
+		std::this_thread::sleep_for(std::chrono::duration<double>(sleepTime));
+		double slept = std::chrono::duration<double>(Clock::now() - sleepStart).count();
+
+		// rise quickly on a long oversleep, decay slowly otherwise
+		double overshoot = std::max(slept - sleepTime, 0.0);
+		if (overshoot > m_sleepOvershoot)
+			m_sleepOvershoot = overshoot;
+		else
+			m_sleepOvershoot += (overshoot - m_sleepOvershoot) * g_AverageWeight;
+	}
+
+	while (Clock::now() < deadline)
+	{
+		std::this_thread::yield();
+	}
+}
+
+/***********************************************************
+ *  ShouldPublish()
+ *
+ *  This method compares a freshly built snapshot with the
+ *  last one that was drawn, framebuffer size included.  When
+ *  idle mode is enabled and the view is identical, the frame
+ *  is skipped and the scheduler reports idle so the
+ *  simulation loop can block in glfwWaitEventsTimeout()
+ *  until something happens.
+ ***********************************************************/
+bool FrameScheduler::ShouldPublish(const SCENE_SNAPSHOT& snapshot, bool bForceRedraw)
+{
+	bool bChanged = (m_bHasPublished == false) || bForceRedraw ||
+		(m_settings.bIdleEnabled == false) ||
+		(snapshot.bOrthographic != m_lastPublished.bOrthographic) ||
+		(snapshot.framebufferWidth != m_lastPublished.framebufferWidth) ||
+		(snapshot.framebufferHeight != m_lastPublished.framebufferHeight) ||
+		(snapshot.viewPosition != m_lastPublished.viewPosition) ||
+		(MatricesEqual(snapshot.view, m_lastPublished.view) == false) ||
+		(MatricesEqual(snapshot.projection, m_lastPublished.projection) == false);
+
+	m_bIdle = !bChanged;
+	if (bChanged)
+	{
+		m_lastPublished = snapshot;
+		m_bHasPublished = true;
+	}
+
+	return(bChanged);
+}
@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+// framescheduler.h
+// ============
+// pace the render loop to a target frame rate and skip redrawing
+// frames when nothing in the view has changed
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneSnapshot.h"
+
+#include <chrono>
+
+// swap interval used when presenting a frame
+enum SYNC_MODE
+{
+	SYNC_OFF,       // present immediately, may tear
+	SYNC_VSYNC,     // wait for vertical blank
+	SYNC_ADAPTIVE   // wait for vertical blank unless the frame is late
+};
+
+/***********************************************************
+ *  FRAME_SCHEDULER_SETTINGS
+ *
+ *  Configuration of the frame scheduler, filled from the
+ *  command line in main().
+ ***********************************************************/
+struct FRAME_SCHEDULER_SETTINGS
+{
+	// frames per second to pace to, 0 = unlimited
+	float targetFrameRate;
+	// vertical sync mode
+	SYNC_MODE syncMode;
+	// stop redrawing while the view is unchanged
+	bool bIdleEnabled;
+	// longest time (in seconds) to sleep in glfwWaitEventsTimeout
+	double idleWaitTimeout;
+};
+
+/***********************************************************
+ *  FrameScheduler
+ *
+ *  This class has two halves.  The render thread calls
+ *  ApplySwapInterval() once, and BeginFrame(), EndWork() just
+ *  before the swap and EndFrame() after it for every frame;
+ *  EndFrame() sleeps until the next frame deadline.  Only the
+ *  time up to EndWork() is averaged, as the swap blocks until
+ *  the vertical blank with vsync on and would make every
+ *  frame look as long as the refresh interval.  The
+ *  simulation thread calls ShouldPublish() to decide whether
+ *  a snapshot differs enough from the last one to be worth
+ *  drawing, and IsIdle() to choose between polling and
+ *  waiting for events.  The two halves share no state.
+ ***********************************************************/
+class FrameScheduler
+{
+public:
+	// constructor
+	FrameScheduler(const FRAME_SCHEDULER_SETTINGS& settings);
+
+	// default settings: vsync, unlimited rate, idle mode on
+	static FRAME_SCHEDULER_SETTINGS DefaultSettings();
+
+	// render thread: set the swap interval for the current context
+	void ApplySwapInterval();
+	// render thread: mark the start of a frame
+	void BeginFrame();
+	// render thread: mark the end of the frame's work, just
+	// before the buffers are swapped
+	void EndWork();
+	// render thread: measure the frame and wait for the next deadline
+	void EndFrame();
+	// render thread: smoothed time (in seconds) spent drawing a
+	// frame, without the swap
+	double GetAverageFrameTime() const { return m_averageFrameTime; }
+
+	// simulation thread: true if the snapshot must be drawn - the
+	// camera or projection changed, or a redraw was forced
+	bool ShouldPublish(const SCENE_SNAPSHOT& snapshot, bool bForceRedraw);
+	// simulation thread: true while the view has not changed
+	bool IsIdle() const { return m_bIdle; }
+	// simulation thread: timeout to pass to glfwWaitEventsTimeout
+	double GetIdleWaitTimeout() const { return m_settings.idleWaitTimeout; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	// sleep until the deadline, spinning for the last stretch
+	void WaitUntil(Clock::time_point deadline);
+
+	FRAME_SCHEDULER_SETTINGS m_settings;
+
+	// render thread state
+	// start of the current frame
+	Clock::time_point m_frameStart;
+	// end of the current frame's work, before the swap
+	Clock::time_point m_workEnd;
+	bool m_bWorkEnded;
+	// time at which the next frame should start
+	Clock::time_point m_nextDeadline;
+	// exponential moving average of the frame work time
+	double m_averageFrameTime;
+	// how much a sleep typically overshoots its request
+	double m_sleepOvershoot;
+	// frame interval currently paced to (a multiple of the target)
+	double m_pacedInterval;
+
+	// simulation thread state
+	// the last snapshot handed to the render thread
+	SCENE_SNAPSHOT m_lastPublished;
+	// true once a snapshot has been published
+	bool m_bHasPublished;
+	// true while nothing has changed since the last snapshot
+	bool m_bIdle;
+};
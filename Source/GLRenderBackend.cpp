@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////////////////////////////////
+// glrenderbackend.cpp
+// ============
+// draw the scene object by object with OpenGL and the scene shaders
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLRenderBackend.h"
+
+#include <iostream>
+#include <string>
+
+// declaration of global variables
+namespace
+{
+	// uniform names are built once, so setting a uniform never
+	// makes a temporary string on the heap
+	const std::string g_ModelName = "model";
+	const std::string g_TextureValueName = "objectTexture";
+	const std::string g_UseTextureName = "bUseTexture";
+	const std::string g_UseLightingName = "bUseLighting";
+	const std::string g_UVScaleName = "UVscale";
+	const std::string g_MaterialAmbientColorName = "material.ambientColor";
+	const std::string g_MaterialAmbientStrengthName = "material.ambientStrength";
+	const std::string g_MaterialDiffuseColorName = "material.diffuseColor";
+	const std::string g_MaterialSpecularColorName = "material.specularColor";
+	const std::string g_MaterialShininessName = "material.shininess";
+
+	// light slots of the scene shader
+	const size_t g_ShaderLightSlots = 4;
+}
+
+/***********************************************************
+ *  GLRenderBackend()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GLRenderBackend::GLRenderBackend(ShaderManager* pShaderManager, MeshLibrary* pMeshLibrary)
+{
+	m_pShaderManager = pShaderManager;
+	m_pMeshLibrary = pMeshLibrary;
+	m_blendMode = BLEND_OPAQUE;
+	m_blendOpacity = 1.0f;
+}
+
+/***********************************************************
+ *  LoadMeshes()
+ *
+ *  This method loads every basic mesh into the shared
+ *  buffers of the mesh library.  Only one instance of a
+ *  mesh needs to be in memory no matter how many times it
+ *  is drawn - and generated meshes are kept in an on-disk
+ *  cache so later starts skip the generation.
+ ***********************************************************/
+void GLRenderBackend::LoadMeshes()
+{
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		m_pMeshLibrary->LoadMesh(MeshGenerator::DefaultParams((SCENE_MESH)i));
+	}
+	m_pMeshLibrary->UploadMeshes();
+	m_pMeshLibrary->PrintMemoryReport();
+}
+
+/***********************************************************
+ *  CreateTexture()
+ *
+ *  This method creates a repeating GL texture with mipmaps
+ *  from an RGB or RGBA image.
+ ***********************************************************/
+unsigned int GLRenderBackend::CreateTexture(const unsigned char* image, int width, int height, int channels)
+{
+	GLenum internalFormat;
+	GLenum format;
+	// if the loaded image is in RGB format
+	if (channels == 3)
+	{
+		internalFormat = GL_RGB8;
+		format = GL_RGB;
+	}
+	// if the loaded image is in RGBA format - it supports transparency
+	else if (channels == 4)
+	{
+		internalFormat = GL_RGBA8;
+		format = GL_RGBA;
+	}
+	else
+	{
+		std::cout << "Not implemented to handle image with " << channels << " channels" << std::endl;
+		return(0);
+	}
+
+	GLuint textureID = 0;
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// Set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// Set texture filtering parameters - trilinear, like the
+	// software backend samples
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// Fix to ensure that OpenGL does not assume 4-byte alignment (images whose row size is not multiple of 4)
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, image);
+
+	// generate the texture mipmaps for mapping textures to lower resolutions
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  DestroyTexture()
+ *
+ *  This method frees a GL texture.
+ ***********************************************************/
+void GLRenderBackend::DestroyTexture(unsigned int texture)
+{
+	GLuint textureID = texture;
+	glDeleteTextures(1, &textureID);
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method binds a texture to the unit of its slot.
+ ***********************************************************/
+void GLRenderBackend::BindTexture(int slot, unsigned int texture)
+{
+	glActiveTexture(GL_TEXTURE0 + slot);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method sets the lights into the lightSources
+ *  uniforms of the shader program.
+ ***********************************************************/
+void GLRenderBackend::SetLights(const std::vector<RENDER_LIGHT>& lights)
+{
+	m_pShaderManager->use();
+
+	// Enable lighting in shaders
+	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const RENDER_LIGHT& light = lights[i];
+		std::string name = "lightSources[" + std::to_string(i) + "].";
+		m_pShaderManager->setVec3Value(name + "position", light.position);
+		m_pShaderManager->setVec3Value(name + "ambientColor", light.ambientColor);
+		m_pShaderManager->setVec3Value(name + "diffuseColor", light.diffuseColor);
+		m_pShaderManager->setVec3Value(name + "specularColor", light.specularColor);
+		m_pShaderManager->setFloatValue(name + "focalStrength", light.focalStrength);
+		m_pShaderManager->setFloatValue(name + "specularIntensity", light.specularIntensity);
+		m_pShaderManager->setBoolValue(name + "isDirectional", light.bDirectional);
+	}
+
+	// ----------------------------
+	// Disable unused light slots if shader expects four
+	// ----------------------------
+	for (size_t i = lights.size(); i < g_ShaderLightSlots; i++)
+	{
+		std::string name = "lightSources[" + std::to_string(i) + "].";
+		m_pShaderManager->setVec3Value(name + "ambientColor", glm::vec3(0.0f));
+		m_pShaderManager->setVec3Value(name + "diffuseColor", glm::vec3(0.0f));
+		m_pShaderManager->setVec3Value(name + "specularColor", glm::vec3(0.0f));
+	}
+}
+
+/***********************************************************
+ *  SetMaterials()
+ *
+ *  This method keeps the materials the draws refer to.
+ ***********************************************************/
+void GLRenderBackend::SetMaterials(const std::vector<RENDER_MATERIAL>& materials)
+{
+	m_materials = materials;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method makes the scene program current and starts
+ *  with the opaque state.  The view manager has already set
+ *  the snapshot's camera on the program.
+ ***********************************************************/
+void GLRenderBackend::BeginFrame(const SCENE_SNAPSHOT& /*snapshot*/)
+{
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	m_blendMode = BLEND_OPAQUE;
+	m_blendOpacity = 1.0f;
+
+	m_pShaderManager->use();
+	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+	m_pShaderManager->setBoolValue(g_UseTextureName, true);
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method sets the object's transform, material,
+ *  texture and UV scale into the shader and the blend state
+ *  of the material, and draws the mesh.
+ ***********************************************************/
+void GLRenderBackend::DrawMesh(SCENE_MESH mesh, const RENDER_OBJECT& object)
+{
+	m_pShaderManager->setMat4Value(g_ModelName, object.model);
+	if ((object.materialIndex >= 0) && (object.materialIndex < (int)m_materials.size()))
+	{
+		const RENDER_MATERIAL& material = m_materials[object.materialIndex];
+		SetBlendState(material.blendMode, material.opacity);
+		m_pShaderManager->setVec3Value(g_MaterialAmbientColorName, material.ambientColor);
+		m_pShaderManager->setFloatValue(g_MaterialAmbientStrengthName, material.ambientStrength);
+		m_pShaderManager->setVec3Value(g_MaterialDiffuseColorName, material.diffuseColor);
+		m_pShaderManager->setVec3Value(g_MaterialSpecularColorName, material.specularColor);
+		m_pShaderManager->setFloatValue(g_MaterialShininessName, material.shininess);
+	}
+	else
+	{
+		SetBlendState(BLEND_OPAQUE, 1.0f);
+	}
+	m_pShaderManager->setIntValue(g_UseTextureName, true);
+	m_pShaderManager->setSampler2DValue(g_TextureValueName, object.textureSlot);
+	m_pShaderManager->setVec2Value(g_UVScaleName, object.uvScale.x, object.uvScale.y);
+
+	m_pMeshLibrary->DrawMesh(mesh);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  The draws went straight to the context, so this method
+ *  only puts the opaque state back.
+ ***********************************************************/
+void GLRenderBackend::EndFrame()
+{
+	SetBlendState(BLEND_OPAQUE, 1.0f);
+}
+
+/***********************************************************
+ *  SetBlendState()
+ *
+ *  This method changes the blend and depth write state when
+ *  the blend mode (or transparent opacity) differs from the
+ *  previous draw's.  The draws come sorted by pass, so it
+ *  changes once per pass, plus between transparent
+ *  materials of different opacity.
+ ***********************************************************/
+void GLRenderBackend::SetBlendState(BLEND_MODE blendMode, float opacity)
+{
+	if ((blendMode == m_blendMode) && ((blendMode != BLEND_TRANSPARENT) || (opacity == m_blendOpacity)))
+	{
+		return;
+	}
+
+	if (blendMode == BLEND_OPAQUE)
+	{
+		glDisable(GL_BLEND);
+		glDepthMask(GL_TRUE);
+	}
+	else if (blendMode == BLEND_ALPHA_TEST)
+	{
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glDepthMask(GL_TRUE);
+	}
+	else
+	{
+		glEnable(GL_BLEND);
+		glBlendColor(0.0f, 0.0f, 0.0f, opacity);
+		glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+		glDepthMask(GL_FALSE);
+	}
+	m_blendMode = blendMode;
+	m_blendOpacity = opacity;
+}
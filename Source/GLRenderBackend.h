@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////////////////////////////////
+// glrenderbackend.h
+// ============
+// draw the scene object by object with OpenGL and the scene shaders
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderBackend.h"
+#include "MeshLibrary.h"
+#include "ShaderManager.h"
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  GLRenderBackend
+ *
+ *  The OpenGL backend: meshes come from the mesh library,
+ *  textures are GL textures on units 0 - 15, and lights,
+ *  materials and transforms are set into the uniforms of
+ *  the shader manager's program.  The view and projection
+ *  are set by the view manager.
+ *
+ *  The scene shader has no alpha test or opacity input, so
+ *  the blend modes are made with the blend state alone:
+ *  transparent materials blend by a constant alpha of their
+ *  opacity without depth writes, and alpha tested ones blend
+ *  by the texture alpha with depth writes.
+ ***********************************************************/
+class GLRenderBackend : public RenderBackend
+{
+public:
+	// constructor; neither object is owned
+	GLRenderBackend(ShaderManager* pShaderManager, MeshLibrary* pMeshLibrary);
+
+	virtual void LoadMeshes();
+
+	virtual unsigned int CreateTexture(const unsigned char* image, int width, int height, int channels);
+	virtual void DestroyTexture(unsigned int texture);
+	virtual void BindTexture(int slot, unsigned int texture);
+
+	virtual void SetLights(const std::vector<RENDER_LIGHT>& lights);
+	virtual void SetMaterials(const std::vector<RENDER_MATERIAL>& materials);
+
+	virtual void BeginFrame(const SCENE_SNAPSHOT& snapshot);
+	virtual void DrawMesh(SCENE_MESH mesh, const RENDER_OBJECT& object);
+	virtual void EndFrame();
+
+private:
+	ShaderManager* m_pShaderManager;
+	MeshLibrary* m_pMeshLibrary;
+	std::vector<RENDER_MATERIAL> m_materials;
+	// blend mode the blend and depth write state is set for
+	BLEND_MODE m_blendMode;
+	float m_blendOpacity;
+
+	// set the blend state of a material's blend mode
+	void SetBlendState(BLEND_MODE blendMode, float opacity);
+};
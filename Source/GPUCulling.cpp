@@ -0,0 +1,729 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculling.cpp
+// ============
+// cull the opaque objects of the multi-draw path in a compute shader -
+// against the view frustum and the previous frame's depth pyramid - and
+// write their indirect commands on the GPU
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GPUCulling.h"
+#include "ShaderVariantCache.h"
+#include "EntityStore.h"
+
+#include <iostream>
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// shader storage buffer binding points of the cull shader;
+	// the per-object data is where the indirect shaders read it
+	const GLuint g_DrawDataBinding = 0;
+	const GLuint g_ObjectBinding = 5;
+	const GLuint g_MeshBinding = 6;
+	const GLuint g_FadeBinding = 7;
+	const GLuint g_CommandBinding = 8;
+	// texture unit the depth copy and the pyramid are read
+	// from, and the image unit a pyramid level is written to
+	const GLuint g_PyramidUnit = 23;
+	const GLuint g_PyramidImageUnit = 0;
+	// invocations per work group, as in the shaders
+	const GLuint g_CullGroupSize = 64;
+	const GLuint g_PyramidGroupSize = 8;
+	// the most batches the cull shader takes offsets for
+	const int g_MaxBatches = 32;
+	// the object flag of the cull shader that keeps an object
+	// out of orthographic views
+	const uint32_t g_PerspectiveOnlyFlag = 1;
+	// frames whose disagreements the validation prints
+	const unsigned long long g_PrintedMismatchFrames = 5;
+
+	// layout of the std430 CullObject struct of the cull shader
+	struct GPU_CULL_OBJECT
+	{
+		uint32_t mesh;
+		uint32_t flags;
+		int32_t impostor;
+		// batch of the object's command (-1 = not culled here)
+		// and its slot among the batch's culled objects
+		int32_t batch;
+		uint32_t slot;
+		uint32_t padding[3];
+	};
+
+	// layout of the std430 CullMesh struct of the cull shader
+	struct GPU_CULL_MESH
+	{
+		// xyz = center, w = radius
+		glm::vec4 sphere;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t baseVertex;
+		uint32_t padding;
+	};
+
+	// layout of an indirect command, as the shader writes it
+	struct GPU_DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	/***********************************************************
+	 *  FloorPowerOfTwo()
+	 *
+	 *  Largest power of two not above a positive value.
+	 ***********************************************************/
+	int FloorPowerOfTwo(int value)
+	{
+		int power = 1;
+		while (power * 2 <= value)
+		{
+			power *= 2;
+		}
+		return(power);
+	}
+}
+
+/***********************************************************
+ *  GPUCulling()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GPUCulling::GPUCulling(const MeshLibrary* pMeshLibrary, const GPU_CULLING_SETTINGS& settings)
+{
+	m_pMeshLibrary = pMeshLibrary;
+	m_settings = settings;
+	m_programs.cull = 0;
+	m_programs.pyramid = 0;
+	DeletePrograms(m_programs);
+	m_newPrograms.cull = 0;
+	m_newPrograms.pyramid = 0;
+	DeletePrograms(m_newPrograms);
+	m_objectBuffer = 0;
+	m_meshBuffer = 0;
+	m_fadeBuffer = 0;
+	m_objectCount = 0;
+	m_culledCount = 0;
+	for (int i = 0; i < 6; i++)
+	{
+		m_frustumPlanes[i] = glm::vec4(0.0f);
+	}
+	m_viewProjection = glm::mat4(1.0f);
+	m_bOrthographic = false;
+	m_impostorCount = 0;
+	m_bFrameOcclusion = false;
+	m_depthTexture = 0;
+	m_depthWidth = 0;
+	m_depthHeight = 0;
+	m_pyramidTexture = 0;
+	m_pyramidWidth = 0;
+	m_pyramidHeight = 0;
+	m_pyramidLevels = 0;
+	m_pyramidViewProjection = glm::mat4(1.0f);
+	m_bPyramidValid = false;
+	m_validatedFrames = 0;
+	m_expectedObjects = 0;
+	m_drawnObjects = 0;
+	m_occludedObjects = 0;
+	m_mismatches = 0;
+	m_mismatchFrames = 0;
+}
+
+/***********************************************************
+ *  ~GPUCulling()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GPUCulling::~GPUCulling()
+{
+	if (m_validatedFrames > 0)
+	{
+		PrintReport();
+	}
+	Destroy();
+	m_pMeshLibrary = NULL;
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings used when nothing else
+ *  is given on the command line.
+ ***********************************************************/
+GPU_CULLING_SETTINGS GPUCulling::DefaultSettings()
+{
+	GPU_CULLING_SETTINGS settings;
+	settings.mode = GPU_CULLING_OFF;
+	settings.maxPyramidSize = 1024;
+	settings.bValidate = false;
+	return(settings);
+}
+
+/***********************************************************
+ *  ModeName()
+ *
+ *  This method returns the command line name of a mode.
+ ***********************************************************/
+const char* GPUCulling::ModeName(GPU_CULLING_MODE mode)
+{
+	switch (mode)
+	{
+	case GPU_CULLING_FRUSTUM:
+		return("frustum");
+	case GPU_CULLING_OCCLUSION:
+		return("occlusion");
+	default:
+		return("off");
+	}
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method builds the cull shader - and the pyramid
+ *  shader, for the occlusion mode - and creates the buffers.
+ ***********************************************************/
+bool GPUCulling::Initialize(const char* cullShaderFile, const char* pyramidShaderFile)
+{
+	Destroy();
+	m_cullShaderFile = cullShaderFile;
+	m_pyramidShaderFile = pyramidShaderFile;
+
+	if (!BuildPrograms(m_programs))
+	{
+		return(false);
+	}
+
+	glGenBuffers(1, &m_objectBuffer);
+	glGenBuffers(1, &m_meshBuffer);
+	glGenBuffers(1, &m_fadeBuffer);
+
+	// the shader reads no fade while there are none, but the
+	// binding still needs a buffer with storage
+	float noFade = 0.0f;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_fadeBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(float), &noFade, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  BuildShaders()
+ *
+ *  This method builds the programs from the current shader
+ *  files, leaving the ones in use alone.
+ ***********************************************************/
+bool GPUCulling::BuildShaders()
+{
+	DiscardShaders();
+	return(BuildPrograms(m_newPrograms));
+}
+
+/***********************************************************
+ *  ApplyShaders()
+ *
+ *  This method switches to the programs of the last
+ *  BuildShaders(), if both built.
+ ***********************************************************/
+void GPUCulling::ApplyShaders()
+{
+	if (m_newPrograms.cull == 0)
+	{
+		return;
+	}
+	DeletePrograms(m_programs);
+	m_programs = m_newPrograms;
+	m_newPrograms.cull = 0;
+	m_newPrograms.pyramid = 0;
+	DeletePrograms(m_newPrograms);
+}
+
+/***********************************************************
+ *  DiscardShaders()
+ *
+ *  This method drops the programs of the last
+ *  BuildShaders().
+ ***********************************************************/
+void GPUCulling::DiscardShaders()
+{
+	DeletePrograms(m_newPrograms);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method frees the programs, buffers and textures.
+ ***********************************************************/
+void GPUCulling::Destroy()
+{
+	DiscardShaders();
+	DeletePrograms(m_programs);
+	if (m_objectBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_objectBuffer);
+		glDeleteBuffers(1, &m_meshBuffer);
+		glDeleteBuffers(1, &m_fadeBuffer);
+		m_objectBuffer = 0;
+		m_meshBuffer = 0;
+		m_fadeBuffer = 0;
+	}
+	if (m_depthTexture != 0)
+	{
+		glDeleteTextures(1, &m_depthTexture);
+		m_depthTexture = 0;
+		m_depthWidth = 0;
+		m_depthHeight = 0;
+	}
+	if (m_pyramidTexture != 0)
+	{
+		glDeleteTextures(1, &m_pyramidTexture);
+		m_pyramidTexture = 0;
+		m_pyramidWidth = 0;
+		m_pyramidHeight = 0;
+		m_pyramidLevels = 0;
+	}
+	m_objectCount = 0;
+	m_culledCount = 0;
+	m_bPyramidValid = false;
+}
+
+/***********************************************************
+ *  SetObjects()
+ *
+ *  This method gives every culled object the next slot of
+ *  its batch, in object order, and uploads the objects with
+ *  the spheres and index ranges of the meshes.  Objects
+ *  without a batch or a known mesh are left to the CPU.
+ ***********************************************************/
+std::vector<unsigned char> GPUCulling::SetObjects(const std::vector<GPU_CULLING_OBJECT>& objects, const std::vector<glm::vec4>& meshSpheres,
+	const std::vector<unsigned char>& objectBatches, int batchCount, size_t* batchCounts)
+{
+	batchCount = std::min(batchCount, g_MaxBatches);
+	for (int batch = 0; batch < batchCount; batch++)
+	{
+		batchCounts[batch] = 0;
+	}
+
+	std::vector<GPU_CULL_OBJECT> cullObjects(objects.size());
+	std::vector<unsigned char> accepted(objects.size(), 0);
+	m_objectBatches.assign(objects.size(), -1);
+	m_objectSlots.assign(objects.size(), 0);
+	m_culledCount = 0;
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		GPU_CULL_OBJECT& cullObject = cullObjects[i];
+		cullObject.mesh = (uint32_t)objects[i].mesh;
+		cullObject.flags = objects[i].bPerspectiveOnly ? g_PerspectiveOnlyFlag : 0;
+		cullObject.impostor = objects[i].impostor;
+		cullObject.batch = -1;
+		cullObject.slot = 0;
+		cullObject.padding[0] = cullObject.padding[1] = cullObject.padding[2] = 0;
+
+		int batch = (i < objectBatches.size()) ? objectBatches[i] : batchCount;
+		if (objects[i].bCulled && (batch < batchCount) && ((size_t)objects[i].mesh < meshSpheres.size()))
+		{
+			cullObject.batch = batch;
+			cullObject.slot = (uint32_t)batchCounts[batch]++;
+			m_objectBatches[i] = cullObject.batch;
+			m_objectSlots[i] = cullObject.slot;
+			accepted[i] = 1;
+			m_culledCount++;
+		}
+	}
+	m_objectCount = objects.size();
+	m_batchCounts.assign(batchCounts, batchCounts + batchCount);
+	m_batchOffsets.assign(batchCount, 0);
+
+	std::vector<GPU_CULL_MESH> cullMeshes(meshSpheres.size());
+	for (size_t i = 0; i < meshSpheres.size(); i++)
+	{
+		const MESH_RANGE& range = m_pMeshLibrary->GetMeshRange((SCENE_MESH)i);
+		cullMeshes[i].sphere = meshSpheres[i];
+		cullMeshes[i].indexCount = range.indexCount;
+		cullMeshes[i].firstIndex = range.firstIndex;
+		cullMeshes[i].baseVertex = range.baseVertex;
+		cullMeshes[i].padding = 0;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(std::max<size_t>(cullObjects.size(), 1) * sizeof(GPU_CULL_OBJECT)),
+		cullObjects.empty() ? NULL : cullObjects.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_meshBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(std::max<size_t>(cullMeshes.size(), 1) * sizeof(GPU_CULL_MESH)),
+		cullMeshes.empty() ? NULL : cullMeshes.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return(accepted);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method takes the frustum planes of the frame the way
+ *  the CPU culling does.  The pyramid of an orthographic
+ *  frame is not built, and none is used in one.
+ ***********************************************************/
+void GPUCulling::BeginFrame(const glm::mat4& viewProjection, bool bOrthographic)
+{
+	EntityStore::ExtractFrustumPlanes(viewProjection, m_frustumPlanes);
+	m_viewProjection = viewProjection;
+	m_bOrthographic = bOrthographic;
+	m_impostorCount = 0;
+}
+
+/***********************************************************
+ *  SetImpostorFades()
+ *
+ *  This method uploads the frame's impostor fades into a
+ *  freshly allocated buffer.
+ ***********************************************************/
+void GPUCulling::SetImpostorFades(const float* fades, size_t count)
+{
+	m_impostorCount = (NULL != fades) ? count : 0;
+	if (m_impostorCount == 0)
+	{
+		return;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_fadeBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(count * sizeof(float)), fades, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method runs the cull shader with one invocation per
+ *  object and makes its commands visible to the draws that
+ *  follow.
+ ***********************************************************/
+void GPUCulling::Cull(GLuint drawDataBuffer, GLuint commandBuffer, const size_t* batchOffsets)
+{
+	if ((m_culledCount == 0) || (m_programs.cull == 0))
+	{
+		return;
+	}
+
+	for (size_t batch = 0; batch < m_batchOffsets.size(); batch++)
+	{
+		m_batchOffsets[batch] = (GLuint)batchOffsets[batch];
+	}
+	m_bFrameOcclusion = (m_settings.mode == GPU_CULLING_OCCLUSION) && m_bPyramidValid && !m_bOrthographic;
+
+	glUseProgram(m_programs.cull);
+	glUniform4fv(m_programs.frustumPlanes, 6, &m_frustumPlanes[0][0]);
+	glUniform1ui(m_programs.hiddenFlags, m_bOrthographic ? g_PerspectiveOnlyFlag : 0);
+	glUniform1uiv(m_programs.batchOffsets, (GLsizei)m_batchOffsets.size(), m_batchOffsets.data());
+	glUniform1ui(m_programs.objectCount, (GLuint)m_objectCount);
+	glUniform1ui(m_programs.impostorCount, (GLuint)m_impostorCount);
+	glUniform1i(m_programs.bOcclusion, m_bFrameOcclusion ? 1 : 0);
+	if (m_bFrameOcclusion)
+	{
+		glUniformMatrix4fv(m_programs.pyramidViewProjection, 1, GL_FALSE, &m_pyramidViewProjection[0][0]);
+		glUniform2f(m_programs.pyramidSize, (float)m_pyramidWidth, (float)m_pyramidHeight);
+		glUniform1i(m_programs.pyramidLevels, m_pyramidLevels);
+		glActiveTexture(GL_TEXTURE0 + g_PyramidUnit);
+		glBindTexture(GL_TEXTURE_2D, m_pyramidTexture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_DrawDataBinding, drawDataBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_ObjectBinding, m_objectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_MeshBinding, m_meshBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_FadeBinding, m_fadeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_CommandBinding, commandBuffer);
+
+	glDispatchCompute((GLuint)((m_objectCount + g_CullGroupSize - 1) / g_CullGroupSize), 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_CommandBinding, 0);
+	glUseProgram(0);
+}
+
+/***********************************************************
+ *  BuildPyramid()
+ *
+ *  This method copies the depth within the viewport and
+ *  reduces it level by level: every texel of a level keeps
+ *  the farthest depth of the texels it covers one level
+ *  down, rounded outwards, so the pyramid never claims a
+ *  surface nearer than the one drawn.
+ ***********************************************************/
+void GPUCulling::BuildPyramid()
+{
+	if ((m_settings.mode != GPU_CULLING_OCCLUSION) || (m_programs.pyramid == 0) || (m_culledCount == 0))
+	{
+		return;
+	}
+	if (m_bOrthographic)
+	{
+		m_bPyramidValid = false;
+		return;
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	if ((viewport[2] <= 0) || (viewport[3] <= 0))
+	{
+		m_bPyramidValid = false;
+		return;
+	}
+	ResizeTargets(viewport[2], viewport[3]);
+
+	glActiveTexture(GL_TEXTURE0 + g_PyramidUnit);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	glUseProgram(m_programs.pyramid);
+	int sourceWidth = viewport[2];
+	int sourceHeight = viewport[3];
+	for (int level = 0; level < m_pyramidLevels; level++)
+	{
+		// the finest level reads the depth copy, the others
+		// the level below them
+		if (level == 1)
+		{
+			glBindTexture(GL_TEXTURE_2D, m_pyramidTexture);
+		}
+		int width = std::max(m_pyramidWidth >> level, 1);
+		int height = std::max(m_pyramidHeight >> level, 1);
+		glUniform1i(m_programs.sourceLevel, std::max(level - 1, 0));
+		glUniform2i(m_programs.sourceSize, sourceWidth, sourceHeight);
+		glBindImageTexture(g_PyramidImageUnit, m_pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((GLuint)((width + g_PyramidGroupSize - 1) / g_PyramidGroupSize),
+			(GLuint)((height + g_PyramidGroupSize - 1) / g_PyramidGroupSize), 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		sourceWidth = width;
+		sourceHeight = height;
+	}
+
+	glBindImageTexture(g_PyramidImageUnit, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glUseProgram(0);
+
+	m_pyramidViewProjection = m_viewProjection;
+	m_bPyramidValid = true;
+}
+
+/***********************************************************
+ *  Validate()
+ *
+ *  This method reads the commands of the culled objects
+ *  back and compares each with the CPU's answer for the
+ *  object.  An object the GPU draws must be in the frustum
+ *  and not faded out; one in the frustum it leaves out is a
+ *  disagreement, unless the depth pyramid was in use - then
+ *  it counts as occluded, which the CPU cannot check.
+ ***********************************************************/
+void GPUCulling::Validate(GLuint commandBuffer, const unsigned char* expectedVisible)
+{
+	if ((m_culledCount == 0) || (m_programs.cull == 0))
+	{
+		return;
+	}
+
+	size_t commandEnd = 0;
+	for (size_t batch = 0; batch < m_batchOffsets.size(); batch++)
+	{
+		commandEnd = std::max(commandEnd, (size_t)m_batchOffsets[batch] + m_batchCounts[batch]);
+	}
+	if (m_validationCommands.size() < commandEnd * sizeof(GPU_DRAW_COMMAND))
+	{
+		m_validationCommands.resize(commandEnd * sizeof(GPU_DRAW_COMMAND));
+	}
+
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_COPY_READ_BUFFER, commandBuffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)(commandEnd * sizeof(GPU_DRAW_COMMAND)),
+		m_validationCommands.data());
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	const GPU_DRAW_COMMAND* commands = (const GPU_DRAW_COMMAND*)m_validationCommands.data();
+
+	unsigned long long mismatches = 0;
+	for (size_t i = 0; i < m_objectCount; i++)
+	{
+		if (m_objectBatches[i] < 0)
+			continue;
+
+		const GPU_DRAW_COMMAND& command = commands[m_batchOffsets[m_objectBatches[i]] + m_objectSlots[i]];
+		bool bDrawn = command.instanceCount != 0;
+		bool bExpected = expectedVisible[i] != 0;
+		m_expectedObjects += bExpected ? 1 : 0;
+		m_drawnObjects += bDrawn ? 1 : 0;
+		if ((bDrawn && !bExpected) || (bDrawn && (command.baseInstance != (GLuint)i)))
+			mismatches++;
+		else if (!bDrawn && bExpected && m_bFrameOcclusion)
+			m_occludedObjects++;
+		else if (!bDrawn && bExpected)
+			mismatches++;
+	}
+
+	m_validatedFrames++;
+	m_mismatches += mismatches;
+	if (mismatches > 0)
+	{
+		m_mismatchFrames++;
+		if (m_mismatchFrames <= g_PrintedMismatchFrames)
+		{
+			std::cout << "GPU culling check: " << mismatches << " objects differ from the CPU culling in frame "
+				<< m_validatedFrames << std::endl;
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildPrograms()
+ *
+ *  This method builds the cull and pyramid programs - the
+ *  pyramid one only for the occlusion mode - and looks up
+ *  the locations of their uniforms.
+ ***********************************************************/
+bool GPUCulling::BuildPrograms(CULLING_PROGRAMS& programs) const
+{
+	DeletePrograms(programs);
+	programs.cull = ShaderVariantCache::BuildComputeProgram(m_cullShaderFile.c_str());
+	if (programs.cull == 0)
+	{
+		return(false);
+	}
+	if (m_settings.mode == GPU_CULLING_OCCLUSION)
+	{
+		programs.pyramid = ShaderVariantCache::BuildComputeProgram(m_pyramidShaderFile.c_str());
+		if (programs.pyramid == 0)
+		{
+			DeletePrograms(programs);
+			return(false);
+		}
+		programs.sourceLevel = glGetUniformLocation(programs.pyramid, "sourceLevel");
+		programs.sourceSize = glGetUniformLocation(programs.pyramid, "sourceSize");
+	}
+
+	programs.frustumPlanes = glGetUniformLocation(programs.cull, "frustumPlanes");
+	programs.hiddenFlags = glGetUniformLocation(programs.cull, "hiddenFlags");
+	programs.batchOffsets = glGetUniformLocation(programs.cull, "batchOffsets");
+	programs.objectCount = glGetUniformLocation(programs.cull, "objectCount");
+	programs.impostorCount = glGetUniformLocation(programs.cull, "impostorCount");
+	programs.bOcclusion = glGetUniformLocation(programs.cull, "bOcclusion");
+	programs.pyramidViewProjection = glGetUniformLocation(programs.cull, "pyramidViewProjection");
+	programs.pyramidSize = glGetUniformLocation(programs.cull, "pyramidSize");
+	programs.pyramidLevels = glGetUniformLocation(programs.cull, "pyramidLevels");
+	return(true);
+}
+
+/***********************************************************
+ *  DeletePrograms()
+ *
+ *  This method frees the programs, if any, and clears the
+ *  locations of their uniforms.
+ ***********************************************************/
+void GPUCulling::DeletePrograms(CULLING_PROGRAMS& programs)
+{
+	if (programs.cull != 0)
+	{
+		glDeleteProgram(programs.cull);
+	}
+	if (programs.pyramid != 0)
+	{
+		glDeleteProgram(programs.pyramid);
+	}
+	programs.cull = 0;
+	programs.frustumPlanes = -1;
+	programs.hiddenFlags = -1;
+	programs.batchOffsets = -1;
+	programs.objectCount = -1;
+	programs.impostorCount = -1;
+	programs.bOcclusion = -1;
+	programs.pyramidViewProjection = -1;
+	programs.pyramidSize = -1;
+	programs.pyramidLevels = -1;
+	programs.pyramid = 0;
+	programs.sourceLevel = -1;
+	programs.sourceSize = -1;
+}
+
+/***********************************************************
+ *  ResizeTargets()
+ *
+ *  This method grows the depth copy to hold the viewport and
+ *  sizes the pyramid to the largest powers of two within it,
+ *  halved until the longer side is at most maxPyramidSize.
+ *  A new pyramid has no depth yet.
+ ***********************************************************/
+void GPUCulling::ResizeTargets(int width, int height)
+{
+	if ((width > m_depthWidth) || (height > m_depthHeight))
+	{
+		if (m_depthTexture != 0)
+		{
+			glDeleteTextures(1, &m_depthTexture);
+		}
+		m_depthWidth = std::max(width, m_depthWidth);
+		m_depthHeight = std::max(height, m_depthHeight);
+		glGenTextures(1, &m_depthTexture);
+		glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_depthWidth, m_depthHeight, 0,
+			GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	int pyramidWidth = FloorPowerOfTwo(width);
+	int pyramidHeight = FloorPowerOfTwo(height);
+	while (std::max(pyramidWidth, pyramidHeight) > std::max(m_settings.maxPyramidSize, 1))
+	{
+		pyramidWidth = std::max(pyramidWidth / 2, 1);
+		pyramidHeight = std::max(pyramidHeight / 2, 1);
+	}
+	if ((pyramidWidth == m_pyramidWidth) && (pyramidHeight == m_pyramidHeight))
+	{
+		return;
+	}
+
+	if (m_pyramidTexture != 0)
+	{
+		glDeleteTextures(1, &m_pyramidTexture);
+	}
+	m_pyramidWidth = pyramidWidth;
+	m_pyramidHeight = pyramidHeight;
+	m_pyramidLevels = 1;
+	while ((std::max(m_pyramidWidth, m_pyramidHeight) >> m_pyramidLevels) > 0)
+	{
+		m_pyramidLevels++;
+	}
+	glGenTextures(1, &m_pyramidTexture);
+	glBindTexture(GL_TEXTURE_2D, m_pyramidTexture);
+	glTexStorage2D(GL_TEXTURE_2D, m_pyramidLevels, GL_R32F, m_pyramidWidth, m_pyramidHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	m_bPyramidValid = false;
+}
+
+/***********************************************************
+ *  PrintReport()
+ *
+ *  This method prints how the GPU's results compared with
+ *  the CPU's over the validated frames.
+ ***********************************************************/
+void GPUCulling::PrintReport() const
+{
+	double frames = (double)m_validatedFrames;
+	std::cout << "GPU culling (" << ModeName(m_settings.mode) << ") check over " << m_validatedFrames << " frames:" << std::endl;
+	std::cout << "  objects per frame in view on the CPU: " << (double)m_expectedObjects / frames
+		<< ", drawn by the GPU: " << (double)m_drawnObjects / frames << std::endl;
+	if (m_settings.mode == GPU_CULLING_OCCLUSION)
+	{
+		std::cout << "  hidden by the depth pyramid per frame: " << (double)m_occludedObjects / frames << std::endl;
+	}
+	std::cout << "  disagreements: " << m_mismatches << " in " << m_mismatchFrames << " frames" << std::endl;
+}
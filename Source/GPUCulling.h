@@ -0,0 +1,248 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuculling.h
+// ============
+// cull the opaque objects of the multi-draw path in a compute shader -
+// against the view frustum and the previous frame's depth pyramid - and
+// write their indirect commands on the GPU
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshLibrary.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  GPU_CULLING_MODE
+ *
+ *  What the compute pass tests the objects against.
+ ***********************************************************/
+enum GPU_CULLING_MODE
+{
+	// nothing - the CPU culls every object
+	GPU_CULLING_OFF,
+	// the view frustum
+	GPU_CULLING_FRUSTUM,
+	// the view frustum, then the depth of the previous frame
+	GPU_CULLING_OCCLUSION
+};
+
+/***********************************************************
+ *  GPU_CULLING_SETTINGS
+ *
+ *  Configuration of the GPU culling, filled from the command
+ *  line in main().
+ ***********************************************************/
+struct GPU_CULLING_SETTINGS
+{
+	GPU_CULLING_MODE mode;
+	// longest side of the depth pyramid's finest level (a
+	// power of two)
+	int maxPyramidSize;
+	// read the results back every frame and compare them with
+	// the CPU culling - for testing only, as it stalls
+	bool bValidate;
+};
+
+/***********************************************************
+ *  GPU_CULLING_OBJECT
+ *
+ *  What the scene tells about an object, in the order of the
+ *  per-object data.
+ ***********************************************************/
+struct GPU_CULLING_OBJECT
+{
+	SCENE_MESH mesh;
+	// the GPU culls and draws the object, and the scene leaves
+	// it out of the frame's AddDraw() calls; never set for
+	// objects of transparent materials
+	bool bCulled;
+	// only drawn in the perspective view
+	bool bPerspectiveOnly;
+	// impostor instance that replaces the object once it has
+	// faded in (-1 = none)
+	int32_t impostor;
+};
+
+/***********************************************************
+ *  GPUCulling
+ *
+ *  Tests the bounding spheres of the objects in a compute
+ *  shader and writes their indirect commands, so no object
+ *  the GPU culls costs the CPU anything per frame and nothing
+ *  is read back:
+ *
+ *  - the objects, their batch and their place within it, and
+ *    the bounding sphere and index range of every mesh are
+ *    uploaded once; the sphere is moved by the object's model
+ *    matrix from the per-object data exactly as the scene
+ *    moves the entity bounds for the CPU culling
+ *  - every object has a fixed command slot in its batch, after
+ *    the commands the CPU added, so the shader writes a whole
+ *    command with one instance or none - no counters, and the
+ *    commands come out in the same order every frame.  That
+ *    order is the objects', not front to back: the view depth
+ *    sort of the CPU's visible list does not reach them, so
+ *    they get less from the early depth test - the depth
+ *    pre-pass makes up for it where it pays
+ *  - objects whose impostor has fully faded in are dropped,
+ *    with the fades the scene computes for the impostors
+ *
+ *  In the occlusion mode the depth of everything opaque is
+ *  copied after it is drawn and reduced into a pyramid of
+ *  the farthest depth per texel.  The next frame projects the
+ *  box around each sphere with that frame's camera and
+ *  drops the object if the box's nearest depth lies behind
+ *  the farthest depth of the pyramid texels covering it.
+ *  The test is one frame late: an object that comes into
+ *  view from behind an occluder as the camera moves appears
+ *  a frame after it should.  Boxes reaching past the
+ *  previous frame's view are kept, as the pyramid knows
+ *  nothing of what is there.
+ *
+ *  All methods must be called on the thread that owns the GL
+ *  context (the render thread).
+ ***********************************************************/
+class GPUCulling
+{
+public:
+	// constructor
+	GPUCulling(const MeshLibrary* pMeshLibrary, const GPU_CULLING_SETTINGS& settings);
+	// destructor - prints the report of the validation
+	~GPUCulling();
+
+	// default settings: off, a pyramid of at most 1024 texels
+	// across, no validation
+	static GPU_CULLING_SETTINGS DefaultSettings();
+	// name of a mode, for messages
+	static const char* ModeName(GPU_CULLING_MODE mode);
+
+	// build the compute programs and the buffers
+	bool Initialize(const char* cullShaderFile, const char* pyramidShaderFile);
+	// build the programs from the shader files beside the
+	// current ones; ApplyShaders() switches to them and
+	// DiscardShaders() drops them
+	bool BuildShaders();
+	void ApplyShaders();
+	void DiscardShaders();
+	// free the GL objects
+	void Destroy();
+
+	// upload the objects and the bounding spheres of the meshes
+	// (xyz = center, w = radius, by SCENE_MESH), with the batch
+	// of every object; counts the objects of each batch the
+	// GPU draws into batchCounts and returns one byte per
+	// object, set for the objects it culls and draws
+	std::vector<unsigned char> SetObjects(const std::vector<GPU_CULLING_OBJECT>& objects, const std::vector<glm::vec4>& meshSpheres,
+		const std::vector<unsigned char>& objectBatches, int batchCount, size_t* batchCounts);
+	// true if any object is culled here
+	bool HasObjects() const { return m_culledCount > 0; }
+
+	// start a frame with its combined projection and view, and
+	// whether the view is orthographic
+	void BeginFrame(const glm::mat4& viewProjection, bool bOrthographic);
+	// fade of every impostor instance this frame (count 0 = no
+	// impostors are drawn)
+	void SetImpostorFades(const float* fades, size_t count);
+	// write the commands of the culled objects into the bound
+	// indirect buffer, batch b's starting at command
+	// batchOffsets[b]
+	void Cull(GLuint drawDataBuffer, GLuint commandBuffer, const size_t* batchOffsets);
+	// copy the depth of the bound framebuffer within the
+	// viewport and build the pyramid the next frame tests with
+	void BuildPyramid();
+	// compare the commands of the last Cull() with the objects
+	// the CPU finds in the frustum (one byte per object, with
+	// the faded out ones cleared); stalls until the GPU is done
+	void Validate(GLuint commandBuffer, const unsigned char* expectedVisible);
+
+private:
+	// the compute programs with the locations of their
+	// uniforms, looked up once when they are linked
+	struct CULLING_PROGRAMS
+	{
+		GLuint cull;
+		GLint frustumPlanes;
+		GLint hiddenFlags;
+		GLint batchOffsets;
+		GLint objectCount;
+		GLint impostorCount;
+		GLint bOcclusion;
+		GLint pyramidViewProjection;
+		GLint pyramidSize;
+		GLint pyramidLevels;
+		// none outside the occlusion mode
+		GLuint pyramid;
+		GLint sourceLevel;
+		GLint sourceSize;
+	};
+
+	// build both programs from the shader files
+	bool BuildPrograms(CULLING_PROGRAMS& programs) const;
+	// free the programs and clear their locations
+	static void DeletePrograms(CULLING_PROGRAMS& programs);
+	// create the depth copy and the pyramid for a viewport
+	void ResizeTargets(int width, int height);
+	void PrintReport() const;
+
+	const MeshLibrary* m_pMeshLibrary;
+	GPU_CULLING_SETTINGS m_settings;
+	std::string m_cullShaderFile;
+	std::string m_pyramidShaderFile;
+	CULLING_PROGRAMS m_programs;
+	// built by BuildShaders() and not applied yet
+	CULLING_PROGRAMS m_newPrograms;
+
+	// shader storage buffers: the objects, the meshes and the
+	// impostor fades
+	GLuint m_objectBuffer;
+	GLuint m_meshBuffer;
+	GLuint m_fadeBuffer;
+	size_t m_objectCount;
+	size_t m_culledCount;
+	// batch and slot of every object (batch -1 = not culled
+	// here) and the culled objects of each batch, for the
+	// validation
+	std::vector<int32_t> m_objectBatches;
+	std::vector<uint32_t> m_objectSlots;
+	std::vector<size_t> m_batchCounts;
+
+	// the frame
+	glm::vec4 m_frustumPlanes[6];
+	glm::mat4 m_viewProjection;
+	bool m_bOrthographic;
+	size_t m_impostorCount;
+	// first command slot of each batch's culled objects
+	std::vector<GLuint> m_batchOffsets;
+	// the objects of the frame were tested against the pyramid
+	bool m_bFrameOcclusion;
+
+	// the depth copy, in a texture as large as the largest
+	// viewport so far, and the pyramid of the last frame
+	GLuint m_depthTexture;
+	int m_depthWidth;
+	int m_depthHeight;
+	GLuint m_pyramidTexture;
+	int m_pyramidWidth;
+	int m_pyramidHeight;
+	int m_pyramidLevels;
+	// camera the pyramid was drawn with (none before the first
+	// frame, after a resize or after an orthographic frame)
+	glm::mat4 m_pyramidViewProjection;
+	bool m_bPyramidValid;
+
+	// validation report
+	unsigned long long m_validatedFrames;
+	unsigned long long m_expectedObjects;
+	unsigned long long m_drawnObjects;
+	unsigned long long m_occludedObjects;
+	unsigned long long m_mismatches;
+	unsigned long long m_mismatchFrames;
+	// the commands read back
+	std::vector<unsigned char> m_validationCommands;
+};
@@ -0,0 +1,224 @@
+///////////////////////////////////////////////////////////////////////////////
+// headlessrenderer.cpp
+// ============
+// draw the scene with the software rasterizer, without a window or GPU,
+// and write or check reference images
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HeadlessRenderer.h"
+#include "SceneManager.h"
+#include "ViewManager.h"
+#include "CameraPath.h"
+
+#include "stb_image.h"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+// declaration of global variables
+namespace
+{
+	// a pixel differs from the reference when a channel is off
+	// by more than this, in 8-bit steps
+	const int g_PixelTolerance = 16;
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings of a timing run of the
+ *  start view.
+ ***********************************************************/
+HEADLESS_RENDER_SETTINGS HeadlessRenderer::DefaultSettings()
+{
+	HEADLESS_RENDER_SETTINGS settings;
+	settings.rasterizer = SoftwareRasterizer::DefaultSettings();
+	settings.cameraPathFile = NULL;
+	settings.timeStep = 1.0f / 60.0f;
+	settings.frameCount = 60;
+	settings.outputFile = NULL;
+	settings.referenceFile = NULL;
+	settings.maxError = 2.0f;
+	return(settings);
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method prepares the scene for the software
+ *  rasterizer, draws the frames and handles the image of the
+ *  last one.  The view manager only builds the camera
+ *  matrices; it gets no window.
+ ***********************************************************/
+bool HeadlessRenderer::Run(const HEADLESS_RENDER_SETTINGS& settings)
+{
+	SoftwareRasterizer rasterizer(settings.rasterizer);
+	SceneManager sceneManager(NULL, &rasterizer);
+	sceneManager.PrepareScene();
+	ViewManager viewManager(NULL);
+
+	CameraPath cameraPath;
+	int frameCount = settings.frameCount;
+	if (NULL != settings.cameraPathFile)
+	{
+		if (!cameraPath.Load(settings.cameraPathFile))
+		{
+			return(false);
+		}
+		frameCount = (int)(cameraPath.GetDuration() / settings.timeStep) + 1;
+	}
+	std::cout << "Software rasterizer: " << rasterizer.GetWidth() << " x " << rasterizer.GetHeight() << " on "
+		<< rasterizer.GetThreadCount() << " threads, " << frameCount << " frames" << std::endl;
+
+	FrameStatistics statistics;
+	size_t triangleCount = 0;
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		if (NULL != settings.cameraPathFile)
+		{
+			CAMERA_KEYFRAME keyframe;
+			cameraPath.Sample(frame * settings.timeStep, keyframe);
+			viewManager.SetCameraKeyframe(keyframe);
+		}
+
+		SCENE_SNAPSHOT snapshot;
+		snapshot.frameIndex = (unsigned long long)frame + 1;
+		snapshot.simulationTime = frame * settings.timeStep;
+		snapshot.deltaTime = settings.timeStep;
+		snapshot.framebufferWidth = rasterizer.GetWidth();
+		snapshot.framebufferHeight = rasterizer.GetHeight();
+		viewManager.UpdateSceneSnapshot(snapshot);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		sceneManager.RenderScene(snapshot);
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		statistics.AddFrame(snapshot.frameIndex, milliseconds, 0.0);
+		triangleCount += rasterizer.GetTriangleCount();
+	}
+	statistics.PrintReport("Software rasterizer");
+	if (frameCount > 0)
+	{
+		std::cout << "  " << triangleCount / frameCount << " triangles per frame" << std::endl;
+	}
+
+	std::vector<unsigned char> pixels;
+	rasterizer.ReadPixels(pixels);
+	bool bSucceeded = true;
+	if (NULL != settings.outputFile)
+	{
+		if (WriteTGA(settings.outputFile, rasterizer.GetWidth(), rasterizer.GetHeight(), pixels))
+			std::cout << "Wrote " << settings.outputFile << std::endl;
+		else
+			bSucceeded = false;
+	}
+	if (NULL != settings.referenceFile)
+	{
+		float error = 0.0f;
+		size_t differentPixels = 0;
+		if (!CompareImage(settings.referenceFile, rasterizer.GetWidth(), rasterizer.GetHeight(), pixels, error,
+			differentPixels))
+		{
+			return(false);
+		}
+
+		bool bMatches = (error <= settings.maxError);
+		std::cout << "Reference " << settings.referenceFile << ": error " << error << " (at most " << settings.maxError
+			<< "), " << differentPixels << " pixels differ - " << (bMatches ? "match" : "MISMATCH") << std::endl;
+		bSucceeded = bSucceeded && bMatches;
+	}
+	return(bSucceeded);
+}
+
+/***********************************************************
+ *  WriteTGA()
+ *
+ *  This method writes an uncompressed 32-bit TGA image.  TGA
+ *  rows go bottom to top, so the rows are written as they
+ *  are, with the channels swapped to BGRA.
+ ***********************************************************/
+bool HeadlessRenderer::WriteTGA(const char* filename, int width, int height, const std::vector<unsigned char>& pixels)
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Could not write image:" << filename << std::endl;
+		return(false);
+	}
+
+	unsigned char header[18] = { 0 };
+	// uncompressed true color, 8 bits of alpha
+	header[2] = 2;
+	header[12] = (unsigned char)(width & 0xff);
+	header[13] = (unsigned char)(width >> 8);
+	header[14] = (unsigned char)(height & 0xff);
+	header[15] = (unsigned char)(height >> 8);
+	header[16] = 32;
+	header[17] = 8;
+	file.write((const char*)header, sizeof(header));
+
+	std::vector<unsigned char> row((size_t)width * 4);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* source = &pixels[(size_t)y * width * 4];
+		for (int x = 0; x < width; x++)
+		{
+			row[x * 4] = source[x * 4 + 2];
+			row[x * 4 + 1] = source[x * 4 + 1];
+			row[x * 4 + 2] = source[x * 4];
+			row[x * 4 + 3] = source[x * 4 + 3];
+		}
+		file.write((const char*)row.data(), row.size());
+	}
+	return(file.good());
+}
+
+/***********************************************************
+ *  CompareImage()
+ *
+ *  This method compares an image with an image file, e.g. a
+ *  reference written by an earlier run.
+ ***********************************************************/
+bool HeadlessRenderer::CompareImage(const char* filename, int width, int height, const std::vector<unsigned char>& pixels,
+	float& error, size_t& differentPixels)
+{
+	int fileWidth = 0;
+	int fileHeight = 0;
+	int channels = 0;
+	// bottom row first, like the image
+	stbi_set_flip_vertically_on_load(true);
+	unsigned char* reference = stbi_load(filename, &fileWidth, &fileHeight, &channels, 4);
+	if (NULL == reference)
+	{
+		std::cout << "Could not load image:" << filename << std::endl;
+		return(false);
+	}
+	if ((fileWidth != width) || (fileHeight != height))
+	{
+		std::cout << "Reference " << filename << " is " << fileWidth << " x " << fileHeight << ", not " << width << " x "
+			<< height << std::endl;
+		stbi_image_free(reference);
+		return(false);
+	}
+
+	double squaredSum = 0.0;
+	differentPixels = 0;
+	for (size_t i = 0; i < (size_t)width * height; i++)
+	{
+		bool bDifferent = false;
+		for (int channel = 0; channel < 3; channel++)
+		{
+			int difference = (int)pixels[i * 4 + channel] - (int)reference[i * 4 + channel];
+			squaredSum += (double)(difference * difference);
+			bDifferent = bDifferent || (std::abs(difference) > g_PixelTolerance);
+		}
+		if (bDifferent)
+			differentPixels++;
+	}
+	stbi_image_free(reference);
+
+	error = (float)std::sqrt(squaredSum / ((double)width * height * 3.0));
+	return(true);
+}
@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// headlessrenderer.h
+// ============
+// draw the scene with the software rasterizer, without a window or GPU,
+// and write or check reference images
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SoftwareRasterizer.h"
+
+#include <vector>
+
+/***********************************************************
+ *  HEADLESS_RENDER_SETTINGS
+ *
+ *  What to draw and where the image goes.
+ ***********************************************************/
+struct HEADLESS_RENDER_SETTINGS
+{
+	SOFTWARE_RASTERIZER_SETTINGS rasterizer;
+	// camera path to follow with a fixed time step (NULL =
+	// frameCount frames of the start view)
+	const char* cameraPathFile;
+	float timeStep;
+	int frameCount;
+	// image file the last frame is written to (NULL = none)
+	const char* outputFile;
+	// image the last frame is compared with (NULL = none), and
+	// the root mean square error, in 8-bit steps, it may have
+	const char* referenceFile;
+	float maxError;
+};
+
+/***********************************************************
+ *  HeadlessRenderer
+ *
+ *  Prepares the scene with the software rasterizer as its
+ *  render backend and draws it from the start view or along
+ *  a recorded camera path, reporting the frame times.  The
+ *  last frame can be written as a TGA image and compared
+ *  with a reference image from an earlier run, so image
+ *  regressions can be caught on machines without a GPU.
+ ***********************************************************/
+class HeadlessRenderer
+{
+public:
+	// default settings: 60 frames of the start view
+	static HEADLESS_RENDER_SETTINGS DefaultSettings();
+	// draw the frames; false if the scene could not be drawn,
+	// the image not written or the comparison failed
+	static bool Run(const HEADLESS_RENDER_SETTINGS& settings);
+
+	// write RGBA rows, bottom row first, as a 32-bit TGA image
+	static bool WriteTGA(const char* filename, int width, int height, const std::vector<unsigned char>& pixels);
+	// root mean square error of the RGB channels of an image
+	// and an image file; false if the file cannot be read or
+	// has another size
+	static bool CompareImage(const char* filename, int width, int height, const std::vector<unsigned char>& pixels,
+		float& error, size_t& differentPixels);
+};
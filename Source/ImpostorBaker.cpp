@@ -0,0 +1,477 @@
+///////////////////////////////////////////////////////////////////////////////
+// impostorbaker.cpp
+// ============
+// render scene object archetypes from many view directions into impostor
+// atlases, on the CPU, with an on-disk cache of the results
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImpostorBaker.h"
+#include "SoftwareRasterizer.h"
+#include "FileUtility.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <glm/gtx/transform.hpp>
+
+#include "stb_image.h"
+
+// declaration of global variables
+namespace
+{
+	const char g_CacheMagic[4] = { 'T', 'G', 'I', 'M' };
+	// bump whenever the baked images change
+	const uint32_t g_CacheVersion = 2;
+	// passes of color spreading into the empty texels
+	const int g_DilationPasses = 4;
+	// texture slots of the software rasterizer
+	const int g_TextureSlots = 16;
+
+	/***********************************************************
+	 *  FrameBasis()
+	 *
+	 *  Right and up axes of the view of a frame direction, with
+	 *  world up kept up; matches FrameBasis() in the impostor
+	 *  shader.
+	 ***********************************************************/
+	void FrameBasis(const glm::vec3& direction, glm::vec3& right, glm::vec3& up)
+	{
+		glm::vec3 forward = -direction;
+		right = glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f));
+		if (glm::dot(right, right) < 1e-8f)
+			right = glm::vec3(1.0f, 0.0f, 0.0f);
+		right = glm::normalize(right);
+		up = glm::cross(right, forward);
+	}
+
+	/***********************************************************
+	 *  DrawArchetype()
+	 *
+	 *  Draws every part of an archetype into a frame of the
+	 *  rasterizer, unlit, with the texture slot of its image.
+	 ***********************************************************/
+	void DrawArchetype(SoftwareRasterizer& rasterizer, const IMPOSTOR_ARCHETYPE& archetype,
+		const std::vector<int>& partSlots, const SCENE_SNAPSHOT& snapshot)
+	{
+		rasterizer.BeginFrame(snapshot);
+		for (size_t i = 0; i < archetype.parts.size(); i++)
+		{
+			RENDER_OBJECT object;
+			object.model = archetype.parts[i].transform;
+			object.uvScale = archetype.parts[i].uvScale;
+			object.textureSlot = partSlots[i];
+			object.materialIndex = -1;
+			rasterizer.DrawMesh(archetype.parts[i].mesh, object);
+		}
+		rasterizer.EndFrame();
+	}
+
+	/***********************************************************
+	 *  EncodeByte()
+	 *
+	 *  A value in [0, 1] as a texel channel.
+	 ***********************************************************/
+	unsigned char EncodeByte(float value)
+	{
+		return((unsigned char)(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f));
+	}
+}
+
+/***********************************************************
+ *  ImpostorBaker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ImpostorBaker::ImpostorBaker(const char* cacheDirectory, int framesPerSide, int frameSize)
+{
+	m_directory = cacheDirectory;
+	m_framesPerSide = std::max(framesPerSide, 2);
+	m_frameSize = std::max(frameSize, 8);
+}
+
+/***********************************************************
+ *  FrameDirection()
+ *
+ *  This method returns the view direction of a frame.  The
+ *  frame's position in the atlas, from -1 to 1, is unfolded
+ *  from the hemi-octahedron: the centre looks straight down
+ *  and the edges of the atlas lie on the horizon.
+ ***********************************************************/
+glm::vec3 ImpostorBaker::FrameDirection(int frameX, int frameY, int framesPerSide)
+{
+	glm::vec2 t = glm::vec2((float)frameX, (float)frameY) / (float)(framesPerSide - 1) * 2.0f - 1.0f;
+	glm::vec2 p = glm::vec2(t.x + t.y, t.x - t.y) * 0.5f;
+	glm::vec3 direction(p.x, 1.0f - std::fabs(p.x) - std::fabs(p.y), p.y);
+	return(glm::normalize(direction));
+}
+
+/***********************************************************
+ *  GetAtlas()
+ *
+ *  This method loads the archetype's atlas from the cache,
+ *  baking and storing it if it is missing or stale.
+ ***********************************************************/
+bool ImpostorBaker::GetAtlas(const IMPOSTOR_ARCHETYPE& archetype, IMPOSTOR_ATLAS& atlas) const
+{
+	if (Load(archetype, atlas))
+	{
+		return(true);
+	}
+
+	if (!Bake(archetype, atlas))
+	{
+		return(false);
+	}
+	Store(archetype, atlas);
+	return(true);
+}
+
+/***********************************************************
+ *  Bake()
+ *
+ *  This method draws the archetype into every frame of the
+ *  atlas with the software rasterizer: orthographic views of
+ *  the bounding sphere, once with the unlit texture color
+ *  and once with the normal of the nearest surface.  Back
+ *  faces give the normal turned towards the viewer, as the
+ *  open meshes show them.
+ ***********************************************************/
+bool ImpostorBaker::Bake(const IMPOSTOR_ARCHETYPE& archetype, IMPOSTOR_ATLAS& atlas) const
+{
+	const int size = m_frameSize;
+	SOFTWARE_RASTERIZER_SETTINGS settings = SoftwareRasterizer::DefaultSettings();
+	settings.width = size;
+	settings.height = size;
+	SoftwareRasterizer rasterizer(settings);
+	rasterizer.LoadMeshes();
+
+	// the bounds of the parts in the archetype's space, and a
+	// texture slot for each image they use
+	std::vector<std::string> imageFiles;
+	std::vector<int> partSlots(archetype.parts.size(), -1);
+	std::vector<glm::vec3> positions;
+	glm::vec3 boundsMin(1e30f);
+	glm::vec3 boundsMax(-1e30f);
+	stbi_set_flip_vertically_on_load(true);
+	for (size_t i = 0; i < archetype.parts.size(); i++)
+	{
+		const IMPOSTOR_PART& part = archetype.parts[i];
+		MESH_DATA mesh;
+		MeshGenerator::Generate(MeshGenerator::DefaultParams(part.mesh), mesh);
+
+		size_t vertexCount = mesh.vertices.size() / MESH_FLOATS_PER_VERTEX;
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			const float* source = &mesh.vertices[v * MESH_FLOATS_PER_VERTEX];
+			glm::vec3 position = glm::vec3(part.transform * glm::vec4(source[0], source[1], source[2], 1.0f));
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+			positions.push_back(position);
+		}
+
+		for (size_t j = 0; (j < imageFiles.size()) && (partSlots[i] < 0); j++)
+		{
+			if (imageFiles[j] == part.textureFile)
+				partSlots[i] = (int)j;
+		}
+		if ((partSlots[i] >= 0) || part.textureFile.empty())
+		{
+			continue;
+		}
+		if ((int)imageFiles.size() >= g_TextureSlots)
+		{
+			std::cout << "Impostor archetype " << archetype.name << " uses more than " << g_TextureSlots
+				<< " images, drawing " << part.textureFile << " untextured" << std::endl;
+			continue;
+		}
+
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		unsigned char* pixels = stbi_load(part.textureFile.c_str(), &width, &height, &channels, 4);
+		if (NULL == pixels)
+		{
+			std::cout << "Could not load image:" << part.textureFile << std::endl;
+			continue;
+		}
+		unsigned int texture = rasterizer.CreateTexture(pixels, width, height, 4);
+		stbi_image_free(pixels);
+		partSlots[i] = (int)imageFiles.size();
+		rasterizer.BindTexture(partSlots[i], texture);
+		imageFiles.push_back(part.textureFile);
+	}
+	if (boundsMin.x > boundsMax.x)
+	{
+		std::cout << "Impostor archetype " << archetype.name << " has no geometry" << std::endl;
+		return(false);
+	}
+
+	atlas.framesPerSide = m_framesPerSide;
+	atlas.frameSize = m_frameSize;
+	atlas.center = (boundsMin + boundsMax) * 0.5f;
+	atlas.radius = 0.0f;
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		atlas.radius = std::max(atlas.radius, glm::length(positions[i] - atlas.center));
+	}
+	// a texel of margin around the silhouette
+	atlas.radius *= 1.0f + 2.0f / m_frameSize;
+
+	int atlasSize = atlas.AtlasSize();
+	atlas.color.assign((size_t)atlasSize * atlasSize * 4, 0);
+	atlas.normal.assign((size_t)atlasSize * atlasSize * 4, 0);
+
+	std::vector<unsigned char> colorPixels;
+	std::vector<unsigned char> normalPixels;
+	std::vector<unsigned char> covered;
+	std::vector<glm::vec3> frameColor((size_t)size * size);
+	std::vector<glm::vec3> frameNormal((size_t)size * size);
+	for (int frameY = 0; frameY < m_framesPerSide; frameY++)
+	{
+		for (int frameX = 0; frameX < m_framesPerSide; frameX++)
+		{
+			glm::vec3 direction = FrameDirection(frameX, frameY, m_framesPerSide);
+			glm::vec3 right;
+			glm::vec3 up;
+			FrameBasis(direction, right, up);
+
+			// looking at the centre from the frame's direction, with
+			// the bounding sphere filling the frame and lying
+			// between the near and far planes
+			SCENE_SNAPSHOT snapshot = SCENE_SNAPSHOT();
+			snapshot.viewPosition = atlas.center + direction * (atlas.radius * 2.0f);
+			snapshot.view = glm::lookAt(snapshot.viewPosition, atlas.center, up);
+			snapshot.projection = glm::ortho(-atlas.radius, atlas.radius, -atlas.radius, atlas.radius,
+				atlas.radius, atlas.radius * 3.0f);
+			snapshot.bOrthographic = true;
+			snapshot.framebufferWidth = size;
+			snapshot.framebufferHeight = size;
+
+			rasterizer.SetOutput(SOFTWARE_OUTPUT_SHADED);
+			DrawArchetype(rasterizer, archetype, partSlots, snapshot);
+			rasterizer.ReadPixels(colorPixels);
+			rasterizer.ReadCoverage(covered);
+			rasterizer.SetOutput(SOFTWARE_OUTPUT_NORMAL);
+			DrawArchetype(rasterizer, archetype, partSlots, snapshot);
+			rasterizer.ReadPixels(normalPixels);
+
+			for (size_t texel = 0; texel < frameColor.size(); texel++)
+			{
+				const unsigned char* color = &colorPixels[texel * 4];
+				const unsigned char* normal = &normalPixels[texel * 4];
+				frameColor[texel] = glm::vec3(color[0], color[1], color[2]) / 255.0f;
+				frameNormal[texel] = glm::vec3(normal[0], normal[1], normal[2]) / 255.0f * 2.0f - 1.0f;
+			}
+
+			// spread the colors into the empty texels next to the
+			// silhouette, one ring per pass
+			std::vector<unsigned char> filled = covered;
+			for (int pass = 0; pass < g_DilationPasses; pass++)
+			{
+				std::vector<unsigned char> nextFilled = filled;
+				for (int y = 0; y < size; y++)
+				{
+					for (int x = 0; x < size; x++)
+					{
+						size_t texel = (size_t)y * size + x;
+						if (filled[texel])
+							continue;
+
+						glm::vec3 colorSum(0.0f);
+						glm::vec3 normalSum(0.0f);
+						int count = 0;
+						for (int n = 0; n < 9; n++)
+						{
+							int nx = x + n % 3 - 1;
+							int ny = y + n / 3 - 1;
+							if ((nx < 0) || (ny < 0) || (nx >= size) || (ny >= size) || !filled[(size_t)ny * size + nx])
+								continue;
+							colorSum += frameColor[(size_t)ny * size + nx];
+							normalSum += frameNormal[(size_t)ny * size + nx];
+							count++;
+						}
+						if (count > 0)
+						{
+							frameColor[texel] = colorSum / (float)count;
+							frameNormal[texel] = normalSum / (float)count;
+							nextFilled[texel] = 1;
+						}
+					}
+				}
+				filled.swap(nextFilled);
+			}
+
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					size_t texel = (size_t)y * size + x;
+					size_t atlasTexel = ((size_t)(frameY * size + y) * atlasSize + (size_t)(frameX * size + x)) * 4;
+					glm::vec3 color = filled[texel] ? frameColor[texel] : glm::vec3(0.0f);
+					glm::vec3 normal = filled[texel] ? glm::normalize(frameNormal[texel]) : direction;
+					unsigned char coverage = covered[texel] ? 255 : 0;
+					atlas.color[atlasTexel] = EncodeByte(color.r);
+					atlas.color[atlasTexel + 1] = EncodeByte(color.g);
+					atlas.color[atlasTexel + 2] = EncodeByte(color.b);
+					atlas.color[atlasTexel + 3] = coverage;
+					atlas.normal[atlasTexel] = EncodeByte(normal.x * 0.5f + 0.5f);
+					atlas.normal[atlasTexel + 1] = EncodeByte(normal.y * 0.5f + 0.5f);
+					atlas.normal[atlasTexel + 2] = EncodeByte(normal.z * 0.5f + 0.5f);
+					atlas.normal[atlasTexel + 3] = coverage;
+				}
+			}
+		}
+	}
+
+	std::cout << "Baked impostor " << archetype.name << ": " << m_framesPerSide * m_framesPerSide << " views of "
+		<< size << " x " << size << " texels" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  ArchetypeKey()
+ *
+ *  This method hashes everything the atlas depends on: the
+ *  parts, the atlas layout and the baker version.
+ ***********************************************************/
+uint64_t ImpostorBaker::ArchetypeKey(const IMPOSTOR_ARCHETYPE& archetype) const
+{
+	uint64_t hash = HASH_SEED;
+	hash = HashBytes(hash, &g_CacheVersion, sizeof(g_CacheVersion));
+	hash = HashBytes(hash, &m_framesPerSide, sizeof(m_framesPerSide));
+	hash = HashBytes(hash, &m_frameSize, sizeof(m_frameSize));
+	for (size_t i = 0; i < archetype.parts.size(); i++)
+	{
+		const IMPOSTOR_PART& part = archetype.parts[i];
+		uint64_t meshKey = MeshGenerator::ParamsKey(MeshGenerator::DefaultParams(part.mesh));
+		hash = HashBytes(hash, &meshKey, sizeof(meshKey));
+		for (int column = 0; column < 4; column++)
+		{
+			glm::vec4 values = part.transform[column];
+			hash = HashBytes(hash, &values[0], 4 * sizeof(float));
+		}
+		hash = HashBytes(hash, part.textureFile.c_str(), part.textureFile.size() + 1);
+		hash = HashBytes(hash, &part.uvScale[0], 2 * sizeof(float));
+	}
+	return(hash);
+}
+
+/***********************************************************
+ *  CacheFilename()
+ *
+ *  This method returns the cache file path of an archetype,
+ *  e.g. "ImpostorCache/5d2c41e0a9b37f18.impostor".
+ ***********************************************************/
+std::string ImpostorBaker::CacheFilename(const IMPOSTOR_ARCHETYPE& archetype) const
+{
+	std::ostringstream name;
+	name << m_directory << "/" << std::hex << std::setw(16) << std::setfill('0') << ArchetypeKey(archetype)
+		<< ".impostor";
+	return(name.str());
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method reads a cached atlas and validates it.
+ ***********************************************************/
+bool ImpostorBaker::Load(const IMPOSTOR_ARCHETYPE& archetype, IMPOSTOR_ATLAS& atlas) const
+{
+	std::string filename = CacheFilename(archetype);
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file)
+	{
+		return(false);
+	}
+
+	IMPOSTOR_CACHE_HEADER header;
+	file.read((char*)&header, sizeof(header));
+	if (!file.good() ||
+		(memcmp(header.magic, g_CacheMagic, sizeof(g_CacheMagic)) != 0) ||
+		(header.version != g_CacheVersion) ||
+		(header.key != ArchetypeKey(archetype)) ||
+		(header.framesPerSide != m_framesPerSide) ||
+		(header.frameSize != m_frameSize))
+	{
+		std::cout << "Impostor cache file is stale:" << filename << std::endl;
+		return(false);
+	}
+
+	atlas.framesPerSide = header.framesPerSide;
+	atlas.frameSize = header.frameSize;
+	atlas.center = glm::vec3(header.center[0], header.center[1], header.center[2]);
+	atlas.radius = header.radius;
+	size_t imageBytes = (size_t)atlas.AtlasSize() * atlas.AtlasSize() * 4;
+	atlas.color.resize(imageBytes);
+	atlas.normal.resize(imageBytes);
+	file.read((char*)atlas.color.data(), imageBytes);
+	file.read((char*)atlas.normal.data(), imageBytes);
+	if (!file.good() ||
+		(Checksum(Checksum(CHECKSUM_SEED, atlas.color.data(), imageBytes), atlas.normal.data(), imageBytes) != header.checksum))
+	{
+		std::cout << "Impostor cache file is corrupt:" << filename << std::endl;
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Store()
+ *
+ *  This method writes an atlas to the cache, through a
+ *  temporary file like the mesh cache.
+ ***********************************************************/
+bool ImpostorBaker::Store(const IMPOSTOR_ARCHETYPE& archetype, const IMPOSTOR_ATLAS& atlas) const
+{
+	MakeDirectory(m_directory);
+
+	IMPOSTOR_CACHE_HEADER header;
+	memcpy(header.magic, g_CacheMagic, sizeof(g_CacheMagic));
+	header.version = g_CacheVersion;
+	header.key = ArchetypeKey(archetype);
+	header.framesPerSide = atlas.framesPerSide;
+	header.frameSize = atlas.frameSize;
+	header.center[0] = atlas.center.x;
+	header.center[1] = atlas.center.y;
+	header.center[2] = atlas.center.z;
+	header.radius = atlas.radius;
+	header.checksum = Checksum(Checksum(CHECKSUM_SEED, atlas.color.data(), atlas.color.size()),
+		atlas.normal.data(), atlas.normal.size());
+	header.reserved = 0;
+
+	std::string filename = CacheFilename(archetype);
+	std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream file(tempFilename.c_str(), std::ios::binary);
+		if (!file)
+		{
+			std::cout << "Could not create impostor cache file:" << tempFilename << std::endl;
+			return(false);
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)atlas.color.data(), atlas.color.size());
+		file.write((const char*)atlas.normal.data(), atlas.normal.size());
+		if (!file.good())
+		{
+			std::cout << "Could not write impostor cache file:" << tempFilename << std::endl;
+			return(false);
+		}
+	}
+
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::cout << "Could not replace impostor cache file:" << filename << std::endl;
+		std::remove(tempFilename.c_str());
+		return(false);
+	}
+
+	return(true);
+}
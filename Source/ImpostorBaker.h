@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+// impostorbaker.h
+// ============
+// render scene object archetypes from many view directions into impostor
+// atlases, on the CPU, with an on-disk cache of the results
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshGenerator.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  IMPOSTOR_PART
+ *
+ *  One mesh of an archetype, placed in the archetype's own
+ *  space, with the image file of its texture.
+ ***********************************************************/
+struct IMPOSTOR_PART
+{
+	SCENE_MESH mesh;
+	glm::mat4 transform;
+	std::string textureFile;
+	glm::vec2 uvScale;
+};
+
+/***********************************************************
+ *  IMPOSTOR_ARCHETYPE
+ *
+ *  A shape that is placed many times in the scene, e.g. a
+ *  topiary of a given height and radius.
+ ***********************************************************/
+struct IMPOSTOR_ARCHETYPE
+{
+	// for messages only
+	std::string name;
+	std::vector<IMPOSTOR_PART> parts;
+};
+
+/***********************************************************
+ *  IMPOSTOR_ATLAS
+ *
+ *  The baked views of an archetype: framesPerSide x
+ *  framesPerSide frames of frameSize texels, bottom row
+ *  first.  Frame (x, y) shows the archetype as seen from
+ *  ImpostorBaker::FrameDirection(x, y), scaled so its
+ *  bounding sphere fills the frame.
+ ***********************************************************/
+struct IMPOSTOR_ATLAS
+{
+	int framesPerSide;
+	int frameSize;
+	// bounding sphere in the archetype's space
+	glm::vec3 center;
+	float radius;
+	// rgb = texture color, a = coverage
+	std::vector<unsigned char> color;
+	// rgb = normal in the archetype's space * 0.5 + 0.5,
+	// a = coverage
+	std::vector<unsigned char> normal;
+
+	// texels along a side of the atlas
+	int AtlasSize() const { return framesPerSide * frameSize; }
+};
+
+/***********************************************************
+ *  ImpostorBaker
+ *
+ *  Bakes impostor atlases with the software rasterizer of
+ *  the headless backend: the archetype's meshes come from
+ *  the mesh generator and its textures are read with
+ *  stb_image, so baking needs no window, GL context or GPU
+ *  and runs the same on a build machine as at startup.
+ *
+ *  The view directions cover the upper hemisphere in a
+ *  hemi-octahedral layout, so neighbouring frames are
+ *  neighbouring directions and the horizon is on the edge
+ *  of the atlas.  Texels next to the silhouette get the
+ *  color of their covered neighbours, so filtering at the
+ *  edge does not bring in black.
+ *
+ *  Atlases are stored in a cache directory, one file per
+ *  archetype and layout, and only baked when missing.
+ ***********************************************************/
+class ImpostorBaker
+{
+public:
+	// constructor
+	ImpostorBaker(const char* cacheDirectory, int framesPerSide, int frameSize);
+
+	// the atlas of an archetype from the cache, or baked (and
+	// stored) if it is not there
+	bool GetAtlas(const IMPOSTOR_ARCHETYPE& archetype, IMPOSTOR_ATLAS& atlas) const;
+	// bake an atlas without the cache
+	bool Bake(const IMPOSTOR_ARCHETYPE& archetype, IMPOSTOR_ATLAS& atlas) const;
+
+	// direction from the archetype towards the viewer of a
+	// frame; matches FrameDirection() in the impostor shader
+	static glm::vec3 FrameDirection(int frameX, int frameY, int framesPerSide);
+
+private:
+	struct IMPOSTOR_CACHE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		int32_t framesPerSide;
+		int32_t frameSize;
+		float center[3];
+		float radius;
+		// 32-bit FNV-1a of everything after the header
+		uint32_t checksum;
+		uint32_t reserved;
+	};
+
+	// 64-bit key of the archetype and the atlas layout
+	uint64_t ArchetypeKey(const IMPOSTOR_ARCHETYPE& archetype) const;
+	std::string CacheFilename(const IMPOSTOR_ARCHETYPE& archetype) const;
+	bool Load(const IMPOSTOR_ARCHETYPE& archetype, IMPOSTOR_ATLAS& atlas) const;
+	bool Store(const IMPOSTOR_ARCHETYPE& archetype, const IMPOSTOR_ATLAS& atlas) const;
+
+	std::string m_directory;
+	int m_framesPerSide;
+	int m_frameSize;
+};
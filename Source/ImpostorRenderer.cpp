@@ -0,0 +1,292 @@
+///////////////////////////////////////////////////////////////////////////////
+// impostorrenderer.cpp
+// ============
+// draw distant objects as camera-facing quads textured from their baked
+// impostor atlases, cross-faded with the meshes
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImpostorRenderer.h"
+
+#include <iostream>
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// binding points used by the impostor shaders, after the
+	// indirect renderer's and the terrain's
+	const GLuint g_InstanceBinding = 3;
+	const GLuint g_ColorUnit = 19;
+	const GLuint g_NormalUnit = 20;
+	// coarsest mip level of the atlases - the coarser ones would
+	// mix neighbouring views
+	const int g_MaxMipLevel = 3;
+}
+
+/***********************************************************
+ *  ImpostorRenderer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ImpostorRenderer::ImpostorRenderer(const IMPOSTOR_SETTINGS& settings)
+{
+	m_settings = settings;
+	m_colorTexture = 0;
+	m_normalTexture = 0;
+	m_vertexArray = 0;
+	m_instanceBuffer = 0;
+	m_pInstances = NULL;
+	m_instanceCount = 0;
+	m_pShaders = NULL;
+}
+
+/***********************************************************
+ *  ~ImpostorRenderer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ImpostorRenderer::~ImpostorRenderer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings the scene uses.
+ ***********************************************************/
+IMPOSTOR_SETTINGS ImpostorRenderer::DefaultSettings()
+{
+	IMPOSTOR_SETTINGS settings;
+	settings.framesPerSide = 8;
+	settings.frameSize = 64;
+	settings.fadeStart = 15.0f;
+	settings.fadeEnd = 18.0f;
+	settings.maxInstances = 1024;
+	return(settings);
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method reads the shaders and creates the instance
+ *  buffer; the atlases come with SetAtlases().
+ ***********************************************************/
+bool ImpostorRenderer::Initialize(const char* vertexShaderFile, const char* fragmentShaderFile, const char* shaderCacheDirectory)
+{
+	Destroy();
+
+	m_vertexShaderFile = vertexShaderFile;
+	m_fragmentShaderFile = fragmentShaderFile;
+	m_shaderCacheDirectory = shaderCacheDirectory;
+	m_pShaders = new ShaderVariantCache(shaderCacheDirectory);
+	if (!m_pShaders->LoadSources(vertexShaderFile, fragmentShaderFile))
+	{
+		Destroy();
+		return(false);
+	}
+
+	glGenVertexArrays(1, &m_vertexArray);
+	glGenBuffers(1, &m_instanceBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(m_settings.maxInstances * sizeof(GPU_IMPOSTOR_INSTANCE)),
+		NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method frees the GL objects.
+ ***********************************************************/
+void ImpostorRenderer::Destroy()
+{
+	if (m_colorTexture != 0)
+		glDeleteTextures(1, &m_colorTexture);
+	if (m_normalTexture != 0)
+		glDeleteTextures(1, &m_normalTexture);
+	if (m_vertexArray != 0)
+		glDeleteVertexArrays(1, &m_vertexArray);
+	if (m_instanceBuffer != 0)
+		glDeleteBuffers(1, &m_instanceBuffer);
+	m_colorTexture = 0;
+	m_normalTexture = 0;
+	m_vertexArray = 0;
+	m_instanceBuffer = 0;
+	m_bounds.clear();
+
+	delete m_pShaders;
+	m_pShaders = NULL;
+}
+
+/***********************************************************
+ *  ReloadShaders()
+ *
+ *  This method rebuilds the program from the shader files.
+ ***********************************************************/
+bool ImpostorRenderer::ReloadShaders(const SHADER_VARIANT& variant)
+{
+	ShaderVariantCache* pShaders = new ShaderVariantCache(m_shaderCacheDirectory.c_str());
+	if (!pShaders->LoadSources(m_vertexShaderFile.c_str(), m_fragmentShaderFile.c_str()) ||
+		(pShaders->GetProgram(variant) == 0))
+	{
+		delete pShaders;
+		std::cout << "Impostor shader reload failed - keeping the previous shaders" << std::endl;
+		return(false);
+	}
+
+	delete m_pShaders;
+	m_pShaders = pShaders;
+	return(true);
+}
+
+/***********************************************************
+ *  SetAtlases()
+ *
+ *  This method uploads the atlases into two texture arrays,
+ *  replacing the previous ones.  All atlases must have the
+ *  layout of the settings.
+ ***********************************************************/
+bool ImpostorRenderer::SetAtlases(const std::vector<IMPOSTOR_ATLAS>& atlases)
+{
+	if (m_colorTexture != 0)
+		glDeleteTextures(1, &m_colorTexture);
+	if (m_normalTexture != 0)
+		glDeleteTextures(1, &m_normalTexture);
+	m_colorTexture = 0;
+	m_normalTexture = 0;
+	m_bounds.clear();
+	if (atlases.empty())
+	{
+		return(true);
+	}
+
+	int atlasSize = m_settings.framesPerSide * m_settings.frameSize;
+	for (size_t i = 0; i < atlases.size(); i++)
+	{
+		if (atlases[i].AtlasSize() != atlasSize)
+		{
+			std::cout << "Impostor atlas " << i << " does not match the impostor settings" << std::endl;
+			return(false);
+		}
+	}
+
+	int levels = 1;
+	while ((levels <= g_MaxMipLevel) && ((m_settings.frameSize >> levels) >= 4))
+		levels++;
+	GLuint* textures[2] = { &m_colorTexture, &m_normalTexture };
+	for (int t = 0; t < 2; t++)
+	{
+		glGenTextures(1, textures[t]);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, *textures[t]);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, atlasSize, atlasSize, (GLsizei)atlases.size());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		for (size_t i = 0; i < atlases.size(); i++)
+		{
+			const std::vector<unsigned char>& image = (t == 0) ? atlases[i].color : atlases[i].normal;
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)i, atlasSize, atlasSize, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+				image.data());
+		}
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	for (size_t i = 0; i < atlases.size(); i++)
+	{
+		m_bounds.push_back(glm::vec4(atlases[i].center, atlases[i].radius));
+	}
+	std::cout << "Impostors: " << atlases.size() << " archetypes, " << atlasSize << " x " << atlasSize
+		<< " atlases (" << (2 * atlases.size() * atlasSize * atlasSize * 4 / 1024) << " KB)" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  GetFade()
+ *
+ *  This method returns the fade of an impostor: 0 before
+ *  fadeStart, 1 from fadeEnd on.
+ ***********************************************************/
+float ImpostorRenderer::GetFade(float distanceInRadii) const
+{
+	if (m_bounds.empty())
+	{
+		return(0.0f);
+	}
+	float length = std::max(m_settings.fadeEnd - m_settings.fadeStart, 0.001f);
+	return(std::min(std::max((distanceInRadii - m_settings.fadeStart) / length, 0.0f), 1.0f));
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method starts an empty list of impostors.
+ ***********************************************************/
+void ImpostorRenderer::BeginFrame(FrameArena& arena)
+{
+	m_pInstances = arena.AllocateArray<GPU_IMPOSTOR_INSTANCE>((size_t)m_settings.maxInstances);
+	m_instanceCount = 0;
+}
+
+/***********************************************************
+ *  AddImpostor()
+ *
+ *  This method adds an impostor to the frame; instances past
+ *  maxInstances are dropped, and their meshes stay hidden.
+ ***********************************************************/
+void ImpostorRenderer::AddImpostor(int archetype, const glm::mat4& model, float fade, uint32_t objectIndex)
+{
+	if ((NULL == m_pInstances) || (m_instanceCount >= m_settings.maxInstances) ||
+		(archetype < 0) || (archetype >= (int)m_bounds.size()))
+	{
+		return;
+	}
+
+	GPU_IMPOSTOR_INSTANCE& instance = m_pInstances[m_instanceCount++];
+	instance.model = model;
+	instance.sphere = m_bounds[archetype];
+	instance.fade = fade;
+	instance.layer = archetype;
+	instance.objectIndex = (int32_t)objectIndex;
+	instance.padding = 0;
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method uploads the frame's impostors and draws them
+ *  as one instanced draw of six vertices each.
+ ***********************************************************/
+void ImpostorRenderer::Draw(const SHADER_VARIANT& variant)
+{
+	if ((m_instanceCount == 0) || (NULL == m_pShaders))
+	{
+		return;
+	}
+	GLuint program = m_pShaders->GetProgram(variant);
+	if (program == 0)
+	{
+		return;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)(m_instanceCount * sizeof(GPU_IMPOSTOR_INSTANCE)), m_pInstances);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "framesPerSide"), m_settings.framesPerSide);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_InstanceBinding, m_instanceBuffer);
+	glActiveTexture(GL_TEXTURE0 + g_ColorUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_colorTexture);
+	glActiveTexture(GL_TEXTURE0 + g_NormalUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_normalTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindVertexArray(m_vertexArray);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 6, m_instanceCount);
+	glBindVertexArray(0);
+}
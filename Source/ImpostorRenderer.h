@@ -0,0 +1,133 @@
+///////////////////////////////////////////////////////////////////////////////
+// impostorrenderer.h
+// ============
+// draw distant objects as camera-facing quads textured from their baked
+// impostor atlases, cross-faded with the meshes
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ImpostorBaker.h"
+#include "ShaderVariantCache.h"
+#include "FrameArena.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  IMPOSTOR_SETTINGS
+ *
+ *  Atlas layout and switch distances of the impostors.
+ ***********************************************************/
+struct IMPOSTOR_SETTINGS
+{
+	// views along a side of the atlas, and texels along a view
+	int framesPerSide;
+	int frameSize;
+	// distances, in bounding radii, over which the impostor
+	// fades in over the mesh; beyond fadeEnd only the impostor
+	// is drawn
+	float fadeStart;
+	float fadeEnd;
+	// impostors drawn per frame at most
+	int maxInstances;
+};
+
+/***********************************************************
+ *  GPU_IMPOSTOR_INSTANCE
+ *
+ *  One impostor to draw; matches the std430 ImpostorInstance
+ *  struct of the impostor shaders.
+ ***********************************************************/
+struct GPU_IMPOSTOR_INSTANCE
+{
+	// world transform of the archetype
+	glm::mat4 model;
+	// xyz = bounding sphere centre in the archetype's space,
+	// w = radius
+	glm::vec4 sphere;
+	// 0 = hidden, 1 = fully drawn
+	float fade;
+	// atlas layer of the archetype
+	int32_t layer;
+	// indirect renderer object whose material is used
+	int32_t objectIndex;
+	int32_t padding;
+};
+
+/***********************************************************
+ *  ImpostorRenderer
+ *
+ *  Draws impostors: one quad per instance, facing the camera
+ *  and moved in front of the object by its bounding radius,
+ *  textured with the atlas view nearest to the direction the
+ *  camera sees the object from.  The atlas holds colors and
+ *  normals, so impostors are lit by the scene lights with
+ *  their object's material like the meshes they stand in
+ *  for.
+ *
+ *  Over the fade distance the impostor covers more and more
+ *  of the mesh in a screen-space dither pattern, which needs
+ *  no blending or sorting; once it covers all of it the mesh
+ *  is no longer drawn.
+ *
+ *  The quads are drawn with the indirect renderer's camera,
+ *  light, object and material buffers, which must be bound.
+ ***********************************************************/
+class ImpostorRenderer
+{
+public:
+	// constructor
+	ImpostorRenderer(const IMPOSTOR_SETTINGS& settings);
+	// destructor
+	~ImpostorRenderer();
+
+	// default settings: 8 x 8 views of 64 texels, fading in
+	// from 15 to 18 bounding radii away
+	static IMPOSTOR_SETTINGS DefaultSettings();
+
+	// read the impostor shaders and create the buffers
+	bool Initialize(const char* vertexShaderFile, const char* fragmentShaderFile, const char* shaderCacheDirectory);
+	void Destroy();
+	// rebuild the program from the shader files; the current
+	// program stays if it fails to build
+	bool ReloadShaders(const SHADER_VARIANT& variant);
+
+	// upload the atlases; archetype i is layer i
+	bool SetAtlases(const std::vector<IMPOSTOR_ATLAS>& atlases);
+	// bounding sphere of an archetype (xyz centre, w radius)
+	const glm::vec4& GetBounds(int archetype) const { return m_bounds[archetype]; }
+	// how far the impostor of an object has faded in at a
+	// distance from the camera, in bounding radii
+	float GetFade(float distanceInRadii) const;
+
+	// start the frame's list of impostors in the arena
+	void BeginFrame(FrameArena& arena);
+	void AddImpostor(int archetype, const glm::mat4& model, float fade, uint32_t objectIndex);
+	// draw the frame's impostors with the variant's lighting
+	void Draw(const SHADER_VARIANT& variant);
+
+private:
+	IMPOSTOR_SETTINGS m_settings;
+	std::vector<glm::vec4> m_bounds;
+
+	// atlases as texture arrays, one layer per archetype
+	GLuint m_colorTexture;
+	GLuint m_normalTexture;
+	// quads need no vertex data, but a vertex array must be bound
+	GLuint m_vertexArray;
+	GLuint m_instanceBuffer;
+
+	// the frame's instances
+	GPU_IMPOSTOR_INSTANCE* m_pInstances;
+	int m_instanceCount;
+
+	std::string m_vertexShaderFile;
+	std::string m_fragmentShaderFile;
+	std::string m_shaderCacheDirectory;
+	ShaderVariantCache* m_pShaders;
+};
@@ -0,0 +1,785 @@
+///////////////////////////////////////////////////////////////////////////////
+// indirectrenderer.cpp
+// ============
+// draw all visible scene objects with one multi-draw indirect call per
+// shader variant
+///////////////////////////////////////////////////////////////////////////////
+
+#include "IndirectRenderer.h"
+
+#include <iostream>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	// shader storage buffer binding points used by the shaders
+	const GLuint g_DrawDataBinding = 0;
+	const GLuint g_MaterialBinding = 1;
+	// uniform buffer binding points used by the shaders
+	const GLuint g_CameraBinding = 0;
+	const GLuint g_LightBinding = 1;
+
+	// layout of the std140 camera uniform block
+	struct GPU_CAMERA
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 viewPosition;
+	};
+
+	/***********************************************************
+	 *  UploadChanges()
+	 *
+	 *  Uploads the entries of next that differ from current,
+	 *  one glBufferSubData() per run of changed entries, and
+	 *  makes current a copy of next.  A change in the number
+	 *  of entries reallocates the buffer (or, for fixed-size
+	 *  buffers, rewrites it whole).  Returns the number of
+	 *  changed entries.
+	 ***********************************************************/
+	template <typename T>
+	size_t UploadChanges(GLenum target, GLuint buffer, std::vector<T>& current, const std::vector<T>& next, bool bFixedSize)
+	{
+		glBindBuffer(target, buffer);
+
+		size_t changed = 0;
+		if (current.size() != next.size())
+		{
+			if (bFixedSize)
+				glBufferSubData(target, 0, (GLsizeiptr)(next.size() * sizeof(T)), next.data());
+			else
+				glBufferData(target, (GLsizeiptr)(next.size() * sizeof(T)), next.data(), GL_STATIC_DRAW);
+			changed = next.size();
+		}
+		else
+		{
+			size_t i = 0;
+			while (i < next.size())
+			{
+				if (memcmp(&current[i], &next[i], sizeof(T)) == 0)
+				{
+					i++;
+					continue;
+				}
+				size_t first = i;
+				while ((i < next.size()) && (memcmp(&current[i], &next[i], sizeof(T)) != 0))
+					i++;
+				glBufferSubData(target, (GLintptr)(first * sizeof(T)), (GLsizeiptr)((i - first) * sizeof(T)), &next[first]);
+				changed += i - first;
+			}
+		}
+
+		glBindBuffer(target, 0);
+		current = next;
+		return(changed);
+	}
+}
+
+/***********************************************************
+ *  IndirectRenderer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+IndirectRenderer::IndirectRenderer(const MeshLibrary* pMeshLibrary)
+{
+	m_pMeshLibrary = pMeshLibrary;
+	m_pShaderVariants = NULL;
+	m_pDepthPrepass = NULL;
+	m_pGPUCulling = NULL;
+	m_drawDataBuffer = 0;
+	m_materialBuffer = 0;
+	m_cameraBuffer = 0;
+	m_lightBuffer = 0;
+	m_lightCount = 0;
+	m_commandBuffer = 0;
+	m_commandCapacity = 0;
+	for (int i = 0; i < VARIANT_BATCHES; i++)
+	{
+		m_batches[i].commands = NULL;
+		m_batches[i].commandCount = 0;
+		m_batches[i].objectCount = 0;
+		m_batches[i].gpuCount = 0;
+		m_batches[i].lastMesh = MESH_COUNT;
+	}
+	m_transparent.commands = NULL;
+	m_transparent.commandCount = 0;
+	m_transparent.objectCount = 0;
+	m_transparent.gpuCount = 0;
+	m_transparent.lastMesh = MESH_COUNT;
+	m_pTransparentBatches = NULL;
+	m_transparentFirstCommand = 0;
+	m_pFrameCommands = NULL;
+}
+
+/***********************************************************
+ *  ~IndirectRenderer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+IndirectRenderer::~IndirectRenderer()
+{
+	if (m_drawDataBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_drawDataBuffer);
+		glDeleteBuffers(1, &m_materialBuffer);
+		glDeleteBuffers(1, &m_cameraBuffer);
+		glDeleteBuffers(1, &m_lightBuffer);
+		glDeleteBuffers(1, &m_commandBuffer);
+	}
+	m_drawDataBuffer = 0;
+	m_materialBuffer = 0;
+	m_cameraBuffer = 0;
+	m_lightBuffer = 0;
+	m_commandBuffer = 0;
+
+	delete m_pGPUCulling;
+	m_pGPUCulling = NULL;
+	delete m_pDepthPrepass;
+	m_pDepthPrepass = NULL;
+	delete m_pShaderVariants;
+	m_pShaderVariants = NULL;
+	m_pMeshLibrary = NULL;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method checks for OpenGL 4.6, which has everything
+ *  the indirect path uses: multi-draw indirect, shader
+ *  storage buffers, compute shaders, program binaries and
+ *  gl_BaseInstance in the shaders.  OpenGL 4.5 with
+ *  ARB_shader_draw_parameters does as well - the shader
+ *  variant cache compiles the shaders for it - which lets
+ *  the path run on Mesa's software renderer.
+ ***********************************************************/
+bool IndirectRenderer::IsSupported()
+{
+	return((GLEW_VERSION_4_6 || (GLEW_VERSION_4_5 && GLEW_ARB_shader_draw_parameters)) ? true : false);
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method reads the indirect shader sources and
+ *  creates the buffers.  The variants are built once the
+ *  objects and lights are known.
+ ***********************************************************/
+bool IndirectRenderer::Initialize(const char* vertexShaderFile, const char* fragmentShaderFile, const char* shaderCacheDirectory)
+{
+	m_vertexShaderFile = vertexShaderFile;
+	m_fragmentShaderFile = fragmentShaderFile;
+	m_shaderCacheDirectory = shaderCacheDirectory;
+
+	m_pShaderVariants = new ShaderVariantCache(shaderCacheDirectory);
+	if (!m_pShaderVariants->LoadSources(vertexShaderFile, fragmentShaderFile))
+	{
+		delete m_pShaderVariants;
+		m_pShaderVariants = NULL;
+		return(false);
+	}
+
+	glGenBuffers(1, &m_drawDataBuffer);
+	glGenBuffers(1, &m_materialBuffer);
+	glGenBuffers(1, &m_cameraBuffer);
+	glGenBuffers(1, &m_lightBuffer);
+	glGenBuffers(1, &m_commandBuffer);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_cameraBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(GPU_CAMERA), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_lightBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, SHADER_MAX_LIGHTS * sizeof(GPU_LIGHT), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  EnableDepthPrepass()
+ *
+ *  This method builds the depth pre-pass.  The mesh library
+ *  must have uploaded its position-only stream; without it,
+ *  or if the shaders do not build, the objects are drawn in
+ *  a single pass.
+ ***********************************************************/
+bool IndirectRenderer::EnableDepthPrepass(const DEPTH_PREPASS_SETTINGS& settings, const char* vertexShaderFile, const char* fragmentShaderFile)
+{
+	delete m_pDepthPrepass;
+	m_pDepthPrepass = NULL;
+	if ((settings.mode == DEPTH_PREPASS_OFF) || (m_pMeshLibrary->GetPositionVertexArray() == 0))
+	{
+		return(false);
+	}
+
+	m_pDepthPrepass = new DepthPrepass(settings);
+	if (!m_pDepthPrepass->Initialize(vertexShaderFile, fragmentShaderFile, m_shaderCacheDirectory.c_str()))
+	{
+		delete m_pDepthPrepass;
+		m_pDepthPrepass = NULL;
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  EnableGPUCulling()
+ *
+ *  This method builds the GPU culling.  If its shaders do
+ *  not build, the CPU culls every object as before.
+ ***********************************************************/
+bool IndirectRenderer::EnableGPUCulling(const GPU_CULLING_SETTINGS& settings, const char* cullShaderFile, const char* pyramidShaderFile)
+{
+	delete m_pGPUCulling;
+	m_pGPUCulling = NULL;
+	UpdateCullingObjects();
+	if (settings.mode == GPU_CULLING_OFF)
+	{
+		return(false);
+	}
+
+	m_pGPUCulling = new GPUCulling(m_pMeshLibrary, settings);
+	if (!m_pGPUCulling->Initialize(cullShaderFile, pyramidShaderFile))
+	{
+		delete m_pGPUCulling;
+		m_pGPUCulling = NULL;
+		return(false);
+	}
+	UpdateCullingObjects();
+	return(true);
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method uploads the changed light sources.  The lit
+ *  variants are built for exactly this many lights.
+ ***********************************************************/
+size_t IndirectRenderer::SetLights(const std::vector<GPU_LIGHT>& lights)
+{
+	std::vector<GPU_LIGHT> used = lights;
+	if (used.size() > (size_t)SHADER_MAX_LIGHTS)
+	{
+		std::cout << "Only " << SHADER_MAX_LIGHTS << " of " << used.size() << " lights are used" << std::endl;
+		used.resize(SHADER_MAX_LIGHTS);
+	}
+
+	size_t changed = UploadChanges(GL_UNIFORM_BUFFER, m_lightBuffer, m_lights, used, true);
+	if (m_lightCount != (int)used.size())
+	{
+		m_lightCount = (int)used.size();
+		BuildUsedVariants(m_pShaderVariants);
+	}
+	return(changed);
+}
+
+/***********************************************************
+ *  SetDrawData()
+ *
+ *  This method uploads the changed object data, which the
+ *  commands refer to by object index, sorts the objects into
+ *  the variant batches - or the transparent list, by the
+ *  blend mode of their material - and builds the variants
+ *  in use so that no frame has to wait for a compile.
+ ***********************************************************/
+size_t IndirectRenderer::SetDrawData(const std::vector<GPU_DRAW_DATA>& drawData)
+{
+	size_t changed = UploadChanges(GL_SHADER_STORAGE_BUFFER, m_drawDataBuffer, m_drawData, drawData, false);
+
+	m_objectBatches.resize(drawData.size());
+	m_objectTransparent.resize(drawData.size());
+	for (int batch = 0; batch < VARIANT_BATCHES; batch++)
+	{
+		m_batches[batch].objectCount = 0;
+	}
+	m_transparent.objectCount = 0;
+	for (size_t i = 0; i < drawData.size(); i++)
+	{
+		int materialIndex = drawData[i].materialIndex;
+		BLEND_MODE blendMode = ((materialIndex >= 0) && (materialIndex < (int)m_materialBlendModes.size())) ?
+			m_materialBlendModes[materialIndex] : BLEND_OPAQUE;
+
+		int texturing = (drawData[i].textureSlot >= 0) ? 1 : ((drawData[i].textureSlot == VIRTUAL_TEXTURE_SLOT) ? 2 : 0);
+		int lighting = (materialIndex < 0) ? 0 :
+			(((drawData[i].lightmapChart >= 0) && (blendMode != BLEND_TRANSPARENT)) ? 2 : 1);
+		int batch = texturing + 3 * lighting + ((blendMode == BLEND_ALPHA_TEST) ? 9 : 0);
+		m_objectBatches[i] = (unsigned char)batch;
+		m_objectTransparent[i] = (blendMode == BLEND_TRANSPARENT) ? 1 : 0;
+		if (m_objectTransparent[i])
+			m_transparent.objectCount++;
+		else
+			m_batches[batch].objectCount++;
+	}
+	BuildUsedVariants(m_pShaderVariants);
+	UpdateCullingObjects();
+
+	return(changed);
+}
+
+/***********************************************************
+ *  SetMaterials()
+ *
+ *  This method uploads the changed materials and keeps their
+ *  blend modes for the next SetDrawData().
+ ***********************************************************/
+size_t IndirectRenderer::SetMaterials(const std::vector<GPU_MATERIAL>& materials, const std::vector<BLEND_MODE>& blendModes)
+{
+	m_materialBlendModes = blendModes;
+	return(UploadChanges(GL_SHADER_STORAGE_BUFFER, m_materialBuffer, m_materials, materials, false));
+}
+
+/***********************************************************
+ *  SetCullingObjects()
+ *
+ *  This method keeps the objects of the GPU culling and
+ *  hands them to it with their current batches, returning
+ *  the ones it took.
+ ***********************************************************/
+std::vector<unsigned char> IndirectRenderer::SetCullingObjects(const std::vector<GPU_CULLING_OBJECT>& objects,
+	const std::vector<glm::vec4>& meshSpheres)
+{
+	m_cullingObjects = objects;
+	m_cullingSpheres = meshSpheres;
+	return(UpdateCullingObjects());
+}
+
+/***********************************************************
+ *  ReloadShaders()
+ *
+ *  This method builds the variants in use, the depth-only
+ *  program and the GPU culling programs from the current
+ *  shader files beside the ones in use, and switches to them
+ *  together only if all of them built, so a typo in a shader
+ *  being edited leaves the scene drawing with the old
+ *  programs - never with a mix of old and new.
+ ***********************************************************/
+bool IndirectRenderer::ReloadShaders()
+{
+	ShaderVariantCache* pShaderVariants = new ShaderVariantCache(m_shaderCacheDirectory.c_str());
+	bool bSuccess = pShaderVariants->LoadSources(m_vertexShaderFile.c_str(), m_fragmentShaderFile.c_str()) &&
+		BuildUsedVariants(pShaderVariants);
+	if (!bSuccess)
+	{
+		std::cout << "Shader reload failed - keeping the previous shaders" << std::endl;
+	}
+	if (bSuccess && (NULL != m_pDepthPrepass))
+	{
+		bSuccess = m_pDepthPrepass->BuildShaders();
+	}
+	if (bSuccess && (NULL != m_pGPUCulling))
+	{
+		bSuccess = m_pGPUCulling->BuildShaders();
+	}
+
+	if (!bSuccess)
+	{
+		delete pShaderVariants;
+		if (NULL != m_pDepthPrepass)
+		{
+			m_pDepthPrepass->DiscardShaders();
+		}
+		if (NULL != m_pGPUCulling)
+		{
+			m_pGPUCulling->DiscardShaders();
+		}
+		return(false);
+	}
+
+	delete m_pShaderVariants;
+	m_pShaderVariants = pShaderVariants;
+	if (NULL != m_pDepthPrepass)
+	{
+		m_pDepthPrepass->ApplyShaders();
+	}
+	if (NULL != m_pGPUCulling)
+	{
+		m_pGPUCulling->ApplyShaders();
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method uploads the camera of the frame and gives
+ *  every batch room in the frame arena for one command per
+ *  object, which is the most it can get - the commands the
+ *  CPU adds and those the GPU culling writes together.  The
+ *  batches sit back to back in one array, followed by the
+ *  transparent list.
+ ***********************************************************/
+void IndirectRenderer::BeginFrame(const SCENE_SNAPSHOT& snapshot, FrameArena& arena)
+{
+	GPU_CAMERA camera;
+	camera.view = snapshot.view;
+	camera.projection = snapshot.projection;
+	camera.viewPosition = glm::vec4(snapshot.viewPosition, 1.0f);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_cameraBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(GPU_CAMERA), &camera);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	if (NULL != m_pGPUCulling)
+	{
+		m_pGPUCulling->BeginFrame(snapshot.projection * snapshot.view, snapshot.bOrthographic);
+	}
+
+	m_pFrameCommands = arena.AllocateArray<DRAW_ELEMENTS_INDIRECT_COMMAND>(m_objectBatches.size());
+	size_t firstCommand = 0;
+	for (int i = 0; i < VARIANT_BATCHES; i++)
+	{
+		m_batches[i].commands = m_pFrameCommands + firstCommand;
+		m_batches[i].commandCount = 0;
+		m_batches[i].lastMesh = MESH_COUNT;
+		firstCommand += m_batches[i].objectCount;
+	}
+	m_transparent.commands = m_pFrameCommands + firstCommand;
+	m_transparent.commandCount = 0;
+	m_transparent.lastMesh = MESH_COUNT;
+	m_pTransparentBatches = arena.AllocateArray<unsigned char>(m_transparent.objectCount);
+}
+
+/***********************************************************
+ *  AddDraw()
+ *
+ *  This method adds a command for one object to its batch
+ *  (or the transparent list), or extends the previous
+ *  command by an instance when it draws the same mesh with
+ *  the same variant for the object just before this one.
+ ***********************************************************/
+void IndirectRenderer::AddDraw(SCENE_MESH mesh, uint32_t objectIndex)
+{
+	if (objectIndex >= m_objectBatches.size())
+	{
+		return;
+	}
+	bool bTransparent = m_objectTransparent[objectIndex] != 0;
+	VARIANT_BATCH& batch = bTransparent ? m_transparent : m_batches[m_objectBatches[objectIndex]];
+
+	if ((mesh == batch.lastMesh) && (batch.commandCount > 0))
+	{
+		DRAW_ELEMENTS_INDIRECT_COMMAND& last = batch.commands[batch.commandCount - 1];
+		if ((last.baseInstance + last.instanceCount == objectIndex) &&
+			(!bTransparent || (m_pTransparentBatches[batch.commandCount - 1] == m_objectBatches[objectIndex])))
+		{
+			last.instanceCount++;
+			return;
+		}
+	}
+
+	const MESH_RANGE& range = m_pMeshLibrary->GetMeshRange(mesh);
+	if ((range.indexCount == 0) || (batch.commandCount + batch.gpuCount >= batch.objectCount))
+	{
+		return;
+	}
+
+	DRAW_ELEMENTS_INDIRECT_COMMAND& command = batch.commands[batch.commandCount++];
+	command.count = range.indexCount;
+	command.instanceCount = 1;
+	command.firstIndex = range.firstIndex;
+	command.baseVertex = range.baseVertex;
+	command.baseInstance = objectIndex;
+	batch.lastMesh = mesh;
+	if (bTransparent)
+	{
+		m_pTransparentBatches[batch.commandCount - 1] = m_objectBatches[objectIndex];
+	}
+}
+
+/***********************************************************
+ *  SetImpostorFades()
+ *
+ *  This method passes the frame's impostor fades on to the
+ *  GPU culling.
+ ***********************************************************/
+void IndirectRenderer::SetImpostorFades(const float* fades, size_t count)
+{
+	if (NULL != m_pGPUCulling)
+	{
+		m_pGPUCulling->SetImpostorFades(fades, count);
+	}
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method closes the gaps between the batches in the
+ *  arena - leaving each batch room for the commands of the
+ *  GPU culling after its own - uploads the frame's commands,
+ *  reallocating the command buffer each frame so the driver
+ *  never has to wait for the previous frame's copy, has the
+ *  GPU culling fill in its commands, and draws each batch
+ *  with its variant in one multi-draw call.  The opaque
+ *  batches come first - after their depth, when the depth
+ *  pre-pass runs this frame - then the alpha tested ones.
+ *  The transparent commands are uploaded too, for
+ *  SubmitTransparent().
+ ***********************************************************/
+void IndirectRenderer::Submit()
+{
+	// batches only move down, so moving them in order is safe
+	size_t commandTotal = 0;
+	size_t gpuOffsets[VARIANT_BATCHES];
+	for (int i = 0; i < VARIANT_BATCHES; i++)
+	{
+		VARIANT_BATCH& batch = m_batches[i];
+		if ((batch.commandCount > 0) && (batch.commands != m_pFrameCommands + commandTotal))
+		{
+			memmove(m_pFrameCommands + commandTotal, batch.commands, batch.commandCount * sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND));
+		}
+		commandTotal += batch.commandCount;
+		gpuOffsets[i] = commandTotal;
+		commandTotal += batch.gpuCount;
+	}
+	m_transparentFirstCommand = commandTotal;
+	if ((m_transparent.commandCount > 0) && (m_transparent.commands != m_pFrameCommands + commandTotal))
+	{
+		memmove(m_pFrameCommands + commandTotal, m_transparent.commands,
+			m_transparent.commandCount * sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND));
+	}
+	commandTotal += m_transparent.commandCount;
+	// the object data stays bound for anything drawn after the
+	// batches with the same shader inputs (the terrain)
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_DrawDataBinding, m_drawDataBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_MaterialBinding, m_materialBuffer);
+	glBindBufferBase(GL_UNIFORM_BUFFER, g_CameraBinding, m_cameraBuffer);
+	glBindBufferBase(GL_UNIFORM_BUFFER, g_LightBinding, m_lightBuffer);
+	if (commandTotal == 0)
+	{
+		return;
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	if (commandTotal > m_commandCapacity)
+	{
+		m_commandCapacity = commandTotal * 2;
+	}
+	GLsizeiptr commandBytes = (GLsizeiptr)(commandTotal * sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND));
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, (GLsizeiptr)(m_commandCapacity * sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND)),
+		NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commandBytes, m_pFrameCommands);
+	if (NULL != m_pGPUCulling)
+	{
+		m_pGPUCulling->Cull(m_drawDataBuffer, m_commandBuffer, gpuOffsets);
+	}
+
+	// the opaque batches are the first half, back to back
+	size_t opaqueCommands = 0;
+	for (int i = 0; i < VARIANT_BATCHES / 2; i++)
+	{
+		opaqueCommands += m_batches[i].commandCount + m_batches[i].gpuCount;
+	}
+	bool bDepthPrepass = (NULL != m_pDepthPrepass) && (opaqueCommands > 0);
+	if (bDepthPrepass)
+	{
+		if (m_pDepthPrepass->BeginOpaque())
+		{
+			m_pDepthPrepass->DrawDepth(m_pMeshLibrary->GetPositionVertexArray(),
+				m_pMeshLibrary->GetIndexType(), (GLsizei)opaqueCommands);
+		}
+		m_pDepthPrepass->BeginShading();
+	}
+
+	glBindVertexArray(m_pMeshLibrary->GetVertexArray());
+
+	size_t firstCommand = 0;
+	for (int i = 0; i < VARIANT_BATCHES; i++)
+	{
+		if (bDepthPrepass && (i == VARIANT_BATCHES / 2))
+		{
+			m_pDepthPrepass->EndOpaque();
+		}
+		size_t commandCount = m_batches[i].commandCount + m_batches[i].gpuCount;
+		if (commandCount == 0)
+			continue;
+
+		GLuint program = m_pShaderVariants->GetProgram(BatchVariant(i));
+		if (program != 0)
+		{
+			glUseProgram(program);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, m_pMeshLibrary->GetIndexType(),
+				(void*)(firstCommand * sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND)), (GLsizei)commandCount, 0);
+		}
+		firstCommand += commandCount;
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/***********************************************************
+ *  SubmitTransparent()
+ *
+ *  This method draws the transparent commands uploaded by
+ *  Submit() in the order they were added, one multi-draw
+ *  call per run of the same variant.  They are blended over
+ *  what is behind them and depth tested, but write no depth,
+ *  so they never hide each other.  The terrain and the
+ *  impostors drawn since Submit() bound buffers of their
+ *  own, so the object data is bound again.
+ ***********************************************************/
+void IndirectRenderer::SubmitTransparent()
+{
+	size_t commandCount = m_transparent.commandCount;
+	if (commandCount == 0)
+	{
+		return;
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_DrawDataBinding, m_drawDataBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_MaterialBinding, m_materialBuffer);
+	glBindBufferBase(GL_UNIFORM_BUFFER, g_CameraBinding, m_cameraBuffer);
+	glBindBufferBase(GL_UNIFORM_BUFFER, g_LightBinding, m_lightBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBindVertexArray(m_pMeshLibrary->GetVertexArray());
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_FALSE);
+
+	size_t first = 0;
+	while (first < commandCount)
+	{
+		unsigned char batch = m_pTransparentBatches[first];
+		size_t end = first + 1;
+		while ((end < commandCount) && (m_pTransparentBatches[end] == batch))
+		{
+			end++;
+		}
+
+		GLuint program = m_pShaderVariants->GetProgram(BatchVariant(batch));
+		if (program != 0)
+		{
+			glUseProgram(program);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, m_pMeshLibrary->GetIndexType(),
+				(void*)((m_transparentFirstCommand + first) * sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND)),
+				(GLsizei)(end - first), 0);
+		}
+		first = end;
+	}
+
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/***********************************************************
+ *  BuildOcclusionPyramid()
+ *
+ *  This method has the GPU culling keep the depth of the
+ *  bound framebuffer for its next frame.
+ ***********************************************************/
+void IndirectRenderer::BuildOcclusionPyramid()
+{
+	if (NULL != m_pGPUCulling)
+	{
+		m_pGPUCulling->BuildPyramid();
+	}
+}
+
+/***********************************************************
+ *  ValidateGPUCulling()
+ *
+ *  This method has the GPU culling compare the commands it
+ *  wrote this frame with the CPU's answer.
+ ***********************************************************/
+void IndirectRenderer::ValidateGPUCulling(const unsigned char* expectedVisible)
+{
+	if (NULL != m_pGPUCulling)
+	{
+		m_pGPUCulling->Validate(m_commandBuffer, expectedVisible);
+	}
+}
+
+/***********************************************************
+ *  UpdateCullingObjects()
+ *
+ *  This method hands the culling objects to the GPU culling
+ *  with the batch of each - transparent objects get none -
+ *  and notes how many commands of each batch it writes.
+ *  Objects that do not match the per-object data (between a
+ *  SetDrawData() of a new scene and the SetCullingObjects()
+ *  that follows it) are not handed over.  Returns one byte
+ *  per culling object, set for those the GPU culling took.
+ ***********************************************************/
+std::vector<unsigned char> IndirectRenderer::UpdateCullingObjects()
+{
+	size_t gpuCounts[VARIANT_BATCHES] = { 0 };
+	std::vector<unsigned char> accepted(m_cullingObjects.size(), 0);
+	if ((NULL != m_pGPUCulling) && (m_cullingObjects.size() == m_objectBatches.size()))
+	{
+		std::vector<unsigned char> batches = m_objectBatches;
+		for (size_t i = 0; i < batches.size(); i++)
+		{
+			if (m_objectTransparent[i])
+				batches[i] = VARIANT_BATCHES;
+		}
+		accepted = m_pGPUCulling->SetObjects(m_cullingObjects, m_cullingSpheres, batches, VARIANT_BATCHES, gpuCounts);
+	}
+	else if (NULL != m_pGPUCulling)
+	{
+		m_pGPUCulling->SetObjects(std::vector<GPU_CULLING_OBJECT>(), m_cullingSpheres, m_objectBatches,
+			VARIANT_BATCHES, gpuCounts);
+	}
+	for (int i = 0; i < VARIANT_BATCHES; i++)
+	{
+		m_batches[i].gpuCount = gpuCounts[i];
+	}
+	return(accepted);
+}
+
+/***********************************************************
+ *  BuildUsedVariants()
+ *
+ *  This method builds the variant of every batch that has
+ *  objects, returning false if any failed.
+ ***********************************************************/
+bool IndirectRenderer::BuildUsedVariants(ShaderVariantCache* pShaderVariants)
+{
+	bool bBatchUsed[VARIANT_BATCHES] = { false };
+	for (size_t i = 0; i < m_objectBatches.size(); i++)
+	{
+		bBatchUsed[m_objectBatches[i]] = true;
+	}
+
+	bool bSuccess = true;
+	for (int batch = 0; batch < VARIANT_BATCHES; batch++)
+	{
+		if (bBatchUsed[batch] && (pShaderVariants->GetProgram(BatchVariant(batch)) == 0))
+		{
+			bSuccess = false;
+		}
+	}
+	return(bSuccess);
+}
+
+/***********************************************************
+ *  GetObjectVariant()
+ *
+ *  This method returns the shader variant the indirect
+ *  path draws an object with.
+ ***********************************************************/
+SHADER_VARIANT IndirectRenderer::GetObjectVariant(uint32_t objectIndex) const
+{
+	int batch = (objectIndex < m_objectBatches.size()) ? m_objectBatches[objectIndex] : 0;
+	return(BatchVariant(batch));
+}
+
+/***********************************************************
+ *  BatchVariant()
+ *
+ *  This method returns the shader variant of a batch: the
+ *  batch index modulo 3 is untextured, textured or virtual
+ *  textured, the second three of every nine batches are lit,
+ *  the third three lit with the lightmap, and the upper nine
+ *  batches are alpha tested.
+ ***********************************************************/
+SHADER_VARIANT IndirectRenderer::BatchVariant(int batch) const
+{
+	SHADER_VARIANT variant;
+	variant.bTextured = (batch % 3) == 1;
+	variant.bVirtualTextured = (batch % 3) == 2;
+	variant.bLit = (batch % 9) >= 3;
+	variant.bLightmapped = (batch % 9) >= 6;
+	variant.bAlphaTested = batch >= 9;
+	variant.lightCount = variant.bLit ? m_lightCount : 0;
+	return(variant);
+}
@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////////////////////////////////
+// indirectrenderer.h
+// ============
+// draw all visible scene objects with one multi-draw indirect call per
+// shader variant
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshLibrary.h"
+#include "SceneSnapshot.h"
+#include "RenderBackend.h"
+#include "ShaderVariantCache.h"
+#include "FrameArena.h"
+#include "DepthPrepass.h"
+#include "GPUCulling.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// texture slot of objects sampling the virtual texture
+const int32_t VIRTUAL_TEXTURE_SLOT = -2;
+
+/***********************************************************
+ *  GPU_DRAW_DATA
+ *
+ *  Per-object data read by the indirect shaders from a
+ *  shader storage buffer; matches the std430 DrawData struct
+ *  in Shaders/indirectVertexShader.glsl.
+ ***********************************************************/
+struct GPU_DRAW_DATA
+{
+	glm::mat4 model;
+	glm::vec2 uvScale;
+	// texture unit of the object's texture (-1 = untextured,
+	// VIRTUAL_TEXTURE_SLOT = the virtual texture)
+	int32_t textureSlot;
+	// index into the material buffer (-1 = unlit)
+	int32_t materialIndex;
+	// first lightmap chart of the object and its page (chart
+	// -1 = not lightmapped)
+	int32_t lightmapChart;
+	int32_t lightmapLayer;
+	int32_t padding[2];
+};
+
+/***********************************************************
+ *  GPU_MATERIAL
+ *
+ *  Material read by the indirect fragment shader; matches
+ *  the std430 Material struct of the shader.
+ ***********************************************************/
+struct GPU_MATERIAL
+{
+	// rgb = ambient color, a = ambient strength
+	glm::vec4 ambient;
+	// rgb = diffuse color, a = opacity, or the alpha cutoff
+	// of alpha tested materials
+	glm::vec4 diffuse;
+	// rgb = specular color, a = shininess
+	glm::vec4 specular;
+};
+
+/***********************************************************
+ *  GPU_LIGHT
+ *
+ *  Light source in the light uniform buffer; matches the
+ *  std140 Light struct of the fragment shader.
+ ***********************************************************/
+struct GPU_LIGHT
+{
+	// xyz = position or direction, w = 1 for directional
+	glm::vec4 position;
+	// rgb = ambient color, a = focal strength
+	glm::vec4 ambient;
+	// rgb = diffuse color, a = specular intensity
+	glm::vec4 diffuse;
+	// rgb = specular color
+	glm::vec4 specular;
+};
+
+/***********************************************************
+ *  IndirectRenderer
+ *
+ *  Draws any number of objects with glMultiDrawElementsIndirect()
+ *  from the shared buffers of the mesh library:
+ *
+ *  - the per-object transforms, UV scales and texture /
+ *    material indices are uploaded once to a shader storage
+ *    buffer, indexed by object
+ *  - each frame the visible objects are added as indirect
+ *    commands whose base instance is the object index, which
+ *    the vertex shader reads back as gl_BaseInstance
+ *  - runs of consecutive objects of the same mesh become one
+ *    instanced command
+ *
+ *  Each object is drawn with the shader variant matching it
+ *  (textured or not, lit or not, for the scene's number of
+ *  lights, lightmapped or not, alpha tested or not), so the commands are grouped
+ *  by variant and each group is one multi-draw call.  The
+ *  camera and the lights live in uniform buffers shared by
+ *  all variants, so only the program changes between the
+ *  groups.  The alpha tested groups come after the opaque
+ *  ones, so the discard in their shader does not keep the
+ *  opaque surfaces from early depth testing.
+ *
+ *  With a depth pre-pass enabled, the opaque groups' depth
+ *  is drawn first in one multi-draw call through the mesh
+ *  library's position-only stream, and the groups are then
+ *  shaded against it with an equal depth test - in the
+ *  frames the pre-pass decides it pays off.  The alpha tested
+ *  groups need their texture for the depth, so they stay out
+ *  of it and are drawn as usual afterwards.
+ *
+ *  With GPU culling enabled, the objects the scene hands to
+ *  it are never added on the CPU: each has a command slot in
+ *  its group after the added commands, which the culling's
+ *  compute shader fills in before the group is drawn - so
+ *  the group is still one multi-draw call, with the culled
+ *  objects' commands drawing no instance.
+ *
+ *  Objects of transparent materials are kept out of the
+ *  groups: they are drawn by SubmitTransparent() in the order
+ *  they were added, blended and without depth writes, with a
+ *  multi-draw call per run of objects of the same variant.
+ *
+ *  The Set*() methods upload only the entries that differ
+ *  from the previous call and return how many that were, so
+ *  a hot reload touches just what was edited.
+ *
+ *  The CPU cost per frame is filling one small command per
+ *  visible object and a fixed number of GL calls, however
+ *  many objects are visible.  Needs OpenGL 4.6, or 4.5 with
+ *  ARB_shader_draw_parameters.
+ ***********************************************************/
+class IndirectRenderer
+{
+public:
+	// constructor
+	IndirectRenderer(const MeshLibrary* pMeshLibrary);
+	// destructor
+	~IndirectRenderer();
+
+	// true if the current context can run the indirect path
+	static bool IsSupported();
+
+	// read the indirect shaders and create the buffers
+	bool Initialize(const char* vertexShaderFile, const char* fragmentShaderFile, const char* shaderCacheDirectory);
+	// build the depth pre-pass from its shaders; needs the mesh
+	// library's position-only stream
+	bool EnableDepthPrepass(const DEPTH_PREPASS_SETTINGS& settings, const char* vertexShaderFile, const char* fragmentShaderFile);
+	// build the GPU culling from its compute shaders
+	bool EnableGPUCulling(const GPU_CULLING_SETTINGS& settings, const char* cullShaderFile, const char* pyramidShaderFile);
+	bool IsGPUCullingEnabled() const { return NULL != m_pGPUCulling; }
+
+	// upload the light sources (at most SHADER_MAX_LIGHTS)
+	size_t SetLights(const std::vector<GPU_LIGHT>& lights);
+	// upload the per-object data and the materials, and build
+	// the shader variants the objects need; the materials'
+	// blend modes sort the objects into the passes, so set the
+	// materials first
+	size_t SetDrawData(const std::vector<GPU_DRAW_DATA>& drawData);
+	size_t SetMaterials(const std::vector<GPU_MATERIAL>& materials, const std::vector<BLEND_MODE>& blendModes);
+	// tell the GPU culling which objects it draws, in the order
+	// of the per-object data, and the bounding sphere of every
+	// mesh; kept across SetDrawData() calls.  Returns one byte
+	// per object, set for the objects the GPU culls - only
+	// those may be left out of the CPU culling
+	std::vector<unsigned char> SetCullingObjects(const std::vector<GPU_CULLING_OBJECT>& objects, const std::vector<glm::vec4>& meshSpheres);
+	// rebuild the variants in use, the depth pre-pass and the
+	// GPU culling from the shader files; the current programs
+	// all stay if any fails to build
+	bool ReloadShaders();
+
+	// start a frame with the camera of a snapshot; the frame's
+	// commands are kept in the arena until Submit()
+	void BeginFrame(const SCENE_SNAPSHOT& snapshot, FrameArena& arena);
+	// add one visible object to the frame; transparent objects
+	// should be added back to front
+	void AddDraw(SCENE_MESH mesh, uint32_t objectIndex);
+	// fade of every impostor instance for the GPU culling, after
+	// BeginFrame() (NULL = no impostors this frame)
+	void SetImpostorFades(const float* fades, size_t count);
+	// draw the opaque and alpha tested objects added since
+	// BeginFrame(), with the depth pre-pass if it is enabled
+	void Submit();
+	// draw the transparent objects added since BeginFrame(),
+	// after Submit() and anything else opaque
+	void SubmitTransparent();
+	// keep the depth of everything opaque drawn so far for the
+	// GPU culling's occlusion test of the next frame
+	void BuildOcclusionPyramid();
+	// compare the GPU culling of the frame with the objects the
+	// CPU finds visible (one byte per object); stalls
+	void ValidateGPUCulling(const unsigned char* expectedVisible);
+
+	// shader variant of an object, for drawing it with other
+	// geometry through the same fragment shader
+	SHADER_VARIANT GetObjectVariant(uint32_t objectIndex) const;
+
+private:
+	struct DRAW_ELEMENTS_INDIRECT_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// commands of one shader variant for the current frame
+	struct VARIANT_BATCH
+	{
+		// room for one command per object of the batch
+		DRAW_ELEMENTS_INDIRECT_COMMAND* commands;
+		size_t commandCount;
+		size_t objectCount;
+		// commands the GPU culling writes after commandCount
+		size_t gpuCount;
+		// mesh of the last command, to merge runs into instances
+		SCENE_MESH lastMesh;
+	};
+
+	// (untextured, textured, virtual textured) x (unlit, lit,
+	// lit from the lightmap) x alpha tested
+	static const int VARIANT_BATCHES = 18;
+
+	// variant of a batch with the current light count
+	SHADER_VARIANT BatchVariant(int batch) const;
+	// build the variants of the batches in use
+	bool BuildUsedVariants(ShaderVariantCache* pShaderVariants);
+	// hand the culling objects to the GPU culling with their
+	// batches, and make room for their commands; returns the
+	// objects it took, one byte each
+	std::vector<unsigned char> UpdateCullingObjects();
+
+	const MeshLibrary* m_pMeshLibrary;
+	ShaderVariantCache* m_pShaderVariants;
+	// NULL unless enabled
+	DepthPrepass* m_pDepthPrepass;
+	GPUCulling* m_pGPUCulling;
+	// objects and mesh spheres of the GPU culling
+	std::vector<GPU_CULLING_OBJECT> m_cullingObjects;
+	std::vector<glm::vec4> m_cullingSpheres;
+	// shader files and binary cache directory, for reloading
+	std::string m_vertexShaderFile;
+	std::string m_fragmentShaderFile;
+	std::string m_shaderCacheDirectory;
+
+	// last uploaded contents of the buffers
+	std::vector<GPU_DRAW_DATA> m_drawData;
+	std::vector<GPU_MATERIAL> m_materials;
+	std::vector<BLEND_MODE> m_materialBlendModes;
+	std::vector<GPU_LIGHT> m_lights;
+
+	// shader storage buffers
+	GLuint m_drawDataBuffer;
+	GLuint m_materialBuffer;
+	// uniform buffers shared by all variants
+	GLuint m_cameraBuffer;
+	GLuint m_lightBuffer;
+	int m_lightCount;
+	// indirect command buffer and its size in commands
+	GLuint m_commandBuffer;
+	size_t m_commandCapacity;
+
+	// batch (variant) of every object, and which objects are
+	// transparent
+	std::vector<unsigned char> m_objectBatches;
+	std::vector<unsigned char> m_objectTransparent;
+	VARIANT_BATCH m_batches[VARIANT_BATCHES];
+	// transparent commands in drawing order, after the batches
+	// in the command buffer, and the batch of each
+	VARIANT_BATCH m_transparent;
+	unsigned char* m_pTransparentBatches;
+	size_t m_transparentFirstCommand;
+	// start of the frame's commands in the arena
+	DRAW_ELEMENTS_INDIRECT_COMMAND* m_pFrameCommands;
+};
@@ -0,0 +1,58 @@
+///////////////////////////////////////////////////////////////////////////////
+// inputeventqueue.cpp
+// ============
+// ring of timestamped input events filled from the GLFW callbacks
+///////////////////////////////////////////////////////////////////////////////
+
+#include "InputEventQueue.h"
+
+/***********************************************************
+ *  InputEventQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+InputEventQueue::InputEventQueue()
+{
+	m_head = 0;
+	m_tail = 0;
+	m_droppedEvents = 0;
+}
+
+/***********************************************************
+ *  Push()
+ *
+ *  This method is called by the GLFW callbacks to append
+ *  an event to the ring.
+ ***********************************************************/
+bool InputEventQueue::Push(const INPUT_EVENT& event)
+{
+	if ((m_tail - m_head) >= CAPACITY)
+	{
+		m_droppedEvents++;
+		return(false);
+	}
+
+	m_events[m_tail & (CAPACITY - 1)] = event;
+	m_tail++;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Pop()
+ *
+ *  This method is called by the input latch to remove the
+ *  oldest event from the ring.
+ ***********************************************************/
+bool InputEventQueue::Pop(INPUT_EVENT& event)
+{
+	if (m_head == m_tail)
+	{
+		return(false);
+	}
+
+	event = m_events[m_head & (CAPACITY - 1)];
+	m_head++;
+
+	return(true);
+}
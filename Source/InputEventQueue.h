@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+// inputeventqueue.h
+// ============
+// ring of timestamped input events filled from the GLFW callbacks
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+
+// types of input events recorded by the GLFW callbacks
+enum INPUT_EVENT_TYPE
+{
+	INPUT_KEY,
+	INPUT_MOUSE_MOVE,
+	INPUT_MOUSE_BUTTON,
+	INPUT_SCROLL
+};
+
+/***********************************************************
+ *  INPUT_EVENT
+ *
+ *  One input event as delivered by GLFW, stamped with the
+ *  glfwGetTime() value at which the callback ran.
+ ***********************************************************/
+struct INPUT_EVENT
+{
+	INPUT_EVENT_TYPE type;
+	// GLFW key or mouse button code (INPUT_KEY, INPUT_MOUSE_BUTTON)
+	int key;
+	// GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+	int action;
+	// cursor position or scroll offsets
+	double x;
+	double y;
+	// time in seconds at which the event was received
+	double timestamp;
+};
+
+/***********************************************************
+ *  InputEventQueue
+ *
+ *  Fixed-size ring buffer filled by the GLFW callbacks and
+ *  drained by the input latch that runs just before the view
+ *  matrix is built.  Both run on the main thread - GLFW
+ *  delivers the callbacks from glfwPollEvents() - so the ring
+ *  needs no locks or atomics.
+ ***********************************************************/
+class InputEventQueue
+{
+public:
+	// capacity of the ring - must be a power of two
+	static const size_t CAPACITY = 1024;
+
+	// constructor
+	InputEventQueue();
+
+	// append an event; returns false (and drops the event) if
+	// the latch has fallen a full ring behind
+	bool Push(const INPUT_EVENT& event);
+
+	// remove the oldest event; returns false when empty
+	bool Pop(INPUT_EVENT& event);
+
+	// number of events dropped because the ring was full
+	unsigned int GetDroppedCount() const { return m_droppedEvents; }
+
+private:
+	// index of the next slot Pop() will read
+	size_t m_head;
+	// index of the next slot Push() will write
+	size_t m_tail;
+	// events dropped on overflow
+	unsigned int m_droppedEvents;
+	// event storage
+	INPUT_EVENT m_events[CAPACITY];
+};
@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmap.cpp
+// ============
+// load a baked lightmap into GPU textures and give the scene shaders the
+// charts of its objects
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Lightmap.h"
+
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// binding points used by the lightmapped shaders, after the
+	// impostors'
+	const GLuint g_ChartBinding = 4;
+	const GLuint g_IrradianceUnit = 21;
+	const GLuint g_OcclusionUnit = 22;
+}
+
+/***********************************************************
+ *  Lightmap()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+Lightmap::Lightmap()
+{
+	m_sceneKey = 0;
+	m_irradianceTexture = 0;
+	m_occlusionTexture = 0;
+	m_chartBuffer = 0;
+}
+
+/***********************************************************
+ *  ~Lightmap()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+Lightmap::~Lightmap()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method reads the lightmap file and uploads its pages
+ *  and charts.  The chart buffer starts with a vec4 whose x
+ *  is the irradiance range of the RGBM encoding.
+ ***********************************************************/
+bool Lightmap::Load(const char* filename)
+{
+	Destroy();
+
+	LIGHTMAP_ATLAS atlas;
+	if (!LightmapBaker::Load(filename, atlas))
+	{
+		return(false);
+	}
+	if (!GLEW_EXT_texture_compression_s3tc)
+	{
+		std::cout << "Lightmap " << filename << " not used - the GPU has no S3TC texture compression" << std::endl;
+		return(false);
+	}
+
+	GLsizei size = (GLsizei)atlas.pageSize;
+	glGenTextures(1, &m_irradianceTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_irradianceTexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, size, size, atlas.pageCount);
+	for (int page = 0; page < atlas.pageCount; page++)
+	{
+		glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, page, size, size, 1, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+			(GLsizei)atlas.IrradiancePageBytes(), atlas.irradiance.data() + page * atlas.IrradiancePageBytes());
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenTextures(1, &m_occlusionTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_occlusionTexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_COMPRESSED_RED_RGTC1, size, size, atlas.pageCount);
+	for (int page = 0; page < atlas.pageCount; page++)
+	{
+		glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, page, size, size, 1, GL_COMPRESSED_RED_RGTC1,
+			(GLsizei)atlas.OcclusionPageBytes(), atlas.occlusion.data() + page * atlas.OcclusionPageBytes());
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	std::vector<glm::vec4> charts;
+	charts.reserve(atlas.charts.size() + 1);
+	charts.push_back(glm::vec4(atlas.irradianceRange, 0.0f, 0.0f, 0.0f));
+	charts.insert(charts.end(), atlas.charts.begin(), atlas.charts.end());
+	glGenBuffers(1, &m_chartBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_chartBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(charts.size() * sizeof(glm::vec4)), charts.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	m_sceneKey = atlas.sceneKey;
+	m_objects = atlas.objects;
+	std::cout << "Lightmap: " << atlas.charts.size() << " charts on " << atlas.pageCount << " pages of " << size
+		<< " x " << size << " (" << (atlas.irradiance.size() + atlas.occlusion.size()) / 1024 << " KB)" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method frees the textures and the chart buffer.
+ ***********************************************************/
+void Lightmap::Destroy()
+{
+	if (m_irradianceTexture != 0)
+	{
+		glDeleteTextures(1, &m_irradianceTexture);
+		m_irradianceTexture = 0;
+	}
+	if (m_occlusionTexture != 0)
+	{
+		glDeleteTextures(1, &m_occlusionTexture);
+		m_occlusionTexture = 0;
+	}
+	if (m_chartBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_chartBuffer);
+		m_chartBuffer = 0;
+	}
+	m_objects.clear();
+	m_sceneKey = 0;
+}
+
+/***********************************************************
+ *  Matches()
+ *
+ *  This method tells whether the lightmap is loaded and was
+ *  baked from the scene with the key.
+ ***********************************************************/
+bool Lightmap::Matches(uint64_t sceneKey) const
+{
+	return((m_chartBuffer != 0) && (m_sceneKey == sceneKey));
+}
+
+/***********************************************************
+ *  GetPlacement()
+ *
+ *  This method returns where an object's charts are.
+ ***********************************************************/
+LIGHTMAP_PLACEMENT Lightmap::GetPlacement(uint32_t objectIndex) const
+{
+	if (objectIndex < m_objects.size())
+	{
+		return(m_objects[objectIndex]);
+	}
+	LIGHTMAP_PLACEMENT placement;
+	placement.firstChart = -1;
+	placement.chartCount = 0;
+	placement.layer = 0;
+	placement.reserved = 0;
+	return(placement);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method binds the charts and both page arrays.
+ ***********************************************************/
+void Lightmap::Bind() const
+{
+	if (m_chartBuffer == 0)
+	{
+		return;
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_ChartBinding, m_chartBuffer);
+	glActiveTexture(GL_TEXTURE0 + g_IrradianceUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_irradianceTexture);
+	glActiveTexture(GL_TEXTURE0 + g_OcclusionUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_occlusionTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmap.h
+// ============
+// load a baked lightmap into GPU textures and give the scene shaders the
+// charts of its objects
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "LightmapBaker.h"
+
+#include <vector>
+#include <cstdint>
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  Lightmap
+ *
+ *  Holds the lightmap the garden was baked into by
+ *  LightmapBaker: the irradiance pages as a BC3 texture
+ *  array, the occlusion pages as a BC4 (RGTC1) one, both
+ *  uploaded compressed as they were stored, and the page
+ *  rectangles of the charts in a shader storage buffer.
+ *
+ *  The indirect renderer passes an object's first chart and
+ *  page in its draw data, the mesh library the chart index
+ *  and chart coordinate in vertex attribute 3, and the
+ *  lightmapped shader variants combine the two.
+ *
+ *  All methods but GetPlacement() and Matches() must be
+ *  called on the thread that owns the GL context.
+ ***********************************************************/
+class Lightmap
+{
+public:
+	// constructor
+	Lightmap();
+	// destructor
+	~Lightmap();
+
+	// load a lightmap file and create its textures; fails if
+	// the file is missing or the GPU lacks the compressed
+	// formats
+	bool Load(const char* filename);
+	// free the GL objects
+	void Destroy();
+
+	// true if the lightmap was baked from the scene with this
+	// key (LightmapBaker::SceneKey())
+	bool Matches(uint64_t sceneKey) const;
+	// charts and page of a scene object; firstChart is -1 for
+	// objects without lightmap
+	LIGHTMAP_PLACEMENT GetPlacement(uint32_t objectIndex) const;
+
+	// bind the chart buffer and the textures for the scene
+	// shaders
+	void Bind() const;
+
+private:
+	uint64_t m_sceneKey;
+	std::vector<LIGHTMAP_PLACEMENT> m_objects;
+	GLuint m_irradianceTexture;
+	GLuint m_occlusionTexture;
+	GLuint m_chartBuffer;
+};
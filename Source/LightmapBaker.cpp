@@ -0,0 +1,1645 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.cpp
+// ============
+// bake the light of the static garden - direct light, bounced light and
+// ambient occlusion - into compressed lightmap pages with a multithreaded
+// CPU path tracer
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightmapBaker.h"
+#include "LightmapCharts.h"
+#include "FileUtility.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "stb_image.h"
+
+// declaration of global variables
+namespace
+{
+	const char g_FileMagic[4] = { 'T', 'G', 'L', 'M' };
+	// bump whenever the file layout or the chart numbering changes
+	const uint32_t g_FileVersion = 1;
+	// texels of border on every side of a chart
+	const int g_ChartBorder = 2;
+	// highest irradiance the RGBM encoding holds
+	const float g_IrradianceRange = 4.0f;
+	// distance ray origins are lifted off their surface
+	const float g_RayOffset = 2e-3f;
+	// angular radius of directional lights and radius of point
+	// lights, in radians and units, for slightly soft shadows
+	const float g_DirectionalSpread = 0.01f;
+	const float g_PointLightRadius = 0.1f;
+	// texels traced per work item
+	const size_t g_TexelsPerTask = 64;
+	// triangles per leaf of the hierarchy at most
+	const uint32_t g_LeafTriangles = 4;
+	const float g_Pi = 3.14159265358979f;
+
+	// the start of a lightmap file
+	struct LIGHTMAP_FILE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sceneKey;
+		int32_t pageSize;
+		int32_t pageCount;
+		int32_t objectCount;
+		int32_t chartCount;
+		float irradianceRange;
+		// 32-bit FNV-1a of everything after the header
+		uint32_t checksum;
+	};
+
+	/***********************************************************
+	 *  RANDOM
+	 *
+	 *  Small xorshift generator, one per texel, seeded from the
+	 *  texel's position so any thread traces it the same way.
+	 ***********************************************************/
+	struct RANDOM
+	{
+		uint64_t state;
+
+		RANDOM(uint64_t seed)
+		{
+			// splitmix64, so neighbouring seeds differ in all bits
+			seed += 0x9E3779B97F4A7C15ull;
+			seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+			seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+			state = (seed ^ (seed >> 31)) | 1;
+		}
+
+		// uniform in [0, 1)
+		float Next()
+		{
+			state ^= state >> 12;
+			state ^= state << 25;
+			state ^= state >> 27;
+			return((float)((state * 2685821657736338717ull) >> 40) / 16777216.0f);
+		}
+	};
+
+	// an occluder's triangle, ready for intersection
+	struct BAKE_TRIANGLE
+	{
+		glm::vec3 corner;
+		glm::vec3 edge1;
+		glm::vec3 edge2;
+		// unit normal of the front face
+		glm::vec3 normal;
+		int object;
+	};
+
+	// node of the bounding volume hierarchy; an inner node's
+	// first child follows it and `first` is its second child,
+	// a leaf's `first` is its first triangle
+	struct BVH_NODE
+	{
+		glm::vec3 boundsMin;
+		uint32_t first;
+		glm::vec3 boundsMax;
+		// triangles of a leaf (0 = inner node)
+		uint32_t count;
+	};
+
+	// what the paths are traced through
+	struct TRACE_SCENE
+	{
+		std::vector<BAKE_TRIANGLE> triangles;
+		std::vector<BVH_NODE> nodes;
+		// surface color of every object
+		std::vector<glm::vec3> albedo;
+		std::vector<LIGHTMAP_LIGHT> lights;
+	};
+
+	struct RAY_HIT
+	{
+		float distance;
+		int triangle;
+	};
+
+	// a generated mesh with its lightmap charts
+	struct BAKE_MESH
+	{
+		MESH_DATA data;
+		std::vector<float> chartVertices;
+		int chartCount;
+		bool bLoaded;
+	};
+
+	// a chart's rectangle in the atlas
+	struct CHART_LAYOUT
+	{
+		// covered texel centres along each side
+		int width;
+		int height;
+		// corner of the rectangle, border included
+		int x;
+		int y;
+		// world extent along the chart's u and v
+		float lengthU;
+		float lengthV;
+	};
+
+	// the charts of one lightmapped object
+	struct OBJECT_LAYOUT
+	{
+		int object;
+		int page;
+		std::vector<CHART_LAYOUT> charts;
+	};
+
+	// a row of rectangles of at most `height` texels
+	struct SHELF
+	{
+		int y;
+		int height;
+		int used;
+	};
+
+	struct PAGE_LAYOUT
+	{
+		std::vector<SHELF> shelves;
+		int top;
+	};
+
+	// a surface point to trace from, and the texel it lights
+	struct TEXEL_SAMPLE
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		int page;
+		int x;
+		int y;
+	};
+
+	// the terrain as the ray tracer sees it: the surface
+	// points of a grid over its chart, row by row along u
+	struct TERRAIN_GRID
+	{
+		std::vector<glm::vec3> points;
+		int cellsU;
+		int cellsV;
+	};
+
+	// the texels of one page while they are being baked
+	struct PAGE_TEXELS
+	{
+		std::vector<glm::vec3> irradiance;
+		std::vector<float> occlusion;
+		// chart of every texel, border included (-1 = none)
+		std::vector<int> charts;
+		std::vector<unsigned char> covered;
+	};
+
+	/***********************************************************
+	 *  BuildNode()
+	 *
+	 *  Builds the hierarchy below a node over a range of the
+	 *  triangle order, splitting at the median of the
+	 *  triangle centres along the longest axis.  Returns the
+	 *  node's index.
+	 ***********************************************************/
+	uint32_t BuildNode(TRACE_SCENE& scene, std::vector<uint32_t>& order, const std::vector<glm::vec3>& centers,
+		uint32_t first, uint32_t count)
+	{
+		BVH_NODE node;
+		node.boundsMin = glm::vec3(1e30f);
+		node.boundsMax = glm::vec3(-1e30f);
+		glm::vec3 centerMin(1e30f);
+		glm::vec3 centerMax(-1e30f);
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			const BAKE_TRIANGLE& triangle = scene.triangles[order[i]];
+			glm::vec3 corners[3] = { triangle.corner, triangle.corner + triangle.edge1, triangle.corner + triangle.edge2 };
+			for (int c = 0; c < 3; c++)
+			{
+				node.boundsMin = glm::min(node.boundsMin, corners[c]);
+				node.boundsMax = glm::max(node.boundsMax, corners[c]);
+			}
+			centerMin = glm::min(centerMin, centers[order[i]]);
+			centerMax = glm::max(centerMax, centers[order[i]]);
+		}
+		node.first = first;
+		node.count = count;
+
+		uint32_t index = (uint32_t)scene.nodes.size();
+		scene.nodes.push_back(node);
+
+		glm::vec3 extent = centerMax - centerMin;
+		int axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+		if ((count <= g_LeafTriangles) || (extent[axis] <= 0.0f))
+		{
+			return(index);
+		}
+
+		uint32_t half = count / 2;
+		std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+			[&centers, axis](uint32_t a, uint32_t b) { return(centers[a][axis] < centers[b][axis]); });
+		BuildNode(scene, order, centers, first, half);
+		uint32_t second = BuildNode(scene, order, centers, first + half, count - half);
+		scene.nodes[index].first = second;
+		scene.nodes[index].count = 0;
+		return(index);
+	}
+
+	/***********************************************************
+	 *  BuildHierarchy()
+	 *
+	 *  Builds the bounding volume hierarchy over the scene's
+	 *  triangles and puts the triangles in leaf order.
+	 ***********************************************************/
+	void BuildHierarchy(TRACE_SCENE& scene)
+	{
+		scene.nodes.clear();
+		if (scene.triangles.empty())
+		{
+			return;
+		}
+
+		std::vector<uint32_t> order(scene.triangles.size());
+		std::vector<glm::vec3> centers(scene.triangles.size());
+		for (size_t i = 0; i < scene.triangles.size(); i++)
+		{
+			const BAKE_TRIANGLE& triangle = scene.triangles[i];
+			order[i] = (uint32_t)i;
+			centers[i] = triangle.corner + (triangle.edge1 + triangle.edge2) / 3.0f;
+		}
+		BuildNode(scene, order, centers, 0, (uint32_t)order.size());
+
+		std::vector<BAKE_TRIANGLE> sorted(scene.triangles.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			sorted[i] = scene.triangles[order[i]];
+		}
+		scene.triangles.swap(sorted);
+	}
+
+	/***********************************************************
+	 *  IntersectBounds()
+	 *
+	 *  Slab test of a ray against a node's box, up to a
+	 *  distance.
+	 ***********************************************************/
+	bool IntersectBounds(const BVH_NODE& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance)
+	{
+		glm::vec3 t0 = (node.boundsMin - origin) * inverseDirection;
+		glm::vec3 t1 = (node.boundsMax - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+		float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		return(enter <= exit);
+	}
+
+	/***********************************************************
+	 *  IntersectTriangle()
+	 *
+	 *  Moeller-Trumbore ray / triangle test; returns the
+	 *  distance along the ray, or -1 for a miss.  Both faces
+	 *  are hit.
+	 ***********************************************************/
+	float IntersectTriangle(const BAKE_TRIANGLE& triangle, const glm::vec3& origin, const glm::vec3& direction)
+	{
+		glm::vec3 p = glm::cross(direction, triangle.edge2);
+		float determinant = glm::dot(triangle.edge1, p);
+		if (std::fabs(determinant) < 1e-12f)
+			return(-1.0f);
+		float inverseDeterminant = 1.0f / determinant;
+
+		glm::vec3 t = origin - triangle.corner;
+		float u = glm::dot(t, p) * inverseDeterminant;
+		if ((u < 0.0f) || (u > 1.0f))
+			return(-1.0f);
+		glm::vec3 q = glm::cross(t, triangle.edge1);
+		float v = glm::dot(direction, q) * inverseDeterminant;
+		if ((v < 0.0f) || (u + v > 1.0f))
+			return(-1.0f);
+		return(glm::dot(triangle.edge2, q) * inverseDeterminant);
+	}
+
+	/***********************************************************
+	 *  TraceRay()
+	 *
+	 *  Finds the nearest triangle a ray hits before maxDistance
+	 *  - or, with bAnyHit, any of them, for shadow rays.
+	 ***********************************************************/
+	bool TraceRay(const TRACE_SCENE& scene, const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+		bool bAnyHit, RAY_HIT& hit)
+	{
+		hit.distance = maxDistance;
+		hit.triangle = -1;
+		if (scene.nodes.empty())
+		{
+			return(false);
+		}
+
+		glm::vec3 inverseDirection;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			inverseDirection[axis] = (std::fabs(direction[axis]) > 1e-12f) ? 1.0f / direction[axis] : 1e12f;
+		}
+
+		uint32_t stack[64];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			uint32_t index = stack[--stackSize];
+			const BVH_NODE& node = scene.nodes[index];
+			if (!IntersectBounds(node, origin, inverseDirection, hit.distance))
+				continue;
+
+			if (node.count > 0)
+			{
+				for (uint32_t i = node.first; i < node.first + node.count; i++)
+				{
+					float distance = IntersectTriangle(scene.triangles[i], origin, direction);
+					if ((distance > 0.0f) && (distance < hit.distance))
+					{
+						hit.distance = distance;
+						hit.triangle = (int)i;
+						if (bAnyHit)
+							return(true);
+					}
+				}
+			}
+			else if (stackSize + 2 <= 64)
+			{
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = index + 1;
+			}
+		}
+		return(hit.triangle >= 0);
+	}
+
+	/***********************************************************
+	 *  TangentFrame()
+	 *
+	 *  Two unit axes perpendicular to a unit normal and to each
+	 *  other.
+	 ***********************************************************/
+	void TangentFrame(const glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent)
+	{
+		tangent = (std::fabs(normal.x) > 0.9f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		tangent = glm::normalize(glm::cross(normal, tangent));
+		bitangent = glm::cross(normal, tangent);
+	}
+
+	/***********************************************************
+	 *  CosineDirection()
+	 *
+	 *  A direction around a normal with a density proportional
+	 *  to the cosine to it, so averaging what the rays see
+	 *  gives the irradiance without weights.
+	 ***********************************************************/
+	glm::vec3 CosineDirection(const glm::vec3& normal, RANDOM& random)
+	{
+		float angle = 2.0f * g_Pi * random.Next();
+		float radius = std::sqrt(random.Next());
+		glm::vec3 tangent;
+		glm::vec3 bitangent;
+		TangentFrame(normal, tangent, bitangent);
+		return(glm::normalize(tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle)) +
+			normal * std::sqrt(std::max(1.0f - radius * radius, 0.0f))));
+	}
+
+	/***********************************************************
+	 *  RandomInSphere()
+	 *
+	 *  A point in the unit sphere, for jittering the lights.
+	 ***********************************************************/
+	glm::vec3 RandomInSphere(RANDOM& random)
+	{
+		glm::vec3 point;
+		do
+		{
+			point = glm::vec3(random.Next(), random.Next(), random.Next()) * 2.0f - 1.0f;
+		} while (glm::dot(point, point) > 1.0f);
+		return(point);
+	}
+
+	/***********************************************************
+	 *  DirectLight()
+	 *
+	 *  Light reaching a surface point straight from the light
+	 *  sources, with one shadow ray per light to a random point
+	 *  of it.  Like the scene shader, there is no falloff.
+	 ***********************************************************/
+	glm::vec3 DirectLight(const TRACE_SCENE& scene, const glm::vec3& position, const glm::vec3& normal, RANDOM& random,
+		unsigned long long& rays)
+	{
+		glm::vec3 light(0.0f);
+		glm::vec3 origin = position + normal * g_RayOffset;
+		for (size_t i = 0; i < scene.lights.size(); i++)
+		{
+			const LIGHTMAP_LIGHT& source = scene.lights[i];
+			glm::vec3 toLight;
+			float distance = 1e30f;
+			if (source.bDirectional)
+			{
+				toLight = glm::normalize(-glm::normalize(source.position) + RandomInSphere(random) * g_DirectionalSpread);
+			}
+			else
+			{
+				toLight = source.position + RandomInSphere(random) * g_PointLightRadius - position;
+				distance = glm::length(toLight);
+				if (distance < 1e-4f)
+					continue;
+				toLight /= distance;
+			}
+
+			float cosine = glm::dot(normal, toLight);
+			if (cosine <= 0.0f)
+				continue;
+
+			RAY_HIT hit;
+			rays++;
+			if (!TraceRay(scene, origin, toLight, distance, true, hit))
+			{
+				light += cosine * source.diffuseColor;
+			}
+		}
+		return(light);
+	}
+
+	/***********************************************************
+	 *  TraceTexel()
+	 *
+	 *  The irradiance and ambient occlusion of a texel's
+	 *  surface point: every path samples the lights directly,
+	 *  then follows a cosine-distributed ray that bounces off
+	 *  the surfaces it hits, each of which reflects the light
+	 *  that reaches it straight from the lights.  The first ray
+	 *  of each path also tells whether the ambient light is
+	 *  blocked nearby.
+	 ***********************************************************/
+	void TraceTexel(const TRACE_SCENE& scene, const LIGHTMAP_SETTINGS& settings, const TEXEL_SAMPLE& texel,
+		glm::vec3& irradiance, float& occlusion, unsigned long long& rays)
+	{
+		RANDOM random(((uint64_t)texel.page << 40) ^ ((uint64_t)texel.y << 20) ^ (uint64_t)texel.x);
+		glm::vec3 direct(0.0f);
+		glm::vec3 indirect(0.0f);
+		int occluded = 0;
+		for (int s = 0; s < settings.samples; s++)
+		{
+			direct += DirectLight(scene, texel.position, texel.normal, random, rays);
+
+			glm::vec3 position = texel.position;
+			glm::vec3 normal = texel.normal;
+			glm::vec3 throughput(1.0f);
+			int segments = std::max(settings.bounces, 1);
+			for (int bounce = 0; bounce < segments; bounce++)
+			{
+				glm::vec3 direction = CosineDirection(normal, random);
+				float maxDistance = (settings.bounces > 0) ? 1e30f : settings.occlusionDistance;
+				RAY_HIT hit;
+				rays++;
+				if (!TraceRay(scene, position + normal * g_RayOffset, direction, maxDistance, false, hit))
+					break;
+				if ((bounce == 0) && (hit.distance < settings.occlusionDistance))
+					occluded++;
+				if (settings.bounces == 0)
+					break;
+
+				// the back of a surface reflects nothing
+				const BAKE_TRIANGLE& triangle = scene.triangles[hit.triangle];
+				if (glm::dot(triangle.normal, direction) >= 0.0f)
+					break;
+
+				position = position + normal * g_RayOffset + direction * hit.distance;
+				normal = triangle.normal;
+				throughput *= scene.albedo[triangle.object];
+				indirect += throughput * DirectLight(scene, position, normal, random, rays);
+			}
+		}
+
+		irradiance = (direct + indirect) / (float)settings.samples;
+		occlusion = 1.0f - (float)occluded / (float)settings.samples;
+	}
+
+	/***********************************************************
+	 *  PlaceRect()
+	 *
+	 *  Finds room for a rectangle on a page: on the shelf it
+	 *  fits with the least height to spare, or on a new shelf.
+	 ***********************************************************/
+	bool PlaceRect(PAGE_LAYOUT& page, int pageSize, int width, int height, int& x, int& y)
+	{
+		int best = -1;
+		for (size_t i = 0; i < page.shelves.size(); i++)
+		{
+			const SHELF& shelf = page.shelves[i];
+			if ((height <= shelf.height) && (shelf.used + width <= pageSize) &&
+				((best < 0) || (shelf.height < page.shelves[best].height)))
+			{
+				best = (int)i;
+			}
+		}
+		if (best >= 0)
+		{
+			SHELF& shelf = page.shelves[best];
+			x = shelf.used;
+			y = shelf.y;
+			shelf.used += width;
+			return(true);
+		}
+
+		if ((width > pageSize) || (page.top + height > pageSize))
+		{
+			return(false);
+		}
+		SHELF shelf;
+		shelf.y = page.top;
+		shelf.height = height;
+		shelf.used = width;
+		page.shelves.push_back(shelf);
+		page.top += height;
+		x = 0;
+		y = shelf.y;
+		return(true);
+	}
+
+	/***********************************************************
+	 *  PlaceObject()
+	 *
+	 *  Places all charts of an object on a page, tallest
+	 *  first; the page is left as it was if they do not fit.
+	 ***********************************************************/
+	bool PlaceObject(PAGE_LAYOUT& page, int pageSize, OBJECT_LAYOUT& object)
+	{
+		std::vector<int> order(object.charts.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = (int)i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&object](int a, int b)
+		{
+			return(object.charts[a].height > object.charts[b].height);
+		});
+
+		PAGE_LAYOUT trial = page;
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			CHART_LAYOUT& chart = object.charts[order[i]];
+			if (!PlaceRect(trial, pageSize, chart.width + 2 * g_ChartBorder, chart.height + 2 * g_ChartBorder, chart.x, chart.y))
+			{
+				return(false);
+			}
+		}
+		page = trial;
+		return(true);
+	}
+
+	/***********************************************************
+	 *  SizeCharts()
+	 *
+	 *  Sets the texels of an object's charts from their world
+	 *  extent times the density: rectangles, border included,
+	 *  are rounded up to whole 4 x 4 blocks.
+	 ***********************************************************/
+	void SizeCharts(OBJECT_LAYOUT& object, float texelsPerUnit, int maxChartSize)
+	{
+		for (size_t i = 0; i < object.charts.size(); i++)
+		{
+			CHART_LAYOUT& chart = object.charts[i];
+			int sizes[2];
+			float lengths[2] = { chart.lengthU, chart.lengthV };
+			for (int axis = 0; axis < 2; axis++)
+			{
+				int texels = (int)std::ceil(lengths[axis] * texelsPerUnit) + 1;
+				texels = std::min(std::max(texels, 2), maxChartSize);
+				sizes[axis] = ((texels + 2 * g_ChartBorder + 3) & ~3) - 2 * g_ChartBorder;
+			}
+			chart.width = sizes[0];
+			chart.height = sizes[1];
+		}
+	}
+
+	/***********************************************************
+	 *  AverageColor()
+	 *
+	 *  Average color of an image file, white if it cannot be
+	 *  read.
+	 ***********************************************************/
+	glm::vec3 AverageColor(const std::string& filename)
+	{
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		unsigned char* pixels = stbi_load(filename.c_str(), &width, &height, &channels, 4);
+		if (NULL == pixels)
+		{
+			std::cout << "Could not load image:" << filename << std::endl;
+			return(glm::vec3(1.0f));
+		}
+
+		glm::dvec3 sum(0.0);
+		size_t count = (size_t)width * height;
+		for (size_t i = 0; i < count; i++)
+		{
+			sum += glm::dvec3(pixels[i * 4], pixels[i * 4 + 1], pixels[i * 4 + 2]);
+		}
+		stbi_image_free(pixels);
+		return((count > 0) ? glm::vec3(sum / (255.0 * count)) : glm::vec3(1.0f));
+	}
+
+	/***********************************************************
+	 *  TerrainCoordinate()
+	 *
+	 *  The point of the grounds at a terrain chart coordinate.
+	 *  The chart spans the grounds with u along x and v against
+	 *  z, like the ground plane's texture and the terrain
+	 *  shader.
+	 ***********************************************************/
+	glm::vec3 TerrainCoordinate(const TerrainHeightfield& heightfield, float u, float v)
+	{
+		const TERRAIN_SHAPE& shape = heightfield.GetShape();
+		float x = shape.center.x - shape.size.x * 0.5f + u * shape.size.x;
+		float z = shape.center.z + shape.size.y * 0.5f - v * shape.size.y;
+		return(glm::vec3(x, heightfield.GetHeight(x, z), z));
+	}
+
+	/***********************************************************
+	 *  BuildTerrainGrid()
+	 *
+	 *  Samples the heightfield on a grid of about the given
+	 *  spacing over the terrain chart.
+	 ***********************************************************/
+	void BuildTerrainGrid(const TerrainHeightfield& heightfield, float spacing, TERRAIN_GRID& grid)
+	{
+		const TERRAIN_SHAPE& shape = heightfield.GetShape();
+		grid.cellsU = std::max((int)std::ceil(shape.size.x / spacing), 1);
+		grid.cellsV = std::max((int)std::ceil(shape.size.y / spacing), 1);
+		grid.points.resize((size_t)(grid.cellsU + 1) * (grid.cellsV + 1));
+		for (int v = 0; v <= grid.cellsV; v++)
+		{
+			for (int u = 0; u <= grid.cellsU; u++)
+			{
+				grid.points[(size_t)v * (grid.cellsU + 1) + u] =
+					TerrainCoordinate(heightfield, (float)u / grid.cellsU, (float)v / grid.cellsV);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  TerrainPoint()
+	 *
+	 *  Surface point and normal of the terrain at a chart
+	 *  coordinate.  The point lies on the grid's triangles, so
+	 *  rays leaving it start above the surface they are traced
+	 *  against even where the heightfield curves; the normal is
+	 *  the heightfield's, taken as the terrain shader takes it.
+	 ***********************************************************/
+	void TerrainPoint(const TerrainHeightfield& heightfield, const TERRAIN_GRID& grid, float spacing, float u, float v,
+		glm::vec3& position, glm::vec3& normal)
+	{
+		float gridU = glm::clamp(u, 0.0f, 1.0f) * grid.cellsU;
+		float gridV = glm::clamp(v, 0.0f, 1.0f) * grid.cellsV;
+		int cellU = std::min((int)gridU, grid.cellsU - 1);
+		int cellV = std::min((int)gridV, grid.cellsV - 1);
+		float fractionU = gridU - cellU;
+		float fractionV = gridV - cellV;
+		const glm::vec3& p00 = grid.points[(size_t)cellV * (grid.cellsU + 1) + cellU];
+		const glm::vec3& p10 = grid.points[(size_t)cellV * (grid.cellsU + 1) + cellU + 1];
+		const glm::vec3& p01 = grid.points[(size_t)(cellV + 1) * (grid.cellsU + 1) + cellU];
+		const glm::vec3& p11 = grid.points[(size_t)(cellV + 1) * (grid.cellsU + 1) + cellU + 1];
+		// the cells are split along their p00 - p11 diagonal
+		if (fractionU >= fractionV)
+			position = p00 + (p10 - p00) * fractionU + (p11 - p10) * fractionV;
+		else
+			position = p00 + (p01 - p00) * fractionV + (p11 - p01) * fractionU;
+
+		glm::vec3 surface = TerrainCoordinate(heightfield, u, v);
+		normal = glm::normalize(glm::vec3(
+			heightfield.GetHeight(surface.x - spacing, surface.z) - heightfield.GetHeight(surface.x + spacing, surface.z),
+			2.0f * spacing,
+			heightfield.GetHeight(surface.x, surface.z - spacing) - heightfield.GetHeight(surface.x, surface.z + spacing)));
+	}
+
+	/***********************************************************
+	 *  Pack565() / Unpack565()
+	 *
+	 *  A color in [0, 1] as a 5:6:5 endpoint of a color block,
+	 *  and back.
+	 ***********************************************************/
+	uint16_t Pack565(const glm::vec3& color)
+	{
+		glm::vec3 c = glm::clamp(color, 0.0f, 1.0f);
+		return((uint16_t)(((int)(c.r * 31.0f + 0.5f) << 11) | ((int)(c.g * 63.0f + 0.5f) << 5) | (int)(c.b * 31.0f + 0.5f)));
+	}
+
+	glm::vec3 Unpack565(uint16_t packed)
+	{
+		return(glm::vec3((packed >> 11) / 31.0f, ((packed >> 5) & 63) / 63.0f, (packed & 31) / 31.0f));
+	}
+
+	/***********************************************************
+	 *  EncodeColorBlock()
+	 *
+	 *  Compresses 4 x 4 colors into a BC1 color block in its
+	 *  four-color mode (as BC3 always decodes it): the
+	 *  endpoints are the extremes of the colors along their
+	 *  principal axis, and each texel takes the nearest of the
+	 *  four palette colors.
+	 ***********************************************************/
+	void EncodeColorBlock(const glm::vec3 colors[16], unsigned char* block)
+	{
+		glm::vec3 mean(0.0f);
+		for (int i = 0; i < 16; i++)
+		{
+			mean += colors[i];
+		}
+		mean /= 16.0f;
+
+		// principal axis of the colors by power iteration
+		glm::mat3 covariance(0.0f);
+		for (int i = 0; i < 16; i++)
+		{
+			glm::vec3 d = colors[i] - mean;
+			covariance += glm::outerProduct(d, d);
+		}
+		glm::vec3 axis(1.0f, 1.0f, 1.0f);
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			glm::vec3 next = covariance * axis;
+			float length = glm::length(next);
+			if (length < 1e-12f)
+				break;
+			axis = next / length;
+		}
+		axis = glm::normalize(axis);
+
+		float tMin = 1e30f;
+		float tMax = -1e30f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = glm::dot(colors[i] - mean, axis);
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+		uint16_t color0 = Pack565(mean + axis * tMax);
+		uint16_t color1 = Pack565(mean + axis * tMin);
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			glm::vec3 palette[4];
+			palette[0] = Unpack565(color0);
+			palette[1] = Unpack565(color1);
+			palette[2] = (palette[0] * 2.0f + palette[1]) / 3.0f;
+			palette[3] = (palette[0] + palette[1] * 2.0f) / 3.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0;
+				float bestError = 1e30f;
+				for (int p = 0; p < 4; p++)
+				{
+					glm::vec3 d = colors[i] - palette[p];
+					float error = glm::dot(d, d);
+					if (error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				indices |= (uint32_t)best << (2 * i);
+			}
+		}
+
+		block[0] = (unsigned char)(color0 & 0xFF);
+		block[1] = (unsigned char)(color0 >> 8);
+		block[2] = (unsigned char)(color1 & 0xFF);
+		block[3] = (unsigned char)(color1 >> 8);
+		for (int i = 0; i < 4; i++)
+		{
+			block[4 + i] = (unsigned char)(indices >> (8 * i));
+		}
+	}
+
+	/***********************************************************
+	 *  EncodeValueBlock()
+	 *
+	 *  Compresses 4 x 4 values in [0, 1] into a BC4 block - the
+	 *  same layout as the alpha block of BC3 - between their
+	 *  lowest and highest value, and returns the values the
+	 *  block decodes to.
+	 ***********************************************************/
+	void EncodeValueBlock(const float values[16], unsigned char* block, float decoded[16])
+	{
+		float low = 1.0f;
+		float high = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			low = std::min(low, values[i]);
+			high = std::max(high, values[i]);
+		}
+		int value0 = (int)(glm::clamp(high, 0.0f, 1.0f) * 255.0f + 0.5f);
+		int value1 = (int)(glm::clamp(low, 0.0f, 1.0f) * 255.0f + 0.5f);
+
+		uint64_t indices = 0;
+		if (value0 == value1)
+		{
+			// every texel takes value 0
+			for (int i = 0; i < 16; i++)
+			{
+				decoded[i] = value0 / 255.0f;
+			}
+		}
+		else
+		{
+			// value0 > value1: six values between the two
+			float palette[8];
+			palette[0] = (float)value0;
+			palette[1] = (float)value1;
+			for (int p = 2; p < 8; p++)
+			{
+				palette[p] = ((8 - p) * value0 + (p - 1) * value1) / 7.0f;
+			}
+			for (int i = 0; i < 16; i++)
+			{
+				float value = values[i] * 255.0f;
+				int best = 0;
+				for (int p = 1; p < 8; p++)
+				{
+					if (std::fabs(value - palette[p]) < std::fabs(value - palette[best]))
+						best = p;
+				}
+				indices |= (uint64_t)best << (3 * i);
+				decoded[i] = palette[best] / 255.0f;
+			}
+		}
+
+		block[0] = (unsigned char)value0;
+		block[1] = (unsigned char)value1;
+		for (int i = 0; i < 6; i++)
+		{
+			block[2 + i] = (unsigned char)(indices >> (8 * i));
+		}
+	}
+
+	/***********************************************************
+	 *  CompressPage()
+	 *
+	 *  Compresses a baked page block by block: the irradiance
+	 *  as RGBM in BC3 - the multiplier is compressed first, and
+	 *  the color divided by the multiplier the block decodes
+	 *  to - and the occlusion in BC4.
+	 ***********************************************************/
+	void CompressPage(const PAGE_TEXELS& texels, int pageSize, unsigned char* irradiance, unsigned char* occlusion)
+	{
+		int blocks = pageSize / 4;
+		for (int blockY = 0; blockY < blocks; blockY++)
+		{
+			for (int blockX = 0; blockX < blocks; blockX++)
+			{
+				glm::vec3 colors[16];
+				float multipliers[16];
+				float decodedMultipliers[16];
+				float occlusions[16];
+				float decodedOcclusions[16];
+				for (int i = 0; i < 16; i++)
+				{
+					size_t texel = (size_t)(blockY * 4 + i / 4) * pageSize + blockX * 4 + i % 4;
+					colors[i] = texels.irradiance[texel] / g_IrradianceRange;
+					float largest = std::max(std::max(colors[i].r, colors[i].g), colors[i].b);
+					multipliers[i] = std::ceil(glm::clamp(largest, 1.0f / 255.0f, 1.0f) * 255.0f) / 255.0f;
+					occlusions[i] = texels.occlusion[texel];
+				}
+
+				size_t block = (size_t)blockY * blocks + blockX;
+				unsigned char* irradianceBlock = irradiance + block * 16;
+				EncodeValueBlock(multipliers, irradianceBlock, decodedMultipliers);
+				for (int i = 0; i < 16; i++)
+				{
+					colors[i] = glm::clamp(colors[i] / std::max(decodedMultipliers[i], 1.0f / 255.0f), 0.0f, 1.0f);
+				}
+				EncodeColorBlock(colors, irradianceBlock + 8);
+				EncodeValueBlock(occlusions, occlusion + block * 8, decodedOcclusions);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  DilatePage()
+	 *
+	 *  Gives the uncovered texels of every chart - its border,
+	 *  and texel centres just off its triangles - the average
+	 *  of their chart's filled neighbours, one ring per pass.
+	 ***********************************************************/
+	void DilatePage(PAGE_TEXELS& texels, int pageSize)
+	{
+		std::vector<unsigned char> filled = texels.covered;
+		for (int pass = 0; pass < pageSize; pass++)
+		{
+			std::vector<unsigned char> nextFilled = filled;
+			bool bChanged = false;
+			for (int y = 0; y < pageSize; y++)
+			{
+				for (int x = 0; x < pageSize; x++)
+				{
+					size_t texel = (size_t)y * pageSize + x;
+					if (filled[texel] || (texels.charts[texel] < 0))
+						continue;
+
+					glm::vec3 irradianceSum(0.0f);
+					float occlusionSum = 0.0f;
+					int count = 0;
+					for (int n = 0; n < 9; n++)
+					{
+						int nx = x + n % 3 - 1;
+						int ny = y + n / 3 - 1;
+						if ((nx < 0) || (ny < 0) || (nx >= pageSize) || (ny >= pageSize))
+							continue;
+						size_t neighbour = (size_t)ny * pageSize + nx;
+						if (!filled[neighbour] || (texels.charts[neighbour] != texels.charts[texel]))
+							continue;
+						irradianceSum += texels.irradiance[neighbour];
+						occlusionSum += texels.occlusion[neighbour];
+						count++;
+					}
+					if (count > 0)
+					{
+						texels.irradiance[texel] = irradianceSum / (float)count;
+						texels.occlusion[texel] = occlusionSum / (float)count;
+						nextFilled[texel] = 1;
+						bChanged = true;
+					}
+				}
+			}
+			filled.swap(nextFilled);
+			if (!bChanged)
+				break;
+		}
+	}
+}
+
+/***********************************************************
+ *  LightmapBaker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightmapBaker::LightmapBaker(const LIGHTMAP_SETTINGS& settings)
+{
+	m_settings = settings;
+	m_settings.pageSize = std::max((settings.pageSize + 3) & ~3, 64);
+	m_settings.maxChartSize = std::min(std::max(settings.maxChartSize, 2), m_settings.pageSize - 2 * g_ChartBorder);
+	m_settings.samples = std::max(settings.samples, 1);
+	m_settings.bounces = std::min(std::max(settings.bounces, 0), 2);
+	m_settings.texelsPerUnit = std::max(settings.texelsPerUnit, 0.01f);
+	m_settings.terrainSpacing = std::max(settings.terrainSpacing, 0.1f);
+	if (m_settings.threadCount <= 0)
+	{
+		m_settings.threadCount = std::max((int)std::thread::hardware_concurrency(), 1);
+	}
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings of a regular bake.
+ ***********************************************************/
+LIGHTMAP_SETTINGS LightmapBaker::DefaultSettings()
+{
+	LIGHTMAP_SETTINGS settings;
+	settings.texelsPerUnit = 4.0f;
+	settings.pageSize = 1024;
+	settings.maxChartSize = 1000;
+	settings.samples = 64;
+	settings.bounces = 2;
+	settings.occlusionDistance = 2.0f;
+	settings.terrainSpacing = 1.0f;
+	settings.threadCount = 0;
+	return(settings);
+}
+
+/***********************************************************
+ *  SceneKey()
+ *
+ *  This method hashes everything a bake depends on: the
+ *  objects' meshes, transforms, colors and roles, the
+ *  lights, the terrain and the file version.
+ ***********************************************************/
+uint64_t LightmapBaker::SceneKey(const LIGHTMAP_SCENE& scene)
+{
+	uint64_t hash = HASH_SEED;
+	hash = HashBytes(hash, &g_FileVersion, sizeof(g_FileVersion));
+	for (size_t i = 0; i < scene.objects.size(); i++)
+	{
+		const LIGHTMAP_OBJECT& object = scene.objects[i];
+		uint64_t meshKey = MeshGenerator::ParamsKey(MeshGenerator::DefaultParams(object.mesh));
+		hash = HashBytes(hash, &meshKey, sizeof(meshKey));
+		for (int column = 0; column < 4; column++)
+		{
+			glm::vec4 values = object.model[column];
+			hash = HashBytes(hash, &values[0], 4 * sizeof(float));
+		}
+		hash = HashBytes(hash, &object.diffuseColor[0], 3 * sizeof(float));
+		hash = HashBytes(hash, object.textureFile.c_str(), object.textureFile.size() + 1);
+		unsigned char flags = (object.bLightmapped ? 1 : 0) | (object.bOccluder ? 2 : 0) | (object.bTerrain ? 4 : 0);
+		hash = HashBytes(hash, &flags, sizeof(flags));
+	}
+	for (size_t i = 0; i < scene.lights.size(); i++)
+	{
+		const LIGHTMAP_LIGHT& light = scene.lights[i];
+		hash = HashBytes(hash, &light.position[0], 3 * sizeof(float));
+		hash = HashBytes(hash, &light.diffuseColor[0], 3 * sizeof(float));
+		unsigned char directional = light.bDirectional ? 1 : 0;
+		hash = HashBytes(hash, &directional, sizeof(directional));
+	}
+	const TERRAIN_SHAPE& terrain = scene.terrain;
+	hash = HashBytes(hash, &terrain.center[0], 3 * sizeof(float));
+	hash = HashBytes(hash, &terrain.size[0], 2 * sizeof(float));
+	hash = HashBytes(hash, &terrain.hillHeight, sizeof(terrain.hillHeight));
+	hash = HashBytes(hash, &terrain.hillSize, sizeof(terrain.hillSize));
+	hash = HashBytes(hash, &terrain.flatSize[0], 2 * sizeof(float));
+	return(hash);
+}
+
+/***********************************************************
+ *  Bake()
+ *
+ *  This method lays out the charts, builds the ray tracing
+ *  scene, traces every covered texel on all worker threads
+ *  and compresses the pages.
+ ***********************************************************/
+bool LightmapBaker::Bake(const LIGHTMAP_SCENE& scene, LIGHTMAP_ATLAS& atlas) const
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	TerrainHeightfield heightfield(scene.terrain);
+	TERRAIN_GRID terrainGrid;
+	BuildTerrainGrid(heightfield, m_settings.terrainSpacing, terrainGrid);
+
+	// the meshes the objects use, with their charts
+	std::vector<BAKE_MESH> meshes(MESH_COUNT);
+	for (size_t i = 0; i < scene.objects.size(); i++)
+	{
+		BAKE_MESH& mesh = meshes[scene.objects[i].mesh];
+		if (mesh.bLoaded)
+			continue;
+		MeshGenerator::Generate(MeshGenerator::DefaultParams(scene.objects[i].mesh), mesh.data);
+		mesh.chartCount = LightmapCharts::Build(mesh.data.vertices.data(),
+			(uint32_t)(mesh.data.vertices.size() / MESH_FLOATS_PER_VERTEX), mesh.data.indices.data(),
+			(uint32_t)mesh.data.indices.size(), mesh.chartVertices);
+		mesh.bLoaded = true;
+	}
+
+	// surface colors, and the occluders' triangles
+	TRACE_SCENE traceScene;
+	traceScene.lights = scene.lights;
+	std::vector<std::string> textureFiles;
+	std::vector<glm::vec3> textureColors;
+	for (size_t i = 0; i < scene.objects.size(); i++)
+	{
+		const LIGHTMAP_OBJECT& object = scene.objects[i];
+		glm::vec3 textureColor(1.0f);
+		if (!object.textureFile.empty())
+		{
+			size_t t = std::find(textureFiles.begin(), textureFiles.end(), object.textureFile) - textureFiles.begin();
+			if (t == textureFiles.size())
+			{
+				textureFiles.push_back(object.textureFile);
+				textureColors.push_back(AverageColor(object.textureFile));
+			}
+			textureColor = textureColors[t];
+		}
+		traceScene.albedo.push_back(object.diffuseColor * textureColor);
+		if (!object.bOccluder)
+			continue;
+
+		BAKE_TRIANGLE triangle;
+		triangle.object = (int)i;
+		if (object.bTerrain)
+		{
+			for (int v = 0; v < terrainGrid.cellsV; v++)
+			{
+				for (int u = 0; u < terrainGrid.cellsU; u++)
+				{
+					// v runs against z, so these wind upwards
+					size_t row = (size_t)terrainGrid.cellsU + 1;
+					const glm::vec3& p00 = terrainGrid.points[v * row + u];
+					const glm::vec3& p10 = terrainGrid.points[v * row + u + 1];
+					const glm::vec3& p01 = terrainGrid.points[(v + 1) * row + u];
+					const glm::vec3& p11 = terrainGrid.points[(v + 1) * row + u + 1];
+					glm::vec3 corners[2][3] = { { p00, p10, p11 }, { p00, p11, p01 } };
+					for (int t = 0; t < 2; t++)
+					{
+						triangle.corner = corners[t][0];
+						triangle.edge1 = corners[t][1] - corners[t][0];
+						triangle.edge2 = corners[t][2] - corners[t][0];
+						triangle.normal = glm::normalize(glm::cross(triangle.edge1, triangle.edge2));
+						traceScene.triangles.push_back(triangle);
+					}
+				}
+			}
+			continue;
+		}
+
+		const BAKE_MESH& mesh = meshes[object.mesh];
+		for (size_t t = 0; t + 2 < mesh.data.indices.size(); t += 3)
+		{
+			glm::vec3 corners[3];
+			for (int c = 0; c < 3; c++)
+			{
+				const float* vertex = &mesh.data.vertices[(size_t)mesh.data.indices[t + c] * MESH_FLOATS_PER_VERTEX];
+				corners[c] = glm::vec3(object.model * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+			}
+			triangle.corner = corners[0];
+			triangle.edge1 = corners[1] - corners[0];
+			triangle.edge2 = corners[2] - corners[0];
+			glm::vec3 normal = glm::cross(triangle.edge1, triangle.edge2);
+			if (glm::dot(normal, normal) < 1e-20f)
+				continue;
+			triangle.normal = glm::normalize(normal);
+			traceScene.triangles.push_back(triangle);
+		}
+	}
+	BuildHierarchy(traceScene);
+
+	// chart sizes from the world extent of every chart
+	std::vector<OBJECT_LAYOUT> layouts;
+	for (size_t i = 0; i < scene.objects.size(); i++)
+	{
+		const LIGHTMAP_OBJECT& object = scene.objects[i];
+		if (!object.bLightmapped)
+			continue;
+
+		OBJECT_LAYOUT layout;
+		layout.object = (int)i;
+		layout.page = -1;
+		if (object.bTerrain)
+		{
+			CHART_LAYOUT chart;
+			chart.lengthU = scene.terrain.size.x;
+			chart.lengthV = scene.terrain.size.y;
+			layout.charts.push_back(chart);
+		}
+		else
+		{
+			// average length of the chart's u and v axes in the
+			// world, weighted by the triangles' chart area
+			const BAKE_MESH& mesh = meshes[object.mesh];
+			std::vector<double> lengths((size_t)mesh.chartCount * 2, 0.0);
+			std::vector<double> areas(mesh.chartCount, 0.0);
+			for (size_t t = 0; t + 2 < mesh.data.indices.size(); t += 3)
+			{
+				glm::vec3 positions[3];
+				glm::vec2 coordinates[3];
+				int chart = 0;
+				for (int c = 0; c < 3; c++)
+				{
+					uint32_t index = mesh.data.indices[t + c];
+					const float* vertex = &mesh.data.vertices[(size_t)index * MESH_FLOATS_PER_VERTEX];
+					const float* chartVertex = &mesh.chartVertices[(size_t)index * LIGHTMAP_FLOATS_PER_VERTEX];
+					positions[c] = glm::vec3(object.model * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+					coordinates[c] = glm::vec2(chartVertex[0], chartVertex[1]);
+					chart = (int)chartVertex[2];
+				}
+				glm::vec3 edge1 = positions[1] - positions[0];
+				glm::vec3 edge2 = positions[2] - positions[0];
+				glm::vec2 delta1 = coordinates[1] - coordinates[0];
+				glm::vec2 delta2 = coordinates[2] - coordinates[0];
+				float determinant = delta1.x * delta2.y - delta2.x * delta1.y;
+				if (std::fabs(determinant) < 1e-12f)
+					continue;
+				glm::vec3 alongU = (edge1 * delta2.y - edge2 * delta1.y) / determinant;
+				glm::vec3 alongV = (edge2 * delta1.x - edge1 * delta2.x) / determinant;
+				double area = std::fabs(determinant) * 0.5;
+				lengths[(size_t)chart * 2] += glm::length(alongU) * area;
+				lengths[(size_t)chart * 2 + 1] += glm::length(alongV) * area;
+				areas[chart] += area;
+			}
+			for (int c = 0; c < mesh.chartCount; c++)
+			{
+				CHART_LAYOUT chart;
+				chart.lengthU = (areas[c] > 0.0) ? (float)(lengths[(size_t)c * 2] / areas[c]) : 0.0f;
+				chart.lengthV = (areas[c] > 0.0) ? (float)(lengths[(size_t)c * 2 + 1] / areas[c]) : 0.0f;
+				layout.charts.push_back(chart);
+			}
+		}
+		SizeCharts(layout, m_settings.texelsPerUnit, m_settings.maxChartSize);
+		layouts.push_back(layout);
+	}
+
+	// pack the objects, those with the tallest charts first;
+	// an object too large for an empty page gets fewer texels
+	std::vector<int> packOrder(layouts.size());
+	std::vector<int> tallest(layouts.size(), 0);
+	for (size_t i = 0; i < layouts.size(); i++)
+	{
+		packOrder[i] = (int)i;
+		for (size_t c = 0; c < layouts[i].charts.size(); c++)
+		{
+			tallest[i] = std::max(tallest[i], layouts[i].charts[c].height);
+		}
+	}
+	std::stable_sort(packOrder.begin(), packOrder.end(), [&tallest](int a, int b) { return(tallest[a] > tallest[b]); });
+	std::vector<PAGE_LAYOUT> pages;
+	for (size_t i = 0; i < packOrder.size(); i++)
+	{
+		OBJECT_LAYOUT& layout = layouts[packOrder[i]];
+		for (size_t p = 0; (p < pages.size()) && (layout.page < 0); p++)
+		{
+			if (PlaceObject(pages[p], m_settings.pageSize, layout))
+				layout.page = (int)p;
+		}
+		float density = m_settings.texelsPerUnit;
+		while ((layout.page < 0) && (density > m_settings.texelsPerUnit / 64.0f))
+		{
+			PAGE_LAYOUT page;
+			page.top = 0;
+			if (PlaceObject(page, m_settings.pageSize, layout))
+			{
+				layout.page = (int)pages.size();
+				pages.push_back(page);
+			}
+			else
+			{
+				density *= 0.5f;
+				SizeCharts(layout, density, m_settings.maxChartSize);
+			}
+		}
+		if (layout.page < 0)
+		{
+			std::cout << "Lightmap: object " << layout.object << " does not fit a page and stays unlit" << std::endl;
+		}
+	}
+
+	atlas.sceneKey = SceneKey(scene);
+	atlas.pageSize = m_settings.pageSize;
+	atlas.pageCount = (int)pages.size();
+	atlas.irradianceRange = g_IrradianceRange;
+	atlas.objects.assign(scene.objects.size(), LIGHTMAP_PLACEMENT());
+	for (size_t i = 0; i < atlas.objects.size(); i++)
+	{
+		atlas.objects[i].firstChart = -1;
+		atlas.objects[i].chartCount = 0;
+		atlas.objects[i].layer = 0;
+		atlas.objects[i].reserved = 0;
+	}
+	atlas.charts.clear();
+
+	// the texels of every chart, and the surface points of the
+	// ones its triangles cover
+	const int pageSize = m_settings.pageSize;
+	size_t pageTexels = (size_t)pageSize * pageSize;
+	std::vector<PAGE_TEXELS> pageTexelData(pages.size());
+	for (size_t p = 0; p < pages.size(); p++)
+	{
+		pageTexelData[p].irradiance.assign(pageTexels, glm::vec3(0.0f));
+		pageTexelData[p].occlusion.assign(pageTexels, 1.0f);
+		pageTexelData[p].charts.assign(pageTexels, -1);
+		pageTexelData[p].covered.assign(pageTexels, 0);
+	}
+	std::vector<TEXEL_SAMPLE> samples;
+	for (size_t i = 0; i < layouts.size(); i++)
+	{
+		const OBJECT_LAYOUT& layout = layouts[i];
+		if (layout.page < 0)
+			continue;
+		const LIGHTMAP_OBJECT& object = scene.objects[layout.object];
+		PAGE_TEXELS& texels = pageTexelData[layout.page];
+		LIGHTMAP_PLACEMENT& placement = atlas.objects[layout.object];
+		placement.firstChart = (int32_t)atlas.charts.size();
+		placement.chartCount = (int32_t)layout.charts.size();
+		placement.layer = layout.page;
+
+		for (size_t c = 0; c < layout.charts.size(); c++)
+		{
+			const CHART_LAYOUT& chart = layout.charts[c];
+			int chartIndex = (int)atlas.charts.size();
+			atlas.charts.push_back(glm::vec4(
+				(chart.x + g_ChartBorder + 0.5f) / pageSize, (chart.y + g_ChartBorder + 0.5f) / pageSize,
+				(chart.width - 1.0f) / pageSize, (chart.height - 1.0f) / pageSize));
+			for (int y = 0; y < chart.height + 2 * g_ChartBorder; y++)
+			{
+				for (int x = 0; x < chart.width + 2 * g_ChartBorder; x++)
+				{
+					texels.charts[(size_t)(chart.y + y) * pageSize + chart.x + x] = chartIndex;
+				}
+			}
+
+			if (object.bTerrain)
+			{
+				for (int y = 0; y < chart.height; y++)
+				{
+					for (int x = 0; x < chart.width; x++)
+					{
+						TEXEL_SAMPLE sample;
+						TerrainPoint(heightfield, terrainGrid, m_settings.terrainSpacing, (float)x / (chart.width - 1),
+							(float)y / (chart.height - 1), sample.position, sample.normal);
+						sample.page = layout.page;
+						sample.x = chart.x + g_ChartBorder + x;
+						sample.y = chart.y + g_ChartBorder + y;
+						texels.covered[(size_t)sample.y * pageSize + sample.x] = 1;
+						samples.push_back(sample);
+					}
+				}
+			}
+		}
+		if (object.bTerrain)
+			continue;
+
+		// rasterize the triangles onto their charts' texel centres
+		const BAKE_MESH& mesh = meshes[object.mesh];
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(object.model)));
+		for (size_t t = 0; t + 2 < mesh.data.indices.size(); t += 3)
+		{
+			glm::vec3 positions[3];
+			glm::vec3 normals[3];
+			glm::vec2 points[3];
+			const CHART_LAYOUT* pChart = NULL;
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t index = mesh.data.indices[t + c];
+				const float* vertex = &mesh.data.vertices[(size_t)index * MESH_FLOATS_PER_VERTEX];
+				const float* chartVertex = &mesh.chartVertices[(size_t)index * LIGHTMAP_FLOATS_PER_VERTEX];
+				positions[c] = glm::vec3(object.model * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+				normals[c] = normalMatrix * glm::vec3(vertex[3], vertex[4], vertex[5]);
+				pChart = &layout.charts[(int)chartVertex[2]];
+				points[c] = glm::vec2(chartVertex[0] * (pChart->width - 1), chartVertex[1] * (pChart->height - 1));
+			}
+			float area = (points[1].x - points[0].x) * (points[2].y - points[0].y) -
+				(points[1].y - points[0].y) * (points[2].x - points[0].x);
+			if (std::fabs(area) < 1e-8f)
+				continue;
+
+			int minX = std::max((int)std::floor(std::min(points[0].x, std::min(points[1].x, points[2].x))), 0);
+			int maxX = std::min((int)std::ceil(std::max(points[0].x, std::max(points[1].x, points[2].x))), pChart->width - 1);
+			int minY = std::max((int)std::floor(std::min(points[0].y, std::min(points[1].y, points[2].y))), 0);
+			int maxY = std::min((int)std::ceil(std::max(points[0].y, std::max(points[1].y, points[2].y))), pChart->height - 1);
+			for (int y = minY; y <= maxY; y++)
+			{
+				for (int x = minX; x <= maxX; x++)
+				{
+					glm::vec2 p((float)x, (float)y);
+					float w0 = ((points[1].x - p.x) * (points[2].y - p.y) - (points[1].y - p.y) * (points[2].x - p.x)) / area;
+					float w1 = ((points[2].x - p.x) * (points[0].y - p.y) - (points[2].y - p.y) * (points[0].x - p.x)) / area;
+					float w2 = 1.0f - w0 - w1;
+					// texel centres on an edge belong to the first
+					// triangle that reaches them
+					if ((w0 < -1e-4f) || (w1 < -1e-4f) || (w2 < -1e-4f))
+						continue;
+
+					TEXEL_SAMPLE sample;
+					sample.page = layout.page;
+					sample.x = pChart->x + g_ChartBorder + x;
+					sample.y = pChart->y + g_ChartBorder + y;
+					size_t texel = (size_t)sample.y * pageSize + sample.x;
+					if (texels.covered[texel])
+						continue;
+					texels.covered[texel] = 1;
+					sample.position = positions[0] * w0 + positions[1] * w1 + positions[2] * w2;
+					sample.normal = glm::normalize(normals[0] * w0 + normals[1] * w1 + normals[2] * w2);
+					samples.push_back(sample);
+				}
+			}
+		}
+	}
+
+	std::cout << "Baking lightmaps: " << layouts.size() << " objects, " << atlas.charts.size() << " charts on "
+		<< pages.size() << " pages of " << pageSize << " x " << pageSize << ", " << samples.size() << " texels, "
+		<< traceScene.triangles.size() << " triangles, " << m_settings.samples << " paths of "
+		<< m_settings.bounces << " bounces per texel on " << m_settings.threadCount << " threads" << std::endl;
+
+	// trace the texels on all threads, a task of texels at a time
+	std::vector<glm::vec3> irradiance(samples.size());
+	std::vector<float> occlusion(samples.size());
+	size_t taskCount = (samples.size() + g_TexelsPerTask - 1) / g_TexelsPerTask;
+	std::atomic<size_t> nextTask(0);
+	std::atomic<size_t> tasksDone(0);
+	std::atomic<unsigned long long> rayCount(0);
+	const LIGHTMAP_SETTINGS& settings = m_settings;
+	std::vector<std::thread> workers;
+	for (int t = 0; t < m_settings.threadCount; t++)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			unsigned long long rays = 0;
+			for (size_t task = nextTask++; task < taskCount; task = nextTask++)
+			{
+				size_t end = std::min((task + 1) * g_TexelsPerTask, samples.size());
+				for (size_t i = task * g_TexelsPerTask; i < end; i++)
+				{
+					TraceTexel(traceScene, settings, samples[i], irradiance[i], occlusion[i], rays);
+				}
+				tasksDone++;
+			}
+			rayCount += rays;
+		}));
+	}
+	int reported = 0;
+	while (tasksDone.load() < taskCount)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		int percent = (int)(tasksDone.load() * 100 / taskCount);
+		if (percent >= reported + 10)
+		{
+			reported = percent - percent % 10;
+			std::cout << "Baking lightmaps: " << reported << "%" << std::endl;
+		}
+	}
+	for (size_t t = 0; t < workers.size(); t++)
+	{
+		workers[t].join();
+	}
+
+	// fill the borders and compress
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		size_t texel = (size_t)samples[i].y * pageSize + samples[i].x;
+		pageTexelData[samples[i].page].irradiance[texel] = irradiance[i];
+		pageTexelData[samples[i].page].occlusion[texel] = occlusion[i];
+	}
+	atlas.irradiance.resize(atlas.IrradiancePageBytes() * pages.size());
+	atlas.occlusion.resize(atlas.OcclusionPageBytes() * pages.size());
+	for (size_t p = 0; p < pages.size(); p++)
+	{
+		DilatePage(pageTexelData[p], pageSize);
+		CompressPage(pageTexelData[p], pageSize, &atlas.irradiance[p * atlas.IrradiancePageBytes()],
+			&atlas.occlusion[p * atlas.OcclusionPageBytes()]);
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Baked lightmaps in " << seconds << " s: " << rayCount.load() << " rays, "
+		<< rayCount.load() / std::max(seconds, 1e-3) / 1e6 << " million rays per second" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Store()
+ *
+ *  This method writes a lightmap file - header, placements,
+ *  charts, then the irradiance and occlusion pages - through
+ *  a temporary file like the other caches.
+ ***********************************************************/
+bool LightmapBaker::Store(const char* filename, const LIGHTMAP_ATLAS& atlas)
+{
+	std::string path = filename;
+	size_t slash = path.find_last_of("/\\");
+	if (slash != std::string::npos)
+	{
+		MakeDirectory(path.substr(0, slash));
+	}
+
+	LIGHTMAP_FILE_HEADER header;
+	memcpy(header.magic, g_FileMagic, sizeof(g_FileMagic));
+	header.version = g_FileVersion;
+	header.sceneKey = atlas.sceneKey;
+	header.pageSize = atlas.pageSize;
+	header.pageCount = atlas.pageCount;
+	header.objectCount = (int32_t)atlas.objects.size();
+	header.chartCount = (int32_t)atlas.charts.size();
+	header.irradianceRange = atlas.irradianceRange;
+	uint32_t checksum = Checksum(CHECKSUM_SEED, atlas.objects.data(), atlas.objects.size() * sizeof(LIGHTMAP_PLACEMENT));
+	checksum = Checksum(checksum, atlas.charts.data(), atlas.charts.size() * sizeof(glm::vec4));
+	checksum = Checksum(checksum, atlas.irradiance.data(), atlas.irradiance.size());
+	header.checksum = Checksum(checksum, atlas.occlusion.data(), atlas.occlusion.size());
+
+	std::string tempFilename = path + ".tmp";
+	{
+		std::ofstream file(tempFilename.c_str(), std::ios::binary);
+		if (!file)
+		{
+			std::cout << "Could not create lightmap file:" << tempFilename << std::endl;
+			return(false);
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)atlas.objects.data(), atlas.objects.size() * sizeof(LIGHTMAP_PLACEMENT));
+		file.write((const char*)atlas.charts.data(), atlas.charts.size() * sizeof(glm::vec4));
+		file.write((const char*)atlas.irradiance.data(), atlas.irradiance.size());
+		file.write((const char*)atlas.occlusion.data(), atlas.occlusion.size());
+		if (!file.good())
+		{
+			std::cout << "Could not write lightmap file:" << tempFilename << std::endl;
+			return(false);
+		}
+	}
+
+	std::remove(path.c_str());
+	if (std::rename(tempFilename.c_str(), path.c_str()) != 0)
+	{
+		std::cout << "Could not replace lightmap file:" << path << std::endl;
+		std::remove(tempFilename.c_str());
+		return(false);
+	}
+
+	std::cout << "Wrote " << path << ": " << atlas.pageCount << " pages, "
+		<< (atlas.irradiance.size() + atlas.occlusion.size()) / 1024 << " KB" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method reads a lightmap file and validates it.  A
+ *  missing file is not reported - the scene is simply drawn
+ *  without a lightmap.  The counts of the header must add up
+ *  to the size of the file before anything is allocated, and
+ *  every placement must lie within the pages and charts.
+ ***********************************************************/
+bool LightmapBaker::Load(const char* filename, LIGHTMAP_ATLAS& atlas)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		return(false);
+	}
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	LIGHTMAP_FILE_HEADER header;
+	file.read((char*)&header, sizeof(header));
+	if (!file.good() || (memcmp(header.magic, g_FileMagic, sizeof(g_FileMagic)) != 0))
+	{
+		std::cout << "Not a lightmap file:" << filename << std::endl;
+		return(false);
+	}
+	if (header.version != g_FileVersion)
+	{
+		std::cout << "Lightmap file is stale:" << filename << std::endl;
+		return(false);
+	}
+
+	// sizes in 64 bits, each checked against what is left of
+	// the file so none of them can overflow
+	bool bValid = (header.pageSize > 0) && ((header.pageSize & 3) == 0) && (header.pageCount >= 0) &&
+		(header.objectCount >= 0) && (header.chartCount >= 0);
+	if (bValid)
+	{
+		uint64_t remaining = (uint64_t)(fileSize - (std::streamoff)sizeof(header));
+		uint64_t pageBytes = (uint64_t)header.pageSize * header.pageSize;
+		pageBytes += pageBytes / 2;
+		bValid = ((uint64_t)header.objectCount <= remaining / sizeof(LIGHTMAP_PLACEMENT));
+		if (bValid)
+		{
+			remaining -= (uint64_t)header.objectCount * sizeof(LIGHTMAP_PLACEMENT);
+			bValid = ((uint64_t)header.chartCount <= remaining / sizeof(glm::vec4));
+		}
+		if (bValid)
+		{
+			remaining -= (uint64_t)header.chartCount * sizeof(glm::vec4);
+			bValid = (remaining % pageBytes == 0) && (remaining / pageBytes == (uint64_t)header.pageCount);
+		}
+	}
+	if (!bValid)
+	{
+		std::cout << "Lightmap file is corrupt:" << filename << std::endl;
+		return(false);
+	}
+
+	atlas.sceneKey = header.sceneKey;
+	atlas.pageSize = header.pageSize;
+	atlas.pageCount = header.pageCount;
+	atlas.irradianceRange = header.irradianceRange;
+	atlas.objects.resize(header.objectCount);
+	atlas.charts.resize(header.chartCount);
+	atlas.irradiance.resize(atlas.IrradiancePageBytes() * atlas.pageCount);
+	atlas.occlusion.resize(atlas.OcclusionPageBytes() * atlas.pageCount);
+	file.read((char*)atlas.objects.data(), atlas.objects.size() * sizeof(LIGHTMAP_PLACEMENT));
+	file.read((char*)atlas.charts.data(), atlas.charts.size() * sizeof(glm::vec4));
+	file.read((char*)atlas.irradiance.data(), atlas.irradiance.size());
+	file.read((char*)atlas.occlusion.data(), atlas.occlusion.size());
+
+	uint32_t checksum = Checksum(CHECKSUM_SEED, atlas.objects.data(), atlas.objects.size() * sizeof(LIGHTMAP_PLACEMENT));
+	checksum = Checksum(checksum, atlas.charts.data(), atlas.charts.size() * sizeof(glm::vec4));
+	checksum = Checksum(checksum, atlas.irradiance.data(), atlas.irradiance.size());
+	checksum = Checksum(checksum, atlas.occlusion.data(), atlas.occlusion.size());
+	if (!file.good() || (checksum != header.checksum))
+	{
+		std::cout << "Lightmap file is corrupt:" << filename << std::endl;
+		return(false);
+	}
+
+	for (size_t i = 0; i < atlas.objects.size(); i++)
+	{
+		const LIGHTMAP_PLACEMENT& placement = atlas.objects[i];
+		if (placement.firstChart == -1)
+		{
+			continue;
+		}
+		if ((placement.firstChart < 0) || (placement.chartCount < 0) ||
+			(placement.chartCount > header.chartCount - placement.firstChart) ||
+			(placement.layer < 0) || (placement.layer >= header.pageCount))
+		{
+			std::cout << "Lightmap file is corrupt:" << filename << " (object " << i << " lies outside the atlas)" << std::endl;
+			return(false);
+		}
+	}
+
+	return(true);
+}
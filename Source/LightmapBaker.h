@@ -0,0 +1,200 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.h
+// ============
+// bake the light of the static garden - direct light, bounced light and
+// ambient occlusion - into compressed lightmap pages with a multithreaded
+// CPU path tracer
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshGenerator.h"
+#include "TerrainHeightfield.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  LIGHTMAP_SETTINGS
+ *
+ *  Resolution and quality of a bake, filled from the command
+ *  line in main().
+ ***********************************************************/
+struct LIGHTMAP_SETTINGS
+{
+	// lightmap texels per world unit
+	float texelsPerUnit;
+	// side of the square pages of the atlas (multiple of 4)
+	int pageSize;
+	// longest side of a chart in texels; larger objects get
+	// fewer texels per unit
+	int maxChartSize;
+	// paths per texel; each also samples every light once
+	int samples;
+	// times the light bounces off the scene (0 - 2)
+	int bounces;
+	// distance within which a surface occludes a texel from
+	// the ambient light
+	float occlusionDistance;
+	// spacing of the terrain's triangles in the ray tracer
+	float terrainSpacing;
+	// worker threads (0 = one per core)
+	int threadCount;
+};
+
+/***********************************************************
+ *  LIGHTMAP_LIGHT
+ *
+ *  A light source of the bake.  The ambient and specular
+ *  parts of the scene's lights stay in the shader, so only
+ *  the diffuse light is baked.
+ ***********************************************************/
+struct LIGHTMAP_LIGHT
+{
+	// position, or the direction the light shines in
+	glm::vec3 position;
+	glm::vec3 diffuseColor;
+	bool bDirectional;
+};
+
+/***********************************************************
+ *  LIGHTMAP_OBJECT
+ *
+ *  A scene object as the baker sees it, in the order of the
+ *  scene objects.
+ ***********************************************************/
+struct LIGHTMAP_OBJECT
+{
+	SCENE_MESH mesh;
+	glm::mat4 model;
+	// the object's surface color is its material's diffuse
+	// color times the average of its texture (empty = none)
+	glm::vec3 diffuseColor;
+	std::string textureFile;
+	// gets lightmap charts
+	bool bLightmapped;
+	// blocks and bounces light
+	bool bOccluder;
+	// the terrain: its surface is the heightfield of the
+	// scene's terrain shape, not the mesh
+	bool bTerrain;
+};
+
+/***********************************************************
+ *  LIGHTMAP_SCENE
+ *
+ *  Everything a bake depends on.  A lightmap is only used
+ *  with the scene it was baked from - LightmapBaker::
+ *  SceneKey() tells.
+ ***********************************************************/
+struct LIGHTMAP_SCENE
+{
+	std::vector<LIGHTMAP_OBJECT> objects;
+	std::vector<LIGHTMAP_LIGHT> lights;
+	TERRAIN_SHAPE terrain;
+};
+
+/***********************************************************
+ *  LIGHTMAP_PLACEMENT
+ *
+ *  Where an object's charts are: all of them on one page.
+ ***********************************************************/
+struct LIGHTMAP_PLACEMENT
+{
+	// first entry in LIGHTMAP_ATLAS::charts (-1 = the object
+	// has no lightmap)
+	int32_t firstChart;
+	int32_t chartCount;
+	// page of the atlas
+	int32_t layer;
+	int32_t reserved;
+};
+
+/***********************************************************
+ *  LIGHTMAP_ATLAS
+ *
+ *  The baked lightmap: pageCount square pages of pageSize
+ *  texels, bottom row first, in two compressed layers:
+ *
+ *  - irradiance: the light reaching the surface from the
+ *    light sources, directly and bounced, encoded as RGBM
+ *    (rgb * a * irradianceRange) in BC3 blocks
+ *  - occlusion: the part of the hemisphere open to ambient
+ *    light, in BC4 blocks
+ *
+ *  A chart coordinate (u, v) of an object maps to the page
+ *  coordinate charts[i].xy + (u, v) * charts[i].zw, which
+ *  puts the chart's corners on texel centres.  Charts are
+ *  aligned to the 4 x 4 blocks and have two texels of
+ *  border, so neither filtering nor compression mixes them.
+ ***********************************************************/
+struct LIGHTMAP_ATLAS
+{
+	uint64_t sceneKey;
+	int pageSize;
+	int pageCount;
+	float irradianceRange;
+	// one per scene object
+	std::vector<LIGHTMAP_PLACEMENT> objects;
+	std::vector<glm::vec4> charts;
+	std::vector<unsigned char> irradiance;
+	std::vector<unsigned char> occlusion;
+
+	// compressed bytes of a page of each layer
+	size_t IrradiancePageBytes() const { return (size_t)pageSize * pageSize; }
+	size_t OcclusionPageBytes() const { return (size_t)pageSize * pageSize / 2; }
+};
+
+/***********************************************************
+ *  LightmapBaker
+ *
+ *  Bakes the light of a static scene on the CPU, so baking
+ *  needs no window, GL context or GPU:
+ *
+ *  - every lightmapped object gets a chart per connected
+ *    piece of its mesh (LightmapCharts), sized from the
+ *    piece's extent in the world, and the charts of each
+ *    object are packed onto one page of the atlas; the
+ *    terrain is a single chart over the grounds
+ *  - the occluders' triangles go into a bounding volume
+ *    hierarchy, the terrain as a grid over its heightfield
+ *  - every texel covered by a chart traces paths from its
+ *    surface point: a shadow ray to each light gives the
+ *    direct light, cosine-distributed rays give the bounced
+ *    light (each bounce lit by the lights in turn) and the
+ *    share of them that hit something nearby the ambient
+ *    occlusion.  Texels are shared out between all cores and
+ *    seeded by position, so a bake is reproducible
+ *  - texels next to the covered ones get the light of their
+ *    chart's covered neighbours, so filtering never reads
+ *    unlit texels, and the pages are block compressed
+ *
+ *  The lighting matches the scene shader: no falloff with
+ *  distance, and light reflected by a surface is its color
+ *  times the light it receives.
+ ***********************************************************/
+class LightmapBaker
+{
+public:
+	// constructor
+	LightmapBaker(const LIGHTMAP_SETTINGS& settings);
+
+	// default settings: 4 texels per unit on 1024 texel pages,
+	// 64 paths of 2 bounces, occlusion within 2 units
+	static LIGHTMAP_SETTINGS DefaultSettings();
+	// 64-bit key of a scene, stored with its lightmap
+	static uint64_t SceneKey(const LIGHTMAP_SCENE& scene);
+
+	// bake the lightmap of a scene
+	bool Bake(const LIGHTMAP_SCENE& scene, LIGHTMAP_ATLAS& atlas) const;
+
+	// write a lightmap file, and read one back
+	static bool Store(const char* filename, const LIGHTMAP_ATLAS& atlas);
+	static bool Load(const char* filename, LIGHTMAP_ATLAS& atlas);
+
+private:
+	LIGHTMAP_SETTINGS m_settings;
+};
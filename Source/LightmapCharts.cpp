@@ -0,0 +1,161 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapcharts.cpp
+// ============
+// split a mesh into the charts its lightmap is laid out in, and give every
+// vertex its coordinate within its chart
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightmapCharts.h"
+#include "MeshGenerator.h"
+
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// a connected piece of a mesh
+	struct CHART
+	{
+		// extent of the vertex positions
+		float positionMin[3];
+		float positionMax[3];
+		// extent of the texture coordinates
+		float uvMin[2];
+		float uvMax[2];
+		// position in the final numbering
+		int index;
+	};
+
+	/***********************************************************
+	 *  FindRoot()
+	 *
+	 *  Root of a vertex in the union-find forest, halving the
+	 *  path on the way.
+	 ***********************************************************/
+	uint32_t FindRoot(std::vector<uint32_t>& parents, uint32_t vertex)
+	{
+		while (parents[vertex] != vertex)
+		{
+			parents[vertex] = parents[parents[vertex]];
+			vertex = parents[vertex];
+		}
+		return(vertex);
+	}
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method joins the vertices of every triangle into
+ *  pieces, measures each piece and numbers the pieces in
+ *  the order of their centres (x, then y, then z).
+ ***********************************************************/
+int LightmapCharts::Build(const float* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+	std::vector<float>& chartVertices)
+{
+	std::vector<uint32_t> parents(vertexCount);
+	std::vector<unsigned char> used(vertexCount, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		parents[v] = v;
+	}
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		used[indices[i]] = used[indices[i + 1]] = used[indices[i + 2]] = 1;
+		uint32_t a = FindRoot(parents, indices[i]);
+		for (int corner = 1; corner < 3; corner++)
+		{
+			uint32_t b = FindRoot(parents, indices[i + corner]);
+			if (a != b)
+			{
+				parents[std::max(a, b)] = std::min(a, b);
+				a = std::min(a, b);
+			}
+		}
+	}
+
+	// one chart per root; vertices no triangle uses (the
+	// sphere's spare pole vertices) may be dropped by the mesh
+	// optimizer, so they get no chart of their own
+	std::vector<int> rootCharts(vertexCount, -1);
+	std::vector<int> vertexCharts(vertexCount, -1);
+	std::vector<CHART> charts;
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		if (!used[v])
+			continue;
+		uint32_t root = FindRoot(parents, v);
+		if (rootCharts[root] < 0)
+		{
+			CHART chart;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				chart.positionMin[axis] = 1e30f;
+				chart.positionMax[axis] = -1e30f;
+			}
+			chart.uvMin[0] = chart.uvMin[1] = 1e30f;
+			chart.uvMax[0] = chart.uvMax[1] = -1e30f;
+			chart.index = 0;
+			rootCharts[root] = (int)charts.size();
+			charts.push_back(chart);
+		}
+		vertexCharts[v] = rootCharts[root];
+
+		const float* vertex = vertices + (size_t)v * MESH_FLOATS_PER_VERTEX;
+		CHART& chart = charts[vertexCharts[v]];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			chart.positionMin[axis] = std::min(chart.positionMin[axis], vertex[axis]);
+			chart.positionMax[axis] = std::max(chart.positionMax[axis], vertex[axis]);
+		}
+		for (int axis = 0; axis < 2; axis++)
+		{
+			chart.uvMin[axis] = std::min(chart.uvMin[axis], vertex[6 + axis]);
+			chart.uvMax[axis] = std::max(chart.uvMax[axis], vertex[6 + axis]);
+		}
+	}
+
+	// number the charts by the centres of their extents, which
+	// neither the vertex order nor welded duplicates change
+	std::vector<int> order(charts.size());
+	for (size_t i = 0; i < charts.size(); i++)
+	{
+		order[i] = (int)i;
+	}
+	std::sort(order.begin(), order.end(), [&charts](int a, int b)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float centerA = charts[a].positionMin[axis] + charts[a].positionMax[axis];
+			float centerB = charts[b].positionMin[axis] + charts[b].positionMax[axis];
+			if (centerA != centerB)
+				return(centerA < centerB);
+		}
+		return(false);
+	});
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		charts[order[i]].index = (int)i;
+	}
+
+	chartVertices.resize((size_t)vertexCount * LIGHTMAP_FLOATS_PER_VERTEX);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		const float* vertex = vertices + (size_t)v * MESH_FLOATS_PER_VERTEX;
+		float* chartVertex = &chartVertices[(size_t)v * LIGHTMAP_FLOATS_PER_VERTEX];
+		if (vertexCharts[v] < 0)
+		{
+			chartVertex[0] = chartVertex[1] = chartVertex[2] = 0.0f;
+			continue;
+		}
+		const CHART& chart = charts[vertexCharts[v]];
+		for (int axis = 0; axis < 2; axis++)
+		{
+			float extent = chart.uvMax[axis] - chart.uvMin[axis];
+			chartVertex[axis] = (extent > 0.0f) ? (vertex[6 + axis] - chart.uvMin[axis]) / extent : 0.0f;
+		}
+		chartVertex[2] = (float)chart.index;
+	}
+
+	return((int)charts.size());
+}
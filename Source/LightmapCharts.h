@@ -0,0 +1,42 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapcharts.h
+// ============
+// split a mesh into the charts its lightmap is laid out in, and give every
+// vertex its coordinate within its chart
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// floats per vertex of the lightmap stream: chart u, v and
+// the chart index
+const int LIGHTMAP_FLOATS_PER_VERTEX = 3;
+
+/***********************************************************
+ *  LightmapCharts
+ *
+ *  The basic meshes' texture coordinates tile (the scene
+ *  scales them per object) and so cannot address a lightmap,
+ *  but within each connected piece of a mesh they cover the
+ *  unit square once: the box is six separate faces, the
+ *  other meshes one piece each.  Every connected piece is a
+ *  chart, and a vertex's chart coordinate is its texture
+ *  coordinate stretched to fill the unit square over the
+ *  piece's extent.
+ *
+ *  Charts are numbered by the centre of their extent, so
+ *  the numbering does not depend on the vertex order - the
+ *  baker, working on freshly generated meshes, and the mesh
+ *  library, working on optimized or cached ones, agree.
+ ***********************************************************/
+class LightmapCharts
+{
+public:
+	// fill LIGHTMAP_FLOATS_PER_VERTEX floats per vertex of a
+	// mesh in the MESH_FLOATS_PER_VERTEX layout; returns the
+	// number of charts
+	static int Build(const float* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+		std::vector<float>& chartVertices);
+};
@@ -1,5 +1,7 @@
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
+#include <algorithm>        // std::min
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -11,8 +13,14 @@
 
 #include "SceneManager.h"
 #include "ViewManager.h"
-#include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "RenderThread.h"
+#include "FrameScheduler.h"
+#include "CameraPath.h"
+#include "EntityBenchmark.h"
+#include "VirtualTextureBuilder.h"
+#include "HeadlessRenderer.h"
+#include "RenderReplay.h"
 
 // Namespace for declaring global variables
 namespace
@@ -29,12 +37,74 @@ namespace
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// render thread object that owns the GL context and draws the scene
+	RenderThread* g_RenderThread = nullptr;
+	// frame scheduler object for frame pacing and idle detection
+	FrameScheduler* g_FrameScheduler = nullptr;
+
+	// frame pacing settings, adjustable from the command line
+	FRAME_SCHEDULER_SETTINGS g_FrameSettings = FrameScheduler::DefaultSettings();
+	// dynamic resolution settings, adjustable from the command line
+	DYNAMIC_RESOLUTION_SETTINGS g_ResolutionSettings = DynamicResolution::DefaultSettings();
+	// set when the window must be redrawn even if the view is unchanged
+	bool g_bForceRedraw = true;
+
+	// camera path file to record to / play back from (NULL = none)
+	const char* g_RecordPathFile = NULL;
+	const char* g_PlaybackPathFile = NULL;
+	// file to write the per-frame playback timings to (NULL = none)
+	const char* g_PlaybackCSVFile = NULL;
+	// fixed simulation time step (in seconds) used during playback
+	float g_PlaybackTimeStep = 1.0f / 60.0f;
+
+	// radius of the sphere the camera collides with the scene as
+	const float g_CameraRadius = 0.5f;
+
+	// vertex layout of the mesh buffers, adjustable from the command line
+	VERTEX_FORMAT g_VertexFormat = VERTEX_FORMAT_FULL;
+	// draw the scene with one multi-draw indirect call when supported
+	bool g_bMultiDraw = true;
+	// depth pre-pass of the multi-draw path's opaque objects
+	DEPTH_PREPASS_SETTINGS g_DepthPrepassSettings = DepthPrepass::DefaultSettings();
+	// culling of the multi-draw path's opaque objects on the GPU
+	GPU_CULLING_SETTINGS g_GPUCullingSettings = GPUCulling::DefaultSettings();
+	// apply edits to the scene file and shaders while running
+	bool g_bHotReload = false;
+	// longest idle wait while hot reloading, so edits show up quickly
+	const double g_HotReloadPollInterval = 0.02;
+	// number of entities to benchmark the entity store with (0 = run
+	// the application)
+	size_t g_BenchEntityCount = 0;
+	// report rendered frames that made heap allocations
+	bool g_bAllocationCheck = false;
+	// memory budgets of the streamed ground texture
+	VIRTUAL_TEXTURE_SETTINGS g_VirtualTextureSettings = VirtualTexture::DefaultSettings();
+	// build the ground's virtual texture file and exit
+	bool g_bBuildGroundTexture = false;
+	// bake the topiaries' impostor atlases and exit
+	bool g_bBakeImpostors = false;
+	// bake the garden's lightmap and exit
+	bool g_bBakeLightmaps = false;
+	LIGHTMAP_SETTINGS g_LightmapSettings = LightmapBaker::DefaultSettings();
+	// draw the scene with the software rasterizer and exit
+	bool g_bSoftwareRender = false;
+	HEADLESS_RENDER_SETTINGS g_SoftwareRenderSettings = HeadlessRenderer::DefaultSettings();
+	// file to capture the draws of the first frames to (NULL = none)
+	const char* g_CaptureFile = NULL;
+	int g_CaptureFrameCount = 60;
+	// replay a capture file and exit
+	RENDER_REPLAY_SETTINGS g_ReplaySettings = RenderReplay::DefaultSettings();
+	// video recording and screenshot settings
+	FRAME_CAPTURE_SETTINGS g_FrameCaptureSettings = FrameCapture::DefaultSettings();
+	// frame rate of the recorded video (0 = that of the playback step)
+	int g_VideoFrameRate = 0;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+bool ParseCommandLine(int argc, char* argv[]);
 
 
 /***********************************************************
@@ -45,6 +115,48 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// read the optional settings passed on the command line
+	if (ParseCommandLine(argc, argv) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	// the entity benchmark needs no window - run it and exit
+	if (g_BenchEntityCount > 0)
+	{
+		return(EntityBenchmark::Run(g_BenchEntityCount) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	// so does building the ground texture
+	if (g_bBuildGroundTexture)
+	{
+		return(VirtualTextureBuilder::BuildGround() ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	// and baking the impostors
+	if (g_bBakeImpostors)
+	{
+		return(SceneManager::BakeImpostors() ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	// and baking the lightmap
+	if (g_bBakeLightmaps)
+	{
+		return(SceneManager::BakeLightmaps(g_LightmapSettings) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	// and drawing with the software rasterizer, along the
+	// playback path if one was given
+	if (g_bSoftwareRender)
+	{
+		g_SoftwareRenderSettings.cameraPathFile = g_PlaybackPathFile;
+		g_SoftwareRenderSettings.timeStep = g_PlaybackTimeStep;
+		return(HeadlessRenderer::Run(g_SoftwareRenderSettings) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	// and replaying a capture
+	if (NULL != g_ReplaySettings.captureFile)
+	{
+		g_ReplaySettings.rasterizer = g_SoftwareRenderSettings.rasterizer;
+		g_ReplaySettings.csvFile = g_PlaybackCSVFile;
+		return(RenderReplay::Run(g_ReplaySettings) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -63,14 +175,14 @@ int main(int argc, char* argv[])
 	// Capture and hide the mouse cursor inside the window for FPS-style control
 	glfwSetInputMode(g_Window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-	// Register a callback for mouse movement
-	glfwSetCursorPosCallback(g_Window, [](GLFWwindow* window, double xpos, double ypos) {
-		g_ViewManager->MouseCallback(window, xpos, ypos);
-	});
+	// mouse, scroll and keyboard callbacks are registered by the view
+	// manager when the window is created; they queue timestamped
+	// events that are latched once per simulation step
 
-	// Register a callback for mouse scroll
-	glfwSetScrollCallback(g_Window, [](GLFWwindow* window, double xoffset, double yoffset) {
-		g_ViewManager->ScrollCallback(window, xoffset, yoffset);
+	// Register a callback for window exposure / resizing, which needs
+	// a redraw even when the view itself has not changed
+	glfwSetWindowRefreshCallback(g_Window, [](GLFWwindow* /*window*/) {
+		g_bForceRedraw = true;
 	});
 
 	// if GLEW fails initialization, then terminate the application
@@ -89,45 +201,188 @@ int main(int argc, char* argv[])
 
 	// try to create a new scene manager object and prepare the 3D scene
 	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager->SetVertexFormat(g_VertexFormat);
+	g_SceneManager->SetMultiDrawEnabled(g_bMultiDraw);
+	g_SceneManager->SetDepthPrepassSettings(g_DepthPrepassSettings);
+	g_SceneManager->SetGPUCullingSettings(g_GPUCullingSettings);
+	g_SceneManager->SetVirtualTextureSettings(g_VirtualTextureSettings);
+	if (NULL != g_CaptureFile)
+	{
+		g_SceneManager->StartCapture(g_CaptureFile, g_CaptureFrameCount);
+	}
 	g_SceneManager->PrepareScene();
+	if (g_bHotReload)
+	{
+		g_SceneManager->EnableHotReload();
+		g_FrameSettings.idleWaitTimeout = std::min(g_FrameSettings.idleWaitTimeout, g_HotReloadPollInterval);
+	}
+
+	// keep the camera out of the hedges using the scene's spatial index
+	g_ViewManager->SetCollisionGrid(g_SceneManager->GetSpatialGrid(), g_CameraRadius);
+
+	// the GL context now belongs to the render thread - release it
+	// here so the render thread can make it current on its side
+	g_FrameScheduler = new FrameScheduler(g_FrameSettings);
+	g_RenderThread = new RenderThread(g_Window, g_ViewManager, g_SceneManager, g_FrameScheduler);
+	g_RenderThread->SetDynamicResolution(g_ResolutionSettings);
+	if (g_VideoFrameRate <= 0)
+	{
+		g_VideoFrameRate = (int)(1.0f / g_PlaybackTimeStep + 0.5f);
+	}
+	g_FrameCaptureSettings.frameRate = g_VideoFrameRate;
+	g_RenderThread->SetFrameCapture(g_FrameCaptureSettings);
+	g_RenderThread->SetAllocationCheck(g_bAllocationCheck);
+	SnapshotBuffer* pSnapshots = g_RenderThread->GetSnapshotBuffer();
+
+	// camera path being recorded or played back
+	CameraPath cameraPath;
+	FrameStatistics playbackStatistics;
+	bool bPlayback = false;
+	float playbackTime = 0.0f;
+	if (NULL != g_PlaybackPathFile)
+	{
+		bPlayback = cameraPath.Load(g_PlaybackPathFile);
+		if (bPlayback)
+		{
+			std::cout << "Playing back " << cameraPath.GetKeyframeCount() << " keyframes ("
+				<< cameraPath.GetDuration() << " s) from " << g_PlaybackPathFile << std::endl;
+			g_RenderThread->SetFrameStatistics(&playbackStatistics);
+		}
+	}
+	double recordStartTime = glfwGetTime();
+
+	glfwMakeContextCurrent(NULL);
+	g_RenderThread->Start();
 
 	// to track deltaTime
-	float lastFrame = 0.0f;
+	float lastFrame = glfwGetTime();
+	// sequence number of the published scene snapshots
+	unsigned long long frameIndex = 0;
 
-	// loop will keep running until the application is closed 
-	// or until an error has occurred
+	// this loop is the simulation thread - it will keep running until
+	// the application is closed or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
+		// query the latest GLFW events - while nothing in the view
+		// changes, block until an event arrives instead of spinning
+		if (g_FrameScheduler->IsIdle())
+			glfwWaitEventsTimeout(g_FrameScheduler->GetIdleWaitTimeout());
+		else
+			glfwPollEvents();
+
+		// queue a reload of edited scene files and shaders - the
+		// render thread applies it before the next frame it draws
+		if (g_bHotReload && g_SceneManager->CheckForChanges())
+		{
+			g_bForceRedraw = true;
+		}
+		// keep drawing while ground texture pages stream in
+		if (g_SceneManager->IsStreaming())
+		{
+			g_bForceRedraw = true;
+		}
+
 		// Calculate delta time of current frame
 		float currentFrame = glfwGetTime();
 		float deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
-		// Process keyboard input
-		g_ViewManager->ProcessKeyboardEvents(deltaTime);
-
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
-
-		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		// convert from 3D object space to 2D view
-		g_ViewManager->PrepareSceneView();
-
-		// refresh the 3D scene
-		g_SceneManager->RenderScene(g_ViewManager->IsOrthographicProjection());
-
+		// latch the queued input right before the view matrix is
+		// built, so the snapshot reflects the most recent events
+		g_ViewManager->LatchInputEvents(glfwGetTime());
+
+		// the screenshot is read back from the next drawn frame, so
+		// draw one even while idle
+		if (g_ViewManager->TakeScreenshotRequest())
+		{
+			g_RenderThread->RequestScreenshot();
+			g_bForceRedraw = true;
+		}
+
+		// during playback the camera follows the path with a fixed
+		// time step, so every run draws exactly the same frames
+		if (bPlayback)
+		{
+			CAMERA_KEYFRAME keyframe;
+			cameraPath.Sample(playbackTime, keyframe);
+			g_ViewManager->SetCameraKeyframe(keyframe);
+			deltaTime = g_PlaybackTimeStep;
+		}
+
+		// build the immutable snapshot for this step in the back slot
+		SCENE_SNAPSHOT& snapshot = pSnapshots->BeginWrite();
+		snapshot.simulationTime = currentFrame;
+		snapshot.deltaTime = deltaTime;
+		glfwGetFramebufferSize(g_Window, &snapshot.framebufferWidth, &snapshot.framebufferHeight);
+		g_ViewManager->UpdateSceneSnapshot(snapshot);
+
+		// an identical frame is not drawn again (idle mode), except
+		// during playback, where every step counts as a frame
+		if (g_FrameScheduler->ShouldPublish(snapshot, g_bForceRedraw || bPlayback))
+		{
+			if (NULL != g_RecordPathFile)
+			{
+				cameraPath.AddKeyframe(g_ViewManager->GetCameraKeyframe(
+					(float)(glfwGetTime() - recordStartTime)));
+			}
+
+			snapshot.frameIndex = ++frameIndex;
+			pSnapshots->Publish();
+			g_bForceRedraw = false;
+
+			// stay at most one step ahead of the render thread; the
+			// timeout keeps the window responsive if a frame stalls.
+			// Playback draws every step however long it takes, so it
+			// keeps waiting, handling events until the window closes
+			while (!pSnapshots->WaitForConsumer(0.1) && bPlayback)
+			{
+				glfwPollEvents();
+				if (glfwWindowShouldClose(g_Window))
+					break;
+			}
+		}
+
+		// advance the playback and stop at the end of the path
+		if (bPlayback)
+		{
+			playbackTime += g_PlaybackTimeStep;
+			if (playbackTime > cameraPath.GetDuration())
+			{
+				glfwSetWindowShouldClose(g_Window, true);
+			}
+		}
+	}
 
-		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+	// stop the render thread and take the GL context back for cleanup
+	g_RenderThread->Stop();
+	glfwMakeContextCurrent(g_Window);
 
-		// query the latest GLFW events
-		glfwPollEvents();
+	// write out the recorded path / the playback statistics
+	if ((NULL != g_RecordPathFile) && cameraPath.Save(g_RecordPathFile))
+	{
+		std::cout << "Recorded " << cameraPath.GetKeyframeCount() << " keyframes to " << g_RecordPathFile << std::endl;
+	}
+	if (bPlayback)
+	{
+		g_RenderThread->SetFrameStatistics(NULL);
+		playbackStatistics.PrintReport("Camera path playback");
+		if (NULL != g_PlaybackCSVFile)
+		{
+			playbackStatistics.WriteCSV(g_PlaybackCSVFile);
+		}
 	}
 
 	// clear the allocated manager objects from memory
+	if (NULL != g_RenderThread)
+	{
+		delete g_RenderThread;
+		g_RenderThread = NULL;
+	}
+	if (NULL != g_FrameScheduler)
+	{
+		delete g_FrameScheduler;
+		g_FrameScheduler = NULL;
+	}
 	if (NULL != g_SceneManager)
 	{
 		delete g_SceneManager;
@@ -199,5 +454,310 @@ bool InitializeGLEW()
 	std::cout << "INFO: OpenGL Successfully Initialized\n";
 	std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << "\n" << std::endl;
 
+	return(true);
+}
+
+/***********************************************************
+ *	ParseCommandLine()
+ *
+ *  This function reads the optional command line settings:
+ *    --fps <rate>                  pace frames to this rate (0 = off)
+ *    --vsync <off|on|adaptive>     swap interval mode
+ *    --no-idle                     redraw even when nothing changed
+ *    --dynres <ms>                 scale the resolution to hit this
+ *                                  GPU time per frame
+ *    --dynres-min <scale>          smallest resolution scale (0.5)
+ *    --dynres-max <scale>          largest resolution scale (1.0)
+ *    --record <file>               record the camera path to a file
+ *    --playback <file>             play a recorded camera path back
+ *    --playback-step <seconds>     fixed playback time step (1/60)
+ *    --playback-csv <file>         write per-frame playback timings
+ *    --vertex-format <full|compact> vertex layout of the meshes
+ *    --multi-draw <on|off>         one indirect draw call for the
+ *                                  whole scene (on)
+ *    --depth-prepass <off|on|auto> draw the opaque objects' depth
+ *                                  first and shade each pixel once;
+ *                                  auto times both ways and keeps
+ *                                  the faster (off)
+ *    --gpu-culling <mode>          cull the opaque objects in a
+ *                                  compute shader: off, frustum or
+ *                                  occlusion (also against the last
+ *                                  frame's depth); nothing is read
+ *                                  back (off)
+ *    --gpu-culling-check           compare the GPU culling with the
+ *                                  CPU's every frame and report
+ *    --hot-reload                  apply edits of the scene file and
+ *                                  shaders while running
+ *    --bench-entities [count]      time the entity store against an
+ *                                  array of structs and exit (100000)
+ *    --alloc-check                 report frames that made heap
+ *                                  allocations after the warm-up
+ *    --vt-budget <MB>              GPU memory of the streamed ground
+ *                                  texture (32)
+ *    --build-ground-texture        write the ground's virtual texture
+ *                                  file and exit
+ *    --bake-impostors              bake the impostor atlases of the
+ *                                  topiaries into the cache and exit
+ *    --bake-lightmaps              bake the garden's light and ambient
+ *                                  occlusion into Lightmaps and exit
+ *    --lightmap-density <texels>   lightmap texels per unit (4)
+ *    --lightmap-samples <paths>    paths traced per texel (64)
+ *    --lightmap-bounces <count>    bounces of the baked light, 0 - 2
+ *                                  (2)
+ *    --lightmap-threads <count>    baking threads (0 = per core)
+ *    --software-render [image.tga] draw the scene with the software
+ *                                  rasterizer, without a window, and
+ *                                  write the last frame; follows the
+ *                                  --playback path if given
+ *    --software-threads <count>    rasterizer threads (0 = per core)
+ *    --software-frames <count>     frames to draw without a path (60)
+ *    --compare-reference <image>   fail the software render if its
+ *                                  last frame differs from the image
+ *    --reference-error <error>     allowed RMS error, 8-bit steps (2)
+ *    --capture <file> [frames]     record the draws of the setup and
+ *                                  the first frames (60) to a file
+ *    --replay <file>               replay a capture on the software
+ *                                  rasterizer, report its state
+ *                                  changes, overdraw and costliest
+ *                                  draws and exit; timings go to
+ *                                  --playback-csv
+ *    --replay-loops <count>        timed passes over the frames (3)
+ *    --record-video <dir|file.y4m> record every drawn frame as a PNG
+ *                                  sequence or a Y4M video; use with
+ *                                  --playback for a steady frame rate
+ *    --video-fps <rate>            frame rate of the Y4M video (that
+ *                                  of --playback-step)
+ ***********************************************************/
+bool ParseCommandLine(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "--fps") == 0) && (i + 1 < argc))
+		{
+			g_FrameSettings.targetFrameRate = (float)atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--vsync") == 0) && (i + 1 < argc))
+		{
+			const char* mode = argv[++i];
+			if (strcmp(mode, "off") == 0)
+				g_FrameSettings.syncMode = SYNC_OFF;
+			else if (strcmp(mode, "on") == 0)
+				g_FrameSettings.syncMode = SYNC_VSYNC;
+			else if (strcmp(mode, "adaptive") == 0)
+				g_FrameSettings.syncMode = SYNC_ADAPTIVE;
+			else
+			{
+				std::cerr << "Unknown vsync mode: " << mode << std::endl;
+				return(false);
+			}
+		}
+		else if (strcmp(argv[i], "--no-idle") == 0)
+		{
+			g_FrameSettings.bIdleEnabled = false;
+		}
+		else if ((strcmp(argv[i], "--dynres") == 0) && (i + 1 < argc))
+		{
+			g_ResolutionSettings.bEnabled = true;
+			g_ResolutionSettings.targetFrameTime = (float)atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--dynres-min") == 0) && (i + 1 < argc))
+		{
+			g_ResolutionSettings.minScale = (float)atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--dynres-max") == 0) && (i + 1 < argc))
+		{
+			g_ResolutionSettings.maxScale = (float)atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--record") == 0) && (i + 1 < argc))
+		{
+			g_RecordPathFile = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--playback") == 0) && (i + 1 < argc))
+		{
+			g_PlaybackPathFile = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--playback-step") == 0) && (i + 1 < argc))
+		{
+			const char* step = argv[++i];
+			g_PlaybackTimeStep = (float)atof(step);
+			if (!(g_PlaybackTimeStep > 0.0f))
+			{
+				std::cerr << "Invalid playback step: " << step << std::endl;
+				return(false);
+			}
+		}
+		else if ((strcmp(argv[i], "--playback-csv") == 0) && (i + 1 < argc))
+		{
+			g_PlaybackCSVFile = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--vertex-format") == 0) && (i + 1 < argc))
+		{
+			const char* format = argv[++i];
+			if (strcmp(format, "full") == 0)
+				g_VertexFormat = VERTEX_FORMAT_FULL;
+			else if (strcmp(format, "compact") == 0)
+				g_VertexFormat = VERTEX_FORMAT_COMPACT;
+			else
+			{
+				std::cerr << "Unknown vertex format: " << format << std::endl;
+				return(false);
+			}
+		}
+		else if ((strcmp(argv[i], "--multi-draw") == 0) && (i + 1 < argc))
+		{
+			const char* mode = argv[++i];
+			if (strcmp(mode, "on") == 0)
+				g_bMultiDraw = true;
+			else if (strcmp(mode, "off") == 0)
+				g_bMultiDraw = false;
+			else
+			{
+				std::cerr << "Unknown multi-draw mode: " << mode << std::endl;
+				return(false);
+			}
+		}
+		else if ((strcmp(argv[i], "--depth-prepass") == 0) && (i + 1 < argc))
+		{
+			const char* mode = argv[++i];
+			if (strcmp(mode, "off") == 0)
+				g_DepthPrepassSettings.mode = DEPTH_PREPASS_OFF;
+			else if (strcmp(mode, "on") == 0)
+				g_DepthPrepassSettings.mode = DEPTH_PREPASS_ON;
+			else if (strcmp(mode, "auto") == 0)
+				g_DepthPrepassSettings.mode = DEPTH_PREPASS_AUTO;
+			else
+			{
+				std::cerr << "Unknown depth pre-pass mode: " << mode << std::endl;
+				return(false);
+			}
+		}
+		else if ((strcmp(argv[i], "--gpu-culling") == 0) && (i + 1 < argc))
+		{
+			const char* mode = argv[++i];
+			if (strcmp(mode, "off") == 0)
+				g_GPUCullingSettings.mode = GPU_CULLING_OFF;
+			else if (strcmp(mode, "frustum") == 0)
+				g_GPUCullingSettings.mode = GPU_CULLING_FRUSTUM;
+			else if (strcmp(mode, "occlusion") == 0)
+				g_GPUCullingSettings.mode = GPU_CULLING_OCCLUSION;
+			else
+			{
+				std::cerr << "Unknown GPU culling mode: " << mode << std::endl;
+				return(false);
+			}
+		}
+		else if (strcmp(argv[i], "--gpu-culling-check") == 0)
+		{
+			g_GPUCullingSettings.bValidate = true;
+		}
+		else if (strcmp(argv[i], "--hot-reload") == 0)
+		{
+			g_bHotReload = true;
+		}
+		else if (strcmp(argv[i], "--bench-entities") == 0)
+		{
+			g_BenchEntityCount = 100000;
+			if ((i + 1 < argc) && (atoi(argv[i + 1]) > 0))
+			{
+				g_BenchEntityCount = (size_t)atoi(argv[++i]);
+			}
+		}
+		else if (strcmp(argv[i], "--alloc-check") == 0)
+		{
+			g_bAllocationCheck = true;
+		}
+		else if ((strcmp(argv[i], "--vt-budget") == 0) && (i + 1 < argc))
+		{
+			g_VirtualTextureSettings.gpuBudget = (size_t)(atof(argv[++i]) * 1024.0 * 1024.0);
+		}
+		else if (strcmp(argv[i], "--build-ground-texture") == 0)
+		{
+			g_bBuildGroundTexture = true;
+		}
+		else if (strcmp(argv[i], "--bake-impostors") == 0)
+		{
+			g_bBakeImpostors = true;
+		}
+		else if (strcmp(argv[i], "--bake-lightmaps") == 0)
+		{
+			g_bBakeLightmaps = true;
+		}
+		else if ((strcmp(argv[i], "--lightmap-density") == 0) && (i + 1 < argc))
+		{
+			g_LightmapSettings.texelsPerUnit = (float)atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--lightmap-samples") == 0) && (i + 1 < argc))
+		{
+			g_LightmapSettings.samples = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--lightmap-bounces") == 0) && (i + 1 < argc))
+		{
+			g_LightmapSettings.bounces = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--lightmap-threads") == 0) && (i + 1 < argc))
+		{
+			g_LightmapSettings.threadCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--software-render") == 0)
+		{
+			g_bSoftwareRender = true;
+			// the image file is optional
+			if ((i + 1 < argc) && (argv[i + 1][0] != '-'))
+				g_SoftwareRenderSettings.outputFile = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--software-threads") == 0) && (i + 1 < argc))
+		{
+			g_SoftwareRenderSettings.rasterizer.threadCount = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--software-frames") == 0) && (i + 1 < argc))
+		{
+			g_SoftwareRenderSettings.frameCount = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--compare-reference") == 0) && (i + 1 < argc))
+		{
+			g_bSoftwareRender = true;
+			g_SoftwareRenderSettings.referenceFile = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--reference-error") == 0) && (i + 1 < argc))
+		{
+			g_SoftwareRenderSettings.maxError = (float)atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--capture") == 0) && (i + 1 < argc))
+		{
+			g_CaptureFile = argv[++i];
+			if ((i + 1 < argc) && (atoi(argv[i + 1]) > 0))
+			{
+				g_CaptureFrameCount = atoi(argv[++i]);
+			}
+		}
+		else if ((strcmp(argv[i], "--replay") == 0) && (i + 1 < argc))
+		{
+			g_ReplaySettings.captureFile = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--replay-loops") == 0) && (i + 1 < argc))
+		{
+			g_ReplaySettings.loops = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--record-video") == 0) && (i + 1 < argc))
+		{
+			g_FrameCaptureSettings.bRecording = true;
+			g_FrameCaptureSettings.videoOutput = argv[++i];
+			size_t length = g_FrameCaptureSettings.videoOutput.size();
+			if ((length > 4) && (g_FrameCaptureSettings.videoOutput.compare(length - 4, 4, ".y4m") == 0))
+				g_FrameCaptureSettings.format = VIDEO_Y4M;
+			else
+				g_FrameCaptureSettings.format = VIDEO_PNG_SEQUENCE;
+		}
+		else if ((strcmp(argv[i], "--video-fps") == 0) && (i + 1 < argc))
+		{
+			g_VideoFrameRate = atoi(argv[++i]);
+		}
+		else
+		{
+			std::cerr << "Unknown option: " << argv[i] << std::endl;
+			return(false);
+		}
+	}
+
 	return(true);
 }
\ No newline at end of file
@@ -0,0 +1,286 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshcache.cpp
+// ============
+// binary on-disk cache of generated mesh data, memory-mapped on load
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshCache.h"
+#include "FileUtility.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	const char g_CacheMagic[4] = { 'T', 'G', 'M', 'C' };
+	const uint32_t g_CacheVersion = 1;
+}
+
+/***********************************************************
+ *  MappedFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MappedFile::MappedFile()
+{
+	m_pData = NULL;
+	m_size = 0;
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#endif
+}
+
+/***********************************************************
+ *  ~MappedFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method maps a whole file read-only.
+ ***********************************************************/
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+	{
+		return(false);
+	}
+
+	LARGE_INTEGER size;
+	if ((!GetFileSizeEx(m_hFile, &size)) || (size.QuadPart == 0))
+	{
+		Close();
+		return(false);
+	}
+
+	m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping == NULL)
+	{
+		Close();
+		return(false);
+	}
+
+	m_pData = (const unsigned char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_pData == NULL)
+	{
+		Close();
+		return(false);
+	}
+	m_size = (size_t)size.QuadPart;
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return(false);
+	}
+
+	struct stat info;
+	if ((fstat(fd, &info) != 0) || (info.st_size == 0))
+	{
+		close(fd);
+		return(false);
+	}
+
+	void* pData = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file open by itself
+	close(fd);
+	if (pData == MAP_FAILED)
+	{
+		return(false);
+	}
+	m_pData = (const unsigned char*)pData;
+	m_size = (size_t)info.st_size;
+#endif
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method unmaps the file.
+ ***********************************************************/
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_pData != NULL)
+		UnmapViewOfFile(m_pData);
+	if (m_hMapping != NULL)
+		CloseHandle(m_hMapping);
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+	m_hMapping = NULL;
+	m_hFile = INVALID_HANDLE_VALUE;
+#else
+	if (m_pData != NULL)
+		munmap((void*)m_pData, m_size);
+#endif
+	m_pData = NULL;
+	m_size = 0;
+}
+
+/***********************************************************
+ *  MeshCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshCache::MeshCache(const char* directory)
+{
+	m_directory = directory;
+}
+
+/***********************************************************
+ *  CacheFilename()
+ *
+ *  This method returns the cache file path for a set of
+ *  parameters, e.g. "MeshCache/sphere_f009188b583606ef.mesh".
+ ***********************************************************/
+std::string MeshCache::CacheFilename(const MESH_PARAMS& params) const
+{
+	std::ostringstream name;
+	name << m_directory << "/" << MeshGenerator::MeshName(params.mesh) << "_"
+		<< std::hex << std::setw(16) << std::setfill('0') << MeshGenerator::ParamsKey(params)
+		<< ".mesh";
+	return(name.str());
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method maps the cached mesh for the parameters and
+ *  validates it.  Nothing is copied: the view points at the
+ *  vertex and index arrays inside the mapping.
+ ***********************************************************/
+bool MeshCache::Load(const MESH_PARAMS& params, MappedFile& file, MESH_VIEW& view) const
+{
+	std::string filename = CacheFilename(params);
+	if (!file.Open(filename))
+	{
+		return(false);
+	}
+
+	MESH_CACHE_HEADER header;
+	if (file.GetSize() < sizeof(header))
+	{
+		std::cout << "Mesh cache file is truncated:" << filename << std::endl;
+		file.Close();
+		return(false);
+	}
+	memcpy(&header, file.GetData(), sizeof(header));
+
+	size_t vertexBytes = (size_t)header.vertexCount * header.floatsPerVertex * sizeof(float);
+	size_t indexBytes = (size_t)header.indexCount * sizeof(uint32_t);
+	if ((memcmp(header.magic, g_CacheMagic, sizeof(g_CacheMagic)) != 0) ||
+		(header.version != g_CacheVersion) ||
+		(header.paramsKey != MeshGenerator::ParamsKey(params)) ||
+		(header.floatsPerVertex != MESH_FLOATS_PER_VERTEX) ||
+		(file.GetSize() != sizeof(header) + vertexBytes + indexBytes))
+	{
+		std::cout << "Mesh cache file is stale:" << filename << std::endl;
+		file.Close();
+		return(false);
+	}
+
+	const unsigned char* pPayload = file.GetData() + sizeof(header);
+	if (Checksum(CHECKSUM_SEED, pPayload, vertexBytes + indexBytes) != header.checksum)
+	{
+		std::cout << "Mesh cache file is corrupt:" << filename << std::endl;
+		file.Close();
+		return(false);
+	}
+
+	// the header is 32 bytes, so both arrays are 4-byte aligned
+	view.vertices = (const float*)pPayload;
+	view.vertexCount = header.vertexCount;
+	view.indices = (const uint32_t*)(pPayload + vertexBytes);
+	view.indexCount = header.indexCount;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Store()
+ *
+ *  This method writes a generated mesh to the cache.  It is
+ *  written to a temporary file that then replaces the old
+ *  one, so an interrupted write never leaves a file that
+ *  looks valid.
+ ***********************************************************/
+bool MeshCache::Store(const MESH_PARAMS& params, const MESH_DATA& data) const
+{
+	MakeDirectory(m_directory);
+
+	size_t vertexBytes = data.vertices.size() * sizeof(float);
+	size_t indexBytes = data.indices.size() * sizeof(uint32_t);
+
+	MESH_CACHE_HEADER header;
+	memcpy(header.magic, g_CacheMagic, sizeof(g_CacheMagic));
+	header.version = g_CacheVersion;
+	header.paramsKey = MeshGenerator::ParamsKey(params);
+	header.vertexCount = (uint32_t)(data.vertices.size() / MESH_FLOATS_PER_VERTEX);
+	header.indexCount = (uint32_t)data.indices.size();
+	header.floatsPerVertex = MESH_FLOATS_PER_VERTEX;
+	header.checksum = Checksum(CHECKSUM_SEED, data.vertices.data(), vertexBytes);
+	header.checksum = Checksum(header.checksum, data.indices.data(), indexBytes);
+
+	std::string filename = CacheFilename(params);
+	std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream file(tempFilename.c_str(), std::ios::binary);
+		if (!file)
+		{
+			std::cout << "Could not create mesh cache file:" << tempFilename << std::endl;
+			return(false);
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)data.vertices.data(), vertexBytes);
+		file.write((const char*)data.indices.data(), indexBytes);
+		if (!file.good())
+		{
+			std::cout << "Could not write mesh cache file:" << tempFilename << std::endl;
+			return(false);
+		}
+	}
+
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::cout << "Could not replace mesh cache file:" << filename << std::endl;
+		std::remove(tempFilename.c_str());
+		return(false);
+	}
+
+	return(true);
+}
@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshcache.h
+// ============
+// binary on-disk cache of generated mesh data, memory-mapped on load
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshGenerator.h"
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/***********************************************************
+ *  MESH_VIEW
+ *
+ *  Read-only view of mesh data, either inside a mapped cache
+ *  file or in a MESH_DATA.
+ ***********************************************************/
+struct MESH_VIEW
+{
+	const float* vertices;
+	uint32_t vertexCount;
+	const uint32_t* indices;
+	uint32_t indexCount;
+};
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  A whole file mapped read-only into memory.  The pages are
+ *  read by the OS on first touch, straight from the file
+ *  cache, without copying into a heap buffer.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// map a file; false if it does not exist or is empty
+	bool Open(const std::string& filename);
+	// unmap the file
+	void Close();
+
+	const unsigned char* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	// no copies - the mapping has a single owner
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const unsigned char* m_pData;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#endif
+};
+
+/***********************************************************
+ *  MeshCache
+ *
+ *  Stores generated meshes in a directory, one file per set
+ *  of generator parameters.  A cached mesh is used only when
+ *  its header matches the parameter key (which includes the
+ *  generator version) and the checksum of its payload is
+ *  correct; otherwise the caller regenerates and stores it.
+ *
+ *  File layout (little endian):
+ *    MESH_CACHE_HEADER
+ *    float[vertexCount * floatsPerVertex]  vertices
+ *    uint32[indexCount]                    indices
+ ***********************************************************/
+class MeshCache
+{
+public:
+	// constructor
+	MeshCache(const char* directory);
+
+	// map the cached mesh for the parameters; the view points
+	// into the file and stays valid while the file is open
+	bool Load(const MESH_PARAMS& params, MappedFile& file, MESH_VIEW& view) const;
+	// write a generated mesh to the cache
+	bool Store(const MESH_PARAMS& params, const MESH_DATA& data) const;
+
+private:
+	struct MESH_CACHE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t paramsKey;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t floatsPerVertex;
+		// 32-bit FNV-1a of everything after the header
+		uint32_t checksum;
+	};
+
+	// path of the cache file for a set of parameters
+	std::string CacheFilename(const MESH_PARAMS& params) const;
+
+	std::string m_directory;
+};
@@ -0,0 +1,372 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshgenerator.cpp
+// ============
+// generate the vertex and index data of the basic scene meshes
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshGenerator.h"
+#include "FileUtility.h"
+
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	const float g_Pi = 3.14159265358979f;
+}
+
+/***********************************************************
+ *  DefaultParams()
+ *
+ *  This method returns the tessellation used for each mesh
+ *  of the scene.
+ ***********************************************************/
+MESH_PARAMS MeshGenerator::DefaultParams(SCENE_MESH mesh)
+{
+	MESH_PARAMS params;
+	params.mesh = mesh;
+	params.slices = 0;
+	params.stacks = 0;
+	params.majorRadius = 0.0f;
+	params.minorRadius = 0.0f;
+
+	switch (mesh)
+	{
+	case MESH_SPHERE:
+		params.slices = 48;
+		params.stacks = 24;
+		params.majorRadius = 1.0f;
+		break;
+	case MESH_TORUS:
+		params.slices = 64;
+		params.stacks = 24;
+		params.majorRadius = 1.0f;
+		params.minorRadius = 0.1f;
+		break;
+	case MESH_TAPERED_CYLINDER:
+		params.slices = 48;
+		params.stacks = 1;
+		params.majorRadius = 1.0f;
+		params.minorRadius = 0.05f;
+		break;
+	default:
+		break;
+	}
+
+	return(params);
+}
+
+/***********************************************************
+ *  Generate()
+ *
+ *  This method builds the geometry described by the
+ *  parameters.
+ ***********************************************************/
+void MeshGenerator::Generate(const MESH_PARAMS& params, MESH_DATA& data)
+{
+	data.vertices.clear();
+	data.indices.clear();
+
+	switch (params.mesh)
+	{
+	case MESH_PLANE:
+		GeneratePlane(params, data);
+		break;
+	case MESH_BOX:
+		GenerateBox(params, data);
+		break;
+	case MESH_SPHERE:
+		GenerateSphere(params, data);
+		break;
+	case MESH_TORUS:
+		GenerateTorus(params, data);
+		break;
+	case MESH_TAPERED_CYLINDER:
+		GenerateTaperedCylinder(params, data);
+		break;
+	default:
+		break;
+	}
+}
+
+/***********************************************************
+ *  ParamsKey()
+ *
+ *  This method returns a key that changes whenever anything
+ *  the generated geometry depends on changes.  The fields are
+ *  hashed one at a time so struct padding is never included.
+ ***********************************************************/
+uint64_t MeshGenerator::ParamsKey(const MESH_PARAMS& params)
+{
+	uint64_t hash = HASH_SEED;
+	int32_t mesh = (int32_t)params.mesh;
+
+	hash = HashBytes(hash, &MESH_GENERATOR_VERSION, sizeof(MESH_GENERATOR_VERSION));
+	hash = HashBytes(hash, &mesh, sizeof(mesh));
+	hash = HashBytes(hash, &params.slices, sizeof(params.slices));
+	hash = HashBytes(hash, &params.stacks, sizeof(params.stacks));
+	hash = HashBytes(hash, &params.majorRadius, sizeof(params.majorRadius));
+	hash = HashBytes(hash, &params.minorRadius, sizeof(params.minorRadius));
+
+	return(hash);
+}
+
+/***********************************************************
+ *  MeshName()
+ *
+ *  This method returns a short name for a mesh.
+ ***********************************************************/
+const char* MeshGenerator::MeshName(SCENE_MESH mesh)
+{
+	switch (mesh)
+	{
+	case MESH_PLANE:            return("plane");
+	case MESH_BOX:              return("box");
+	case MESH_SPHERE:           return("sphere");
+	case MESH_TORUS:            return("torus");
+	case MESH_TAPERED_CYLINDER: return("taperedcylinder");
+	default:                    return("unknown");
+	}
+}
+
+/***********************************************************
+ *  AddVertex()
+ *
+ *  This method appends one interleaved vertex.
+ ***********************************************************/
+void MeshGenerator::AddVertex(MESH_DATA& data, float x, float y, float z, float nx, float ny, float nz, float u, float v)
+{
+	float vertex[MESH_FLOATS_PER_VERTEX] = { x, y, z, nx, ny, nz, u, v };
+	data.vertices.insert(data.vertices.end(), vertex, vertex + MESH_FLOATS_PER_VERTEX);
+}
+
+/***********************************************************
+ *  AddQuad()
+ *
+ *  This method appends a flat quad spanning center +/- uAxis
+ *  +/- vAxis.  Its normal is uAxis x vAxis, so the two axes
+ *  also set which side faces outwards.
+ ***********************************************************/
+void MeshGenerator::AddQuad(MESH_DATA& data, const float center[3], const float uAxis[3], const float vAxis[3])
+{
+	float normal[3] = {
+		uAxis[1] * vAxis[2] - uAxis[2] * vAxis[1],
+		uAxis[2] * vAxis[0] - uAxis[0] * vAxis[2],
+		uAxis[0] * vAxis[1] - uAxis[1] * vAxis[0] };
+	float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+	for (int i = 0; i < 3; i++)
+	{
+		normal[i] /= length;
+	}
+
+	uint32_t first = (uint32_t)(data.vertices.size() / MESH_FLOATS_PER_VERTEX);
+	const float corners[4][2] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+	for (int i = 0; i < 4; i++)
+	{
+		float s = corners[i][0];
+		float t = corners[i][1];
+		AddVertex(data,
+			center[0] + uAxis[0] * s + vAxis[0] * t,
+			center[1] + uAxis[1] * s + vAxis[1] * t,
+			center[2] + uAxis[2] * s + vAxis[2] * t,
+			normal[0], normal[1], normal[2],
+			(s + 1.0f) * 0.5f, (t + 1.0f) * 0.5f);
+	}
+
+	const uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+	for (int i = 0; i < 6; i++)
+	{
+		data.indices.push_back(first + quad[i]);
+	}
+}
+
+/***********************************************************
+ *  GeneratePlane()
+ *
+ *  This method builds a 2 x 2 square in the XZ plane.
+ ***********************************************************/
+void MeshGenerator::GeneratePlane(const MESH_PARAMS& /*params*/, MESH_DATA& data)
+{
+	const float center[3] = { 0.0f, 0.0f, 0.0f };
+	const float uAxis[3] = { 1.0f, 0.0f, 0.0f };
+	const float vAxis[3] = { 0.0f, 0.0f, -1.0f };
+	AddQuad(data, center, uAxis, vAxis);
+}
+
+/***********************************************************
+ *  GenerateBox()
+ *
+ *  This method builds a unit cube with separate vertices per
+ *  face, so every face has its own normal and texture space.
+ ***********************************************************/
+void MeshGenerator::GenerateBox(const MESH_PARAMS& /*params*/, MESH_DATA& data)
+{
+	// centre, u axis and v axis of each face (u x v = normal)
+	const float faces[6][3][3] = {
+		{ {  0.5f,  0.0f,  0.0f }, {  0.0f, 0.0f, -0.5f }, { 0.0f, 0.5f,  0.0f } },  // +X
+		{ { -0.5f,  0.0f,  0.0f }, {  0.0f, 0.0f,  0.5f }, { 0.0f, 0.5f,  0.0f } },  // -X
+		{ {  0.0f,  0.5f,  0.0f }, {  0.5f, 0.0f,  0.0f }, { 0.0f, 0.0f, -0.5f } },  // +Y
+		{ {  0.0f, -0.5f,  0.0f }, {  0.5f, 0.0f,  0.0f }, { 0.0f, 0.0f,  0.5f } },  // -Y
+		{ {  0.0f,  0.0f,  0.5f }, {  0.5f, 0.0f,  0.0f }, { 0.0f, 0.5f,  0.0f } },  // +Z
+		{ {  0.0f,  0.0f, -0.5f }, { -0.5f, 0.0f,  0.0f }, { 0.0f, 0.5f,  0.0f } }   // -Z
+	};
+
+	for (int i = 0; i < 6; i++)
+	{
+		AddQuad(data, faces[i][0], faces[i][1], faces[i][2]);
+	}
+}
+
+/***********************************************************
+ *  GenerateSphere()
+ *
+ *  This method builds a UV sphere.  Rows run from the north
+ *  pole (v = 1) to the south pole (v = 0); each row repeats
+ *  its first vertex at the end so the texture seam closes.
+ ***********************************************************/
+void MeshGenerator::GenerateSphere(const MESH_PARAMS& params, MESH_DATA& data)
+{
+	int slices = params.slices;
+	int stacks = params.stacks;
+	float radius = params.majorRadius;
+
+	for (int i = 0; i <= stacks; i++)
+	{
+		float phi = g_Pi * i / stacks;
+		float y = std::cos(phi);
+		float ring = std::sin(phi);
+
+		for (int j = 0; j <= slices; j++)
+		{
+			float theta = 2.0f * g_Pi * j / slices;
+			float x = ring * std::sin(theta);
+			float z = ring * std::cos(theta);
+			AddVertex(data, x * radius, y * radius, z * radius, x, y, z,
+				(float)j / slices, 1.0f - (float)i / stacks);
+		}
+	}
+
+	uint32_t rowLength = slices + 1;
+	for (int i = 0; i < stacks; i++)
+	{
+		for (int j = 0; j < slices; j++)
+		{
+			uint32_t a = i * rowLength + j;
+			uint32_t b = (i + 1) * rowLength + j;
+			uint32_t c = b + 1;
+			uint32_t d = a + 1;
+
+			// the triangles touching a pole would be degenerate
+			if (i != 0)
+			{
+				data.indices.push_back(a);
+				data.indices.push_back(b);
+				data.indices.push_back(d);
+			}
+			if (i != stacks - 1)
+			{
+				data.indices.push_back(d);
+				data.indices.push_back(b);
+				data.indices.push_back(c);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  GenerateTorus()
+ *
+ *  This method builds a torus around the Z axis.  Slices go
+ *  around the ring, stacks around the tube.
+ ***********************************************************/
+void MeshGenerator::GenerateTorus(const MESH_PARAMS& params, MESH_DATA& data)
+{
+	int slices = params.slices;
+	int stacks = params.stacks;
+
+	for (int i = 0; i <= slices; i++)
+	{
+		float u = 2.0f * g_Pi * i / slices;
+		float cu = std::cos(u);
+		float su = std::sin(u);
+
+		for (int j = 0; j <= stacks; j++)
+		{
+			float v = 2.0f * g_Pi * j / stacks;
+			float nx = std::cos(v) * cu;
+			float ny = std::cos(v) * su;
+			float nz = std::sin(v);
+			AddVertex(data,
+				params.majorRadius * cu + params.minorRadius * nx,
+				params.majorRadius * su + params.minorRadius * ny,
+				params.minorRadius * nz,
+				nx, ny, nz,
+				(float)i / slices, (float)j / stacks);
+		}
+	}
+
+	uint32_t rowLength = stacks + 1;
+	for (int i = 0; i < slices; i++)
+	{
+		for (int j = 0; j < stacks; j++)
+		{
+			uint32_t a = i * rowLength + j;
+			uint32_t b = (i + 1) * rowLength + j;
+			uint32_t c = b + 1;
+			uint32_t d = a + 1;
+
+			data.indices.push_back(a);
+			data.indices.push_back(b);
+			data.indices.push_back(c);
+			data.indices.push_back(a);
+			data.indices.push_back(c);
+			data.indices.push_back(d);
+		}
+	}
+}
+
+/***********************************************************
+ *  GenerateTaperedCylinder()
+ *
+ *  This method builds the sides of a tapered cylinder; the
+ *  scene never draws the caps of its tree tiers.  The normal
+ *  leans up by the slope of the side.
+ ***********************************************************/
+void MeshGenerator::GenerateTaperedCylinder(const MESH_PARAMS& params, MESH_DATA& data)
+{
+	int slices = params.slices;
+	float bottomRadius = params.majorRadius;
+	float topRadius = params.minorRadius;
+	float slope = bottomRadius - topRadius;
+	float scale = 1.0f / std::sqrt(1.0f + slope * slope);
+
+	for (int i = 0; i <= 1; i++)
+	{
+		float radius = (i == 0) ? bottomRadius : topRadius;
+		for (int j = 0; j <= slices; j++)
+		{
+			float theta = 2.0f * g_Pi * j / slices;
+			float x = std::sin(theta);
+			float z = std::cos(theta);
+			AddVertex(data, x * radius, (float)i, z * radius,
+				x * scale, slope * scale, z * scale,
+				(float)j / slices, (float)i);
+		}
+	}
+
+	uint32_t rowLength = slices + 1;
+	for (int j = 0; j < slices; j++)
+	{
+		uint32_t a = j;
+		uint32_t b = j + 1;
+		uint32_t c = rowLength + j + 1;
+		uint32_t d = rowLength + j;
+
+		data.indices.push_back(a);
+		data.indices.push_back(b);
+		data.indices.push_back(c);
+		data.indices.push_back(a);
+		data.indices.push_back(c);
+		data.indices.push_back(d);
+	}
+}
@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshgenerator.h
+// ============
+// generate the vertex and index data of the basic scene meshes
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// bump whenever the generated geometry or its optimization changes,
+// so cached meshes made by an older generator are rebuilt
+//  2 - triangles and vertices reordered by MeshOptimizer
+const uint32_t MESH_GENERATOR_VERSION = 2;
+
+// position (3) + normal (3) + texture coordinate (2)
+const int MESH_FLOATS_PER_VERTEX = 8;
+
+// basic mesh used to draw a scene object
+enum SCENE_MESH
+{
+	MESH_PLANE,
+	MESH_BOX,
+	MESH_SPHERE,
+	MESH_TORUS,
+	MESH_TAPERED_CYLINDER,
+	MESH_COUNT
+};
+
+/***********************************************************
+ *  MESH_PARAMS
+ *
+ *  Everything the generated geometry depends on.  Unused
+ *  fields of a shape are left at zero.
+ ***********************************************************/
+struct MESH_PARAMS
+{
+	SCENE_MESH mesh;
+	// segments around the shape (sphere, torus ring, cylinder)
+	int slices;
+	// segments from pole to pole / around the torus tube
+	int stacks;
+	// sphere radius, torus ring radius, cylinder bottom radius
+	float majorRadius;
+	// torus tube radius, cylinder top radius
+	float minorRadius;
+};
+
+/***********************************************************
+ *  MESH_DATA
+ *
+ *  Interleaved vertices (MESH_FLOATS_PER_VERTEX floats each)
+ *  and triangle list indices of a generated mesh.
+ ***********************************************************/
+struct MESH_DATA
+{
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+};
+
+/***********************************************************
+ *  MeshGenerator
+ *
+ *  Builds the unit-sized basic shapes drawn by the scene:
+ *
+ *    plane            - 2 x 2 square in the XZ plane, facing +Y
+ *    box              - unit cube centred on the origin
+ *    sphere           - radius 1 around the origin
+ *    torus            - ring of radius 1 in the XY plane
+ *    tapered cylinder - sides of a tree tier from y = 0 to 1,
+ *                       narrowing from radius 1 to the top
+ *
+ *  Front faces are counter-clockwise when seen from outside.
+ ***********************************************************/
+class MeshGenerator
+{
+public:
+	// tessellation used for each mesh of the scene
+	static MESH_PARAMS DefaultParams(SCENE_MESH mesh);
+	// build the geometry described by the parameters
+	static void Generate(const MESH_PARAMS& params, MESH_DATA& data);
+	// 64-bit key of the parameters and generator version
+	static uint64_t ParamsKey(const MESH_PARAMS& params);
+	// short name of a mesh, for file names and messages
+	static const char* MeshName(SCENE_MESH mesh);
+
+private:
+	static void AddVertex(MESH_DATA& data, float x, float y, float z, float nx, float ny, float nz, float u, float v);
+	static void AddQuad(MESH_DATA& data, const float center[3], const float uAxis[3], const float vAxis[3]);
+	static void GeneratePlane(const MESH_PARAMS& params, MESH_DATA& data);
+	static void GenerateBox(const MESH_PARAMS& params, MESH_DATA& data);
+	static void GenerateSphere(const MESH_PARAMS& params, MESH_DATA& data);
+	static void GenerateTorus(const MESH_PARAMS& params, MESH_DATA& data);
+	static void GenerateTaperedCylinder(const MESH_PARAMS& params, MESH_DATA& data);
+};
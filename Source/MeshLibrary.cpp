@@ -0,0 +1,411 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshlibrary.cpp
+// ============
+// load the basic scene meshes into OpenGL buffers and draw them
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshLibrary.h"
+#include "MeshOptimizer.h"
+#include "LightmapCharts.h"
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	// size of the FIFO post-transform cache the ACMR / ATVR
+	// report is simulated with
+	const int g_ReportCacheSize = 16;
+}
+
+/***********************************************************
+ *  MeshLibrary()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshLibrary::MeshLibrary(const char* cacheDirectory)
+	: m_cache(cacheDirectory)
+{
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		m_meshes[i].range.indexCount = 0;
+		m_meshes[i].range.firstIndex = 0;
+		m_meshes[i].range.baseVertex = 0;
+		m_meshes[i].vertexBytes = 0;
+		m_meshes[i].indexBytes = 0;
+		m_meshes[i].positionBytes = 0;
+		m_meshes[i].lightmapBytes = 0;
+		m_pending[i].bLoaded = false;
+	}
+	m_vertexFormat = VERTEX_FORMAT_FULL;
+	m_bPositionStream = false;
+	m_bLightmapStream = false;
+	m_vao = 0;
+	m_vbo = 0;
+	m_ebo = 0;
+	m_positionVao = 0;
+	m_positionVbo = 0;
+	m_lightmapVbo = 0;
+	m_indexType = GL_UNSIGNED_INT;
+}
+
+/***********************************************************
+ *  ~MeshLibrary()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MeshLibrary::~MeshLibrary()
+{
+	DestroyMeshes();
+}
+
+/***********************************************************
+ *  LoadMesh()
+ *
+ *  This method makes a mesh available for the next upload,
+ *  from the mesh cache if possible, and reports how long it
+ *  took.
+ ***********************************************************/
+bool MeshLibrary::LoadMesh(const MESH_PARAMS& params)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool bFromCache = false;
+
+	PENDING_MESH& pending = m_pending[params.mesh];
+	pending.data.vertices.clear();
+	pending.data.indices.clear();
+	pending.bLoaded = false;
+
+	MESH_VIEW& view = pending.view;
+	if (m_cache.Load(params, pending.file, view))
+	{
+		bFromCache = true;
+	}
+	else
+	{
+		MESH_DATA& data = pending.data;
+		MeshGenerator::Generate(params, data);
+		if (data.indices.empty())
+		{
+			std::cout << "Could not generate mesh:" << MeshGenerator::MeshName(params.mesh) << std::endl;
+			return(false);
+		}
+
+		// reorder for the post-transform cache and report the gain
+		uint32_t vertexCount = (uint32_t)(data.vertices.size() / MESH_FLOATS_PER_VERTEX);
+		VERTEX_CACHE_STATISTICS before = MeshOptimizer::AnalyzeVertexCache(data.indices, vertexCount, g_ReportCacheSize);
+		MeshOptimizer::Optimize(data);
+		vertexCount = (uint32_t)(data.vertices.size() / MESH_FLOATS_PER_VERTEX);
+		VERTEX_CACHE_STATISTICS after = MeshOptimizer::AnalyzeVertexCache(data.indices, vertexCount, g_ReportCacheSize);
+		std::cout << "Mesh " << MeshGenerator::MeshName(params.mesh) << " optimized: ACMR "
+			<< before.acmr << " -> " << after.acmr << ", ATVR "
+			<< before.atvr << " -> " << after.atvr << std::endl;
+
+		view.vertices = data.vertices.data();
+		view.vertexCount = vertexCount;
+		view.indices = data.indices.data();
+		view.indexCount = (uint32_t)data.indices.size();
+
+		m_cache.Store(params, data);
+	}
+	pending.bLoaded = true;
+
+	double elapsed = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+	std::cout << "Mesh " << MeshGenerator::MeshName(params.mesh) << ": "
+		<< view.vertexCount << " vertices, " << view.indexCount << " indices, "
+		<< (bFromCache ? "loaded from cache" : "generated") << " in " << elapsed << " ms" << std::endl;
+
+	return(true);
+}
+
+/***********************************************************
+ *  UploadMeshes()
+ *
+ *  This method (re)creates the shared vertex array and
+ *  buffers in the selected vertex format from all loaded
+ *  meshes, placing the meshes one after the other, and then
+ *  releases the loaded data.  The position-only stream, if
+ *  enabled, gets the same positions at the same vertex
+ *  offsets, so the mesh ranges address both streams; so do
+ *  the lightmap chart coordinates, if enabled.
+ ***********************************************************/
+void MeshLibrary::UploadMeshes()
+{
+	// 16-bit indices only if every mesh can address all of its
+	// vertices with them; the base vertex covers the offset
+	bool bShortIndices = (m_vertexFormat == VERTEX_FORMAT_COMPACT);
+	size_t vertexSize = (m_vertexFormat == VERTEX_FORMAT_COMPACT) ?
+		sizeof(COMPACT_VERTEX) : MESH_FLOATS_PER_VERTEX * sizeof(float);
+	size_t totalVertices = 0;
+	size_t totalIndices = 0;
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		if (!m_pending[i].bLoaded)
+			continue;
+		totalVertices += m_pending[i].view.vertexCount;
+		totalIndices += m_pending[i].view.indexCount;
+		if (m_pending[i].view.vertexCount > 65536)
+			bShortIndices = false;
+	}
+	m_indexType = bShortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	size_t indexSize = bShortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+	// the compact position keeps its padding half, so it can be
+	// copied out of the packed vertex unchanged
+	size_t positionSize = (m_vertexFormat == VERTEX_FORMAT_COMPACT) ?
+		sizeof(COMPACT_VERTEX::position) : 3 * sizeof(float);
+
+	if (m_vao == 0)
+	{
+		glGenVertexArrays(1, &m_vao);
+		glGenBuffers(1, &m_vbo);
+		glGenBuffers(1, &m_ebo);
+	}
+	if (m_bPositionStream && (m_positionVao == 0))
+	{
+		glGenVertexArrays(1, &m_positionVao);
+		glGenBuffers(1, &m_positionVbo);
+	}
+	if (m_positionVbo != 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_positionVbo);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(totalVertices * positionSize), NULL, GL_STATIC_DRAW);
+	}
+	std::vector<unsigned char> positions;
+	size_t chartVertexSize = LIGHTMAP_FLOATS_PER_VERTEX * sizeof(float);
+	if (m_bLightmapStream && (m_lightmapVbo == 0))
+	{
+		glGenBuffers(1, &m_lightmapVbo);
+	}
+	if (m_lightmapVbo != 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_lightmapVbo);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(totalVertices * chartVertexSize), NULL, GL_STATIC_DRAW);
+	}
+	std::vector<float> chartVertices;
+
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(totalVertices * vertexSize), NULL, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(totalIndices * indexSize), NULL, GL_STATIC_DRAW);
+
+	uint32_t baseVertex = 0;
+	uint32_t firstIndex = 0;
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		PENDING_MESH& pending = m_pending[i];
+		GL_MESH& glMesh = m_meshes[i];
+		if (!pending.bLoaded)
+		{
+			glMesh.range.indexCount = 0;
+			glMesh.vertexBytes = 0;
+			glMesh.indexBytes = 0;
+			glMesh.positionBytes = 0;
+			glMesh.lightmapBytes = 0;
+			continue;
+		}
+
+		const MESH_VIEW& view = pending.view;
+		glMesh.vertexBytes = view.vertexCount * vertexSize;
+		glMesh.indexBytes = view.indexCount * indexSize;
+		GLintptr vertexOffset = (GLintptr)(baseVertex * vertexSize);
+		GLintptr indexOffset = (GLintptr)(firstIndex * indexSize);
+		glMesh.positionBytes = (m_positionVbo != 0) ? view.vertexCount * positionSize : 0;
+		positions.resize(glMesh.positionBytes);
+
+		if (m_vertexFormat == VERTEX_FORMAT_COMPACT)
+		{
+			std::vector<COMPACT_VERTEX> vertices;
+			PackCompactVertices(view.vertices, view.vertexCount, vertices);
+			glBufferSubData(GL_ARRAY_BUFFER, vertexOffset, (GLsizeiptr)glMesh.vertexBytes, vertices.data());
+			for (size_t v = 0; v < positions.size() / positionSize; v++)
+			{
+				memcpy(&positions[v * positionSize], vertices[v].position, positionSize);
+			}
+		}
+		else
+		{
+			glBufferSubData(GL_ARRAY_BUFFER, vertexOffset, (GLsizeiptr)glMesh.vertexBytes, view.vertices);
+			for (size_t v = 0; v < positions.size() / positionSize; v++)
+			{
+				memcpy(&positions[v * positionSize], view.vertices + v * MESH_FLOATS_PER_VERTEX, positionSize);
+			}
+		}
+		if (!positions.empty())
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, m_positionVbo);
+			glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(baseVertex * positionSize), (GLsizeiptr)positions.size(), positions.data());
+			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		}
+		glMesh.lightmapBytes = 0;
+		if (m_lightmapVbo != 0)
+		{
+			LightmapCharts::Build(view.vertices, view.vertexCount, view.indices, view.indexCount, chartVertices);
+			glMesh.lightmapBytes = chartVertices.size() * sizeof(float);
+			glBindBuffer(GL_ARRAY_BUFFER, m_lightmapVbo);
+			glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(baseVertex * chartVertexSize), (GLsizeiptr)glMesh.lightmapBytes,
+				chartVertices.data());
+			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		}
+
+		if (bShortIndices)
+		{
+			std::vector<uint16_t> indices(view.indices, view.indices + view.indexCount);
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexOffset, (GLsizeiptr)glMesh.indexBytes, indices.data());
+		}
+		else
+		{
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexOffset, (GLsizeiptr)glMesh.indexBytes, view.indices);
+		}
+
+		glMesh.range.indexCount = view.indexCount;
+		glMesh.range.firstIndex = firstIndex;
+		glMesh.range.baseVertex = (int32_t)baseVertex;
+		baseVertex += view.vertexCount;
+		firstIndex += view.indexCount;
+
+		// the data is on the GPU now - drop the mapping or copy
+		pending.file.Close();
+		std::vector<float>().swap(pending.data.vertices);
+		std::vector<uint32_t>().swap(pending.data.indices);
+		pending.bLoaded = false;
+	}
+
+	if (m_vertexFormat == VERTEX_FORMAT_COMPACT)
+	{
+		GLsizei stride = sizeof(COMPACT_VERTEX);
+		glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(COMPACT_VERTEX, position));
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(COMPACT_VERTEX, normal));
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(COMPACT_VERTEX, uv));
+	}
+	else
+	{
+		GLsizei stride = MESH_FLOATS_PER_VERTEX * sizeof(float);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+	}
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	if (m_lightmapVbo != 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_lightmapVbo);
+		glVertexAttribPointer(3, LIGHTMAP_FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, (GLsizei)chartVertexSize, (void*)0);
+		glEnableVertexAttribArray(3);
+	}
+
+	// position-only stream: attribute 0 alone, same indices
+	if (m_positionVao != 0)
+	{
+		glBindVertexArray(m_positionVao);
+		glBindBuffer(GL_ARRAY_BUFFER, m_positionVbo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+		if (m_vertexFormat == VERTEX_FORMAT_COMPACT)
+			glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, (GLsizei)positionSize, (void*)0);
+		else
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (GLsizei)positionSize, (void*)0);
+		glEnableVertexAttribArray(0);
+	}
+
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  PrintMemoryReport()
+ *
+ *  This method prints the size of the vertex and index
+ *  buffers, for comparing the vertex formats.
+ ***********************************************************/
+void MeshLibrary::PrintMemoryReport() const
+{
+	size_t vertexBytes = 0;
+	size_t indexBytes = 0;
+	size_t positionBytes = 0;
+	size_t lightmapBytes = 0;
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		vertexBytes += m_meshes[i].vertexBytes;
+		indexBytes += m_meshes[i].indexBytes;
+		positionBytes += m_meshes[i].positionBytes;
+		lightmapBytes += m_meshes[i].lightmapBytes;
+	}
+
+	std::cout << "Mesh memory (" << ((m_vertexFormat == VERTEX_FORMAT_COMPACT) ? "compact" : "full")
+		<< " vertex format): " << vertexBytes / 1024.0 << " KB vertices, "
+		<< indexBytes / 1024.0 << " KB indices";
+	if (positionBytes > 0)
+	{
+		std::cout << ", " << positionBytes / 1024.0 << " KB position-only stream";
+	}
+	if (lightmapBytes > 0)
+	{
+		std::cout << ", " << lightmapBytes / 1024.0 << " KB lightmap coordinates";
+	}
+	std::cout << std::endl;
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method draws a loaded mesh with the current shader
+ *  settings.
+ ***********************************************************/
+void MeshLibrary::DrawMesh(SCENE_MESH mesh) const
+{
+	const MESH_RANGE& range = m_meshes[mesh].range;
+	if ((m_vao == 0) || (range.indexCount == 0))
+	{
+		return;
+	}
+
+	size_t indexSize = (m_indexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+	glBindVertexArray(m_vao);
+	glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)range.indexCount, m_indexType,
+		(void*)(range.firstIndex * indexSize), range.baseVertex);
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  DestroyMeshes()
+ *
+ *  This method frees the shared OpenGL buffers.
+ ***********************************************************/
+void MeshLibrary::DestroyMeshes()
+{
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		glDeleteBuffers(1, &m_vbo);
+		glDeleteBuffers(1, &m_ebo);
+	}
+	if (m_positionVao != 0)
+	{
+		glDeleteVertexArrays(1, &m_positionVao);
+		glDeleteBuffers(1, &m_positionVbo);
+	}
+	if (m_lightmapVbo != 0)
+	{
+		glDeleteBuffers(1, &m_lightmapVbo);
+	}
+	m_vao = 0;
+	m_vbo = 0;
+	m_ebo = 0;
+	m_positionVao = 0;
+	m_positionVbo = 0;
+	m_lightmapVbo = 0;
+
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		m_meshes[i].range.indexCount = 0;
+		m_meshes[i].vertexBytes = 0;
+		m_meshes[i].indexBytes = 0;
+		m_meshes[i].positionBytes = 0;
+		m_meshes[i].lightmapBytes = 0;
+	}
+}
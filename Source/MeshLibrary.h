@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshlibrary.h
+// ============
+// load the basic scene meshes into OpenGL buffers and draw them
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshGenerator.h"
+#include "MeshCache.h"
+#include "VertexFormat.h"
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  MESH_RANGE
+ *
+ *  Where a mesh lives in the shared buffers, in the form
+ *  glDrawElementsBaseVertex() and indirect draw commands
+ *  take it.
+ ***********************************************************/
+struct MESH_RANGE
+{
+	uint32_t indexCount;
+	// first index of the mesh in the shared index buffer
+	uint32_t firstIndex;
+	// added to every index of the mesh
+	int32_t baseVertex;
+};
+
+/***********************************************************
+ *  MeshLibrary
+ *
+ *  Keeps the basic meshes in one shared vertex buffer and
+ *  one shared index buffer behind a single vertex array, so
+ *  any mix of meshes can be drawn without rebinding - and
+ *  all of them with one multi-draw call.
+ *
+ *  LoadMesh() takes a mesh from the on-disk mesh cache when
+ *  a valid entry exists, keeping the file mapped; otherwise
+ *  it generates and optimizes the mesh and stores it in the
+ *  cache for the next start.  UploadMeshes() then copies all
+ *  loaded meshes into the shared buffers and releases the
+ *  mappings.
+ *
+ *  Vertex attributes match the scene shaders: location 0 is
+ *  the position, 1 the normal and 2 the texture coordinate.
+ *  They are uploaded in the full float layout or, to cut the
+ *  vertex fetch bandwidth, in the compact layout with 16-bit
+ *  indices whenever every mesh's vertex count allows it.
+ *
+ *  Passes that only need the depth of the meshes can ask
+ *  for a second, position-only vertex stream behind its own
+ *  vertex array.  It shares the index buffer and the mesh
+ *  ranges, and holds the positions in the same format as the
+ *  full stream, so both produce bit-identical positions.
+ *
+ *  With a baked lightmap, the vertex array also gets the
+ *  lightmap chart coordinates (LightmapCharts) on location 3,
+ *  from a buffer of their own, computed from the same
+ *  vertices the lightmap was baked from.
+ ***********************************************************/
+class MeshLibrary
+{
+public:
+	// constructor
+	MeshLibrary(const char* cacheDirectory);
+	// destructor
+	~MeshLibrary();
+
+	// choose the vertex layout of the next UploadMeshes() call
+	void SetVertexFormat(VERTEX_FORMAT format) { m_vertexFormat = format; }
+	// also build the position-only stream in the next
+	// UploadMeshes() call
+	void SetPositionStreamEnabled(bool bEnabled) { m_bPositionStream = bEnabled; }
+	// also build the lightmap chart coordinates in the next
+	// UploadMeshes() call
+	void SetLightmapStreamEnabled(bool bEnabled) { m_bLightmapStream = bEnabled; }
+	// make a mesh available for the next UploadMeshes() call
+	bool LoadMesh(const MESH_PARAMS& params);
+	// build the shared buffers from all loaded meshes
+	void UploadMeshes();
+	// print the GPU memory used by the loaded meshes
+	void PrintMemoryReport() const;
+	// draw a loaded mesh
+	void DrawMesh(SCENE_MESH mesh) const;
+	// free the OpenGL buffers of all meshes
+	void DestroyMeshes();
+
+	// shared vertex array, index type and mesh ranges for
+	// callers that issue their own (indirect) draws
+	GLuint GetVertexArray() const { return m_vao; }
+	// vertex array of the position-only stream (0 = not built)
+	GLuint GetPositionVertexArray() const { return m_positionVao; }
+	GLenum GetIndexType() const { return m_indexType; }
+	const MESH_RANGE& GetMeshRange(SCENE_MESH mesh) const { return m_meshes[mesh].range; }
+
+private:
+	struct GL_MESH
+	{
+		MESH_RANGE range;
+		// size of the mesh in the shared buffers in bytes
+		size_t vertexBytes;
+		size_t indexBytes;
+		size_t positionBytes;
+		size_t lightmapBytes;
+	};
+
+	// loaded mesh data waiting for UploadMeshes(), pointing
+	// either into a mapped cache file or the generated data
+	struct PENDING_MESH
+	{
+		MappedFile file;
+		MESH_DATA data;
+		MESH_VIEW view;
+		bool bLoaded;
+	};
+
+	MeshCache m_cache;
+	GL_MESH m_meshes[MESH_COUNT];
+	PENDING_MESH m_pending[MESH_COUNT];
+	VERTEX_FORMAT m_vertexFormat;
+	bool m_bPositionStream;
+	bool m_bLightmapStream;
+
+	GLuint m_vao;
+	GLuint m_vbo;
+	GLuint m_ebo;
+	// position-only stream, sharing m_ebo
+	GLuint m_positionVao;
+	GLuint m_positionVbo;
+	// lightmap chart coordinates on attribute 3 of m_vao
+	GLuint m_lightmapVbo;
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	GLenum m_indexType;
+};
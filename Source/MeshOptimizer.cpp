@@ -0,0 +1,488 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.cpp
+// ============
+// reorder the triangles and vertices of generated meshes for the GPU's
+// post-transform vertex cache, for less overdraw and for fetch locality
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshOptimizer.h"
+
+#include <cmath>
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// size of the LRU cache modelled by the Forsyth scores
+	const int g_ForsythCacheSize = 32;
+	// score weights from Forsyth's "Linear-Speed Vertex Cache
+	// Optimisation"
+	const float g_CacheDecayPower = 1.5f;
+	const float g_LastTriangleScore = 0.75f;
+	const float g_ValenceBoostScale = 2.0f;
+	const float g_ValenceBoostPower = 0.5f;
+
+	// FIFO cache size used to find cluster boundaries; small
+	// enough to be conservative for any current GPU
+	const int g_ClusterCacheSize = 16;
+	// clusters may be split where their running ACMR is within
+	// this factor of the whole cluster's ACMR
+	const float g_OverdrawThreshold = 1.05f;
+
+	/***********************************************************
+	 *  VertexScore()
+	 *
+	 *  Forsyth score of a vertex from its position in the
+	 *  simulated cache (-1 = not in it) and the number of its
+	 *  triangles not yet emitted.
+	 ***********************************************************/
+	float VertexScore(int cachePosition, uint32_t remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+		{
+			return(-1.0f);
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				// the vertices of the last triangle get a fixed score
+				// so the next triangle does not just reuse its edge
+				score = g_LastTriangleScore;
+			}
+			else
+			{
+				float scale = 1.0f / (g_ForsythCacheSize - 3);
+				score = std::pow(1.0f - (cachePosition - 3) * scale, g_CacheDecayPower);
+			}
+		}
+
+		// favour vertices with few triangles left, to finish them
+		score += g_ValenceBoostScale * std::pow((float)remainingTriangles, -g_ValenceBoostPower);
+
+		return(score);
+	}
+
+	/***********************************************************
+	 *  CountCacheMisses()
+	 *
+	 *  Number of FIFO cache misses of each triangle in a range
+	 *  of a triangle list, starting with an empty cache.
+	 ***********************************************************/
+	void CountCacheMisses(const std::vector<uint32_t>& indices, size_t firstTriangle, size_t lastTriangle,
+		std::vector<unsigned int>& timestamps, unsigned int& time, std::vector<int>& misses)
+	{
+		// advancing the clock past the cache size empties the cache
+		time += g_ClusterCacheSize + 1;
+
+		for (size_t t = firstTriangle; t < lastTriangle; t++)
+		{
+			int triangleMisses = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t v = indices[t * 3 + k];
+				if (time - timestamps[v] > (unsigned int)g_ClusterCacheSize)
+				{
+					timestamps[v] = time++;
+					triangleMisses++;
+				}
+			}
+			misses[t] = triangleMisses;
+		}
+	}
+}
+
+/***********************************************************
+ *  Optimize()
+ *
+ *  This method runs the vertex cache, overdraw and vertex
+ *  fetch passes on a mesh.
+ ***********************************************************/
+void MeshOptimizer::Optimize(MESH_DATA& data)
+{
+	uint32_t vertexCount = (uint32_t)(data.vertices.size() / MESH_FLOATS_PER_VERTEX);
+
+	OptimizeVertexCache(data.indices, vertexCount);
+
+	// keep the overdraw order only if it costs no more vertex
+	// cache efficiency than the threshold allows; meshes that
+	// are one long strip (the cylinder sides) lose more than
+	// they gain from being cut into clusters
+	std::vector<uint32_t> indices = data.indices;
+	OptimizeOverdraw(indices, data.vertices, g_OverdrawThreshold);
+	float cacheACMR = AnalyzeVertexCache(data.indices, vertexCount, g_ClusterCacheSize).acmr;
+	float overdrawACMR = AnalyzeVertexCache(indices, vertexCount, g_ClusterCacheSize).acmr;
+	if (overdrawACMR <= cacheACMR * g_OverdrawThreshold)
+	{
+		data.indices.swap(indices);
+	}
+
+	OptimizeVertexFetch(data);
+}
+
+/***********************************************************
+ *  OptimizeVertexCache()
+ *
+ *  This method reorders triangles with Forsyth's algorithm.
+ *  Each step emits the highest scoring triangle, moves its
+ *  vertices to the front of a simulated LRU cache and then
+ *  rescores only the triangles of the vertices whose cache
+ *  position changed, which keeps the pass linear.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// triangles of each vertex, packed into one array
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		remaining[indices[i]]++;
+	}
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t * 3 + k];
+			adjacency[fill[v]++] = (uint32_t)t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		vertexScore[v] = VertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> bEmitted(triangleCount, false);
+	size_t bestTriangle = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		if (triangleScore[t] > triangleScore[bestTriangle])
+			bestTriangle = t;
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	size_t scanCursor = 0;
+
+	for (size_t emitted = 0; emitted < triangleCount; emitted++)
+	{
+		// nothing in the cache has triangles left - take the
+		// next unused triangle in the original order
+		if (bestTriangle == (size_t)-1)
+		{
+			while (bEmitted[scanCursor])
+				scanCursor++;
+			bestTriangle = scanCursor;
+		}
+
+		size_t t = bestTriangle;
+		bEmitted[t] = true;
+
+		// emit the triangle and remove it from its vertices' lists
+		newCache.clear();
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t * 3 + k];
+			output.push_back(v);
+			newCache.push_back(v);
+
+			uint32_t* pBegin = &adjacency[offsets[v]];
+			uint32_t* pEnd = pBegin + remaining[v];
+			uint32_t* pFound = std::find(pBegin, pEnd, (uint32_t)t);
+			std::swap(*pFound, *(pEnd - 1));
+			remaining[v]--;
+		}
+
+		// the triangle's vertices move to the front of the cache
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			uint32_t v = cache[i];
+			if ((v != newCache[0]) && (v != newCache[1]) && (v != newCache[2]))
+				newCache.push_back(v);
+		}
+		for (size_t i = g_ForsythCacheSize; i < newCache.size(); i++)
+		{
+			cachePosition[newCache[i]] = -1;
+			vertexScore[newCache[i]] = VertexScore(-1, remaining[newCache[i]]);
+		}
+		for (size_t i = 0; (i < newCache.size()) && (i < (size_t)g_ForsythCacheSize); i++)
+		{
+			cachePosition[newCache[i]] = (int)i;
+			vertexScore[newCache[i]] = VertexScore((int)i, remaining[newCache[i]]);
+		}
+
+		// rescore the affected triangles and pick the best one
+		bestTriangle = (size_t)-1;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			uint32_t v = newCache[i];
+			for (uint32_t a = 0; a < remaining[v]; a++)
+			{
+				uint32_t candidate = adjacency[offsets[v] + a];
+				float score = vertexScore[indices[candidate * 3]] +
+					vertexScore[indices[candidate * 3 + 1]] +
+					vertexScore[indices[candidate * 3 + 2]];
+				triangleScore[candidate] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = candidate;
+				}
+			}
+		}
+
+		if (newCache.size() > (size_t)g_ForsythCacheSize)
+			newCache.resize(g_ForsythCacheSize);
+		cache.swap(newCache);
+	}
+
+	indices.swap(output);
+}
+
+/***********************************************************
+ *  OptimizeOverdraw()
+ *
+ *  This method reorders clusters of triangles to reduce
+ *  overdraw while keeping most of the vertex cache order
+ *  (after Sander et al., "Fast Triangle Reordering for Vertex
+ *  Locality and Reduced Overdraw").
+ *
+ *  The cache-ordered list is cut where a triangle misses the
+ *  cache with all three vertices (the optimizer started a new
+ *  run there), and long clusters are cut again where their
+ *  running ACMR is within the threshold of the cluster's, so
+ *  the cuts cost little cache efficiency.  Clusters are then
+ *  drawn in order of how much they face away from the mesh
+ *  centroid, which draws the outer surfaces first.
+ ***********************************************************/
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<float>& vertices, float threshold)
+{
+	size_t triangleCount = indices.size() / 3;
+	uint32_t vertexCount = (uint32_t)(vertices.size() / MESH_FLOATS_PER_VERTEX);
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = 0;
+	std::vector<int> misses(triangleCount, 0);
+
+	// hard boundaries: triangles that miss with every vertex
+	CountCacheMisses(indices, 0, triangleCount, timestamps, time, misses);
+	std::vector<size_t> hardBoundaries;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if ((t == 0) || (misses[t] == 3))
+			hardBoundaries.push_back(t);
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// soft boundaries inside each hard cluster
+	std::vector<size_t> clusters;
+	for (size_t c = 0; c + 1 < hardBoundaries.size(); c++)
+	{
+		size_t first = hardBoundaries[c];
+		size_t last = hardBoundaries[c + 1];
+
+		int clusterMisses = 0;
+		for (size_t t = first; t < last; t++)
+			clusterMisses += misses[t];
+		float clusterACMR = (float)clusterMisses / (last - first);
+
+		clusters.push_back(first);
+		CountCacheMisses(indices, first, last, timestamps, time, misses);
+
+		int runningMisses = 0;
+		size_t start = first;
+		for (size_t t = first; t < last; t++)
+		{
+			runningMisses += misses[t];
+			float runningACMR = (float)runningMisses / (t - start + 1);
+			if ((t + 1 < last) && (runningACMR <= clusterACMR * threshold))
+			{
+				clusters.push_back(t + 1);
+				start = t + 1;
+				runningMisses = 0;
+				// the next cluster starts with a cold cache
+				CountCacheMisses(indices, t + 1, last, timestamps, time, misses);
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// area-weighted centroid of the whole mesh
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	std::vector<float> triangleData(triangleCount * 7);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const float* a = &vertices[indices[t * 3] * MESH_FLOATS_PER_VERTEX];
+		const float* b = &vertices[indices[t * 3 + 1] * MESH_FLOATS_PER_VERTEX];
+		const float* c = &vertices[indices[t * 3 + 2] * MESH_FLOATS_PER_VERTEX];
+
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		// the cross product is the normal scaled by twice the area
+		float n[3] = {
+			e1[1] * e2[2] - e1[2] * e2[1],
+			e1[2] * e2[0] - e1[0] * e2[2],
+			e1[0] * e2[1] - e1[1] * e2[0] };
+		float area = 0.5f * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+		float* d = &triangleData[t * 7];
+		for (int k = 0; k < 3; k++)
+		{
+			d[k] = (a[k] + b[k] + c[k]) / 3.0f;
+			d[3 + k] = n[k];
+			meshCentroid[k] += d[k] * area;
+		}
+		d[6] = area;
+		meshArea += area;
+	}
+	if (meshArea > 0.0f)
+	{
+		for (int k = 0; k < 3; k++)
+			meshCentroid[k] /= meshArea;
+	}
+
+	// sort key of each cluster: how far its surface faces
+	// away from the mesh centroid
+	size_t clusterCount = clusters.size() - 1;
+	std::vector<float> sortKeys(clusterCount);
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float centroid[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const float* d = &triangleData[t * 7];
+			for (int k = 0; k < 3; k++)
+			{
+				centroid[k] += d[k] * d[6];
+				normal[k] += d[3 + k];
+			}
+			area += d[6];
+		}
+
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float key = 0.0f;
+		if ((area > 0.0f) && (length > 0.0f))
+		{
+			for (int k = 0; k < 3; k++)
+				key += (centroid[k] / area - meshCentroid[k]) * normal[k] / length;
+		}
+		sortKeys[c] = key;
+		order[c] = c;
+	}
+
+	std::stable_sort(order.begin(), order.end(),
+		[&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (size_t i = 0; i < clusterCount; i++)
+	{
+		size_t c = order[i];
+		output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	}
+
+	indices.swap(output);
+}
+
+/***********************************************************
+ *  OptimizeVertexFetch()
+ *
+ *  This method renumbers the vertices in the order the index
+ *  buffer first uses them, so the vertex fetch reads memory
+ *  mostly sequentially.  Unused vertices are dropped.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexFetch(MESH_DATA& data)
+{
+	uint32_t vertexCount = (uint32_t)(data.vertices.size() / MESH_FLOATS_PER_VERTEX);
+	const uint32_t unused = 0xffffffffu;
+
+	std::vector<uint32_t> remap(vertexCount, unused);
+	std::vector<float> vertices;
+	vertices.reserve(data.vertices.size());
+	uint32_t next = 0;
+
+	for (size_t i = 0; i < data.indices.size(); i++)
+	{
+		uint32_t v = data.indices[i];
+		if (remap[v] == unused)
+		{
+			remap[v] = next++;
+			vertices.insert(vertices.end(),
+				data.vertices.begin() + v * MESH_FLOATS_PER_VERTEX,
+				data.vertices.begin() + (v + 1) * MESH_FLOATS_PER_VERTEX);
+		}
+		data.indices[i] = remap[v];
+	}
+
+	data.vertices.swap(vertices);
+}
+
+/***********************************************************
+ *  AnalyzeVertexCache()
+ *
+ *  This method runs an index buffer through a simulated FIFO
+ *  post-transform cache and returns the ACMR and ATVR.
+ ***********************************************************/
+VERTEX_CACHE_STATISTICS MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, int cacheSize)
+{
+	VERTEX_CACHE_STATISTICS statistics;
+	statistics.acmr = 0.0f;
+	statistics.atvr = 0.0f;
+
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	std::vector<bool> bUsed(vertexCount, false);
+	unsigned int time = cacheSize + 1;
+	size_t misses = 0;
+	size_t usedVertices = 0;
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		uint32_t v = indices[i];
+		if (time - timestamps[v] > (unsigned int)cacheSize)
+		{
+			timestamps[v] = time++;
+			misses++;
+		}
+		if (!bUsed[v])
+		{
+			bUsed[v] = true;
+			usedVertices++;
+		}
+	}
+
+	if (indices.size() >= 3)
+		statistics.acmr = (float)misses / (indices.size() / 3);
+	if (usedVertices > 0)
+		statistics.atvr = (float)misses / usedVertices;
+
+	return(statistics);
+}
@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.h
+// ============
+// reorder the triangles and vertices of generated meshes for the GPU's
+// post-transform vertex cache, for less overdraw and for fetch locality
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshGenerator.h"
+
+#include <vector>
+#include <cstdint>
+
+/***********************************************************
+ *  VERTEX_CACHE_STATISTICS
+ *
+ *  Result of running an index buffer through a simulated
+ *  FIFO post-transform cache.
+ ***********************************************************/
+struct VERTEX_CACHE_STATISTICS
+{
+	// average cache misses per triangle (0.5 is ideal for a
+	// large regular grid, 3.0 is no reuse at all)
+	float acmr;
+	// average transforms per vertex (1.0 is ideal)
+	float atvr;
+};
+
+/***********************************************************
+ *  MeshOptimizer
+ *
+ *  Optimize() runs three passes over a triangle list:
+ *
+ *  1. vertex cache - Forsyth's greedy ordering, which picks
+ *     the next triangle by a score favouring vertices that
+ *     are recently used and have few triangles left
+ *  2. overdraw - the cache-ordered list is cut into clusters
+ *     where the cache restarts, and the clusters are sorted
+ *     so those facing away from the mesh centre (the outer,
+ *     likely visible ones) are drawn first; the new order is
+ *     dropped if it costs too much vertex cache efficiency
+ *  3. vertex fetch - vertices are renumbered in the order the
+ *     index buffer first uses them
+ *
+ *  None of the passes changes the triangles themselves.
+ ***********************************************************/
+class MeshOptimizer
+{
+public:
+	// run all passes on a mesh
+	static void Optimize(MESH_DATA& data);
+
+	// reorder triangles for the post-transform vertex cache
+	static void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+	// reorder clusters of triangles to reduce overdraw
+	static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<float>& vertices, float threshold);
+	// renumber vertices in the order of first use
+	static void OptimizeVertexFetch(MESH_DATA& data);
+
+	// simulate a FIFO post-transform cache of the given size
+	static VERTEX_CACHE_STATISTICS AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, int cacheSize);
+};
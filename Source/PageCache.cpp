@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+// pagecache.cpp
+// ============
+// least recently used assignment of pages (virtual texture pages,
+// terrain height tiles) to a fixed number of cache slots
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PageCache.h"
+
+/***********************************************************
+ *  PageCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+PageCache::PageCache()
+{
+	m_leastRecent = -1;
+	m_mostRecent = -1;
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method empties the cache.  All slots start free, in
+ *  slot order.
+ ***********************************************************/
+void PageCache::Reset(uint32_t slotCount, uint32_t pageCount)
+{
+	m_pageSlots.assign(pageCount, -1);
+	m_slotPages.assign(slotCount, INVALID_PAGE);
+	m_previous.assign(slotCount, -1);
+	m_next.assign(slotCount, -1);
+	m_pinned.assign(slotCount, false);
+	m_leastRecent = -1;
+	m_mostRecent = -1;
+	for (uint32_t slot = 0; slot < slotCount; slot++)
+	{
+		Append((int)slot);
+	}
+}
+
+/***********************************************************
+ *  Touch()
+ *
+ *  This method moves a slot to the most recently used end
+ *  of the list.
+ ***********************************************************/
+void PageCache::Touch(int slot)
+{
+	if (m_pinned[slot] || (slot == m_mostRecent))
+	{
+		return;
+	}
+	Unlink(slot);
+	Append(slot);
+}
+
+/***********************************************************
+ *  GetLeastRecentPage()
+ *
+ *  This method returns the page that the next Allocate()
+ *  would evict, so the caller can refuse to evict a page it
+ *  still needs.
+ ***********************************************************/
+uint32_t PageCache::GetLeastRecentPage() const
+{
+	if (m_leastRecent < 0)
+	{
+		return(INVALID_PAGE);
+	}
+	return(m_slotPages[m_leastRecent]);
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method evicts the least recently used page and
+ *  gives its slot to a new page as the most recently used.
+ ***********************************************************/
+int PageCache::Allocate(uint32_t page, uint32_t& evictedPage)
+{
+	evictedPage = INVALID_PAGE;
+	int slot = m_leastRecent;
+	if (slot < 0)
+	{
+		return(-1);
+	}
+
+	evictedPage = m_slotPages[slot];
+	if (evictedPage != INVALID_PAGE)
+	{
+		m_pageSlots[evictedPage] = -1;
+	}
+	m_slotPages[slot] = page;
+	m_pageSlots[page] = slot;
+
+	Unlink(slot);
+	Append(slot);
+	return(slot);
+}
+
+/***********************************************************
+ *  Pin()
+ *
+ *  This method takes a slot out of the usage list, so its
+ *  page is never evicted.
+ ***********************************************************/
+void PageCache::Pin(int slot)
+{
+	if (m_pinned[slot])
+	{
+		return;
+	}
+	Unlink(slot);
+	m_pinned[slot] = true;
+}
+
+/***********************************************************
+ *  Unlink()
+ *
+ *  This method removes a slot from the usage list.
+ ***********************************************************/
+void PageCache::Unlink(int slot)
+{
+	int previous = m_previous[slot];
+	int next = m_next[slot];
+	if (previous >= 0)
+		m_next[previous] = next;
+	else
+		m_leastRecent = next;
+	if (next >= 0)
+		m_previous[next] = previous;
+	else
+		m_mostRecent = previous;
+	m_previous[slot] = -1;
+	m_next[slot] = -1;
+}
+
+/***********************************************************
+ *  Append()
+ *
+ *  This method links a slot in as the most recently used.
+ ***********************************************************/
+void PageCache::Append(int slot)
+{
+	m_previous[slot] = m_mostRecent;
+	m_next[slot] = -1;
+	if (m_mostRecent >= 0)
+		m_next[m_mostRecent] = slot;
+	else
+		m_leastRecent = slot;
+	m_mostRecent = slot;
+}
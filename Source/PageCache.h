@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+// pagecache.h
+// ============
+// least recently used assignment of pages (virtual texture pages,
+// terrain height tiles) to a fixed number of cache slots
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// page index of no page
+const uint32_t INVALID_PAGE = 0xFFFFFFFFu;
+
+/***********************************************************
+ *  PageCache
+ *
+ *  Book-keeping of a cache with a fixed number of slots that
+ *  each hold one page - the storage itself belongs to the
+ *  owner (CPU memory for the page streamer, a region of the
+ *  physical texture for the virtual texture, a layer of the
+ *  height tile array for the terrain).
+ *
+ *  The unpinned slots form a list from least to most
+ *  recently used; Touch() moves a slot to the end and a new
+ *  page takes the slot at the front.  Pages are looked up in
+ *  an array indexed by page, so every operation is O(1) and
+ *  nothing is allocated after Reset().
+ ***********************************************************/
+class PageCache
+{
+public:
+	// constructor
+	PageCache();
+
+	// empty the cache and size it for a number of slots and pages
+	void Reset(uint32_t slotCount, uint32_t pageCount);
+
+	// slot holding a page, -1 if it is not cached
+	int Find(uint32_t page) const { return m_pageSlots[page]; }
+	// page held by a slot (INVALID_PAGE if none)
+	uint32_t GetSlotPage(int slot) const { return m_slotPages[slot]; }
+	uint32_t GetSlotCount() const { return (uint32_t)m_slotPages.size(); }
+
+	// mark a slot as the most recently used
+	void Touch(int slot);
+	// page in the slot Allocate() would take next (INVALID_PAGE
+	// if that slot is free)
+	uint32_t GetLeastRecentPage() const;
+	// give the least recently used slot to a page; evictedPage is
+	// the page the slot held.  -1 if every slot is pinned
+	int Allocate(uint32_t page, uint32_t& evictedPage);
+	// keep a slot's page cached for good
+	void Pin(int slot);
+
+private:
+	// unlink a slot from the list / link it in at the end
+	void Unlink(int slot);
+	void Append(int slot);
+
+	// slot of each page (-1 = not cached)
+	std::vector<int32_t> m_pageSlots;
+	// page of each slot
+	std::vector<uint32_t> m_slotPages;
+	// neighbours of each slot in the usage list (-1 = none)
+	std::vector<int32_t> m_previous;
+	std::vector<int32_t> m_next;
+	std::vector<bool> m_pinned;
+	// least and most recently used slots
+	int m_leastRecent;
+	int m_mostRecent;
+};
@@ -0,0 +1,226 @@
+///////////////////////////////////////////////////////////////////////////////
+// pagestreamer.cpp
+// ============
+// load virtual texture pages from disk on a background thread into a
+// CPU page cache
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PageStreamer.h"
+
+#include <iostream>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	// pages that can wait in the request queue
+	const size_t g_RequestQueueSize = 512;
+}
+
+/***********************************************************
+ *  PageStreamer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+PageStreamer::PageStreamer()
+{
+	m_firstRequest = 0;
+	m_requestCount = 0;
+	m_bLoading = false;
+	m_bStopping = false;
+}
+
+/***********************************************************
+ *  ~PageStreamer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+PageStreamer::~PageStreamer()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method opens the virtual texture file, allocates a
+ *  cache of as many whole pages as fit in cacheBytes and
+ *  starts the loader thread.
+ ***********************************************************/
+bool PageStreamer::Start(const std::string& filename, size_t cacheBytes)
+{
+	Stop();
+	if (!m_file.Open(filename))
+	{
+		return(false);
+	}
+
+	const VIRTUAL_TEXTURE_INFO& info = m_file.GetInfo();
+	uint32_t slotCount = (uint32_t)(cacheBytes / info.PageBytes());
+	if (slotCount == 0)
+	{
+		std::cout << "Virtual texture: no page fits the " << cacheBytes << " byte CPU cache" << std::endl;
+		m_file.Close();
+		return(false);
+	}
+
+	m_cache.Reset(slotCount, m_file.GetPageCount());
+	m_cachePixels.resize((size_t)slotCount * info.PageBytes());
+	m_pageStates.assign(m_file.GetPageCount(), PAGE_IDLE);
+	m_requests.resize(g_RequestQueueSize);
+	m_firstRequest = 0;
+	m_requestCount = 0;
+	m_bLoading = false;
+	m_bStopping = false;
+	m_thread = std::thread(&PageStreamer::Run, this);
+	return(true);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method stops the loader thread once the page it is
+ *  copying is done, and closes the file.
+ ***********************************************************/
+void PageStreamer::Stop()
+{
+	if (m_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bStopping = true;
+		}
+		m_wake.notify_one();
+		m_thread.join();
+	}
+	m_file.Close();
+}
+
+/***********************************************************
+ *  ClearRequests()
+ *
+ *  This method empties the request queue.  A page that is
+ *  already being loaded finishes.
+ ***********************************************************/
+void PageStreamer::ClearRequests()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_requestCount; i++)
+	{
+		uint32_t page = m_requests[(m_firstRequest + i) % m_requests.size()];
+		m_pageStates[page] = PAGE_IDLE;
+	}
+	m_firstRequest = 0;
+	m_requestCount = 0;
+}
+
+/***********************************************************
+ *  Request()
+ *
+ *  This method queues a page for loading unless it is
+ *  cached, queued or loading already.
+ ***********************************************************/
+bool PageStreamer::Request(uint32_t page)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_pageStates[page] != PAGE_IDLE)
+		{
+			return(true);
+		}
+		if (m_requestCount == m_requests.size())
+		{
+			return(false);
+		}
+		m_requests[(m_firstRequest + m_requestCount) % m_requests.size()] = page;
+		m_requestCount++;
+		m_pageStates[page] = PAGE_QUEUED;
+	}
+	m_wake.notify_one();
+	return(true);
+}
+
+/***********************************************************
+ *  CopyPage()
+ *
+ *  This method copies a cached page and marks it as
+ *  recently used.
+ ***********************************************************/
+bool PageStreamer::CopyPage(uint32_t page, unsigned char* pixels)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_pageStates[page] != PAGE_CACHED)
+	{
+		return(false);
+	}
+
+	int slot = m_cache.Find(page);
+	m_cache.Touch(slot);
+	size_t pageBytes = m_file.GetInfo().PageBytes();
+	memcpy(pixels, &m_cachePixels[(size_t)slot * pageBytes], pageBytes);
+	return(true);
+}
+
+/***********************************************************
+ *  IsBusy()
+ *
+ *  This method tells whether pages are still on their way.
+ ***********************************************************/
+bool PageStreamer::IsBusy()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return((m_requestCount > 0) || m_bLoading);
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is the body of the loader thread.  It takes
+ *  the oldest request, evicts the least recently used page
+ *  of the cache for it and copies the page in with the lock
+ *  released, so the render thread is never held up by the
+ *  disk.  The slot being filled cannot be read meanwhile:
+ *  its old page is already gone and the new one is not
+ *  cached yet.
+ ***********************************************************/
+void PageStreamer::Run()
+{
+	size_t pageBytes = m_file.GetInfo().PageBytes();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		while (!m_bStopping && (m_requestCount == 0))
+		{
+			m_wake.wait(lock);
+		}
+		if (m_bStopping)
+		{
+			break;
+		}
+
+		uint32_t page = m_requests[m_firstRequest];
+		m_firstRequest = (m_firstRequest + 1) % m_requests.size();
+		m_requestCount--;
+
+		uint32_t evictedPage = INVALID_PAGE;
+		int slot = m_cache.Allocate(page, evictedPage);
+		if (evictedPage != INVALID_PAGE)
+		{
+			m_pageStates[evictedPage] = PAGE_IDLE;
+		}
+		if (slot < 0)
+		{
+			m_pageStates[page] = PAGE_IDLE;
+			continue;
+		}
+		m_pageStates[page] = PAGE_LOADING;
+		m_bLoading = true;
+
+		lock.unlock();
+		memcpy(&m_cachePixels[(size_t)slot * pageBytes], m_file.GetPagePixels(page), pageBytes);
+		lock.lock();
+
+		m_pageStates[page] = PAGE_CACHED;
+		m_bLoading = false;
+	}
+}
@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////////
+// pagestreamer.h
+// ============
+// load virtual texture pages from disk on a background thread into a
+// CPU page cache
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "VirtualTextureFile.h"
+#include "PageCache.h"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+/***********************************************************
+ *  PageStreamer
+ *
+ *  Owns the virtual texture file and a CPU cache of its
+ *  pages with a fixed memory size.  The render thread asks
+ *  for pages with Request(); a loader thread copies them
+ *  from the mapped file - where the actual disk reads happen
+ *  - into the least recently used cache slot, and the render
+ *  thread picks them up with CopyPage() once they are there.
+ *
+ *  The request queue has a fixed size and is meant to be
+ *  refilled every frame after ClearRequests(), so pages that
+ *  are no longer visible never wait in front of the ones
+ *  that are.
+ ***********************************************************/
+class PageStreamer
+{
+public:
+	// constructor
+	PageStreamer();
+	// destructor
+	~PageStreamer();
+
+	// open the file, size the cache and start the loader thread
+	bool Start(const std::string& filename, size_t cacheBytes);
+	// stop the loader thread and close the file
+	void Stop();
+
+	const VirtualTextureFile& GetFile() const { return m_file; }
+	// pages the CPU cache can hold
+	uint32_t GetCacheSlotCount() const { return m_cache.GetSlotCount(); }
+
+	// drop the requests that have not started loading
+	void ClearRequests();
+	// queue a page that is not cached; false if the queue is full
+	bool Request(uint32_t page);
+	// copy a cached page; false if it is not in the cache yet
+	bool CopyPage(uint32_t page, unsigned char* pixels);
+	// true while requests are queued or loading
+	bool IsBusy();
+
+private:
+	// state of a page in the streamer
+	enum PAGE_STATE
+	{
+		PAGE_IDLE,
+		PAGE_QUEUED,
+		PAGE_LOADING,
+		PAGE_CACHED
+	};
+
+	// body of the loader thread
+	void Run();
+
+	VirtualTextureFile m_file;
+
+	// guards everything below
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	// CPU cache: slot book-keeping and the pixels of all slots
+	PageCache m_cache;
+	std::vector<unsigned char> m_cachePixels;
+	// PAGE_STATE of every page
+	std::vector<unsigned char> m_pageStates;
+	// ring of queued pages
+	std::vector<uint32_t> m_requests;
+	size_t m_firstRequest;
+	size_t m_requestCount;
+	// a page is being copied by the loader
+	bool m_bLoading;
+	bool m_bStopping;
+
+	std::thread m_thread;
+};
@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderbackend.h
+// ============
+// interface of the object-by-object drawing of the scene, so it can be
+// done with OpenGL or on the CPU
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshGenerator.h"
+#include "SceneSnapshot.h"
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  RENDER_LIGHT
+ *
+ *  A scene light source.  For directional lights the
+ *  position is the direction the light shines in.
+ ***********************************************************/
+struct RENDER_LIGHT
+{
+	glm::vec3 position;
+	glm::vec3 ambientColor;
+	glm::vec3 diffuseColor;
+	glm::vec3 specularColor;
+	float focalStrength;
+	float specularIntensity;
+	bool bDirectional;
+};
+
+/***********************************************************
+ *  BLEND_MODE
+ *
+ *  How the surfaces of a material cover what is behind
+ *  them, which decides the pass they are drawn in.
+ ***********************************************************/
+enum BLEND_MODE
+{
+	// drawn first, front to back, without blending
+	BLEND_OPAQUE,
+	// fragments whose alpha is below the cutoff are dropped,
+	// the rest are opaque; drawn after the opaque surfaces
+	BLEND_ALPHA_TEST,
+	// blended over what is behind, back to front and without
+	// depth writes, after everything else
+	BLEND_TRANSPARENT
+};
+
+/***********************************************************
+ *  RENDER_MATERIAL
+ *
+ *  How a surface reacts to the lights.
+ ***********************************************************/
+struct RENDER_MATERIAL
+{
+	glm::vec3 ambientColor;
+	float ambientStrength;
+	glm::vec3 diffuseColor;
+	glm::vec3 specularColor;
+	float shininess;
+	BLEND_MODE blendMode;
+	// alpha multiplied into transparent surfaces
+	float opacity;
+	// texture alpha below which alpha tested fragments are
+	// dropped
+	float alphaCutoff;
+};
+
+/***********************************************************
+ *  RENDER_OBJECT
+ *
+ *  Everything a draw of a mesh needs besides the mesh.
+ ***********************************************************/
+struct RENDER_OBJECT
+{
+	glm::mat4 model;
+	glm::vec2 uvScale;
+	// texture slot (-1 = untextured) and material (-1 = unlit
+	// and opaque), whose blend mode the draw takes
+	int textureSlot;
+	int materialIndex;
+};
+
+/***********************************************************
+ *  RenderBackend
+ *
+ *  What the scene manager needs to draw the scene object by
+ *  object: the basic meshes, up to 16 texture slots, the
+ *  lights and materials, and the draws of a frame.  Shading
+ *  is the Phong lighting of the scene shaders.
+ *
+ *  The OpenGL backend draws into the current context; the
+ *  software backend rasterizes into its own image on the
+ *  CPU, for machines without a GPU.
+ ***********************************************************/
+class RenderBackend
+{
+public:
+	// destructor
+	virtual ~RenderBackend() {}
+
+	// make every basic mesh drawable
+	virtual void LoadMeshes() = 0;
+
+	// create a texture from 8-bit image rows, bottom row first;
+	// 0 if it cannot be created
+	virtual unsigned int CreateTexture(const unsigned char* image, int width, int height, int channels) = 0;
+	virtual void DestroyTexture(unsigned int texture) = 0;
+	// make a texture the one of a slot
+	virtual void BindTexture(int slot, unsigned int texture) = 0;
+
+	virtual void SetLights(const std::vector<RENDER_LIGHT>& lights) = 0;
+	virtual void SetMaterials(const std::vector<RENDER_MATERIAL>& materials) = 0;
+
+	// draw the frame of a snapshot: BeginFrame(), any number of
+	// DrawMesh() calls, then EndFrame().  The draws come in
+	// pass order - opaque, alpha tested, then transparent back
+	// to front - so blending can follow submission order
+	virtual void BeginFrame(const SCENE_SNAPSHOT& snapshot) = 0;
+	virtual void DrawMesh(SCENE_MESH mesh, const RENDER_OBJECT& object) = 0;
+	virtual void EndFrame() = 0;
+};
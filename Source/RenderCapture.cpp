@@ -0,0 +1,356 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendercapture.cpp
+// ============
+// record the calls made to a render backend into a file, for replaying
+// them without the scene
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderCapture.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstddef>
+
+/***********************************************************
+ *  RenderCapture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderCapture::RenderCapture(RenderBackend* pBackend)
+{
+	m_pBackend = pBackend;
+	m_frameCount = 0;
+	m_capturedFrames = 0;
+	m_fileSize = 0;
+}
+
+/***********************************************************
+ *  ~RenderCapture()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderCapture::~RenderCapture()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Close();
+	m_pBackend = NULL;
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method creates the capture file and writes its
+ *  header.  Calls made before this are not in the file, so
+ *  it has to be opened before the scene is prepared.
+ ***********************************************************/
+bool RenderCapture::Open(const char* filename, int frameCount)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Close();
+
+	m_file.open(filename, std::ios::binary | std::ios::trunc);
+	if (!m_file)
+	{
+		std::cout << "Could not create capture file:" << filename << std::endl;
+		return(false);
+	}
+	m_filename = filename;
+	m_frameCount = frameCount;
+	m_capturedFrames = 0;
+	m_buffer.clear();
+
+	CAPTURE_FILE_HEADER header;
+	memcpy(header.magic, CAPTURE_FILE_MAGIC, sizeof(CAPTURE_FILE_MAGIC));
+	header.version = CAPTURE_FILE_VERSION;
+	header.meshGeneratorVersion = MESH_GENERATOR_VERSION;
+	header.frameCount = 0;
+	m_file.write((const char*)&header, sizeof(header));
+	m_fileSize = sizeof(header);
+	return(true);
+}
+
+/***********************************************************
+ *  LoadMeshes()
+ *
+ *  This method passes the call on and records it.
+ ***********************************************************/
+void RenderCapture::LoadMeshes()
+{
+	m_pBackend->LoadMeshes();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	WriteCommand(CAPTURE_LOAD_MESHES);
+}
+
+/***********************************************************
+ *  CreateTexture()
+ *
+ *  The texels are stored as they came, so the file is as
+ *  large as the scene's images.
+ ***********************************************************/
+unsigned int RenderCapture::CreateTexture(const unsigned char* image, int width, int height, int channels)
+{
+	unsigned int texture = m_pBackend->CreateTexture(image, width, height, channels);
+	if (texture == 0)
+	{
+		return(0);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (IsCapturing())
+	{
+		WriteCommand(CAPTURE_CREATE_TEXTURE);
+		WriteInt((int32_t)texture);
+		WriteInt(width);
+		WriteInt(height);
+		WriteInt(channels);
+		Write(image, (size_t)width * height * channels);
+	}
+	return(texture);
+}
+
+/***********************************************************
+ *  DestroyTexture() / BindTexture()
+ *
+ *  These methods pass the call on and record it.
+ ***********************************************************/
+void RenderCapture::DestroyTexture(unsigned int texture)
+{
+	m_pBackend->DestroyTexture(texture);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (IsCapturing())
+	{
+		WriteCommand(CAPTURE_DESTROY_TEXTURE);
+		WriteInt((int32_t)texture);
+	}
+}
+
+void RenderCapture::BindTexture(int slot, unsigned int texture)
+{
+	m_pBackend->BindTexture(slot, texture);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (IsCapturing())
+	{
+		WriteCommand(CAPTURE_BIND_TEXTURE);
+		WriteInt(slot);
+		WriteInt((int32_t)texture);
+	}
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method passes the lights on and records them.
+ ***********************************************************/
+void RenderCapture::SetLights(const std::vector<RENDER_LIGHT>& lights)
+{
+	m_pBackend->SetLights(lights);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!IsCapturing())
+	{
+		return;
+	}
+	WriteCommand(CAPTURE_SET_LIGHTS);
+	WriteInt((int32_t)lights.size());
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const RENDER_LIGHT& light = lights[i];
+		float values[14] = {
+			light.position.x, light.position.y, light.position.z,
+			light.ambientColor.x, light.ambientColor.y, light.ambientColor.z,
+			light.diffuseColor.x, light.diffuseColor.y, light.diffuseColor.z,
+			light.specularColor.x, light.specularColor.y, light.specularColor.z,
+			light.focalStrength, light.specularIntensity };
+		WriteFloats(values, 14);
+		WriteInt(light.bDirectional ? 1 : 0);
+	}
+}
+
+/***********************************************************
+ *  SetMaterials()
+ *
+ *  This method passes the materials on and records them.
+ ***********************************************************/
+void RenderCapture::SetMaterials(const std::vector<RENDER_MATERIAL>& materials)
+{
+	m_pBackend->SetMaterials(materials);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!IsCapturing())
+	{
+		return;
+	}
+	WriteCommand(CAPTURE_SET_MATERIALS);
+	WriteInt((int32_t)materials.size());
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		const RENDER_MATERIAL& material = materials[i];
+		float values[13] = {
+			material.ambientColor.x, material.ambientColor.y, material.ambientColor.z,
+			material.ambientStrength,
+			material.diffuseColor.x, material.diffuseColor.y, material.diffuseColor.z,
+			material.specularColor.x, material.specularColor.y, material.specularColor.z,
+			material.shininess, material.opacity, material.alphaCutoff };
+		WriteFloats(values, 13);
+		WriteInt((int32_t)material.blendMode);
+	}
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  The snapshot is stored with the camera the view manager
+ *  set up for the frame.
+ ***********************************************************/
+void RenderCapture::BeginFrame(const SCENE_SNAPSHOT& snapshot)
+{
+	m_pBackend->BeginFrame(snapshot);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!IsCapturing())
+	{
+		return;
+	}
+	WriteCommand(CAPTURE_BEGIN_FRAME);
+	uint64_t frameIndex = snapshot.frameIndex;
+	Write(&frameIndex, sizeof(frameIndex));
+	float values[35];
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			values[column * 4 + row] = snapshot.view[column][row];
+			values[16 + column * 4 + row] = snapshot.projection[column][row];
+		}
+	}
+	values[32] = snapshot.viewPosition.x;
+	values[33] = snapshot.viewPosition.y;
+	values[34] = snapshot.viewPosition.z;
+	WriteFloats(values, 35);
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  Model matrices are affine, so their last row is left out.
+ ***********************************************************/
+void RenderCapture::DrawMesh(SCENE_MESH mesh, const RENDER_OBJECT& object)
+{
+	m_pBackend->DrawMesh(mesh, object);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!IsCapturing())
+	{
+		return;
+	}
+	WriteCommand(CAPTURE_DRAW_MESH);
+	unsigned char meshIndex = (unsigned char)mesh;
+	Write(&meshIndex, sizeof(meshIndex));
+	float values[14];
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 3; row++)
+		{
+			values[column * 3 + row] = object.model[column][row];
+		}
+	}
+	values[12] = object.uvScale.x;
+	values[13] = object.uvScale.y;
+	WriteFloats(values, 14);
+	WriteInt(object.textureSlot);
+	WriteInt(object.materialIndex);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method writes the frame to the file and ends the
+ *  capture after its last frame.
+ ***********************************************************/
+void RenderCapture::EndFrame()
+{
+	m_pBackend->EndFrame();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!IsCapturing())
+	{
+		return;
+	}
+	WriteCommand(CAPTURE_END_FRAME);
+	m_capturedFrames++;
+	Flush();
+	if (m_capturedFrames >= m_frameCount)
+	{
+		Close();
+	}
+}
+
+/***********************************************************
+ *  WriteCommand() / Write()
+ *
+ *  These methods add to the collected commands.  The lock
+ *  is held by the caller.
+ ***********************************************************/
+void RenderCapture::WriteCommand(CAPTURE_COMMAND command)
+{
+	if (IsCapturing())
+	{
+		unsigned char code = (unsigned char)command;
+		Write(&code, sizeof(code));
+	}
+}
+
+void RenderCapture::Write(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+}
+
+/***********************************************************
+ *  Flush()
+ *
+ *  This method writes the collected commands to the file.
+ ***********************************************************/
+void RenderCapture::Flush()
+{
+	if (!m_buffer.empty())
+	{
+		m_file.write((const char*)m_buffer.data(), m_buffer.size());
+		m_fileSize += m_buffer.size();
+		m_buffer.clear();
+	}
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method finishes the file: the commands not written
+ *  yet and the frame count in the header.
+ ***********************************************************/
+void RenderCapture::Close()
+{
+	if (!IsCapturing())
+	{
+		return;
+	}
+	Flush();
+	uint32_t frameCount = (uint32_t)m_capturedFrames;
+	m_file.seekp(offsetof(CAPTURE_FILE_HEADER, frameCount));
+	m_file.write((const char*)&frameCount, sizeof(frameCount));
+	bool bWritten = m_file.good();
+	m_file.close();
+
+	if (bWritten)
+	{
+		std::cout << "Captured " << m_capturedFrames << " frames to " << m_filename << " ("
+			<< (m_fileSize + 1023) / 1024 << " KB)" << std::endl;
+	}
+	else
+	{
+		std::cout << "Could not write capture file:" << m_filename << std::endl;
+	}
+	std::vector<unsigned char>().swap(m_buffer);
+}
@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendercapture.h
+// ============
+// record the calls made to a render backend into a file, for replaying
+// them without the scene
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderBackend.h"
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// identifies capture files, and the layout of their calls
+const char CAPTURE_FILE_MAGIC[4] = { 'T', 'G', 'R', 'C' };
+const uint32_t CAPTURE_FILE_VERSION = 2;
+
+/***********************************************************
+ *  CAPTURE_COMMAND
+ *
+ *  The calls of a capture file.  Each is one byte followed
+ *  by its arguments:
+ *
+ *    LOAD_MESHES
+ *    CREATE_TEXTURE  id, width, height, channels, texels
+ *    DESTROY_TEXTURE id
+ *    BIND_TEXTURE    slot, id
+ *    SET_LIGHTS      count, lights
+ *    SET_MATERIALS   count, materials
+ *    BEGIN_FRAME     frame index, view, projection, eye
+ *    DRAW_MESH       mesh, model (3 x 4), UV scale, slot,
+ *                    material
+ *    END_FRAME
+ *
+ *  Integers are 32-bit and floats 32-bit IEEE, little-endian.
+ *  Texture IDs are those the capturing backend returned.
+ ***********************************************************/
+enum CAPTURE_COMMAND
+{
+	CAPTURE_LOAD_MESHES = 1,
+	CAPTURE_CREATE_TEXTURE,
+	CAPTURE_DESTROY_TEXTURE,
+	CAPTURE_BIND_TEXTURE,
+	CAPTURE_SET_LIGHTS,
+	CAPTURE_SET_MATERIALS,
+	CAPTURE_BEGIN_FRAME,
+	CAPTURE_DRAW_MESH,
+	CAPTURE_END_FRAME
+};
+
+/***********************************************************
+ *  CAPTURE_FILE_HEADER
+ *
+ *  Start of a capture file.  The meshes are not stored -
+ *  the replay generates them - so the generator version has
+ *  to match.
+ ***********************************************************/
+struct CAPTURE_FILE_HEADER
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t meshGeneratorVersion;
+	// frames in the file, written when the capture ends
+	uint32_t frameCount;
+};
+
+/***********************************************************
+ *  RenderCapture
+ *
+ *  A render backend in front of another one: every call is
+ *  passed on and, while capturing, also written to a file -
+ *  the setup calls (meshes, textures, lights, materials) as
+ *  they come and the draws of the given number of frames.
+ *  Commands are collected in memory and written out at the
+ *  end of each frame, so capturing costs the render thread
+ *  no file access per draw.  Setup calls can come from the
+ *  main thread (hot reload), so writing is locked.
+ ***********************************************************/
+class RenderCapture : public RenderBackend
+{
+public:
+	// constructor; the backend is not owned
+	RenderCapture(RenderBackend* pBackend);
+	// destructor - ends a capture still running
+	virtual ~RenderCapture();
+
+	// start writing the calls to a file, up to the end of the
+	// given number of frames
+	bool Open(const char* filename, int frameCount);
+	bool IsCapturing() const { return m_file.is_open(); }
+
+	virtual void LoadMeshes();
+
+	virtual unsigned int CreateTexture(const unsigned char* image, int width, int height, int channels);
+	virtual void DestroyTexture(unsigned int texture);
+	virtual void BindTexture(int slot, unsigned int texture);
+
+	virtual void SetLights(const std::vector<RENDER_LIGHT>& lights);
+	virtual void SetMaterials(const std::vector<RENDER_MATERIAL>& materials);
+
+	virtual void BeginFrame(const SCENE_SNAPSHOT& snapshot);
+	virtual void DrawMesh(SCENE_MESH mesh, const RENDER_OBJECT& object);
+	virtual void EndFrame();
+
+private:
+	void WriteCommand(CAPTURE_COMMAND command);
+	void Write(const void* data, size_t size);
+	void WriteInt(int32_t value) { Write(&value, sizeof(value)); }
+	void WriteFloats(const float* values, size_t count) { Write(values, count * sizeof(float)); }
+	// write the collected commands to the file
+	void Flush();
+	// write the frame count and close the file
+	void Close();
+
+	RenderBackend* m_pBackend;
+	std::mutex m_mutex;
+	std::ofstream m_file;
+	std::string m_filename;
+	std::vector<unsigned char> m_buffer;
+	int m_frameCount;
+	int m_capturedFrames;
+	size_t m_fileSize;
+};
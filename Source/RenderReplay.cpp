@@ -0,0 +1,554 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderreplay.cpp
+// ============
+// replay a capture file on the software rasterizer, time it and report
+// what the frames spend their work on
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderReplay.h"
+#include "CameraPath.h"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	// bytes of a recorded light and material
+	const size_t g_LightSize = 14 * sizeof(float) + sizeof(int32_t);
+	const size_t g_MaterialSize = 13 * sizeof(float) + sizeof(int32_t);
+	const int g_TextureSlots = 16;
+	// uniforms the GL backend sets per draw: the model matrix,
+	// the five material values, bUseTexture, the sampler and
+	// the UV scale
+	const size_t g_MaterialUniforms = 5;
+
+	// a share as a percentage
+	double Percent(size_t part, size_t whole)
+	{
+		return((whole > 0) ? 100.0 * part / whole : 0.0);
+	}
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings of a replay at the size
+ *  of the scene window.
+ ***********************************************************/
+RENDER_REPLAY_SETTINGS RenderReplay::DefaultSettings()
+{
+	RENDER_REPLAY_SETTINGS settings;
+	settings.rasterizer = SoftwareRasterizer::DefaultSettings();
+	settings.captureFile = NULL;
+	settings.loops = 3;
+	settings.reportedDraws = 10;
+	settings.csvFile = NULL;
+	return(settings);
+}
+
+/***********************************************************
+ *  RenderReplay()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderReplay::RenderReplay(SoftwareRasterizer* pRasterizer)
+{
+	m_pRasterizer = pRasterizer;
+	m_position = 0;
+	m_frameCount = 0;
+	m_bMeasuring = false;
+	m_frame = 0;
+	m_counts = REPLAY_STATE_COUNTS();
+	for (int i = 0; i < g_TextureSlots; i++)
+	{
+		m_boundTextures[i] = 0;
+	}
+	m_lastObject = RENDER_OBJECT();
+	m_lastMesh = MESH_PLANE;
+	m_bFirstDraw = true;
+	m_coveredPixels = 0;
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method replays the file once measuring and then the
+ *  given number of times for the frame times.  The timed
+ *  loops start at the first frame, so the setup calls before
+ *  it run only once.
+ ***********************************************************/
+bool RenderReplay::Run(const RENDER_REPLAY_SETTINGS& settings)
+{
+	SoftwareRasterizer rasterizer(settings.rasterizer);
+	RenderReplay replay(&rasterizer);
+	if (!replay.Load(settings.captureFile))
+	{
+		return(false);
+	}
+
+	// measuring pass, from the start of the file
+	CAPTURE_COMMAND command;
+	size_t firstFrame = 0;
+	replay.m_bMeasuring = true;
+	rasterizer.SetDrawStatistics(true);
+	for (size_t position = replay.m_position; replay.Step(command); position = replay.m_position)
+	{
+		if ((command == CAPTURE_BEGIN_FRAME) && (firstFrame == 0))
+			firstFrame = position;
+	}
+	if (replay.m_position != replay.m_data.size())
+	{
+		std::cout << "Capture file is damaged:" << settings.captureFile << std::endl;
+		return(false);
+	}
+	replay.m_bMeasuring = false;
+	rasterizer.SetDrawStatistics(false);
+	replay.PrintReport(settings);
+
+	// timed loops over the frames
+	FrameStatistics statistics;
+	unsigned long long frameIndex = 0;
+	for (int loop = 0; (loop < settings.loops) && (firstFrame > 0); loop++)
+	{
+		replay.m_position = firstFrame;
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		while (replay.Step(command))
+		{
+			if (command == CAPTURE_END_FRAME)
+			{
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				statistics.AddFrame(++frameIndex, std::chrono::duration<double, std::milli>(now - frameStart).count(), 0.0);
+				frameStart = now;
+			}
+		}
+	}
+	statistics.PrintReport("Capture replay");
+	if (NULL != settings.csvFile)
+	{
+		statistics.WriteCSV(settings.csvFile);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method reads the whole capture file and checks its
+ *  header.
+ ***********************************************************/
+bool RenderReplay::Load(const char* filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Could not open capture file:" << filename << std::endl;
+		return(false);
+	}
+	m_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	CAPTURE_FILE_HEADER header;
+	m_position = 0;
+	if (!Read(&header, sizeof(header)) || (memcmp(header.magic, CAPTURE_FILE_MAGIC, sizeof(CAPTURE_FILE_MAGIC)) != 0) ||
+		(header.version != CAPTURE_FILE_VERSION))
+	{
+		std::cout << "Not a capture file:" << filename << std::endl;
+		return(false);
+	}
+	if (header.meshGeneratorVersion != MESH_GENERATOR_VERSION)
+	{
+		std::cout << "Capture " << filename << " was made with other meshes (generator version "
+			<< header.meshGeneratorVersion << ", not " << MESH_GENERATOR_VERSION << ")" << std::endl;
+	}
+	m_frameCount = header.frameCount;
+
+	std::cout << "Replaying " << filename << ": " << m_frameCount << " frames, " << (m_data.size() + 1023) / 1024
+		<< " KB, " << m_pRasterizer->GetThreadCount() << " threads" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Read()
+ *
+ *  This method copies bytes at the read position out of the
+ *  file and moves past them.
+ ***********************************************************/
+bool RenderReplay::Read(void* data, size_t size)
+{
+	if (size > m_data.size() - m_position)
+	{
+		return(false);
+	}
+	memcpy(data, &m_data[m_position], size);
+	m_position += size;
+	return(true);
+}
+
+/***********************************************************
+ *  ReplayTexture()
+ *
+ *  This method returns the texture of the rasterizer that
+ *  was created for a captured texture ID (0 = none).
+ ***********************************************************/
+unsigned int RenderReplay::ReplayTexture(unsigned int captured) const
+{
+	// the newest texture with the ID, as GL reuses freed IDs
+	for (size_t i = m_capturedTextures.size(); i > 0; i--)
+	{
+		if (m_capturedTextures[i - 1] == captured)
+			return(m_replayTextures[i - 1]);
+	}
+	return(0);
+}
+
+/***********************************************************
+ *  Step()
+ *
+ *  This method reads the next call of the file and makes it
+ *  on the rasterizer.  While measuring, it also tracks the
+ *  state the calls set and collects the draw statistics of
+ *  each frame.
+ ***********************************************************/
+bool RenderReplay::Step(CAPTURE_COMMAND& command)
+{
+	unsigned char code = 0;
+	if (!Read(&code, sizeof(code)))
+	{
+		return(false);
+	}
+	command = (CAPTURE_COMMAND)code;
+
+	switch (command)
+	{
+	case CAPTURE_LOAD_MESHES:
+		m_pRasterizer->LoadMeshes();
+		break;
+
+	case CAPTURE_CREATE_TEXTURE:
+	{
+		int32_t values[4];
+		if (!Read(values, sizeof(values)) || (values[1] <= 0) || (values[2] <= 0) ||
+			((values[3] != 3) && (values[3] != 4)))
+		{
+			return(false);
+		}
+		size_t size = (size_t)values[1] * values[2] * values[3];
+		if (size > m_data.size() - m_position)
+		{
+			return(false);
+		}
+		m_capturedTextures.push_back((unsigned int)values[0]);
+		m_replayTextures.push_back(m_pRasterizer->CreateTexture(&m_data[m_position], values[1], values[2], values[3]));
+		m_position += size;
+		break;
+	}
+
+	case CAPTURE_DESTROY_TEXTURE:
+	{
+		int32_t texture;
+		if (!Read(&texture, sizeof(texture)))
+		{
+			return(false);
+		}
+		m_pRasterizer->DestroyTexture(ReplayTexture((unsigned int)texture));
+		break;
+	}
+
+	case CAPTURE_BIND_TEXTURE:
+	{
+		int32_t values[2];
+		if (!Read(values, sizeof(values)))
+		{
+			return(false);
+		}
+		if (m_bMeasuring && (values[0] >= 0) && (values[0] < g_TextureSlots))
+		{
+			m_counts.textureBinds++;
+			if (m_boundTextures[values[0]] == (unsigned int)values[1])
+				m_counts.redundantTextureBinds++;
+			m_boundTextures[values[0]] = (unsigned int)values[1];
+		}
+		m_pRasterizer->BindTexture(values[0], ReplayTexture((unsigned int)values[1]));
+		break;
+	}
+
+	case CAPTURE_SET_LIGHTS:
+	{
+		int32_t count;
+		if (!Read(&count, sizeof(count)) || (count < 0) || ((size_t)count * g_LightSize > m_data.size() - m_position))
+		{
+			return(false);
+		}
+		const unsigned char* payload = &m_data[m_position];
+		std::vector<RENDER_LIGHT> lights(count);
+		for (int32_t i = 0; i < count; i++)
+		{
+			float values[14];
+			int32_t bDirectional;
+			Read(values, sizeof(values));
+			Read(&bDirectional, sizeof(bDirectional));
+			lights[i].position = glm::vec3(values[0], values[1], values[2]);
+			lights[i].ambientColor = glm::vec3(values[3], values[4], values[5]);
+			lights[i].diffuseColor = glm::vec3(values[6], values[7], values[8]);
+			lights[i].specularColor = glm::vec3(values[9], values[10], values[11]);
+			lights[i].focalStrength = values[12];
+			lights[i].specularIntensity = values[13];
+			lights[i].bDirectional = (bDirectional != 0);
+		}
+		if (m_bMeasuring)
+		{
+			std::vector<unsigned char> bytes(payload, payload + count * g_LightSize);
+			m_counts.lightUpdates++;
+			if (bytes == m_lastLights)
+				m_counts.redundantLightUpdates++;
+			m_lastLights.swap(bytes);
+		}
+		m_pRasterizer->SetLights(lights);
+		break;
+	}
+
+	case CAPTURE_SET_MATERIALS:
+	{
+		int32_t count;
+		if (!Read(&count, sizeof(count)) || (count < 0) || ((size_t)count * g_MaterialSize > m_data.size() - m_position))
+		{
+			return(false);
+		}
+		const unsigned char* payload = &m_data[m_position];
+		std::vector<RENDER_MATERIAL> materials(count);
+		for (int32_t i = 0; i < count; i++)
+		{
+			float values[13];
+			int32_t blendMode;
+			Read(values, sizeof(values));
+			Read(&blendMode, sizeof(blendMode));
+			materials[i].ambientColor = glm::vec3(values[0], values[1], values[2]);
+			materials[i].ambientStrength = values[3];
+			materials[i].diffuseColor = glm::vec3(values[4], values[5], values[6]);
+			materials[i].specularColor = glm::vec3(values[7], values[8], values[9]);
+			materials[i].shininess = values[10];
+			materials[i].opacity = values[11];
+			materials[i].alphaCutoff = values[12];
+			materials[i].blendMode = ((blendMode >= BLEND_OPAQUE) && (blendMode <= BLEND_TRANSPARENT)) ?
+				(BLEND_MODE)blendMode : BLEND_OPAQUE;
+		}
+		if (m_bMeasuring)
+		{
+			std::vector<unsigned char> bytes(payload, payload + count * g_MaterialSize);
+			m_counts.materialUpdates++;
+			if (bytes == m_lastMaterials)
+				m_counts.redundantMaterialUpdates++;
+			m_lastMaterials.swap(bytes);
+		}
+		m_pRasterizer->SetMaterials(materials);
+		break;
+	}
+
+	case CAPTURE_BEGIN_FRAME:
+	{
+		uint64_t frameIndex;
+		float values[35];
+		if (!Read(&frameIndex, sizeof(frameIndex)) || !Read(values, sizeof(values)))
+		{
+			return(false);
+		}
+		SCENE_SNAPSHOT snapshot = SCENE_SNAPSHOT();
+		snapshot.frameIndex = frameIndex;
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				snapshot.view[column][row] = values[column * 4 + row];
+				snapshot.projection[column][row] = values[16 + column * 4 + row];
+			}
+		}
+		snapshot.viewPosition = glm::vec3(values[32], values[33], values[34]);
+		m_frameDraws.clear();
+		m_bFirstDraw = true;
+		m_pRasterizer->BeginFrame(snapshot);
+		break;
+	}
+
+	case CAPTURE_DRAW_MESH:
+	{
+		unsigned char mesh;
+		float values[14];
+		int32_t indices[2];
+		if (!Read(&mesh, sizeof(mesh)) || !Read(values, sizeof(values)) || !Read(indices, sizeof(indices)) ||
+			(mesh >= MESH_COUNT))
+		{
+			return(false);
+		}
+		RENDER_OBJECT object;
+		object.model = glm::mat4(1.0f);
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 3; row++)
+			{
+				object.model[column][row] = values[column * 3 + row];
+			}
+		}
+		object.uvScale = glm::vec2(values[12], values[13]);
+		object.textureSlot = indices[0];
+		object.materialIndex = indices[1];
+
+		if (m_bMeasuring)
+		{
+			// the uniforms the GL backend sets, and those the
+			// previous draw of the frame already set the same
+			bool bMaterial = (object.materialIndex >= 0) &&
+				((size_t)object.materialIndex < m_lastMaterials.size() / g_MaterialSize);
+			m_counts.draws++;
+			m_counts.uniformUpdates += 4 + (bMaterial ? g_MaterialUniforms : 0);
+			// bUseTexture is already set by the frame's start
+			m_counts.redundantUniformUpdates++;
+			if (!m_bFirstDraw)
+			{
+				if ((SCENE_MESH)mesh != m_lastMesh)
+					m_counts.meshChanges++;
+				if (object.textureSlot != m_lastObject.textureSlot)
+					m_counts.textureChanges++;
+				else
+					m_counts.redundantUniformUpdates++;
+				if (object.materialIndex != m_lastObject.materialIndex)
+					m_counts.materialChanges++;
+				else if (bMaterial)
+					m_counts.redundantUniformUpdates += g_MaterialUniforms;
+				if (object.uvScale == m_lastObject.uvScale)
+					m_counts.redundantUniformUpdates++;
+				if (object.model == m_lastObject.model)
+					m_counts.redundantUniformUpdates++;
+			}
+			m_lastObject = object;
+			m_lastMesh = (SCENE_MESH)mesh;
+			m_bFirstDraw = false;
+
+			REPLAY_DRAW draw;
+			draw.frame = m_frame;
+			draw.draw = (int)m_frameDraws.size();
+			draw.mesh = (SCENE_MESH)mesh;
+			draw.textureSlot = object.textureSlot;
+			draw.materialIndex = object.materialIndex;
+			draw.statistics = SOFTWARE_DRAW_STATISTICS();
+			m_frameDraws.push_back(draw);
+		}
+		m_pRasterizer->DrawMesh((SCENE_MESH)mesh, object);
+		break;
+	}
+
+	case CAPTURE_END_FRAME:
+		m_pRasterizer->EndFrame();
+		if (m_bMeasuring)
+		{
+			const std::vector<SOFTWARE_DRAW_STATISTICS>& statistics = m_pRasterizer->GetDrawStatistics();
+			for (size_t i = 0; (i < m_frameDraws.size()) && (i < statistics.size()); i++)
+			{
+				m_frameDraws[i].statistics = statistics[i];
+				m_draws.push_back(m_frameDraws[i]);
+			}
+			m_coveredPixels += m_pRasterizer->GetCoveredPixels();
+			m_frame++;
+		}
+		break;
+
+	default:
+		// back onto the unknown byte, so the caller sees the
+		// file as damaged rather than at its end
+		m_position--;
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  PrintReport()
+ *
+ *  This method prints what the measuring pass found.
+ ***********************************************************/
+void RenderReplay::PrintReport(const RENDER_REPLAY_SETTINGS& settings) const
+{
+	size_t triangles = 0;
+	size_t fragments = 0;
+	size_t shadedFragments = 0;
+	double drawTime = 0.0;
+	size_t meshDraws[MESH_COUNT] = { 0 };
+	size_t meshTriangles[MESH_COUNT] = { 0 };
+	size_t meshFragments[MESH_COUNT] = { 0 };
+	double meshTimes[MESH_COUNT] = { 0.0 };
+	for (size_t i = 0; i < m_draws.size(); i++)
+	{
+		const REPLAY_DRAW& draw = m_draws[i];
+		double time = draw.statistics.vertexTime + draw.statistics.rasterTime;
+		triangles += draw.statistics.triangles;
+		fragments += draw.statistics.fragments;
+		shadedFragments += draw.statistics.shadedFragments;
+		drawTime += time;
+		meshDraws[draw.mesh]++;
+		meshTriangles[draw.mesh] += draw.statistics.triangles;
+		meshFragments[draw.mesh] += draw.statistics.shadedFragments;
+		meshTimes[draw.mesh] += time;
+	}
+	int frames = std::max(m_frame, 1);
+
+	std::cout << "\nCapture analysis\n";
+	std::cout << "  frames:       " << m_frame << "\n";
+	std::cout << "  draws:        " << m_draws.size() / frames << " per frame, "
+		<< triangles / frames << " triangles per frame\n";
+
+	std::cout << "  state calls:  texture binds " << m_counts.textureBinds << " (" << m_counts.redundantTextureBinds
+		<< " redundant), light updates " << m_counts.lightUpdates << " (" << m_counts.redundantLightUpdates
+		<< " redundant), material updates " << m_counts.materialUpdates << " (" << m_counts.redundantMaterialUpdates
+		<< " redundant)\n";
+	std::cout << "  between draws: mesh changes " << Percent(m_counts.meshChanges, m_counts.draws)
+		<< "%, texture changes " << Percent(m_counts.textureChanges, m_counts.draws)
+		<< "%, material changes " << Percent(m_counts.materialChanges, m_counts.draws) << "%\n";
+	std::cout << "  GL uniforms:  " << m_counts.uniformUpdates / frames << " per frame, "
+		<< Percent(m_counts.redundantUniformUpdates, m_counts.uniformUpdates) << "% left unchanged by the draw\n";
+
+	if (m_coveredPixels > 0)
+	{
+		std::cout << "  overdraw:     " << (double)shadedFragments / m_coveredPixels << " shaded fragments and "
+			<< (double)fragments / m_coveredPixels << " covered fragments per covered pixel\n";
+	}
+
+	std::cout << "  per mesh:     draws / triangles / shaded fragments / ms, per frame\n";
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		if (meshDraws[i] == 0)
+			continue;
+		std::cout << "    " << MeshGenerator::MeshName((SCENE_MESH)i) << ": " << meshDraws[i] / frames << " / "
+			<< meshTriangles[i] / frames << " / " << meshFragments[i] / frames << " / " << meshTimes[i] / frames
+			<< " (" << Percent((size_t)(meshTimes[i] * 1000.0), (size_t)(drawTime * 1000.0)) << "%)\n";
+	}
+
+	// the costliest draws, by vertex and raster time
+	std::vector<size_t> order(m_draws.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	size_t reported = std::min(order.size(), (size_t)std::max(settings.reportedDraws, 0));
+	std::partial_sort(order.begin(), order.begin() + reported, order.end(), [this](size_t a, size_t b)
+	{
+		const SOFTWARE_DRAW_STATISTICS& first = m_draws[a].statistics;
+		const SOFTWARE_DRAW_STATISTICS& second = m_draws[b].statistics;
+		return((first.vertexTime + first.rasterTime) > (second.vertexTime + second.rasterTime));
+	});
+	if (reported > 0)
+	{
+		std::cout << "  costliest draws: frame.draw mesh (slot, material) triangles, covered / shaded fragments, ms\n";
+	}
+	for (size_t i = 0; i < reported; i++)
+	{
+		const REPLAY_DRAW& draw = m_draws[order[i]];
+		std::cout << "    " << draw.frame << "." << draw.draw << " " << MeshGenerator::MeshName(draw.mesh) << " ("
+			<< draw.textureSlot << ", " << draw.materialIndex << ") " << draw.statistics.triangles << ", "
+			<< draw.statistics.fragments << " / " << draw.statistics.shadedFragments << ", "
+			<< draw.statistics.vertexTime + draw.statistics.rasterTime << "\n";
+	}
+	std::cout << std::endl;
+}
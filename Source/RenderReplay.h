@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderreplay.h
+// ============
+// replay a capture file on the software rasterizer, time it and report
+// what the frames spend their work on
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderCapture.h"
+#include "SoftwareRasterizer.h"
+
+#include <vector>
+
+/***********************************************************
+ *  RENDER_REPLAY_SETTINGS
+ *
+ *  What to replay and how often.
+ ***********************************************************/
+struct RENDER_REPLAY_SETTINGS
+{
+	SOFTWARE_RASTERIZER_SETTINGS rasterizer;
+	const char* captureFile;
+	// timed passes over the captured frames, after the pass
+	// that measures the draws
+	int loops;
+	// most expensive draws to list
+	int reportedDraws;
+	// file to write the per-frame timings to (NULL = none)
+	const char* csvFile;
+};
+
+/***********************************************************
+ *  RenderReplay
+ *
+ *  Runs the calls of a capture file against the software
+ *  rasterizer, without a window and without the scene: the
+ *  file has the textures, lights, materials, cameras and
+ *  draws, and the meshes are generated.
+ *
+ *  The first pass over the frames measures every draw -
+ *  triangles, covered and shaded fragments, vertex and
+ *  raster time - and tracks the state the calls set.  The
+ *  report lists:
+ *
+ *  - state calls that set what was already set, and the
+ *    uniform updates the GL backend makes per draw for
+ *    values the previous draw left in place
+ *  - overdraw: shaded fragments per covered pixel
+ *  - the most expensive draws and the cost per mesh
+ *
+ *  The frames are then replayed again without measuring,
+ *  and their times reported like a playback's.
+ ***********************************************************/
+class RenderReplay
+{
+public:
+	// default settings: 3 timed loops, the 10 costliest draws
+	static RENDER_REPLAY_SETTINGS DefaultSettings();
+	// replay the file; false if it cannot be read
+	static bool Run(const RENDER_REPLAY_SETTINGS& settings);
+
+private:
+	// a draw of the measuring pass
+	struct REPLAY_DRAW
+	{
+		int frame;
+		int draw;
+		SCENE_MESH mesh;
+		int textureSlot;
+		int materialIndex;
+		SOFTWARE_DRAW_STATISTICS statistics;
+	};
+
+	// state calls, and how many changed nothing
+	struct REPLAY_STATE_COUNTS
+	{
+		size_t textureBinds;
+		size_t redundantTextureBinds;
+		size_t lightUpdates;
+		size_t redundantLightUpdates;
+		size_t materialUpdates;
+		size_t redundantMaterialUpdates;
+		size_t draws;
+		size_t meshChanges;
+		size_t textureChanges;
+		size_t materialChanges;
+		size_t uniformUpdates;
+		size_t redundantUniformUpdates;
+	};
+
+	// constructor
+	RenderReplay(SoftwareRasterizer* pRasterizer);
+
+	bool Load(const char* filename);
+	// run the next call of the file; false at its end or if
+	// the call is damaged
+	bool Step(CAPTURE_COMMAND& command);
+	bool Read(void* data, size_t size);
+	// the texture of the rasterizer for a captured ID
+	unsigned int ReplayTexture(unsigned int captured) const;
+
+	void PrintReport(const RENDER_REPLAY_SETTINGS& settings) const;
+
+	SoftwareRasterizer* m_pRasterizer;
+	std::vector<unsigned char> m_data;
+	size_t m_position;
+	uint32_t m_frameCount;
+	// captured texture IDs and those of the rasterizer
+	std::vector<unsigned int> m_capturedTextures;
+	std::vector<unsigned int> m_replayTextures;
+
+	// measuring pass
+	bool m_bMeasuring;
+	int m_frame;
+	REPLAY_STATE_COUNTS m_counts;
+	unsigned int m_boundTextures[16];
+	std::vector<unsigned char> m_lastLights;
+	std::vector<unsigned char> m_lastMaterials;
+	RENDER_OBJECT m_lastObject;
+	SCENE_MESH m_lastMesh;
+	bool m_bFirstDraw;
+	std::vector<REPLAY_DRAW> m_frameDraws;
+	std::vector<REPLAY_DRAW> m_draws;
+	size_t m_coveredPixels;
+};
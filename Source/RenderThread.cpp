@@ -0,0 +1,359 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderthread.cpp
+// ============
+// own the OpenGL context and draw the latest published scene snapshot
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderThread.h"
+#include "AllocationCounter.h"
+
+#include <iostream>
+#include <chrono>
+
+// declaration of global variables
+namespace
+{
+	// frames drawn before the allocation check starts, while
+	// buffers, arenas and driver state reach their final sizes
+	const unsigned long long g_AllocationWarmupFrames = 60;
+	// allocating frames reported one by one before the summary
+	const unsigned long long g_AllocationReportLimit = 10;
+}
+
+/***********************************************************
+ *  RenderThread()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderThread::RenderThread(
+	GLFWwindow* pWindow,
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager,
+	FrameScheduler* pFrameScheduler)
+{
+	m_pWindow = pWindow;
+	m_pViewManager = pViewManager;
+	m_pSceneManager = pSceneManager;
+	m_pFrameScheduler = pFrameScheduler;
+	m_dynamicResolutionSettings = DynamicResolution::DefaultSettings();
+	m_pDynamicResolution = NULL;
+	m_frameCaptureSettings = FrameCapture::DefaultSettings();
+	m_pFrameCapture = NULL;
+	m_bScreenshotRequested = false;
+	m_pFrameStatistics = NULL;
+	m_bRunning = false;
+	m_framesRendered = 0;
+	m_bAllocationCheck = false;
+}
+
+/***********************************************************
+ *  ~RenderThread()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderThread::~RenderThread()
+{
+	Stop();
+	m_pWindow = NULL;
+	m_pViewManager = NULL;
+	m_pSceneManager = NULL;
+	m_pFrameScheduler = NULL;
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method launches the render thread.  A GL context can
+ *  only be current on one thread at a time, so the caller
+ *  must call glfwMakeContextCurrent(NULL) before this.
+ ***********************************************************/
+bool RenderThread::Start()
+{
+	if ((m_bRunning == true) || (NULL == m_pWindow))
+	{
+		return(false);
+	}
+
+	m_bRunning = true;
+	m_thread = std::thread(&RenderThread::Run, this);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method signals the render thread to finish its
+ *  current frame and waits for it to exit.  Afterwards the
+ *  GL context is free to be made current on the caller.
+ ***********************************************************/
+void RenderThread::Stop()
+{
+	if (m_bRunning == false)
+	{
+		return;
+	}
+
+	m_snapshots.Shutdown();
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	m_bRunning = false;
+}
+
+/***********************************************************
+ *  SetDynamicResolution()
+ *
+ *  This method stores the dynamic resolution settings.  The
+ *  GL objects are created later, on the render thread.
+ ***********************************************************/
+void RenderThread::SetDynamicResolution(const DYNAMIC_RESOLUTION_SETTINGS& settings)
+{
+	if (m_bRunning == false)
+	{
+		m_dynamicResolutionSettings = settings;
+	}
+}
+
+/***********************************************************
+ *  SetFrameCapture()
+ *
+ *  This method stores the frame capture settings.  The pixel
+ *  buffers are created later, on the render thread.
+ ***********************************************************/
+void RenderThread::SetFrameCapture(const FRAME_CAPTURE_SETTINGS& settings)
+{
+	if (m_bRunning == false)
+	{
+		m_frameCaptureSettings = settings;
+	}
+}
+
+/***********************************************************
+ *  SetAllocationCheck()
+ *
+ *  This method turns the per-frame allocation check on or
+ *  off.  Frames after the warm-up are expected to make no
+ *  heap allocations; a hot reload is the only exception.
+ ***********************************************************/
+void RenderThread::SetAllocationCheck(bool bEnabled)
+{
+	if (m_bRunning == false)
+	{
+		m_bAllocationCheck = bEnabled;
+	}
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is the body of the render thread.  It owns
+ *  the GL context for its whole lifetime and draws every new
+ *  snapshot the simulation thread publishes.  While the view
+ *  is idle no snapshots arrive and the thread simply sleeps.
+ ***********************************************************/
+void RenderThread::Run()
+{
+	glfwMakeContextCurrent(m_pWindow);
+
+	// the swap interval belongs to the context, so set it here
+	if (NULL != m_pFrameScheduler)
+	{
+		m_pFrameScheduler->ApplySwapInterval();
+	}
+
+	// the offscreen target is created with the context current,
+	// for the framebuffer size of the first snapshot that has
+	// one (none while the window starts minimized)
+	bool bCreateDynamicResolution = m_dynamicResolutionSettings.bEnabled;
+	// so are the pixel buffers of a recording
+	bool bCreateFrameCapture = m_frameCaptureSettings.bRecording;
+
+	SCENE_SNAPSHOT snapshot;
+	unsigned long long lastFrameIndex = 0;
+	// frames checked for allocations and those that made some
+	unsigned long long checkedFrames = 0;
+	unsigned long long allocatingFrames = 0;
+
+	// WaitForLatest() returns false once Stop() has been called
+	while (m_snapshots.WaitForLatest(snapshot, lastFrameIndex))
+	{
+		bool bHasSize = (snapshot.framebufferWidth > 0) && (snapshot.framebufferHeight > 0);
+		if (bCreateDynamicResolution && bHasSize)
+		{
+			bCreateDynamicResolution = false;
+			m_pDynamicResolution = new DynamicResolution(m_dynamicResolutionSettings);
+			if (m_pDynamicResolution->Initialize(snapshot.framebufferWidth, snapshot.framebufferHeight) == false)
+			{
+				std::cout << "Dynamic resolution disabled" << std::endl;
+				delete m_pDynamicResolution;
+				m_pDynamicResolution = NULL;
+			}
+		}
+		// follow a resized window; a minimized one keeps the size
+		// it had
+		else if ((NULL != m_pDynamicResolution) && bHasSize &&
+			((snapshot.framebufferWidth != m_pDynamicResolution->GetOutputWidth()) ||
+			(snapshot.framebufferHeight != m_pDynamicResolution->GetOutputHeight())))
+		{
+			if (m_pDynamicResolution->Resize(snapshot.framebufferWidth, snapshot.framebufferHeight) == false)
+			{
+				std::cout << "Dynamic resolution disabled" << std::endl;
+				delete m_pDynamicResolution;
+				m_pDynamicResolution = NULL;
+			}
+		}
+		if (bCreateFrameCapture)
+		{
+			bCreateFrameCapture = false;
+			CreateFrameCapture(snapshot.framebufferWidth, snapshot.framebufferHeight);
+		}
+
+		if (NULL != m_pFrameScheduler)
+		{
+			m_pFrameScheduler->BeginFrame();
+		}
+
+		std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+		unsigned long long allocationsBefore = AllocationCounter::GetThreadCount();
+		RenderFrame(snapshot);
+		unsigned long long frameAllocations = AllocationCounter::GetThreadCount() - allocationsBefore;
+
+		if (m_bAllocationCheck && (m_framesRendered >= g_AllocationWarmupFrames))
+		{
+			checkedFrames++;
+			if (frameAllocations > 0)
+			{
+				allocatingFrames++;
+				if (allocatingFrames <= g_AllocationReportLimit)
+				{
+					std::cout << "Allocation check: frame " << snapshot.frameIndex << " made "
+						<< frameAllocations << " heap allocations" << std::endl;
+				}
+			}
+		}
+
+		// the frame time includes the swap, so it reflects the GPU
+		// too when vsync is off (benchmarks should use --vsync off)
+		FrameStatistics* pFrameStatistics = m_pFrameStatistics;
+		if (NULL != pFrameStatistics)
+		{
+			double frameTime = std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - frameStart).count();
+			double gpuTime = (NULL != m_pDynamicResolution) ? m_pDynamicResolution->GetGPUFrameTime() : 0.0;
+			pFrameStatistics->AddFrame(snapshot.frameIndex, frameTime, gpuTime);
+		}
+
+		// wake the main thread out of its idle wait while virtual
+		// texture pages are loading, so the next frame shows them
+		if (m_pSceneManager->UpdateStreaming())
+		{
+			glfwPostEmptyEvent();
+		}
+
+		// measure the frame and wait for the next frame deadline
+		if (NULL != m_pFrameScheduler)
+		{
+			m_pFrameScheduler->EndFrame();
+		}
+
+		lastFrameIndex = snapshot.frameIndex;
+		m_framesRendered++;
+	}
+
+	if (m_bAllocationCheck)
+	{
+		std::cout << "Allocation check: " << allocatingFrames << " of " << checkedFrames
+			<< " frames after the warm-up made heap allocations" << std::endl;
+	}
+
+	if (NULL != m_pDynamicResolution)
+	{
+		delete m_pDynamicResolution;
+		m_pDynamicResolution = NULL;
+	}
+	// writes out the frames still in flight
+	if (NULL != m_pFrameCapture)
+	{
+		delete m_pFrameCapture;
+		m_pFrameCapture = NULL;
+	}
+
+	// hand the context back so the main thread can clean up
+	glfwMakeContextCurrent(NULL);
+}
+
+/***********************************************************
+ *  RenderFrame()
+ *
+ *  This method draws one snapshot and flips the back buffer.
+ *  With dynamic resolution the scene goes through the scaled
+ *  offscreen target first.
+ ***********************************************************/
+void RenderThread::RenderFrame(const SCENE_SNAPSHOT& snapshot)
+{
+	// draw into the scaled offscreen target when it is enabled
+	if (NULL != m_pDynamicResolution)
+	{
+		m_pDynamicResolution->BeginScene();
+	}
+
+	// Enable z-depth
+	glEnable(GL_DEPTH_TEST);
+
+	// Clear the frame and z buffers
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// convert from 3D object space to 2D view
+	m_pViewManager->PrepareSceneView(snapshot);
+
+	// refresh the 3D scene
+	m_pSceneManager->RenderScene(snapshot);
+
+	// upscale the offscreen target into the window
+	if (NULL != m_pDynamicResolution)
+	{
+		m_pDynamicResolution->EndScene();
+	}
+
+	// read the finished frame back for the video or a screenshot
+	bool bScreenshot = m_bScreenshotRequested.exchange(false);
+	if (bScreenshot && (NULL == m_pFrameCapture))
+	{
+		CreateFrameCapture(snapshot.framebufferWidth, snapshot.framebufferHeight);
+	}
+	if (NULL != m_pFrameCapture)
+	{
+		m_pFrameCapture->CaptureFrame(snapshot.framebufferWidth, snapshot.framebufferHeight, bScreenshot);
+	}
+
+	// the swap may wait for the vertical blank, which is not
+	// part of the frame's work
+	if (NULL != m_pFrameScheduler)
+	{
+		m_pFrameScheduler->EndWork();
+	}
+
+	// Flips the the back buffer with the front buffer every frame.
+	glfwSwapBuffers(m_pWindow);
+}
+
+/***********************************************************
+ *  CreateFrameCapture()
+ *
+ *  This method creates the pixel buffers and the encoder
+ *  thread for the framebuffer size of a snapshot; GLFW only
+ *  tells the size on the main thread.
+ ***********************************************************/
+void RenderThread::CreateFrameCapture(int width, int height)
+{
+	m_pFrameCapture = new FrameCapture(m_frameCaptureSettings);
+	if (m_pFrameCapture->Initialize(width, height) == false)
+	{
+		std::cout << "Frame capture disabled" << std::endl;
+		delete m_pFrameCapture;
+		m_pFrameCapture = NULL;
+	}
+}
@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderthread.h
+// ============
+// own the OpenGL context and draw the latest published scene snapshot
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneSnapshot.h"
+#include "FrameScheduler.h"
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "CameraPath.h"
+#include "SceneManager.h"
+#include "ViewManager.h"
+
+#include <atomic>
+#include <thread>
+
+// GLFW library
+#include "GLFW/glfw3.h"
+
+/***********************************************************
+ *  RenderThread
+ *
+ *  This class runs the GL submission loop on its own thread.
+ *  The main thread keeps polling input and simulating the
+ *  camera, and publishes a SCENE_SNAPSHOT for every step; the
+ *  render thread picks up the latest one and draws it, so the
+ *  simulation cost and the GPU submission overlap.
+ ***********************************************************/
+class RenderThread
+{
+public:
+	// constructor
+	RenderThread(
+		GLFWwindow* pWindow,
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager,
+		FrameScheduler* pFrameScheduler);
+	// destructor
+	~RenderThread();
+
+	// make the GL context current on a new thread and start drawing;
+	// the caller must have released the context beforehand
+	bool Start();
+	// stop drawing, join the thread and release the GL context
+	void Stop();
+
+	// render the scene at a GPU-time driven resolution scale;
+	// must be called before Start()
+	void SetDynamicResolution(const DYNAMIC_RESOLUTION_SETTINGS& settings);
+
+	// record the drawn frames as a video; must be called before
+	// Start().  The settings are also those of screenshots
+	void SetFrameCapture(const FRAME_CAPTURE_SETTINGS& settings);
+	// save the next drawn frame as a screenshot (any thread)
+	void RequestScreenshot() { m_bScreenshotRequested = true; }
+
+	// count the heap allocations of every drawn frame and report
+	// the frames that made any; must be called before Start()
+	void SetAllocationCheck(bool bEnabled);
+
+	// record the time of every drawn frame (NULL to stop)
+	void SetFrameStatistics(FrameStatistics* pFrameStatistics) { m_pFrameStatistics = pFrameStatistics; }
+
+	// the buffer the simulation thread publishes snapshots into
+	SnapshotBuffer* GetSnapshotBuffer() { return &m_snapshots; }
+
+	// number of frames drawn so far
+	unsigned long long GetFramesRendered() const { return m_framesRendered.load(); }
+
+private:
+	// body of the render thread
+	void Run();
+	// draw a single snapshot into the back buffer
+	void RenderFrame(const SCENE_SNAPSHOT& snapshot);
+	// create the frame capture for a framebuffer size
+	void CreateFrameCapture(int width, int height);
+
+	// window whose GL context the thread owns
+	GLFWwindow* m_pWindow;
+	// pointer to view manager object
+	ViewManager* m_pViewManager;
+	// pointer to scene manager object
+	SceneManager* m_pSceneManager;
+	// pointer to frame scheduler object (may be NULL)
+	FrameScheduler* m_pFrameScheduler;
+	// dynamic resolution settings and the object created from them
+	// on the render thread (NULL when disabled)
+	DYNAMIC_RESOLUTION_SETTINGS m_dynamicResolutionSettings;
+	DynamicResolution* m_pDynamicResolution;
+	// frame capture settings and the object created from them on
+	// the render thread (NULL until recording or a screenshot)
+	FRAME_CAPTURE_SETTINGS m_frameCaptureSettings;
+	FrameCapture* m_pFrameCapture;
+	std::atomic<bool> m_bScreenshotRequested;
+	// per-frame timings for benchmark playback (may be NULL)
+	std::atomic<FrameStatistics*> m_pFrameStatistics;
+
+	// snapshots published by the simulation thread
+	SnapshotBuffer m_snapshots;
+	// the render thread itself
+	std::thread m_thread;
+	// true while the render thread is running
+	bool m_bRunning;
+	// number of frames drawn so far
+	std::atomic<unsigned long long> m_framesRendered;
+	// count the heap allocations of each frame
+	bool m_bAllocationCheck;
+};
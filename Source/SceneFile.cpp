@@ -0,0 +1,226 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.cpp
+// ============
+// read the text scene description: textures, materials, lights and the
+// layout of the scene objects
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneFile.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+/***********************************************************
+ *  GetString()
+ *
+ *  This method returns a value as it was written.
+ ***********************************************************/
+std::string SCENE_RECORD::GetString(const char* key, const char* defaultValue) const
+{
+	std::map<std::string, std::string>::const_iterator found = values.find(key);
+	if ((found == values.end()) || found->second.empty())
+	{
+		return(defaultValue);
+	}
+	return(found->second);
+}
+
+/***********************************************************
+ *  GetFloat()
+ *
+ *  This method returns a single number value.
+ ***********************************************************/
+float SCENE_RECORD::GetFloat(const char* key, float defaultValue) const
+{
+	float value = defaultValue;
+	GetFloats(key, &value, 1);
+	return(value);
+}
+
+/***********************************************************
+ *  GetVec2()
+ *
+ *  This method returns a value of two numbers.
+ ***********************************************************/
+glm::vec2 SCENE_RECORD::GetVec2(const char* key, glm::vec2 defaultValue) const
+{
+	float value[2] = { defaultValue.x, defaultValue.y };
+	GetFloats(key, value, 2);
+	return(glm::vec2(value[0], value[1]));
+}
+
+/***********************************************************
+ *  GetVec3()
+ *
+ *  This method returns a value of three numbers.
+ ***********************************************************/
+glm::vec3 SCENE_RECORD::GetVec3(const char* key, glm::vec3 defaultValue) const
+{
+	float value[3] = { defaultValue.x, defaultValue.y, defaultValue.z };
+	GetFloats(key, value, 3);
+	return(glm::vec3(value[0], value[1], value[2]));
+}
+
+/***********************************************************
+ *  HasFlag()
+ *
+ *  This method checks for a key, with or without a value.
+ ***********************************************************/
+bool SCENE_RECORD::HasFlag(const char* key) const
+{
+	return(values.find(key) != values.end());
+}
+
+/***********************************************************
+ *  GetFloats()
+ *
+ *  This method parses a comma separated list of exactly
+ *  count numbers.  The output is only written if the whole
+ *  value is valid.
+ ***********************************************************/
+bool SCENE_RECORD::GetFloats(const char* key, float* output, int count) const
+{
+	std::map<std::string, std::string>::const_iterator found = values.find(key);
+	if (found == values.end())
+	{
+		return(false);
+	}
+
+	float parsed[4];
+	const char* text = found->second.c_str();
+	for (int i = 0; i < count; i++)
+	{
+		char* end = NULL;
+		parsed[i] = (float)strtod(text, &end);
+		bool bSeparatorOK = (i + 1 < count) ? (*end == ',') : (*end == '\0');
+		if ((end == text) || !bSeparatorOK)
+		{
+			std::cout << "Scene file line " << line << ": " << key << " needs " << count
+				<< " number(s), got \"" << found->second << "\"" << std::endl;
+			return(false);
+		}
+		text = end + 1;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		output[i] = parsed[i];
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  Read()
+ *
+ *  This method splits a scene file into records, one per
+ *  non-empty line.
+ ***********************************************************/
+bool SceneFile::Read(const char* filename, std::vector<SCENE_RECORD>& records)
+{
+	records.clear();
+
+	std::ifstream file(filename);
+	if (!file)
+	{
+		std::cout << "Could not open scene file:" << filename << std::endl;
+		return(false);
+	}
+
+	std::string text;
+	int lineNumber = 0;
+	while (std::getline(file, text))
+	{
+		lineNumber++;
+
+		// split the line into words, keeping quoted words whole
+		std::vector<std::string> words;
+		std::vector<bool> bQuoted;
+		size_t i = 0;
+		while (i < text.size())
+		{
+			char c = text[i];
+			if ((c == ' ') || (c == '\t') || (c == '\r'))
+			{
+				i++;
+			}
+			else if (c == '#')
+			{
+				break;
+			}
+			else if (c == '"')
+			{
+				size_t close = text.find('"', i + 1);
+				if (close == std::string::npos)
+				{
+					std::cout << "Scene file " << filename << " line " << lineNumber << ": missing closing quote" << std::endl;
+					records.clear();
+					return(false);
+				}
+				words.push_back(text.substr(i + 1, close - i - 1));
+				bQuoted.push_back(true);
+				i = close + 1;
+			}
+			else
+			{
+				size_t end = text.find_first_of(" \t\r#\"", i);
+				if (end == std::string::npos)
+				{
+					end = text.size();
+				}
+				else if ((text[end] == '"') && (end > i) && (text[end - 1] == '='))
+				{
+					// quoted value - key="value with spaces"
+					size_t close = text.find('"', end + 1);
+					if (close == std::string::npos)
+					{
+						std::cout << "Scene file " << filename << " line " << lineNumber << ": missing closing quote" << std::endl;
+						records.clear();
+						return(false);
+					}
+					words.push_back(text.substr(i, end - i) + text.substr(end + 1, close - end - 1));
+					bQuoted.push_back(false);
+					i = close + 1;
+					continue;
+				}
+				words.push_back(text.substr(i, end - i));
+				bQuoted.push_back(false);
+				i = end;
+			}
+		}
+
+		if (words.empty())
+		{
+			continue;
+		}
+
+		SCENE_RECORD record;
+		record.type = words[0];
+		record.line = lineNumber;
+		size_t first = 1;
+		if ((words.size() > 1) && bQuoted[1])
+		{
+			record.name = words[1];
+			first = 2;
+		}
+
+		for (size_t w = first; w < words.size(); w++)
+		{
+			size_t equals = words[w].find('=');
+			if (bQuoted[w] || (equals == 0))
+			{
+				std::cout << "Scene file " << filename << " line " << lineNumber << ": unexpected \"" << words[w] << "\"" << std::endl;
+				records.clear();
+				return(false);
+			}
+			if (equals == std::string::npos)
+				record.values[words[w]] = "";
+			else
+				record.values[words[w].substr(0, equals)] = words[w].substr(equals + 1);
+		}
+
+		records.push_back(record);
+	}
+
+	return(true);
+}
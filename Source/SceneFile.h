@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.h
+// ============
+// read the text scene description: textures, materials, lights and the
+// layout of the scene objects
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  SCENE_RECORD
+ *
+ *  One line of a scene file:
+ *
+ *    type "name" key=value key=x,y,z flag ...
+ *
+ *  The name is optional and may be quoted to hold spaces.
+ *  Values are a single word, a quoted string or a comma
+ *  separated list of numbers; a key without a value is a
+ *  flag.  Everything
+ *  after a '#' is a comment.
+ ***********************************************************/
+struct SCENE_RECORD
+{
+	std::string type;
+	std::string name;
+	// line number in the file, for messages
+	int line;
+	std::map<std::string, std::string> values;
+
+	// value accessors - missing or malformed values give the
+	// default and, when malformed, print a message
+	std::string GetString(const char* key, const char* defaultValue) const;
+	float GetFloat(const char* key, float defaultValue) const;
+	glm::vec2 GetVec2(const char* key, glm::vec2 defaultValue) const;
+	glm::vec3 GetVec3(const char* key, glm::vec3 defaultValue) const;
+	bool HasFlag(const char* key) const;
+
+private:
+	bool GetFloats(const char* key, float* values, int count) const;
+};
+
+/***********************************************************
+ *  SceneFile
+ *
+ *  Splits a scene file into records.  What the record types
+ *  and keys mean is up to the scene manager.
+ ***********************************************************/
+class SceneFile
+{
+public:
+	// read all records of a file; false if it cannot be read
+	// or has a syntax error, in which case records is empty
+	static bool Read(const char* filename, std::vector<SCENE_RECORD>& records);
+};
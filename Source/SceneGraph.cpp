@@ -0,0 +1,161 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenegraph.cpp
+// ============
+// hierarchy of parent-relative transforms, updated incrementally
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneGraph.h"
+
+#include <iostream>
+
+/***********************************************************
+ *  SceneGraph()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneGraph::SceneGraph()
+{
+}
+
+/***********************************************************
+ *  AddNode()
+ *
+ *  This method adds a node at the end of its parent's
+ *  subtree.  Nodes added in building order (a parent, then
+ *  its children) are simply appended; anything else shifts
+ *  the later slots by one, which only happens while a scene
+ *  is built.
+ ***********************************************************/
+int SceneGraph::AddNode(int parent, const glm::mat4& localTransform)
+{
+	if ((parent < -1) || (parent >= (int)m_nodeSlots.size()))
+	{
+		std::cout << "Scene graph: no parent node " << parent << std::endl;
+		return(-1);
+	}
+
+	int parentSlot = (parent < 0) ? -1 : m_nodeSlots[parent];
+	int slot = (parentSlot < 0) ? (int)m_slotNodes.size() : m_subtreeEnds[parentSlot];
+	int node = (int)m_nodeSlots.size();
+
+	// move the later slots up by one
+	for (size_t s = slot; s < m_slotNodes.size(); s++)
+	{
+		m_subtreeEnds[s]++;
+		if (m_parentSlots[s] >= slot)
+			m_parentSlots[s]++;
+		m_nodeSlots[m_slotNodes[s]]++;
+	}
+	// the ancestors' subtrees now end one slot later
+	for (int s = parentSlot; s >= 0; s = m_parentSlots[s])
+	{
+		m_subtreeEnds[s]++;
+	}
+
+	m_parentSlots.insert(m_parentSlots.begin() + slot, parentSlot);
+	m_subtreeEnds.insert(m_subtreeEnds.begin() + slot, slot + 1);
+	m_localTransforms.insert(m_localTransforms.begin() + slot, localTransform);
+	m_worldTransforms.insert(m_worldTransforms.begin() + slot, localTransform);
+	m_flags.insert(m_flags.begin() + slot, (unsigned char)0);
+	m_slotNodes.insert(m_slotNodes.begin() + slot, node);
+	m_nodeSlots.push_back(slot);
+
+	MarkDirty(slot);
+	return(node);
+}
+
+/***********************************************************
+ *  SetLocalTransform()
+ *
+ *  This method changes the transform of a node relative to
+ *  its parent.  The world transforms of the node and its
+ *  descendants follow on the next update.
+ ***********************************************************/
+void SceneGraph::SetLocalTransform(int node, const glm::mat4& localTransform)
+{
+	int slot = m_nodeSlots[node];
+	m_localTransforms[slot] = localTransform;
+	MarkDirty(slot);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method removes all nodes.
+ ***********************************************************/
+void SceneGraph::Clear()
+{
+	m_parentSlots.clear();
+	m_subtreeEnds.clear();
+	m_localTransforms.clear();
+	m_worldTransforms.clear();
+	m_flags.clear();
+	m_slotNodes.clear();
+	m_nodeSlots.clear();
+}
+
+/***********************************************************
+ *  UpdateWorldTransforms()
+ *
+ *  This method brings the world transforms up to date in
+ *  one forward pass.  A slot without a dirty descendant is
+ *  skipped with its whole subtree; a dirty slot has its
+ *  subtree recomputed front to back, which always finds the
+ *  parent's world transform already updated.
+ ***********************************************************/
+int SceneGraph::UpdateWorldTransforms(std::vector<int>* pUpdatedNodes)
+{
+	int updated = 0;
+	int slotCount = (int)m_slotNodes.size();
+	int slot = 0;
+	while (slot < slotCount)
+	{
+		if ((m_flags[slot] & SUBTREE_DIRTY) == 0)
+		{
+			slot = m_subtreeEnds[slot];
+		}
+		else if ((m_flags[slot] & NODE_DIRTY) == 0)
+		{
+			// something below is dirty - look at the children
+			m_flags[slot] = 0;
+			slot++;
+		}
+		else
+		{
+			int end = m_subtreeEnds[slot];
+			for (int s = slot; s < end; s++)
+			{
+				int parentSlot = m_parentSlots[s];
+				if (parentSlot < 0)
+					m_worldTransforms[s] = m_localTransforms[s];
+				else
+					m_worldTransforms[s] = m_worldTransforms[parentSlot] * m_localTransforms[s];
+				m_flags[s] = 0;
+
+				if (NULL != pUpdatedNodes)
+					pUpdatedNodes->push_back(m_slotNodes[s]);
+			}
+			updated += end - slot;
+			slot = end;
+		}
+	}
+
+	return(updated);
+}
+
+/***********************************************************
+ *  MarkDirty()
+ *
+ *  This method flags a slot for recomputing and marks the
+ *  path to it from its root, stopping at the first ancestor
+ *  that is already marked - everything above that one is
+ *  marked as well.
+ ***********************************************************/
+void SceneGraph::MarkDirty(int slot)
+{
+	m_flags[slot] |= NODE_DIRTY | SUBTREE_DIRTY;
+	for (int s = m_parentSlots[slot]; (s >= 0) && ((m_flags[s] & SUBTREE_DIRTY) == 0); s = m_parentSlots[s])
+	{
+		m_flags[s] |= SUBTREE_DIRTY;
+	}
+}
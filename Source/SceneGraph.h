@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenegraph.h
+// ============
+// hierarchy of parent-relative transforms, updated incrementally
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  SceneGraph
+ *
+ *  Each node has a transform relative to its parent; the
+ *  world transform is the parent's world transform times
+ *  the local one.  Nodes are kept in flat arrays in depth
+ *  first order, so every subtree is one contiguous range and
+ *  a parent always comes before its children.
+ *
+ *  Changing a local transform only flags the node, and its
+ *  ancestors as having a dirty descendant.  The update is a
+ *  single forward pass over the arrays that jumps over clean
+ *  subtrees and recomputes each dirty subtree in order, so
+ *  moving a parent costs one flag however many children it
+ *  has.
+ *
+ *  Node handles stay valid while nodes are added; the
+ *  position of a node in the arrays is looked up from its
+ *  handle.
+ ***********************************************************/
+class SceneGraph
+{
+public:
+	// constructor
+	SceneGraph();
+
+	// add a node under a parent (-1 = root); returns its handle
+	int AddNode(int parent, const glm::mat4& localTransform);
+	// change the transform of a node relative to its parent
+	void SetLocalTransform(int node, const glm::mat4& localTransform);
+	// remove all nodes
+	void Clear();
+
+	// recompute the world transforms of the dirty nodes and their
+	// descendants; returns how many were recomputed and, if given
+	// a list, appends their handles to it
+	int UpdateWorldTransforms(std::vector<int>* pUpdatedNodes);
+
+	const glm::mat4& GetLocalTransform(int node) const { return m_localTransforms[m_nodeSlots[node]]; }
+	// world transform as of the last update
+	const glm::mat4& GetWorldTransform(int node) const { return m_worldTransforms[m_nodeSlots[node]]; }
+	int GetNodeCount() const { return (int)m_nodeSlots.size(); }
+
+private:
+	// flags of a slot
+	enum
+	{
+		NODE_DIRTY = 1,
+		SUBTREE_DIRTY = 2
+	};
+
+	// flag a slot dirty and its ancestors as having a dirty descendant
+	void MarkDirty(int slot);
+
+	// per slot, in depth first order
+	std::vector<int> m_parentSlots;
+	// slot after the last descendant of the slot
+	std::vector<int> m_subtreeEnds;
+	std::vector<glm::mat4> m_localTransforms;
+	std::vector<glm::mat4> m_worldTransforms;
+	std::vector<unsigned char> m_flags;
+	std::vector<int> m_slotNodes;
+
+	// per node handle, its current slot
+	std::vector<int> m_nodeSlots;
+};
@@ -8,6 +8,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
+#include "SoftwareRasterizer.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -16,14 +17,127 @@
 
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+
 // declaration of global variables
 namespace
 {
-	const char* g_ModelName = "model";
-	const char* g_ColorValueName = "objectColor";
-	const char* g_TextureValueName = "objectTexture";
-	const char* g_UseTextureName = "bUseTexture";
-	const char* g_UseLightingName = "bUseLighting";
+	// uniform names are built once, so setting a uniform never
+	// makes a temporary string on the heap
+	const std::string g_ModelName = "model";
+	const std::string g_ColorValueName = "objectColor";
+	const std::string g_TextureValueName = "objectTexture";
+	const std::string g_UseTextureName = "bUseTexture";
+	const std::string g_UVScaleName = "UVscale";
+	const std::string g_MaterialAmbientColorName = "material.ambientColor";
+	const std::string g_MaterialAmbientStrengthName = "material.ambientStrength";
+	const std::string g_MaterialDiffuseColorName = "material.diffuseColor";
+	const std::string g_MaterialSpecularColorName = "material.specularColor";
+	const std::string g_MaterialShininessName = "material.shininess";
+
+	// directory of the on-disk cache of generated meshes
+	const char* g_MeshCacheDirectory = "MeshCache";
+
+	// edge length of the spatial grid cells, about the size of
+	// a hedge wall so each wall only covers a few cells
+	const float g_SpatialCellSize = 4.0f;
+
+	// shaders of the multi-draw indirect path
+	const char* g_IndirectVertexShader = "Shaders/indirectVertexShader.glsl";
+	const char* g_IndirectFragmentShader = "Shaders/indirectFragmentShader.glsl";
+	// depth-only pre-pass of the indirect path
+	const char* g_DepthPrepassVertexShader = "Shaders/depthPrepassVertexShader.glsl";
+	const char* g_DepthPrepassFragmentShader = "Shaders/depthPrepassFragmentShader.glsl";
+	// compute shaders of the indirect path's GPU culling
+	const char* g_GPUCullingComputeShader = "Shaders/gpuCullingComputeShader.glsl";
+	const char* g_DepthPyramidComputeShader = "Shaders/depthPyramidComputeShader.glsl";
+	// feedback pass of the virtual texture
+	const char* g_FeedbackVertexShader = "Shaders/virtualTextureFeedbackVertexShader.glsl";
+	const char* g_FeedbackFragmentShader = "Shaders/virtualTextureFeedbackFragmentShader.glsl";
+	// the terrain's own vertex shader; it shares the fragment
+	// shaders above
+	const char* g_TerrainVertexShader = "Shaders/terrainVertexShader.glsl";
+	// impostors of the distant topiaries
+	const char* g_ImpostorVertexShader = "Shaders/impostorVertexShader.glsl";
+	const char* g_ImpostorFragmentShader = "Shaders/impostorFragmentShader.glsl";
+	// directory of the on-disk cache of baked impostor atlases
+	const char* g_ImpostorCacheDirectory = "ImpostorCache";
+	// lightmap of the garden, written by --bake-lightmaps
+	const char* g_LightmapFile = "Lightmaps/garden.lmap";
+
+	// texture, material and texture tiling of the topiary bushes,
+	// which use the ground's tiling
+	const char* g_TopiaryTexture = "Leaves1";
+	const char* g_TopiaryMaterial = "Foliage";
+	const glm::vec2 g_TopiaryUVScale = glm::vec2(20.0f, 20.0f);
+	// directory of the on-disk cache of linked shader programs
+	const char* g_ShaderCacheDirectory = "ShaderCache";
+
+	// textures, materials, lights and layout of the scene
+	const char* g_SceneFile = "Scene/garden.scene";
+	// reloads slower than this are pointed out in the report
+	const double g_ReloadTargetMilliseconds = 50.0;
+
+	// frame arena of the render thread - the visible list, its
+	// sort keys and the indirect commands of a few thousand
+	// objects fit, with the terrain's node instances and the
+	// impostors
+	const size_t g_FrameArenaSize = 640 * 1024;
+
+	/***********************************************************
+	 *  MaterialsEqual() / LightsEqual() / ShapesEqual() /
+	 *  ObjectsEqual()
+	 *
+	 *  Field by field comparisons, to tell which entries a
+	 *  reload changed.
+	 ***********************************************************/
+	bool MaterialsEqual(const SceneManager::OBJECT_MATERIAL& a, const SceneManager::OBJECT_MATERIAL& b)
+	{
+		return((a.tag == b.tag) && (a.ambientStrength == b.ambientStrength) && (a.ambientColor == b.ambientColor) &&
+			(a.diffuseColor == b.diffuseColor) && (a.specularColor == b.specularColor) && (a.shininess == b.shininess) &&
+			(a.blendMode == b.blendMode) && (a.opacity == b.opacity) && (a.alphaCutoff == b.alphaCutoff));
+	}
+
+	bool LightsEqual(const SceneManager::LIGHT_SOURCE& a, const SceneManager::LIGHT_SOURCE& b)
+	{
+		return((a.position == b.position) && (a.ambientColor == b.ambientColor) && (a.diffuseColor == b.diffuseColor) &&
+			(a.specularColor == b.specularColor) && (a.focalStrength == b.focalStrength) &&
+			(a.specularIntensity == b.specularIntensity) && (a.bDirectional == b.bDirectional));
+	}
+
+	bool ShapesEqual(const TERRAIN_SHAPE& a, const TERRAIN_SHAPE& b)
+	{
+		return((a.center == b.center) && (a.size == b.size) && (a.hillHeight == b.hillHeight) &&
+			(a.hillSize == b.hillSize) && (a.flatSize == b.flatSize));
+	}
+
+	bool ObjectsEqual(const SceneManager::SCENE_OBJECT& a, const SceneManager::SCENE_OBJECT& b)
+	{
+		return((a.name == b.name) && (a.mesh == b.mesh) && (a.model == b.model) && (a.textureTag == b.textureTag) &&
+			(a.materialTag == b.materialTag) && (a.uvScale == b.uvScale) && (a.virtualTexture == b.virtualTexture) &&
+			(a.bPerspectiveOnly == b.bPerspectiveOnly));
+	}
+
+	/***********************************************************
+	 *  CountChanges()
+	 *
+	 *  Number of entries that differ between two lists,
+	 *  counting added and removed entries.
+	 ***********************************************************/
+	template <typename T>
+	size_t CountChanges(const std::vector<T>& before, const std::vector<T>& after, bool (*equal)(const T&, const T&))
+	{
+		size_t common = std::min(before.size(), after.size());
+		size_t changed = std::max(before.size(), after.size()) - common;
+		for (size_t i = 0; i < common; i++)
+		{
+			if (!equal(before[i], after[i]))
+				changed++;
+		}
+		return(changed);
+	}
 }
 
 /***********************************************************
@@ -31,10 +145,40 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager *pShaderManager)
+SceneManager::SceneManager(ShaderManager *pShaderManager, RenderBackend* pBackend)
 {
 	m_pShaderManager = pShaderManager;
-	m_basicMeshes = new ShapeMeshes();
+	m_pMeshLibrary = new MeshLibrary(g_MeshCacheDirectory);
+	m_pGLBackend = NULL;
+	m_pBackend = pBackend;
+	if (NULL == m_pBackend)
+	{
+		m_pGLBackend = new GLRenderBackend(pShaderManager, m_pMeshLibrary);
+		m_pBackend = m_pGLBackend;
+	}
+	m_pCapture = NULL;
+	m_pSceneGraph = new SceneGraph();
+	m_pEntities = new EntityStore();
+	m_pFrameArena = new FrameArena(g_FrameArenaSize);
+	m_pSpatialGrid = new SpatialGrid(g_SpatialCellSize);
+	m_pIndirectRenderer = NULL;
+	m_bMultiDrawEnabled = true;
+	m_depthPrepassSettings = DepthPrepass::DefaultSettings();
+	m_gpuCullingSettings = GPUCulling::DefaultSettings();
+	m_pVirtualTexture = NULL;
+	m_virtualTextureSettings = VirtualTexture::DefaultSettings();
+	m_pTerrain = NULL;
+	m_terrainObject = -1;
+	m_terrainShape = TERRAIN_SHAPE();
+	m_pImpostors = NULL;
+	m_impostorSettings = ImpostorRenderer::DefaultSettings();
+	m_pLightmap = NULL;
+	m_pFileWatcher = NULL;
+	m_bStreaming = false;
+	m_bReloadPending = false;
+	m_bSceneFileChanged = false;
+	m_bShadersChanged = false;
+	m_bSpatialRebuildPending = false;
 
 	// initialize the texture collection
 	for (int i = 0; i < 16; i++)
@@ -53,24 +197,49 @@ SceneManager::SceneManager(ShaderManager *pShaderManager)
 SceneManager::~SceneManager()
 {
 	m_pShaderManager = NULL;
-	delete m_basicMeshes;
-	m_basicMeshes = NULL;
+	delete m_pFileWatcher;
+	m_pFileWatcher = NULL;
+	delete m_pImpostors;
+	m_pImpostors = NULL;
+	delete m_pLightmap;
+	m_pLightmap = NULL;
+	delete m_pTerrain;
+	m_pTerrain = NULL;
+	delete m_pVirtualTexture;
+	m_pVirtualTexture = NULL;
+	delete m_pIndirectRenderer;
+	m_pIndirectRenderer = NULL;
+	delete m_pCapture;
+	m_pCapture = NULL;
+	delete m_pGLBackend;
+	m_pGLBackend = NULL;
+	m_pBackend = NULL;
+	delete m_pMeshLibrary;
+	m_pMeshLibrary = NULL;
+	delete m_pSpatialGrid;
+	m_pSpatialGrid = NULL;
+	delete m_pSceneGraph;
+	m_pSceneGraph = NULL;
+	delete m_pEntities;
+	m_pEntities = NULL;
+	delete m_pFrameArena;
+	m_pFrameArena = NULL;
 }
 
 /***********************************************************
- *  CreateGLTexture()
+ *  CreateTexture()
  *
  *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  handing the image to the render backend - which sets up
+ *  the texture mapping and generates the mipmaps - and
+ *  loading the read texture into the next available texture
+ *  slot in memory.
  ***********************************************************/
-bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
+bool SceneManager::CreateTexture(const char* filename, std::string tag)
 {
 	int width = 0;
 	int height = 0;
 	int colorChannels = 0;
-	GLuint textureID = 0;
 
 	// indicate to always flip images vertically when loaded
 	stbi_set_flip_vertically_on_load(true);
@@ -88,41 +257,19 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 	{
 		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
 
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// Set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// Set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// Fix to ensure that OpenGL does not assume 4-byte alignment (images whose row size is not multiple of 4)
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
-		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
-		}
-
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
+		unsigned int textureID = m_pBackend->CreateTexture(image, width, height, colorChannels);
 
 		// free the image data from local memory
 		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+		if (textureID == 0)
+		{
+			return false;
+		}
 
 		// register the loaded texture and associate it with the special tag string
 		m_textureIDs[m_loadedTextures].ID = textureID;
 		m_textureIDs[m_loadedTextures].tag = tag;
+		m_textureIDs[m_loadedTextures].filename = filename;
 		m_loadedTextures++;
 
 		return true;
@@ -135,32 +282,56 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 }
 
 /***********************************************************
- *  BindGLTextures()
+ *  ReplaceTexture()
+ *
+ *  This method loads a new image for a texture slot that is
+ *  in use.  The old texture is kept if the image cannot be
+ *  loaded, so objects never lose their texture on a typo.
+ ***********************************************************/
+bool SceneManager::ReplaceTexture(int slot, const char* filename)
+{
+	if ((m_loadedTextures >= 16) || !CreateTexture(filename, m_textureIDs[slot].tag))
+	{
+		return(false);
+	}
+
+	// the new texture was appended - move it into the slot
+	m_loadedTextures--;
+	m_pBackend->DestroyTexture(m_textureIDs[slot].ID);
+	m_textureIDs[slot].ID = m_textureIDs[m_loadedTextures].ID;
+	m_textureIDs[slot].filename = m_textureIDs[m_loadedTextures].filename;
+	m_textureIDs[m_loadedTextures].tag = "/0";
+	m_textureIDs[m_loadedTextures].ID = -1;
+	m_textureIDs[m_loadedTextures].filename.clear();
+	return(true);
+}
+
+/***********************************************************
+ *  BindTextures()
  *
  *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  texture memory slots.  There are up to 16 slots.
  ***********************************************************/
-void SceneManager::BindGLTextures()
+void SceneManager::BindTextures()
 {
 	for (int i = 0; i < m_loadedTextures; i++)
 	{
 		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		m_pBackend->BindTexture(i, m_textureIDs[i].ID);
 	}
 }
 
 /***********************************************************
- *  DestroyGLTextures()
+ *  DestroyTextures()
  *
  *  This method is used for freeing the memory in all the
  *  used texture memory slots.
  ***********************************************************/
-void SceneManager::DestroyGLTextures()
+void SceneManager::DestroyTextures()
 {
 	for (int i = 0; i < m_loadedTextures; i++)
 	{
-		glGenTextures(1, &m_textureIDs[i].ID);
+		m_pBackend->DestroyTexture(m_textureIDs[i].ID);
 	}
 }
 
@@ -170,7 +341,7 @@ void SceneManager::DestroyGLTextures()
  *  This method is used for getting an ID for the previously
  *  loaded texture bitmap associated with the passed in tag.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+int SceneManager::FindTextureID(const std::string& tag)
 {
 	int textureID = -1;
 	int index = 0;
@@ -196,7 +367,7 @@ int SceneManager::FindTextureID(std::string tag)
  *  This method is used for getting a slot index for the previously
  *  loaded texture bitmap associated with the passed in tag.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+int SceneManager::FindTextureSlot(const std::string& tag)
 {
 	int textureSlot = -1;
 	int index = 0;
@@ -222,7 +393,7 @@ int SceneManager::FindTextureSlot(std::string tag)
  *  This method is used for getting a material from the previously
  *  defined materials list that is associated with the passed in tag.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+bool SceneManager::FindMaterial(const std::string& tag, OBJECT_MATERIAL& material)
 {
 	if (m_objectMaterials.size() == 0)
 	{
@@ -241,6 +412,9 @@ bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
 			material.diffuseColor = m_objectMaterials[index].diffuseColor;
 			material.specularColor = m_objectMaterials[index].specularColor;
 			material.shininess = m_objectMaterials[index].shininess;
+			material.blendMode = m_objectMaterials[index].blendMode;
+			material.opacity = m_objectMaterials[index].opacity;
+			material.alphaCutoff = m_objectMaterials[index].alphaCutoff;
 		}
 		else
 		{
@@ -252,12 +426,30 @@ bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  FindMaterialIndex()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for getting the index of a defined
+ *  material in the materials list, -1 if there is none.
  ***********************************************************/
-void SceneManager::SetTransformations(
+int SceneManager::FindMaterialIndex(const std::string& tag)
+{
+	for (size_t i = 0; i < m_objectMaterials.size(); i++)
+	{
+		if (m_objectMaterials[i].tag == tag)
+		{
+			return((int)i);
+		}
+	}
+	return(-1);
+}
+
+/***********************************************************
+ *  BuildModelMatrix()
+ *
+ *  This method is used for building the model matrix from
+ *  the passed in transformation values.
+ ***********************************************************/
+glm::mat4 SceneManager::BuildModelMatrix(
 	glm::vec3 scaleXYZ,
 	float XrotationDegrees,
 	float YrotationDegrees,
@@ -283,6 +475,29 @@ void SceneManager::SetTransformations(
 
 	modelView = translation * rotationX * rotationY * rotationZ * scale;
 
+	return(modelView);
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting the transform buffer
+ *  using the passed in transformation values.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	glm::mat4 modelView = BuildModelMatrix(
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ);
+
 	if (NULL != m_pShaderManager)
 	{
 		m_pShaderManager->setMat4Value(g_ModelName, modelView);
@@ -323,15 +538,23 @@ void SceneManager::SetShaderColor(
  *  associated with the passed in ID into the shader.
  ***********************************************************/
 void SceneManager::SetShaderTexture(
-	std::string textureTag)
+	const std::string& textureTag)
+{
+	SetShaderTextureSlot(FindTextureSlot(textureTag));
+}
+
+/***********************************************************
+ *  SetShaderTextureSlot()
+ *
+ *  This method is used for setting the texture in a slot
+ *  found beforehand into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTextureSlot(int textureSlot)
 {
 	if (NULL != m_pShaderManager)
 	{
 		m_pShaderManager->setIntValue(g_UseTextureName, true);
-
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureSlot);
 	}
 }
 
@@ -345,7 +568,7 @@ void SceneManager::SetTextureUVScale(float u, float v)
 {
 	if (NULL != m_pShaderManager)
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		m_pShaderManager->setVec2Value(g_UVScaleName, glm::vec2(u, v));
 	}
 }
 
@@ -356,163 +579,244 @@ void SceneManager::SetTextureUVScale(float u, float v)
  *  into the shader.
  ***********************************************************/
 void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+	const std::string& materialTag)
+{
+	SetShaderMaterial(FindMaterialIndex(materialTag));
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for passing the values of a material
+ *  found beforehand into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(int materialIndex)
 {
-	if (m_objectMaterials.size() > 0)
+	if ((materialIndex < 0) || (materialIndex >= (int)m_objectMaterials.size()))
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+		return;
+	}
 
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
-		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-		}
+	const OBJECT_MATERIAL& material = m_objectMaterials[materialIndex];
+	m_pShaderManager->setVec3Value(g_MaterialAmbientColorName, material.ambientColor);
+	m_pShaderManager->setFloatValue(g_MaterialAmbientStrengthName, material.ambientStrength);
+	m_pShaderManager->setVec3Value(g_MaterialDiffuseColorName, material.diffuseColor);
+	m_pShaderManager->setVec3Value(g_MaterialSpecularColorName, material.specularColor);
+	m_pShaderManager->setFloatValue(g_MaterialShininessName, material.shininess);
+}
+
+/***********************************************************
+ *  LoadSceneFile()
+ *
+ *  This method reads the scene file.  On a read or syntax
+ *  error the records of the previous read are kept.
+ ***********************************************************/
+bool SceneManager::LoadSceneFile()
+{
+	std::vector<SCENE_RECORD> records;
+	if (!SceneFile::Read(g_SceneFile, records))
+	{
+		return(false);
 	}
+
+	m_sceneRecords.swap(records);
+	return(true);
 }
 
  /***********************************************************
   *  LoadSceneTextures()
   *
-  *  This method is used for preparing the 3D scene by loading
-  *  the shapes, textures in memory to support the 3D scene
-  *  rendering
+  *  This method loads the images of the texture records of
+  *  the scene file into texture slots.  Textures that are
+  *  already loaded from the same file are left alone, so a
+  *  reload only decodes the images that were changed.
   ***********************************************************/
 void SceneManager::LoadSceneTextures()
 {
-	//std::cout << "LoadSceneTextures() called" << std::endl;
-	//CreateGLTexture("Textures/leaves1.jpg", "Leaves1");
-
-	bool bLoaded1 = CreateGLTexture("Textures/leaves1.jpg", "Leaves1");
-	if (!bLoaded1)
-	{
-		std::cout << "Failed to load Leaves1" << std::endl;
-		return;  // abort if texture failed to load
-	}
-
-	bool bLoaded2 = CreateGLTexture("Textures/leaves2.jpg", "Leaves2");
-	if (!bLoaded2)
+	for (size_t i = 0; i < m_sceneRecords.size(); i++)
 	{
-		std::cout << "Failed to load Leaves2" << std::endl;
-		return;  // abort if texture failed to load
-	}
+		const SCENE_RECORD& record = m_sceneRecords[i];
+		if (record.type != "texture")
+			continue;
+
+		std::string filename = record.GetString("file", "");
+		int slot = FindTextureSlot(record.name);
+		if ((slot >= 0) && (m_textureIDs[slot].filename == filename))
+			continue;
+
+		bool bLoaded = false;
+		if (slot >= 0)
+			bLoaded = ReplaceTexture(slot, filename.c_str());
+		else if (m_loadedTextures < 16)
+			bLoaded = CreateTexture(filename.c_str(), record.name);
+		else
+			std::cout << "No texture slot left for " << record.name << std::endl;
 
-	bool bLoaded3 = CreateGLTexture("Textures/gravel1.jpg", "Gravel1");
-	if (!bLoaded3)
-	{
-		std::cout << "Failed to load Gravel1" << std::endl;
-		return;  // abort if texture failed to load
+		if (!bLoaded)
+		{
+			std::cout << "Failed to load " << record.name << std::endl;
+		}
 	}
 
 	// after the texture image data is loaded into memory, the
 	// loaded textures need to be bound to texture slots - there
 	// are a total of 16 available slots for scene textures
-	BindGLTextures();
+	BindTextures();
 }
 
 /***********************************************************
  *  DefineObjectMaterials()
  *
  *  This method configures material properties for objects
- *  within the 3D scene. These determine how surfaces react
- *  to the lighting defined in SetupSceneLights().
+ *  within the 3D scene from the material records of the
+ *  scene file. These determine how surfaces react to the
+ *  lighting defined in SetupSceneLights().
  ***********************************************************/
 void SceneManager::DefineObjectMaterials()
 {
-	if (!m_pShaderManager)
-		return;
+	m_objectMaterials.clear();
+	std::vector<RENDER_MATERIAL> materials;
 
-	// Foliage material (default)
-	OBJECT_MATERIAL foliageMaterial;
-	foliageMaterial.tag = "Foliage";
-	foliageMaterial.ambientColor = glm::vec3(0.2f, 0.4f, 0.2f);
-	foliageMaterial.ambientStrength = 0.5f;
-	foliageMaterial.diffuseColor = glm::vec3(0.3f, 0.7f, 0.3f);
-	foliageMaterial.specularColor = glm::vec3(0.9f, 0.9f, 0.9f);
-	foliageMaterial.shininess = 16.0f;
-	m_objectMaterials.push_back(foliageMaterial);
+	for (size_t i = 0; i < m_sceneRecords.size(); i++)
+	{
+		const SCENE_RECORD& record = m_sceneRecords[i];
+		if (record.type != "material")
+			continue;
 
-	// Ground material
-	OBJECT_MATERIAL groundMaterial;
-	groundMaterial.tag = "Ground";
-	groundMaterial.ambientColor = glm::vec3(0.4f, 0.4f, 0.4f);
-	groundMaterial.ambientStrength = 0.4f;
-	groundMaterial.diffuseColor = glm::vec3(0.6f, 0.6f, 0.6f);
-	groundMaterial.specularColor = glm::vec3(0.8f, 0.8f, 0.8f);
-	groundMaterial.shininess = 8.0f;
-	m_objectMaterials.push_back(groundMaterial);
+		OBJECT_MATERIAL material;
+		material.tag = record.name;
+		material.ambientColor = record.GetVec3("ambient", glm::vec3(0.2f));
+		material.ambientStrength = record.GetFloat("ambient-strength", 0.5f);
+		material.diffuseColor = record.GetVec3("diffuse", glm::vec3(0.8f));
+		material.specularColor = record.GetVec3("specular", glm::vec3(0.5f));
+		material.shininess = record.GetFloat("shininess", 16.0f);
+		material.opacity = std::min(std::max(record.GetFloat("opacity", 1.0f), 0.0f), 1.0f);
+		material.alphaCutoff = record.GetFloat("alpha-cutoff", 0.5f);
+		std::string blend = record.GetString("blend", "opaque");
+		if (blend == "alpha-test")
+			material.blendMode = BLEND_ALPHA_TEST;
+		else if (blend == "transparent")
+			material.blendMode = BLEND_TRANSPARENT;
+		else
+		{
+			if (blend != "opaque")
+				std::cout << "Scene file line " << record.line << ": unknown blend mode \"" << blend << "\"" << std::endl;
+			material.blendMode = BLEND_OPAQUE;
+		}
+		m_objectMaterials.push_back(material);
+
+		RENDER_MATERIAL renderMaterial;
+		renderMaterial.ambientColor = material.ambientColor;
+		renderMaterial.ambientStrength = material.ambientStrength;
+		renderMaterial.diffuseColor = material.diffuseColor;
+		renderMaterial.specularColor = material.specularColor;
+		renderMaterial.shininess = material.shininess;
+		renderMaterial.blendMode = material.blendMode;
+		renderMaterial.opacity = material.opacity;
+		renderMaterial.alphaCutoff = material.alphaCutoff;
+		materials.push_back(renderMaterial);
+	}
+	m_pBackend->SetMaterials(materials);
 }
 
 /***********************************************************
  *  SetupSceneLights()
  *
- *  This method sets up up to two light sources for the scene.
- *  These lights are applied via the existing ShaderManager
- *  uniforms. The first is the primary light, the second is a
- *  softer fill light to reduce harsh shadows.
+ *  This method sets up the light sources for the scene from
+ *  the light records of the scene file: in the garden the
+ *  sun as the primary light, a softer fill light to reduce
+ *  harsh shadows and a warm bounce off the ground.  They are
+ *  applied via the render backend and, for the indirect
+ *  path, its light buffer.
  ***********************************************************/
 void SceneManager::SetupSceneLights()
 {
-	if (!m_pShaderManager)
-		return;
+	m_sceneLights.clear();
+
+	for (size_t i = 0; i < m_sceneRecords.size(); i++)
+	{
+		const SCENE_RECORD& record = m_sceneRecords[i];
+		if (record.type != "light")
+			continue;
+
+		// the "position" of a directional light is treated as
+		// a *direction vector* in the shader
+		bool bDirectional = record.HasFlag("directional");
+		glm::vec3 position = record.GetVec3("position", glm::vec3(0.0f, -1.0f, 0.0f));
+		if (bDirectional)
+		{
+			if (glm::length(position) <= 0.0f)
+			{
+				std::cout << "Scene file line " << record.line << ": light direction is zero" << std::endl;
+				continue;
+			}
+			position = glm::normalize(position);
+		}
+
+		AddSceneLight(position,
+			record.GetVec3("ambient", glm::vec3(0.0f)),
+			record.GetVec3("diffuse", glm::vec3(1.0f)),
+			record.GetVec3("specular", glm::vec3(1.0f)),
+			record.GetFloat("focal-strength", 16.0f),
+			record.GetFloat("specular-intensity", 0.5f),
+			bDirectional);
+	}
 
-	// Enable lighting in shaders
-	m_pShaderManager->setBoolValue("bUseLighting", true);
-
-	// ----------------------------
-	// Sunlight (directional, warm white)
-	// ----------------------------
-	// The "position" here is treated as a *direction vector* in the shader.
-	glm::vec3 sunDirection = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
-	glm::vec3 sunColor = glm::vec3(1.0f, 0.95f, 0.85f); // warm sunlight tone
-
-	m_pShaderManager->setVec3Value("lightSources[0].position", sunDirection);
-	m_pShaderManager->setVec3Value("lightSources[0].ambientColor", sunColor * 0.4f);
-	m_pShaderManager->setVec3Value("lightSources[0].diffuseColor", sunColor);
-	m_pShaderManager->setVec3Value("lightSources[0].specularColor", glm::vec3(1.0f));
-	m_pShaderManager->setFloatValue("lightSources[0].focalStrength", 32.0f);
-	m_pShaderManager->setFloatValue("lightSources[0].specularIntensity", 1.0f);
-	m_pShaderManager->setBoolValue("lightSources[0].isDirectional", true);
-
-	// ----------------------------
-	// Fill light (cool tint, point light)
-	// ----------------------------
-	glm::vec3 lightPos1 = glm::vec3(-8.0f, 6.0f, -8.0f);
-	glm::vec3 lightColor1 = glm::vec3(0.3f, 0.4f, 0.6f); // bluish tone
-
-	m_pShaderManager->setVec3Value("lightSources[1].position", lightPos1);
-	m_pShaderManager->setVec3Value("lightSources[1].ambientColor", lightColor1 * 0.15f);
-	m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", lightColor1 * 0.6f);
-	m_pShaderManager->setVec3Value("lightSources[1].specularColor", lightColor1 * 0.8f);
-	m_pShaderManager->setFloatValue("lightSources[1].focalStrength", 16.0f);
-	m_pShaderManager->setFloatValue("lightSources[1].specularIntensity", 0.5f);
-	m_pShaderManager->setBoolValue("lightSources[1].isDirectional", false);
-
-	// ----------------------------
-	// Ground bounce (soft warm fill)
-	// ----------------------------
-	glm::vec3 bouncePos = glm::vec3(0.0f, 2.0f, 0.0f);
-	glm::vec3 bounceColor = glm::vec3(0.8f, 0.7f, 0.6f);
-
-	m_pShaderManager->setVec3Value("lightSources[2].position", bouncePos);
-	m_pShaderManager->setVec3Value("lightSources[2].ambientColor", bounceColor * 0.05f);
-	m_pShaderManager->setVec3Value("lightSources[2].diffuseColor", bounceColor * 0.3f);
-	m_pShaderManager->setVec3Value("lightSources[2].specularColor", glm::vec3(0.4f));
-	m_pShaderManager->setFloatValue("lightSources[2].focalStrength", 8.0f);
-	m_pShaderManager->setFloatValue("lightSources[2].specularIntensity", 0.3f);
-	m_pShaderManager->setBoolValue("lightSources[2].isDirectional", false);
-
-	// ----------------------------
-	// Disable unused light slots if shader expects four
-	// ----------------------------
-	m_pShaderManager->setVec3Value("lightSources[3].ambientColor", glm::vec3(0.0f));
-	m_pShaderManager->setVec3Value("lightSources[3].diffuseColor", glm::vec3(0.0f));
+	std::vector<RENDER_LIGHT> renderLights;
+	for (size_t i = 0; i < m_sceneLights.size(); i++)
+	{
+		const LIGHT_SOURCE& light = m_sceneLights[i];
+		RENDER_LIGHT renderLight;
+		renderLight.position = light.position;
+		renderLight.ambientColor = light.ambientColor;
+		renderLight.diffuseColor = light.diffuseColor;
+		renderLight.specularColor = light.specularColor;
+		renderLight.focalStrength = light.focalStrength;
+		renderLight.specularIntensity = light.specularIntensity;
+		renderLight.bDirectional = light.bDirectional;
+		renderLights.push_back(renderLight);
+	}
+	m_pBackend->SetLights(renderLights);
+
+	// the indirect path builds its shader variants for
+	// exactly this many lights
+	if (NULL != m_pIndirectRenderer)
+	{
+		std::vector<GPU_LIGHT> lights;
+		for (size_t i = 0; i < m_sceneLights.size(); i++)
+		{
+			const LIGHT_SOURCE& light = m_sceneLights[i];
+			GPU_LIGHT gpuLight;
+			gpuLight.position = glm::vec4(light.position, light.bDirectional ? 1.0f : 0.0f);
+			gpuLight.ambient = glm::vec4(light.ambientColor, light.focalStrength);
+			gpuLight.diffuse = glm::vec4(light.diffuseColor, light.specularIntensity);
+			gpuLight.specular = glm::vec4(light.specularColor, 0.0f);
+			lights.push_back(gpuLight);
+		}
+		m_pIndirectRenderer->SetLights(lights);
+	}
 }
 
+/***********************************************************
+ *  AddSceneLight()
+ *
+ *  This method appends a light source to the scene lights.
+ *  For directional lights the position is the direction the
+ *  light shines in.
+ ***********************************************************/
+void SceneManager::AddSceneLight(glm::vec3 position, glm::vec3 ambientColor, glm::vec3 diffuseColor, glm::vec3 specularColor,
+	float focalStrength, float specularIntensity, bool bDirectional)
+{
+	LIGHT_SOURCE light;
+	light.position = position;
+	light.ambientColor = ambientColor;
+	light.diffuseColor = diffuseColor;
+	light.specularColor = specularColor;
+	light.focalStrength = focalStrength;
+	light.specularIntensity = specularIntensity;
+	light.bDirectional = bDirectional;
+	m_sceneLights.push_back(light);
+}
 
 /***********************************************************
  *  PrepareScene()
@@ -523,6 +827,18 @@ void SceneManager::SetupSceneLights()
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
+	// the indirect path needs its shaders before the lights
+	// are set up, and the lightmap before the meshes are
+	// uploaded
+	CreateIndirectRenderer();
+	CreateLightmap();
+
+	// everything but the meshes is described in the scene file
+	if (!LoadSceneFile())
+	{
+		std::cout << "The scene is empty until " << g_SceneFile << " can be read" << std::endl;
+	}
+
 	// load the textures for the 3D scene
 	LoadSceneTextures();
 	// Setup lights for the scene
@@ -533,248 +849,1626 @@ void SceneManager::PrepareScene()
 	// only one instance of a particular mesh needs to be
 	// loaded in memory no matter how many times it is drawn
 	// in the rendered 3D scene
-
-	m_basicMeshes->LoadPlaneMesh();
-	m_basicMeshes->LoadTaperedCylinderTreeTierMesh();
-	m_basicMeshes->LoadSphereMesh();
-	m_basicMeshes->LoadTorusMesh();
-	m_basicMeshes->LoadBoxMesh();
+	m_pBackend->LoadMeshes();
+	CreateDepthPrepass();
+	CreateGPUCulling();
+
+	// lay out the objects of the garden and index them - this
+	// runs on the main thread, so the grid is built right away
+	BuildSceneObjects();
+	CreateVirtualTexture();
+	UploadIndirectSceneData();
+	CreateTerrain();
+	CreateImpostors();
+	UploadCullingData();
+	QueueSpatialRebuild();
+	ApplySpatialRebuild();
 }
 
 /***********************************************************
- *  RenderScene()
+ *  CreateIndirectRenderer()
  *
- *  This method is used for rendering the 3D scene by 
- *  transforming and drawing the basic 3D shapes.
- * 
- *  This method orchestrates the layout of our entire garden 
- *  scene. It applies geometric transformations (scaling, 
- *  rotation, translation) to base meshes, assigns colours via 
- *  shaders, and calls helper methods to assemble compound 
- *  structures (hedges, bushes, decorative shapes). The scene 
- *  is rendered differently depending on whether an 
- *  orthographic or perspective view is selected.
- ***********************************************************/
-void SceneManager::RenderScene(bool bOrthographic)
-{
-	// Declare the variables used to scale, rotate, and position meshes
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
+ *  This method sets up the multi-draw indirect path when it
+ *  is enabled and the context supports it; otherwise the
+ *  scene is drawn object by object.  Other backends than
+ *  OpenGL always draw object by object.
+ ***********************************************************/
+void SceneManager::CreateIndirectRenderer()
+{
+	if (!m_bMultiDrawEnabled || (NULL == m_pGLBackend))
+	{
+		return;
+	}
+
+	if (!IndirectRenderer::IsSupported())
+	{
+		std::cout << "Multi-draw indirect needs OpenGL 4.6 (or 4.5 with ARB_shader_draw_parameters) - drawing object by object" << std::endl;
+		return;
+	}
 
-	/****************************************************************/
-
-
-	// ================================
-	// 1) Ground Plane (the party starts here)
-	// ================================
-	// Plane provides a base surface for the scene. It's skipped in 
-	// orthographic mode to test perspective changes.
+	m_pIndirectRenderer = new IndirectRenderer(m_pMeshLibrary);
+	if (!m_pIndirectRenderer->Initialize(g_IndirectVertexShader, g_IndirectFragmentShader, g_ShaderCacheDirectory))
+	{
+		delete m_pIndirectRenderer;
+		m_pIndirectRenderer = NULL;
+		std::cout << "Multi-draw indirect unavailable - drawing object by object" << std::endl;
+		return;
+	}
 
-	// Only draw plane if not orthographic
-	if (!bOrthographic) 
+	// the pre-pass draws from a position-only copy of the meshes
+	if (m_depthPrepassSettings.mode != DEPTH_PREPASS_OFF)
 	{
-		scaleXYZ = glm::vec3(60.0f, 1.0f, 30.0f);  // widen plane in X and Z, keep Y flat
-
-		// Set the XYZ rotation for the mesh
-		XrotationDegrees = 0.0f;
-		YrotationDegrees = 0.0f;
-		ZrotationDegrees = 0.0f;
-
-		// Set the XYZ position for the mesh
-		positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);  // keep plane centred
+		m_pMeshLibrary->SetPositionStreamEnabled(true);
+	}
+}
 
-		// Set the transformations into memory to be used on the drawn meshes
-		SetTransformations(
-			scaleXYZ,
-			XrotationDegrees,
-			YrotationDegrees,
-			ZrotationDegrees,
-			positionXYZ);
+/***********************************************************
+ *  CreateDepthPrepass()
+ *
+ *  This method gives the indirect path its depth pre-pass
+ *  when one is asked for.  It needs the position-only mesh
+ *  stream, so it runs after the meshes are uploaded.
+ ***********************************************************/
+void SceneManager::CreateDepthPrepass()
+{
+	if ((NULL == m_pIndirectRenderer) || (m_depthPrepassSettings.mode == DEPTH_PREPASS_OFF))
+	{
+		return;
+	}
 
-		// Plane: coloured surface only with lighting
-		m_pShaderManager->use();
-		SetShaderMaterial("Ground");
-		SetShaderTexture("Gravel1");
-		m_pShaderManager->setBoolValue("bUseLighting", true);
-		m_pShaderManager->setBoolValue("bUseTexture", true);
-
-		// Light grey shader colour ensures visibility when perspective is active
-		//SetShaderColor(0.7f, 0.7f, 0.7f, 1.0f);
-
-		float tileX = 20.0f;  // number of times texture repeats along X
-		float tileZ = 20.0f;  // number of times texture repeats along Z
-		m_pShaderManager->setVec2Value("UVscale", tileX, tileZ);
-
-		// Draw the mesh with transformation values
-		m_basicMeshes->DrawPlaneMesh();
-	}
-
-	/****************************************************************/
-
-
-	// ================================
-	// 2) Cylinders with sphere tips (topiary bushes)
-	// ================================
-	// Use helper function to draw decorative, bush-like structures.
-	DrawCylinderWithSphereTip(glm::vec3(0.0f, 0.0f, 3.0f),
-		7.0f,   // height
-		2.5f);  // radius
-
-	DrawCylinderWithSphereTip(glm::vec3(-12.0f, 0.0f, -2.0f),
-		6.0f,
-		2.0f);
-
-	/****************************************************************/
-
-
-	// ================================
-	// 3) Torus (ring hedge around base)
-	// ================================
-	// Torus mesh is scaled and rotated to act as a ring hedge surrounding the main bushes.
-	scaleXYZ = glm::vec3(5.0f, 5.0f, 5.0f);						   // large, flat ring
-	positionXYZ = glm::vec3(0.0f, 0.5f, 3.0f);					   // position at ground level
-	SetTransformations(scaleXYZ, 90.0f, 0.0f, 0.0f, positionXYZ);  // rotate so torus is horizontal
-
-	// Set texture and lighting
-	m_pShaderManager->use();
-	SetShaderMaterial("Foliage");
-	SetShaderTexture("Leaves2");
-	m_pShaderManager->setBoolValue("bUseLighting", true);
-	m_pShaderManager->setBoolValue("bUseTexture", true);
-
-	// Tone down the shininess
-	m_pShaderManager->setVec3Value("material.specularColor", glm::vec3(0.3f, 0.3f, 0.3f));
-	m_pShaderManager->setFloatValue("material.shininess", 8.0f);
+	if (m_pIndirectRenderer->EnableDepthPrepass(m_depthPrepassSettings,
+		g_DepthPrepassVertexShader, g_DepthPrepassFragmentShader))
+	{
+		std::cout << "Depth pre-pass: " << DepthPrepass::ModeName(m_depthPrepassSettings.mode) << std::endl;
+	}
+	else
+	{
+		std::cout << "Depth pre-pass unavailable - shading the opaque objects in one pass" << std::endl;
+	}
+}
 
-	// Adjust UV scaling so texture repeats instead of stretches.
-	// Use a factor based on torus size; larger number = more repeats
-	float torusTiling = 5.0f;
-	m_pShaderManager->setVec2Value("UVscale", torusTiling, torusTiling);
+/***********************************************************
+ *  CreateGPUCulling()
+ *
+ *  This method moves the culling of the indirect path's
+ *  opaque objects onto the GPU when it is asked for.  The
+ *  objects are handed to it once the scene is built.
+ ***********************************************************/
+void SceneManager::CreateGPUCulling()
+{
+	if ((NULL == m_pIndirectRenderer) || (m_gpuCullingSettings.mode == GPU_CULLING_OFF))
+	{
+		return;
+	}
 
-	m_basicMeshes->DrawTorusMesh();
+	if (m_pIndirectRenderer->EnableGPUCulling(m_gpuCullingSettings,
+		g_GPUCullingComputeShader, g_DepthPyramidComputeShader))
+	{
+		std::cout << "GPU culling: " << GPUCulling::ModeName(m_gpuCullingSettings.mode)
+			<< (m_gpuCullingSettings.bValidate ? ", checked against the CPU every frame" : "") << std::endl;
+	}
+	else
+	{
+		std::cout << "GPU culling unavailable - culling every object on the CPU" << std::endl;
+	}
+}
 
-	/****************************************************************/
+/***********************************************************
+ *  CreateLightmap()
+ *
+ *  This method loads the baked lightmap for the indirect
+ *  path and has the mesh library upload the chart stream
+ *  the lightmapped shaders read.  Without the file the
+ *  garden is lit per pixel as before.
+ ***********************************************************/
+void SceneManager::CreateLightmap()
+{
+	if (NULL == m_pIndirectRenderer)
+	{
+		return;
+	}
 
+	m_pLightmap = new Lightmap();
+	if (!m_pLightmap->Load(g_LightmapFile))
+	{
+		delete m_pLightmap;
+		m_pLightmap = NULL;
+		std::cout << "No lightmap - lighting per pixel (bake " << g_LightmapFile << " with --bake-lightmaps)"
+			<< std::endl;
+		return;
+	}
+	m_pMeshLibrary->SetLightmapStreamEnabled(true);
+}
 
-	// =====================================
-	// 4) Rectangular Hedge Left (flat on plane)
-	// =====================================
-	// Draws a rectangular hedge aligned with the left bush.
-	glm::vec3 secondComboPos = glm::vec3(-12.0f, 0.0f, -2.0f);
-	DrawRectangularHedge(
-		secondComboPos,						 // centre it around the cylinder
-		10.0f,								 // length in X
-		6.0f,								 // width in Z
-		2.0f);								 // height in Y
+/***********************************************************
+ *  BuildLightmapScene()
+ *
+ *  This method describes the scene for the lightmap baker:
+ *  every opaque or alpha tested lit object gets a lightmap,
+ *  every object but the transparent ones casts shadows,
+ *  and the shader's lights are the bake's lights.
+ ***********************************************************/
+void SceneManager::BuildLightmapScene(LIGHTMAP_SCENE& scene)
+{
+	scene.objects.clear();
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		const SCENE_OBJECT& object = m_sceneObjects[i];
+		int materialIndex = FindMaterialIndex(object.materialTag);
+		bool bTransparent = (materialIndex >= 0) && (m_objectMaterials[materialIndex].blendMode == BLEND_TRANSPARENT);
+		int textureSlot = FindTextureSlot(object.textureTag);
+
+		LIGHTMAP_OBJECT lightmapObject;
+		lightmapObject.mesh = object.mesh;
+		lightmapObject.model = object.model;
+		lightmapObject.diffuseColor = (materialIndex >= 0) ? m_objectMaterials[materialIndex].diffuseColor : glm::vec3(1.0f);
+		lightmapObject.textureFile = (textureSlot >= 0) ? m_textureIDs[textureSlot].filename : "";
+		lightmapObject.bLightmapped = (materialIndex >= 0) && !bTransparent;
+		lightmapObject.bOccluder = !bTransparent;
+		lightmapObject.bTerrain = ((int)i == m_terrainObject);
+		scene.objects.push_back(lightmapObject);
+	}
 
-	/****************************************************************/
+	scene.lights.clear();
+	for (size_t i = 0; (i < m_sceneLights.size()) && (i < SHADER_MAX_LIGHTS); i++)
+	{
+		LIGHTMAP_LIGHT light;
+		light.position = m_sceneLights[i].position;
+		light.diffuseColor = m_sceneLights[i].diffuseColor;
+		light.bDirectional = m_sceneLights[i].bDirectional;
+		scene.lights.push_back(light);
+	}
+	scene.terrain = m_terrainShape;
+}
 
+/***********************************************************
+ *  CreateVirtualTexture()
+ *
+ *  This method opens the virtual texture named by the first
+ *  scene object that has one.  It is sampled by the indirect
+ *  shaders only, so without the indirect path - or without
+ *  the file - the objects keep their regular texture.
+ ***********************************************************/
+void SceneManager::CreateVirtualTexture()
+{
+	if (NULL == m_pIndirectRenderer)
+	{
+		return;
+	}
 
-	// ================================
-	// 5) Outer Rectangular Hedge in front of torus
-	// ================================
-	// Creates a hedge boundary enclosing the torus.
-	glm::vec3 outerHedgeCenter = glm::vec3(0.0f, 0.0f, 18.0f);  // in front of the torus, along Z
-	float outerLength = 8.0f;
-	float outerWidth = 10.0f;
-	float hedgeHeight = 2.0f;
+	std::string filename;
+	for (size_t i = 0; (i < m_sceneObjects.size()) && filename.empty(); i++)
+	{
+		filename = m_sceneObjects[i].virtualTexture;
+	}
+	if (filename.empty())
+	{
+		return;
+	}
 
-	DrawRectangularHedge(outerHedgeCenter, outerLength, outerWidth, hedgeHeight);
-
-	/****************************************************************/
+	m_pVirtualTexture = new VirtualTexture(m_pMeshLibrary, m_virtualTextureSettings);
+	if (!m_pVirtualTexture->Initialize(filename.c_str(), g_FeedbackVertexShader, g_FeedbackFragmentShader,
+		g_ShaderCacheDirectory))
+	{
+		delete m_pVirtualTexture;
+		m_pVirtualTexture = NULL;
+		std::cout << "Virtual texture unavailable - using the tiled textures (build " << filename
+			<< " with --build-ground-texture)" << std::endl;
+	}
+}
 
+/***********************************************************
+ *  UploadIndirectSceneData()
+ *
+ *  This method uploads the transform, UV scale, texture and
+ *  material of every scene object, plus the materials, for
+ *  the indirect path.  Nothing of it changes per frame.
+ *  Objects without a texture or material are drawn with the
+ *  untextured or unlit shader variant, and objects naming
+ *  the open virtual texture with the virtual textured one.
+ *  While the lightmap matches the scene, the objects it
+ *  covers get their charts and the lightmapped variant.
+ ***********************************************************/
+void SceneManager::UploadIndirectSceneData()
+{
+	if (NULL == m_pIndirectRenderer)
+	{
+		return;
+	}
 
-	// ================================
-	// 6) Inner X-shaped hedges inside of the outer hedge
-	// ================================
-	// Adds decorative criss-cross hedges using rotated box meshes.
-	float innerWidth = 1.0f;  // thickness of the hedge wall
-
-	// innerLength: diagonal span of the X-shaped hedge across the inner rectangle,
-	// accounting for hedge wall thickness (using the Pythagorean theorem)
-	// Note: no need for a helper since it'll only be used once
-	float innerLength = sqrt(
-		(outerLength - 2 * innerWidth) * (outerLength - 2 * innerWidth) +
-		(outerWidth - 2 * innerWidth) * (outerWidth - 2 * innerWidth)
-	);
+	std::vector<GPU_MATERIAL> materials;
+	std::vector<BLEND_MODE> blendModes;
+	for (size_t i = 0; i < m_objectMaterials.size(); i++)
+	{
+		const OBJECT_MATERIAL& material = m_objectMaterials[i];
+		GPU_MATERIAL gpuMaterial;
+		gpuMaterial.ambient = glm::vec4(material.ambientColor, material.ambientStrength);
+		gpuMaterial.diffuse = glm::vec4(material.diffuseColor,
+			(material.blendMode == BLEND_ALPHA_TEST) ? material.alphaCutoff :
+			((material.blendMode == BLEND_TRANSPARENT) ? material.opacity : 1.0f));
+		gpuMaterial.specular = glm::vec4(material.specularColor, material.shininess);
+		materials.push_back(gpuMaterial);
+		blendModes.push_back(material.blendMode);
+	}
+	m_pIndirectRenderer->SetMaterials(materials, blendModes);
 
-	// Diagonal 1 (from front-left to back-right)
-	SetTransformations(glm::vec3(innerLength, hedgeHeight, innerWidth),
-		0.0f, 45.0f, 0.0f, outerHedgeCenter);
-	m_basicMeshes->DrawBoxMesh();
+	// the lightmap only fits the scene it was baked from
+	bool bLightmap = false;
+	if (NULL != m_pLightmap)
+	{
+		LIGHTMAP_SCENE scene;
+		BuildLightmapScene(scene);
+		bLightmap = m_pLightmap->Matches(LightmapBaker::SceneKey(scene));
+		if (!bLightmap)
+		{
+			std::cout << "Lightmap " << g_LightmapFile << " is out of date - lighting per pixel (bake it again with "
+				<< "--bake-lightmaps)" << std::endl;
+		}
+	}
 
-	// Diagonal 2 (from back-left to front-right)
-	SetTransformations(glm::vec3(innerLength, hedgeHeight, innerWidth),
-		0.0f, -45.0f, 0.0f, outerHedgeCenter);
-	m_basicMeshes->DrawBoxMesh();
+	std::vector<GPU_DRAW_DATA> drawData;
+	m_virtualTexturedObjects.assign(m_sceneObjects.size(), 0);
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		const SCENE_OBJECT& object = m_sceneObjects[i];
+		GPU_DRAW_DATA data;
+		data.model = object.model;
+		data.uvScale = object.uvScale;
+		data.textureSlot = FindTextureSlot(object.textureTag);
+		data.materialIndex = FindMaterialIndex(object.materialTag);
+		if ((NULL != m_pVirtualTexture) && !object.virtualTexture.empty() &&
+			(object.virtualTexture == m_pVirtualTexture->GetFilename()))
+		{
+			data.textureSlot = VIRTUAL_TEXTURE_SLOT;
+			m_virtualTexturedObjects[i] = 1;
+		}
+		data.lightmapChart = -1;
+		data.lightmapLayer = 0;
+		if (bLightmap)
+		{
+			LIGHTMAP_PLACEMENT placement = m_pLightmap->GetPlacement((uint32_t)i);
+			data.lightmapChart = placement.firstChart;
+			data.lightmapLayer = placement.layer;
+		}
+		data.padding[0] = 0;
+		data.padding[1] = 0;
+		drawData.push_back(data);
+	}
+	m_pIndirectRenderer->SetDrawData(drawData);
 }
 
-// ----------------------------------------------
-// Helper Functions for Drawing Complex Objects
-// ----------------------------------------------
-void SceneManager::DrawCylinderWithSphereTip(glm::vec3 basePos, float cylinderHeight, float cylinderRadius)
+/***********************************************************
+ *  UploadCullingData()
+ *
+ *  This method hands the GPU culling every object it can
+ *  take - all drawn ones but the transparent objects, which
+ *  go back to front, and the virtually textured ones, whose
+ *  feedback pass needs the CPU's list - with the bounding
+ *  sphere of every mesh, and marks the entities of the ones
+ *  it took so the CPU culling skips them; an object it turns
+ *  down stays with the CPU.
+ ***********************************************************/
+void SceneManager::UploadCullingData()
 {
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
+	if ((NULL == m_pIndirectRenderer) || !m_pIndirectRenderer->IsGPUCullingEnabled())
+	{
+		return;
+	}
 
-	// --------------------------
-	// Cylinder body
-	// --------------------------
-	scaleXYZ = glm::vec3(cylinderRadius, cylinderHeight, cylinderRadius);
-	positionXYZ = basePos;
+	std::vector<glm::vec4> meshSpheres(MESH_COUNT);
+	for (int mesh = 0; mesh < MESH_COUNT; mesh++)
+	{
+		meshSpheres[mesh] = MeshBoundingSphere((SCENE_MESH)mesh);
+	}
 
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
+	const uint8_t* visibility = m_pEntities->GetVisibility();
+	std::vector<GPU_CULLING_OBJECT> objects(m_sceneObjects.size());
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		const SCENE_OBJECT& object = m_sceneObjects[i];
+		uint8_t flags = visibility[m_pEntities->GetDenseIndex(object.entity)];
+		int materialIndex = FindMaterialIndex(object.materialTag);
+		bool bTransparent = (materialIndex >= 0) && (m_objectMaterials[materialIndex].blendMode == BLEND_TRANSPARENT);
+
+		objects[i].mesh = object.mesh;
+		objects[i].bCulled = ((flags & ENTITY_HIDDEN) == 0) && !bTransparent && !m_virtualTexturedObjects[i];
+		objects[i].bPerspectiveOnly = (flags & ENTITY_PERSPECTIVE_ONLY) != 0;
+		objects[i].impostor = ((NULL != m_pImpostors) && (i < m_impostorObjects.size())) ? m_impostorObjects[i] : -1;
+	}
 
-	// Activate shader and set material/texture BEFORE drawing
-	m_pShaderManager->use();
-	SetShaderMaterial("Foliage");
-	SetShaderTexture("Leaves1");
-	m_pShaderManager->setBoolValue("bUseLighting", true);
-	m_pShaderManager->setBoolValue("bUseTexture", true);
+	std::vector<unsigned char> accepted = m_pIndirectRenderer->SetCullingObjects(objects, meshSpheres);
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		ENTITY entity = m_sceneObjects[i].entity;
+		uint8_t flags = visibility[m_pEntities->GetDenseIndex(entity)] & ~ENTITY_GPU_CULLED;
+		m_pEntities->SetVisibility(entity, flags | ((accepted[i] != 0) ? ENTITY_GPU_CULLED : 0));
+	}
+}
 
-	// Draw only the sides
-	m_basicMeshes->DrawTaperedCylinderTreeTierMesh(false, false, true);
+/***********************************************************
+ *  CreateTerrain()
+ *
+ *  This method creates the terrain for the terrain record,
+ *  or recreates it if the record's shape changed, and hides
+ *  the flat plane the record's object would otherwise draw.
+ *  The terrain is drawn with the object's data, so it keeps
+ *  the object's material and (virtual) texture.  Without the
+ *  indirect path the plane is drawn instead.
+ ***********************************************************/
+void SceneManager::CreateTerrain()
+{
+	if ((NULL == m_pIndirectRenderer) || (m_terrainObject < 0))
+	{
+		delete m_pTerrain;
+		m_pTerrain = NULL;
+		return;
+	}
+
+	if ((NULL != m_pTerrain) && !ShapesEqual(m_pTerrain->GetShape(), TerrainHeightfield(m_terrainShape).GetShape()))
+	{
+		delete m_pTerrain;
+		m_pTerrain = NULL;
+	}
+	if (NULL == m_pTerrain)
+	{
+		m_pTerrain = new Terrain(Terrain::DefaultSettings());
+		if (!m_pTerrain->Initialize(m_terrainShape, g_TerrainVertexShader, g_IndirectFragmentShader,
+			g_FeedbackFragmentShader, g_ShaderCacheDirectory))
+		{
+			delete m_pTerrain;
+			m_pTerrain = NULL;
+			std::cout << "Terrain unavailable - drawing the grounds flat" << std::endl;
+			return;
+		}
+	}
+
+	const SCENE_OBJECT& object = m_sceneObjects[m_terrainObject];
+	m_pEntities->SetVisibility(object.entity, ENTITY_HIDDEN | (object.bPerspectiveOnly ? ENTITY_PERSPECTIVE_ONLY : 0));
+}
+
+/***********************************************************
+ *  CreateImpostors()
+ *
+ *  This method gives every topiary archetype of the scene
+ *  its impostor atlas - from the cache, or baked on the CPU
+ *  if the cache does not have it - and uploads them.  Only
+ *  the indirect path draws impostors.
+ ***********************************************************/
+void SceneManager::CreateImpostors()
+{
+	if ((NULL == m_pIndirectRenderer) || m_impostorArchetypes.empty())
+	{
+		delete m_pImpostors;
+		m_pImpostors = NULL;
+		return;
+	}
+
+	if (NULL == m_pImpostors)
+	{
+		m_pImpostors = new ImpostorRenderer(m_impostorSettings);
+		if (!m_pImpostors->Initialize(g_ImpostorVertexShader, g_ImpostorFragmentShader, g_ShaderCacheDirectory))
+		{
+			delete m_pImpostors;
+			m_pImpostors = NULL;
+			std::cout << "Impostors unavailable - drawing every topiary as meshes" << std::endl;
+			return;
+		}
+	}
+
+	ImpostorBaker baker(g_ImpostorCacheDirectory, m_impostorSettings.framesPerSide, m_impostorSettings.frameSize);
+	std::vector<IMPOSTOR_ATLAS> atlases(m_impostorArchetypes.size());
+	for (size_t i = 0; i < m_impostorArchetypes.size(); i++)
+	{
+		if (!baker.GetAtlas(m_impostorArchetypes[i], atlases[i]))
+		{
+			delete m_pImpostors;
+			m_pImpostors = NULL;
+			std::cout << "Impostors unavailable - drawing every topiary as meshes" << std::endl;
+			return;
+		}
+	}
+	m_pImpostors->SetAtlases(atlases);
+}
+
+/***********************************************************
+ *  ImpostorVariant()
+ *
+ *  This method returns the shader variant the impostors are
+ *  drawn with: the lighting of the first topiary's mesh.
+ ***********************************************************/
+SHADER_VARIANT SceneManager::ImpostorVariant() const
+{
+	SHADER_VARIANT variant = m_pIndirectRenderer->GetObjectVariant(m_impostorInstances[0].firstObject);
+	variant.bTextured = true;
+	variant.bVirtualTextured = false;
+	variant.bLightmapped = false;
+	// the impostor shader drops the empty texels on its own
+	variant.bAlphaTested = false;
+	return(variant);
+}
+
+/***********************************************************
+ *  CollectImpostorArchetypes()
+ *
+ *  This method lists the distinct topiary shapes of a set of
+ *  scene records as impostor archetypes, with the archetype
+ *  of each record (-1 for the other records).  It needs no
+ *  GL context, so the headless bake uses it as well.
+ ***********************************************************/
+void SceneManager::CollectImpostorArchetypes(const std::vector<SCENE_RECORD>& records,
+	std::vector<IMPOSTOR_ARCHETYPE>& archetypes, std::vector<int>& recordArchetypes)
+{
+	archetypes.clear();
+	recordArchetypes.assign(records.size(), -1);
+
+	std::string textureFile;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		if ((records[i].type == "texture") && (records[i].name == g_TopiaryTexture))
+			textureFile = records[i].GetString("file", "");
+	}
+
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const SCENE_RECORD& record = records[i];
+		if (record.type != "topiary")
+			continue;
+
+		float height = record.GetFloat("height", 1.0f);
+		float radius = record.GetFloat("radius", 1.0f);
+		std::ostringstream name;
+		name << "topiary " << height << " x " << radius;
+		for (size_t j = 0; (j < archetypes.size()) && (recordArchetypes[i] < 0); j++)
+		{
+			if (archetypes[j].name == name.str())
+				recordArchetypes[i] = (int)j;
+		}
+		if (recordArchetypes[i] >= 0)
+			continue;
+
+		IMPOSTOR_ARCHETYPE archetype;
+		archetype.name = name.str();
+		IMPOSTOR_PART part;
+		part.textureFile = textureFile;
+		part.uvScale = g_TopiaryUVScale;
+		glm::mat4 body;
+		glm::mat4 tip;
+		TopiaryTransforms(height, radius, body, tip);
+		part.mesh = MESH_TAPERED_CYLINDER;
+		part.transform = body;
+		archetype.parts.push_back(part);
+		part.mesh = MESH_SPHERE;
+		part.transform = tip;
+		archetype.parts.push_back(part);
+
+		recordArchetypes[i] = (int)archetypes.size();
+		archetypes.push_back(archetype);
+	}
+}
+
+/***********************************************************
+ *  BakeImpostors()
+ *
+ *  This method bakes the impostor atlases of the scene file
+ *  into the cache without a window or GL context, for build
+ *  machines without a GPU.  Atlases already in the cache are
+ *  kept.
+ ***********************************************************/
+bool SceneManager::BakeImpostors()
+{
+	std::vector<SCENE_RECORD> records;
+	if (!SceneFile::Read(g_SceneFile, records))
+	{
+		return(false);
+	}
+
+	std::vector<IMPOSTOR_ARCHETYPE> archetypes;
+	std::vector<int> recordArchetypes;
+	CollectImpostorArchetypes(records, archetypes, recordArchetypes);
+
+	IMPOSTOR_SETTINGS settings = ImpostorRenderer::DefaultSettings();
+	ImpostorBaker baker(g_ImpostorCacheDirectory, settings.framesPerSide, settings.frameSize);
+	for (size_t i = 0; i < archetypes.size(); i++)
+	{
+		IMPOSTOR_ATLAS atlas;
+		if (!baker.GetAtlas(archetypes[i], atlas))
+		{
+			return(false);
+		}
+	}
+
+	std::cout << archetypes.size() << " impostor archetypes in " << g_ImpostorCacheDirectory << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  BakeLightmaps()
+ *
+ *  This method builds the scene of the scene file on the
+ *  software rasterizer, which needs no window or GL context,
+ *  and bakes and stores its lightmap.
+ ***********************************************************/
+bool SceneManager::BakeLightmaps(const LIGHTMAP_SETTINGS& settings)
+{
+	SoftwareRasterizer rasterizer(SoftwareRasterizer::DefaultSettings());
+	SceneManager sceneManager(NULL, &rasterizer);
+	sceneManager.PrepareScene();
+
+	LIGHTMAP_SCENE scene;
+	sceneManager.BuildLightmapScene(scene);
+	LightmapBaker baker(settings);
+	LIGHTMAP_ATLAS atlas;
+	if (!baker.Bake(scene, atlas) || !LightmapBaker::Store(g_LightmapFile, atlas))
+	{
+		return(false);
+	}
+
+	std::cout << "Lightmap written to " << g_LightmapFile << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  BuildSceneObjects()
+ *
+ *  This method lays out the garden from the object, topiary
+ *  and hedge records of the scene file.  Each record becomes
+ *  a scene graph node, placed relative to the record named
+ *  by its parent key (if any), and compound structures
+ *  (hedges, bushes) get their pieces as child nodes.  Base
+ *  meshes are assigned textures and materials.
+ *
+ *  The result is a list of scene objects that RenderScene()
+ *  draws every frame and that is also indexed in the
+ *  spatial grid for picking and camera collision.
+ ***********************************************************/
+void SceneManager::BuildSceneObjects()
+{
+	m_sceneObjects.clear();
+	m_pEntities->Clear();
+	m_pSceneGraph->Clear();
+	m_nodeObjects.clear();
+	m_namedNodes.clear();
+	m_recordNodes.assign(m_sceneRecords.size(), -1);
+	m_terrainObject = -1;
+	m_impostorInstances.clear();
+	std::vector<int> recordArchetypes;
+	CollectImpostorArchetypes(m_sceneRecords, m_impostorArchetypes, recordArchetypes);
+
+	for (size_t i = 0; i < m_sceneRecords.size(); i++)
+	{
+		const SCENE_RECORD& record = m_sceneRecords[i];
+
+		if ((record.type == "texture") || (record.type == "material") || (record.type == "light"))
+		{
+			continue;
+		}
+		if ((record.type != "object") && (record.type != "topiary") && (record.type != "hedge") && (record.type != "terrain"))
+		{
+			std::cout << "Scene file line " << record.line << ": unknown record \"" << record.type << "\"" << std::endl;
+			continue;
+		}
+
+		// parents have to come before their children in the file
+		int parentNode = -1;
+		std::string parentName = record.GetString("parent", "");
+		if (!parentName.empty())
+		{
+			std::map<std::string, int>::const_iterator found = m_namedNodes.find(parentName);
+			if (found == m_namedNodes.end())
+			{
+				std::cout << "Scene file line " << record.line << ": no earlier record \"" << parentName << "\"" << std::endl;
+				continue;
+			}
+			parentNode = found->second;
+		}
+
+		int node = -1;
+		if (record.type == "object")
+		{
+			std::string meshName = record.GetString("mesh", "");
+			int mesh = 0;
+			while ((mesh < MESH_COUNT) && (meshName != MeshGenerator::MeshName((SCENE_MESH)mesh)))
+				mesh++;
+			if (mesh == MESH_COUNT)
+			{
+				std::cout << "Scene file line " << record.line << ": unknown mesh \"" << meshName << "\"" << std::endl;
+				continue;
+			}
+
+			node = AddSceneObject(
+				record.name.c_str(),
+				(SCENE_MESH)mesh,
+				parentNode,
+				RecordTransform(record),
+				record.GetString("texture", "").c_str(),
+				record.GetString("material", "").c_str(),
+				record.GetVec2("uv", glm::vec2(1.0f)));
+			m_sceneObjects.back().virtualTexture = record.GetString("virtual-texture", "");
+			if (record.HasFlag("perspective-only"))
+			{
+				m_sceneObjects.back().bPerspectiveOnly = true;
+				m_pEntities->SetVisibility(m_sceneObjects.back().entity, ENTITY_PERSPECTIVE_ONLY);
+			}
+		}
+		else if (record.type == "terrain")
+		{
+			if (m_terrainObject >= 0)
+			{
+				std::cout << "Scene file line " << record.line << ": only one terrain record is drawn" << std::endl;
+				continue;
+			}
+
+			// the heightfield is laid out in world space, so the
+			// terrain has no parent
+			m_terrainShape.center = record.GetVec3("position", glm::vec3(0.0f));
+			m_terrainShape.size = record.GetVec2("size", glm::vec2(120.0f, 60.0f));
+			m_terrainShape.hillHeight = record.GetFloat("hill-height", 0.0f);
+			m_terrainShape.hillSize = record.GetFloat("hill-size", 30.0f);
+			m_terrainShape.flatSize = record.GetVec2("flat", m_terrainShape.size * 0.5f);
+
+			// a plane over the grounds, with the same texture
+			// mapping as the terrain
+			node = AddSceneObject(
+				record.name.c_str(),
+				MESH_PLANE,
+				-1,
+				RecordTransform(record),
+				record.GetString("texture", "").c_str(),
+				record.GetString("material", "").c_str(),
+				record.GetVec2("uv", glm::vec2(1.0f)));
+			m_sceneObjects.back().virtualTexture = record.GetString("virtual-texture", "");
+			if (record.HasFlag("perspective-only"))
+			{
+				m_sceneObjects.back().bPerspectiveOnly = true;
+				m_pEntities->SetVisibility(m_sceneObjects.back().entity, ENTITY_PERSPECTIVE_ONLY);
+			}
+			m_terrainObject = (int)m_sceneObjects.size() - 1;
+		}
+		else if (record.type == "topiary")
+		{
+			uint32_t firstObject = (uint32_t)m_sceneObjects.size();
+			node = AddCylinderWithSphereTip(record.name.c_str(), parentNode,
+				RecordTransform(record),
+				record.GetFloat("height", 1.0f),
+				record.GetFloat("radius", 1.0f));
+			if ((node >= 0) && (recordArchetypes[i] >= 0))
+			{
+				IMPOSTOR_INSTANCE impostor;
+				impostor.archetype = recordArchetypes[i];
+				impostor.node = node;
+				impostor.firstObject = firstObject;
+				impostor.objectCount = (uint32_t)m_sceneObjects.size() - firstObject;
+				m_impostorInstances.push_back(impostor);
+			}
+		}
+		else
+		{
+			node = AddRectangularHedge(record.name.c_str(), parentNode,
+				RecordTransform(record),
+				record.GetFloat("length", 1.0f),
+				record.GetFloat("width", 1.0f),
+				record.GetFloat("height", 1.0f));
+		}
+
+		m_recordNodes[i] = node;
+		if (!record.name.empty())
+		{
+			m_namedNodes[record.name] = node;
+		}
+	}
+
+	m_impostorObjects.assign(m_sceneObjects.size(), -1);
+	for (size_t i = 0; i < m_impostorInstances.size(); i++)
+	{
+		const IMPOSTOR_INSTANCE& impostor = m_impostorInstances[i];
+		for (uint32_t j = 0; j < impostor.objectCount; j++)
+		{
+			m_impostorObjects[impostor.firstObject + j] = (int)i;
+		}
+	}
+
+	UpdateSceneTransforms();
+}
+
+/***********************************************************
+ *  RecordTransform()
+ *
+ *  This method builds the transform of a layout record
+ *  relative to its parent.  Only single objects are scaled;
+ *  the size of a bush, hedge or terrain is given by its own
+ *  keys.
+ ***********************************************************/
+glm::mat4 SceneManager::RecordTransform(const SCENE_RECORD& record)
+{
+	glm::vec3 scale = glm::vec3(1.0f);
+	if (record.type == "object")
+	{
+		scale = record.GetVec3("scale", glm::vec3(1.0f));
+	}
+	else if (record.type == "terrain")
+	{
+		// the plane mesh spans -1 to 1
+		glm::vec2 size = record.GetVec2("size", glm::vec2(120.0f, 60.0f));
+		scale = glm::vec3(size.x * 0.5f, 1.0f, size.y * 0.5f);
+	}
+	glm::vec3 rotation = record.GetVec3("rotation", glm::vec3(0.0f));
+
+	return(BuildModelMatrix(scale, rotation.x, rotation.y, rotation.z, record.GetVec3("position", glm::vec3(0.0f))));
+}
+
+/***********************************************************
+ *  MoveChangedRecords()
+ *
+ *  This method handles a reload that only moved, turned or
+ *  scaled layout records: the nodes of those records get
+ *  their new transform and the scene graph update carries
+ *  it to their children, so moving a hedge enclosure costs
+ *  one dirty node.  Returns false, changing nothing, if any
+ *  other value or record changed.
+ ***********************************************************/
+bool SceneManager::MoveChangedRecords(const std::vector<SCENE_RECORD>& previousRecords, size_t& movedObjects)
+{
+	movedObjects = 0;
+	if ((previousRecords.size() != m_sceneRecords.size()) || (m_recordNodes.size() != m_sceneRecords.size()))
+	{
+		return(false);
+	}
+
+	std::vector<size_t> movedRecords;
+	for (size_t i = 0; i < m_sceneRecords.size(); i++)
+	{
+		const SCENE_RECORD& before = previousRecords[i];
+		const SCENE_RECORD& after = m_sceneRecords[i];
+		if ((before.type != after.type) || (before.name != after.name))
+		{
+			return(false);
+		}
+		if (before.values == after.values)
+		{
+			continue;
+		}
+
+		// a light also has a position, but it is not a node, and
+		// moving the terrain moves its heightfield
+		if ((m_recordNodes[i] < 0) || (after.type == "texture") || (after.type == "material") || (after.type == "light") ||
+			(after.type == "terrain"))
+		{
+			return(false);
+		}
+
+		std::map<std::string, std::string> beforeValues = before.values;
+		std::map<std::string, std::string> afterValues = after.values;
+		const char* transformKeys[3] = { "position", "rotation", "scale" };
+		for (int k = 0; k < 3; k++)
+		{
+			beforeValues.erase(transformKeys[k]);
+			afterValues.erase(transformKeys[k]);
+		}
+		if (beforeValues != afterValues)
+		{
+			return(false);
+		}
+		movedRecords.push_back(i);
+	}
+
+	for (size_t i = 0; i < movedRecords.size(); i++)
+	{
+		size_t record = movedRecords[i];
+		m_pSceneGraph->SetLocalTransform(m_recordNodes[record], RecordTransform(m_sceneRecords[record]));
+	}
+	movedObjects = UpdateSceneTransforms();
+	return(true);
+}
+
+/***********************************************************
+ *  UpdateSceneTransforms()
+ *
+ *  This method runs the scene graph update and copies the
+ *  new world transforms into the scene objects that moved
+ *  and into their entities, along with their world space
+ *  bounding spheres.  Returns the number of objects that
+ *  moved.
+ ***********************************************************/
+size_t SceneManager::UpdateSceneTransforms()
+{
+	std::vector<int> updatedNodes;
+	m_pSceneGraph->UpdateWorldTransforms(&updatedNodes);
+
+	size_t movedObjects = 0;
+	for (size_t i = 0; i < updatedNodes.size(); i++)
+	{
+		int objectIndex = m_nodeObjects[updatedNodes[i]];
+		if (objectIndex < 0)
+			continue;
+
+		SCENE_OBJECT& object = m_sceneObjects[objectIndex];
+		object.model = m_pSceneGraph->GetWorldTransform(object.node);
+
+		// bounding sphere of the shape, moved into world space and
+		// grown by the largest scale of the model matrix
+		glm::vec4 sphere = MeshBoundingSphere(object.mesh);
+		const glm::mat4& model = object.model;
+		float maxScale = std::max(glm::length(glm::vec3(model[0])),
+			std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		m_pEntities->SetTransform(object.entity, model);
+		m_pEntities->SetBounds(object.entity, glm::vec3(model * glm::vec4(glm::vec3(sphere), 1.0f)), sphere.w * maxScale);
+
+		movedObjects++;
+	}
+
+	return(movedObjects);
+}
+
+/***********************************************************
+ *  QueueSpatialRebuild()
+ *
+ *  This method hands a copy of the scene objects to the
+ *  main thread, which owns the spatial grid - the camera
+ *  collision and picking query it between frames.
+ ***********************************************************/
+void SceneManager::QueueSpatialRebuild()
+{
+	std::lock_guard<std::mutex> lock(m_reloadMutex);
+	m_pendingSpatialObjects = m_sceneObjects;
+	m_bSpatialRebuildPending = true;
+}
+
+/***********************************************************
+ *  ApplySpatialRebuild()
+ *
+ *  This method indexes the queued scene objects, replacing
+ *  the previous contents of the spatial grid (main thread).
+ ***********************************************************/
+void SceneManager::ApplySpatialRebuild()
+{
+	std::vector<SCENE_OBJECT> objects;
+	{
+		std::lock_guard<std::mutex> lock(m_reloadMutex);
+		if (!m_bSpatialRebuildPending)
+			return;
+		objects.swap(m_pendingSpatialObjects);
+		m_bSpatialRebuildPending = false;
+	}
+
+	m_pSpatialGrid->Clear();
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		m_pSpatialGrid->Insert(objects[i].name, MeshShape(objects[i].mesh), objects[i].model);
+	}
+}
+
+/***********************************************************
+ *  StartCapture()
+ *
+ *  This method puts a capture in front of the render
+ *  backend, so the calls of the setup and of the given
+ *  number of frames are written to a file.  Only the object
+ *  by object draws go through the backend, so multi-draw is
+ *  turned off; the terrain and impostors are drawn outside
+ *  of it and are not in the capture.
+ ***********************************************************/
+bool SceneManager::StartCapture(const char* filename, int frameCount)
+{
+	if (NULL == m_pCapture)
+	{
+		m_pCapture = new RenderCapture(m_pBackend);
+		m_pBackend = m_pCapture;
+	}
+	m_bMultiDrawEnabled = false;
+	return(m_pCapture->Open(filename, frameCount));
+}
+
+/***********************************************************
+ *  EnableHotReload()
+ *
+ *  This method starts watching the scene file and, with the
+ *  indirect path, its shaders.  The shaders of the object by
+ *  object path are not part of this project and are not
+ *  watched.
+ ***********************************************************/
+void SceneManager::EnableHotReload()
+{
+	if (NULL != m_pFileWatcher)
+	{
+		return;
+	}
+
+	m_pFileWatcher = new FileWatcher();
+	m_pFileWatcher->AddFile(g_SceneFile);
+	if (NULL != m_pIndirectRenderer)
+	{
+		m_pFileWatcher->AddFile(g_IndirectVertexShader);
+		m_pFileWatcher->AddFile(g_IndirectFragmentShader);
+		if (m_depthPrepassSettings.mode != DEPTH_PREPASS_OFF)
+		{
+			m_pFileWatcher->AddFile(g_DepthPrepassVertexShader);
+			m_pFileWatcher->AddFile(g_DepthPrepassFragmentShader);
+		}
+		if (m_gpuCullingSettings.mode != GPU_CULLING_OFF)
+		{
+			m_pFileWatcher->AddFile(g_GPUCullingComputeShader);
+			m_pFileWatcher->AddFile(g_DepthPyramidComputeShader);
+		}
+		m_pFileWatcher->AddFile(g_TerrainVertexShader);
+		m_pFileWatcher->AddFile(g_ImpostorVertexShader);
+		m_pFileWatcher->AddFile(g_ImpostorFragmentShader);
+	}
+	std::cout << "Hot reload: watching " << g_SceneFile << (m_pIndirectRenderer ? " and the indirect shaders" : "") << std::endl;
+}
+
+/***********************************************************
+ *  CheckForChanges()
+ *
+ *  This method polls the watched files and queues a reload
+ *  for the render thread, which owns the GL context.  It
+ *  also indexes the objects of a reload the render thread
+ *  has finished.
+ ***********************************************************/
+bool SceneManager::CheckForChanges()
+{
+	if (NULL == m_pFileWatcher)
+	{
+		return(false);
+	}
+
+	ApplySpatialRebuild();
+
+	std::vector<std::string> changedFiles;
+	if (!m_pFileWatcher->Poll(changedFiles))
+	{
+		return(false);
+	}
+
+	std::lock_guard<std::mutex> lock(m_reloadMutex);
+	if (!m_bReloadPending)
+	{
+		m_reloadDetectedTime = std::chrono::steady_clock::now();
+	}
+	for (size_t i = 0; i < changedFiles.size(); i++)
+	{
+		if (changedFiles[i] == g_SceneFile)
+			m_bSceneFileChanged = true;
+		else
+			m_bShadersChanged = true;
+	}
+	m_bReloadPending = true;
+	return(true);
+}
+
+/***********************************************************
+ *  ApplyHotReload()
+ *
+ *  This method applies a queued reload on the render thread.
+ *  The scene file is read again.  If it only moved layout
+ *  records, their scene graph nodes are updated; otherwise
+ *  textures, materials, lights and objects are rebuilt from
+ *  it.  Either way the upload methods only send the entries
+ *  that differ to the GPU.
+ *  Meshes and unchanged textures stay resident.  Changed
+ *  shaders are rebuilt and swapped in if they compile.
+ *
+ *  The latency from noticing the change to the GPU having
+ *  finished with it is reported.
+ ***********************************************************/
+void SceneManager::ApplyHotReload()
+{
+	bool bSceneFileChanged = false;
+	bool bShadersChanged = false;
+	std::chrono::steady_clock::time_point detectedTime;
+	{
+		std::lock_guard<std::mutex> lock(m_reloadMutex);
+		bSceneFileChanged = m_bSceneFileChanged;
+		bShadersChanged = m_bShadersChanged;
+		detectedTime = m_reloadDetectedTime;
+		m_bSceneFileChanged = false;
+		m_bShadersChanged = false;
+		m_bReloadPending = false;
+	}
+
+	size_t changedTextures = 0;
+	size_t changedMaterials = 0;
+	size_t changedLights = 0;
+	size_t changedObjects = 0;
+	bool bShadersReloaded = false;
+
+	if (bSceneFileChanged)
+	{
+		std::vector<SCENE_RECORD> previousRecords = m_sceneRecords;
+
+		// a file that does not parse leaves the scene as it was
+		if (!LoadSceneFile())
+		{
+			std::cout << "Hot reload: " << g_SceneFile << " not applied" << std::endl;
+		}
+		else if (MoveChangedRecords(previousRecords, changedObjects))
+		{
+			// only transforms changed - the moved nodes were updated
+			// in place and nothing else needs rebuilding
+			UploadIndirectSceneData();
+			UploadCullingData();
+			if (changedObjects > 0)
+			{
+				QueueSpatialRebuild();
+			}
+		}
+		else
+		{
+			std::vector<std::string> textureFiles;
+			for (int i = 0; i < m_loadedTextures; i++)
+			{
+				textureFiles.push_back(m_textureIDs[i].filename);
+			}
+			LoadSceneTextures();
+			for (int i = 0; i < m_loadedTextures; i++)
+			{
+				if ((i >= (int)textureFiles.size()) || (textureFiles[i] != m_textureIDs[i].filename))
+					changedTextures++;
+			}
+
+			std::vector<OBJECT_MATERIAL> materials = m_objectMaterials;
+			DefineObjectMaterials();
+			changedMaterials = CountChanges(materials, m_objectMaterials, MaterialsEqual);
+
+			std::vector<LIGHT_SOURCE> lights = m_sceneLights;
+			SetupSceneLights();
+			changedLights = CountChanges(lights, m_sceneLights, LightsEqual);
+
+			std::vector<SCENE_OBJECT> objects = m_sceneObjects;
+			BuildSceneObjects();
+			changedObjects = CountChanges(objects, m_sceneObjects, ObjectsEqual);
+
+			UploadIndirectSceneData();
+			CreateTerrain();
+			CreateImpostors();
+			UploadCullingData();
+			if (changedObjects > 0)
+			{
+				QueueSpatialRebuild();
+			}
+		}
+	}
+
+	if (bShadersChanged && (NULL != m_pIndirectRenderer))
+	{
+		bShadersReloaded = m_pIndirectRenderer->ReloadShaders();
+		if (NULL != m_pTerrain)
+		{
+			bShadersReloaded = m_pTerrain->ReloadShaders(
+				m_pIndirectRenderer->GetObjectVariant((uint32_t)m_terrainObject)) && bShadersReloaded;
+		}
+		if ((NULL != m_pImpostors) && !m_impostorInstances.empty())
+		{
+			bShadersReloaded = m_pImpostors->ReloadShaders(ImpostorVariant()) && bShadersReloaded;
+		}
+	}
+
+	// wait for the uploads and any shader compiles, so the
+	// measured time is what it takes to see the change
+	glFinish();
+	double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - detectedTime).count();
+
+	std::cout << "Hot reload: " << changedObjects << " objects, " << changedMaterials << " materials, "
+		<< changedLights << " lights, " << changedTextures << " textures"
+		<< (bShadersReloaded ? ", shaders" : "") << " changed in " << latency << " ms";
+	if (latency > g_ReloadTargetMilliseconds)
+	{
+		std::cout << " (over the " << g_ReloadTargetMilliseconds << " ms target)";
+	}
+	std::cout << std::endl;
+}
+
+/***********************************************************
+ *  SortVisibleEntities()
+ *
+ *  This method orders the visible entities for drawing by
+ *  sorting 64-bit keys: the pass in the top two bits, then
+ *  the view depth of the bounds center, then the entity in
+ *  the low 32 bits.  A depth in front of the camera is a
+ *  positive float, whose bits sort like its value; the
+ *  transparent entities get their depth bits inverted so
+ *  they sort back to front.  Opaque entities drawn front to
+ *  back let the depth test reject the pixels they hide
+ *  before those are shaded.
+ ***********************************************************/
+const uint32_t* SceneManager::SortVisibleEntities(const uint32_t* visibleEntities, size_t visibleCount,
+	const glm::mat4& view, size_t& opaqueCount)
+{
+	const float* boundsX = m_pEntities->GetBoundsX();
+	const float* boundsY = m_pEntities->GetBoundsY();
+	const float* boundsZ = m_pEntities->GetBoundsZ();
+	const int32_t* materialIndices = m_pEntities->GetMaterialIndices();
+
+	uint64_t* keys = m_pFrameArena->AllocateArray<uint64_t>(visibleCount);
+	uint32_t* sortedEntities = m_pFrameArena->AllocateArray<uint32_t>(visibleCount);
+	opaqueCount = 0;
+	for (size_t i = 0; i < visibleCount; i++)
+	{
+		uint32_t entity = visibleEntities[i];
+		int32_t materialIndex = materialIndices[entity];
+		BLEND_MODE blendMode = ((materialIndex >= 0) && (materialIndex < (int)m_objectMaterials.size())) ?
+			m_objectMaterials[materialIndex].blendMode : BLEND_OPAQUE;
+
+		// the view looks down -z; centers behind the camera
+		// (of large objects) count as depth 0
+		float depth = -(view[0][2] * boundsX[entity] + view[1][2] * boundsY[entity] +
+			view[2][2] * boundsZ[entity] + view[3][2]);
+		uint32_t depthBits = 0;
+		if (depth > 0.0f)
+		{
+			memcpy(&depthBits, &depth, sizeof(depthBits));
+		}
+		// the sign bit is 0, so 30 bits keep all but the lowest
+		// mantissa bit
+		depthBits >>= 1;
+		if (blendMode == BLEND_TRANSPARENT)
+		{
+			depthBits = 0x3fffffffu - depthBits;
+		}
+		else
+		{
+			opaqueCount++;
+		}
+
+		keys[i] = ((uint64_t)blendMode << 62) | ((uint64_t)depthBits << 32) | entity;
+	}
+
+	std::sort(keys, keys + visibleCount);
+	for (size_t i = 0; i < visibleCount; i++)
+	{
+		sortedEntities[i] = (uint32_t)keys[i];
+	}
+	return(sortedEntities);
+}
+
+/***********************************************************
+ *  ValidateGPUCulling()
+ *
+ *  This method runs the CPU culling over the entities the
+ *  GPU culled this frame - dropping those whose impostor
+ *  has faded in, as the GPU does - and has the commands the
+ *  GPU wrote compared with it.
+ ***********************************************************/
+void SceneManager::ValidateGPUCulling(const glm::vec4 frustumPlanes[6], uint8_t hiddenFlags, const float* impostorFades)
+{
+	size_t visibleCount = 0;
+	const uint32_t* visibleEntities = m_pEntities->CollectVisible(frustumPlanes, hiddenFlags, *m_pFrameArena, visibleCount);
+	const uint8_t* visibility = m_pEntities->GetVisibility();
+	const uint32_t* drawIndices = m_pEntities->GetDrawIndices();
+
+	unsigned char* expectedVisible = m_pFrameArena->AllocateArray<unsigned char>(m_sceneObjects.size());
+	memset(expectedVisible, 0, m_sceneObjects.size());
+	for (size_t i = 0; i < visibleCount; i++)
+	{
+		uint32_t entity = visibleEntities[i];
+		uint32_t objectIndex = drawIndices[entity];
+		if (((visibility[entity] & ENTITY_GPU_CULLED) == 0) || (objectIndex >= m_sceneObjects.size()))
+			continue;
+		int impostor = (objectIndex < m_impostorObjects.size()) ? m_impostorObjects[objectIndex] : -1;
+		if ((NULL != impostorFades) && (impostor >= 0) && (impostorFades[impostor] >= 1.0f))
+			continue;
+		expectedVisible[objectIndex] = 1;
+	}
+	m_pIndirectRenderer->ValidateGPUCulling(expectedVisible);
+}
+
+/***********************************************************
+ *  UpdateStreaming()
+ *
+ *  This method stores whether the virtual texture or the
+ *  terrain is loading anything.  The main thread only reads
+ *  the stored flag: a hot reload on this thread may replace
+ *  the terrain at any time.
+ ***********************************************************/
+bool SceneManager::UpdateStreaming()
+{
+	bool bStreaming = ((NULL != m_pVirtualTexture) && m_pVirtualTexture->IsStreaming()) ||
+		((NULL != m_pTerrain) && m_pTerrain->IsStreaming());
+	m_bStreaming = bStreaming;
+	return(bStreaming);
+}
+
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene by 
+ *  drawing the scene objects built in BuildSceneObjects()
+ *  with their transformations, textures and materials. 
+ *  Objects outside the view frustum are skipped, as are
+ *  objects marked perspective-only (the ground plane) when
+ *  the orthographic view is selected.
+ *
+ *  The visible objects are sorted into passes by the blend
+ *  mode of their material (see SortVisibleEntities()).
+ *  With the indirect path the opaque and alpha tested ones
+ *  go out in one multi-draw call per shader variant,
+ *  followed by the terrain, the impostors, the transparent
+ *  objects and the feedback pass of the virtually textured
+ *  objects; otherwise the render backend draws them one by
+ *  one in that order, with the terrain as a flat plane.
+ *  With GPU culling, the CPU only culls the transparent and
+ *  virtually textured objects and the impostors; the rest
+ *  are culled and drawn by the indirect path on its own.
+ *
+ *  Everything the frame needs is taken from the frame arena
+ *  and the materials and textures are set by index, so a
+ *  frame of an unchanged scene makes no heap allocations.
+ ***********************************************************/
+void SceneManager::RenderScene(const SCENE_SNAPSHOT& snapshot)
+{
+	if (m_bReloadPending)
+	{
+		ApplyHotReload();
+	}
+
+	// the culling system streams through the bounds and the
+	// visibility of the entities; the draws are built from the
+	// mesh and draw index columns of the ones that passed.  The
+	// entities the GPU culls are left to it
+	bool bGPUCulling = (NULL != m_pIndirectRenderer) && m_pIndirectRenderer->IsGPUCullingEnabled();
+	uint8_t hiddenFlags = ENTITY_HIDDEN | (snapshot.bOrthographic ? ENTITY_PERSPECTIVE_ONLY : 0);
+	glm::vec4 frustumPlanes[6];
+	EntityStore::ExtractFrustumPlanes(snapshot.projection * snapshot.view, frustumPlanes);
+	size_t visibleCount = 0;
+	const uint32_t* visibleEntities = m_pEntities->CollectVisible(frustumPlanes,
+		hiddenFlags | (bGPUCulling ? ENTITY_GPU_CULLED : 0), *m_pFrameArena, visibleCount);
+	size_t opaqueCount = 0;
+	visibleEntities = SortVisibleEntities(visibleEntities, visibleCount, snapshot.view, opaqueCount);
+
+	const uint8_t* meshes = m_pEntities->GetMeshes();
+	const uint32_t* drawIndices = m_pEntities->GetDrawIndices();
+
+	if (NULL != m_pIndirectRenderer)
+	{
+		// pages that arrived since the last frame are uploaded
+		// before anything samples the virtual texture
+		uint32_t* virtualEntities = NULL;
+		size_t virtualCount = 0;
+		if (NULL != m_pVirtualTexture)
+		{
+			m_pVirtualTexture->Update();
+			virtualEntities = m_pFrameArena->AllocateArray<uint32_t>(visibleCount);
+		}
+
+		// how far the impostor of each topiary has faded in over
+		// its mesh; past the fade only the impostor is drawn
+		size_t impostorCount = m_impostorInstances.size();
+		float* impostorFades = NULL;
+		unsigned char* impostorVisible = NULL;
+		if ((NULL != m_pImpostors) && !snapshot.bOrthographic && (impostorCount > 0))
+		{
+			impostorFades = m_pFrameArena->AllocateArray<float>(impostorCount);
+			impostorVisible = m_pFrameArena->AllocateArray<unsigned char>(impostorCount);
+			for (size_t i = 0; i < impostorCount; i++)
+			{
+				const IMPOSTOR_INSTANCE& impostor = m_impostorInstances[i];
+				const glm::mat4& world = m_pSceneGraph->GetWorldTransform(impostor.node);
+				const glm::vec4& bounds = m_pImpostors->GetBounds(impostor.archetype);
+				glm::vec3 center = glm::vec3(world * glm::vec4(glm::vec3(bounds), 1.0f));
+				float radius = bounds.w * glm::length(glm::vec3(world[0]));
+				impostorFades[i] = m_pImpostors->GetFade(glm::length(center - snapshot.viewPosition) / std::max(radius, 0.001f));
+				impostorVisible[i] = 0;
+
+				// the meshes of GPU culled topiaries never reach the
+				// CPU, so their impostor is tested against the frustum
+				// on its own
+				if (bGPUCulling)
+				{
+					impostorVisible[i] = 1;
+					for (int p = 0; p < 6; p++)
+					{
+						if (glm::dot(glm::vec3(frustumPlanes[p]), center) + frustumPlanes[p].w < -radius)
+							impostorVisible[i] = 0;
+					}
+				}
+			}
+		}
+
+		m_pIndirectRenderer->BeginFrame(snapshot, *m_pFrameArena);
+		m_pIndirectRenderer->SetImpostorFades(impostorFades, impostorCount);
+		for (size_t i = 0; i < visibleCount; i++)
+		{
+			uint32_t entity = visibleEntities[i];
+			if (NULL != impostorFades)
+			{
+				int impostor = m_impostorObjects[drawIndices[entity]];
+				if (impostor >= 0)
+				{
+					impostorVisible[impostor] = 1;
+					if (impostorFades[impostor] >= 1.0f)
+						continue;
+				}
+			}
+			m_pIndirectRenderer->AddDraw((SCENE_MESH)meshes[entity], drawIndices[entity]);
+			if ((NULL != virtualEntities) && m_virtualTexturedObjects[drawIndices[entity]])
+			{
+				virtualEntities[virtualCount++] = entity;
+			}
+		}
+		if (NULL != m_pLightmap)
+		{
+			m_pLightmap->Bind();
+		}
+		m_pIndirectRenderer->Submit();
+		if (bGPUCulling && m_gpuCullingSettings.bValidate)
+		{
+			ValidateGPUCulling(frustumPlanes, hiddenFlags, impostorFades);
+		}
+
+		// the terrain is drawn as its object, with the object
+		// data and lights Submit() left bound
+		bool bDrawTerrain = (NULL != m_pTerrain) &&
+			!(snapshot.bOrthographic && m_sceneObjects[m_terrainObject].bPerspectiveOnly);
+		if (bDrawTerrain)
+		{
+			m_pTerrain->Select(snapshot, *m_pFrameArena);
+			m_pTerrain->Draw((uint32_t)m_terrainObject, m_pIndirectRenderer->GetObjectVariant((uint32_t)m_terrainObject));
+		}
+
+		// the impostors of the topiaries in view that have begun
+		// to fade in, lit with the same buffers
+		if (NULL != impostorFades)
+		{
+			m_pImpostors->BeginFrame(*m_pFrameArena);
+			for (size_t i = 0; i < impostorCount; i++)
+			{
+				if (impostorVisible[i] && (impostorFades[i] > 0.0f))
+				{
+					const IMPOSTOR_INSTANCE& impostor = m_impostorInstances[i];
+					m_pImpostors->AddImpostor(impostor.archetype, m_pSceneGraph->GetWorldTransform(impostor.node),
+						impostorFades[i], impostor.firstObject);
+				}
+			}
+			m_pImpostors->Draw(ImpostorVariant());
+		}
+
+		// everything opaque is drawn; its depth is what the GPU
+		// culling tests the next frame's objects against
+		if (bGPUCulling)
+		{
+			m_pIndirectRenderer->BuildOcclusionPyramid();
+		}
+
+		// the transparent objects go last, over everything opaque
+		if (opaqueCount < visibleCount)
+		{
+			m_pIndirectRenderer->SubmitTransparent();
+		}
+
+		if (NULL != m_pVirtualTexture)
+		{
+			m_pVirtualTexture->BeginFeedback();
+			for (size_t i = 0; i < virtualCount; i++)
+			{
+				uint32_t entity = virtualEntities[i];
+				m_pVirtualTexture->DrawFeedback((SCENE_MESH)meshes[entity], drawIndices[entity]);
+			}
+			if (bDrawTerrain && m_virtualTexturedObjects[m_terrainObject])
+			{
+				m_pTerrain->DrawFeedback((uint32_t)m_terrainObject, m_pVirtualTexture->GetFeedbackBias());
+			}
+			m_pVirtualTexture->EndFeedback();
+		}
+	}
+	else
+	{
+		const int32_t* materialIndices = m_pEntities->GetMaterialIndices();
+		const int32_t* textureSlots = m_pEntities->GetTextureSlots();
+
+		m_pBackend->BeginFrame(snapshot);
+		for (size_t i = 0; i < visibleCount; i++)
+		{
+			uint32_t entity = visibleEntities[i];
+			const SCENE_OBJECT& object = m_sceneObjects[drawIndices[entity]];
+
+			RENDER_OBJECT renderObject;
+			renderObject.model = object.model;
+			renderObject.uvScale = object.uvScale;
+			renderObject.textureSlot = textureSlots[entity];
+			renderObject.materialIndex = materialIndices[entity];
+			m_pBackend->DrawMesh(object.mesh, renderObject);
+		}
+		m_pBackend->EndFrame();
+	}
+
+	// the frame's lists are no longer needed
+	m_pFrameArena->Reset();
+}
+
+// ----------------------------------------------
+// Helper Functions for Building Complex Objects
+// ----------------------------------------------
+
+/***********************************************************
+ *  MeshShape()
+ *
+ *  This method returns the shape of each basic mesh in its
+ *  local space, for the spatial grid and the bounds.
+ ***********************************************************/
+SPATIAL_SHAPE SceneManager::MeshShape(SCENE_MESH mesh)
+{
+	SPATIAL_SHAPE shape;
+	shape.type = SHAPE_BOX;
+	shape.localMin = glm::vec3(-0.5f);
+	shape.localMax = glm::vec3(0.5f);
+	shape.majorRadius = 0.0f;
+	shape.minorRadius = 0.0f;
+
+	switch (mesh)
+	{
+	case MESH_PLANE:
+		shape.localMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+		shape.localMax = glm::vec3(1.0f, 0.0f, 1.0f);
+		break;
+	case MESH_BOX:
+		break;
+	case MESH_SPHERE:
+		shape.type = SHAPE_SPHERE;
+		shape.majorRadius = 1.0f;
+		break;
+	case MESH_TORUS:
+		shape.type = SHAPE_TORUS;
+		shape.majorRadius = 1.0f;
+		shape.minorRadius = 0.1f;
+		break;
+	case MESH_TAPERED_CYLINDER:
+		// bounding box of the tapered cylinder
+		shape.localMin = glm::vec3(-1.0f, 0.0f, -1.0f);
+		shape.localMax = glm::vec3(1.0f, 1.0f, 1.0f);
+		break;
+	default:
+		break;
+	}
+
+	return(shape);
+}
+
+/***********************************************************
+ *  MeshBoundingSphere()
+ *
+ *  This method returns the bounding sphere of a basic mesh
+ *  in its local space: the sphere around its box, or the
+ *  exact one of the sphere and torus.  The CPU culling and
+ *  the GPU culling both grow it by the largest scale of the
+ *  object's model matrix.
+ ***********************************************************/
+glm::vec4 SceneManager::MeshBoundingSphere(SCENE_MESH mesh)
+{
+	SPATIAL_SHAPE shape = MeshShape(mesh);
+	glm::vec3 localCenter = (shape.localMin + shape.localMax) * 0.5f;
+	float localRadius = glm::length(shape.localMax - shape.localMin) * 0.5f;
+	if (shape.type == SHAPE_SPHERE)
+	{
+		localCenter = glm::vec3(0.0f);
+		localRadius = shape.majorRadius;
+	}
+	else if (shape.type == SHAPE_TORUS)
+	{
+		localCenter = glm::vec3(0.0f);
+		localRadius = shape.majorRadius + shape.minorRadius;
+	}
+	return(glm::vec4(localCenter, localRadius));
+}
+
+/***********************************************************
+ *  AddSceneObject()
+ *
+ *  This method appends an object to the scene as a scene
+ *  graph node and a renderable entity.  Its world transform
+ *  and bounds are filled in by UpdateSceneTransforms(), and
+ *  the spatial grid is built from the finished list by
+ *  ApplySpatialRebuild().
+ ***********************************************************/
+int SceneManager::AddSceneObject(const char* name, SCENE_MESH mesh, int parentNode, glm::mat4 localTransform, const char* textureTag, const char* materialTag, glm::vec2 uvScale)
+{
+	int node = m_pSceneGraph->AddNode(parentNode, localTransform);
+	if (node < 0)
+	{
+		return(-1);
+	}
+
+	SCENE_OBJECT object;
+	object.name = name;
+	object.mesh = mesh;
+	object.node = node;
+	object.model = localTransform;
+	object.textureTag = textureTag;
+	object.materialTag = materialTag;
+	object.uvScale = uvScale;
+	object.virtualTexture = "";
+	object.bPerspectiveOnly = false;
+
+	// the render data of the object - the shading is resolved
+	// here, the transform and bounds by UpdateSceneTransforms()
+	object.entity = m_pEntities->Create();
+	m_pEntities->SetMesh(object.entity, mesh);
+	m_pEntities->SetMaterial(object.entity, FindMaterialIndex(materialTag), FindTextureSlot(textureTag));
+	m_pEntities->SetDrawIndex(object.entity, (uint32_t)m_sceneObjects.size());
+
+	m_nodeObjects.resize(m_pSceneGraph->GetNodeCount(), -1);
+	m_nodeObjects[node] = (int)m_sceneObjects.size();
+	m_sceneObjects.push_back(object);
+	return(node);
+}
+
+/***********************************************************
+ *  AddGroupNode()
+ *
+ *  This method adds a scene graph node without an object of
+ *  its own, for the pieces of a compound structure to hang
+ *  off.
+ ***********************************************************/
+int SceneManager::AddGroupNode(int parentNode, glm::mat4 localTransform)
+{
+	int node = m_pSceneGraph->AddNode(parentNode, localTransform);
+	m_nodeObjects.resize(m_pSceneGraph->GetNodeCount(), -1);
+	return(node);
+}
+
+/***********************************************************
+ *  TopiaryTransforms()
+ *
+ *  This method places the two pieces of a topiary bush
+ *  relative to its base: the tapered body and the sphere
+ *  tip.  The impostor archetypes use the same layout.
+ ***********************************************************/
+void SceneManager::TopiaryTransforms(float cylinderHeight, float cylinderRadius, glm::mat4& body, glm::mat4& tip)
+{
+	// --------------------------
+	// Cylinder body
+	// --------------------------
+	glm::vec3 scaleXYZ = glm::vec3(cylinderRadius, cylinderHeight, cylinderRadius);
+	body = BuildModelMatrix(scaleXYZ, 0.0f, 0.0f, 0.0f, glm::vec3(0.0f));
 
 	// --------------------------
 	// Sphere tip
 	// --------------------------
-	float cylinderTopY = positionXYZ.y + scaleXYZ.y;
+	float cylinderTopY = scaleXYZ.y;
 	float topRadius = 0.05f * cylinderRadius;
 	float sphereRadius = topRadius * 1.1f;
 	float sphereCenterY = cylinderTopY - sphereRadius * 0.7f;
 
-	scaleXYZ = glm::vec3(sphereRadius * 2.0f);
-	positionXYZ = glm::vec3(basePos.x, sphereCenterY, basePos.z);
+	tip = BuildModelMatrix(glm::vec3(sphereRadius * 2.0f), 0.0f, 0.0f, 0.0f, glm::vec3(0.0f, sphereCenterY, 0.0f));
+}
+
+int SceneManager::AddCylinderWithSphereTip(const char* name, int parentNode, glm::mat4 localTransform, float cylinderHeight, float cylinderRadius)
+{
+	// the base of the bush - both pieces are placed relative to it
+	int node = AddGroupNode(parentNode, localTransform);
+	if (node < 0)
+	{
+		return(-1);
+	}
 
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
+	glm::mat4 body;
+	glm::mat4 tip;
+	TopiaryTransforms(cylinderHeight, cylinderRadius, body, tip);
 
-	// Ensure shader and material are applied here again
-	// Ensure shader and material are applied here again
-	m_pShaderManager->use();
-	SetShaderMaterial("Foliage");
-	SetShaderTexture("Leaves1");
-	m_pShaderManager->setBoolValue("bUseLighting", true);
-	m_pShaderManager->setBoolValue("bUseTexture", true);
+	AddSceneObject(name, MESH_TAPERED_CYLINDER, node, body, g_TopiaryTexture, g_TopiaryMaterial, g_TopiaryUVScale);
+	AddSceneObject((std::string(name) + " tip").c_str(), MESH_SPHERE, node, tip, g_TopiaryTexture, g_TopiaryMaterial,
+		g_TopiaryUVScale);
 
-	m_basicMeshes->DrawSphereMesh();
+	return(node);
 }
 
-void SceneManager::DrawRectangularHedge(glm::vec3 centerPos, float length, float width, float height)
+int SceneManager::AddRectangularHedge(const char* name, int parentNode, glm::mat4 localTransform, float length, float width, float height)
 {
-	glm::vec3 scaleXYZ;
-	glm::vec3 positionXYZ;
+	// the centre of the enclosure on the ground - the walls are
+	// placed relative to it
+	int node = AddGroupNode(parentNode, localTransform);
+	if (node < 0)
+	{
+		return(-1);
+	}
+
 	float halfHeight = height * 0.5f;  // centre mesh vertically at half its height
 	float wallThickness = 1.0f;		   // consistent thickness of each hedge wall
+	std::string wallName = name;
 
 	// Left side (aligned along Z)
-	DrawHedgeWall(
-		glm::vec3(centerPos.x - (length - wallThickness) * 0.5f, halfHeight, centerPos.z),
+	AddHedgeWall(
+		(wallName + " left").c_str(),
+		node,
+		glm::vec3(-(length - wallThickness) * 0.5f, halfHeight, 0.0f),
 		glm::vec3(wallThickness, height, width - wallThickness),
 		"Leaves2",
 		(width - wallThickness) * 0.5f,
@@ -782,8 +2476,10 @@ void SceneManager::DrawRectangularHedge(glm::vec3 centerPos, float length, float
 	);
 
 	// Right side (opposite side along Z)
-	DrawHedgeWall(
-		glm::vec3(centerPos.x + (length - wallThickness) * 0.5f, halfHeight, centerPos.z),
+	AddHedgeWall(
+		(wallName + " right").c_str(),
+		node,
+		glm::vec3((length - wallThickness) * 0.5f, halfHeight, 0.0f),
 		glm::vec3(wallThickness, height, width - wallThickness),
 		"Leaves2",
 		(width - wallThickness) * 0.5f,
@@ -791,8 +2487,10 @@ void SceneManager::DrawRectangularHedge(glm::vec3 centerPos, float length, float
 	);
 
 	// Front side (aligned along X)
-	DrawHedgeWall(
-		glm::vec3(centerPos.x, halfHeight, centerPos.z - (width - wallThickness) * 0.5f),
+	AddHedgeWall(
+		(wallName + " front").c_str(),
+		node,
+		glm::vec3(0.0f, halfHeight, -(width - wallThickness) * 0.5f),
 		glm::vec3(length, height, wallThickness),
 		"Leaves2",
 		length * 0.5f,
@@ -800,19 +2498,22 @@ void SceneManager::DrawRectangularHedge(glm::vec3 centerPos, float length, float
 	);
 
 	// Back side (opposite side along X)
-	DrawHedgeWall(
-		glm::vec3(centerPos.x, halfHeight, centerPos.z + (width - wallThickness) * 0.5f),
+	AddHedgeWall(
+		(wallName + " back").c_str(),
+		node,
+		glm::vec3(0.0f, halfHeight, (width - wallThickness) * 0.5f),
 		glm::vec3(length, height, wallThickness),
 		"Leaves2",
 		length * 0.5f,
 		height * 0.5f
 	);
+
+	return(node);
 }
 
-void SceneManager::DrawHedgeWall(glm::vec3 centerPos, glm::vec3 scaleXYZ, const char* textureName, float uvX, float uvY)
+int SceneManager::AddHedgeWall(const char* name, int parentNode, glm::vec3 centerPos, glm::vec3 scaleXYZ, const char* textureName, float uvX, float uvY)
 {
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, centerPos);
-	SetShaderTexture(textureName);
-	m_pShaderManager->setVec2Value("UVscale", uvX, uvY);
-	m_basicMeshes->DrawBoxMesh();
+	return(AddSceneObject(name, MESH_BOX, parentNode,
+		BuildModelMatrix(scaleXYZ, 0.0f, 0.0f, 0.0f, centerPos),
+		textureName, "TrimmedFoliage", glm::vec2(uvX, uvY)));
 }
@@ -10,10 +10,29 @@
 #pragma once
 
 #include "ShaderManager.h"
-#include "ShapeMeshes.h"
+#include "MeshLibrary.h"
+#include "RenderBackend.h"
+#include "GLRenderBackend.h"
+#include "RenderCapture.h"
+#include "SpatialGrid.h"
+#include "SceneGraph.h"
+#include "EntityStore.h"
+#include "FrameArena.h"
+#include "IndirectRenderer.h"
+#include "VirtualTexture.h"
+#include "Terrain.h"
+#include "ImpostorRenderer.h"
+#include "Lightmap.h"
+#include "SceneSnapshot.h"
+#include "SceneFile.h"
+#include "FileWatcher.h"
 
+#include <map>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 
 #include <glm/glm.hpp>
 #include <glm/vec3.hpp>
@@ -28,8 +47,10 @@
 class SceneManager
 {
 public:
-	// constructor
-	SceneManager(ShaderManager *pShaderManager);
+	// constructor; without a backend the scene is drawn with
+	// OpenGL and the shader manager's program, with one (not
+	// owned) it is drawn by the backend alone
+	SceneManager(ShaderManager *pShaderManager, RenderBackend* pBackend = NULL);
 	// destructor
 	~SceneManager();
 
@@ -37,6 +58,8 @@ public:
 	{
 		std::string tag;
 		uint32_t ID;
+		// image file the texture was decoded from
+		std::string filename;
 	};
 
 	struct OBJECT_MATERIAL
@@ -46,32 +69,177 @@ public:
 		glm::vec3 diffuseColor;
 		glm::vec3 specularColor;
 		float shininess;
+		// pass the surfaces are drawn in, the opacity of
+		// transparent ones and the cutoff of alpha tested ones
+		BLEND_MODE blendMode;
+		float opacity;
+		float alphaCutoff;
 		std::string tag;
 	};
 
+	struct LIGHT_SOURCE
+	{
+		// direction of directional lights
+		glm::vec3 position;
+		glm::vec3 ambientColor;
+		glm::vec3 diffuseColor;
+		glm::vec3 specularColor;
+		float focalStrength;
+		float specularIntensity;
+		bool bDirectional;
+	};
+
+	// one drawn object of the scene, with its transform and
+	// shading resolved once when the scene is prepared
+	struct SCENE_OBJECT
+	{
+		std::string name;
+		SCENE_MESH mesh;
+		// node of the object in the scene graph
+		int node;
+		// world transform of the node
+		glm::mat4 model;
+		std::string textureTag;
+		std::string materialTag;
+		glm::vec2 uvScale;
+		// virtual texture file sampled instead of the texture on
+		// the indirect path (empty = none)
+		std::string virtualTexture;
+		// only drawn in the perspective view
+		bool bPerspectiveOnly;
+		// render data of the object: transform, bounds, mesh,
+		// material and visibility
+		ENTITY entity;
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
-	// pointer to basic shapes object
-	ShapeMeshes* m_basicMeshes;
+	// pointer to basic meshes object
+	MeshLibrary* m_pMeshLibrary;
+	// draws the scene object by object; the OpenGL backend is
+	// owned (NULL with another backend)
+	RenderBackend* m_pBackend;
+	GLRenderBackend* m_pGLBackend;
+	// records the backend calls while capturing (owned)
+	RenderCapture* m_pCapture;
 	// total number of loaded textures
 	int m_loadedTextures;
 	// loaded textures info
 	TEXTURE_INFO m_textureIDs[16];
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// light sources of the scene
+	std::vector<LIGHT_SOURCE> m_sceneLights;
+	// objects of the scene in drawing order
+	std::vector<SCENE_OBJECT> m_sceneObjects;
+	// parent-relative transforms of the scene objects
+	SceneGraph* m_pSceneGraph;
+	// scene object of each scene graph node (-1 = group node)
+	std::vector<int> m_nodeObjects;
+	// scene graph node of each scene record (-1 = not placed)
+	std::vector<int> m_recordNodes;
+	// scene graph nodes of the named records, for parenting
+	std::map<std::string, int> m_namedNodes;
+	// renderable entities of the scene objects, for the
+	// culling and draw building of each frame
+	EntityStore* m_pEntities;
+	// transient lists of the frame being rendered
+	FrameArena* m_pFrameArena;
+	// spatial index over the scene objects
+	SpatialGrid* m_pSpatialGrid;
+	// multi-draw indirect path (NULL = draw object by object)
+	IndirectRenderer* m_pIndirectRenderer;
+	// use the indirect path when the context supports it
+	bool m_bMultiDrawEnabled;
+	// depth pre-pass of the indirect path's opaque objects
+	DEPTH_PREPASS_SETTINGS m_depthPrepassSettings;
+	// culling of the indirect path's opaque objects on the GPU
+	GPU_CULLING_SETTINGS m_gpuCullingSettings;
+	// streamed texture of the objects naming a virtual texture
+	// (NULL = none, or no indirect path)
+	VirtualTexture* m_pVirtualTexture;
+	VIRTUAL_TEXTURE_SETTINGS m_virtualTextureSettings;
+	// 1 for each object drawn with the virtual texture
+	std::vector<unsigned char> m_virtualTexturedObjects;
+	// heightfield the terrain object is drawn as on the indirect
+	// path (NULL = none); elsewhere it stays a flat plane
+	Terrain* m_pTerrain;
+	// scene object and shape of the terrain record (-1 = none)
+	int m_terrainObject;
+	TERRAIN_SHAPE m_terrainShape;
+	// a topiary drawn as an impostor when it is far away
+	struct IMPOSTOR_INSTANCE
+	{
+		int archetype;
+		// base node of the topiary, and its scene objects
+		int node;
+		uint32_t firstObject;
+		uint32_t objectCount;
+	};
+	// impostors of the distant topiaries on the indirect path
+	// (NULL = none; the topiaries are always meshes)
+	ImpostorRenderer* m_pImpostors;
+	IMPOSTOR_SETTINGS m_impostorSettings;
+	std::vector<IMPOSTOR_ARCHETYPE> m_impostorArchetypes;
+	std::vector<IMPOSTOR_INSTANCE> m_impostorInstances;
+	// impostor instance of each scene object (-1 = none)
+	std::vector<int> m_impostorObjects;
+	// baked diffuse light and ambient occlusion of the garden
+	// on the indirect path (NULL = none; lit per pixel)
+	Lightmap* m_pLightmap;
+	// set by the render thread while pages or tiles are loading,
+	// read by the main thread
+	std::atomic<bool> m_bStreaming;
+	// records of the scene file the scene is built from
+	std::vector<SCENE_RECORD> m_sceneRecords;
+
+	// watcher of the scene file and shaders (NULL = no hot reload)
+	FileWatcher* m_pFileWatcher;
+	// set by the main thread when a watched file was written,
+	// cleared by the render thread once the reload is applied
+	std::atomic<bool> m_bReloadPending;
+	// guards the members below, which both threads touch
+	std::mutex m_reloadMutex;
+	bool m_bSceneFileChanged;
+	bool m_bShadersChanged;
+	// when the first unapplied change was noticed
+	std::chrono::steady_clock::time_point m_reloadDetectedTime;
+	// objects to index once the main thread picks them up
+	std::vector<SCENE_OBJECT> m_pendingSpatialObjects;
+	bool m_bSpatialRebuildPending;
 
-	// load texture images and convert to OpenGL texture data
-	bool CreateGLTexture(const char* filename, std::string tag);
-	// bind loaded OpenGL textures to slots in memory
-	void BindGLTextures();
-	// free the loaded OpenGL textures
-	void DestroyGLTextures();
+	// load texture images and convert to backend texture data
+	bool CreateTexture(const char* filename, std::string tag);
+	// load a texture into a slot that is already in use
+	bool ReplaceTexture(int slot, const char* filename);
+	// bind loaded textures to slots in memory
+	void BindTextures();
+	// free the loaded textures
+	void DestroyTextures();
 	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
+	int FindTextureID(const std::string& tag);
+	int FindTextureSlot(const std::string& tag);
 	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	bool FindMaterial(const std::string& tag, OBJECT_MATERIAL& material);
+	int FindMaterialIndex(const std::string& tag);
+	// the visible entities in drawing order: opaque front to
+	// back, then alpha tested front to back, then transparent
+	// back to front; returns the count before the transparent
+	// ones in opaqueCount
+	const uint32_t* SortVisibleEntities(const uint32_t* visibleEntities, size_t visibleCount, const glm::mat4& view,
+		size_t& opaqueCount);
+	// compare the frame's GPU culling with the CPU culling of
+	// the same entities (--gpu-culling-check)
+	void ValidateGPUCulling(const glm::vec4 frustumPlanes[6], uint8_t hiddenFlags, const float* impostorFades);
+
+	// build the model matrix from the transformation values
+	static glm::mat4 BuildModelMatrix(
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
 
 	// set the transformation values 
 	// into the transform buffer
@@ -91,7 +259,9 @@ private:
 
 	// set the texture data into the shader
 	void SetShaderTexture(
-		std::string textureTag);
+		const std::string& textureTag);
+	// set the texture of a slot found beforehand into the shader
+	void SetShaderTextureSlot(int textureSlot);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -99,7 +269,66 @@ private:
 
 	// set the object material into the shader
 	void SetShaderMaterial(
-		std::string materialTag);
+		const std::string& materialTag);
+	// set a material found beforehand into the shader
+	void SetShaderMaterial(int materialIndex);
+
+	// append a light source to the scene lights
+	void AddSceneLight(glm::vec3 position, glm::vec3 ambientColor, glm::vec3 diffuseColor, glm::vec3 specularColor,
+		float focalStrength, float specularIntensity, bool bDirectional);
+	// create the indirect renderer if it is enabled and supported
+	void CreateIndirectRenderer();
+	// build its depth pre-pass once the meshes are uploaded
+	void CreateDepthPrepass();
+	// build its GPU culling once the meshes are uploaded
+	void CreateGPUCulling();
+	// open the virtual texture the scene objects name
+	void CreateVirtualTexture();
+	// upload the object and material data of the indirect path
+	void UploadIndirectSceneData();
+	// hand the objects the GPU culling can take to it, after
+	// the terrain and impostors are set up
+	void UploadCullingData();
+	// create the terrain for the terrain record, or update it
+	// after a rebuild of the scene objects
+	void CreateTerrain();
+	// bake or load the impostor atlases of the topiaries
+	void CreateImpostors();
+	// shader variant the impostors are drawn with
+	SHADER_VARIANT ImpostorVariant() const;
+	// load the baked lightmap for the indirect path
+	void CreateLightmap();
+	// the scene objects, lights and terrain as the lightmap
+	// baker sees them
+	void BuildLightmapScene(LIGHTMAP_SCENE& scene);
+	// the distinct topiary shapes of the records, and the
+	// archetype of each record (-1 = none)
+	static void CollectImpostorArchetypes(const std::vector<SCENE_RECORD>& records,
+		std::vector<IMPOSTOR_ARCHETYPE>& archetypes, std::vector<int>& recordArchetypes);
+	// body and tip transforms of a topiary relative to its base
+	static void TopiaryTransforms(float cylinderHeight, float cylinderRadius, glm::mat4& body, glm::mat4& tip);
+	// read the scene file into the scene records
+	bool LoadSceneFile();
+	// transform of a layout record relative to its parent
+	glm::mat4 RecordTransform(const SCENE_RECORD& record);
+	// add a scene graph node for a group of objects
+	int AddGroupNode(int parentNode, glm::mat4 localTransform);
+	// move the records whose transform alone changed; false if
+	// anything else changed and the scene must be rebuilt
+	bool MoveChangedRecords(const std::vector<SCENE_RECORD>& previousRecords, size_t& movedObjects);
+	// update the world transforms and bounds of moved objects
+	size_t UpdateSceneTransforms();
+	// shape of a basic mesh in its local space
+	static SPATIAL_SHAPE MeshShape(SCENE_MESH mesh);
+	// bounding sphere of a basic mesh in its local space (xyz =
+	// center, w = radius)
+	static glm::vec4 MeshBoundingSphere(SCENE_MESH mesh);
+	// hand the scene objects to the main thread for indexing
+	void QueueSpatialRebuild();
+	// rebuild the spatial grid from the queued objects
+	void ApplySpatialRebuild();
+	// rebuild what changed in the watched files (render thread)
+	void ApplyHotReload();
 
 public:
 
@@ -108,10 +337,54 @@ public:
 	void PrepareScene();
 	void DefineObjectMaterials();
 	void SetupSceneLights();
-	void RenderScene(bool bOrthographic);
-	void DrawCylinderWithSphereTip(glm::vec3 basePos, float cylinderHeight, float cylinderRadius);
-	void DrawRectangularHedge(glm::vec3 centerPos, float length, float width, float height);
-	void DrawHedgeWall(glm::vec3 centerPos, glm::vec3 scaleXYZ, const char* textureName, float uvX, float uvY);
+	void BuildSceneObjects();
+	void RenderScene(const SCENE_SNAPSHOT& snapshot);
+	// the helpers below add scene graph nodes under parentNode
+	// (-1 = root) with transforms relative to it
+	int AddSceneObject(const char* name, SCENE_MESH mesh, int parentNode, glm::mat4 localTransform, const char* textureTag, const char* materialTag, glm::vec2 uvScale);
+	int AddCylinderWithSphereTip(const char* name, int parentNode, glm::mat4 localTransform, float cylinderHeight, float cylinderRadius);
+	int AddRectangularHedge(const char* name, int parentNode, glm::mat4 localTransform, float length, float width, float height);
+	int AddHedgeWall(const char* name, int parentNode, glm::vec3 centerPos, glm::vec3 scaleXYZ, const char* textureName, float uvX, float uvY);
 	// loads textures from image files
 	void LoadSceneTextures();
+
+	// vertex layout of the mesh buffers; set before PrepareScene()
+	void SetVertexFormat(VERTEX_FORMAT format) { m_pMeshLibrary->SetVertexFormat(format); }
+	// draw with one multi-draw indirect call; set before PrepareScene()
+	void SetMultiDrawEnabled(bool bEnabled) { m_bMultiDrawEnabled = bEnabled; }
+	// depth pre-pass mode of the multi-draw path; set before
+	// PrepareScene()
+	void SetDepthPrepassSettings(const DEPTH_PREPASS_SETTINGS& settings) { m_depthPrepassSettings = settings; }
+	// GPU culling of the multi-draw path; set before
+	// PrepareScene()
+	void SetGPUCullingSettings(const GPU_CULLING_SETTINGS& settings) { m_gpuCullingSettings = settings; }
+	// memory budgets of the virtual texture; set before PrepareScene()
+	void SetVirtualTextureSettings(const VIRTUAL_TEXTURE_SETTINGS& settings) { m_virtualTextureSettings = settings; }
+	// record the backend calls of the setup and the next frames
+	// to a file for RenderReplay; call before PrepareScene()
+	bool StartCapture(const char* filename, int frameCount);
+	// true while virtual texture pages or terrain tiles in view
+	// are loading, so frames should keep being drawn; the flag
+	// the render thread last stored, safe on the main thread
+	bool IsStreaming() const { return m_bStreaming.load(); }
+	// ask the virtual texture and the terrain whether they are
+	// streaming and store the answer for IsStreaming() (render
+	// thread, which owns them, after each frame)
+	bool UpdateStreaming();
+
+	// spatial index of the scene objects, for picking and collision
+	const SpatialGrid* GetSpatialGrid() const { return m_pSpatialGrid; }
+
+	// bake the impostor atlases of the scene file into the cache
+	// without a GL context
+	static bool BakeImpostors();
+	// bake the lightmap of the scene file on the CPU without a
+	// GL context
+	static bool BakeLightmaps(const LIGHTMAP_SETTINGS& settings);
+
+	// watch the scene file and shaders; call after PrepareScene()
+	void EnableHotReload();
+	// check the watched files (main thread, once per loop); true
+	// if a reload was queued and the scene needs to be redrawn
+	bool CheckForChanges();
 };
\ No newline at end of file
@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenesnapshot.cpp
+// ============
+// immutable per-frame scene state handed from the simulation thread
+// to the render thread through a double buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneSnapshot.h"
+
+#include <chrono>
+
+/***********************************************************
+ *  SnapshotBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SnapshotBuffer::SnapshotBuffer()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		m_slots[i].frameIndex = 0;
+		m_slots[i].simulationTime = 0.0;
+		m_slots[i].deltaTime = 0.0f;
+		m_slots[i].view = glm::mat4(1.0f);
+		m_slots[i].projection = glm::mat4(1.0f);
+		m_slots[i].viewPosition = glm::vec3(0.0f);
+		m_slots[i].bOrthographic = false;
+	}
+	m_writeIndex = 0;
+	m_bHasSnapshot = false;
+	m_bConsumed = true;
+	m_bShutdown = false;
+}
+
+/***********************************************************
+ *  ~SnapshotBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SnapshotBuffer::~SnapshotBuffer()
+{
+	Shutdown();
+}
+
+/***********************************************************
+ *  BeginWrite()
+ *
+ *  This method returns the back slot.  Only the producer
+ *  thread touches it, so no lock is needed while filling it.
+ ***********************************************************/
+SCENE_SNAPSHOT& SnapshotBuffer::BeginWrite()
+{
+	return(m_slots[m_writeIndex]);
+}
+
+/***********************************************************
+ *  Publish()
+ *
+ *  This method flips the freshly written back slot to the
+ *  front and wakes up the consumer.
+ ***********************************************************/
+void SnapshotBuffer::Publish()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_writeIndex ^= 1;
+		m_bHasSnapshot = true;
+		m_bConsumed = false;
+	}
+	m_published.notify_one();
+}
+
+/***********************************************************
+ *  WaitForConsumer()
+ *
+ *  This method keeps the producer at most one snapshot ahead
+ *  of the consumer, so simulation of frame N+1 overlaps the
+ *  drawing of frame N instead of racing ahead of it.
+ ***********************************************************/
+bool SnapshotBuffer::WaitForConsumer(double timeoutSeconds)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return(m_consumed.wait_for(lock,
+		std::chrono::duration<double>(timeoutSeconds),
+		[this] { return m_bConsumed || m_bShutdown; }));
+}
+
+/***********************************************************
+ *  WaitForLatest()
+ *
+ *  This method blocks until a snapshot newer than the one the
+ *  consumer last drew has been published, then copies it out.
+ ***********************************************************/
+bool SnapshotBuffer::WaitForLatest(SCENE_SNAPSHOT& snapshot, unsigned long long lastFrameIndex)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_published.wait(lock, [this, lastFrameIndex] {
+			return m_bShutdown ||
+				(m_bHasSnapshot && m_slots[m_writeIndex ^ 1].frameIndex != lastFrameIndex);
+		});
+
+		if (m_bShutdown)
+		{
+			return(false);
+		}
+
+		// the front slot is the one the producer is not writing
+		snapshot = m_slots[m_writeIndex ^ 1];
+		m_bConsumed = true;
+	}
+	m_consumed.notify_one();
+
+	return(true);
+}
+
+/***********************************************************
+ *  Shutdown()
+ *
+ *  This method releases any thread waiting on the buffer.
+ ***********************************************************/
+void SnapshotBuffer::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bShutdown = true;
+	}
+	m_published.notify_all();
+	m_consumed.notify_all();
+}
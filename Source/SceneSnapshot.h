@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenesnapshot.h
+// ============
+// immutable per-frame scene state handed from the simulation thread
+// to the render thread through a double buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  SCENE_SNAPSHOT
+ *
+ *  Everything the render thread needs to draw one frame.
+ *  Once published, a snapshot is never modified again; the
+ *  render thread only ever works on its own copy.
+ ***********************************************************/
+struct SCENE_SNAPSHOT
+{
+	// sequence number of the simulation step that built it
+	unsigned long long frameIndex;
+	// time (in seconds) at which the simulation step ran
+	double simulationTime;
+	// time between this simulation step and the previous one
+	float deltaTime;
+
+	// camera matrices and position for the shader
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 viewPosition;
+	// true = orthographic, false = perspective
+	bool bOrthographic;
+
+	// size of the window's framebuffer in pixels; read on the
+	// main thread, as GLFW allows nowhere else
+	int framebufferWidth;
+	int framebufferHeight;
+};
+
+/***********************************************************
+ *  SnapshotBuffer
+ *
+ *  Double buffer of SCENE_SNAPSHOT objects.  The producer
+ *  fills its private back slot without holding any lock and
+ *  then flips it to the front with Publish().  The consumer
+ *  copies the front slot out under the lock, so neither side
+ *  ever sees a half-written snapshot.
+ ***********************************************************/
+class SnapshotBuffer
+{
+public:
+	// constructor
+	SnapshotBuffer();
+	// destructor
+	~SnapshotBuffer();
+
+	// producer: get the back slot to fill for the next frame
+	SCENE_SNAPSHOT& BeginWrite();
+	// producer: make the back slot the latest snapshot
+	void Publish();
+	// producer: block until the consumer has taken the latest
+	// snapshot, or until the timeout (in seconds) expires
+	bool WaitForConsumer(double timeoutSeconds);
+
+	// consumer: wait for a snapshot newer than lastFrameIndex and
+	// copy it out; returns false once Shutdown() has been called
+	bool WaitForLatest(SCENE_SNAPSHOT& snapshot, unsigned long long lastFrameIndex);
+
+	// wake up and release both sides so the threads can exit
+	void Shutdown();
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_published;
+	std::condition_variable m_consumed;
+
+	// the two snapshot slots
+	SCENE_SNAPSHOT m_slots[2];
+	// index of the slot owned by the producer
+	int m_writeIndex;
+	// true once at least one snapshot has been published
+	bool m_bHasSnapshot;
+	// true when the consumer has copied the latest snapshot
+	bool m_bConsumed;
+	// true once Shutdown() has been called
+	bool m_bShutdown;
+};
@@ -0,0 +1,480 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadervariantcache.cpp
+// ============
+// build specialized shader programs from #define permutations and keep
+// the linked program binaries on disk
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderVariantCache.h"
+#include "FileUtility.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	const char g_BinaryMagic[4] = { 'T', 'G', 'P', 'B' };
+
+	// header of a program binary cache file, followed by the
+	// binary itself
+	struct PROGRAM_BINARY_HEADER
+	{
+		char magic[4];
+		GLenum binaryFormat;
+		uint32_t binaryLength;
+		uint32_t reserved;
+	};
+
+	/***********************************************************
+	 *  ReadTextFile()
+	 *
+	 *  Reads a whole text file into a string.
+	 ***********************************************************/
+	bool ReadTextFile(const char* filename, std::string& text)
+	{
+		std::ifstream file(filename);
+		if (!file)
+		{
+			return(false);
+		}
+		std::stringstream stream;
+		stream << file.rdbuf();
+		text = stream.str();
+		return(true);
+	}
+
+	/***********************************************************
+	 *  CompileShader()
+	 *
+	 *  Compiles one shader stage, printing the log on failure.
+	 ***********************************************************/
+	GLuint CompileShader(GLenum type, const std::string& source)
+	{
+		GLuint shader = glCreateShader(type);
+		const char* text = source.c_str();
+		glShaderSource(shader, 1, &text, NULL);
+		glCompileShader(shader);
+
+		GLint success = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			char infoLog[1024];
+			glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+			std::cout << "Shader compilation failed:" << std::endl << infoLog << std::endl;
+			glDeleteShader(shader);
+			return(0);
+		}
+		return(shader);
+	}
+
+	/***********************************************************
+	 *  LinkProgram()
+	 *
+	 *  Links a program with its shaders attached, printing the
+	 *  log and deleting the program on failure.
+	 ***********************************************************/
+	GLuint LinkProgram(GLuint program)
+	{
+		glLinkProgram(program);
+
+		GLint success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			char infoLog[1024];
+			glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+			std::cout << "Shader program linking failed:" << std::endl << infoLog << std::endl;
+			glDeleteProgram(program);
+			return(0);
+		}
+		return(program);
+	}
+
+	/***********************************************************
+	 *  PackVariant()
+	 *
+	 *  Packs a variant into a map key.
+	 ***********************************************************/
+	uint32_t PackVariant(const SHADER_VARIANT& variant)
+	{
+		return((variant.bTextured ? 1u : 0u) | (variant.bLit ? 2u : 0u) | (variant.bVirtualTextured ? 4u : 0u) |
+			(variant.bAlphaTested ? 8u : 0u) | ((uint32_t)variant.lightCount << 4) |
+			(variant.bLightmapped ? 0x200u : 0u));
+	}
+}
+
+/***********************************************************
+ *  ShaderVariantCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderVariantCache::ShaderVariantCache(const char* cacheDirectory)
+	: m_directory(cacheDirectory)
+{
+}
+
+/***********************************************************
+ *  ~ShaderVariantCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderVariantCache::~ShaderVariantCache()
+{
+	DestroyPrograms();
+}
+
+/***********************************************************
+ *  LoadSources()
+ *
+ *  This method reads the shader files and notes the driver
+ *  the binaries will be built by.  Needs a current context.
+ ***********************************************************/
+bool ShaderVariantCache::LoadSources(const char* vertexShaderFile, const char* fragmentShaderFile)
+{
+	if (!ReadTextFile(vertexShaderFile, m_vertexSource))
+	{
+		std::cout << "Could not read shader file:" << vertexShaderFile << std::endl;
+		return(false);
+	}
+	if (!ReadTextFile(fragmentShaderFile, m_fragmentSource))
+	{
+		std::cout << "Could not read shader file:" << fragmentShaderFile << std::endl;
+		return(false);
+	}
+
+	m_driverString.clear();
+	const GLenum names[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (int i = 0; i < 3; i++)
+	{
+		const GLubyte* value = glGetString(names[i]);
+		if (value != NULL)
+			m_driverString += (const char*)value;
+		m_driverString += "\n";
+	}
+
+	// programs built from the previous sources are stale
+	DestroyPrograms();
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetProgram()
+ *
+ *  This method returns the program of a variant, building
+ *  it from the binary cache or the sources on first use and
+ *  reporting how long that took.
+ ***********************************************************/
+GLuint ShaderVariantCache::GetProgram(const SHADER_VARIANT& variant)
+{
+	uint32_t packed = PackVariant(variant);
+	std::map<uint32_t, GLuint>::const_iterator found = m_programs.find(packed);
+	if (found != m_programs.end())
+	{
+		return(found->second);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::string vertexSource = BuildSource(m_vertexSource, variant);
+	std::string fragmentSource = BuildSource(m_fragmentSource, variant);
+	uint64_t key = HASH_SEED;
+	key = HashString(key, vertexSource);
+	key = HashString(key, fragmentSource);
+	key = HashString(key, m_driverString);
+
+	bool bFromCache = true;
+	GLuint program = LoadProgramBinary(key);
+	if (program == 0)
+	{
+		bFromCache = false;
+		program = CompileProgram(vertexSource, fragmentSource);
+		if (program == 0)
+		{
+			std::cout << "Could not build shader variant:" << VariantName(variant) << std::endl;
+			return(0);
+		}
+		StoreProgramBinary(key, program);
+	}
+	m_programs[packed] = program;
+
+	double elapsed = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+	std::cout << "Shader variant " << VariantName(variant) << ": "
+		<< (bFromCache ? "loaded from binary cache" : "compiled") << " in " << elapsed << " ms" << std::endl;
+
+	return(program);
+}
+
+/***********************************************************
+ *  DestroyPrograms()
+ *
+ *  This method deletes all built programs.
+ ***********************************************************/
+void ShaderVariantCache::DestroyPrograms()
+{
+	std::map<uint32_t, GLuint>::iterator it;
+	for (it = m_programs.begin(); it != m_programs.end(); ++it)
+	{
+		glDeleteProgram(it->second);
+	}
+	m_programs.clear();
+}
+
+/***********************************************************
+ *  VariantName()
+ *
+ *  This method returns a short name of a variant, such as
+ *  "textured_lit3".
+ ***********************************************************/
+std::string ShaderVariantCache::VariantName(const SHADER_VARIANT& variant)
+{
+	std::ostringstream name;
+	if (variant.bVirtualTextured)
+		name << "virtual_";
+	else
+		name << (variant.bTextured ? "textured" : "untextured") << "_";
+	if (variant.bLit)
+		name << "lit" << variant.lightCount;
+	else
+		name << "unlit";
+	if (variant.bLit && variant.bLightmapped)
+		name << "_lightmap";
+	if (variant.bAlphaTested)
+		name << "_alphatest";
+	return(name.str());
+}
+
+/***********************************************************
+ *  BuildComputeProgram()
+ *
+ *  This method compiles and links a compute shader on its
+ *  own.  The compute shaders are few and small, so they are
+ *  not worth a binary cache.
+ ***********************************************************/
+GLuint ShaderVariantCache::BuildComputeProgram(const char* shaderFile)
+{
+	std::string source;
+	if (!ReadTextFile(shaderFile, source))
+	{
+		std::cout << "Could not read shader file:" << shaderFile << std::endl;
+		return(0);
+	}
+
+	GLuint shader = CompileShader(GL_COMPUTE_SHADER, source);
+	if (shader == 0)
+	{
+		std::cout << "Could not build compute shader:" << shaderFile << std::endl;
+		return(0);
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, shader);
+	program = LinkProgram(program);
+	glDeleteShader(shader);
+	return(program);
+}
+
+/***********************************************************
+ *  BuildSource()
+ *
+ *  This method inserts the variant's defines right after
+ *  the #version line, which has to stay first.  The shaders
+ *  are written for GLSL 4.60; on an OpenGL 4.5 context (such
+ *  as Mesa's software renderer) they are compiled as 4.50
+ *  with ARB_shader_draw_parameters, whose gl_BaseInstanceARB
+ *  stands in for gl_BaseInstance.
+ ***********************************************************/
+std::string ShaderVariantCache::BuildSource(const std::string& source, const SHADER_VARIANT& variant) const
+{
+	std::ostringstream defines;
+	defines << "#define TEXTURED " << (variant.bTextured ? 1 : 0) << "\n";
+	defines << "#define VIRTUAL_TEXTURED " << (variant.bVirtualTextured ? 1 : 0) << "\n";
+	defines << "#define LIT " << (variant.bLit ? 1 : 0) << "\n";
+	defines << "#define LIGHT_COUNT " << (variant.bLit ? variant.lightCount : 0) << "\n";
+	defines << "#define LIGHTMAPPED " << ((variant.bLit && variant.bLightmapped) ? 1 : 0) << "\n";
+	defines << "#define ALPHA_TESTED " << (variant.bAlphaTested ? 1 : 0) << "\n";
+
+	size_t insertAt = 0;
+	size_t version = source.find("#version");
+	if (version != std::string::npos)
+	{
+		size_t lineEnd = source.find('\n', version);
+		insertAt = (lineEnd == std::string::npos) ? source.size() : lineEnd + 1;
+	}
+
+	if (!GLEW_VERSION_4_6)
+	{
+		defines << "#extension GL_ARB_shader_draw_parameters : require\n";
+	}
+
+	std::string result = source;
+	result.insert(insertAt, defines.str());
+	if (!GLEW_VERSION_4_6)
+	{
+		size_t found = result.find("#version 460");
+		if (found != std::string::npos)
+		{
+			result.replace(found, 12, "#version 450");
+		}
+		for (found = result.find("gl_BaseInstance"); found != std::string::npos;
+			found = result.find("gl_BaseInstance", found + 1))
+		{
+			if (result.compare(found, 18, "gl_BaseInstanceARB") != 0)
+				result.insert(found + 15, "ARB");
+		}
+	}
+	return(result);
+}
+
+/***********************************************************
+ *  CompileProgram()
+ *
+ *  This method compiles and links a program, asking the
+ *  driver to keep the binary retrievable for the cache.
+ ***********************************************************/
+GLuint ShaderVariantCache::CompileProgram(const std::string& vertexSource, const std::string& fragmentSource) const
+{
+	GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, vertexSource);
+	GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	if ((vertexShader == 0) || (fragmentShader == 0))
+	{
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return(0);
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	program = LinkProgram(program);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+	return(program);
+}
+
+/***********************************************************
+ *  LoadProgramBinary()
+ *
+ *  This method creates a program from a cached binary.  The
+ *  driver may still reject a binary (it is free to do so
+ *  for any reason), in which case 0 is returned and the
+ *  program gets compiled from source.
+ ***********************************************************/
+GLuint ShaderVariantCache::LoadProgramBinary(uint64_t key) const
+{
+	std::ifstream file(CacheFilename(key).c_str(), std::ios::binary);
+	if (!file)
+	{
+		return(0);
+	}
+
+	PROGRAM_BINARY_HEADER header;
+	file.read((char*)&header, sizeof(header));
+	if (!file.good() || (memcmp(header.magic, g_BinaryMagic, sizeof(g_BinaryMagic)) != 0))
+	{
+		return(0);
+	}
+
+	std::vector<char> binary(header.binaryLength);
+	file.read(binary.data(), binary.size());
+	if (!file.good())
+	{
+		return(0);
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+	GLint success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(program);
+		return(0);
+	}
+
+	return(program);
+}
+
+/***********************************************************
+ *  StoreProgramBinary()
+ *
+ *  This method writes the binary of a linked program to the
+ *  cache, through a temporary file like the mesh cache.
+ ***********************************************************/
+bool ShaderVariantCache::StoreProgramBinary(uint64_t key, GLuint program) const
+{
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if ((formatCount == 0) || (length <= 0))
+	{
+		// the driver does not hand out binaries
+		return(false);
+	}
+
+	PROGRAM_BINARY_HEADER header;
+	memcpy(header.magic, g_BinaryMagic, sizeof(g_BinaryMagic));
+	header.binaryFormat = 0;
+	header.reserved = 0;
+
+	std::vector<char> binary(length);
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &header.binaryFormat, binary.data());
+	header.binaryLength = (uint32_t)written;
+
+	MakeDirectory(m_directory);
+
+	std::string filename = CacheFilename(key);
+	std::string tempFilename = filename + ".tmp";
+	{
+		std::ofstream file(tempFilename.c_str(), std::ios::binary);
+		if (!file)
+		{
+			std::cout << "Could not create shader cache file:" << tempFilename << std::endl;
+			return(false);
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write(binary.data(), written);
+		if (!file.good())
+		{
+			std::cout << "Could not write shader cache file:" << tempFilename << std::endl;
+			return(false);
+		}
+	}
+
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::cout << "Could not replace shader cache file:" << filename << std::endl;
+		std::remove(tempFilename.c_str());
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  CacheFilename()
+ *
+ *  This method returns the cache file of a program key.
+ ***********************************************************/
+std::string ShaderVariantCache::CacheFilename(uint64_t key) const
+{
+	std::ostringstream name;
+	name << m_directory << "/program_"
+		<< std::hex << std::setw(16) << std::setfill('0') << key
+		<< ".bin";
+	return(name.str());
+}
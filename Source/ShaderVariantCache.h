@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadervariantcache.h
+// ============
+// build specialized shader programs from #define permutations and keep
+// the linked program binaries on disk
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <cstdint>
+
+#include <GL/glew.h>
+
+// most light sources a shader variant can be built for
+const int SHADER_MAX_LIGHTS = 4;
+
+/***********************************************************
+ *  SHADER_VARIANT
+ *
+ *  One permutation of the shader sources.  Each field turns
+ *  into a #define, so the compiler removes the branches and
+ *  unrolls the light loop instead of the shader testing
+ *  uniforms for every fragment:
+ *
+ *    TEXTURED     - sample the object texture (else the
+ *                   material's diffuse color is the base)
+ *    VIRTUAL_TEXTURED - sample the streamed virtual texture
+ *                   instead of an object texture
+ *    LIT          - apply the light sources (else unlit)
+ *    LIGHT_COUNT  - number of light sources to loop over
+ *    LIGHTMAPPED  - take the diffuse light and the ambient
+ *                   occlusion from the baked lightmap
+ *    ALPHA_TESTED - drop fragments whose alpha is below the
+ *                   material's cutoff
+ ***********************************************************/
+struct SHADER_VARIANT
+{
+	bool bTextured;
+	bool bVirtualTextured;
+	bool bLit;
+	int lightCount;
+	bool bLightmapped;
+	bool bAlphaTested;
+};
+
+/***********************************************************
+ *  ShaderVariantCache
+ *
+ *  Builds and owns the programs of all variants of one pair
+ *  of vertex / fragment shader files.  A variant is built on
+ *  first use: the linked program is loaded from the program
+ *  binary cache when an entry exists for the same sources,
+ *  defines and driver, and otherwise compiled from source
+ *  and stored with glGetProgramBinary() for the next start.
+ *
+ *  Binary cache files are named after a 64-bit hash of the
+ *  preprocessed sources and the GL vendor, renderer and
+ *  version strings, so a driver update or a shader edit
+ *  simply misses the cache.
+ ***********************************************************/
+class ShaderVariantCache
+{
+public:
+	// constructor
+	ShaderVariantCache(const char* cacheDirectory);
+	// destructor
+	~ShaderVariantCache();
+
+	// read the shader sources all variants are built from
+	bool LoadSources(const char* vertexShaderFile, const char* fragmentShaderFile);
+	// get (building if needed) the program of a variant;
+	// returns 0 if it could not be built
+	GLuint GetProgram(const SHADER_VARIANT& variant);
+	// delete all built programs
+	void DestroyPrograms();
+
+	// short name of a variant, for messages
+	static std::string VariantName(const SHADER_VARIANT& variant);
+	// build a compute program from its file, without variants
+	// or the binary cache; returns 0 if it could not be built
+	static GLuint BuildComputeProgram(const char* shaderFile);
+
+private:
+	// source of a shader with the variant's defines inserted
+	std::string BuildSource(const std::string& source, const SHADER_VARIANT& variant) const;
+	// compile and link a program from source
+	GLuint CompileProgram(const std::string& vertexSource, const std::string& fragmentSource) const;
+	// load / store a linked program in the binary cache
+	GLuint LoadProgramBinary(uint64_t key) const;
+	bool StoreProgramBinary(uint64_t key, GLuint program) const;
+	std::string CacheFilename(uint64_t key) const;
+
+	std::string m_directory;
+	std::string m_vertexSource;
+	std::string m_fragmentSource;
+	// GL vendor, renderer and version, part of every cache key
+	std::string m_driverString;
+	// programs built so far, by packed variant
+	std::map<uint32_t, GLuint> m_programs;
+};
@@ -0,0 +1,948 @@
+///////////////////////////////////////////////////////////////////////////////
+// softwarerasterizer.cpp
+// ============
+// draw the scene on the CPU: a tile-binned, multithreaded rasterizer with
+// the shading of the scene shaders
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SoftwareRasterizer.h"
+
+#include <emmintrin.h>
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// size of the scene window
+	const int g_DefaultWidth = 1000;
+	const int g_DefaultHeight = 800;
+	const int g_DefaultTileSize = 64;
+	// texture slots, as on units 0 - 15
+	const int g_TextureSlots = 16;
+	// covered pixels of each 4-bit quad mask
+	const int g_QuadPixels[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+	// milliseconds since a point in time
+	double MillisecondsSince(const std::chrono::steady_clock::time_point& start)
+	{
+		return(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	/***********************************************************
+	 *  PackColor()
+	 *
+	 *  RGBA in 0 - 1 to the bytes of a texel, red first.
+	 ***********************************************************/
+	uint32_t PackColor(const glm::vec4& color)
+	{
+		uint32_t r = (uint32_t)(std::min(std::max(color.r, 0.0f), 1.0f) * 255.0f + 0.5f);
+		uint32_t g = (uint32_t)(std::min(std::max(color.g, 0.0f), 1.0f) * 255.0f + 0.5f);
+		uint32_t b = (uint32_t)(std::min(std::max(color.b, 0.0f), 1.0f) * 255.0f + 0.5f);
+		uint32_t a = (uint32_t)(std::min(std::max(color.a, 0.0f), 1.0f) * 255.0f + 0.5f);
+		return(r | (g << 8) | (b << 16) | (a << 24));
+	}
+
+	glm::vec4 UnpackColor(uint32_t texel)
+	{
+		return(glm::vec4((float)(texel & 0xff), (float)((texel >> 8) & 0xff), (float)((texel >> 16) & 0xff),
+			(float)(texel >> 24)) * (1.0f / 255.0f));
+	}
+
+	/***********************************************************
+	 *  LerpVertex()
+	 *
+	 *  A vertex between two clip space vertices.
+	 ***********************************************************/
+	template <typename VERTEX>
+	VERTEX LerpVertex(const VERTEX& a, const VERTEX& b, float t)
+	{
+		VERTEX vertex;
+		vertex.position = a.position + (b.position - a.position) * t;
+		vertex.world = a.world + (b.world - a.world) * t;
+		vertex.normal = a.normal + (b.normal - a.normal) * t;
+		vertex.uv = a.uv + (b.uv - a.uv) * t;
+		return(vertex);
+	}
+}
+
+/***********************************************************
+ *  SoftwareRasterizer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SoftwareRasterizer::SoftwareRasterizer(const SOFTWARE_RASTERIZER_SETTINGS& settings)
+{
+	m_settings = settings;
+	m_settings.width = std::max(m_settings.width, 1);
+	m_settings.height = std::max(m_settings.height, 1);
+	m_settings.tileSize = std::max((m_settings.tileSize + 1) & ~1, 2);
+	if (m_settings.threadCount <= 0)
+	{
+		m_settings.threadCount = std::max((int)std::thread::hardware_concurrency(), 1);
+	}
+
+	m_stride = (m_settings.width + 1) & ~1;
+	m_paddedHeight = (m_settings.height + 1) & ~1;
+	m_color.assign((size_t)m_stride * m_paddedHeight, 0);
+	m_depth.assign((size_t)m_stride * m_paddedHeight, 1.0f);
+
+	m_tilesX = (m_settings.width + m_settings.tileSize - 1) / m_settings.tileSize;
+	m_tilesY = (m_settings.height + m_settings.tileSize - 1) / m_settings.tileSize;
+	m_bins.resize((size_t)m_tilesX * m_tilesY);
+
+	for (int i = 0; i < g_TextureSlots; i++)
+	{
+		m_slotTextures[i] = 0;
+	}
+	m_output = SOFTWARE_OUTPUT_SHADED;
+	m_viewProjection = glm::mat4(1.0f);
+	m_viewPosition = glm::vec3(0.0f);
+	m_viewForward = glm::vec3(0.0f, 0.0f, -1.0f);
+	m_bOrthographic = false;
+	m_bDrawStatistics = false;
+	m_coveredPixels = 0;
+	m_drawIndex = 0;
+
+	m_frameGeneration = 0;
+	m_busyWorkers = 0;
+	m_bStopping = false;
+	m_nextTile = 0;
+	for (int i = 1; i < m_settings.threadCount; i++)
+	{
+		m_workers.push_back(std::thread(&SoftwareRasterizer::Run, this));
+	}
+}
+
+/***********************************************************
+ *  ~SoftwareRasterizer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SoftwareRasterizer::~SoftwareRasterizer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_wake.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		delete m_textures[i];
+	}
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings of a frame the size of
+ *  the scene window.
+ ***********************************************************/
+SOFTWARE_RASTERIZER_SETTINGS SoftwareRasterizer::DefaultSettings()
+{
+	SOFTWARE_RASTERIZER_SETTINGS settings;
+	settings.width = g_DefaultWidth;
+	settings.height = g_DefaultHeight;
+	settings.threadCount = 0;
+	settings.tileSize = g_DefaultTileSize;
+	return(settings);
+}
+
+/***********************************************************
+ *  LoadMeshes()
+ *
+ *  This method generates the basic meshes.
+ ***********************************************************/
+void SoftwareRasterizer::LoadMeshes()
+{
+	for (int i = 0; i < MESH_COUNT; i++)
+	{
+		MeshGenerator::Generate(MeshGenerator::DefaultParams((SCENE_MESH)i), m_meshes[i]);
+	}
+}
+
+/***********************************************************
+ *  CreateTexture()
+ *
+ *  This method converts an RGB or RGBA image to RGBA texels
+ *  and builds its mip chain by averaging 2 x 2 texels, down
+ *  to 1 x 1.
+ ***********************************************************/
+unsigned int SoftwareRasterizer::CreateTexture(const unsigned char* image, int width, int height, int channels)
+{
+	if (((channels != 3) && (channels != 4)) || (width <= 0) || (height <= 0))
+	{
+		std::cout << "Not implemented to handle image with " << channels << " channels" << std::endl;
+		return(0);
+	}
+
+	SOFTWARE_TEXTURE* pTexture = new SOFTWARE_TEXTURE();
+	std::vector<uint32_t> texels((size_t)width * height);
+	for (size_t i = 0; i < texels.size(); i++)
+	{
+		const unsigned char* source = image + i * channels;
+		texels[i] = source[0] | (source[1] << 8) | (source[2] << 16) | ((uint32_t)((channels == 4) ? source[3] : 255) << 24);
+	}
+	pTexture->widths.push_back(width);
+	pTexture->heights.push_back(height);
+	pTexture->levels.push_back(texels);
+
+	while ((width > 1) || (height > 1))
+	{
+		const std::vector<uint32_t>& above = pTexture->levels.back();
+		int aboveWidth = width;
+		int aboveHeight = height;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+		std::vector<uint32_t> level((size_t)width * height);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				int x0 = std::min(x * 2, aboveWidth - 1);
+				int x1 = std::min(x * 2 + 1, aboveWidth - 1);
+				int y0 = std::min(y * 2, aboveHeight - 1);
+				int y1 = std::min(y * 2 + 1, aboveHeight - 1);
+				glm::vec4 sum = UnpackColor(above[(size_t)y0 * aboveWidth + x0]) + UnpackColor(above[(size_t)y0 * aboveWidth + x1]) +
+					UnpackColor(above[(size_t)y1 * aboveWidth + x0]) + UnpackColor(above[(size_t)y1 * aboveWidth + x1]);
+				level[(size_t)y * width + x] = PackColor(sum * 0.25f);
+			}
+		}
+		pTexture->widths.push_back(width);
+		pTexture->heights.push_back(height);
+		pTexture->levels.push_back(level);
+	}
+
+	m_textures.push_back(pTexture);
+	return((unsigned int)m_textures.size());
+}
+
+/***********************************************************
+ *  DestroyTexture()
+ *
+ *  This method frees a texture; its ID is not reused.
+ ***********************************************************/
+void SoftwareRasterizer::DestroyTexture(unsigned int texture)
+{
+	if ((texture == 0) || (texture > m_textures.size()))
+	{
+		return;
+	}
+	delete m_textures[texture - 1];
+	m_textures[texture - 1] = NULL;
+	for (int i = 0; i < g_TextureSlots; i++)
+	{
+		if (m_slotTextures[i] == texture)
+			m_slotTextures[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method makes a texture the one of a slot.
+ ***********************************************************/
+void SoftwareRasterizer::BindTexture(int slot, unsigned int texture)
+{
+	if ((slot >= 0) && (slot < g_TextureSlots))
+	{
+		m_slotTextures[slot] = texture;
+	}
+}
+
+/***********************************************************
+ *  SetLights() / SetMaterials()
+ *
+ *  These methods keep the lights and materials for shading.
+ ***********************************************************/
+void SoftwareRasterizer::SetLights(const std::vector<RENDER_LIGHT>& lights)
+{
+	m_lights = lights;
+}
+
+void SoftwareRasterizer::SetMaterials(const std::vector<RENDER_MATERIAL>& materials)
+{
+	m_materials = materials;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method starts a frame of the snapshot's view with
+ *  empty tile bins.  The tiles are cleared when they are
+ *  rasterized.
+ ***********************************************************/
+void SoftwareRasterizer::BeginFrame(const SCENE_SNAPSHOT& snapshot)
+{
+	m_viewProjection = snapshot.projection * snapshot.view;
+	m_viewPosition = snapshot.viewPosition;
+	m_viewForward = -glm::vec3(snapshot.view[0][2], snapshot.view[1][2], snapshot.view[2][2]);
+	m_bOrthographic = snapshot.bOrthographic;
+	m_triangles.clear();
+	for (size_t i = 0; i < m_bins.size(); i++)
+	{
+		m_bins[i].clear();
+	}
+	m_drawStatistics.clear();
+	m_coveredPixels = 0;
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method runs the vertex stage of the mesh and bins
+ *  its triangles.  The texture coordinates are scaled here,
+ *  as the vertex shader does.
+ ***********************************************************/
+void SoftwareRasterizer::DrawMesh(SCENE_MESH mesh, const RENDER_OBJECT& object)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	size_t firstTriangle = m_triangles.size();
+	m_drawIndex = (uint32_t)m_drawStatistics.size();
+
+	const MESH_DATA& data = m_meshes[mesh];
+	size_t vertexCount = data.vertices.size() / MESH_FLOATS_PER_VERTEX;
+	glm::mat4 modelViewProjection = m_viewProjection * object.model;
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(object.model)));
+
+	m_vertices.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const float* source = &data.vertices[i * MESH_FLOATS_PER_VERTEX];
+		glm::vec4 position(source[0], source[1], source[2], 1.0f);
+		CLIP_VERTEX& vertex = m_vertices[i];
+		vertex.position = modelViewProjection * position;
+		vertex.world = glm::vec3(object.model * position);
+		vertex.normal = normalMatrix * glm::vec3(source[3], source[4], source[5]);
+		vertex.uv = glm::vec2(source[6], source[7]) * object.uvScale;
+	}
+
+	for (size_t i = 0; i + 2 < data.indices.size(); i += 3)
+	{
+		ClipAndBin(m_vertices[data.indices[i]], m_vertices[data.indices[i + 1]], m_vertices[data.indices[i + 2]], object);
+	}
+
+	SOFTWARE_DRAW_STATISTICS statistics = SOFTWARE_DRAW_STATISTICS();
+	if (m_bDrawStatistics)
+	{
+		statistics.triangles = m_triangles.size() - firstTriangle;
+		statistics.vertexTime = MillisecondsSince(start);
+	}
+	m_drawStatistics.push_back(statistics);
+}
+
+/***********************************************************
+ *  ClipAndBin()
+ *
+ *  This method drops a triangle outside the view volume and
+ *  clips one crossing the near plane, which leaves one or
+ *  two triangles.  The other planes need no clipping: the
+ *  pixel bounds are clamped to the screen, and depths past
+ *  the far plane fail the depth test against the cleared
+ *  depth of 1.
+ ***********************************************************/
+void SoftwareRasterizer::ClipAndBin(const CLIP_VERTEX& a, const CLIP_VERTEX& b, const CLIP_VERTEX& c,
+	const RENDER_OBJECT& object)
+{
+	const glm::vec4& pa = a.position;
+	const glm::vec4& pb = b.position;
+	const glm::vec4& pc = c.position;
+	if (((pa.x < -pa.w) && (pb.x < -pb.w) && (pc.x < -pc.w)) ||
+		((pa.x > pa.w) && (pb.x > pb.w) && (pc.x > pc.w)) ||
+		((pa.y < -pa.w) && (pb.y < -pb.w) && (pc.y < -pc.w)) ||
+		((pa.y > pa.w) && (pb.y > pb.w) && (pc.y > pc.w)) ||
+		((pa.z > pa.w) && (pb.z > pb.w) && (pc.z > pc.w)))
+	{
+		return;
+	}
+
+	// signed distances to the near plane, z = -w
+	float distances[3] = { pa.z + pa.w, pb.z + pb.w, pc.z + pc.w };
+	if ((distances[0] >= 0.0f) && (distances[1] >= 0.0f) && (distances[2] >= 0.0f))
+	{
+		SetupTriangle(a, b, c, object);
+		return;
+	}
+	if ((distances[0] < 0.0f) && (distances[1] < 0.0f) && (distances[2] < 0.0f))
+	{
+		return;
+	}
+
+	// Sutherland-Hodgman against the one plane
+	const CLIP_VERTEX* input[3] = { &a, &b, &c };
+	CLIP_VERTEX output[4];
+	int outputCount = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		int next = (i + 1) % 3;
+		if (distances[i] >= 0.0f)
+		{
+			output[outputCount++] = *input[i];
+		}
+		if ((distances[i] >= 0.0f) != (distances[next] >= 0.0f))
+		{
+			float t = distances[i] / (distances[i] - distances[next]);
+			output[outputCount++] = LerpVertex(*input[i], *input[next], t);
+		}
+	}
+	for (int i = 1; i + 1 < outputCount; i++)
+	{
+		SetupTriangle(output[0], output[i], output[i + 1], object);
+	}
+}
+
+/***********************************************************
+ *  SetupTriangle()
+ *
+ *  This method projects a triangle in front of the near
+ *  plane to the screen, sets up its barycentric planes and
+ *  adds it to the bins of the tiles its bounds touch.
+ ***********************************************************/
+void SoftwareRasterizer::SetupTriangle(const CLIP_VERTEX& a, const CLIP_VERTEX& b, const CLIP_VERTEX& c,
+	const RENDER_OBJECT& object)
+{
+	const CLIP_VERTEX* vertices[3] = { &a, &b, &c };
+	float screenX[3];
+	float screenY[3];
+	RASTER_TRIANGLE triangle;
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec4& position = vertices[i]->position;
+		float inverseW = 1.0f / std::max(position.w, 1e-6f);
+		screenX[i] = (position.x * inverseW * 0.5f + 0.5f) * m_settings.width;
+		screenY[i] = (position.y * inverseW * 0.5f + 0.5f) * m_settings.height;
+		triangle.depth[i] = position.z * inverseW * 0.5f + 0.5f;
+		triangle.inverseW[i] = inverseW;
+		triangle.u[i] = vertices[i]->uv.x * inverseW;
+		triangle.v[i] = vertices[i]->uv.y * inverseW;
+		triangle.world[i] = vertices[i]->world;
+		triangle.normal[i] = vertices[i]->normal;
+	}
+
+	float area = (screenX[1] - screenX[0]) * (screenY[2] - screenY[0]) - (screenY[1] - screenY[0]) * (screenX[2] - screenX[0]);
+	if (std::fabs(area) < 1e-8f)
+	{
+		return;
+	}
+
+	float minX = std::min(screenX[0], std::min(screenX[1], screenX[2]));
+	float maxX = std::max(screenX[0], std::max(screenX[1], screenX[2]));
+	float minY = std::min(screenY[0], std::min(screenY[1], screenY[2]));
+	float maxY = std::max(screenY[0], std::max(screenY[1], screenY[2]));
+	if ((maxX < 0.0f) || (maxY < 0.0f) || (minX >= (float)m_settings.width) || (minY >= (float)m_settings.height))
+	{
+		return;
+	}
+	triangle.minX = std::max((int)std::floor(minX), 0);
+	triangle.minY = std::max((int)std::floor(minY), 0);
+	triangle.maxX = std::min((int)std::floor(maxX), m_settings.width - 1);
+	triangle.maxY = std::min((int)std::floor(maxY), m_settings.height - 1);
+
+	// weight of vertex i = the edge function of the opposite
+	// edge over the area, as a plane A x + B y + C
+	for (int i = 0; i < 2; i++)
+	{
+		int from = (i + 1) % 3;
+		int to = (i + 2) % 3;
+		float dx = screenX[to] - screenX[from];
+		float dy = screenY[to] - screenY[from];
+		triangle.weightA[i] = -dy / area;
+		triangle.weightB[i] = dx / area;
+		triangle.weightC[i] = (dy * screenX[from] - dx * screenY[from]) / area;
+	}
+	triangle.textureSlot = object.textureSlot;
+	triangle.materialIndex = object.materialIndex;
+	triangle.drawIndex = m_drawIndex;
+
+	uint32_t index = (uint32_t)m_triangles.size();
+	m_triangles.push_back(triangle);
+	int tileSize = m_settings.tileSize;
+	for (int tileY = triangle.minY / tileSize; tileY <= triangle.maxY / tileSize; tileY++)
+	{
+		for (int tileX = triangle.minX / tileSize; tileX <= triangle.maxX / tileSize; tileX++)
+		{
+			m_bins[(size_t)tileY * m_tilesX + tileX].push_back(index);
+		}
+	}
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method rasterizes the binned triangles on all
+ *  threads and returns once the image is complete.
+ ***********************************************************/
+void SoftwareRasterizer::EndFrame()
+{
+	m_nextTile = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_frameGeneration++;
+		m_busyWorkers = (int)m_workers.size();
+	}
+	m_wake.notify_all();
+
+	RasterizeTiles();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return(m_busyWorkers == 0); });
+
+	if (m_bDrawStatistics)
+	{
+		for (int y = 0; y < m_settings.height; y++)
+		{
+			const float* depth = &m_depth[(size_t)y * m_stride];
+			for (int x = 0; x < m_settings.width; x++)
+			{
+				if (depth[x] < 1.0f)
+					m_coveredPixels++;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is the body of the worker threads: they
+ *  sleep until a frame is ready to rasterize.
+ ***********************************************************/
+void SoftwareRasterizer::Run()
+{
+	unsigned long long frameGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return(m_bStopping || (m_frameGeneration != frameGeneration)); });
+			if (m_bStopping)
+			{
+				return;
+			}
+			frameGeneration = m_frameGeneration;
+		}
+
+		RasterizeTiles();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_busyWorkers == 0)
+		{
+			m_done.notify_one();
+		}
+	}
+}
+
+/***********************************************************
+ *  RasterizeTiles()
+ *
+ *  This method rasterizes tiles until the frame has none
+ *  left.  With statistics on, the thread counts into its own
+ *  copy and adds it to the frame's once it is done.
+ ***********************************************************/
+void SoftwareRasterizer::RasterizeTiles()
+{
+	std::vector<SOFTWARE_DRAW_STATISTICS> statistics;
+	if (m_bDrawStatistics)
+	{
+		statistics.assign(m_drawStatistics.size(), SOFTWARE_DRAW_STATISTICS());
+	}
+
+	int tileCount = m_tilesX * m_tilesY;
+	for (int tile = m_nextTile++; tile < tileCount; tile = m_nextTile++)
+	{
+		RasterizeTile(tile, m_bDrawStatistics ? &statistics : NULL);
+	}
+
+	if (m_bDrawStatistics)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (size_t i = 0; i < statistics.size(); i++)
+		{
+			m_drawStatistics[i].fragments += statistics[i].fragments;
+			m_drawStatistics[i].shadedFragments += statistics[i].shadedFragments;
+			m_drawStatistics[i].rasterTime += statistics[i].rasterTime;
+		}
+	}
+}
+
+/***********************************************************
+ *  RasterizeTile()
+ *
+ *  This method clears a tile to black at the far depth and
+ *  rasterizes its triangles in the order they were drawn.
+ ***********************************************************/
+void SoftwareRasterizer::RasterizeTile(int tile, std::vector<SOFTWARE_DRAW_STATISTICS>* pStatistics)
+{
+	int tileSize = m_settings.tileSize;
+	int x0 = (tile % m_tilesX) * tileSize;
+	int y0 = (tile / m_tilesX) * tileSize;
+	int x1 = std::min(x0 + tileSize, m_stride) - 1;
+	int y1 = std::min(y0 + tileSize, m_paddedHeight) - 1;
+
+	const uint32_t clearColor = PackColor(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	for (int y = y0; y <= y1; y++)
+	{
+		size_t row = (size_t)y * m_stride;
+		std::fill(m_color.begin() + row + x0, m_color.begin() + row + x1 + 1, clearColor);
+		std::fill(m_depth.begin() + row + x0, m_depth.begin() + row + x1 + 1, 1.0f);
+	}
+
+	const std::vector<uint32_t>& bin = m_bins[tile];
+	for (size_t i = 0; i < bin.size(); i++)
+	{
+		const RASTER_TRIANGLE& triangle = m_triangles[bin[i]];
+		if (NULL == pStatistics)
+		{
+			RasterizeTriangle(triangle, std::max(triangle.minX, x0), std::max(triangle.minY, y0),
+				std::min(triangle.maxX, x1), std::min(triangle.maxY, y1), NULL);
+			continue;
+		}
+
+		SOFTWARE_DRAW_STATISTICS& statistics = (*pStatistics)[triangle.drawIndex];
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		RasterizeTriangle(triangle, std::max(triangle.minX, x0), std::max(triangle.minY, y0),
+			std::min(triangle.maxX, x1), std::min(triangle.maxY, y1), &statistics);
+		statistics.rasterTime += MillisecondsSince(start);
+	}
+}
+
+/***********************************************************
+ *  RasterizeTriangle()
+ *
+ *  This method rasterizes the part of a triangle within a
+ *  pixel rectangle of one tile, one 2 x 2 quad at a time.
+ *  Quads start on even pixels; the buffers are padded, so
+ *  the pixels of a quad past the image are always there and
+ *  only masked off.
+ ***********************************************************/
+void SoftwareRasterizer::RasterizeTriangle(const RASTER_TRIANGLE& triangle, int x0, int y0, int x1, int y1,
+	SOFTWARE_DRAW_STATISTICS* pStatistics)
+{
+	const __m128 quadX = _mm_set_ps(1.5f, 0.5f, 1.5f, 0.5f);
+	const __m128 quadY = _mm_set_ps(1.5f, 1.5f, 0.5f, 0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 a0 = _mm_set1_ps(triangle.weightA[0]);
+	const __m128 b0 = _mm_set1_ps(triangle.weightB[0]);
+	const __m128 c0 = _mm_set1_ps(triangle.weightC[0]);
+	const __m128 a1 = _mm_set1_ps(triangle.weightA[1]);
+	const __m128 b1 = _mm_set1_ps(triangle.weightB[1]);
+	const __m128 c1 = _mm_set1_ps(triangle.weightC[1]);
+
+	const SOFTWARE_TEXTURE* pTexture = NULL;
+	if ((triangle.textureSlot >= 0) && (triangle.textureSlot < g_TextureSlots))
+	{
+		unsigned int texture = m_slotTextures[triangle.textureSlot];
+		if ((texture > 0) && (texture <= m_textures.size()))
+			pTexture = m_textures[texture - 1];
+	}
+
+	// blend mode of the material, as the indirect fragment
+	// shader and the GL blend state apply it
+	BLEND_MODE blendMode = BLEND_OPAQUE;
+	float opacity = 1.0f;
+	float alphaCutoff = 0.0f;
+	if ((triangle.materialIndex >= 0) && (triangle.materialIndex < (int)m_materials.size()))
+	{
+		const RENDER_MATERIAL& material = m_materials[triangle.materialIndex];
+		blendMode = material.blendMode;
+		opacity = material.opacity;
+		alphaCutoff = material.alphaCutoff;
+	}
+
+	for (int y = y0 & ~1; y <= y1; y += 2)
+	{
+		__m128 py = _mm_add_ps(_mm_set1_ps((float)y), quadY);
+		// pixels of the quad inside the rectangle: lanes are
+		// (x, y), (x + 1, y), (x, y + 1), (x + 1, y + 1)
+		int rowMask = ((y >= y0) ? 0x3 : 0) | ((y + 1 <= y1) ? 0xc : 0);
+		for (int x = x0 & ~1; x <= x1; x += 2)
+		{
+			int columnMask = ((x >= x0) ? 0x5 : 0) | ((x + 1 <= x1) ? 0xa : 0);
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), quadX);
+			__m128 w0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, px), _mm_mul_ps(b0, py)), c0);
+			__m128 w1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a1, px), _mm_mul_ps(b1, py)), c1);
+			__m128 w2 = _mm_sub_ps(_mm_sub_ps(one, w0), w1);
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+			int mask = _mm_movemask_ps(inside) & rowMask & columnMask;
+			if (mask == 0)
+				continue;
+			if (NULL != pStatistics)
+				pStatistics->fragments += g_QuadPixels[mask];
+
+			// depth test against the quad's two rows
+			size_t row0 = (size_t)y * m_stride + x;
+			size_t row1 = row0 + m_stride;
+			__m128 depth = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(w0, _mm_set1_ps(triangle.depth[0])),
+				_mm_mul_ps(w1, _mm_set1_ps(triangle.depth[1]))),
+				_mm_mul_ps(w2, _mm_set1_ps(triangle.depth[2])));
+			__m128 stored = _mm_loadl_pi(zero, (const __m64*)&m_depth[row0]);
+			stored = _mm_loadh_pi(stored, (const __m64*)&m_depth[row1]);
+			mask &= _mm_movemask_ps(_mm_cmplt_ps(depth, stored));
+			if (mask == 0)
+				continue;
+			if (NULL != pStatistics)
+				pStatistics->shadedFragments += g_QuadPixels[mask];
+
+			// perspective-correct texture coordinates of all four
+			// pixels, covered or not, for the mip level
+			__m128 inverseW = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(w0, _mm_set1_ps(triangle.inverseW[0])),
+				_mm_mul_ps(w1, _mm_set1_ps(triangle.inverseW[1]))),
+				_mm_mul_ps(w2, _mm_set1_ps(triangle.inverseW[2])));
+			__m128 w = _mm_div_ps(one, _mm_max_ps(inverseW, _mm_set1_ps(1e-12f)));
+			__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(w0, _mm_set1_ps(triangle.u[0])),
+				_mm_mul_ps(w1, _mm_set1_ps(triangle.u[1]))),
+				_mm_mul_ps(w2, _mm_set1_ps(triangle.u[2]))), w);
+			__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(w0, _mm_set1_ps(triangle.v[0])),
+				_mm_mul_ps(w1, _mm_set1_ps(triangle.v[1]))),
+				_mm_mul_ps(w2, _mm_set1_ps(triangle.v[2]))), w);
+
+			float weights0[4];
+			float weights1[4];
+			float weights2[4];
+			float depths[4];
+			float pixelW[4];
+			float us[4];
+			float vs[4];
+			_mm_storeu_ps(weights0, w0);
+			_mm_storeu_ps(weights1, w1);
+			_mm_storeu_ps(weights2, w2);
+			_mm_storeu_ps(depths, depth);
+			_mm_storeu_ps(pixelW, w);
+			_mm_storeu_ps(us, u);
+			_mm_storeu_ps(vs, v);
+
+			float lod = 0.0f;
+			if (NULL != pTexture)
+			{
+				float width = (float)pTexture->widths[0];
+				float height = (float)pTexture->heights[0];
+				float dudx = (us[1] - us[0]) * width;
+				float dvdx = (vs[1] - vs[0]) * height;
+				float dudy = (us[2] - us[0]) * width;
+				float dvdy = (vs[2] - vs[0]) * height;
+				float rho = std::max(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy);
+				lod = 0.5f * std::log2(std::max(rho, 1e-12f));
+			}
+
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if ((mask & (1 << lane)) == 0)
+					continue;
+				size_t pixel = ((lane < 2) ? row0 : row1) + (lane & 1);
+				// perspective-correct weights of the vertices, for
+				// the world position and normal
+				float weights[3] = {
+					weights0[lane] * triangle.inverseW[0] * pixelW[lane],
+					weights1[lane] * triangle.inverseW[1] * pixelW[lane],
+					weights2[lane] * triangle.inverseW[2] * pixelW[lane] };
+				glm::vec4 color = ShadePixel(triangle, weights, us[lane], vs[lane], lod);
+				if (blendMode == BLEND_TRANSPARENT)
+				{
+					// blended in submission order, which is back to
+					// front, and not hiding what comes later
+					color.a *= opacity;
+					m_color[pixel] = PackColor(color * color.a + UnpackColor(m_color[pixel]) * (1.0f - color.a));
+					continue;
+				}
+				if (blendMode == BLEND_ALPHA_TEST)
+				{
+					if (color.a < alphaCutoff)
+						continue;
+					color.a = 1.0f;
+				}
+				m_depth[pixel] = depths[lane];
+				m_color[pixel] = PackColor(color);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  ShadePixel()
+ *
+ *  This method shades a pixel like the indirect fragment
+ *  shader: the texture color (white without a texture)
+ *  times the sum of CalcLight() over the scene lights, or
+ *  the texture color alone without a material.  With the
+ *  normal output it is the interpolated normal instead,
+ *  turned towards the viewer on back faces.
+ ***********************************************************/
+glm::vec4 SoftwareRasterizer::ShadePixel(const RASTER_TRIANGLE& triangle, const float weights[3], float u, float v,
+	float lod) const
+{
+	if (m_output == SOFTWARE_OUTPUT_NORMAL)
+	{
+		glm::vec3 normal = glm::normalize(triangle.normal[0] * weights[0] + triangle.normal[1] * weights[1] +
+			triangle.normal[2] * weights[2]);
+		glm::vec3 towardsViewer = -m_viewForward;
+		if (!m_bOrthographic)
+		{
+			towardsViewer = m_viewPosition -
+				(triangle.world[0] * weights[0] + triangle.world[1] * weights[1] + triangle.world[2] * weights[2]);
+		}
+		if (glm::dot(normal, towardsViewer) < 0.0f)
+			normal = -normal;
+		return(glm::vec4(normal * 0.5f + 0.5f, 1.0f));
+	}
+
+	glm::vec4 baseColor(1.0f);
+	if ((triangle.textureSlot >= 0) && (triangle.textureSlot < g_TextureSlots))
+	{
+		unsigned int texture = m_slotTextures[triangle.textureSlot];
+		if ((texture > 0) && (texture <= m_textures.size()) && (NULL != m_textures[texture - 1]))
+			baseColor = SampleTexture(*m_textures[texture - 1], u, v, lod);
+	}
+
+	if ((triangle.materialIndex < 0) || (triangle.materialIndex >= (int)m_materials.size()))
+	{
+		return(baseColor);
+	}
+
+	glm::vec3 position = triangle.world[0] * weights[0] + triangle.world[1] * weights[1] + triangle.world[2] * weights[2];
+	glm::vec3 normal = glm::normalize(triangle.normal[0] * weights[0] + triangle.normal[1] * weights[1] +
+		triangle.normal[2] * weights[2]);
+
+	const RENDER_MATERIAL& material = m_materials[triangle.materialIndex];
+	glm::vec3 viewDirection = glm::normalize(m_viewPosition - position);
+	glm::vec3 lighting(0.0f);
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		const RENDER_LIGHT& light = m_lights[i];
+		glm::vec3 lightDirection = light.bDirectional ? glm::normalize(-light.position) : glm::normalize(light.position - position);
+
+		glm::vec3 ambient = light.ambientColor * material.ambientColor * material.ambientStrength;
+
+		float diffuseImpact = std::max(glm::dot(normal, lightDirection), 0.0f);
+		glm::vec3 diffuse = diffuseImpact * light.diffuseColor * material.diffuseColor;
+
+		glm::vec3 reflectDirection = glm::reflect(-lightDirection, normal);
+		float specularComponent = std::pow(std::max(glm::dot(viewDirection, reflectDirection), 0.0f),
+			std::max(light.focalStrength, material.shininess));
+		glm::vec3 specular = light.specularIntensity * specularComponent * light.specularColor * material.specularColor;
+
+		lighting += ambient + diffuse + specular;
+	}
+
+	return(glm::vec4(lighting * glm::vec3(baseColor), baseColor.a));
+}
+
+/***********************************************************
+ *  SampleTexture()
+ *
+ *  This method samples a texture trilinearly, the filter
+ *  GL_LINEAR_MIPMAP_LINEAR, with repeat wrapping.
+ ***********************************************************/
+glm::vec4 SoftwareRasterizer::SampleTexture(const SOFTWARE_TEXTURE& texture, float u, float v, float lod)
+{
+	int lastLevel = (int)texture.levels.size() - 1;
+	if (lod <= 0.0f)
+	{
+		return(SampleLevel(texture, 0, u, v));
+	}
+	if (lod >= (float)lastLevel)
+	{
+		return(SampleLevel(texture, lastLevel, u, v));
+	}
+
+	int level = (int)lod;
+	float blend = lod - (float)level;
+	return(SampleLevel(texture, level, u, v) * (1.0f - blend) + SampleLevel(texture, level + 1, u, v) * blend);
+}
+
+/***********************************************************
+ *  SampleLevel()
+ *
+ *  This method samples one mip level bilinearly.
+ ***********************************************************/
+glm::vec4 SoftwareRasterizer::SampleLevel(const SOFTWARE_TEXTURE& texture, int level, float u, float v)
+{
+	int width = texture.widths[level];
+	int height = texture.heights[level];
+	const std::vector<uint32_t>& texels = texture.levels[level];
+
+	float x = u * width - 0.5f;
+	float y = v * height - 0.5f;
+	float floorX = std::floor(x);
+	float floorY = std::floor(y);
+	float fractionX = x - floorX;
+	float fractionY = y - floorY;
+	int x0 = (int)std::fmod(floorX, (float)width);
+	int y0 = (int)std::fmod(floorY, (float)height);
+	if (x0 < 0)
+		x0 += width;
+	if (y0 < 0)
+		y0 += height;
+	int x1 = (x0 + 1 < width) ? x0 + 1 : 0;
+	int y1 = (y0 + 1 < height) ? y0 + 1 : 0;
+
+	glm::vec4 bottom = UnpackColor(texels[(size_t)y0 * width + x0]) * (1.0f - fractionX) +
+		UnpackColor(texels[(size_t)y0 * width + x1]) * fractionX;
+	glm::vec4 top = UnpackColor(texels[(size_t)y1 * width + x0]) * (1.0f - fractionX) +
+		UnpackColor(texels[(size_t)y1 * width + x1]) * fractionX;
+	return(bottom * (1.0f - fractionY) + top * fractionY);
+}
+
+/***********************************************************
+ *  ReadPixels()
+ *
+ *  This method copies the last frame out as RGBA rows,
+ *  bottom row first.
+ ***********************************************************/
+void SoftwareRasterizer::ReadPixels(std::vector<unsigned char>& pixels) const
+{
+	pixels.resize((size_t)m_settings.width * m_settings.height * 4);
+	for (int y = 0; y < m_settings.height; y++)
+	{
+		for (int x = 0; x < m_settings.width; x++)
+		{
+			uint32_t color = m_color[(size_t)y * m_stride + x];
+			unsigned char* pixel = &pixels[((size_t)y * m_settings.width + x) * 4];
+			pixel[0] = (unsigned char)(color & 0xff);
+			pixel[1] = (unsigned char)((color >> 8) & 0xff);
+			pixel[2] = (unsigned char)((color >> 16) & 0xff);
+			pixel[3] = (unsigned char)(color >> 24);
+		}
+	}
+}
+
+/***********************************************************
+ *  ReadCoverage()
+ *
+ *  This method marks the pixels of the last frame whose
+ *  depth was written.
+ ***********************************************************/
+void SoftwareRasterizer::ReadCoverage(std::vector<unsigned char>& coverage) const
+{
+	coverage.resize((size_t)m_settings.width * m_settings.height);
+	for (int y = 0; y < m_settings.height; y++)
+	{
+		const float* depth = &m_depth[(size_t)y * m_stride];
+		for (int x = 0; x < m_settings.width; x++)
+		{
+			coverage[(size_t)y * m_settings.width + x] = (depth[x] < 1.0f) ? 1 : 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  SetDrawStatistics()
+ *
+ *  This method turns the measuring of the draws on or off.
+ ***********************************************************/
+void SoftwareRasterizer::SetDrawStatistics(bool bEnabled)
+{
+	m_bDrawStatistics = bEnabled;
+}
@@ -0,0 +1,248 @@
+///////////////////////////////////////////////////////////////////////////////
+// softwarerasterizer.h
+// ============
+// draw the scene on the CPU: a tile-binned, multithreaded rasterizer with
+// the shading of the scene shaders
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderBackend.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+/***********************************************************
+ *  SOFTWARE_RASTERIZER_SETTINGS
+ *
+ *  Size of the image and how the work is split.
+ ***********************************************************/
+struct SOFTWARE_RASTERIZER_SETTINGS
+{
+	int width;
+	int height;
+	// threads that rasterize, including the caller's
+	// (0 = one per core)
+	int threadCount;
+	// edge length of the screen tiles in pixels (even)
+	int tileSize;
+};
+
+/***********************************************************
+ *  SOFTWARE_OUTPUT
+ *
+ *  What the rasterizer writes into the color buffer.
+ ***********************************************************/
+enum SOFTWARE_OUTPUT
+{
+	// the shaded color, as the scene shaders draw it
+	SOFTWARE_OUTPUT_SHADED,
+	// the world normal turned towards the viewer, * 0.5 + 0.5,
+	// for baking the normals of impostors
+	SOFTWARE_OUTPUT_NORMAL
+};
+
+/***********************************************************
+ *  SOFTWARE_DRAW_STATISTICS
+ *
+ *  What one draw of a frame cost the rasterizer.
+ ***********************************************************/
+struct SOFTWARE_DRAW_STATISTICS
+{
+	// triangles binned after clipping
+	size_t triangles;
+	// pixels the triangles covered, and those that passed the
+	// depth test and were shaded
+	size_t fragments;
+	size_t shadedFragments;
+	// milliseconds in the vertex stage and, summed over the
+	// threads, in rasterizing
+	double vertexTime;
+	double rasterTime;
+};
+
+/***********************************************************
+ *  SoftwareRasterizer
+ *
+ *  The software backend.  DrawMesh() transforms the mesh's
+ *  vertices, clips the triangles against the near plane and
+ *  bins each one into the screen tiles its bounds touch.
+ *  EndFrame() then has the worker threads take tiles off a
+ *  shared counter; a thread clears its tile and rasterizes
+ *  the tile's triangles in the order they were drawn, so a
+ *  tile is only ever written by one thread and the image
+ *  does not depend on the thread count.
+ *
+ *  Pixels are rasterized in 2 x 2 quads with SSE: the edge
+ *  functions, depth test and perspective-correct texture
+ *  coordinates of the four pixels are computed together,
+ *  and the texture coordinate differences across the quad
+ *  select the mip level, as on the GPU.  The covered pixels
+ *  are then shaded like the indirect fragment shader: the
+ *  trilinear filtered texture times the Phong lighting of
+ *  every scene light with the object's material.  Both
+ *  faces of a triangle are drawn, as culling is off in GL.
+ *
+ *  The image is kept bottom row first, like glReadPixels()
+ *  returns it.  Besides the scene, the impostor baker draws
+ *  its views of the archetypes with it, once shaded and once
+ *  with the normals as the output.
+ ***********************************************************/
+class SoftwareRasterizer : public RenderBackend
+{
+public:
+	// constructor
+	SoftwareRasterizer(const SOFTWARE_RASTERIZER_SETTINGS& settings);
+	// destructor
+	virtual ~SoftwareRasterizer();
+
+	// default settings: the window size, one thread per core
+	// and 64 pixel tiles
+	static SOFTWARE_RASTERIZER_SETTINGS DefaultSettings();
+
+	virtual void LoadMeshes();
+
+	virtual unsigned int CreateTexture(const unsigned char* image, int width, int height, int channels);
+	virtual void DestroyTexture(unsigned int texture);
+	virtual void BindTexture(int slot, unsigned int texture);
+
+	virtual void SetLights(const std::vector<RENDER_LIGHT>& lights);
+	virtual void SetMaterials(const std::vector<RENDER_MATERIAL>& materials);
+
+	virtual void BeginFrame(const SCENE_SNAPSHOT& snapshot);
+	virtual void DrawMesh(SCENE_MESH mesh, const RENDER_OBJECT& object);
+	virtual void EndFrame();
+
+	int GetWidth() const { return m_settings.width; }
+	int GetHeight() const { return m_settings.height; }
+	int GetThreadCount() const { return (int)m_workers.size() + 1; }
+	// triangles binned in the last frame
+	size_t GetTriangleCount() const { return m_triangles.size(); }
+	// copy the last frame out as RGBA rows, bottom row first
+	void ReadPixels(std::vector<unsigned char>& pixels) const;
+	// one byte per pixel of the last frame, 1 where something
+	// was drawn, bottom row first
+	void ReadCoverage(std::vector<unsigned char>& coverage) const;
+
+	// what the following frames write (shaded by default)
+	void SetOutput(SOFTWARE_OUTPUT output) { m_output = output; }
+
+	// measure every draw of the following frames (off by default,
+	// as the timing slows rasterizing down)
+	void SetDrawStatistics(bool bEnabled);
+	// the draws of the last frame, in the order they were made
+	const std::vector<SOFTWARE_DRAW_STATISTICS>& GetDrawStatistics() const { return m_drawStatistics; }
+	// pixels of the last frame something was drawn on
+	size_t GetCoveredPixels() const { return m_coveredPixels; }
+
+private:
+	// a texture and its mip chain, RGBA texels
+	struct SOFTWARE_TEXTURE
+	{
+		std::vector<int> widths;
+		std::vector<int> heights;
+		std::vector<std::vector<uint32_t>> levels;
+	};
+
+	// a vertex after the vertex stage, in clip space
+	struct CLIP_VERTEX
+	{
+		glm::vec4 position;
+		glm::vec3 world;
+		glm::vec3 normal;
+		glm::vec2 uv;
+	};
+
+	// a triangle set up for rasterizing: barycentric weights
+	// of vertices 0 and 1 as planes over the pixel position,
+	// depth, 1/w, the texture coordinates divided by w and
+	// the world positions and normals
+	struct RASTER_TRIANGLE
+	{
+		float weightA[2];
+		float weightB[2];
+		float weightC[2];
+		float depth[3];
+		float inverseW[3];
+		float u[3];
+		float v[3];
+		glm::vec3 world[3];
+		glm::vec3 normal[3];
+		int textureSlot;
+		int materialIndex;
+		uint32_t drawIndex;
+		// pixel bounds, inclusive
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+	};
+
+	void ClipAndBin(const CLIP_VERTEX& a, const CLIP_VERTEX& b, const CLIP_VERTEX& c, const RENDER_OBJECT& object);
+	void SetupTriangle(const CLIP_VERTEX& a, const CLIP_VERTEX& b, const CLIP_VERTEX& c, const RENDER_OBJECT& object);
+
+	// body of the worker threads
+	void Run();
+	// take tiles off the counter until none are left
+	void RasterizeTiles();
+	void RasterizeTile(int tile, std::vector<SOFTWARE_DRAW_STATISTICS>* pStatistics);
+	// rasterize a triangle within a pixel rectangle, counting
+	// its fragments if statistics are given
+	void RasterizeTriangle(const RASTER_TRIANGLE& triangle, int x0, int y0, int x1, int y1,
+		SOFTWARE_DRAW_STATISTICS* pStatistics);
+	// shade one pixel of a triangle, from the perspective-correct
+	// weights of its vertices
+	glm::vec4 ShadePixel(const RASTER_TRIANGLE& triangle, const float weights[3], float u, float v, float lod) const;
+	static glm::vec4 SampleTexture(const SOFTWARE_TEXTURE& texture, float u, float v, float lod);
+	static glm::vec4 SampleLevel(const SOFTWARE_TEXTURE& texture, int level, float u, float v);
+
+	SOFTWARE_RASTERIZER_SETTINGS m_settings;
+	// the color and depth buffers are padded to whole quads
+	int m_stride;
+	int m_paddedHeight;
+	std::vector<uint32_t> m_color;
+	std::vector<float> m_depth;
+
+	MESH_DATA m_meshes[MESH_COUNT];
+	// textures by ID - 1 (NULL = destroyed), and the ID bound
+	// to each slot (0 = none)
+	std::vector<SOFTWARE_TEXTURE*> m_textures;
+	unsigned int m_slotTextures[16];
+	std::vector<RENDER_LIGHT> m_lights;
+	std::vector<RENDER_MATERIAL> m_materials;
+
+	SOFTWARE_OUTPUT m_output;
+
+	// the frame being drawn
+	glm::mat4 m_viewProjection;
+	glm::vec3 m_viewPosition;
+	// direction the camera looks in, which is the view
+	// direction everywhere in an orthographic view
+	glm::vec3 m_viewForward;
+	bool m_bOrthographic;
+	std::vector<CLIP_VERTEX> m_vertices;
+	std::vector<RASTER_TRIANGLE> m_triangles;
+	int m_tilesX;
+	int m_tilesY;
+	// indices of the triangles touching each tile
+	std::vector<std::vector<uint32_t>> m_bins;
+	// draw the triangles being binned belong to
+	uint32_t m_drawIndex;
+	bool m_bDrawStatistics;
+	std::vector<SOFTWARE_DRAW_STATISTICS> m_drawStatistics;
+	size_t m_coveredPixels;
+
+	// worker threads; the caller of EndFrame() is one more
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	unsigned long long m_frameGeneration;
+	int m_busyWorkers;
+	bool m_bStopping;
+	std::atomic<int> m_nextTile;
+};
@@ -0,0 +1,630 @@
+///////////////////////////////////////////////////////////////////////////////
+// spatialgrid.cpp
+// ============
+// uniform grid over the world-space bounds of the scene objects for
+// ray casts, sphere sweeps and box overlap queries
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SpatialGrid.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// distance at which a sweep or sphere trace counts as touching
+	const float g_ContactEpsilon = 0.0001f;
+	// iteration limits for sweeps and sphere tracing
+	const int g_MaxSweepSteps = 64;
+	const int g_MaxTraceSteps = 96;
+	// a ray cast walks at most this many cells
+	const int g_MaxRayCells = 4096;
+}
+
+/***********************************************************
+ *  SpatialGrid()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SpatialGrid::SpatialGrid(float cellSize)
+{
+	m_cellSize = (cellSize > 0.0f) ? cellSize : 1.0f;
+	m_liveObjects = 0;
+	m_queryStamp = 0;
+}
+
+/***********************************************************
+ *  Insert()
+ *
+ *  This method adds an object to the grid.
+ ***********************************************************/
+int SpatialGrid::Insert(const std::string& name, const SPATIAL_SHAPE& shape, const glm::mat4& model)
+{
+	SPATIAL_OBJECT object;
+	object.name = name;
+	object.shape = shape;
+	object.bAlive = true;
+	object.queryStamp = 0;
+	PlaceObject(object, model);
+
+	int handle = (int)m_objects.size();
+	m_objects.push_back(object);
+	LinkObject(handle);
+	m_liveObjects++;
+
+	return(handle);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method moves an object.  If it still covers the same
+ *  cells, the cell lists are left alone.
+ ***********************************************************/
+void SpatialGrid::Update(int handle, const glm::mat4& model)
+{
+	if ((handle < 0) || (handle >= (int)m_objects.size()) || (m_objects[handle].bAlive == false))
+	{
+		return;
+	}
+
+	SPATIAL_OBJECT& object = m_objects[handle];
+	int oldMin[3] = { object.cellMin[0], object.cellMin[1], object.cellMin[2] };
+	int oldMax[3] = { object.cellMax[0], object.cellMax[1], object.cellMax[2] };
+
+	PlaceObject(object, model);
+
+	bool bSameCells = true;
+	for (int i = 0; i < 3; i++)
+	{
+		if ((oldMin[i] != object.cellMin[i]) || (oldMax[i] != object.cellMax[i]))
+			bSameCells = false;
+	}
+	if (bSameCells)
+	{
+		return;
+	}
+
+	// unlink from the old cell range, then link into the new one
+	int newMin[3] = { object.cellMin[0], object.cellMin[1], object.cellMin[2] };
+	int newMax[3] = { object.cellMax[0], object.cellMax[1], object.cellMax[2] };
+	for (int i = 0; i < 3; i++)
+	{
+		object.cellMin[i] = oldMin[i];
+		object.cellMax[i] = oldMax[i];
+	}
+	UnlinkObject(handle);
+	for (int i = 0; i < 3; i++)
+	{
+		object.cellMin[i] = newMin[i];
+		object.cellMax[i] = newMax[i];
+	}
+	LinkObject(handle);
+}
+
+/***********************************************************
+ *  Remove()
+ *
+ *  This method takes an object out of the grid.
+ ***********************************************************/
+void SpatialGrid::Remove(int handle)
+{
+	if ((handle < 0) || (handle >= (int)m_objects.size()) || (m_objects[handle].bAlive == false))
+	{
+		return;
+	}
+
+	UnlinkObject(handle);
+	m_objects[handle].bAlive = false;
+	m_liveObjects--;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method removes all objects.
+ ***********************************************************/
+void SpatialGrid::Clear()
+{
+	m_objects.clear();
+	m_cells.clear();
+	m_liveObjects = 0;
+}
+
+/***********************************************************
+ *  PlaceObject()
+ *
+ *  This method works out the world-space frame of an object
+ *  from its model matrix.  The scene's model matrices are
+ *  translation * rotation * scale, so the columns of the
+ *  upper 3x3 are orthogonal: their directions are the box
+ *  axes and their lengths the scale along each axis.
+ ***********************************************************/
+void SpatialGrid::PlaceObject(SPATIAL_OBJECT& object, const glm::mat4& model)
+{
+	glm::vec3 scale;
+	for (int i = 0; i < 3; i++)
+	{
+		glm::vec3 column = glm::vec3(model[i].x, model[i].y, model[i].z);
+		scale[i] = glm::length(column);
+		object.axes[i] = (scale[i] > 0.0f) ? column / scale[i] : glm::vec3(0.0f);
+	}
+	// keep a valid frame for flattened objects such as the ground plane
+	if (scale.y == 0.0f)
+		object.axes[1] = glm::normalize(glm::cross(object.axes[2], object.axes[0]));
+
+	glm::vec3 localCenter(0.0f);
+	glm::vec3 localHalf(0.0f);
+	object.majorRadius = 0.0f;
+	object.minorRadius = 0.0f;
+
+	switch (object.shape.type)
+	{
+	case SHAPE_BOX:
+		localCenter = (object.shape.localMin + object.shape.localMax) * 0.5f;
+		localHalf = (object.shape.localMax - object.shape.localMin) * 0.5f;
+		object.halfExtents = localHalf * scale;
+		break;
+	case SHAPE_SPHERE:
+		object.majorRadius = object.shape.majorRadius * scale.x;
+		object.halfExtents = glm::vec3(object.majorRadius);
+		break;
+	case SHAPE_TORUS:
+		object.majorRadius = object.shape.majorRadius * scale.x;
+		object.minorRadius = object.shape.minorRadius * scale.x;
+		object.halfExtents = glm::vec3(
+			object.majorRadius + object.minorRadius,
+			object.majorRadius + object.minorRadius,
+			object.minorRadius);
+		break;
+	}
+
+	glm::vec4 center = model * glm::vec4(localCenter, 1.0f);
+	object.center = glm::vec3(center.x, center.y, center.z);
+
+	// world AABB of the oriented box
+	glm::vec3 extent(0.0f);
+	for (int i = 0; i < 3; i++)
+	{
+		extent += glm::abs(object.axes[i]) * object.halfExtents[i];
+	}
+	object.boundsMin = object.center - extent;
+	object.boundsMax = object.center + extent;
+
+	for (int i = 0; i < 3; i++)
+	{
+		object.cellMin[i] = CellCoordinate(object.boundsMin[i]);
+		object.cellMax[i] = CellCoordinate(object.boundsMax[i]);
+	}
+}
+
+/***********************************************************
+ *  LinkObject()
+ *
+ *  This method adds an object to every cell it covers.
+ ***********************************************************/
+void SpatialGrid::LinkObject(int handle)
+{
+	const SPATIAL_OBJECT& object = m_objects[handle];
+	for (int x = object.cellMin[0]; x <= object.cellMax[0]; x++)
+	{
+		for (int y = object.cellMin[1]; y <= object.cellMax[1]; y++)
+		{
+			for (int z = object.cellMin[2]; z <= object.cellMax[2]; z++)
+			{
+				m_cells[CellKey(x, y, z)].push_back(handle);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  UnlinkObject()
+ *
+ *  This method removes an object from every cell it covers
+ *  and drops cells that become empty.
+ ***********************************************************/
+void SpatialGrid::UnlinkObject(int handle)
+{
+	const SPATIAL_OBJECT& object = m_objects[handle];
+	for (int x = object.cellMin[0]; x <= object.cellMax[0]; x++)
+	{
+		for (int y = object.cellMin[1]; y <= object.cellMax[1]; y++)
+		{
+			for (int z = object.cellMin[2]; z <= object.cellMax[2]; z++)
+			{
+				std::unordered_map<uint64_t, std::vector<int> >::iterator cell = m_cells.find(CellKey(x, y, z));
+				if (cell == m_cells.end())
+					continue;
+
+				std::vector<int>& handles = cell->second;
+				handles.erase(std::remove(handles.begin(), handles.end(), handle), handles.end());
+				if (handles.empty())
+					m_cells.erase(cell);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  CellKey()
+ *
+ *  This method packs three signed 21-bit cell coordinates
+ *  into one 64-bit hash map key.
+ ***********************************************************/
+uint64_t SpatialGrid::CellKey(int x, int y, int z)
+{
+	const uint64_t mask = (1u << 21) - 1;
+	return(((uint64_t)(x & mask) << 42) | ((uint64_t)(y & mask) << 21) | (uint64_t)(z & mask));
+}
+
+/***********************************************************
+ *  CellCoordinate()
+ *
+ *  This method returns the cell index along one axis.
+ ***********************************************************/
+int SpatialGrid::CellCoordinate(float value) const
+{
+	return((int)std::floor(value / m_cellSize));
+}
+
+/***********************************************************
+ *  SignedDistance()
+ *
+ *  This method returns the exact distance from a point to the
+ *  surface of an object, negative inside it.
+ ***********************************************************/
+float SpatialGrid::SignedDistance(const SPATIAL_OBJECT& object, const glm::vec3& point) const
+{
+	glm::vec3 offset = point - object.center;
+
+	switch (object.shape.type)
+	{
+	case SHAPE_SPHERE:
+		return(glm::length(offset) - object.majorRadius);
+
+	case SHAPE_TORUS:
+	{
+		// the ring lies in the plane of the first two axes
+		float height = glm::dot(offset, object.axes[2]);
+		glm::vec3 radial = offset - object.axes[2] * height;
+		float ringDistance = glm::length(radial) - object.majorRadius;
+		return(std::sqrt(ringDistance * ringDistance + height * height) - object.minorRadius);
+	}
+
+	case SHAPE_BOX:
+	default:
+	{
+		glm::vec3 q;
+		for (int i = 0; i < 3; i++)
+		{
+			q[i] = std::fabs(glm::dot(offset, object.axes[i])) - object.halfExtents[i];
+		}
+		glm::vec3 outside = glm::max(q, glm::vec3(0.0f));
+		float inside = std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+		return(glm::length(outside) + inside);
+	}
+	}
+}
+
+/***********************************************************
+ *  SurfaceNormal()
+ *
+ *  This method returns the direction in which the distance to
+ *  an object grows fastest at a point, which is the surface
+ *  normal of the nearest surface point (central differences).
+ ***********************************************************/
+glm::vec3 SpatialGrid::SurfaceNormal(const SPATIAL_OBJECT& object, const glm::vec3& point) const
+{
+	const float h = 0.001f;
+	glm::vec3 gradient(
+		SignedDistance(object, point + glm::vec3(h, 0.0f, 0.0f)) - SignedDistance(object, point - glm::vec3(h, 0.0f, 0.0f)),
+		SignedDistance(object, point + glm::vec3(0.0f, h, 0.0f)) - SignedDistance(object, point - glm::vec3(0.0f, h, 0.0f)),
+		SignedDistance(object, point + glm::vec3(0.0f, 0.0f, h)) - SignedDistance(object, point - glm::vec3(0.0f, 0.0f, h)));
+
+	float length = glm::length(gradient);
+	if (length <= 0.0f)
+	{
+		return(glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+	return(gradient / length);
+}
+
+/***********************************************************
+ *  RayObject()
+ *
+ *  This method intersects a ray (unit direction) with one
+ *  object.  Boxes use the slab test in the box frame, spheres
+ *  the quadratic, and tori sphere tracing of the distance
+ *  function from where the ray enters the torus bounds.
+ ***********************************************************/
+bool SpatialGrid::RayObject(const SPATIAL_OBJECT& object, const glm::vec3& origin, const glm::vec3& direction, float maxT, float& t) const
+{
+	glm::vec3 offset = origin - object.center;
+
+	if (object.shape.type == SHAPE_SPHERE)
+	{
+		float b = glm::dot(offset, direction);
+		float c = glm::dot(offset, offset) - object.majorRadius * object.majorRadius;
+		float discriminant = b * b - c;
+		if (discriminant < 0.0f)
+			return(false);
+
+		float root = std::sqrt(discriminant);
+		t = -b - root;
+		if (t < 0.0f)
+			t = -b + root;
+		return((t >= 0.0f) && (t <= maxT));
+	}
+
+	// slab test against the oriented box (also the torus bounds)
+	float tNear = 0.0f;
+	float tFar = maxT;
+	for (int i = 0; i < 3; i++)
+	{
+		float o = glm::dot(offset, object.axes[i]);
+		float d = glm::dot(direction, object.axes[i]);
+		float h = object.halfExtents[i];
+
+		if (std::fabs(d) < 1e-8f)
+		{
+			if ((o < -h) || (o > h))
+				return(false);
+			continue;
+		}
+
+		float t0 = (-h - o) / d;
+		float t1 = (h - o) / d;
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tNear = std::max(tNear, t0);
+		tFar = std::min(tFar, t1);
+		if (tNear > tFar)
+			return(false);
+	}
+
+	if (object.shape.type == SHAPE_BOX)
+	{
+		t = tNear;
+		return(true);
+	}
+
+	// sphere trace the torus inside its bounds
+	t = tNear;
+	for (int step = 0; step < g_MaxTraceSteps; step++)
+	{
+		float distance = SignedDistance(object, origin + direction * t);
+		if (distance < g_ContactEpsilon)
+			return(true);
+		t += distance;
+		if (t > tFar)
+			return(false);
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *  RayCast()
+ *
+ *  This method walks the cells along the ray in order (3D
+ *  DDA) and tests the objects in each.  The walk stops as
+ *  soon as the nearest hit lies before the current cell's
+ *  exit, since no later cell can contain a nearer one.
+ ***********************************************************/
+bool SpatialGrid::RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, SPATIAL_HIT& hit) const
+{
+	float length = glm::length(direction);
+	if ((length <= 0.0f) || m_cells.empty())
+	{
+		return(false);
+	}
+	glm::vec3 dir = direction / length;
+
+	m_queryStamp++;
+	hit.handle = -1;
+	hit.t = maxDistance;
+
+	int cell[3];
+	int step[3];
+	float tMax[3];
+	float tDelta[3];
+	for (int i = 0; i < 3; i++)
+	{
+		cell[i] = CellCoordinate(origin[i]);
+		if (dir[i] > 0.0f)
+		{
+			step[i] = 1;
+			tMax[i] = ((cell[i] + 1) * m_cellSize - origin[i]) / dir[i];
+			tDelta[i] = m_cellSize / dir[i];
+		}
+		else if (dir[i] < 0.0f)
+		{
+			step[i] = -1;
+			tMax[i] = (cell[i] * m_cellSize - origin[i]) / dir[i];
+			tDelta[i] = -m_cellSize / dir[i];
+		}
+		else
+		{
+			step[i] = 0;
+			tMax[i] = std::numeric_limits<float>::max();
+			tDelta[i] = std::numeric_limits<float>::max();
+		}
+	}
+
+	for (int visited = 0; visited < g_MaxRayCells; visited++)
+	{
+		std::unordered_map<uint64_t, std::vector<int> >::const_iterator found =
+			m_cells.find(CellKey(cell[0], cell[1], cell[2]));
+		if (found != m_cells.end())
+		{
+			const std::vector<int>& handles = found->second;
+			for (size_t i = 0; i < handles.size(); i++)
+			{
+				const SPATIAL_OBJECT& object = m_objects[handles[i]];
+				if (object.queryStamp == m_queryStamp)
+					continue;
+				object.queryStamp = m_queryStamp;
+
+				float t = 0.0f;
+				if (RayObject(object, origin, dir, hit.t, t) && (t < hit.t))
+				{
+					hit.handle = handles[i];
+					hit.t = t;
+				}
+			}
+		}
+
+		// step into the next cell along the axis crossed first
+		int axis = 0;
+		if (tMax[1] < tMax[axis]) axis = 1;
+		if (tMax[2] < tMax[axis]) axis = 2;
+
+		float cellExit = tMax[axis];
+		if ((hit.handle >= 0) && (hit.t <= cellExit))
+			break;
+		if (cellExit > maxDistance)
+			break;
+
+		cell[axis] += step[axis];
+		tMax[axis] += tDelta[axis];
+	}
+
+	if (hit.handle < 0)
+	{
+		return(false);
+	}
+	hit.point = origin + dir * hit.t;
+	hit.normal = SurfaceNormal(m_objects[hit.handle], hit.point);
+
+	return(true);
+}
+
+/***********************************************************
+ *  SphereSweep()
+ *
+ *  This method moves a sphere along a segment and reports
+ *  the first contact.  For each candidate object it uses
+ *  conservative advancement: the exact distance to the
+ *  surface is a step that can never pass through it.  The
+ *  hit point is the sphere centre at the moment of contact.
+ ***********************************************************/
+bool SpatialGrid::SphereSweep(const glm::vec3& start, const glm::vec3& end, float radius, SPATIAL_HIT& hit) const
+{
+	glm::vec3 motion = end - start;
+	float length = glm::length(motion);
+
+	std::vector<int> candidates;
+	QueryAABB(glm::min(start, end) - glm::vec3(radius), glm::max(start, end) + glm::vec3(radius), candidates);
+
+	hit.handle = -1;
+	hit.t = 1.0f;
+
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		const SPATIAL_OBJECT& object = m_objects[candidates[i]];
+
+		// already touching at the start - let the sphere move out
+		if (SignedDistance(object, start) < radius)
+			continue;
+
+		float t = 0.0f;
+		for (int step = 0; step < g_MaxSweepSteps; step++)
+		{
+			float distance = SignedDistance(object, start + motion * t) - radius;
+			if (distance < g_ContactEpsilon)
+			{
+				if (t < hit.t)
+				{
+					hit.handle = candidates[i];
+					hit.t = t;
+				}
+				break;
+			}
+			if (length <= 0.0f)
+				break;
+			t += distance / length;
+			if (t > hit.t)
+				break;
+		}
+	}
+
+	if (hit.handle < 0)
+	{
+		return(false);
+	}
+	hit.point = start + motion * hit.t;
+	hit.normal = SurfaceNormal(m_objects[hit.handle], hit.point);
+
+	return(true);
+}
+
+/***********************************************************
+ *  SphereOverlap()
+ *
+ *  This method tests whether a sphere touches any object.
+ ***********************************************************/
+bool SpatialGrid::SphereOverlap(const glm::vec3& center, float radius) const
+{
+	std::vector<int> candidates;
+	QueryAABB(center - glm::vec3(radius), center + glm::vec3(radius), candidates);
+
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		if (SignedDistance(m_objects[candidates[i]], center) < radius)
+			return(true);
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *  QueryAABB()
+ *
+ *  This method collects the handles of every object whose
+ *  world AABB overlaps the given box.
+ ***********************************************************/
+void SpatialGrid::QueryAABB(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<int>& handles) const
+{
+	m_queryStamp++;
+
+	int cellMin[3];
+	int cellMax[3];
+	for (int i = 0; i < 3; i++)
+	{
+		cellMin[i] = CellCoordinate(boxMin[i]);
+		cellMax[i] = CellCoordinate(boxMax[i]);
+	}
+
+	for (int x = cellMin[0]; x <= cellMax[0]; x++)
+	{
+		for (int y = cellMin[1]; y <= cellMax[1]; y++)
+		{
+			for (int z = cellMin[2]; z <= cellMax[2]; z++)
+			{
+				std::unordered_map<uint64_t, std::vector<int> >::const_iterator found =
+					m_cells.find(CellKey(x, y, z));
+				if (found == m_cells.end())
+					continue;
+
+				const std::vector<int>& cellHandles = found->second;
+				for (size_t i = 0; i < cellHandles.size(); i++)
+				{
+					const SPATIAL_OBJECT& object = m_objects[cellHandles[i]];
+					if (object.queryStamp == m_queryStamp)
+						continue;
+					object.queryStamp = m_queryStamp;
+
+					if ((object.boundsMin.x <= boxMax.x) && (object.boundsMax.x >= boxMin.x) &&
+						(object.boundsMin.y <= boxMax.y) && (object.boundsMax.y >= boxMin.y) &&
+						(object.boundsMin.z <= boxMax.z) && (object.boundsMax.z >= boxMin.z))
+					{
+						handles.push_back(cellHandles[i]);
+					}
+				}
+			}
+		}
+	}
+}
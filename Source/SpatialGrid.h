@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+// spatialgrid.h
+// ============
+// uniform grid over the world-space bounds of the scene objects for
+// ray casts, sphere sweeps and box overlap queries
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// shape used for the exact test once the grid has found a candidate
+enum SPATIAL_SHAPE_TYPE
+{
+	SHAPE_BOX,      // oriented box between localMin and localMax
+	SHAPE_SPHERE,   // sphere of majorRadius around the local origin
+	SHAPE_TORUS     // ring in the local XY plane around the local origin
+};
+
+/***********************************************************
+ *  SPATIAL_SHAPE
+ *
+ *  Shape of an object in its local (mesh) space.  The model
+ *  matrix passed to the grid places it in the world.  Spheres
+ *  and tori expect a uniform scale.
+ ***********************************************************/
+struct SPATIAL_SHAPE
+{
+	SPATIAL_SHAPE_TYPE type;
+	// extents of a SHAPE_BOX
+	glm::vec3 localMin;
+	glm::vec3 localMax;
+	// radius of a SHAPE_SPHERE, ring radius of a SHAPE_TORUS
+	float majorRadius;
+	// tube radius of a SHAPE_TORUS
+	float minorRadius;
+};
+
+/***********************************************************
+ *  SPATIAL_HIT
+ *
+ *  Result of a ray cast or sphere sweep.
+ ***********************************************************/
+struct SPATIAL_HIT
+{
+	// handle of the object that was hit
+	int handle;
+	// distance along the ray, or fraction [0,1] of a sweep
+	float t;
+	// world-space point of contact; for a sweep, the centre of
+	// the sphere at the moment of contact
+	glm::vec3 point;
+	// unit surface normal of the object at the contact
+	glm::vec3 normal;
+};
+
+/***********************************************************
+ *  SpatialGrid
+ *
+ *  Sparse uniform grid - only occupied cells are stored, in a
+ *  hash map keyed by the cell coordinates.  Each object lives
+ *  in every cell its world-space AABB touches, so a query only
+ *  looks at the objects in the cells it passes through and
+ *  then runs an exact test against the object's shape.
+ *
+ *  Objects can be moved with Update(), which only touches the
+ *  cells the object leaves or enters.  The grid is not thread
+ *  safe; it is used from the simulation thread only.
+ ***********************************************************/
+class SpatialGrid
+{
+public:
+	// constructor
+	SpatialGrid(float cellSize);
+
+	// add an object; returns its handle
+	int Insert(const std::string& name, const SPATIAL_SHAPE& shape, const glm::mat4& model);
+	// move an existing object
+	void Update(int handle, const glm::mat4& model);
+	// remove an object; its handle is not reused
+	void Remove(int handle);
+	// remove all objects
+	void Clear();
+
+	// nearest object hit by a ray (direction need not be normalized)
+	bool RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, SPATIAL_HIT& hit) const;
+	// first object a sphere touches moving from start to end;
+	// objects the sphere already overlaps at the start are ignored
+	// so a trapped sphere can always move out
+	bool SphereSweep(const glm::vec3& start, const glm::vec3& end, float radius, SPATIAL_HIT& hit) const;
+	// true if the sphere overlaps any object
+	bool SphereOverlap(const glm::vec3& center, float radius) const;
+	// handles of all objects whose world AABB overlaps the box
+	void QueryAABB(const glm::vec3& boxMin, const glm::vec3& boxMax, std::vector<int>& handles) const;
+
+	// name given to an object when it was inserted
+	const std::string& GetName(int handle) const { return m_objects[handle].name; }
+	// number of live objects
+	int GetObjectCount() const { return m_liveObjects; }
+
+private:
+	struct SPATIAL_OBJECT
+	{
+		std::string name;
+		SPATIAL_SHAPE shape;
+		bool bAlive;
+		// world-space frame: centre, unit axes and half extents
+		glm::vec3 center;
+		glm::vec3 axes[3];
+		glm::vec3 halfExtents;
+		// world radii of spheres and tori
+		float majorRadius;
+		float minorRadius;
+		// world-space AABB and the range of cells it covers
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		int cellMin[3];
+		int cellMax[3];
+		// last query that visited the object, to skip duplicates
+		mutable unsigned int queryStamp;
+	};
+
+	// compute the world frame and bounds of an object
+	void PlaceObject(SPATIAL_OBJECT& object, const glm::mat4& model);
+	// add / remove an object to / from the cells it covers
+	void LinkObject(int handle);
+	void UnlinkObject(int handle);
+	// hash map key of a cell
+	static uint64_t CellKey(int x, int y, int z);
+	// cell coordinate containing a world coordinate
+	int CellCoordinate(float value) const;
+
+	// exact tests against one object's shape
+	float SignedDistance(const SPATIAL_OBJECT& object, const glm::vec3& point) const;
+	glm::vec3 SurfaceNormal(const SPATIAL_OBJECT& object, const glm::vec3& point) const;
+	bool RayObject(const SPATIAL_OBJECT& object, const glm::vec3& origin, const glm::vec3& direction, float maxT, float& t) const;
+
+	// edge length of a cell
+	float m_cellSize;
+	// all objects ever inserted, indexed by handle
+	std::vector<SPATIAL_OBJECT> m_objects;
+	// handles of the objects in each occupied cell
+	std::unordered_map<uint64_t, std::vector<int> > m_cells;
+	// number of objects not removed
+	int m_liveObjects;
+	// counter used to visit each object once per query
+	mutable unsigned int m_queryStamp;
+};
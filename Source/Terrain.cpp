@@ -0,0 +1,692 @@
+///////////////////////////////////////////////////////////////////////////////
+// terrain.cpp
+// ============
+// chunked heightfield terrain with continuous distance-based LOD (CDLOD)
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Terrain.h"
+#include "EntityStore.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// binding points used by the terrain shader
+	const GLuint g_InstanceBinding = 2;
+	const GLuint g_TerrainBinding = 3;
+	// texture unit of the height tiles, after the virtual
+	// texture's units
+	const GLuint g_HeightUnit = 18;
+	// height tiles queued per frame at most
+	const size_t g_MaxTileRequests = 256;
+
+	/***********************************************************
+	 *  BoxInFrustum()
+	 *
+	 *  True if a box is at least partly inside the frustum.
+	 ***********************************************************/
+	bool BoxInFrustum(const glm::vec4 planes[6], const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			// the corner furthest along the plane's normal
+			glm::vec3 corner(
+				(planes[i].x >= 0.0f) ? boxMax.x : boxMin.x,
+				(planes[i].y >= 0.0f) ? boxMax.y : boxMin.y,
+				(planes[i].z >= 0.0f) ? boxMax.z : boxMin.z);
+			if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.0f)
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+
+	/***********************************************************
+	 *  BoxInRange()
+	 *
+	 *  True if any point of a box is within a distance.
+	 ***********************************************************/
+	bool BoxInRange(const glm::vec3& position, float range, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		glm::vec3 closest = glm::min(glm::max(position, boxMin), boxMax);
+		glm::vec3 offset = closest - position;
+		return(glm::dot(offset, offset) <= range * range);
+	}
+}
+
+/***********************************************************
+ *  Terrain()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+Terrain::Terrain(const TERRAIN_SETTINGS& settings)
+	: m_heightfield(TERRAIN_SHAPE())
+{
+	m_settings = settings;
+	m_levelCount = 0;
+	for (int i = 0; i < TERRAIN_MAX_LEVELS; i++)
+	{
+		m_ranges[i] = 0.0f;
+	}
+	m_vertexArray = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_fullIndexCount = 0;
+	m_quarterIndexCount = 0;
+	m_quarterBaseVertex = 0;
+	m_quarterFirstIndex = 0;
+	m_heightTexture = 0;
+	m_tileSize = 0;
+	m_frame = 0;
+	m_instanceBuffer = 0;
+	m_terrainBuffer = 0;
+	m_pFullInstances = NULL;
+	m_pQuarterInstances = NULL;
+	m_fullCount = 0;
+	m_quarterCount = 0;
+	m_viewPosition = glm::vec3(0.0f);
+	m_pShaders = NULL;
+	m_pFeedbackShaders = NULL;
+	m_bStreaming = false;
+}
+
+/***********************************************************
+ *  ~Terrain()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+Terrain::~Terrain()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings the scene uses.
+ ***********************************************************/
+TERRAIN_SETTINGS Terrain::DefaultSettings()
+{
+	TERRAIN_SETTINGS settings;
+	settings.gridResolution = 32;
+	settings.leafNodeSize = 8.0f;
+	settings.maxLevels = 10;
+	settings.detailDistance = 3.0f;
+	settings.morphRatio = 0.3f;
+	settings.tileCacheSize = 1024;
+	settings.tilesPerFrame = 32;
+	settings.maxInstances = 1024;
+	return(settings);
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method builds the quadtree over the grounds: the
+ *  fewest levels whose root nodes cover the grounds, up to
+ *  maxLevels, with as many roots as it takes.  The roots'
+ *  height tiles are generated right away and never evicted,
+ *  so there is always something to draw.
+ ***********************************************************/
+bool Terrain::Initialize(const TERRAIN_SHAPE& shape, const char* vertexShaderFile, const char* fragmentShaderFile,
+	const char* feedbackFragmentShaderFile, const char* shaderCacheDirectory)
+{
+	Destroy();
+
+	m_settings.gridResolution = std::min(std::max(m_settings.gridResolution & ~1, 2), 254);
+	m_settings.maxLevels = std::min(std::max(m_settings.maxLevels, 1), TERRAIN_MAX_LEVELS);
+	m_heightfield = TerrainHeightfield(shape);
+
+	m_vertexShaderFile = vertexShaderFile;
+	m_fragmentShaderFile = fragmentShaderFile;
+	m_feedbackFragmentShaderFile = feedbackFragmentShaderFile;
+	m_shaderCacheDirectory = shaderCacheDirectory;
+	m_pShaders = new ShaderVariantCache(shaderCacheDirectory);
+	m_pFeedbackShaders = new ShaderVariantCache(shaderCacheDirectory);
+	if (!m_pShaders->LoadSources(vertexShaderFile, fragmentShaderFile) ||
+		!m_pFeedbackShaders->LoadSources(vertexShaderFile, feedbackFragmentShaderFile))
+	{
+		Destroy();
+		return(false);
+	}
+
+	// levels and LOD ranges
+	float extent = std::max(shape.size.x, shape.size.y);
+	m_levelCount = 1;
+	while ((m_levelCount < m_settings.maxLevels) && (m_settings.leafNodeSize * (float)(1 << (m_levelCount - 1)) < extent))
+	{
+		m_levelCount++;
+	}
+	for (int level = 0; level < m_levelCount; level++)
+	{
+		m_ranges[level] = m_settings.detailDistance * m_settings.leafNodeSize * (float)(1 << level);
+	}
+
+	// the quadtree
+	float rootSize = m_settings.leafNodeSize * (float)(1 << (m_levelCount - 1));
+	glm::vec2 groundsMin = glm::vec2(shape.center.x, shape.center.z) - shape.size * 0.5f;
+	int rootsX = std::max((int)std::ceil(shape.size.x / rootSize), 1);
+	int rootsZ = std::max((int)std::ceil(shape.size.y / rootSize), 1);
+	for (int z = 0; z < rootsZ; z++)
+	{
+		for (int x = 0; x < rootsX; x++)
+		{
+			m_roots.push_back(BuildNode(groundsMin.x + x * rootSize, groundsMin.y + z * rootSize, rootSize, m_levelCount - 1));
+		}
+	}
+
+	// height tiles - each node's grid plus a one sample border
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	int tileCount = std::min(std::max(m_settings.tileCacheSize, (int)m_roots.size() + 16), (int)maxLayers);
+	m_tileSize = m_settings.gridResolution + 3;
+	glGenTextures(1, &m_heightTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_heightTexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R32F, m_tileSize, m_tileSize, tileCount);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	m_tileCache.Reset((uint32_t)tileCount, (uint32_t)m_nodes.size());
+	m_tileHeights.resize((size_t)m_tileSize * m_tileSize);
+	m_nodeFrame.assign(m_nodes.size(), 0);
+	m_tileRequests.reserve(g_MaxTileRequests);
+
+	// constants and per-frame instances
+	GPU_TERRAIN terrain;
+	for (int level = 0; level < TERRAIN_MAX_LEVELS; level++)
+	{
+		terrain.morph[level] = glm::vec4(0.0f);
+		if (level + 1 < m_levelCount)
+		{
+			// the top level never morphs
+			float previous = (level > 0) ? m_ranges[level - 1] : 0.0f;
+			float morphStart = previous + (m_ranges[level] - previous) * (1.0f - m_settings.morphRatio);
+			terrain.morph[level] = glm::vec4(morphStart, 1.0f / std::max(m_ranges[level] - morphStart, 0.001f), 0.0f, 0.0f);
+		}
+	}
+	terrain.bounds = glm::vec4(groundsMin, groundsMin + shape.size);
+	terrain.texture = glm::vec4(groundsMin.x, groundsMin.y + shape.size.y, 1.0f / shape.size.x, 1.0f / shape.size.y);
+	terrain.tile = glm::vec4(1.0f / m_tileSize, (float)m_settings.gridResolution, 0.0f, 0.0f);
+	glGenBuffers(1, &m_terrainBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_terrainBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(GPU_TERRAIN), &terrain, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glGenBuffers(1, &m_instanceBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(2 * m_settings.maxInstances * sizeof(GPU_TERRAIN_INSTANCE)),
+		NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	CreateGridMeshes();
+
+	// the roots are always resident
+	for (size_t i = 0; i < m_roots.size(); i++)
+	{
+		m_tileRequests.push_back(m_roots[i]);
+	}
+	int tilesPerFrame = m_settings.tilesPerFrame;
+	m_settings.tilesPerFrame = (int)m_roots.size();
+	GenerateTiles();
+	m_settings.tilesPerFrame = tilesPerFrame;
+	for (size_t i = 0; i < m_roots.size(); i++)
+	{
+		m_tileCache.Pin(m_tileCache.Find((uint32_t)m_roots[i]));
+	}
+
+	std::cout << "Terrain: " << shape.size.x << " x " << shape.size.y << ", " << m_levelCount << " levels, "
+		<< m_roots.size() << " roots, " << m_nodes.size() << " nodes of " << m_settings.gridResolution << " x "
+		<< m_settings.gridResolution << " quads, " << tileCount << " height tiles ("
+		<< (tileCount * m_tileHeights.size() * sizeof(float) / 1024) << " KB)" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method frees the quadtree and the GL objects.
+ ***********************************************************/
+void Terrain::Destroy()
+{
+	if (m_vertexArray != 0)
+		glDeleteVertexArrays(1, &m_vertexArray);
+	if (m_vertexBuffer != 0)
+		glDeleteBuffers(1, &m_vertexBuffer);
+	if (m_indexBuffer != 0)
+		glDeleteBuffers(1, &m_indexBuffer);
+	if (m_heightTexture != 0)
+		glDeleteTextures(1, &m_heightTexture);
+	if (m_instanceBuffer != 0)
+		glDeleteBuffers(1, &m_instanceBuffer);
+	if (m_terrainBuffer != 0)
+		glDeleteBuffers(1, &m_terrainBuffer);
+	m_vertexArray = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_heightTexture = 0;
+	m_instanceBuffer = 0;
+	m_terrainBuffer = 0;
+
+	delete m_pShaders;
+	m_pShaders = NULL;
+	delete m_pFeedbackShaders;
+	m_pFeedbackShaders = NULL;
+
+	m_nodes.clear();
+	m_roots.clear();
+	m_levelCount = 0;
+	m_fullCount = 0;
+	m_quarterCount = 0;
+	m_bStreaming = false;
+}
+
+/***********************************************************
+ *  ReloadShaders()
+ *
+ *  This method rebuilds the scene and feedback programs
+ *  from the shader files.
+ ***********************************************************/
+bool Terrain::ReloadShaders(const SHADER_VARIANT& variant)
+{
+	ShaderVariantCache* pShaders = new ShaderVariantCache(m_shaderCacheDirectory.c_str());
+	ShaderVariantCache* pFeedbackShaders = new ShaderVariantCache(m_shaderCacheDirectory.c_str());
+	if (!pShaders->LoadSources(m_vertexShaderFile.c_str(), m_fragmentShaderFile.c_str()) ||
+		!pFeedbackShaders->LoadSources(m_vertexShaderFile.c_str(), m_feedbackFragmentShaderFile.c_str()) ||
+		(pShaders->GetProgram(variant) == 0))
+	{
+		delete pShaders;
+		delete pFeedbackShaders;
+		std::cout << "Terrain shader reload failed - keeping the previous shaders" << std::endl;
+		return(false);
+	}
+
+	delete m_pShaders;
+	m_pShaders = pShaders;
+	delete m_pFeedbackShaders;
+	m_pFeedbackShaders = pFeedbackShaders;
+	return(true);
+}
+
+/***********************************************************
+ *  Select()
+ *
+ *  This method walks the quadtree for the snapshot's camera
+ *  and uploads the instances of the nodes to draw, then
+ *  generates the tiles the walk found missing.  Those are
+ *  used from the next frame on.
+ ***********************************************************/
+void Terrain::Select(const SCENE_SNAPSHOT& snapshot, FrameArena& arena)
+{
+	m_frame++;
+	m_viewPosition = snapshot.viewPosition;
+	EntityStore::ExtractFrustumPlanes(snapshot.projection * snapshot.view, m_frustumPlanes);
+
+	m_pFullInstances = arena.AllocateArray<GPU_TERRAIN_INSTANCE>((size_t)m_settings.maxInstances);
+	m_pQuarterInstances = arena.AllocateArray<GPU_TERRAIN_INSTANCE>((size_t)m_settings.maxInstances);
+	m_fullCount = 0;
+	m_quarterCount = 0;
+	m_tileRequests.clear();
+	for (size_t i = 0; i < m_roots.size(); i++)
+	{
+		if (m_roots[i] >= 0)
+			SelectNode(m_roots[i]);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+	if (m_fullCount > 0)
+	{
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)(m_fullCount * sizeof(GPU_TERRAIN_INSTANCE)),
+			m_pFullInstances);
+	}
+	if (m_quarterCount > 0)
+	{
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)(m_fullCount * sizeof(GPU_TERRAIN_INSTANCE)),
+			(GLsizeiptr)(m_quarterCount * sizeof(GPU_TERRAIN_INSTANCE)), m_pQuarterInstances);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	m_bStreaming = !m_tileRequests.empty();
+	GenerateTiles();
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method draws the selected nodes with the program of
+ *  the terrain object's shader variant.
+ ***********************************************************/
+void Terrain::Draw(uint32_t objectIndex, const SHADER_VARIANT& variant)
+{
+	GLuint program = m_pShaders->GetProgram(variant);
+	if (program != 0)
+	{
+		DrawInstances(program, glGetUniformLocation(program, "objectIndex"), objectIndex);
+	}
+}
+
+/***********************************************************
+ *  DrawFeedback()
+ *
+ *  This method draws the selected nodes into the virtual
+ *  texture's feedback target, which must be bound.
+ ***********************************************************/
+void Terrain::DrawFeedback(uint32_t objectIndex, float feedbackBias)
+{
+	// the virtual textured variant leaves the texture
+	// coordinates unscaled, as the feedback needs them
+	SHADER_VARIANT variant;
+	variant.bTextured = false;
+	variant.bVirtualTextured = true;
+	variant.bLit = false;
+	variant.bLightmapped = false;
+	variant.bAlphaTested = false;
+	variant.lightCount = 0;
+	GLuint program = m_pFeedbackShaders->GetProgram(variant);
+	if (program != 0)
+	{
+		glUseProgram(program);
+		glUniform1f(glGetUniformLocation(program, "feedbackBias"), feedbackBias);
+		DrawInstances(program, glGetUniformLocation(program, "objectIndex"), objectIndex);
+	}
+}
+
+/***********************************************************
+ *  BuildNode()
+ *
+ *  This method adds a node and, down to the finest level,
+ *  its children.  Returns -1 for a node outside the grounds.
+ ***********************************************************/
+int Terrain::BuildNode(float x, float z, float size, int level)
+{
+	const TERRAIN_SHAPE& shape = m_heightfield.GetShape();
+	glm::vec2 groundsMin = glm::vec2(shape.center.x, shape.center.z) - shape.size * 0.5f;
+	glm::vec2 groundsMax = groundsMin + shape.size;
+	if ((x >= groundsMax.x) || (z >= groundsMax.y) || (x + size <= groundsMin.x) || (z + size <= groundsMin.y))
+	{
+		return(-1);
+	}
+
+	int nodeIndex = (int)m_nodes.size();
+	TERRAIN_NODE node;
+	node.x = x;
+	node.z = z;
+	node.size = size;
+	node.level = level;
+	node.minHeight = m_heightfield.GetMinHeight();
+	node.maxHeight = m_heightfield.GetMaxHeight();
+	for (int i = 0; i < 4; i++)
+	{
+		node.children[i] = -1;
+	}
+	m_nodes.push_back(node);
+
+	if (level > 0)
+	{
+		float half = size * 0.5f;
+		for (int i = 0; i < 4; i++)
+		{
+			int child = BuildNode(x + (i & 1) * half, z + (i >> 1) * half, half, level - 1);
+			m_nodes[nodeIndex].children[i] = child;
+		}
+	}
+	return(nodeIndex);
+}
+
+/***********************************************************
+ *  SelectNode()
+ *
+ *  This method is the CDLOD selection of a node.  A node
+ *  beyond its level's range is left to its parent.  One
+ *  within range of the next finer level is split, and each
+ *  child that is beyond that range is drawn as a quarter of
+ *  this node instead; otherwise the node is drawn whole.
+ *  Nodes outside the frustum count as handled.
+ ***********************************************************/
+bool Terrain::SelectNode(int nodeIndex)
+{
+	const TERRAIN_NODE& node = m_nodes[nodeIndex];
+	glm::vec3 boxMin(node.x, node.minHeight, node.z);
+	glm::vec3 boxMax(node.x + node.size, node.maxHeight, node.z + node.size);
+
+	if (!BoxInFrustum(m_frustumPlanes, boxMin, boxMax))
+	{
+		return(true);
+	}
+	if ((node.level + 1 < m_levelCount) && !BoxInRange(m_viewPosition, m_ranges[node.level], boxMin, boxMax))
+	{
+		return(false);
+	}
+	if ((node.level == 0) || !BoxInRange(m_viewPosition, m_ranges[node.level - 1], boxMin, boxMax))
+	{
+		AddInstance(nodeIndex, -1);
+		return(true);
+	}
+
+	// split only once every child can be drawn
+	bool bChildrenResident = true;
+	for (int i = 0; i < 4; i++)
+	{
+		if ((node.children[i] >= 0) && !IsTileResident(node.children[i]))
+			bChildrenResident = false;
+	}
+	if (!bChildrenResident)
+	{
+		AddInstance(nodeIndex, -1);
+		return(true);
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		int child = m_nodes[nodeIndex].children[i];
+		if ((child >= 0) && !SelectNode(child))
+		{
+			AddInstance(nodeIndex, i);
+		}
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  AddInstance()
+ *
+ *  This method adds a node to the frame's instances, whole
+ *  (quarter -1) or one quarter of it.  Instances beyond
+ *  maxInstances are dropped.
+ ***********************************************************/
+void Terrain::AddInstance(int nodeIndex, int quarter)
+{
+	const TERRAIN_NODE& node = m_nodes[nodeIndex];
+	int slot = m_tileCache.Find((uint32_t)nodeIndex);
+	if (slot < 0)
+	{
+		return;
+	}
+	m_tileCache.Touch(slot);
+	m_nodeFrame[nodeIndex] = m_frame;
+
+	GPU_TERRAIN_INSTANCE instance;
+	instance.node = glm::vec4(node.x, node.z, node.size / m_settings.gridResolution, (float)node.level);
+	instance.tile = glm::vec4((float)slot, 0.0f, 0.0f, 0.0f);
+	if (quarter < 0)
+	{
+		if (m_fullCount < m_settings.maxInstances)
+			m_pFullInstances[m_fullCount++] = instance;
+	}
+	else
+	{
+		int half = m_settings.gridResolution / 2;
+		instance.tile.y = (float)((quarter & 1) * half);
+		instance.tile.z = (float)((quarter >> 1) * half);
+		if (m_quarterCount < m_settings.maxInstances)
+			m_pQuarterInstances[m_quarterCount++] = instance;
+	}
+}
+
+/***********************************************************
+ *  IsTileResident()
+ *
+ *  This method tells whether a node's height tile is on the
+ *  GPU, marking it as used; a missing tile is queued.
+ ***********************************************************/
+bool Terrain::IsTileResident(int nodeIndex)
+{
+	int slot = m_tileCache.Find((uint32_t)nodeIndex);
+	if (slot >= 0)
+	{
+		m_tileCache.Touch(slot);
+		m_nodeFrame[nodeIndex] = m_frame;
+		return(true);
+	}
+
+	if ((m_nodeFrame[nodeIndex] != m_frame) && (m_tileRequests.size() < g_MaxTileRequests))
+	{
+		m_nodeFrame[nodeIndex] = m_frame;
+		m_tileRequests.push_back(nodeIndex);
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  GenerateTiles()
+ *
+ *  This method generates the queued tiles, coarse levels
+ *  first, into the least recently used layers.  A tile used
+ *  this frame is never evicted; if all of them are, the
+ *  rest of the queue waits and its parents stay in view.
+ ***********************************************************/
+void Terrain::GenerateTiles()
+{
+	std::sort(m_tileRequests.begin(), m_tileRequests.end(),
+		[this](int a, int b) { return m_nodes[a].level > m_nodes[b].level; });
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_heightTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	int generated = 0;
+	for (size_t i = 0; (i < m_tileRequests.size()) && (generated < m_settings.tilesPerFrame); i++)
+	{
+		uint32_t leastRecentNode = m_tileCache.GetLeastRecentPage();
+		if ((leastRecentNode != INVALID_PAGE) && (m_nodeFrame[leastRecentNode] == m_frame) && (m_frame != 0))
+		{
+			break;
+		}
+
+		int nodeIndex = m_tileRequests[i];
+		TERRAIN_NODE& node = m_nodes[nodeIndex];
+		uint32_t evictedNode = INVALID_PAGE;
+		int slot = m_tileCache.Allocate((uint32_t)nodeIndex, evictedNode);
+		if (slot < 0)
+		{
+			break;
+		}
+
+		double spacing = (double)node.size / m_settings.gridResolution;
+		m_heightfield.FillTile(node.x - spacing, node.z - spacing, spacing, m_tileSize, m_tileHeights.data(),
+			node.minHeight, node.maxHeight);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot, m_tileSize, m_tileSize, 1, GL_RED, GL_FLOAT,
+			m_tileHeights.data());
+		generated++;
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+/***********************************************************
+ *  CreateGridMeshes()
+ *
+ *  This method creates the two grid meshes every node is
+ *  drawn with: the whole node, and a quarter of it at the
+ *  same spacing.  Vertices are the grid coordinates.
+ ***********************************************************/
+void Terrain::CreateGridMeshes()
+{
+	std::vector<GLubyte> vertices;
+	std::vector<GLushort> indices;
+	int sides[2] = { m_settings.gridResolution, m_settings.gridResolution / 2 };
+	for (int mesh = 0; mesh < 2; mesh++)
+	{
+		int side = sides[mesh];
+		GLushort baseVertex = (GLushort)(vertices.size() / 2);
+		if (mesh == 1)
+		{
+			m_quarterBaseVertex = (GLint)baseVertex;
+			m_quarterFirstIndex = indices.size();
+		}
+		for (int y = 0; y <= side; y++)
+		{
+			for (int x = 0; x <= side; x++)
+			{
+				vertices.push_back((GLubyte)x);
+				vertices.push_back((GLubyte)y);
+			}
+		}
+		// counter-clockwise seen from above
+		for (int y = 0; y < side; y++)
+		{
+			for (int x = 0; x < side; x++)
+			{
+				GLushort corner = (GLushort)(y * (side + 1) + x);
+				GLushort next = (GLushort)(corner + side + 1);
+				GLushort quad[6] = { corner, next, (GLushort)(corner + 1), (GLushort)(corner + 1), next, (GLushort)(next + 1) };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+		if (mesh == 0)
+			m_fullIndexCount = (GLsizei)indices.size();
+		else
+			m_quarterIndexCount = (GLsizei)(indices.size() - m_quarterFirstIndex);
+	}
+
+	glGenVertexArrays(1, &m_vertexArray);
+	glBindVertexArray(m_vertexArray);
+	glGenBuffers(1, &m_vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertices.size(), vertices.data(), GL_STATIC_DRAW);
+	glGenBuffers(1, &m_indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(indices.size() * sizeof(GLushort)), indices.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_UNSIGNED_BYTE, GL_FALSE, 2 * sizeof(GLubyte), (void*)0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  DrawInstances()
+ *
+ *  This method draws the frame's whole nodes and quarters,
+ *  one instanced call each.  The shader finds its instance
+ *  as gl_BaseInstance + gl_InstanceID.
+ ***********************************************************/
+void Terrain::DrawInstances(GLuint program, GLint objectLocation, uint32_t objectIndex)
+{
+	if ((m_fullCount == 0) && (m_quarterCount == 0))
+	{
+		return;
+	}
+
+	glUseProgram(program);
+	glUniform1i(objectLocation, (GLint)objectIndex);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, g_InstanceBinding, m_instanceBuffer);
+	glBindBufferBase(GL_UNIFORM_BUFFER, g_TerrainBinding, m_terrainBuffer);
+	glActiveTexture(GL_TEXTURE0 + g_HeightUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_heightTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindVertexArray(m_vertexArray);
+	if (m_fullCount > 0)
+	{
+		glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, m_fullIndexCount, GL_UNSIGNED_SHORT, (void*)0,
+			m_fullCount, 0, 0);
+	}
+	if (m_quarterCount > 0)
+	{
+		glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, m_quarterIndexCount, GL_UNSIGNED_SHORT,
+			(void*)(m_quarterFirstIndex * sizeof(GLushort)), m_quarterCount, m_quarterBaseVertex, (GLuint)m_fullCount);
+	}
+	glBindVertexArray(0);
+}
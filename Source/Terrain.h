@@ -0,0 +1,237 @@
+///////////////////////////////////////////////////////////////////////////////
+// terrain.h
+// ============
+// chunked heightfield terrain with continuous distance-based LOD (CDLOD)
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TerrainHeightfield.h"
+#include "PageCache.h"
+#include "ShaderVariantCache.h"
+#include "SceneSnapshot.h"
+#include "FrameArena.h"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// most LOD levels of a terrain; matches MAX_TERRAIN_LEVELS in
+// Shaders/terrainVertexShader.glsl
+const int TERRAIN_MAX_LEVELS = 12;
+
+/***********************************************************
+ *  TERRAIN_SETTINGS
+ *
+ *  Resolution and LOD distances of the terrain.
+ ***********************************************************/
+struct TERRAIN_SETTINGS
+{
+	// quads along the side of a node's grid (even, at most 254)
+	int gridResolution;
+	// side of the finest nodes in world units
+	float leafNodeSize;
+	// most LOD levels (at most TERRAIN_MAX_LEVELS)
+	int maxLevels;
+	// distance to which the finest level is drawn, in finest
+	// node sizes; every coarser level doubles it
+	float detailDistance;
+	// part of each LOD range over which the vertices morph
+	// into the next coarser level
+	float morphRatio;
+	// height tiles kept on the GPU, and generated per frame
+	int tileCacheSize;
+	int tilesPerFrame;
+	// nodes drawn per frame at most
+	int maxInstances;
+};
+
+/***********************************************************
+ *  GPU_TERRAIN_INSTANCE
+ *
+ *  One node (or quarter of a node) to draw; matches the
+ *  std430 TerrainInstance struct of the terrain shader.
+ ***********************************************************/
+struct GPU_TERRAIN_INSTANCE
+{
+	// xy = world x, z of the node's corner, z = grid spacing,
+	// w = LOD level
+	glm::vec4 node;
+	// x = height tile layer, yz = grid offset of the drawn part
+	glm::vec4 tile;
+};
+
+/***********************************************************
+ *  GPU_TERRAIN
+ *
+ *  Terrain constants; matches the std140 TerrainBlock of the
+ *  terrain shader.
+ ***********************************************************/
+struct GPU_TERRAIN
+{
+	// per level: x = morph start distance, y = 1 / morph length
+	glm::vec4 morph[TERRAIN_MAX_LEVELS];
+	// xy = min corner, zw = max corner of the grounds (x, z)
+	glm::vec4 bounds;
+	// xy = x at u = 0 and z at v = 0, zw = 1 / size
+	glm::vec4 texture;
+	// x = 1 / height tile size in texels, y = quads along a node
+	glm::vec4 tile;
+};
+
+/***********************************************************
+ *  Terrain
+ *
+ *  Draws the grounds as a heightfield with continuous
+ *  distance-based LOD:
+ *
+ *  - the grounds are covered by a quadtree of square nodes;
+ *    every node is drawn with the same grid mesh, scaled to
+ *    its size, so the finest nodes are the smallest
+ *  - each frame the quadtree is walked from the roots: nodes
+ *    outside the view frustum are skipped, and a node is
+ *    split while the camera is within the LOD range of its
+ *    children's level.  Ranges double per level, so the
+ *    vertex count stays about the same in screen space
+ *    however large the grounds are
+ *  - near the end of its range every vertex morphs onto the
+ *    grid of the next coarser level, so neighbouring nodes
+ *    of different levels meet without cracks and levels
+ *    change without popping
+ *  - every node has its own tile of heights, at its own
+ *    spacing with a one sample border for the normals.  The
+ *    tiles are generated when first needed, a few per frame,
+ *    into a fixed-size texture array with least recently
+ *    used eviction; until a node's children have their
+ *    tiles the node is drawn whole
+ *
+ *  The terrain is drawn as one object of the indirect
+ *  renderer: its material, texture (or virtual texture) and
+ *  lights come from that object's data, through the same
+ *  fragment shader.  All methods must be called on the
+ *  thread that owns the GL context.
+ ***********************************************************/
+class Terrain
+{
+public:
+	// constructor
+	Terrain(const TERRAIN_SETTINGS& settings);
+	// destructor
+	~Terrain();
+
+	// default settings: 32 x 32 grids, 8 unit finest nodes
+	static TERRAIN_SETTINGS DefaultSettings();
+
+	// build the quadtree for the grounds and the GL objects, and
+	// read the shaders (the fragment shaders are the indirect
+	// renderer's and the virtual texture feedback's)
+	bool Initialize(const TERRAIN_SHAPE& shape, const char* vertexShaderFile, const char* fragmentShaderFile,
+		const char* feedbackFragmentShaderFile, const char* shaderCacheDirectory);
+	void Destroy();
+	// rebuild the programs from the shader files; the current
+	// programs stay if one fails to build
+	bool ReloadShaders(const SHADER_VARIANT& variant);
+
+	const TERRAIN_SHAPE& GetShape() const { return m_heightfield.GetShape(); }
+	// height of the grounds at a point
+	float GetHeight(float x, float z) const { return m_heightfield.GetHeight(x, z); }
+
+	// choose the nodes to draw from the snapshot's camera and
+	// generate missing height tiles
+	void Select(const SCENE_SNAPSHOT& snapshot, FrameArena& arena);
+	// draw the selected nodes as the given indirect renderer
+	// object, with its shader variant
+	void Draw(uint32_t objectIndex, const SHADER_VARIANT& variant);
+	// draw the selected nodes into the virtual texture feedback
+	void DrawFeedback(uint32_t objectIndex, float feedbackBias);
+
+	// true while height tiles of nodes in view are missing
+	bool IsStreaming() const { return m_bStreaming.load(); }
+
+private:
+	// a node of the quadtree
+	struct TERRAIN_NODE
+	{
+		// world x, z of the min corner and side length
+		float x;
+		float z;
+		float size;
+		// LOD level, 0 = finest
+		int level;
+		// the four children, x halves first (-1 = none: a leaf,
+		// or a quarter outside the grounds)
+		int children[4];
+		// height range of the node - of the whole grounds until
+		// its tile is generated, then of the tile
+		float minHeight;
+		float maxHeight;
+	};
+
+	// build the nodes of a quadtree below a root
+	int BuildNode(float x, float z, float size, int level);
+	// select a node for a level; false if the node is beyond the
+	// level's range and its parent has to draw the area
+	bool SelectNode(int nodeIndex);
+	// add a node, or a quarter of it, to the frame's instances
+	void AddInstance(int nodeIndex, int quarter);
+	// true if the node's tile is resident; if not, queue it
+	bool IsTileResident(int nodeIndex);
+	// generate the queued tiles, up to tilesPerFrame
+	void GenerateTiles();
+	// create the grid meshes
+	void CreateGridMeshes();
+	// draw the frame's instances with a program
+	void DrawInstances(GLuint program, GLint objectLocation, uint32_t objectIndex);
+
+	TERRAIN_SETTINGS m_settings;
+	TerrainHeightfield m_heightfield;
+	std::vector<TERRAIN_NODE> m_nodes;
+	std::vector<int> m_roots;
+	int m_levelCount;
+	// LOD range of every level
+	float m_ranges[TERRAIN_MAX_LEVELS];
+
+	// grid meshes: the whole node and a quarter at the same spacing
+	GLuint m_vertexArray;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	GLsizei m_fullIndexCount;
+	GLsizei m_quarterIndexCount;
+	GLint m_quarterBaseVertex;
+	size_t m_quarterFirstIndex;
+
+	// height tiles: one layer per resident node
+	GLuint m_heightTexture;
+	int m_tileSize;
+	PageCache m_tileCache;
+	std::vector<float> m_tileHeights;
+	// frame each node was last drawn or queued
+	std::vector<uint32_t> m_nodeFrame;
+	uint32_t m_frame;
+	// nodes whose tiles are wanted this frame
+	std::vector<int> m_tileRequests;
+
+	// instances of the frame: whole nodes, then quarters
+	GLuint m_instanceBuffer;
+	GLuint m_terrainBuffer;
+	GPU_TERRAIN_INSTANCE* m_pFullInstances;
+	GPU_TERRAIN_INSTANCE* m_pQuarterInstances;
+	int m_fullCount;
+	int m_quarterCount;
+	// camera and frustum of the frame being selected
+	glm::vec3 m_viewPosition;
+	glm::vec4 m_frustumPlanes[6];
+
+	// programs: the scene variant and the feedback pass
+	std::string m_vertexShaderFile;
+	std::string m_fragmentShaderFile;
+	std::string m_feedbackFragmentShaderFile;
+	std::string m_shaderCacheDirectory;
+	ShaderVariantCache* m_pShaders;
+	ShaderVariantCache* m_pFeedbackShaders;
+	std::atomic<bool> m_bStreaming;
+};
@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+// terrainheightfield.cpp
+// ============
+// height of the garden grounds at any point, and tiles of heights for
+// the terrain's quadtree nodes
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TerrainHeightfield.h"
+
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+
+// declaration of global variables
+namespace
+{
+	// octaves of the hills
+	const int g_HillOctaves = 5;
+
+	/***********************************************************
+	 *  LatticeValue() / ValueNoise() / HillNoise()
+	 *
+	 *  Smooth value noise in [0, 1], summed over a few octaves.
+	 ***********************************************************/
+	double LatticeValue(int64_t x, int64_t y)
+	{
+		uint32_t hash = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u;
+		hash = (hash ^ (hash >> 13)) * 1274126177u;
+		hash ^= hash >> 16;
+		return((hash & 0xFFFF) / 65535.0);
+	}
+
+	double ValueNoise(double x, double y)
+	{
+		double cellX = std::floor(x);
+		double cellY = std::floor(y);
+		int64_t x0 = (int64_t)cellX;
+		int64_t y0 = (int64_t)cellY;
+		double fx = x - cellX;
+		double fy = y - cellY;
+		fx = fx * fx * (3.0 - 2.0 * fx);
+		fy = fy * fy * (3.0 - 2.0 * fy);
+		double bottom = LatticeValue(x0, y0) + (LatticeValue(x0 + 1, y0) - LatticeValue(x0, y0)) * fx;
+		double top = LatticeValue(x0, y0 + 1) + (LatticeValue(x0 + 1, y0 + 1) - LatticeValue(x0, y0 + 1)) * fx;
+		return(bottom + (top - bottom) * fy);
+	}
+
+	double HillNoise(double x, double y)
+	{
+		double sum = 0.0;
+		double amplitude = 0.5;
+		double total = 0.0;
+		for (int octave = 0; octave < g_HillOctaves; octave++)
+		{
+			sum += amplitude * ValueNoise(x, y);
+			total += amplitude;
+			x *= 2.0;
+			y *= 2.0;
+			amplitude *= 0.45;
+		}
+		return(sum / total);
+	}
+}
+
+/***********************************************************
+ *  TerrainHeightfield()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TerrainHeightfield::TerrainHeightfield(const TERRAIN_SHAPE& shape)
+{
+	m_shape = shape;
+	m_shape.hillSize = std::max(m_shape.hillSize, 1.0f);
+	m_shape.hillHeight = std::max(m_shape.hillHeight, 0.0f);
+}
+
+/***********************************************************
+ *  GetHeight()
+ *
+ *  This method returns the height at a point: flat inside
+ *  the flat area, with the hills fading in over half a hill
+ *  size outside it.
+ ***********************************************************/
+float TerrainHeightfield::GetHeight(double x, double z) const
+{
+	double dx = std::max(std::fabs(x - m_shape.center.x) - m_shape.flatSize.x, 0.0);
+	double dz = std::max(std::fabs(z - m_shape.center.z) - m_shape.flatSize.y, 0.0);
+	double ramp = std::min(std::sqrt(dx * dx + dz * dz) / (0.5 * m_shape.hillSize), 1.0);
+	if (ramp <= 0.0)
+	{
+		return(m_shape.center.y);
+	}
+	ramp = ramp * ramp * (3.0 - 2.0 * ramp);
+
+	double hills = HillNoise(x / m_shape.hillSize, z / m_shape.hillSize);
+	return((float)(m_shape.center.y + m_shape.hillHeight * ramp * hills));
+}
+
+/***********************************************************
+ *  FillTile()
+ *
+ *  This method evaluates a square grid of heights.
+ ***********************************************************/
+void TerrainHeightfield::FillTile(double x, double z, double spacing, int count, float* heights,
+	float& minHeight, float& maxHeight) const
+{
+	minHeight = GetMaxHeight();
+	maxHeight = GetMinHeight();
+	for (int row = 0; row < count; row++)
+	{
+		double sampleZ = z + row * spacing;
+		for (int column = 0; column < count; column++)
+		{
+			float height = GetHeight(x + column * spacing, sampleZ);
+			heights[row * count + column] = height;
+			minHeight = std::min(minHeight, height);
+			maxHeight = std::max(maxHeight, height);
+		}
+	}
+}
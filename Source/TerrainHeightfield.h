@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+// terrainheightfield.h
+// ============
+// height of the garden grounds at any point, and tiles of heights for
+// the terrain's quadtree nodes
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  TERRAIN_SHAPE
+ *
+ *  The grounds as given by the terrain record of the scene
+ *  file: a flat area for the garden, and gentle hills rising
+ *  around it.
+ ***********************************************************/
+struct TERRAIN_SHAPE
+{
+	// centre of the grounds; y is the height of the flat area
+	glm::vec3 center;
+	// extent along x and z
+	glm::vec2 size;
+	// highest the hills rise above the flat area
+	float hillHeight;
+	// horizontal size of the hills
+	float hillSize;
+	// half extents of the flat area around the centre
+	glm::vec2 flatSize;
+};
+
+/***********************************************************
+ *  TerrainHeightfield
+ *
+ *  The height function of the terrain.  Heights are
+ *  evaluated in double precision from world coordinates, so
+ *  two tiles sampling the same point - a node and its
+ *  parent along a shared edge - always get the same value.
+ *  This is where a surveyed height map of a real site would
+ *  be read instead.
+ ***********************************************************/
+class TerrainHeightfield
+{
+public:
+	// constructor
+	TerrainHeightfield(const TERRAIN_SHAPE& shape);
+
+	const TERRAIN_SHAPE& GetShape() const { return m_shape; }
+	// height at a point of the grounds
+	float GetHeight(double x, double z) const;
+	// lowest and highest height anywhere
+	float GetMinHeight() const { return m_shape.center.y; }
+	float GetMaxHeight() const { return m_shape.center.y + m_shape.hillHeight; }
+
+	// fill count x count heights starting at (x, z) with the
+	// given spacing, row by row along x; returns the lowest and
+	// highest of them
+	void FillTile(double x, double z, double spacing, int count, float* heights,
+		float& minHeight, float& maxHeight) const;
+
+private:
+	TERRAIN_SHAPE m_shape;
+};
@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// vertexformat.cpp
+// ============
+// vertex layouts the basic meshes can be uploaded in, and the packing
+// of the full float vertices into the compact layout
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VertexFormat.h"
+#include "MeshGenerator.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+/***********************************************************
+ *  FloatToHalf()
+ *
+ *  This function converts a float to a half float with
+ *  round-to-nearest-even.  Values too large for a half
+ *  become infinity and tiny ones become denormals or zero.
+ ***********************************************************/
+uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	// NaN and infinity
+	if (((bits >> 23) & 0xff) == 0xff)
+	{
+		return(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	}
+	// overflow
+	if (exponent >= 31)
+	{
+		return(sign | 0x7c00);
+	}
+	// denormal half or zero
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return(sign);
+
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if ((remainder > halfway) || ((remainder == halfway) && (half & 1)))
+			half++;
+		return(sign | (uint16_t)half);
+	}
+
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1fff;
+	// rounding may carry into the exponent, which is still correct
+	if ((remainder > 0x1000) || ((remainder == 0x1000) && (half & 1)))
+		half++;
+
+	return(sign | (uint16_t)half);
+}
+
+/***********************************************************
+ *  PackNormal()
+ *
+ *  This function packs a unit normal into the signed
+ *  normalized GL_INT_2_10_10_10_REV layout: x in bits 0-9,
+ *  y in bits 10-19, z in bits 20-29.
+ ***********************************************************/
+uint32_t PackNormal(float x, float y, float z)
+{
+	float components[3] = { x, y, z };
+	uint32_t packed = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		float value = std::max(-1.0f, std::min(components[i], 1.0f));
+		int32_t quantized = (int32_t)std::lround(value * 511.0f);
+		packed |= ((uint32_t)quantized & 0x3ff) << (10 * i);
+	}
+
+	return(packed);
+}
+
+/***********************************************************
+ *  PackCompactVertices()
+ *
+ *  This function packs interleaved full vertices into the
+ *  compact layout.
+ ***********************************************************/
+void PackCompactVertices(const float* vertices, uint32_t vertexCount, std::vector<COMPACT_VERTEX>& compact)
+{
+	compact.resize(vertexCount);
+
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		const float* vertex = vertices + i * MESH_FLOATS_PER_VERTEX;
+		COMPACT_VERTEX& packed = compact[i];
+
+		packed.position[0] = FloatToHalf(vertex[0]);
+		packed.position[1] = FloatToHalf(vertex[1]);
+		packed.position[2] = FloatToHalf(vertex[2]);
+		packed.position[3] = 0;
+		packed.normal = PackNormal(vertex[3], vertex[4], vertex[5]);
+		packed.uv[0] = FloatToHalf(vertex[6]);
+		packed.uv[1] = FloatToHalf(vertex[7]);
+	}
+}
@@ -0,0 +1,45 @@
+///////////////////////////////////////////////////////////////////////////////
+// vertexformat.h
+// ============
+// vertex layouts the basic meshes can be uploaded in, and the packing
+// of the full float vertices into the compact layout
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// layout of the vertices in the OpenGL vertex buffers
+enum VERTEX_FORMAT
+{
+	// 32 bytes: float position, float normal, float UV
+	VERTEX_FORMAT_FULL,
+	// 16 bytes: half position, 10:10:10:2 normal, half UV
+	VERTEX_FORMAT_COMPACT
+};
+
+/***********************************************************
+ *  COMPACT_VERTEX
+ *
+ *  Compact vertex layout.  The basic meshes are unit sized,
+ *  so half floats keep positions to within about 1/2000 of
+ *  their size.  The normal is a signed normalized 10:10:10:2
+ *  value (GL_INT_2_10_10_10_REV), which the vertex fetch
+ *  unpacks, so the shaders are unchanged.
+ ***********************************************************/
+struct COMPACT_VERTEX
+{
+	// x, y, z and one half of padding for 4-byte alignment
+	uint16_t position[4];
+	uint32_t normal;
+	uint16_t uv[2];
+};
+
+// convert a float to an IEEE half float, rounding to nearest
+uint16_t FloatToHalf(float value);
+// pack a unit normal into a signed normalized 10:10:10:2 value
+uint32_t PackNormal(float x, float y, float z);
+// pack interleaved full vertices (position, normal, UV) into
+// the compact layout
+void PackCompactVertices(const float* vertices, uint32_t vertexCount, std::vector<COMPACT_VERTEX>& compact);
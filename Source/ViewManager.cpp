@@ -14,6 +14,8 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>    
 
+#include <algorithm>
+
 // declaration of the global variables and defines
 namespace
 {
@@ -23,14 +25,19 @@ namespace
 	const char* g_ViewName = "view";
 	const char* g_ProjectionName = "projection";
 
-	// these variables are used for mouse movement processing
-	float gLastX = WINDOW_WIDTH / 2.0f;
-	float gLastY = WINDOW_HEIGHT / 2.0f;
-	bool gFirstMouse = true;
+	// movement keys and the camera direction each one drives,
+	// indexed the same way as m_bMovementKeyDown
+	const int g_MovementKeys[6] = {
+		GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E };
+	const Camera_Movement g_MovementDirections[6] = {
+		FORWARD, BACKWARD, LEFT, RIGHT, DOWN, UP };
 
-	// time between current frame and last frame
-	float gDeltaTime = 0.0f;
-	float gLastFrame = 0.0f;
+	// a colliding camera stops this far short of the surface
+	const float g_CollisionSkin = 0.01f;
+	// number of surfaces the camera can slide along in one step
+	const int g_MaxSlideSteps = 3;
+	// longest distance at which objects can be picked
+	const float g_PickDistance = 200.0f;
 
 	// the following variable is false when orthographic projection
 	// is off and true when it is on
@@ -76,6 +83,19 @@ ViewManager::ViewManager(
 	firstMouse = true;			   // flag for first mouse event
 	movementSpeedFactor = 1.0f;    // default movement speed
 
+	// No movement keys are held at start-up
+	for (int i = 0; i < 6; i++)
+	{
+		m_bMovementKeyDown[i] = false;
+		m_movementKeyDownTime[i] = 0.0;
+	}
+	m_lastLatchTime = 0.0;
+	m_bScreenshotRequested = false;
+
+	// No collision until a spatial index is set
+	m_pCollisionGrid = NULL;
+	m_collisionRadius = 0.0f;
+
 	// Default to perspective projection
 	bOrthographicProjection = false;
 }
@@ -105,6 +125,15 @@ ViewManager::~ViewManager()
 GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 {
 	GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, windowTitle, NULL, NULL);
+#ifndef __APPLE__
+	// software renderers such as Mesa's stop at OpenGL 4.5, which
+	// the multi-draw path can still run on
+	if (window == NULL)
+	{
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+		window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, windowTitle, NULL, NULL);
+	}
+#endif
 
 	if (window == NULL)
 	{
@@ -120,12 +149,15 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	// Store 'this' pointer for static callbacks
 	glfwSetWindowUserPointer(window, this);
 
-	// This callback is used to receive mouse moving events
+	// These callbacks queue mouse, scroll and keyboard events
+	// for LatchInputEvents() instead of polling every frame
 	glfwSetCursorPosCallback(window, &ViewManager::MouseCallback);
+	glfwSetScrollCallback(window, &ViewManager::ScrollCallback);
+	glfwSetKeyCallback(window, &ViewManager::KeyCallback);
+	glfwSetMouseButtonCallback(window, &ViewManager::MouseButtonCallback);
 
-	// enable blending for supporting tranparent rendering
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// blending stays off - only the transparent pass of the
+	// scene turns it on, so opaque surfaces are drawn without it
 
 	m_pWindow = window;
 
@@ -139,44 +171,24 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
  *  the mouse is moved within the active GLFW display window.
  * 
  *  Design note:
- *  Camera control now uses the member variable m_pCamera
- *  instead of the old global g_pCamera. This makes the code
- *  object-oriented: each ViewManager manages its own camera
- *  rather than relying on a shared global.
- *
- *  Function:
- *  - Tracks the mouse position across frames
- *  - Calculates movement offsets
- *  - Passes offsets to the Camera to update its look direction
+ *  The callback only records the new cursor position with a
+ *  timestamp.  The offsets are worked out against the
+ *  per-instance lastX/lastY in ApplyInputEvent(), when the
+ *  input is latched just before the view matrix is built.
  ***********************************************************/
 void ViewManager::MouseCallback(GLFWwindow * window, double xMousePos, double yMousePos)
 {
 	ViewManager* vm = static_cast<ViewManager*>(glfwGetWindowUserPointer(window));
 	if (!vm) return;
 
-	Camera* camera = vm->m_pCamera;
-
-	// First time the mouse moves: just store its position
-	if (gFirstMouse)
-	{
-		gLastX = xMousePos;
-		gLastY = yMousePos;
-		gFirstMouse = false;
-	}
-
-	// Calculate movement relative to last position
-	float xoffset = xMousePos - gLastX;
-	float yoffset = gLastY - yMousePos;  // inverted: screen Y grows downward
-	gLastX = xMousePos;
-	gLastY = yMousePos;
-
-	// Adjust sensitivity (smaller factor equates to smoother motion)
-	float sensitivity = 0.1f;  // tweak as needed?
-	xoffset *= sensitivity;
-	yoffset *= sensitivity;
-
-	// Update the cameras horizontal/vertical look direction
-	camera->ProcessMouseMovement(xoffset, yoffset);
+	INPUT_EVENT event;
+	event.type = INPUT_MOUSE_MOVE;
+	event.key = 0;
+	event.action = 0;
+	event.x = xMousePos;
+	event.y = yMousePos;
+	event.timestamp = glfwGetTime();
+	vm->m_inputEvents.Push(event);
 }
 
 /***********************************************************
@@ -184,128 +196,382 @@ void ViewManager::MouseCallback(GLFWwindow * window, double xMousePos, double yM
  *
  *  This method is automatically called from GLFW whenever
  *  the mouse scroll wheel is used within the active GLFW
- *  display window. It adjusts the camera's movement speed
- *  based on the scroll input.
- * 
- *  Design note:
- *  Uses m_pCamera instead of a global camera pointer.
- *
- *  Function:
- *  - Adjusts camera zoom / movement speed based on scroll input
+ *  display window.  The scroll offsets are queued and later
+ *  adjust the camera zoom / movement speed.
  ***********************************************************/
 void ViewManager::ScrollCallback(GLFWwindow * window, double xOffset, double yOffset)
 {
 	ViewManager* vm = static_cast<ViewManager*>(glfwGetWindowUserPointer(window));
 	if (!vm) return;
 
-	// Adjust camera speed directly in Camera class
-	vm->m_pCamera->ProcessMouseScroll(static_cast<float>(yOffset));
+	INPUT_EVENT event;
+	event.type = INPUT_SCROLL;
+	event.key = 0;
+	event.action = 0;
+	event.x = xOffset;
+	event.y = yOffset;
+	event.timestamp = glfwGetTime();
+	vm->m_inputEvents.Push(event);
 }
 
 /***********************************************************
- *  ProcessKeyboardEvents()
+ *  KeyCallback()
  *
- *  This method is called to process any keyboard events
- *  that may be waiting in the event queue.
- * 
- *  Design note:
- *  Uses m_pCamera (per-instance) instead of a global camera
- *  pointer for cleaner encapsulation.
+ *  This method is automatically called from GLFW whenever a
+ *  key is pressed, repeated or released within the active
+ *  GLFW display window.  It replaces polling glfwGetKey()
+ *  for every key on every frame.
+ ***********************************************************/
+void ViewManager::KeyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/)
+{
+	ViewManager* vm = static_cast<ViewManager*>(glfwGetWindowUserPointer(window));
+	if (!vm) return;
+
+	INPUT_EVENT event;
+	event.type = INPUT_KEY;
+	event.key = key;
+	event.action = action;
+	event.x = 0.0;
+	event.y = 0.0;
+	event.timestamp = glfwGetTime();
+	vm->m_inputEvents.Push(event);
+}
+
+/***********************************************************
+ *  MouseButtonCallback()
+ *
+ *  This method is automatically called from GLFW whenever a
+ *  mouse button is pressed or released within the active
+ *  GLFW display window.
+ ***********************************************************/
+void ViewManager::MouseButtonCallback(GLFWwindow* window, int button, int action, int /*mods*/)
+{
+	ViewManager* vm = static_cast<ViewManager*>(glfwGetWindowUserPointer(window));
+	if (!vm) return;
+
+	INPUT_EVENT event;
+	event.type = INPUT_MOUSE_BUTTON;
+	event.key = button;
+	event.action = action;
+	event.x = 0.0;
+	event.y = 0.0;
+	event.timestamp = glfwGetTime();
+	vm->m_inputEvents.Push(event);
+}
+
+/***********************************************************
+ *  SetCollisionGrid()
+ *
+ *  This method sets the spatial index that the camera
+ *  collides with and that is used for picking.  The camera
+ *  is treated as a sphere of the given radius.
+ ***********************************************************/
+void ViewManager::SetCollisionGrid(const SpatialGrid* pGrid, float cameraRadius)
+{
+	m_pCollisionGrid = pGrid;
+	m_collisionRadius = cameraRadius;
+}
+
+/***********************************************************
+ *  LatchInputEvents()
+ *
+ *  This method drains the input event queue and applies it to
+ *  the camera.  It is called as late as possible, immediately
+ *  before the view matrix for the next frame is built.
+ *
+ *  Movement keys are integrated with sub-frame precision: a
+ *  key only moves the camera for the part of the interval
+ *  since the last latch during which it was actually held,
+ *  using the timestamps of its press and release events.
+ *
+ *  When a collision grid is set, the camera's movement is
+ *  swept through it so the camera cannot pass through the
+ *  hedges, the topiaries or the ground.
  *
  *  Function:
  *  - ESC closes the window
  *  - WASD + QE keys move the camera
+ *  - Left mouse button names the object in the view centre
  *  - O/P switch between Orthographic and Perspective modes
  *  - Numpad + / - adjust mouse sensitivity
  ***********************************************************/
-void ViewManager::ProcessKeyboardEvents(float deltaTime)
+void ViewManager::LatchInputEvents(double latchTime)
 {
-	// Close the window if the escape key has been pressed
-	if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	// time each movement key was held since the previous latch
+	double heldTime[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+	INPUT_EVENT event;
+	while (m_inputEvents.Pop(event))
 	{
-		glfwSetWindowShouldClose(m_pWindow, true);
+		if ((event.type == INPUT_KEY) && (event.action != GLFW_REPEAT))
+		{
+			for (int i = 0; i < 6; i++)
+			{
+				if (event.key != g_MovementKeys[i])
+					continue;
+
+				if ((event.action == GLFW_PRESS) && (!m_bMovementKeyDown[i]))
+				{
+					m_bMovementKeyDown[i] = true;
+					m_movementKeyDownTime[i] = event.timestamp;
+				}
+				else if ((event.action == GLFW_RELEASE) && (m_bMovementKeyDown[i]))
+				{
+					m_bMovementKeyDown[i] = false;
+					heldTime[i] += event.timestamp -
+						std::max(m_movementKeyDownTime[i], m_lastLatchTime);
+				}
+			}
+		}
+
+		ApplyInputEvent(event);
 	}
 
-	// Movement speed is frame-rate independent and adjusted with scroll wheel
-	float speed = deltaTime * movementSpeedFactor;  // movementSpeedFactor is updated via ScrollCallback
-
-	// Camera movement controls
-	if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS)
-		m_pCamera->ProcessKeyboard(FORWARD, speed);
-	if (glfwGetKey(m_pWindow, GLFW_KEY_S) == GLFW_PRESS)
-		m_pCamera->ProcessKeyboard(BACKWARD, speed);
-	if (glfwGetKey(m_pWindow, GLFW_KEY_A) == GLFW_PRESS)
-		m_pCamera->ProcessKeyboard(LEFT, speed);
-	if (glfwGetKey(m_pWindow, GLFW_KEY_D) == GLFW_PRESS)
-		m_pCamera->ProcessKeyboard(RIGHT, speed);
-	if (glfwGetKey(m_pWindow, GLFW_KEY_Q) == GLFW_PRESS)
-		m_pCamera->ProcessKeyboard(DOWN, speed);
-	if (glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS)
-		m_pCamera->ProcessKeyboard(UP, speed);
-
-	// Projection toggle keys: O = Orthographic, P = Perspective
-	if (glfwGetKey(m_pWindow, GLFW_KEY_O) == GLFW_PRESS)
+	glm::vec3 startPosition = m_pCamera->Position;
+
+	// keys still held count up to the latch time
+	for (int i = 0; i < 6; i++)
 	{
-		if (!bOrthographicProjection) {
-			bOrthographicProjection = true;
-			// DEBUG: uncomment line below to see if switching occurs
-			//std::cout << "Switched to Orthographic\n";
+		if (m_bMovementKeyDown[i])
+		{
+			heldTime[i] += latchTime - std::max(m_movementKeyDownTime[i], m_lastLatchTime);
+		}
+
+		// Movement speed is frame-rate independent and adjusted with scroll wheel
+		if (heldTime[i] > 0.0)
+		{
+			float speed = (float)heldTime[i] * movementSpeedFactor;
+			m_pCamera->ProcessKeyboard(g_MovementDirections[i], speed);
+		}
+	}
+
+	if ((NULL != m_pCollisionGrid) && (m_pCamera->Position != startPosition))
+	{
+		m_pCamera->Position = ResolveCameraMove(startPosition, m_pCamera->Position);
+	}
+
+	m_lastLatchTime = latchTime;
+}
+
+/***********************************************************
+ *  ResolveCameraMove()
+ *
+ *  This method sweeps the camera sphere from start to end.
+ *  On contact the camera stops just short of the surface and
+ *  the rest of the move is projected onto the surface, so it
+ *  slides along walls instead of sticking to them.
+ ***********************************************************/
+glm::vec3 ViewManager::ResolveCameraMove(const glm::vec3& start, const glm::vec3& end) const
+{
+	glm::vec3 position = start;
+	glm::vec3 target = end;
+
+	for (int step = 0; step < g_MaxSlideSteps; step++)
+	{
+		SPATIAL_HIT hit;
+		if (!m_pCollisionGrid->SphereSweep(position, target, m_collisionRadius, hit))
+		{
+			return(target);
 		}
+
+		glm::vec3 motion = target - position;
+		float length = glm::length(motion);
+		float t = std::max(0.0f, hit.t - g_CollisionSkin / length);
+		position += motion * t;
+
+		// remove the part of the remaining move into the surface
+		glm::vec3 remaining = target - position;
+		remaining -= hit.normal * std::min(0.0f, glm::dot(remaining, hit.normal));
+		target = position + remaining;
 	}
 
-	if (glfwGetKey(m_pWindow, GLFW_KEY_P) == GLFW_PRESS)
+	return(position);
+}
+
+/***********************************************************
+ *  PickObject()
+ *
+ *  This method casts a ray through the centre of the view
+ *  (where the captured cursor points) and prints the name of
+ *  the first object it hits.
+ ***********************************************************/
+void ViewManager::PickObject()
+{
+	if (NULL == m_pCollisionGrid)
+	{
+		return;
+	}
+
+	// unproject the view centre at the near and far planes
+	SCENE_SNAPSHOT snapshot;
+	UpdateSceneSnapshot(snapshot);
+	glm::mat4 inverse = glm::inverse(snapshot.projection * snapshot.view);
+	glm::vec4 nearPoint = inverse * glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverse * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	glm::vec3 origin = glm::vec3(nearPoint.x, nearPoint.y, nearPoint.z) / nearPoint.w;
+	glm::vec3 target = glm::vec3(farPoint.x, farPoint.y, farPoint.z) / farPoint.w;
+
+	SPATIAL_HIT hit;
+	if (m_pCollisionGrid->RayCast(origin, target - origin, g_PickDistance, hit))
+	{
+		std::cout << "Picked: " << m_pCollisionGrid->GetName(hit.handle)
+			<< " at distance " << hit.t << std::endl;
+	}
+	else
+	{
+		std::cout << "Picked: nothing" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  ApplyInputEvent()
+ *
+ *  This method applies the parts of an input event that act
+ *  at a single instant (look direction, zoom, mode toggles).
+ *  Held movement keys are integrated by LatchInputEvents().
+ ***********************************************************/
+void ViewManager::ApplyInputEvent(const INPUT_EVENT& event)
+{
+	if (event.type == INPUT_MOUSE_MOVE)
+	{
+		// First time the mouse moves: just store its position
+		if (firstMouse)
+		{
+			lastX = event.x;
+			lastY = event.y;
+			firstMouse = false;
+		}
+
+		// Calculate movement relative to last position
+		float xoffset = event.x - lastX;
+		float yoffset = lastY - event.y;  // inverted: screen Y grows downward
+		lastX = event.x;
+		lastY = event.y;
+
+		// Adjust sensitivity (smaller factor equates to smoother motion)
+		float sensitivity = 0.1f;  // tweak as needed?
+		xoffset *= sensitivity;
+		yoffset *= sensitivity;
+
+		// Update the camera's horizontal/vertical look direction
+		m_pCamera->ProcessMouseMovement(xoffset, yoffset);
+	}
+	else if (event.type == INPUT_MOUSE_BUTTON)
+	{
+		if ((event.key == GLFW_MOUSE_BUTTON_LEFT) && (event.action == GLFW_PRESS))
+		{
+			PickObject();
+		}
+	}
+	else if (event.type == INPUT_SCROLL)
+	{
+		// Adjust camera speed directly in Camera class
+		m_pCamera->ProcessMouseScroll(static_cast<float>(event.y));
+	}
+	else if ((event.type == INPUT_KEY) && (event.action != GLFW_RELEASE))
 	{
-		if (bOrthographicProjection) {
+		switch (event.key)
+		{
+		// Close the window if the escape key has been pressed
+		case GLFW_KEY_ESCAPE:
+			glfwSetWindowShouldClose(m_pWindow, true);
+			break;
+
+		// Projection toggle keys: O = Orthographic, P = Perspective
+		case GLFW_KEY_O:
+			bOrthographicProjection = true;
+			break;
+		case GLFW_KEY_P:
 			bOrthographicProjection = false;
-			// DEBUG: uncomment line below to see if switching occurs
-			//std::cout << "Switched to Perspective\n";
+			break;
+
+		// Adjust mouse sensitivity with Numpad + and - keys; holding
+		// the key keeps adjusting it through the key repeat events
+		case GLFW_KEY_KP_ADD:
+			m_pCamera->MouseSensitivity += 0.01f;
+			break;
+		case GLFW_KEY_KP_SUBTRACT:
+			m_pCamera->MouseSensitivity -= 0.01f;
+			break;
+
+		// Save the next frame as a screenshot, once per press
+		case GLFW_KEY_F12:
+			if (event.action == GLFW_PRESS)
+			{
+				m_bScreenshotRequested = true;
+			}
+			break;
 		}
+
+		// Limit sensitivity to avoid going too low or negative
+		if (m_pCamera->MouseSensitivity < 0.01f)
+			m_pCamera->MouseSensitivity = 0.01f;
 	}
+}
 
-	// Adjust mouse sensitivity with Numpad + and - keys (my trackpad might just suck)
-	if (glfwGetKey(m_pWindow, GLFW_KEY_KP_ADD) == GLFW_PRESS)  // Numpad +
-		m_pCamera->MouseSensitivity += 0.01f;
+/***********************************************************
+ *  TakeScreenshotRequest()
+ *
+ *  This method returns true if the screenshot key has been
+ *  pressed since the last call.
+ ***********************************************************/
+bool ViewManager::TakeScreenshotRequest()
+{
+	bool bRequested = m_bScreenshotRequested;
+	m_bScreenshotRequested = false;
 
-	if (glfwGetKey(m_pWindow, GLFW_KEY_KP_SUBTRACT) == GLFW_PRESS)  // Numpad -
-		m_pCamera->MouseSensitivity -= 0.01f;
+	return(bRequested);
+}
 
-	// Limit sensitivity to avoid going too low or negative
-	if (m_pCamera->MouseSensitivity < 0.01f)
-		m_pCamera->MouseSensitivity = 0.01f;
+/***********************************************************
+ *  GetCameraKeyframe()
+ *
+ *  This method returns the camera state that determines the
+ *  rendered view, for recording it to a camera path.
+ ***********************************************************/
+CAMERA_KEYFRAME ViewManager::GetCameraKeyframe(float time) const
+{
+	CAMERA_KEYFRAME keyframe;
+	keyframe.time = time;
+	keyframe.position = m_pCamera->Position;
+	keyframe.front = m_pCamera->Front;
+	keyframe.zoom = m_pCamera->Zoom;
+	keyframe.bOrthographic = bOrthographicProjection;
+	return(keyframe);
 }
 
 /***********************************************************
- *  PrepareSceneView()
+ *  SetCameraKeyframe()
+ *
+ *  This method overrides the camera with a state sampled from
+ *  a camera path during playback.
+ ***********************************************************/
+void ViewManager::SetCameraKeyframe(const CAMERA_KEYFRAME& keyframe)
+{
+	m_pCamera->Position = keyframe.position;
+	m_pCamera->Front = keyframe.front;
+	m_pCamera->Zoom = keyframe.zoom;
+	bOrthographicProjection = keyframe.bOrthographic;
+}
+
+/***********************************************************
+ *  UpdateSceneSnapshot()
  *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene
- *  rendering.
- * 
  *  This method sets up the camera view and projection
  *  matrices that determine how the 3D world is rendered in
- *  each frame. It handles both orthographic and perspective
- *  projections, applies per-frame timing to ensure smooth
- *  camera movement, and sends the final matrices and camera
- *  position to the active shader program so geometry can be
- *  transformed correctly during rendering.
+ *  the next frame. It handles both orthographic and
+ *  perspective projections and stores the final matrices
+ *  and camera position in the snapshot, so the render
+ *  thread never has to touch the live camera.
+ *
+ *  It runs on the simulation thread right after the input
+ *  events for the step have been latched.
  ***********************************************************/
-void ViewManager::PrepareSceneView()
+void ViewManager::UpdateSceneSnapshot(SCENE_SNAPSHOT& snapshot)
 {
 	glm::mat4 view;
 	glm::mat4 projection;
 
-	// Per-frame timing is used to normalize movement across 
-	// machines with different frame rates (ensures time-based, 
-	// not frame-based, updates).
-	float currentFrame = glfwGetTime();
-	gDeltaTime = currentFrame - gLastFrame;
-	gLastFrame = currentFrame;
-
-	// Process any keyboard events that may be waiting in the
-	// event queue, using frame time for smooth movement.
-	// NOTE: WASD/QE camera movement is frame-rate independent.
-	ProcessKeyboardEvents(gDeltaTime);
-
 	// Camera setup: Orthographic vs Perspective projection
 	// determines how 3D coordinates are mapped to the screen.
 	if (bOrthographicProjection)
@@ -354,13 +620,29 @@ void ViewManager::PrepareSceneView()
 		view = m_pCamera->GetViewMatrix();
 	}
 
+	snapshot.view = view;
+	snapshot.projection = projection;
+	snapshot.viewPosition = m_pCamera->Position;
+	snapshot.bOrthographic = bOrthographicProjection;
+}
+
+/***********************************************************
+ *  PrepareSceneView()
+ *
+ *  This method sends the camera matrices and position of a
+ *  published snapshot to the active shader program so the
+ *  geometry can be transformed correctly during rendering.
+ *  It runs on the render thread, which owns the GL context.
+ ***********************************************************/
+void ViewManager::PrepareSceneView(const SCENE_SNAPSHOT& snapshot)
+{
 	// Send matrices and camera position to the shader program.
 	// The shader uses these values to transform 3D coordinates
 	// into screen space and apply lighting based on camera pos.
 	if (m_pShaderManager)
 	{
-		m_pShaderManager->setMat4Value(g_ViewName, view);
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-		m_pShaderManager->setVec3Value("viewPosition", m_pCamera->Position);
+		m_pShaderManager->setMat4Value(g_ViewName, snapshot.view);
+		m_pShaderManager->setMat4Value(g_ProjectionName, snapshot.projection);
+		m_pShaderManager->setVec3Value("viewPosition", snapshot.viewPosition);
 	}
 }
\ No newline at end of file
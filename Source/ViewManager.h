@@ -10,6 +10,10 @@
 #pragma once
 
 #include "ShaderManager.h"
+#include "SceneSnapshot.h"
+#include "InputEventQueue.h"
+#include "CameraPath.h"
+#include "SpatialGrid.h"
 #include "camera.h"
 
 // GLFW library
@@ -37,6 +41,12 @@ public:
 	// Scroll callback for zooming in and out
 	static void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 
+	// Key callback for keyboard interaction with the 3D scene
+	static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+	// Mouse button callback for picking objects in the 3D scene
+	static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+
 private:
 	// For mouse movement
 	float lastX;
@@ -45,6 +55,31 @@ private:
 	float movementSpeedFactor;     // speed factor adjustable with scroll
 	bool bOrthographicProjection;  // true = orthographic, false = perspective
 
+	// Timestamped input events queued by the GLFW callbacks
+	InputEventQueue m_inputEvents;
+	// Held state of the six movement keys (WASD + QE)
+	bool m_bMovementKeyDown[6];
+	// Time at which each held movement key went down
+	double m_movementKeyDownTime[6];
+	// Time at which the input was last latched
+	double m_lastLatchTime;
+	// Set by the screenshot key until the main loop takes it
+	bool m_bScreenshotRequested;
+
+	// Apply one queued input event to the camera and view state
+	void ApplyInputEvent(const INPUT_EVENT& event);
+
+	// Spatial index the camera collides with (not owned)
+	const SpatialGrid* m_pCollisionGrid;
+	// Radius of the sphere around the camera used for collision
+	float m_collisionRadius;
+
+	// Move the camera from start towards end, sliding along
+	// anything in the way
+	glm::vec3 ResolveCameraMove(const glm::vec3& start, const glm::vec3& end) const;
+	// Report the object under the centre of the view
+	void PickObject();
+
 	// Pointer to shader manager object
 	ShaderManager* m_pShaderManager;
 	// Active OpenGL display window
@@ -54,12 +89,26 @@ public:
 	// Create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
 	
+	// Build the camera matrices for the current simulation step
+	void UpdateSceneSnapshot(SCENE_SNAPSHOT& snapshot);
+
 	// Prepare the conversion from 3D object display to 2D scene display
-	void PrepareSceneView();
+	void PrepareSceneView(const SCENE_SNAPSHOT& snapshot);
+
+	// Apply all queued input events up to latchTime to the camera
+	void LatchInputEvents(double latchTime);
 
-	// Process keyboard events for interaction with the 3D scene
-	void ProcessKeyboardEvents(float deltaTime);
+	// Set the spatial index used for camera collision and picking
+	void SetCollisionGrid(const SpatialGrid* pGrid, float cameraRadius);
 
 	// Returns true if orthographic projection is enabled, false if perspective
 	bool IsOrthographicProjection() const { return bOrthographicProjection; }
+
+	// Returns true once for every press of the screenshot key (F12)
+	bool TakeScreenshotRequest();
+
+	// Get the camera state for recording a camera path
+	CAMERA_KEYFRAME GetCameraKeyframe(float time) const;
+	// Drive the camera from a recorded camera path
+	void SetCameraKeyframe(const CAMERA_KEYFRAME& keyframe);
 };
\ No newline at end of file
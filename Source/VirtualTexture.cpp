@@ -0,0 +1,593 @@
+///////////////////////////////////////////////////////////////////////////////
+// virtualtexture.cpp
+// ============
+// sparse virtual texture: feedback-driven page streaming into a fixed
+// size physical page cache on the GPU
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VirtualTexture.h"
+
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// texture units of the virtual texture, after the 16 units
+	// of the scene textures
+	const GLuint g_IndirectionUnit = 16;
+	const GLuint g_PhysicalUnit = 17;
+	// uniform buffer binding point of the layout block
+	const GLuint g_LayoutBinding = 2;
+	// physical slot positions are stored in 8 bits
+	const int g_MaxSlotsPerSide = 256;
+	// clean feedback read-backs after which streaming counts as
+	// finished - the frames just drawn have feedback in flight
+	const int g_QuietFeedbackReads = 3;
+	const double g_Megabyte = 1024.0 * 1024.0;
+}
+
+/***********************************************************
+ *  VirtualTexture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+VirtualTexture::VirtualTexture(const MeshLibrary* pMeshLibrary, const VIRTUAL_TEXTURE_SETTINGS& settings)
+{
+	m_pMeshLibrary = pMeshLibrary;
+	m_settings = settings;
+	m_physicalTexture = 0;
+	m_slotsPerSide = 0;
+	m_indirectionTexture = 0;
+	m_bIndirectionDirty = false;
+	m_layoutBuffer = 0;
+	m_pFeedbackShaders = NULL;
+	m_feedbackProgram = 0;
+	m_feedbackObjectLocation = -1;
+	m_feedbackBiasLocation = -1;
+	m_feedbackBias = 0.0f;
+	m_feedbackFramebuffer = 0;
+	m_feedbackColorBuffer = 0;
+	m_feedbackDepthBuffer = 0;
+	for (int i = 0; i < FEEDBACK_BUFFERS; i++)
+	{
+		m_feedbackBuffers[i] = 0;
+		m_feedbackFences[i] = NULL;
+	}
+	m_feedbackIndex = 0;
+	m_sceneFramebuffer = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		m_sceneViewport[i] = 0;
+	}
+	m_feedbackReads = 0;
+	m_quietReads = 0;
+	m_bStreaming = false;
+}
+
+/***********************************************************
+ *  ~VirtualTexture()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+VirtualTexture::~VirtualTexture()
+{
+	Destroy();
+	m_pMeshLibrary = NULL;
+}
+
+/***********************************************************
+ *  DefaultSettings()
+ *
+ *  This method returns the settings used unless the command
+ *  line changes them.
+ ***********************************************************/
+VIRTUAL_TEXTURE_SETTINGS VirtualTexture::DefaultSettings()
+{
+	VIRTUAL_TEXTURE_SETTINGS settings;
+	settings.gpuBudget = 32 * 1024 * 1024;
+	settings.cpuCacheBytes = 64 * 1024 * 1024;
+	settings.uploadsPerFrame = 16;
+	settings.feedbackWidth = 160;
+	settings.feedbackHeight = 90;
+	return(settings);
+}
+
+/***********************************************************
+ *  Initialize()
+ *
+ *  This method opens the virtual texture and sizes the GL
+ *  objects from the GPU budget: the indirection texture and
+ *  the feedback buffers are fixed by the file and settings,
+ *  and the physical texture gets as many page slots as fit
+ *  in what is left.  The top level is uploaded and pinned.
+ ***********************************************************/
+bool VirtualTexture::Initialize(const char* filename, const char* feedbackVertexShader, const char* feedbackFragmentShader,
+	const char* shaderCacheDirectory)
+{
+	Destroy();
+
+	m_filename = filename;
+	if (!m_streamer.Start(m_filename, m_settings.cpuCacheBytes))
+	{
+		std::cout << "Virtual texture " << m_filename << " could not be opened" << std::endl;
+		return(false);
+	}
+	const VirtualTextureFile& file = m_streamer.GetFile();
+	const VIRTUAL_TEXTURE_INFO& info = file.GetInfo();
+	const uint32_t topLevel = info.levelCount - 1;
+	const uint32_t topPages = info.LevelPagesX(topLevel) * info.LevelPagesY(topLevel);
+
+	// the physical pages get the budget the fixed parts leave
+	size_t fixedBytes = (size_t)file.GetPageCount() * 4 +
+		(size_t)m_settings.feedbackWidth * m_settings.feedbackHeight * 4 * (2 + FEEDBACK_BUFFERS);
+	size_t pageBudget = (m_settings.gpuBudget > fixedBytes) ? (m_settings.gpuBudget - fixedBytes) : 0;
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	m_slotsPerSide = (int)std::sqrt((double)(pageBudget / info.PageBytes()));
+	m_slotsPerSide = std::min(m_slotsPerSide, std::min(g_MaxSlotsPerSide, maxTextureSize / (int)info.StoredPageSize()));
+	if ((uint32_t)(m_slotsPerSide * m_slotsPerSide) <= topPages)
+	{
+		std::cout << "Virtual texture: the " << (m_settings.gpuBudget / g_Megabyte)
+			<< " MB GPU budget has no room for streamed pages" << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	// physical texture - filtered, but without mipmaps: each
+	// page is a single level of the virtual texture
+	int physicalSize = m_slotsPerSide * (int)info.StoredPageSize();
+	glGenTextures(1, &m_physicalTexture);
+	glBindTexture(GL_TEXTURE_2D, m_physicalTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, physicalSize, physicalSize);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// indirection texture - one mip level per virtual level
+	glGenTextures(1, &m_indirectionTexture);
+	glBindTexture(GL_TEXTURE_2D, m_indirectionTexture);
+	glTexStorage2D(GL_TEXTURE_2D, (GLsizei)info.levelCount, GL_RGBA8UI, (GLsizei)info.pagesX, (GLsizei)info.pagesY);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GPU_VIRTUAL_TEXTURE layout;
+	layout.layout = glm::vec4((float)info.pagesX, (float)info.pagesY, (float)info.levelCount, 0.0f);
+	layout.page = glm::vec4((float)info.pageSize, (float)info.border, (float)info.StoredPageSize(), 0.0f);
+	layout.physical = glm::vec4(1.0f / physicalSize, 1.0f / physicalSize, 0.0f, 0.0f);
+	glGenBuffers(1, &m_layoutBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_layoutBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(GPU_VIRTUAL_TEXTURE), &layout, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// feedback program and target
+	m_pFeedbackShaders = new ShaderVariantCache(shaderCacheDirectory);
+	SHADER_VARIANT variant;
+	variant.bTextured = false;
+	variant.bVirtualTextured = false;
+	variant.bLit = false;
+	variant.bLightmapped = false;
+	variant.bAlphaTested = false;
+	variant.lightCount = 0;
+	if (m_pFeedbackShaders->LoadSources(feedbackVertexShader, feedbackFragmentShader))
+	{
+		m_feedbackProgram = m_pFeedbackShaders->GetProgram(variant);
+	}
+	if (m_feedbackProgram == 0)
+	{
+		Destroy();
+		return(false);
+	}
+	m_feedbackObjectLocation = glGetUniformLocation(m_feedbackProgram, "objectIndex");
+	m_feedbackBiasLocation = glGetUniformLocation(m_feedbackProgram, "feedbackBias");
+
+	glGenRenderbuffers(1, &m_feedbackColorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_feedbackColorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_settings.feedbackWidth, m_settings.feedbackHeight);
+	glGenRenderbuffers(1, &m_feedbackDepthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_feedbackDepthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_settings.feedbackWidth, m_settings.feedbackHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_feedbackFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_feedbackColorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_feedbackDepthBuffer);
+	bool bComplete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!bComplete)
+	{
+		std::cout << "Virtual texture: the feedback target is incomplete" << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	glGenBuffers(FEEDBACK_BUFFERS, m_feedbackBuffers);
+	for (int i = 0; i < FEEDBACK_BUFFERS; i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_feedbackBuffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)m_settings.feedbackWidth * m_settings.feedbackHeight * 4,
+			NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// everything the frames use is allocated here
+	m_physicalCache.Reset((uint32_t)(m_slotsPerSide * m_slotsPerSide), file.GetPageCount());
+	m_indirection.assign(file.GetPageCount(), 0);
+	m_pageNeededRead.assign(file.GetPageCount(), 0);
+	m_neededPages.clear();
+	m_neededPages.reserve(file.GetPageCount());
+	m_stagingPage.resize(info.PageBytes());
+
+	// the top level is the fallback of every page
+	for (uint32_t y = 0; y < info.LevelPagesY(topLevel); y++)
+	{
+		for (uint32_t x = 0; x < info.LevelPagesX(topLevel); x++)
+		{
+			uint32_t page = file.PageIndex(topLevel, x, y);
+			uint32_t evictedPage = INVALID_PAGE;
+			int slot = m_physicalCache.Allocate(page, evictedPage);
+			m_physicalCache.Pin(slot);
+			UploadPage(slot, file.GetPagePixels(page));
+		}
+	}
+	UpdateIndirection();
+	// draw until the first feedback has come back
+	m_quietReads = 0;
+	m_bStreaming = true;
+
+	std::cout << "Virtual texture " << m_filename << ": " << (info.pagesX * info.pageSize) << " x "
+		<< (info.pagesY * info.pageSize) << " texels, " << info.levelCount << " levels, "
+		<< file.GetPageCount() << " pages (" << (file.GetPageCount() * info.PageBytes() / g_Megabyte) << " MB); "
+		<< (m_slotsPerSide * m_slotsPerSide) << " GPU page slots, " << (GetGPUMemory() / g_Megabyte) << " of "
+		<< (m_settings.gpuBudget / g_Megabyte) << " MB GPU budget; " << m_streamer.GetCacheSlotCount()
+		<< " CPU page slots" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method stops the page streamer and frees the GL
+ *  objects.
+ ***********************************************************/
+void VirtualTexture::Destroy()
+{
+	m_streamer.Stop();
+
+	if (m_physicalTexture != 0)
+		glDeleteTextures(1, &m_physicalTexture);
+	if (m_indirectionTexture != 0)
+		glDeleteTextures(1, &m_indirectionTexture);
+	if (m_layoutBuffer != 0)
+		glDeleteBuffers(1, &m_layoutBuffer);
+	if (m_feedbackFramebuffer != 0)
+		glDeleteFramebuffers(1, &m_feedbackFramebuffer);
+	if (m_feedbackColorBuffer != 0)
+		glDeleteRenderbuffers(1, &m_feedbackColorBuffer);
+	if (m_feedbackDepthBuffer != 0)
+		glDeleteRenderbuffers(1, &m_feedbackDepthBuffer);
+	for (int i = 0; i < FEEDBACK_BUFFERS; i++)
+	{
+		if (m_feedbackBuffers[i] != 0)
+			glDeleteBuffers(1, &m_feedbackBuffers[i]);
+		if (m_feedbackFences[i] != NULL)
+			glDeleteSync(m_feedbackFences[i]);
+		m_feedbackBuffers[i] = 0;
+		m_feedbackFences[i] = NULL;
+	}
+	m_physicalTexture = 0;
+	m_indirectionTexture = 0;
+	m_layoutBuffer = 0;
+	m_feedbackFramebuffer = 0;
+	m_feedbackColorBuffer = 0;
+	m_feedbackDepthBuffer = 0;
+
+	delete m_pFeedbackShaders;
+	m_pFeedbackShaders = NULL;
+	m_feedbackProgram = 0;
+	m_bStreaming = false;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method runs once per frame before the scene is
+ *  drawn.  When new feedback has come back, the pages it
+ *  asked for are walked coarse levels first: resident pages
+ *  are marked as used, pages waiting in the CPU cache are
+ *  uploaded (a few per frame, into the least recently used
+ *  slots) and the rest are requested from the streamer.  A
+ *  page needed by this feedback is never evicted for
+ *  another; if the cache is full of them the remaining
+ *  pages wait, showing their coarser fallback.
+ ***********************************************************/
+void VirtualTexture::Update()
+{
+	if (m_physicalTexture == 0)
+	{
+		return;
+	}
+
+	if (ReadFeedback())
+	{
+		// coarser levels have the larger page indices
+		std::sort(m_neededPages.begin(), m_neededPages.end(), std::greater<uint32_t>());
+
+		// mark the resident pages first, so every page still
+		// needed is behind the evictable ones in the usage list
+		for (size_t i = 0; i < m_neededPages.size(); i++)
+		{
+			int slot = m_physicalCache.Find(m_neededPages[i]);
+			if (slot >= 0)
+			{
+				m_physicalCache.Touch(slot);
+			}
+		}
+
+		m_streamer.ClearRequests();
+		int uploads = 0;
+		bool bMissing = false;
+		bool bCacheFull = false;
+		for (size_t i = 0; i < m_neededPages.size(); i++)
+		{
+			uint32_t page = m_neededPages[i];
+			if (m_physicalCache.Find(page) >= 0)
+			{
+				continue;
+			}
+
+			bMissing = true;
+			if (bCacheFull)
+			{
+				continue;
+			}
+			if ((uploads >= m_settings.uploadsPerFrame) || !m_streamer.CopyPage(page, m_stagingPage.data()))
+			{
+				m_streamer.Request(page);
+				continue;
+			}
+
+			uint32_t leastRecentPage = m_physicalCache.GetLeastRecentPage();
+			if ((leastRecentPage != INVALID_PAGE) && (m_pageNeededRead[leastRecentPage] == m_feedbackReads))
+			{
+				bCacheFull = true;
+				continue;
+			}
+			uint32_t evictedPage = INVALID_PAGE;
+			int slot = m_physicalCache.Allocate(page, evictedPage);
+			UploadPage(slot, m_stagingPage.data());
+			m_bIndirectionDirty = true;
+			uploads++;
+		}
+
+		m_quietReads = (bMissing && !bCacheFull) ? 0 : m_quietReads + 1;
+		m_bStreaming = (m_quietReads < g_QuietFeedbackReads);
+	}
+
+	if (m_bIndirectionDirty)
+	{
+		UpdateIndirection();
+	}
+
+	glActiveTexture(GL_TEXTURE0 + g_IndirectionUnit);
+	glBindTexture(GL_TEXTURE_2D, m_indirectionTexture);
+	glActiveTexture(GL_TEXTURE0 + g_PhysicalUnit);
+	glBindTexture(GL_TEXTURE_2D, m_physicalTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, g_LayoutBinding, m_layoutBuffer);
+}
+
+/***********************************************************
+ *  BeginFeedback()
+ *
+ *  This method switches to the feedback target.  The level
+ *  bias makes up for the target being smaller than the
+ *  scene's viewport, so the feedback asks for the levels the
+ *  scene samples.
+ ***********************************************************/
+void VirtualTexture::BeginFeedback()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_sceneFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_sceneViewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFramebuffer);
+	glViewport(0, 0, m_settings.feedbackWidth, m_settings.feedbackHeight);
+	const GLfloat noPage[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat farDepth = 1.0f;
+	glClearBufferfv(GL_COLOR, 0, noPage);
+	glClearBufferfv(GL_DEPTH, 0, &farDepth);
+
+	m_feedbackBias = std::log2((float)m_settings.feedbackHeight / (float)std::max(m_sceneViewport[3], 1));
+	glUseProgram(m_feedbackProgram);
+	glUniform1f(m_feedbackBiasLocation, m_feedbackBias);
+}
+
+/***********************************************************
+ *  DrawFeedback()
+ *
+ *  This method draws one virtually textured object into the
+ *  feedback target.
+ ***********************************************************/
+void VirtualTexture::DrawFeedback(SCENE_MESH mesh, uint32_t objectIndex)
+{
+	glUniform1i(m_feedbackObjectLocation, (GLint)objectIndex);
+	m_pMeshLibrary->DrawMesh(mesh);
+}
+
+/***********************************************************
+ *  EndFeedback()
+ *
+ *  This method starts the read-back of the feedback into
+ *  the next pixel buffer of the ring and returns to the
+ *  scene's framebuffer.  If that buffer has not been read
+ *  yet the GPU is far behind, and this frame's feedback is
+ *  skipped.
+ ***********************************************************/
+void VirtualTexture::EndFeedback()
+{
+	if (m_feedbackFences[m_feedbackIndex] == NULL)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_feedbackBuffers[m_feedbackIndex]);
+		glReadPixels(0, 0, m_settings.feedbackWidth, m_settings.feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		m_feedbackFences[m_feedbackIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_feedbackIndex = (m_feedbackIndex + 1) % FEEDBACK_BUFFERS;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)m_sceneFramebuffer);
+	glViewport(m_sceneViewport[0], m_sceneViewport[1], m_sceneViewport[2], m_sceneViewport[3]);
+}
+
+/***********************************************************
+ *  GetGPUMemory()
+ *
+ *  This method returns the bytes of GPU memory the physical
+ *  texture, the indirection texture and the feedback target
+ *  and buffers take.
+ ***********************************************************/
+size_t VirtualTexture::GetGPUMemory() const
+{
+	if (m_physicalTexture == 0)
+	{
+		return(0);
+	}
+	size_t physicalBytes = (size_t)m_slotsPerSide * m_slotsPerSide * m_streamer.GetFile().GetInfo().PageBytes();
+	size_t indirectionBytes = m_indirection.size() * sizeof(uint32_t);
+	size_t feedbackBytes = (size_t)m_settings.feedbackWidth * m_settings.feedbackHeight * 4 * (2 + FEEDBACK_BUFFERS);
+	return(physicalBytes + indirectionBytes + feedbackBytes);
+}
+
+/***********************************************************
+ *  ReadFeedback()
+ *
+ *  This method reads every finished feedback buffer, oldest
+ *  first, without waiting for unfinished ones, and collects
+ *  the pages they name.  Returns true if any was read.
+ ***********************************************************/
+bool VirtualTexture::ReadFeedback()
+{
+	const VirtualTextureFile& file = m_streamer.GetFile();
+	const VIRTUAL_TEXTURE_INFO& info = file.GetInfo();
+	size_t texelCount = (size_t)m_settings.feedbackWidth * m_settings.feedbackHeight;
+	bool bRead = false;
+
+	for (int i = 0; i < FEEDBACK_BUFFERS; i++)
+	{
+		int index = (m_feedbackIndex + i) % FEEDBACK_BUFFERS;
+		if (m_feedbackFences[index] == NULL)
+			continue;
+		GLenum status = glClientWaitSync(m_feedbackFences[index], 0, 0);
+		if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED))
+			break;
+		glDeleteSync(m_feedbackFences[index]);
+		m_feedbackFences[index] = NULL;
+
+		if (!bRead)
+		{
+			m_feedbackReads++;
+			m_neededPages.clear();
+			bRead = true;
+		}
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_feedbackBuffers[index]);
+		const unsigned char* texels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+			(GLsizeiptr)(texelCount * 4), GL_MAP_READ_BIT);
+		if (texels != NULL)
+		{
+			for (size_t t = 0; t < texelCount; t++)
+			{
+				const unsigned char* texel = texels + t * 4;
+				uint32_t level = texel[2];
+				// alpha 0 = no virtually textured object here
+				if ((texel[3] == 0) || (level >= info.levelCount) ||
+					(texel[0] >= info.LevelPagesX(level)) || (texel[1] >= info.LevelPagesY(level)))
+					continue;
+				AddNeededPage(file.PageIndex(level, texel[0], texel[1]));
+			}
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	return(bRead);
+}
+
+/***********************************************************
+ *  AddNeededPage()
+ *
+ *  This method adds a page and the pages covering it on
+ *  the coarser levels, each once per feedback read, so the
+ *  fallbacks of a page in view stay resident too.
+ ***********************************************************/
+void VirtualTexture::AddNeededPage(uint32_t page)
+{
+	const VirtualTextureFile& file = m_streamer.GetFile();
+	while ((page != INVALID_PAGE) && (m_pageNeededRead[page] != m_feedbackReads))
+	{
+		m_pageNeededRead[page] = m_feedbackReads;
+		m_neededPages.push_back(page);
+		page = file.ParentPage(page);
+	}
+}
+
+/***********************************************************
+ *  UploadPage()
+ *
+ *  This method copies a stored page into a physical slot.
+ ***********************************************************/
+void VirtualTexture::UploadPage(int slot, const unsigned char* pixels)
+{
+	GLint storedSize = (GLint)m_streamer.GetFile().GetInfo().StoredPageSize();
+	glBindTexture(GL_TEXTURE_2D, m_physicalTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % m_slotsPerSide) * storedSize, (slot / m_slotsPerSide) * storedSize,
+		storedSize, storedSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/***********************************************************
+ *  UpdateIndirection()
+ *
+ *  This method rebuilds the indirection texels from the top
+ *  level down: a resident page points at its own slot, any
+ *  other page at what its parent points at.  The texture is
+ *  a few thousand texels, so it is rewritten whole.
+ ***********************************************************/
+void VirtualTexture::UpdateIndirection()
+{
+	const VirtualTextureFile& file = m_streamer.GetFile();
+	const VIRTUAL_TEXTURE_INFO& info = file.GetInfo();
+
+	glBindTexture(GL_TEXTURE_2D, m_indirectionTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for (int level = (int)info.levelCount - 1; level >= 0; level--)
+	{
+		uint32_t pagesX = info.LevelPagesX(level);
+		uint32_t pagesY = info.LevelPagesY(level);
+		for (uint32_t y = 0; y < pagesY; y++)
+		{
+			for (uint32_t x = 0; x < pagesX; x++)
+			{
+				uint32_t page = file.PageIndex(level, x, y);
+				int slot = m_physicalCache.Find(page);
+				if (slot >= 0)
+				{
+					m_indirection[page] = (uint32_t)(slot % m_slotsPerSide) | ((uint32_t)(slot / m_slotsPerSide) << 8) |
+						((uint32_t)level << 16) | 0xFF000000u;
+				}
+				else
+				{
+					m_indirection[page] = m_indirection[file.PageIndex(level + 1, x / 2, y / 2)];
+				}
+			}
+		}
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, (GLsizei)pagesX, (GLsizei)pagesY, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+			&m_indirection[file.PageIndex(level, 0, 0)]);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	m_bIndirectionDirty = false;
+}
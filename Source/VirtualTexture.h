@@ -0,0 +1,190 @@
+///////////////////////////////////////////////////////////////////////////////
+// virtualtexture.h
+// ============
+// sparse virtual texture: feedback-driven page streaming into a fixed
+// size physical page cache on the GPU
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "PageStreamer.h"
+#include "PageCache.h"
+#include "MeshLibrary.h"
+#include "ShaderVariantCache.h"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  VIRTUAL_TEXTURE_SETTINGS
+ *
+ *  Memory budgets and streaming rates of the virtual
+ *  texture, filled from the command line in main().
+ ***********************************************************/
+struct VIRTUAL_TEXTURE_SETTINGS
+{
+	// GPU memory of the physical pages, the indirection texture
+	// and the feedback buffers together
+	size_t gpuBudget;
+	// CPU memory of the page cache
+	size_t cpuCacheBytes;
+	// pages uploaded to the GPU per frame at most
+	int uploadsPerFrame;
+	// size of the feedback target
+	int feedbackWidth;
+	int feedbackHeight;
+};
+
+/***********************************************************
+ *  GPU_VIRTUAL_TEXTURE
+ *
+ *  Layout of the virtual texture for the shaders; matches
+ *  the std140 VirtualTextureBlock of the indirect fragment
+ *  shader and the feedback shader.
+ ***********************************************************/
+struct GPU_VIRTUAL_TEXTURE
+{
+	// xy = level 0 page counts, z = level count
+	glm::vec4 layout;
+	// x = page size, y = border, z = stored page size
+	glm::vec4 page;
+	// xy = 1 / size of the physical texture in texels
+	glm::vec4 physical;
+};
+
+/***********************************************************
+ *  VirtualTexture
+ *
+ *  Textures objects with a virtual texture far larger than
+ *  GPU memory, of which only the pages in view are resident:
+ *
+ *  - a feedback pass draws the virtually textured objects
+ *    into a small target, writing the page and level each
+ *    pixel needs; it is read back through a ring of pixel
+ *    buffers a few frames later, so the CPU never waits
+ *  - the pages asked for are uploaded from the CPU cache of
+ *    the PageStreamer into free or least recently used slots
+ *    of the physical texture, coarse levels first; pages not
+ *    in the CPU cache are requested from its loader thread
+ *  - the indirection texture has one texel per page on each
+ *    level, giving the slot of the page or - until it is
+ *    resident - of the closest resident coarser page, so the
+ *    shader always finds something to sample
+ *
+ *  The top level is loaded at start and never evicted.  The
+ *  physical texture, indirection texture and feedback buffers
+ *  are sized once from the GPU budget, so GPU memory never
+ *  grows however large the virtual texture is.
+ *
+ *  The feedback pass draws only the virtually textured
+ *  objects, so pages hidden behind other objects are loaded
+ *  too; for a ground plane that costs little.
+ *
+ *  All methods must be called on the thread that owns the GL
+ *  context (the render thread), after the indirect renderer
+ *  has bound its camera and object data buffers.
+ ***********************************************************/
+class VirtualTexture
+{
+public:
+	// constructor
+	VirtualTexture(const MeshLibrary* pMeshLibrary, const VIRTUAL_TEXTURE_SETTINGS& settings);
+	// destructor
+	~VirtualTexture();
+
+	// default settings: 32 MB GPU budget, 64 MB CPU cache
+	static VIRTUAL_TEXTURE_SETTINGS DefaultSettings();
+
+	// open the virtual texture file, create the GL objects and
+	// load the top level
+	bool Initialize(const char* filename, const char* feedbackVertexShader, const char* feedbackFragmentShader,
+		const char* shaderCacheDirectory);
+	// stop streaming and free the GL objects
+	void Destroy();
+
+	// file the texture was opened from
+	const std::string& GetFilename() const { return m_filename; }
+
+	// read finished feedback, upload the pages that arrived,
+	// update the indirection and bind everything for the frame
+	void Update();
+
+	// draw the virtually textured objects into the feedback target
+	void BeginFeedback();
+	void DrawFeedback(SCENE_MESH mesh, uint32_t objectIndex);
+	void EndFeedback();
+	// level bias of the current feedback pass, for geometry
+	// drawn into it with its own program
+	float GetFeedbackBias() const { return m_feedbackBias; }
+
+	// true while pages in view are still being loaded, so more
+	// frames should be drawn to show them
+	bool IsStreaming() const { return m_bStreaming.load(); }
+	// GPU memory of all the virtual texture's GL objects
+	size_t GetGPUMemory() const;
+
+private:
+	// feedback read-back buffers in flight
+	static const int FEEDBACK_BUFFERS = 3;
+
+	// collect the pages asked for by finished feedback; false if
+	// none has finished
+	bool ReadFeedback();
+	// add a page and the coarser pages covering it to the
+	// pages needed this frame
+	void AddNeededPage(uint32_t page);
+	// upload a page into a physical slot
+	void UploadPage(int slot, const unsigned char* pixels);
+	// rebuild and upload the indirection texture
+	void UpdateIndirection();
+
+	const MeshLibrary* m_pMeshLibrary;
+	VIRTUAL_TEXTURE_SETTINGS m_settings;
+	std::string m_filename;
+	PageStreamer m_streamer;
+
+	// physical texture: slotsPerSide x slotsPerSide stored pages
+	GLuint m_physicalTexture;
+	int m_slotsPerSide;
+	PageCache m_physicalCache;
+	// indirection texture, one RGBA8UI texel per page:
+	// r, g = slot position, b = level of the page in the slot
+	GLuint m_indirectionTexture;
+	std::vector<uint32_t> m_indirection;
+	bool m_bIndirectionDirty;
+	// layout uniform buffer
+	GLuint m_layoutBuffer;
+
+	// feedback target, its program and read-back ring
+	ShaderVariantCache* m_pFeedbackShaders;
+	GLuint m_feedbackProgram;
+	GLint m_feedbackObjectLocation;
+	GLint m_feedbackBiasLocation;
+	float m_feedbackBias;
+	GLuint m_feedbackFramebuffer;
+	GLuint m_feedbackColorBuffer;
+	GLuint m_feedbackDepthBuffer;
+	GLuint m_feedbackBuffers[FEEDBACK_BUFFERS];
+	GLsync m_feedbackFences[FEEDBACK_BUFFERS];
+	int m_feedbackIndex;
+	// framebuffer and viewport of the scene, restored after the
+	// feedback pass
+	GLint m_sceneFramebuffer;
+	GLint m_sceneViewport[4];
+
+	// pages asked for by the latest feedback, and the feedback
+	// read each page was last asked for
+	std::vector<uint32_t> m_neededPages;
+	std::vector<uint32_t> m_pageNeededRead;
+	uint32_t m_feedbackReads;
+	// feedback reads in a row that asked for nothing loadable
+	int m_quietReads;
+	// a page for uploading
+	std::vector<unsigned char> m_stagingPage;
+	std::atomic<bool> m_bStreaming;
+};
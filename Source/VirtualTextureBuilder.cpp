@@ -0,0 +1,339 @@
+///////////////////////////////////////////////////////////////////////////////
+// virtualtexturebuilder.cpp
+// ============
+// write the virtual texture file of the ground plane
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VirtualTextureBuilder.h"
+#include "VirtualTextureFile.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "stb_image.h"
+
+// declaration of global variables
+namespace
+{
+	const char* g_GroundTextureFile = "Textures/ground.vtex";
+	const char* g_GravelImageFile = "Textures/gravel1.jpg";
+
+	// 64 x 32 pages of 120 texels: 7680 x 3840 texels over the
+	// 120 x 60 ground, 64 texels per unit
+	const uint32_t g_GroundPagesX = 64;
+	const uint32_t g_GroundPagesY = 32;
+	const uint32_t g_GroundPageSize = 120;
+	const uint32_t g_GroundPageBorder = 4;
+	const uint32_t g_GroundLevels = 6;
+
+	// half size of the ground plane in the scene file, and how
+	// often the gravel image repeats across it (uv=20,20)
+	const float g_GroundHalfWidth = 60.0f;
+	const float g_GroundHalfDepth = 30.0f;
+	const float g_GravelRepeat = 20.0f;
+
+	// sandy paths: a ring around the centre topiary, one path
+	// from it to the outer hedge, one to the front walk, and
+	// the walk across the front of the garden
+	const glm::vec2 g_PathRingCenter(0.0f, 3.0f);
+	const float g_PathRingRadius = 7.5f;
+	const glm::vec2 g_PathSegments[][2] =
+	{
+		{ glm::vec2(0.0f, 10.5f), glm::vec2(0.0f, 13.0f) },
+		{ glm::vec2(0.0f, -4.5f), glm::vec2(0.0f, -9.0f) },
+		{ glm::vec2(-60.0f, -9.0f), glm::vec2(60.0f, -9.0f) }
+	};
+	const float g_PathHalfWidth = 1.0f;
+	const float g_PathEdgeWidth = 0.35f;
+	const glm::vec3 g_SandColor(0.78f, 0.70f, 0.55f);
+
+	// a loaded RGB image
+	struct IMAGE_RGB
+	{
+		int width;
+		int height;
+		const unsigned char* pixels;
+	};
+
+	/***********************************************************
+	 *  SampleWrapped()
+	 *
+	 *  Bilinear sample of an RGB image with repeating texture
+	 *  coordinates, as GL_REPEAT samples the gravel texture.
+	 ***********************************************************/
+	glm::vec3 SampleWrapped(const IMAGE_RGB& image, float u, float v)
+	{
+		float x = (u - std::floor(u)) * image.width - 0.5f;
+		float y = (v - std::floor(v)) * image.height - 0.5f;
+		int x0 = (int)std::floor(x);
+		int y0 = (int)std::floor(y);
+		float fx = x - x0;
+		float fy = y - y0;
+
+		glm::vec3 texels[4];
+		for (int i = 0; i < 4; i++)
+		{
+			int tx = (x0 + (i & 1) + image.width) % image.width;
+			int ty = (y0 + (i >> 1) + image.height) % image.height;
+			const unsigned char* texel = image.pixels + ((size_t)ty * image.width + tx) * 3;
+			texels[i] = glm::vec3(texel[0], texel[1], texel[2]) / 255.0f;
+		}
+		return(glm::mix(glm::mix(texels[0], texels[1], fx), glm::mix(texels[2], texels[3], fx), fy));
+	}
+
+	/***********************************************************
+	 *  ValueNoise() / Fbm()
+	 *
+	 *  Smooth value noise in [0, 1] and a few octaves of it.
+	 ***********************************************************/
+	float LatticeValue(int x, int y)
+	{
+		uint32_t hash = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u;
+		hash = (hash ^ (hash >> 13)) * 1274126177u;
+		hash ^= hash >> 16;
+		return((hash & 0xFFFF) / 65535.0f);
+	}
+
+	float ValueNoise(float x, float y)
+	{
+		int x0 = (int)std::floor(x);
+		int y0 = (int)std::floor(y);
+		float fx = x - x0;
+		float fy = y - y0;
+		fx = fx * fx * (3.0f - 2.0f * fx);
+		fy = fy * fy * (3.0f - 2.0f * fy);
+		float bottom = LatticeValue(x0, y0) + (LatticeValue(x0 + 1, y0) - LatticeValue(x0, y0)) * fx;
+		float top = LatticeValue(x0, y0 + 1) + (LatticeValue(x0 + 1, y0 + 1) - LatticeValue(x0, y0 + 1)) * fx;
+		return(bottom + (top - bottom) * fy);
+	}
+
+	float Fbm(float x, float y)
+	{
+		float sum = 0.0f;
+		float amplitude = 0.5f;
+		for (int octave = 0; octave < 4; octave++)
+		{
+			sum += amplitude * ValueNoise(x, y);
+			x *= 2.0f;
+			y *= 2.0f;
+			amplitude *= 0.5f;
+		}
+		return(sum / 0.9375f);
+	}
+
+	/***********************************************************
+	 *  PathCoverage()
+	 *
+	 *  How much of a ground point is path, from 0 (gravel) to
+	 *  1 (sand), with ragged edges.
+	 ***********************************************************/
+	float PathCoverage(const glm::vec2& position)
+	{
+		float distance = std::fabs(glm::length(position - g_PathRingCenter) - g_PathRingRadius);
+		for (size_t i = 0; i < sizeof(g_PathSegments) / sizeof(g_PathSegments[0]); i++)
+		{
+			glm::vec2 a = g_PathSegments[i][0];
+			glm::vec2 ab = g_PathSegments[i][1] - a;
+			float t = glm::clamp(glm::dot(position - a, ab) / glm::dot(ab, ab), 0.0f, 1.0f);
+			distance = std::min(distance, glm::length(position - (a + ab * t)));
+		}
+
+		float edge = g_PathHalfWidth + (Fbm(position.x * 1.5f, position.y * 1.5f) - 0.5f) * 0.6f;
+		return(1.0f - glm::smoothstep(edge - g_PathEdgeWidth, edge + g_PathEdgeWidth, distance));
+	}
+
+	/***********************************************************
+	 *  Paint()
+	 *
+	 *  Color of the ground at a texture coordinate of the plane
+	 *  mesh (u = (x + 1) / 2, v = (1 - z) / 2).
+	 ***********************************************************/
+	void Paint(const IMAGE_RGB& gravel, float u, float v, unsigned char* rgba)
+	{
+		glm::vec2 position((2.0f * u - 1.0f) * g_GroundHalfWidth, (1.0f - 2.0f * v) * g_GroundHalfDepth);
+
+		// the tiled gravel, darker and lighter in large patches
+		glm::vec3 color = SampleWrapped(gravel, u * g_GravelRepeat, v * g_GravelRepeat);
+		float wear = Fbm(position.x * 0.15f, position.y * 0.15f);
+		color *= 0.8f + 0.35f * wear;
+
+		// sand with some gravel showing through
+		float coverage = PathCoverage(position);
+		if (coverage > 0.0f)
+		{
+			float grain = ValueNoise(position.x * 40.0f, position.y * 40.0f);
+			glm::vec3 sand = g_SandColor * (0.9f + 0.15f * grain);
+			color = glm::mix(color, glm::mix(sand, color, 0.2f), coverage);
+		}
+
+		color = glm::clamp(color, 0.0f, 1.0f);
+		rgba[0] = (unsigned char)(color.r * 255.0f + 0.5f);
+		rgba[1] = (unsigned char)(color.g * 255.0f + 0.5f);
+		rgba[2] = (unsigned char)(color.b * 255.0f + 0.5f);
+		rgba[3] = 255;
+	}
+
+	/***********************************************************
+	 *  CopyPage()
+	 *
+	 *  Copies a stored page, borders included, out of an RGBA
+	 *  image whose first column and row are at (left, bottom)
+	 *  in level texels; texels off the image repeat its edge.
+	 ***********************************************************/
+	void CopyPage(const std::vector<unsigned char>& image, int width, int height, int left, int bottom,
+		int storedSize, unsigned char* page)
+	{
+		for (int y = 0; y < storedSize; y++)
+		{
+			int imageY = std::min(std::max(bottom + y, 0), height - 1);
+			for (int x = 0; x < storedSize; x++)
+			{
+				int imageX = std::min(std::max(left + x, 0), width - 1);
+				memcpy(page + ((size_t)y * storedSize + x) * 4, &image[((size_t)imageY * width + imageX) * 4], 4);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  Downsample()
+	 *
+	 *  Averages 2 x 2 texels of the given rows of an RGBA image
+	 *  into the rows of the next level starting at targetRow.
+	 ***********************************************************/
+	void Downsample(const std::vector<unsigned char>& source, int width, int firstRow, int rowCount,
+		std::vector<unsigned char>& target, int targetRow)
+	{
+		int targetWidth = width / 2;
+		for (int y = 0; y < rowCount / 2; y++)
+		{
+			const unsigned char* row0 = &source[(size_t)(firstRow + 2 * y) * width * 4];
+			const unsigned char* row1 = row0 + (size_t)width * 4;
+			unsigned char* out = &target[(size_t)(targetRow + y) * targetWidth * 4];
+			for (int x = 0; x < targetWidth * 4; x++)
+			{
+				int channel = x & 3;
+				int column = (x >> 2) * 8 + channel;
+				out[x] = (unsigned char)((row0[column] + row0[column + 4] + row1[column] + row1[column + 4] + 2) / 4);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildGround()
+ *
+ *  This method writes the ground's virtual texture.  Level 0
+ *  is painted a row of pages at a time (with the border rows
+ *  above and below) and written out, and each row is also
+ *  averaged into level 1, which is small enough to keep.
+ *  The coarser levels are written from level 1 down.  The
+ *  pages come out in page index order, so the file is
+ *  written front to back.
+ ***********************************************************/
+bool VirtualTextureBuilder::BuildGround()
+{
+	VIRTUAL_TEXTURE_INFO info;
+	info.pagesX = g_GroundPagesX;
+	info.pagesY = g_GroundPagesY;
+	info.pageSize = g_GroundPageSize;
+	info.border = g_GroundPageBorder;
+	info.levelCount = g_GroundLevels;
+	VirtualTextureFile file;
+	if (!file.SetLayout(info))
+	{
+		return(false);
+	}
+
+	// loaded bottom row first, like the scene textures
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	stbi_set_flip_vertically_on_load(true);
+	unsigned char* gravelPixels = stbi_load(g_GravelImageFile, &width, &height, &channels, 3);
+	if (NULL == gravelPixels)
+	{
+		std::cout << "Could not load image:" << g_GravelImageFile << std::endl;
+		return(false);
+	}
+	IMAGE_RGB gravel;
+	gravel.width = width;
+	gravel.height = height;
+	gravel.pixels = gravelPixels;
+
+	std::ofstream output(g_GroundTextureFile, std::ios::binary | std::ios::trunc);
+	if (!output.is_open() || !file.WriteHeader(output))
+	{
+		std::cout << "Could not write " << g_GroundTextureFile << std::endl;
+		stbi_image_free(gravelPixels);
+		return(false);
+	}
+
+	const int pageSize = (int)info.pageSize;
+	const int border = (int)info.border;
+	const int storedSize = (int)info.StoredPageSize();
+	const int levelWidth = (int)(info.pagesX * info.pageSize);
+	const int levelHeight = (int)(info.pagesY * info.pageSize);
+	std::vector<unsigned char> page(info.PageBytes());
+
+	// level 0: one band of stored page rows at a time
+	std::vector<unsigned char> band((size_t)levelWidth * storedSize * 4);
+	std::vector<unsigned char> level((size_t)(levelWidth / 2) * (levelHeight / 2) * 4);
+	std::cout << "Painting " << levelWidth << " x " << levelHeight << " ground texels..." << std::endl;
+	for (int pageY = 0; pageY < (int)info.pagesY; pageY++)
+	{
+		int bandBottom = pageY * pageSize - border;
+		for (int y = 0; y < storedSize; y++)
+		{
+			int texelY = std::min(std::max(bandBottom + y, 0), levelHeight - 1);
+			float v = (texelY + 0.5f) / levelHeight;
+			for (int x = 0; x < levelWidth; x++)
+			{
+				Paint(gravel, (x + 0.5f) / levelWidth, v, &band[((size_t)y * levelWidth + x) * 4]);
+			}
+		}
+
+		for (int pageX = 0; pageX < (int)info.pagesX; pageX++)
+		{
+			CopyPage(band, levelWidth, storedSize, pageX * pageSize - border, 0, storedSize, page.data());
+			output.write((const char*)page.data(), page.size());
+		}
+		Downsample(band, levelWidth, border, pageSize, level, pageY * pageSize / 2);
+	}
+	stbi_image_free(gravelPixels);
+
+	// the coarser levels from the one kept in memory
+	for (uint32_t levelIndex = 1; levelIndex < info.levelCount; levelIndex++)
+	{
+		int currentWidth = levelWidth >> levelIndex;
+		int currentHeight = levelHeight >> levelIndex;
+		for (uint32_t pageY = 0; pageY < info.LevelPagesY(levelIndex); pageY++)
+		{
+			for (uint32_t pageX = 0; pageX < info.LevelPagesX(levelIndex); pageX++)
+			{
+				CopyPage(level, currentWidth, currentHeight, (int)pageX * pageSize - border, (int)pageY * pageSize - border,
+					storedSize, page.data());
+				output.write((const char*)page.data(), page.size());
+			}
+		}
+
+		std::vector<unsigned char> nextLevel((size_t)(currentWidth / 2) * (currentHeight / 2) * 4);
+		Downsample(level, currentWidth, 0, currentHeight, nextLevel, 0);
+		level.swap(nextLevel);
+	}
+
+	output.close();
+	if (output.fail())
+	{
+		std::cout << "Could not write " << g_GroundTextureFile << std::endl;
+		return(false);
+	}
+	std::cout << "Wrote " << g_GroundTextureFile << ": " << info.levelCount << " levels, " << file.GetPageCount()
+		<< " pages (" << ((double)file.PageOffset(file.GetPageCount()) / (1024.0 * 1024.0)) << " MB)" << std::endl;
+	return(true);
+}
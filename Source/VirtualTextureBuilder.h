@@ -0,0 +1,25 @@
+///////////////////////////////////////////////////////////////////////////////
+// virtualtexturebuilder.h
+// ============
+// write the virtual texture file of the ground plane
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+/***********************************************************
+ *  VirtualTextureBuilder
+ *
+ *  Paints the ground of the garden as one large texture -
+ *  the gravel image tiled as before, with wear and sandy
+ *  paths laid out around the hedges - and writes it as a
+ *  paged virtual texture file with all its levels.  The
+ *  texture is painted and written a row of pages at a time,
+ *  so the tool never holds the finest level in memory.
+ *  Needs no window or GL context.
+ ***********************************************************/
+class VirtualTextureBuilder
+{
+public:
+	// write Textures/ground.vtex from Textures/gravel1.jpg
+	static bool BuildGround();
+};
@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+// virtualtexturefile.cpp
+// ============
+// tiled on-disk format of a virtual texture, memory-mapped for reading
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VirtualTextureFile.h"
+
+#include <iostream>
+#include <ostream>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	const char g_VirtualTextureMagic[4] = { 'T', 'G', 'V', 'T' };
+	const uint32_t g_VirtualTextureVersion = 1;
+	// largest page count per axis - the indirection texture and the
+	// feedback buffer store page positions in 8 bits
+	const uint32_t g_MaxPagesPerAxis = 256;
+}
+
+/***********************************************************
+ *  VirtualTextureFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+VirtualTextureFile::VirtualTextureFile()
+{
+	memset(&m_info, 0, sizeof(m_info));
+	m_pageCount = 0;
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method maps a virtual texture file and takes its
+ *  layout from the header.  The file must hold every page
+ *  the header describes.
+ ***********************************************************/
+bool VirtualTextureFile::Open(const std::string& filename)
+{
+	Close();
+	if (!m_file.Open(filename))
+	{
+		return(false);
+	}
+
+	VIRTUAL_TEXTURE_HEADER header;
+	if (m_file.GetSize() < sizeof(header))
+	{
+		std::cout << "Virtual texture " << filename << " is truncated" << std::endl;
+		Close();
+		return(false);
+	}
+	memcpy(&header, m_file.GetData(), sizeof(header));
+	if ((memcmp(header.magic, g_VirtualTextureMagic, sizeof(header.magic)) != 0) ||
+		(header.version != g_VirtualTextureVersion))
+	{
+		std::cout << "Virtual texture " << filename << " has an unknown format" << std::endl;
+		Close();
+		return(false);
+	}
+
+	VIRTUAL_TEXTURE_INFO info;
+	info.pagesX = header.pagesX;
+	info.pagesY = header.pagesY;
+	info.pageSize = header.pageSize;
+	info.border = header.border;
+	info.levelCount = header.levelCount;
+	if (!SetLayout(info) || (m_file.GetSize() < PageOffset(m_pageCount)))
+	{
+		std::cout << "Virtual texture " << filename << " has a bad layout or is truncated" << std::endl;
+		Close();
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method unmaps the file.
+ ***********************************************************/
+void VirtualTextureFile::Close()
+{
+	m_file.Close();
+	memset(&m_info, 0, sizeof(m_info));
+	m_levelFirstPage.clear();
+	m_pageCount = 0;
+}
+
+/***********************************************************
+ *  SetLayout()
+ *
+ *  This method checks a page layout and numbers its pages.
+ *  Both page counts must be powers of two that stay at
+ *  least one page on every level.
+ ***********************************************************/
+bool VirtualTextureFile::SetLayout(const VIRTUAL_TEXTURE_INFO& info)
+{
+	bool bPowersOfTwo = (info.pagesX > 0) && (info.pagesY > 0) &&
+		((info.pagesX & (info.pagesX - 1)) == 0) && ((info.pagesY & (info.pagesY - 1)) == 0);
+	if (!bPowersOfTwo || (info.pagesX > g_MaxPagesPerAxis) || (info.pagesY > g_MaxPagesPerAxis) ||
+		(info.pageSize == 0) || (info.levelCount == 0) ||
+		((info.pagesX >> (info.levelCount - 1)) == 0) || ((info.pagesY >> (info.levelCount - 1)) == 0))
+	{
+		return(false);
+	}
+
+	m_info = info;
+	m_levelFirstPage.resize(info.levelCount);
+	m_pageCount = 0;
+	for (uint32_t level = 0; level < info.levelCount; level++)
+	{
+		m_levelFirstPage[level] = m_pageCount;
+		m_pageCount += info.LevelPagesX(level) * info.LevelPagesY(level);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  PageIndex()
+ *
+ *  This method returns the index of a page of a level.
+ ***********************************************************/
+uint32_t VirtualTextureFile::PageIndex(uint32_t level, uint32_t x, uint32_t y) const
+{
+	return(m_levelFirstPage[level] + y * m_info.LevelPagesX(level) + x);
+}
+
+/***********************************************************
+ *  PageLocation()
+ *
+ *  This method returns the level and position of a page.
+ ***********************************************************/
+void VirtualTextureFile::PageLocation(uint32_t page, uint32_t& level, uint32_t& x, uint32_t& y) const
+{
+	level = m_info.levelCount - 1;
+	while ((level > 0) && (page < m_levelFirstPage[level]))
+	{
+		level--;
+	}
+	uint32_t offset = page - m_levelFirstPage[level];
+	x = offset % m_info.LevelPagesX(level);
+	y = offset / m_info.LevelPagesX(level);
+}
+
+/***********************************************************
+ *  ParentPage()
+ *
+ *  This method returns the page of the next coarser level
+ *  that covers a page.
+ ***********************************************************/
+uint32_t VirtualTextureFile::ParentPage(uint32_t page) const
+{
+	uint32_t level = 0;
+	uint32_t x = 0;
+	uint32_t y = 0;
+	PageLocation(page, level, x, y);
+	if (level + 1 >= m_info.levelCount)
+	{
+		return(INVALID_PAGE);
+	}
+	return(PageIndex(level + 1, x / 2, y / 2));
+}
+
+/***********************************************************
+ *  PageOffset()
+ *
+ *  This method returns where a page starts in the file.
+ *  The page count itself gives the size of the whole file.
+ ***********************************************************/
+uint64_t VirtualTextureFile::PageOffset(uint32_t page) const
+{
+	return((uint64_t)sizeof(VIRTUAL_TEXTURE_HEADER) + (uint64_t)page * m_info.PageBytes());
+}
+
+/***********************************************************
+ *  GetPagePixels()
+ *
+ *  This method returns the pixels of a page in the mapped
+ *  file, or NULL if no file is open.
+ ***********************************************************/
+const unsigned char* VirtualTextureFile::GetPagePixels(uint32_t page) const
+{
+	if ((NULL == m_file.GetData()) || (page >= m_pageCount))
+	{
+		return(NULL);
+	}
+	return(m_file.GetData() + PageOffset(page));
+}
+
+/***********************************************************
+ *  WriteHeader()
+ *
+ *  This method writes the file header for the current
+ *  layout; the pages follow it in page index order.
+ ***********************************************************/
+bool VirtualTextureFile::WriteHeader(std::ostream& output) const
+{
+	VIRTUAL_TEXTURE_HEADER header;
+	memcpy(header.magic, g_VirtualTextureMagic, sizeof(header.magic));
+	header.version = g_VirtualTextureVersion;
+	header.pagesX = m_info.pagesX;
+	header.pagesY = m_info.pagesY;
+	header.pageSize = m_info.pageSize;
+	header.border = m_info.border;
+	header.levelCount = m_info.levelCount;
+	header.reserved = 0;
+	output.write((const char*)&header, sizeof(header));
+	return(output.good());
+}
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// virtualtexturefile.h
+// ============
+// tiled on-disk format of a virtual texture, memory-mapped for reading
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MeshCache.h"
+#include "PageCache.h"
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstddef>
+#include <cstdint>
+
+/***********************************************************
+ *  VIRTUAL_TEXTURE_INFO
+ *
+ *  Page layout of a virtual texture.  Level 0 is pagesX x
+ *  pagesY pages (powers of two) of pageSize x pageSize
+ *  texels; each level above halves both page counts.  Every
+ *  stored page repeats `border` texels of its neighbours on
+ *  each side, so bilinear filtering inside a page never
+ *  reads from the page next to it in the physical cache.
+ ***********************************************************/
+struct VIRTUAL_TEXTURE_INFO
+{
+	uint32_t pagesX;
+	uint32_t pagesY;
+	uint32_t pageSize;
+	uint32_t border;
+	uint32_t levelCount;
+
+	// side length of a stored page, borders included
+	uint32_t StoredPageSize() const { return pageSize + 2 * border; }
+	// bytes of a stored RGBA8 page
+	size_t PageBytes() const { return (size_t)StoredPageSize() * StoredPageSize() * 4; }
+	// page counts of a level
+	uint32_t LevelPagesX(uint32_t level) const { return pagesX >> level; }
+	uint32_t LevelPagesY(uint32_t level) const { return pagesY >> level; }
+};
+
+/***********************************************************
+ *  VirtualTextureFile
+ *
+ *  A virtual texture stored page by page, so any page can be
+ *  read on its own without decoding the rest:
+ *
+ *    VIRTUAL_TEXTURE_HEADER
+ *    page 0, page 1, ...   RGBA8, bottom row first
+ *
+ *  Pages are numbered level by level, finest level first and
+ *  row by row within a level, so a larger page index is
+ *  never a finer level.  The file is mapped, and the OS
+ *  reads a page from disk when it is first copied.
+ ***********************************************************/
+class VirtualTextureFile
+{
+public:
+	// constructor
+	VirtualTextureFile();
+
+	// map a virtual texture file and check its header
+	bool Open(const std::string& filename);
+	void Close();
+
+	// set the page layout without a file (for writing one)
+	bool SetLayout(const VIRTUAL_TEXTURE_INFO& info);
+	const VIRTUAL_TEXTURE_INFO& GetInfo() const { return m_info; }
+	uint32_t GetPageCount() const { return m_pageCount; }
+
+	// index of a page, and the level and position of an index
+	uint32_t PageIndex(uint32_t level, uint32_t x, uint32_t y) const;
+	void PageLocation(uint32_t page, uint32_t& level, uint32_t& x, uint32_t& y) const;
+	// index of the page one level up that covers a page
+	// (INVALID_PAGE for the top level)
+	uint32_t ParentPage(uint32_t page) const;
+	// offset of a page from the start of the file
+	uint64_t PageOffset(uint32_t page) const;
+
+	// pixels of a page inside the mapped file
+	const unsigned char* GetPagePixels(uint32_t page) const;
+
+	// write the header of a file with the current layout
+	bool WriteHeader(std::ostream& output) const;
+
+private:
+	struct VIRTUAL_TEXTURE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t pagesX;
+		uint32_t pagesY;
+		uint32_t pageSize;
+		uint32_t border;
+		uint32_t levelCount;
+		uint32_t reserved;
+	};
+
+	VIRTUAL_TEXTURE_INFO m_info;
+	// index of the first page of each level
+	std::vector<uint32_t> m_levelFirstPage;
+	uint32_t m_pageCount;
+	MappedFile m_file;
+};